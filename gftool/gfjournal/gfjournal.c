@@ -55,6 +55,9 @@ const struct db_ops db_journal_apply_ops;
 /* dummy definition to link successfully without mdhost.o */
 void mdhost_self_is_master(void) {}
 void mdhost_self_is_readonly_unlocked(void) {}
+/* dummy definition to link successfully without rpc_stat.o */
+void rpc_stat_lock_waited(double wait) {}
+void rpc_stat_dbq_waited(double wait) {}
 
 static void
 usage(void)
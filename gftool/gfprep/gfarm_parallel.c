@@ -258,8 +258,11 @@ gfpara_init(gfpara_t **handlep, int n_procs,
 			close(pipe_stderr[0]);
 			close(0);
 			fd = open("/dev/null", O_RDONLY);
+			/*
+			 * keep stdout open as /dev/null, not to reuse the
+			 * descriptor for pipes of nested gfpara_init()
+			 */
 			dup2(fd, 1);
-			close(1);
 			from_parent = fdopen(pipe_in[0], "r");
 			to_parent = fdopen(pipe_out[1], "w");
 			dup2(pipe_stderr[1], 2);
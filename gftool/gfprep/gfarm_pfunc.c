@@ -51,6 +51,11 @@ struct gfarm_pfunc {
 	int skip_existing;
 	int is_end;
 	pthread_mutex_t is_end_mutex;
+
+	/* to copy a large file with multiple streams */
+	int split_n;
+	gfarm_off_t split_min_size;
+	gfarm_pfunc_t *split_handle; /* in a child process */
 };
 
 struct gfarm_pfunc_cmd {
@@ -62,6 +67,7 @@ struct gfarm_pfunc_cmd {
 	int src_port;
 	int dst_port;
 	gfarm_off_t src_size;
+	gfarm_off_t src_offset; /* for PFUNC_CMD_COPY_RANGE */
 	int check_disk_avail;
 	void *cb_data;
 };
@@ -73,6 +79,7 @@ enum pfunc_cmdnum {
 	PFUNC_CMD_COPY,
 	PFUNC_CMD_MOVE,
 	PFUNC_CMD_REMOVE_REPLICA,
+	PFUNC_CMD_COPY_RANGE,
 	PFUNC_CMD_TERMINATE
 };
 
@@ -361,6 +368,54 @@ pfunc_write(struct pfunc_file *fp, void *buf, int bufsize, int *wsize)
 	return (GFARM_ERR_NO_ERROR);
 }
 
+static gfarm_error_t
+pfunc_pread(struct pfunc_file *fp, void *buf, int bufsize, gfarm_off_t off,
+	int *rsize)
+{
+	ssize_t len;
+	char *b = buf;
+
+	if (fp->gfarm)
+		return (gfs_pio_pread(fp->gfarm, buf, bufsize, off, rsize));
+	*rsize = 0;
+	while (bufsize > 0) {
+		len = pread(fp->fd, b, bufsize, off);
+		if (len == -1)
+			return (gfarm_errno_to_error(errno));
+		if (len == 0) /* EOF */
+			break;
+		b += len;
+		off += len;
+		bufsize -= len;
+		*rsize += len;
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static gfarm_error_t
+pfunc_pwrite(struct pfunc_file *fp, void *buf, int bufsize, gfarm_off_t off,
+	int *wsize)
+{
+	ssize_t len;
+	char *b = buf;
+
+	if (fp->gfarm)
+		return (gfs_pio_pwrite(fp->gfarm, buf, bufsize, off, wsize));
+	*wsize = 0;
+	while (bufsize > 0) {
+		len = pwrite(fp->fd, b, bufsize, off);
+		if (len == -1)
+			return (gfarm_errno_to_error(errno));
+		if (len == 0)
+			return (GFARM_ERR_NO_SPACE);
+		b += len;
+		off += len;
+		bufsize -= len;
+		*wsize += len;
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
 static gfarm_error_t
 pfunc_close(struct pfunc_file *fp)
 {
@@ -612,6 +667,237 @@ end:
 
 static const char tmp_url_suffix[] = "__tmp_gfpcopy__";
 
+/*
+ * copy a large file with multiple streams.
+ *
+ * the child process which received PFUNC_CMD_COPY creates the
+ * destination file, and splits the file into ranges.  each range is
+ * copied by a grandchild process (handle->split_handle) with its own
+ * gfarm connections, and the child waits for all of them.
+ */
+struct pfunc_split {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	int n_running;
+	int result;
+};
+
+static const char SPLIT_MUTEX_DIAG[] = "split_mutex";
+static const char SPLIT_COND_DIAG[] = "split_cond";
+
+static void
+pfunc_split_cb_end(enum pfunc_result result, void *data)
+{
+	static const char diag[] = "pfunc_split_cb_end";
+	struct pfunc_split *split = data;
+
+	gfarm_mutex_lock(&split->mutex, diag, SPLIT_MUTEX_DIAG);
+	if (result != PFUNC_RESULT_OK)
+		split->result = PFUNC_RESULT_NG;
+	split->n_running--;
+	gfarm_cond_signal(&split->cond, diag, SPLIT_COND_DIAG);
+	gfarm_mutex_unlock(&split->mutex, diag, SPLIT_MUTEX_DIAG);
+}
+
+static void
+pfunc_split_cb_free(void *data)
+{
+	/* struct pfunc_split is on the stack of pfunc_copy_split() */
+}
+
+static gfarm_error_t
+pfunc_copy_range_add(gfarm_pfunc_t *split_handle,
+	const char *src_url, const char *src_host, int src_port,
+	gfarm_off_t offset, gfarm_off_t length,
+	const char *dst_url, const char *dst_host, int dst_port,
+	struct pfunc_split *split)
+{
+	gfarm_pfunc_cmd_t cmd;
+
+	cmd.command = PFUNC_CMD_COPY_RANGE;
+	cmd.src_url = strdup(src_url);
+	cmd.dst_url = strdup(dst_url);
+	if (cmd.src_url == NULL || cmd.dst_url == NULL) {
+		free(cmd.src_url);
+		free(cmd.dst_url);
+		return (GFARM_ERR_NO_MEMORY);
+	}
+	cmd.src_host = src_host;
+	cmd.dst_host = dst_host;
+	cmd.src_port = src_port;
+	cmd.dst_port = dst_port;
+	cmd.src_size = length;
+	cmd.src_offset = offset;
+	cmd.check_disk_avail = 0;
+	cmd.cb_data = split;
+	return (gfarm_pfunc_cmd_add(split_handle, &cmd));
+}
+
+/*
+ * ranges are aligned to copy_bufsize, one range per stream.
+ *
+ * the number of hosts is not taken into account, because all writers of
+ * a file are redirected to the one gfsd which has the file opened for
+ * writing, so the destination of a file is always a single host.
+ * each stream opens the source by itself, so the replicas of the source
+ * are already spread over the streams by the usual scheduling.
+ */
+static gfarm_off_t
+pfunc_split_range_size(gfarm_pfunc_t *handle, gfarm_off_t size)
+{
+	gfarm_off_t range_size, bufsize = handle->copy_bufsize;
+
+	range_size = (size + handle->split_n - 1) / handle->split_n;
+	range_size = (range_size + bufsize - 1) / bufsize * bufsize;
+	return (range_size);
+}
+
+static int
+pfunc_copy_split(gfarm_pfunc_t *handle,
+	const char *src_url, char *src_host, int src_port, gfarm_off_t size,
+	const char *tmp_url, char *dst_host, int dst_port)
+{
+	static const char diag[] = "pfunc_copy_split";
+	gfarm_error_t e;
+	struct pfunc_split split;
+	gfarm_off_t offset, length, range_size;
+	int result;
+
+	gfarm_mutex_init(&split.mutex, diag, SPLIT_MUTEX_DIAG);
+	gfarm_cond_init(&split.cond, diag, SPLIT_COND_DIAG);
+	split.n_running = 0;
+	split.result = PFUNC_RESULT_OK;
+
+	range_size = pfunc_split_range_size(handle, size);
+	for (offset = 0; offset < size; offset += range_size) {
+		length = size - offset;
+		if (length > range_size)
+			length = range_size;
+		gfarm_mutex_lock(&split.mutex, diag, SPLIT_MUTEX_DIAG);
+		split.n_running++;
+		gfarm_mutex_unlock(&split.mutex, diag, SPLIT_MUTEX_DIAG);
+		e = pfunc_copy_range_add(handle->split_handle,
+		    src_url, src_host, src_port, offset, length,
+		    tmp_url, dst_host, dst_port, &split);
+		if (e != GFARM_ERR_NO_ERROR) {
+			fprintf(stderr,
+			    "ERROR: copy failed: range %lld+%lld of %s: %s\n",
+			    (long long)offset, (long long)length, src_url,
+			    gfarm_error_string(e));
+			gfarm_mutex_lock(&split.mutex, diag, SPLIT_MUTEX_DIAG);
+			split.n_running--;
+			split.result = PFUNC_RESULT_NG;
+			gfarm_mutex_unlock(&split.mutex, diag,
+			    SPLIT_MUTEX_DIAG);
+			break;
+		}
+	}
+
+	gfarm_mutex_lock(&split.mutex, diag, SPLIT_MUTEX_DIAG);
+	while (split.n_running > 0)
+		gfarm_cond_wait(&split.cond, &split.mutex,
+		    diag, SPLIT_COND_DIAG);
+	result = split.result;
+	gfarm_mutex_unlock(&split.mutex, diag, SPLIT_MUTEX_DIAG);
+
+	gfarm_cond_destroy(&split.cond, diag, SPLIT_COND_DIAG);
+	gfarm_mutex_destroy(&split.mutex, diag, SPLIT_MUTEX_DIAG);
+	return (result);
+}
+
+/* run in a grandchild process */
+static int
+pfunc_copy_range(gfarm_pfunc_t *handle,
+	const char *src_url, char *src_host, gfarm_off_t offset,
+	gfarm_off_t length, const char *dst_url, char *dst_host)
+{
+	gfarm_error_t e;
+	int result = PFUNC_RESULT_OK;
+	int rsize, wsize, size;
+	struct pfunc_file src_fp, dst_fp;
+
+	e = pfunc_open(src_url, O_RDONLY, 0, &src_fp);
+	if (e != GFARM_ERR_NO_ERROR) {
+		fprintf(stderr, "ERROR: copy failed: open(%s): %s\n",
+			src_url, gfarm_error_string(e));
+		return (PFUNC_RESULT_NG);
+	}
+	e = pfunc_open(dst_url, O_WRONLY, 0, &dst_fp);
+	if (e != GFARM_ERR_NO_ERROR) {
+		(void)pfunc_close(&src_fp);
+		fprintf(stderr, "ERROR: copy failed: open(%s): %s\n",
+			dst_url, gfarm_error_string(e));
+		return (PFUNC_RESULT_NG);
+	}
+	if (src_fp.gfarm && strcmp(src_host, "") != 0) {
+		/* XXX FIXME: INTERNAL FUNCTION SHOULD NOT BE USED */
+		e = gfs_pio_internal_set_view_section(src_fp.gfarm, src_host);
+		if (e != GFARM_ERR_NO_ERROR) {
+			fprintf(stderr,
+				"ERROR: copy failed: set_view(%s, %s): %s\n",
+				src_url, src_host, gfarm_error_string(e));
+			result = PFUNC_RESULT_NG;
+			goto close;
+		}
+	}
+	if (dst_fp.gfarm && strcmp(dst_host, "") != 0) {
+		/* XXX FIXME: INTERNAL FUNCTION SHOULD NOT BE USED */
+		e = gfs_pio_internal_set_view_section(dst_fp.gfarm, dst_host);
+		if (e != GFARM_ERR_NO_ERROR) {
+			fprintf(stderr,
+				"ERROR: copy failed: set_view(%s, %s): %s\n",
+				dst_url, dst_host, gfarm_error_string(e));
+			result = PFUNC_RESULT_NG;
+			goto close;
+		}
+	}
+	while (length > 0) {
+		size = length < handle->copy_bufsize ?
+		    length : handle->copy_bufsize;
+		e = pfunc_pread(&src_fp, handle->copy_buf, size, offset,
+		    &rsize);
+		if (e != GFARM_ERR_NO_ERROR) {
+			fprintf(stderr, "ERROR: copy failed: read(%s): %s\n",
+				src_url, gfarm_error_string(e));
+			result = PFUNC_RESULT_NG;
+			goto close;
+		}
+		if (rsize == 0) /* EOF: truncated while copying */
+			break;
+		e = pfunc_pwrite(&dst_fp, handle->copy_buf, rsize, offset,
+		    &wsize);
+		if (e != GFARM_ERR_NO_ERROR) {
+			fprintf(stderr, "ERROR: copy failed: write(%s): %s\n",
+				dst_url, gfarm_error_string(e));
+			result = PFUNC_RESULT_NG;
+			goto close;
+		}
+		if (rsize != wsize) {
+			fprintf(stderr,
+				"ERROR: copy failed: write(%s): "
+				"rsize!=wsize\n", dst_url);
+			result = PFUNC_RESULT_NG;
+			goto close;
+		}
+		offset += rsize;
+		length -= rsize;
+	}
+close:
+	e = pfunc_close(&src_fp);
+	if (e != GFARM_ERR_NO_ERROR) {
+		fprintf(stderr, "ERROR: copy failed: close(%s): %s\n",
+			src_url, gfarm_error_string(e));
+		result = PFUNC_RESULT_NG;
+	}
+	e = pfunc_close(&dst_fp);
+	if (e != GFARM_ERR_NO_ERROR) {
+		fprintf(stderr, "ERROR: copy failed: close(%s): %s\n",
+			dst_url, gfarm_error_string(e));
+		result = PFUNC_RESULT_NG;
+	}
+	return (result);
+}
+
 static int
 pfunc_copy_to_gfarm_or_local(gfarm_pfunc_t *handle, FILE *to_parent,
 	const char *src_url, char *src_host, int src_port, gfarm_off_t src_size,
@@ -724,6 +1010,12 @@ pfunc_copy_to_gfarm_or_local(gfarm_pfunc_t *handle, FILE *to_parent,
 			goto close;
 		}
 	}
+	if (handle->split_handle != NULL &&
+	    src_st.size >= handle->split_min_size) {
+		result = pfunc_copy_split(handle, src_url, src_host, src_port,
+		    src_st.size, tmp_url, dst_host, dst_port);
+		goto close;
+	}
 	while ((e = pfunc_read(&src_fp, handle->copy_buf,
 			       handle->copy_bufsize, &rsize))
 	       == GFARM_ERR_NO_ERROR) {
@@ -845,6 +1137,34 @@ end:
 	free(dst_host);
 }
 
+static void
+pfunc_copy_range_main(gfarm_pfunc_t *handle,
+		      FILE *from_parent, FILE *to_parent)
+{
+	int result;
+	char *src_url, *dst_url, *src_host, *dst_host;
+	int src_port, dst_port; /* XXX unused */
+	gfarm_off_t offset, length;
+
+	gfpara_recv_string(from_parent, &src_url);
+	gfpara_recv_int64(from_parent, &offset);
+	gfpara_recv_int64(from_parent, &length);
+	gfpara_recv_string(from_parent, &src_host);
+	gfpara_recv_int(from_parent, &src_port);
+	gfpara_recv_string(from_parent, &dst_url);
+	gfpara_recv_string(from_parent, &dst_host);
+	gfpara_recv_int(from_parent, &dst_port);
+
+	result = pfunc_copy_range(handle, src_url, src_host, offset, length,
+	    dst_url, dst_host);
+
+	gfpara_send_int(to_parent, result);
+	free(src_url);
+	free(dst_url);
+	free(src_host);
+	free(dst_host);
+}
+
 static void
 pfunc_remove_replica_main(gfarm_pfunc_t *handle,
 			  FILE *from_parent, FILE *to_parent)
@@ -892,6 +1212,25 @@ pfunc_child(void *param, FILE *from_parent, FILE *to_parent)
 	gfarm_pfunc_t *handle = param;
 	enum pfunc_result result = PFUNC_RESULT_FATAL;
 
+	handle->split_handle = NULL;
+	if (handle->split_n > 1) {
+		/* fork() before gfarm_initialize() and pthread_create() */
+		e = gfarm_pfunc_init_fork(&handle->split_handle,
+		    handle->split_n, 1, 0, handle->copy_bufsize, 0, 0, 0,
+		    NULL, pfunc_split_cb_end, pfunc_split_cb_free);
+		if (e == GFARM_ERR_NO_ERROR) {
+			e = gfarm_pfunc_start(handle->split_handle);
+			if (e != GFARM_ERR_NO_ERROR) {
+				gfarm_pfunc_terminate(handle->split_handle);
+				gfarm_pfunc_join(handle->split_handle);
+				handle->split_handle = NULL;
+			}
+		}
+		if (e != GFARM_ERR_NO_ERROR) /* copy with a single stream */
+			fprintf(stderr, "WARNING: cannot start processes "
+			    "to copy a file with multiple streams: %s\n",
+			    gfarm_error_string(e));
+	}
 	e = gfarm_initialize(NULL, NULL);
 	if (e != GFARM_ERR_NO_ERROR) {
 		fprintf(stderr, "ERROR: gfarm_initialize: %s\n",
@@ -923,6 +1262,9 @@ pfunc_child(void *param, FILE *from_parent, FILE *to_parent)
 			pfunc_remove_replica_main(handle,
 						  from_parent, to_parent);
 			continue;
+		case PFUNC_CMD_COPY_RANGE:
+			pfunc_copy_range_main(handle, from_parent, to_parent);
+			continue;
 		case PFUNC_CMD_TERMINATE:
 			result = PFUNC_RESULT_END;
 			goto term;
@@ -939,6 +1281,12 @@ term:
 	if (e != GFARM_ERR_NO_ERROR)
 		fprintf(stderr, "ERROR: gfarm_terminate: %s\n",
 			gfarm_error_string(e));
+	if (handle->split_handle != NULL) {
+		e = gfarm_pfunc_join(handle->split_handle);
+		if (e != GFARM_ERR_NO_ERROR)
+			fprintf(stderr, "ERROR: gfarm_pfunc_join: %s\n",
+				gfarm_error_string(e));
+	}
 
 	gfpara_send_int(to_parent, result);
 
@@ -1033,6 +1381,16 @@ pfunc_send(FILE *child_in, gfpara_proc_t *proc, void *param, int stop)
 		gfpara_send_string(child_in, "%s", cmd.src_host);
 		gfpara_send_int(child_in, cmd.src_port);
 		break;
+	case PFUNC_CMD_COPY_RANGE:
+		gfpara_send_string(child_in, "%s", cmd.src_url);
+		gfpara_send_int64(child_in, cmd.src_offset);
+		gfpara_send_int64(child_in, cmd.src_size);
+		gfpara_send_string(child_in, "%s", cmd.src_host);
+		gfpara_send_int(child_in, cmd.src_port);
+		gfpara_send_string(child_in, "%s", cmd.dst_url);
+		gfpara_send_string(child_in, "%s", cmd.dst_host);
+		gfpara_send_int(child_in, cmd.dst_port);
+		break;
 	default:
 		fprintf(stderr,
 			"ERROR: unexpected command: %d\n", cmd.command);
@@ -1098,6 +1456,7 @@ gfarm_error_t
 gfarm_pfunc_init_fork(
 	gfarm_pfunc_t **handlep, int n_parallel, int queue_size,
 	gfarm_int64_t simulate_KBs, int copy_bufsize, int skip_existing,
+	int split_n, gfarm_off_t split_min_size,
 	void (*cb_start)(void *), void (*cb_end)(enum pfunc_result, void *),
 	void (*cb_free)(void *))
 {
@@ -1117,6 +1476,9 @@ gfarm_pfunc_init_fork(
 	handle->copy_buf = buf;
 	handle->copy_bufsize = copy_bufsize;
 	handle->skip_existing = skip_existing;
+	handle->split_n = split_n;
+	handle->split_min_size = split_min_size;
+	handle->split_handle = NULL;
 	handle->cb_start = cb_start;
 	handle->cb_end = cb_end;
 	handle->cb_free = cb_free;
@@ -15,7 +15,8 @@ enum pfunc_result {
 };
 
 gfarm_error_t gfarm_pfunc_init_fork(gfarm_pfunc_t **, int, int, gfarm_int64_t,
-	int, int, void (*)(void *), void (*)(enum pfunc_result, void *),
+	int, int, int, gfarm_off_t,
+	void (*)(void *), void (*)(enum pfunc_result, void *),
 	void (*)(void *));
 gfarm_error_t gfarm_pfunc_start(gfarm_pfunc_t *);
 gfarm_error_t gfarm_pfunc_cmd_add(gfarm_pfunc_t *, gfarm_pfunc_cmd_t *);
@@ -100,6 +100,8 @@ gfpcopy_usage()
 "\t[-e (skip existing files\n"
 "\t     in order to execute multiple gfpcopy simultaneously)]\n"
 "\t[-k (skip symlink)]\n"
+"\t[-t <#streams to copy a large file>(default: 1)]\n"
+"\t[-T <#byte(K|M|G|T)(minimum file size to copy with -t)(default: 1G)>]\n"
 "\t<src_url(gfarm:... or file:...) or local-path>\n"
 "\t<dst_directory(gfarm:... or file:... or hpss:...) or local-path>\n");
 }
@@ -2527,6 +2529,9 @@ main(int argc, char *argv[])
 	int opt_ratio = 1; /* -R */
 	int opt_limited_src = 0; /* -L */
 	int opt_copy_bufsize = 64 * 1024; /* -b, default=64KiB */
+	int opt_split_n = 1; /* -t */
+	gfarm_int64_t opt_split_min_size
+		= 1024 * 1024 * 1024; /* -T, default=1GiB */
 	int opt_dirtree_n_para = -1; /* -J */
 	int opt_dirtree_n_fifo = 10000; /* -F */
 	int opt_list_only = 0; /* -l */
@@ -2547,7 +2552,7 @@ main(int argc, char *argv[])
 	gfmsg_fatal_e(e, "gfarm_list_init");
 
 	while ((ch = getopt(argc, argv,
-	    "N:h:j:w:W:s:S:D:H:R:M:b:J:F:C:c:LekmnpPqvdfUlxX:z:Z:?")) != -1) {
+	    "N:h:j:w:W:s:S:D:H:R:M:b:t:T:J:F:C:c:LekmnpPqvdfUlxX:z:Z:?")) != -1) {
 		switch (ch) {
 		case 'w':
 			opt_way = optarg;
@@ -2641,6 +2646,17 @@ main(int argc, char *argv[])
 		case 'b': /* gfpcopy */
 			opt_copy_bufsize = strtol(optarg, NULL, 0);
 			break;
+		case 't': /* gfpcopy */
+			opt_split_n = strtol(optarg, NULL, 0);
+			break;
+		case 'T': /* gfpcopy */
+			e = gfarm_humanize_number_to_int64(
+			    &opt_split_min_size, optarg);
+			if (e != GFARM_ERR_NO_ERROR) {
+				gfmsg_error("-T %s: invalid number", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
 		case 'e': /* gfpcopy */
 			opt_skip_existing = 1;
 			break;
@@ -2779,9 +2795,17 @@ main(int argc, char *argv[])
 			    gfurl_url(src_orig));
 			exit(EXIT_FAILURE);
 		}
+		if (gfurl_is_hpss(dst_orig) && opt_split_n > 1) {
+			gfmsg_error(
+			    "copying to HPSS (%s) with multiple streams "
+			    "is not supported", gfurl_url(dst_orig));
+			exit(EXIT_FAILURE);
+		}
 	} else { /* gfprep */
 		if (opt_force_copy || opt_skip_existing || opt_skip_symlink)
 			gfprep_usage_common(1); /* -f or -e or -k */
+		if (opt_split_n > 1)
+			gfprep_usage_common(1); /* -t */
 		if (opt_migrate) {
 			if (opt_n_desire > 1) { /* -m and -N */
 				gfmsg_error("gfprep needs either -N or -m");
@@ -2880,6 +2904,17 @@ main(int argc, char *argv[])
 		gfprep_usage_common(1);
 	if (opt_copy_bufsize <= 0)
 		gfprep_usage_common(1);
+	if (opt_split_n <= 0 || opt_split_min_size <= 0)
+		gfprep_usage_common(1);
+	if (opt_split_n > gfarm_ctxp->client_parallel_max) {
+		opt_split_n = gfarm_ctxp->client_parallel_max;
+		gfmsg_debug("client_parallel_max = %d",
+		    gfarm_ctxp->client_parallel_max);
+	}
+	if (opt_split_n > 1)
+		gfmsg_debug("number of streams to copy a file larger than "
+		    "%lld bytes: %d", (long long)opt_split_min_size,
+		    opt_split_n);
 	if (opt_dirtree_n_fifo <= 0)
 		gfprep_usage_common(1);
 
@@ -2935,7 +2970,8 @@ main(int argc, char *argv[])
 	/* fork() before gfarm_initialize() and pthread_create() */
 	e = gfarm_pfunc_init_fork(
 	    &pfunc_handle, opt_n_para, 1, opt_simulate_KBs, opt_copy_bufsize,
-	    opt_skip_existing, pfunc_cb_start, pfunc_cb_end, pfunc_cb_free);
+	    opt_skip_existing, opt_split_n, opt_split_min_size,
+	    pfunc_cb_start, pfunc_cb_end, pfunc_cb_free);
 	gfmsg_fatal_e(e, "gfarm_pfunc_init_fork");
 
 	e = gfarm_dirtree_init_fork(&dirtree_handle, src,
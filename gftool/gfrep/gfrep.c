@@ -39,6 +39,7 @@ static int opt_noexec;		/* -n */
 static int opt_verbose;		/* -v */
 static int opt_nrep = 1;	/* -N */
 static int opt_remove;		/* -x */
+static int opt_chain;		/* -c */
 
 struct gfrep_arg {
 	int ndst, nsrc;
@@ -52,6 +53,7 @@ struct file_info {
 	int ncopy;
 	char **copy;
 	int surplus_ncopy;
+	int nrep;	/* number of replicas to be created by -c */
 };
 
 /* for create_filelist */
@@ -72,6 +74,71 @@ gfrep_replicate_to(struct file_info *fi, int di, struct gfrep_arg *a)
 	return (gfs_replicate_to(fi->pathname, a->dst[di], a->dst_port[di]));
 }
 
+static int file_copy_does_exist(struct file_info *, char *);
+static int is_enough_space(const char *, char *, int, gfarm_off_t);
+
+/*
+ * create fi->nrep replicas by a chained replication,
+ * dst[di] is the first hop, and the following hops are chosen from
+ * the subsequent destination nodes.
+ */
+static gfarm_error_t
+gfrep_replicate_chain_to(struct file_info *fi, int di, struct gfrep_arg *a)
+{
+	gfarm_error_t e, e_save = GFARM_ERR_NO_ERROR, *errs;
+	char **hosts;
+	int *ports, i, n = 0;
+
+	GFARM_MALLOC_ARRAY(hosts, fi->nrep);
+	GFARM_MALLOC_ARRAY(ports, fi->nrep);
+	GFARM_MALLOC_ARRAY(errs, fi->nrep);
+	if (hosts == NULL || ports == NULL || errs == NULL) {
+		free(hosts);
+		free(ports);
+		free(errs);
+		return (GFARM_ERR_NO_MEMORY);
+	}
+	for (i = 0; i < a->ndst && n < fi->nrep; ++i, di = (di + 1) % a->ndst) {
+		if (file_copy_does_exist(fi, a->dst[di]) ||
+		    !is_enough_space(fi->pathname,
+		    a->dst[di], a->dst_port[di], fi->filesize))
+			continue;
+		hosts[n] = a->dst[di];
+		ports[n] = a->dst_port[di];
+		++n;
+	}
+	if (n < fi->nrep)
+		e_save = GFARM_ERR_NO_SPACE;
+	if (n > 0) {
+		if (opt_verbose) {
+			printf("%s: chain", fi->pathname);
+			for (i = 0; i < n; ++i)
+				printf(" --> %s", hosts[i]);
+			printf("\n");
+			fflush(stdout);
+		}
+		gfs_replicate_chain_to(fi->pathname, n, hosts, ports, errs);
+		for (i = 0; i < n; ++i) {
+			e = errs[i];
+			/* this gfrep may create the replica concurrently */
+			if (e == GFARM_ERR_ALREADY_EXISTS ||
+			    e == GFARM_ERR_OPERATION_ALREADY_IN_PROGRESS) {
+				if (opt_verbose)
+					printf("%s: %s: %s\n", fi->pathname,
+					    hosts[i], gfarm_error_string(e));
+			} else if (e != GFARM_ERR_NO_ERROR) {
+				fprintf(stderr, "%s: %s: %s\n", fi->pathname,
+				    hosts[i], gfarm_error_string(e));
+				e_save = e;
+			}
+		}
+	}
+	free(hosts);
+	free(ports);
+	free(errs);
+	return (e_save);
+}
+
 static int remove_replicas(struct file_info *, int, int, char **);
 
 static gfarm_error_t
@@ -101,6 +168,11 @@ struct action replicate_mode = {
 	gfrep_replicate_to
 };
 
+struct action replicate_chain_mode = {
+	"replicate",
+	gfrep_replicate_chain_to
+};
+
 struct action migrate_mode = {
 	"migrate",
 	gfrep_migrate_to
@@ -138,7 +210,7 @@ file_info_alloc(void)
 
 static gfarm_error_t
 gfarm_list_add_file_info(char *pathname, gfarm_off_t filesize,
-	int ncopy, char **copy, int surplus, gfarm_list *list)
+	int ncopy, char **copy, int surplus, int nrep, gfarm_list *list)
 {
 	struct file_info *info;
 	gfarm_error_t e;
@@ -170,6 +242,7 @@ gfarm_list_add_file_info(char *pathname, gfarm_off_t filesize,
 	info->ncopy = ncopy;
 	info->filesize = filesize;
 	info->surplus_ncopy = surplus;
+	info->nrep = nrep;
 	e = gfarm_list_add(list, info);
 	if (e != GFARM_ERR_NO_ERROR)
 		file_info_free(info);
@@ -231,9 +304,16 @@ create_filelist(char *file, struct gfs_stat *st, void *arg)
 	}
 
 	/* add a file info to slist */
-	for (j = 0; j < opt_nrep - dst_ncopy; ++j) {
+	if (opt_chain && opt_nrep > dst_ncopy) {
+		/* all replicas are created at once */
 		e = gfarm_list_add_file_info(file, st->st_size, ncopy, copy,
-			0, &a->slist);
+			0, opt_nrep - dst_ncopy, &a->slist);
+		if (e != GFARM_ERR_NO_ERROR)
+			goto free_copy;
+	}
+	for (j = 0; !opt_chain && j < opt_nrep - dst_ncopy; ++j) {
+		e = gfarm_list_add_file_info(file, st->st_size, ncopy, copy,
+			0, 1, &a->slist);
 		if (e != GFARM_ERR_NO_ERROR)
 			goto free_copy;
 	}
@@ -241,7 +321,7 @@ create_filelist(char *file, struct gfs_stat *st, void *arg)
 	/* add a file info to dlist if too many file replicas exist */
 	if (dst_ncopy > opt_nrep) {
 		e = gfarm_list_add_file_info(file, st->st_size, ncopy, copy,
-			dst_ncopy - opt_nrep, &a->dlist);
+			dst_ncopy - opt_nrep, 0, &a->dlist);
 	}
  free_copy:
 	gfarm_strings_free_deeply(ncopy, copy);
@@ -603,7 +683,7 @@ pfor(struct action *act, int nfinfo, struct file_info **finfo,
 static int
 usage()
 {
-	fprintf(stderr, "Usage: %s [-mnqvx] [-S <src_domain>]"
+	fprintf(stderr, "Usage: %s [-cmnqvx] [-S <src_domain>]"
 		" [-D <dst_domain>]\n", program_name);
 	fprintf(stderr, "\t[-h <src_hostlist>] [-H <dst_hostlist>]"
 		" [-N <#replica>]");
@@ -808,11 +888,14 @@ main(int argc, char *argv[])
 	error_check(e);
 
 #ifdef _OPENMP
-	while ((ch = getopt(argc, argv, "h:j:mnqvxS:D:H:N:?")) != -1) {
+	while ((ch = getopt(argc, argv, "ch:j:mnqvxS:D:H:N:?")) != -1) {
 #else
-	while ((ch = getopt(argc, argv, "h:mnqvxS:D:H:N:?")) != -1) {
+	while ((ch = getopt(argc, argv, "ch:mnqvxS:D:H:N:?")) != -1) {
 #endif
 		switch (ch) {
+		case 'c':
+			opt_chain = 1;
+			break;
 		case 'h':
 			src_hostfile = optarg;
 			conflict_check(&mode_src_ch, ch);
@@ -859,6 +942,14 @@ main(int argc, char *argv[])
 	}
 	argc -= optind;
 	argv += optind;
+	if (opt_chain) {
+		if (act == &migrate_mode) {
+			fprintf(stderr, "%s: -c option conflicts with -m\n",
+				program_name);
+			usage();
+		}
+		act = &replicate_chain_mode;
+	}
 
 	/* make writing-to-stderr atomic, for GfarmFS-FUSE log output */
 	setvbuf(stderr, NULL, _IOLBF, 0);
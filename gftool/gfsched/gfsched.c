@@ -21,8 +21,8 @@
 /*
  *  Create a hostfile.
  *
- *  gfsched [-P <path>] [-D <domain>] [-n <number>] [-LMlw]
- *  gfsched  -f <file>  [-D <domain>] [-n <number>] [-LMclw]
+ *  gfsched [-P <path>] [-D <domain>] [-n <number>] [-LMTlw]
+ *  gfsched  -f <file>  [-D <domain>] [-n <number>] [-LMTclw]
  */
 
 char *program_name = "gfsched";
@@ -32,15 +32,16 @@ void
 usage(void)
 {
 	fprintf(stderr, 
-	    "Usage:\t%s [-P <path>] [-D <domain>] [-n <number>] [-LMlw]\n",
+	    "Usage:\t%s [-P <path>] [-D <domain>] [-n <number>] [-LMTlw]\n",
 	    program_name);
 	fprintf(stderr,
-	          "\t%s  -f <file>  [-D <domain>] [-n <number>] [-LMclw]\n",
+	          "\t%s  -f <file>  [-D <domain>] [-n <number>] [-LMTclw]\n",
 	    program_name);
 	fprintf(stderr,
 	    "options:\n");
 	fprintf(stderr, "\t-L\t\tdo not check authentication\n");
 	fprintf(stderr, "\t-M\t\tno client-side scheduling\n");
+	fprintf(stderr, "\t-T\t\ttopology-aware scheduling\n");
 	fprintf(stderr, "\t-c\t\tcreate mode (currently leaves a file)\n");
 	fprintf(stderr, "\t-w\t\twrite mode\n");
 	fprintf(stderr, "\t-l\t\tlong format\n");
@@ -97,7 +98,7 @@ main(int argc, char **argv)
 		exit(1);
 	}
 
-	while ((c = getopt(argc, argv, "D:LMP:cf:ln:w")) != -1) {
+	while ((c = getopt(argc, argv, "D:LMP:Tcf:ln:w")) != -1) {
 		switch (c) {
 		case 'D':
 			opt_domain = optarg;
@@ -111,6 +112,9 @@ main(int argc, char **argv)
 		case 'P':
 			opt_mount_point = optarg;
 			break;
+		case 'T':
+			gfarm_schedule_search_mode_use_topology();
+			break;
 		case 'c':
 			opt_create_mode = 1;
 			break;
@@ -4,6 +4,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <libgen.h>
 #include <gfarm/gfarm.h>
@@ -15,6 +16,7 @@
 #include "gfpath.h"
 #include "metadb_server.h"
 #include "gfm_client.h"
+#include "gfm_proto.h"
 #include "lookup.h"
 #include "gfarm_path.h"
 
@@ -52,11 +54,106 @@ print_user_config_file(char *msg)
 		printf("%s\n", rc);
 }
 
+/* microseconds, the lower bound of the bucket which includes the percentile */
+static gfarm_uint64_t
+rpc_stat_percentile(struct gfm_rpc_stat_histogram *h, gfarm_uint64_t count,
+	int percent)
+{
+	gfarm_uint64_t sum = 0, target = (count * percent + 99) / 100;
+	int i;
+
+	for (i = 0; i < GFM_PROTO_RPC_STAT_NBUCKETS; i++) {
+		sum += h->buckets[i];
+		if (sum >= target && sum > 0)
+			return (gfm_proto_rpc_stat_bucket_lower_bound(i));
+	}
+	return (h->max);
+}
+
+/* the queue wait is not sampled for every request, thus count the buckets */
+static double
+rpc_stat_average(struct gfm_rpc_stat_histogram *h)
+{
+	gfarm_uint64_t n = 0;
+	int i;
+
+	for (i = 0; i < GFM_PROTO_RPC_STAT_NBUCKETS; i++)
+		n += h->buckets[i];
+	return (n == 0 ? 0.0 : (double)h->total / n);
+}
+
+void
+print_rpc_stat(struct gfm_connection *gfm_server)
+{
+	gfarm_error_t e;
+	int i, n;
+	struct gfm_rpc_stat *stats, *st;
+	struct gfm_rpc_stat_histogram *h;
+	const char *name;
+	char buf[GFARM_INT32STRLEN + 1];
+
+	e = gfm_client_rpc_stat_get(gfm_server, &n, &stats);
+	error_check("gfm_client_rpc_stat_get", e);
+
+	/* all times are in microseconds */
+	printf("%-28s %10s %9s %9s %9s %9s %9s %9s %9s\n",
+	    "request", "count", "avg", "p50", "p99", "max",
+	    "queue", "lock", "dbq");
+	for (i = 0; i < n; i++) {
+		st = &stats[i];
+		h = &st->phases[GFM_PROTO_RPC_STAT_TOTAL];
+		if ((name = gfm_proto_command_name(st->request)) == NULL) {
+			snprintf(buf, sizeof buf, "%d", (int)st->request);
+			name = buf;
+		}
+		printf("%-28s %10llu %9.0f %9llu %9llu %9llu %9.0f %9.0f %9.0f\n",
+		    name, (unsigned long long)st->count,
+		    rpc_stat_average(h),
+		    (unsigned long long)rpc_stat_percentile(h, st->count, 50),
+		    (unsigned long long)rpc_stat_percentile(h, st->count, 99),
+		    (unsigned long long)h->max,
+		    rpc_stat_average(&st->phases[GFM_PROTO_RPC_STAT_QUEUE]),
+		    rpc_stat_average(&st->phases[GFM_PROTO_RPC_STAT_LOCK]),
+		    rpc_stat_average(&st->phases[GFM_PROTO_RPC_STAT_DBQ]));
+	}
+	free(stats);
+}
+
+void
+print_memory_stat(struct gfm_connection *gfm_server)
+{
+	gfarm_error_t e;
+	int i, n;
+	char **names;
+	gfarm_uint64_t *values, inodes = 0, bytes = 0;
+
+	e = gfm_client_memory_stat_get(gfm_server, &n, &names, &values);
+	error_check("gfm_client_memory_stat_get", e);
+
+	for (i = 0; i < n; i++) {
+		printf("%-28s %llu\n", names[i], (unsigned long long)values[i]);
+		if (strcmp(names[i], GFM_PROTO_MEMORY_STAT_INODES) == 0)
+			inodes = values[i];
+		else if (strcmp(names[i],
+		    GFM_PROTO_MEMORY_STAT_INODE_TABLE_BYTES) == 0 ||
+		    strcmp(names[i], GFM_PROTO_MEMORY_STAT_INODE_BYTES) == 0 ||
+		    strcmp(names[i],
+		    GFM_PROTO_MEMORY_STAT_FILE_COPY_BYTES) == 0)
+			bytes += values[i];
+	}
+	if (inodes > 0)
+		printf("%-28s %.1f\n", "bytes_per_inode",
+		    (double)bytes / inodes);
+	if (n > 0)
+		gfarm_strings_free_deeply(n, names);
+	free(values);
+}
+
 void
 usage(void)
 {
 	fprintf(stderr,
-	    "Usage:\t%s [-P <path>]\n",
+	    "Usage:\t%s [-M|-R] [-P <path>]\n",
 	    program_name);
 	exit(EXIT_FAILURE);
 }
@@ -65,7 +162,7 @@ int
 main(int argc, char *argv[])
 {
 	gfarm_error_t e, e2;
-	int port, c;
+	int port, c, opt_rpc_stat = 0, opt_memory_stat = 0;
 	char *canonical_hostname, *hostname, *realpath = NULL;
 	const char *user, *gfmd_hostname;
 	const char *path = ".";
@@ -78,15 +175,21 @@ main(int argc, char *argv[])
 	if (argc > 0)
 		program_name = basename(argv[0]);
 
-	while ((c = getopt(argc, argv, "dP:?"))
+	while ((c = getopt(argc, argv, "dMP:R?"))
 	    != -1) {
 		switch (c) {
 		case 'd':
 			gflog_set_priority_level(LOG_DEBUG);
 			break;
+		case 'M':
+			opt_memory_stat = 1;
+			break;
 		case 'P':
 			path = optarg;
 			break;
+		case 'R':
+			opt_rpc_stat = 1;
+			break;
 		case '?':
 			usage();
 		}
@@ -114,6 +217,17 @@ main(int argc, char *argv[])
 		}
 		exit(EXIT_FAILURE);
 	}
+	if (opt_rpc_stat || opt_memory_stat) {
+		free(realpath);
+		if (opt_rpc_stat)
+			print_rpc_stat(gfm_server);
+		else
+			print_memory_stat(gfm_server);
+		gfm_client_connection_free(gfm_server);
+		e = gfarm_terminate();
+		error_check("gfarm_terminate", e);
+		exit(0);
+	}
 	user = gfm_client_username(gfm_server);
 
 	print_user_config_file("user config file  ");
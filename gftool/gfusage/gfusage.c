@@ -23,17 +23,21 @@ static void
 usage(void)
 {
 	fprintf(stderr, "Usage:\t%s [-P <path>] [-g] [name]\n", program_name);
+	fprintf(stderr, "\t%s -d [path...]\n", program_name);
 	exit(1);
 }
 
 static const char head_user[]  = " UserName";
 static const char head_group[] = "GroupName";
+static const char head_dir[] = "Directory";
 static const char head_space[] = "FileSpace";
 static const char head_num[] = "FileNum";
 static const char head_phy_space[] = "PhysicalSpace";
 static const char head_phy_num[] = "PhysicalNum";
 
 static const char header_format[] = "#  %s : %15s %11s %15s %11s\n";
+/* a path may be long, thus it's the last column */
+static const char dir_header_format[] = "# %15s %11s %15s %11s %s\n";
 
 static gfarm_error_t
 print_usage_common(const char *name, int opt_group)
@@ -176,12 +180,53 @@ usage_group_all()
 		return (e_save);
 }
 
+static gfarm_error_t
+usage_dir(const char *path)
+{
+	struct gfs_dir_usage du;
+	char *realpath = NULL;
+	gfarm_error_t e;
+
+	if (gfarm_realpath_by_gfarm2fs(path, &realpath) == GFARM_ERR_NO_ERROR)
+		path = realpath;
+	e = gfs_dir_usage(path, &du);
+	if (e != GFARM_ERR_NO_ERROR)
+		fprintf(stderr, "%s: %s: %s\n",
+			program_name, path, gfarm_error_string(e));
+	else
+		printf("  %15"GFARM_PRId64" %11"GFARM_PRId64
+		       " %15"GFARM_PRId64" %11"GFARM_PRId64" %s\n"
+		       , du.space, du.num, du.phy_space, du.phy_num, path);
+	free(realpath);
+	return (e);
+}
+
+/* the usage of directory trees, which is maintained by gfmd */
+static gfarm_error_t
+usage_dirs(int argc, char **argv)
+{
+	gfarm_error_t e, e_save = GFARM_ERR_NO_ERROR;
+	int i;
+
+	printf(dir_header_format, head_space, head_num,
+	       head_phy_space, head_phy_num, head_dir);
+	if (argc == 0)
+		return (usage_dir("."));
+	for (i = 0; i < argc; i++) {
+		e = usage_dir(argv[i]);
+		if (e_save == GFARM_ERR_NO_ERROR)
+			e_save = e;
+	}
+	return (e_save);
+}
+
 int
 main(int argc, char **argv)
 {
 	gfarm_error_t e;
 	int c, status = 0;
 	int opt_group = 0; /* default: users list */
+	int opt_dir = 0;
 	char *name = NULL, *realpath = NULL;
 	const char *path = ".";
 
@@ -194,11 +239,14 @@ main(int argc, char **argv)
 		exit(1);
 	}
 
-	while ((c = getopt(argc, argv, "P:gh?")) != -1) {
+	while ((c = getopt(argc, argv, "P:dgh?")) != -1) {
 		switch (c) {
 		case 'P':
 			path = optarg;
 			break;
+		case 'd':
+			opt_dir = 1;
+			break;
 		case 'g':
 			opt_group = 1;
 			break;
@@ -211,6 +259,12 @@ main(int argc, char **argv)
 	argc -= optind;
 	argv += optind;
 
+	if (opt_dir) {
+		if (usage_dirs(argc, argv) != GFARM_ERR_NO_ERROR)
+			status = 1;
+		goto terminate;
+	}
+
 	if (gfarm_realpath_by_gfarm2fs(path, &realpath) == GFARM_ERR_NO_ERROR)
 		path = realpath;
 	if ((e = gfm_client_connection_and_process_acquire_by_path(
@@ -12,6 +12,14 @@
 #define GFARM_IOSTAT_IO_WBYTES	3
 #define GFARM_IOSTAT_IO_NITEM	4
 
+/* client read cache, see client_read_cache_directory in gfarm2.conf */
+#define GFARM_IOSTAT_CACHE_HIT_COUNT	0
+#define GFARM_IOSTAT_CACHE_HIT_BYTES	1
+#define GFARM_IOSTAT_CACHE_MISS_COUNT	2
+#define GFARM_IOSTAT_CACHE_MISS_BYTES	3
+#define GFARM_IOSTAT_CACHE_SIZE		4
+#define GFARM_IOSTAT_CACHE_NITEM	5
+
 struct gfarm_iostat_head {
 	unsigned int	s_magic;	/* GFARM_IOSTAT_MAGIC */
 	unsigned int	s_nitem;
@@ -99,6 +99,7 @@ gfarm_error_t gfarm_schedule_hosts_domain_by_file(
 void gfarm_host_sched_info_free(int, struct gfarm_host_sched_info *);
 
 void gfarm_schedule_search_mode_use_loadavg(void);
+void gfarm_schedule_search_mode_use_topology(void);
 gfarm_error_t gfarm_schedule_hosts(const char *,
 	int, struct gfarm_host_sched_info *, int, char **, int *);
 gfarm_error_t gfarm_schedule_hosts_to_write(const char *,
@@ -176,6 +176,39 @@ gfarm_error_t gfs_pio_truncate(GFS_File, gfarm_off_t);
 gfarm_error_t gfs_pio_pread(GFS_File, void *, int, gfarm_off_t, int *);
 gfarm_error_t gfs_pio_pwrite(GFS_File, void *, int, gfarm_off_t, int *);
 
+/* a segment of gfs_pio_preadv() and gfs_pio_pwritev() */
+struct gfs_pio_iovec {
+	void *iov_base;
+	int iov_len;
+	gfarm_off_t iov_offset;
+};
+gfarm_error_t gfs_pio_preadv(GFS_File, const struct gfs_pio_iovec *, int,
+	int *);
+gfarm_error_t gfs_pio_pwritev(GFS_File, const struct gfs_pio_iovec *, int,
+	int *);
+
+/*
+ * the requests of a GFS_File must be issued and completed by one thread
+ * at a time, since they are pipelined on a single connection.
+ * gfs_pio_aio_error() returns GFARM_ERR_OPERATION_NOW_IN_PROGRESS
+ * without waiting if no reply has arrived yet, but once a reply has
+ * started arriving, it may block until the whole reply is received.
+ */
+struct gfs_pio_aiocb {
+	void *aio_buf;
+	int aio_nbytes;
+	gfarm_off_t aio_offset;
+
+	/* private */
+	void *aio_handle;
+	gfarm_error_t aio_error;
+	int aio_return;
+};
+gfarm_error_t gfs_pio_aio_read(GFS_File, struct gfs_pio_aiocb *);
+gfarm_error_t gfs_pio_aio_write(GFS_File, struct gfs_pio_aiocb *);
+gfarm_error_t gfs_pio_aio_error(struct gfs_pio_aiocb *);
+gfarm_error_t gfs_pio_aio_return(struct gfs_pio_aiocb *, int *);
+
 
 int gfs_pio_getc(GFS_File);
 int gfs_pio_ungetc(GFS_File, int);
@@ -319,6 +352,8 @@ gfarm_error_t gfs_closexmlattr(struct gfs_xmlattr_ctx *ctxp);
 
 gfarm_error_t gfs_replicate_to(char *, char *, int);
 gfarm_error_t gfs_replicate_from_to(char *, char *, int, char *, int);
+gfarm_error_t gfs_replicate_chain_to(char *, int, char **, int *,
+	gfarm_error_t *);
 gfarm_error_t gfs_migrate_to(char *, char *, int);
 gfarm_error_t gfs_migrate_from_to(char *, char *, int, char *, int);
 
@@ -355,6 +390,12 @@ gfarm_error_t gfs_replicate_to_local(GFS_File, char *, int);
 gfarm_error_t gfs_execve(const char *, char *const *, char *const *);
 #endif
 gfarm_error_t gfs_statfs(gfarm_off_t *, gfarm_off_t *, gfarm_off_t *);
+
+/* the total usage of the files and directories under a directory */
+struct gfs_dir_usage {
+	gfarm_int64_t space, num, phy_space, phy_num;
+};
+gfarm_error_t gfs_dir_usage(const char *, struct gfs_dir_usage *);
 gfarm_error_t gfs_statfsnode_by_path(const char *, char *, int,
 	gfarm_int32_t *, gfarm_off_t *, gfarm_off_t *,
 	gfarm_off_t *, gfarm_off_t *, gfarm_off_t *, gfarm_off_t *);
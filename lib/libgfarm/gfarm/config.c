@@ -868,6 +868,18 @@ static struct {
 static enum gfarm_atime_type gfarm_atime_type = GFARM_ATIME_DEFAULT;
 static const char *gfarm_atime_type_name = NULL;
 
+static struct {
+	enum gfarm_replica_placement policy;
+	const char *name;
+} gfarm_replica_placements[] = {
+	{ GFARM_REPLICA_PLACEMENT_RANDOM, "random" },
+	{ GFARM_REPLICA_PLACEMENT_WEIGHTED, "weighted" },
+	{ GFARM_REPLICA_PLACEMENT_TWO_CHOICES, "two_choices" }
+};
+static enum gfarm_replica_placement gfarm_replica_placement =
+	GFARM_REPLICA_PLACEMENT_DEFAULT;
+static const char *gfarm_replica_placement_name = NULL;
+
 /* LDAP dependent */
 char *gfarm_ldap_server_name = NULL;
 char *gfarm_ldap_server_port = NULL;
@@ -913,19 +925,27 @@ int	gfarm_iostat_max_client = GFARM_CONFIG_MISC_DEFAULT;
 #define GFARM_SCHEDULE_RTT_THRESH_RATIO_DEFAULT	4000 /* 4.0 * F2LL_SCALE */
 #define GFARM_SCHEDULE_RTT_THRESH_DIFF_DEFAULT	1000 /* 1000 micro second */
 #define GFARM_SCHEDULE_WRITE_LOCAL_PRIORITY_DEFAULT 1 /* enable */
+#define GFARM_SCHEDULE_TOPOLOGY_AWARE_DEFAULT 0 /* disable */
+#define GFARM_SCHEDULE_HOST_STATUS_DEFAULT 0 /* disable */
 #define GFARM_MINIMUM_FREE_DISK_SPACE_DEFAULT	(128 * 1024 * 1024) /* 128MB */
 #ifdef not_def_REPLY_QUEUE
 #define GFM_PROTO_REPLY_TO_GFSD_WINDOW_DEFAULT			200
 #endif
 #define GFS_PROTO_FHREMOVE_REQUEST_WINDOW_DEFAULT		50
+#define GFS_PROTO_FHREMOVE_BATCH_SIZE_DEFAULT			1024
 #define GFS_PROTO_REPLICATION_REQUEST_WINDOW_DEFAULT		20
 #define GFARM_OUTSTANDING_FILE_REPLICATION_LIMIT_DEFAULT	4194304 /* 512MB / (sizeof(file_replication), i.e. 128B) */
+#define GFARM_REPLICATION_SOURCE_WINDOW_DEFAULT		20
+#define GFARM_REPLICATION_BANDWIDTH_LIMIT_DEFAULT	0 /* unlimited */
+#define GFARM_REPLICA_CHECK_REPLICATION_RATIO_DEFAULT	50 /* percent */
 #define GFARM_GFSD_CONNECTION_CACHE_DEFAULT 16 /* 16 free connections */
 #define GFARM_GFMD_CONNECTION_CACHE_DEFAULT  8 /*  8 free connections */
+#define GFARM_GFSD_CONNECTION_POOL_SIZE_DEFAULT 1 /* per gfsd */
 #define GFARM_METADB_MAX_DESCRIPTORS_DEFAULT	(2*65536)
 #define GFARM_CLIENT_FILE_BUFSIZE_DEFAULT	(1024 * 1024)
 #define GFARM_CLIENT_PARALLEL_COPY_DEFAULT	4
 #define GFARM_CLIENT_PARALLEL_MAX_DEFAULT	16
+#define GFARM_CLIENT_READ_CACHE_SIZE_DEFAULT	(1024 * 1024 * 1024) /* 1GB */
 #define GFARM_PROFILE_DEFAULT 0 /* disable */
 #define GFARM_METADB_REPLICATION_ENABLED_DEFAULT	0
 #define GFARM_JOURNAL_MAX_SIZE_DEFAULT		(32 * 1024 * 1024) /* 32MB */
@@ -942,12 +962,19 @@ int	gfarm_iostat_max_client = GFARM_CONFIG_MISC_DEFAULT;
 #define GFARM_REPLICA_CHECK_HOST_DOWN_THRESH_DEFAULT 10800 /* 3 hours */
 #define GFARM_REPLICA_CHECK_SLEEP_TIME_DEFAULT 100000 /* nanosec. */
 #define GFARM_REPLICA_CHECK_MINIMUM_INTERVAL_DEFAULT 10 /* 10 sec. */
+#define GFARM_SPOOL_CHECK_PARALLEL_DEFAULT 8
+#define GFARM_SPOOL_CHECK_INCREMENTAL_DEFAULT 1 /* enable */
+#define GFARM_HOST_STATUS_REPORT_INTERVAL_DEFAULT 500 /* millisec. */
 #ifdef not_def_REPLY_QUEUE
 int gfm_proto_reply_to_gfsd_window = GFARM_CONFIG_MISC_DEFAULT;
 #endif
 int gfs_proto_fhremove_request_window = GFARM_CONFIG_MISC_DEFAULT;
+int gfs_proto_fhremove_batch_size = GFARM_CONFIG_MISC_DEFAULT;
 int gfs_proto_replication_request_window = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_outstanding_file_replication_limit = GFARM_CONFIG_MISC_DEFAULT;
+int gfarm_replication_source_window = GFARM_CONFIG_MISC_DEFAULT;
+gfarm_off_t gfarm_replication_bandwidth_limit = GFARM_CONFIG_MISC_DEFAULT;
+int gfarm_replica_check_replication_ratio = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_xattr_size_limit = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_xmlattr_size_limit = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_metadb_max_descriptors = GFARM_CONFIG_MISC_DEFAULT;
@@ -956,6 +983,9 @@ int gfarm_metadb_thread_pool_size = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_metadb_job_queue_length = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_metadb_heartbeat_interval = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_metadb_dbq_size = GFARM_CONFIG_MISC_DEFAULT;
+int gfarm_metadb_inode_hugepage = GFARM_CONFIG_MISC_DEFAULT;
+int gfarm_metadb_check_parallel = GFARM_CONFIG_MISC_DEFAULT;
+int gfarm_metadb_check_after_clean_shutdown = GFARM_CONFIG_MISC_DEFAULT;
 static int metadb_replication_enabled = GFARM_CONFIG_MISC_DEFAULT;
 static char *journal_dir = NULL;
 static int journal_max_size = GFARM_CONFIG_MISC_DEFAULT;
@@ -969,6 +999,9 @@ int gfarm_replica_check = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_replica_check_host_down_thresh = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_replica_check_sleep_time = GFARM_CONFIG_MISC_DEFAULT;
 int gfarm_replica_check_minimum_interval = GFARM_CONFIG_MISC_DEFAULT;
+int gfarm_spool_check_parallel = GFARM_CONFIG_MISC_DEFAULT;
+int gfarm_spool_check_incremental = GFARM_CONFIG_MISC_DEFAULT;
+int gfarm_host_status_report_interval = GFARM_CONFIG_MISC_DEFAULT;
 
 void
 gfarm_config_clear(void)
@@ -1053,6 +1086,18 @@ gfarm_schedule_write_local_priority(void)
 	return (gfarm_ctxp->schedule_write_local_priority);
 }
 
+int
+gfarm_schedule_topology_aware(void)
+{
+	return (gfarm_ctxp->schedule_topology_aware);
+}
+
+int
+gfarm_schedule_host_status(void)
+{
+	return (gfarm_ctxp->schedule_host_status);
+}
+
 char *
 gfarm_schedule_write_target_domain(void)
 {
@@ -1355,6 +1400,51 @@ gfarm_atime_type_set_by_name(const char *name)
 	return (GFARM_ERR_INVALID_ARGUMENT);
 }
 
+enum gfarm_replica_placement
+gfarm_replica_placement_get(void)
+{
+	return (gfarm_replica_placement);
+}
+
+const char *
+gfarm_replica_placement_get_by_name(void)
+{
+	return (gfarm_replica_placement_name);
+}
+
+gfarm_error_t
+gfarm_replica_placement_set(enum gfarm_replica_placement policy)
+{
+	int i;
+
+	for (i = 0; i < GFARM_ARRAY_LENGTH(gfarm_replica_placements); i++) {
+		if (policy == gfarm_replica_placements[i].policy) {
+			gfarm_replica_placement = policy;
+			gfarm_replica_placement_name =
+			    gfarm_replica_placements[i].name;
+			return (GFARM_ERR_NO_ERROR);
+		}
+	}
+	return (GFARM_ERR_INVALID_ARGUMENT);
+}
+
+gfarm_error_t
+gfarm_replica_placement_set_by_name(const char *name)
+{
+	int i;
+
+	for (i = 0; i < GFARM_ARRAY_LENGTH(gfarm_replica_placements); i++) {
+		if (strcmp(name, gfarm_replica_placements[i].name) == 0) {
+			gfarm_replica_placement =
+			    gfarm_replica_placements[i].policy;
+			gfarm_replica_placement_name =
+			    gfarm_replica_placements[i].name;
+			return (GFARM_ERR_NO_ERROR);
+		}
+	}
+	return (GFARM_ERR_INVALID_ARGUMENT);
+}
+
 /*
  * get (almost) shell style token.
  * e.g.
@@ -1847,6 +1937,52 @@ parse_known_network_arguments(char *p, char **op)
 	return (GFARM_ERR_NO_ERROR);
 }
 
+static gfarm_error_t
+parse_network_location_arguments(char *p, char **op)
+{
+	gfarm_error_t e;
+	char *tmp, *address, *location;
+	struct gfarm_hostspec *hostspecp;
+
+	/* assert(strcmp(*op, "network_location") == 0); */
+
+	e = gfarm_strtoken(&p, &address);
+	if (e != GFARM_ERR_NO_ERROR)
+		return (e);
+	if (address == NULL)
+		return (GFARM_ERRMSG_MISSING_ADDRESS_ARGUMENT);
+	e = gfarm_strtoken(&p, &location);
+	if (e != GFARM_ERR_NO_ERROR)
+		return (e);
+	if (location == NULL || location[0] != '/') {
+		*op = "2nd(location) argument";
+		return (GFARM_ERR_INVALID_ARGUMENT);
+	}
+	e = gfarm_strtoken(&p, &tmp);
+	if (e != GFARM_ERR_NO_ERROR)
+		return (e);
+	if (tmp != NULL)
+		return (GFARM_ERRMSG_TOO_MANY_ARGUMENTS);
+
+	e = gfarm_hostspec_parse(address, &hostspecp);
+	if (e != GFARM_ERR_NO_ERROR) {
+		/*
+		 * we don't return `host' to *op here,
+		 * because it may be too long.
+		 */
+		*op = "1st(address) argument";
+		return (e);
+	}
+
+	e = gfarm_network_location_add(hostspecp, location);
+	if (e != GFARM_ERR_NO_ERROR) {
+		*op = "1st(address) argument";
+		gfarm_hostspec_free(hostspecp);
+		return (e);
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
 static gfarm_error_t
 parse_stringlist(char *p, char **op,
 	gfarm_stringlist *list, const char *listname)
@@ -2336,6 +2472,32 @@ parse_atime_type(char *p)
 	return (GFARM_ERR_NO_ERROR);
 }
 
+static gfarm_error_t
+parse_replica_placement(char *p)
+{
+	gfarm_error_t e;
+	char *s;
+
+	e = get_one_argument(p, &s);
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+			"get_one_argument failed "
+			"when parsing replica_placement(%s): %s",
+			p, gfarm_error_string(e));
+		return (e);
+	}
+	/* first line has precedence */
+	if (gfarm_replica_placement != GFARM_REPLICA_PLACEMENT_DEFAULT)
+		return (GFARM_ERR_NO_ERROR);
+	e = gfarm_replica_placement_set_by_name(s);
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "replica_placement(%s): %s", s, gfarm_error_string(e));
+		return (e);
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
 static gfarm_error_t
 parse_hostname_and_port(char *host_and_port, const char *listname,
 	char **hostname, int *port)
@@ -2744,6 +2906,12 @@ parse_one_line(char *s, char *p, char **op)
 		    gfarm_auth_server_cred_name_set);
 	} else if (strcmp(s, o = "spool_check_level") == 0) {
 		e = parse_spool_check_level(p);
+	} else if (strcmp(s, o = "spool_check_parallel") == 0) {
+		e = parse_set_misc_int(p, &gfarm_spool_check_parallel);
+	} else if (strcmp(s, o = "spool_check_incremental") == 0) {
+		e = parse_set_misc_enabled(p, &gfarm_spool_check_incremental);
+	} else if (strcmp(s, o = "host_status_report_interval") == 0) {
+		e = parse_set_misc_int(p, &gfarm_host_status_report_interval);
 
 	} else if (strcmp(s, o = "metadb_server_host") == 0) {
 		e = parse_set_var(p, &gfarm_ctxp->metadb_server_name);
@@ -2850,6 +3018,8 @@ parse_one_line(char *s, char *p, char **op)
 #endif
 	} else if (strcmp(s, o = "known_network") == 0) {
 		e = parse_known_network_arguments(p, &o);
+	} else if (strcmp(s, o = "network_location") == 0) {
+		e = parse_network_location_arguments(p, &o);
 	} else if (strcmp(s, o = "xattr_cache") == 0) {
 		e = parse_stringlist(p, &o,
 		    &staticp->xattr_cache_list, "xattr cache");
@@ -2887,6 +3057,9 @@ parse_one_line(char *s, char *p, char **op)
 		e = parse_set_misc_int(p, &gfarm_ctxp->page_cache_timeout);
 	} else if (strcmp(s, o = "schedule_cache_timeout") == 0) {
 		e = parse_set_misc_int(p, &gfarm_ctxp->schedule_cache_timeout);
+	} else if (strcmp(s, o = "schedule_shared_cache_directory") == 0) {
+		e = parse_set_var(p,
+		    &gfarm_ctxp->schedule_shared_cache_directory);
 	} else if (strcmp(s, o = "schedule_concurrency") == 0) {
 		e = parse_set_misc_int(p, &gfarm_ctxp->schedule_concurrency);
 	} else if (strcmp(s, o = "schedule_concurrency_per_net") == 0) {
@@ -2916,6 +3089,12 @@ parse_one_line(char *s, char *p, char **op)
 	} else if (strcmp(s, o = "write_local_priority") == 0) {
 		e = parse_set_misc_enabled(p,
 		    &gfarm_ctxp->schedule_write_local_priority);
+	} else if (strcmp(s, o = "schedule_topology_aware") == 0) {
+		e = parse_set_misc_enabled(p,
+		    &gfarm_ctxp->schedule_topology_aware);
+	} else if (strcmp(s, o = "schedule_host_status") == 0) {
+		e = parse_set_misc_enabled(p,
+		    &gfarm_ctxp->schedule_host_status);
 	} else if (strcmp(s, o = "write_target_domain") == 0) {
 		e = parse_set_var(p, &gfarm_ctxp->schedule_write_target_domain);
 	} else if (strcmp(s, o = "minimum_free_disk_space") == 0) {
@@ -2926,6 +3105,8 @@ parse_one_line(char *s, char *p, char **op)
 #endif
 	} else if (strcmp(s, o = "gfs_proto_fhremove_request_window") == 0) {
 		e = parse_set_misc_int(p, &gfs_proto_fhremove_request_window);
+	} else if (strcmp(s, o = "gfs_proto_fhremove_batch_size") == 0) {
+		e = parse_set_misc_int(p, &gfs_proto_fhremove_batch_size);
 	} else if (strcmp(s, o = "gfs_proto_replication_request_window") == 0) {
 		e = parse_set_misc_int(p,
 		    &gfs_proto_replication_request_window);
@@ -2936,8 +3117,28 @@ parse_one_line(char *s, char *p, char **op)
 	} else if (strcmp(s, o = "outstanding_file_replication_limit") == 0) {
 		e = parse_set_misc_int(p,
 		    &gfarm_outstanding_file_replication_limit);
+	} else if (strcmp(s, o = "replication_source_window") == 0) {
+		e = parse_set_misc_int(p, &gfarm_replication_source_window);
+	} else if (strcmp(s, o = "replication_bandwidth_limit") == 0) {
+		e = parse_set_misc_offset(p,
+		    &gfarm_replication_bandwidth_limit);
+	} else if (strcmp(s, o = "replica_check_replication_ratio") == 0) {
+		e = parse_set_misc_int(p,
+		    &gfarm_replica_check_replication_ratio);
+		if (e == GFARM_ERR_NO_ERROR &&
+		    (gfarm_replica_check_replication_ratio <= 0 ||
+		     gfarm_replica_check_replication_ratio > 100)) {
+			e = GFARM_ERR_NUMERICAL_ARGUMENT_OUT_OF_DOMAIN;
+			gfarm_replica_check_replication_ratio =
+			    GFARM_CONFIG_MISC_DEFAULT;
+		}
+	} else if (strcmp(s, o = "replica_placement") == 0) {
+		e = parse_replica_placement(p);
 	} else if (strcmp(s, o = "gfsd_connection_cache") == 0) {
 		e = parse_set_misc_int(p, &gfarm_ctxp->gfsd_connection_cache);
+	} else if (strcmp(s, o = "gfsd_connection_pool_size") == 0) {
+		e = parse_set_misc_int(p,
+		    &gfarm_ctxp->gfsd_connection_pool_size);
 	} else if (strcmp(s, o = "gfmd_connection_cache") == 0) {
 		e = parse_set_misc_int(p, &gfarm_ctxp->gfmd_connection_cache);
 	} else if (strcmp(s, o = "xattr_size_limit") == 0) {
@@ -2966,6 +3167,14 @@ parse_one_line(char *s, char *p, char **op)
 		e = parse_set_misc_int(p, &gfarm_metadb_heartbeat_interval);
 	} else if (strcmp(s, o = "metadb_server_dbq_size") == 0) {
 		e = parse_set_misc_int(p, &gfarm_metadb_dbq_size);
+	} else if (strcmp(s, o = "metadb_server_inode_hugepage") == 0) {
+		e = parse_set_misc_enabled(p, &gfarm_metadb_inode_hugepage);
+	} else if (strcmp(s, o = "metadb_server_check_parallel") == 0) {
+		e = parse_set_misc_int(p, &gfarm_metadb_check_parallel);
+	} else if (strcmp(s, o = "metadb_server_check_after_clean_shutdown")
+	    == 0) {
+		e = parse_set_misc_enabled(p,
+		    &gfarm_metadb_check_after_clean_shutdown);
 	} else if (strcmp(s, o = "record_atime") == 0) {
 		int record_atime;
 
@@ -2981,6 +3190,13 @@ parse_one_line(char *s, char *p, char **op)
 		    &gfarm_ctxp->client_parallel_copy);
 	} else if (strcmp(s, o = "client_parallel_max") == 0) {
 		e = parse_set_misc_int(p, &gfarm_ctxp->client_parallel_max);
+	} else if (strcmp(s, o = "client_read_cache_directory") == 0) {
+		e = parse_set_var(p, &gfarm_ctxp->client_read_cache_directory);
+	} else if (strcmp(s, o = "client_read_cache_size") == 0) {
+		gfarm_off_t size = gfarm_ctxp->client_read_cache_size;
+
+		e = parse_set_misc_offset(p, &size);
+		gfarm_ctxp->client_read_cache_size = size;
 	} else if (strcmp(s, o = "profile") == 0) {
 		e = parse_profile(p, &staticp->profile);
 	} else if (strcmp(s, o = "iostat_gfmd_path") == 0) {
@@ -3175,6 +3391,15 @@ gfarm_config_set_default_misc(void)
 	if (gfarm_spool_check_level == GFARM_SPOOL_CHECK_LEVEL_DEFAULT)
 		(void)gfarm_spool_check_level_set(
 			GFARM_SPOOL_CHECK_LEVEL_LOST_FOUND);
+	if (gfarm_spool_check_parallel == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_spool_check_parallel =
+		    GFARM_SPOOL_CHECK_PARALLEL_DEFAULT;
+	if (gfarm_spool_check_incremental == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_spool_check_incremental =
+		    GFARM_SPOOL_CHECK_INCREMENTAL_DEFAULT;
+	if (gfarm_host_status_report_interval == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_host_status_report_interval =
+		    GFARM_HOST_STATUS_REPORT_INTERVAL_DEFAULT;
 
 	if (gfarm_spool_server_listen_backlog == GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_spool_server_listen_backlog = LISTEN_BACKLOG_DEFAULT;
@@ -3236,6 +3461,12 @@ gfarm_config_set_default_misc(void)
 	    GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_ctxp->schedule_write_local_priority =
 		    GFARM_SCHEDULE_WRITE_LOCAL_PRIORITY_DEFAULT;
+	if (gfarm_ctxp->schedule_topology_aware == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_ctxp->schedule_topology_aware =
+		    GFARM_SCHEDULE_TOPOLOGY_AWARE_DEFAULT;
+	if (gfarm_ctxp->schedule_host_status == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_ctxp->schedule_host_status =
+		    GFARM_SCHEDULE_HOST_STATUS_DEFAULT;
 	if (staticp->minimum_free_disk_space == GFARM_CONFIG_MISC_DEFAULT)
 		staticp->minimum_free_disk_space =
 		    GFARM_MINIMUM_FREE_DISK_SPACE_DEFAULT;
@@ -3247,6 +3478,9 @@ gfarm_config_set_default_misc(void)
 	if (gfs_proto_fhremove_request_window == GFARM_CONFIG_MISC_DEFAULT)
 		gfs_proto_fhremove_request_window =
 		    GFS_PROTO_FHREMOVE_REQUEST_WINDOW_DEFAULT;
+	if (gfs_proto_fhremove_batch_size == GFARM_CONFIG_MISC_DEFAULT)
+		gfs_proto_fhremove_batch_size =
+		    GFS_PROTO_FHREMOVE_BATCH_SIZE_DEFAULT;
 	if (gfs_proto_replication_request_window == GFARM_CONFIG_MISC_DEFAULT)
 		gfs_proto_replication_request_window =
 		    GFS_PROTO_REPLICATION_REQUEST_WINDOW_DEFAULT;
@@ -3254,9 +3488,21 @@ gfarm_config_set_default_misc(void)
 	    GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_outstanding_file_replication_limit =
 		    GFARM_OUTSTANDING_FILE_REPLICATION_LIMIT_DEFAULT;
+	if (gfarm_replication_source_window == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_replication_source_window =
+		    GFARM_REPLICATION_SOURCE_WINDOW_DEFAULT;
+	if (gfarm_replication_bandwidth_limit == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_replication_bandwidth_limit =
+		    GFARM_REPLICATION_BANDWIDTH_LIMIT_DEFAULT;
+	if (gfarm_replica_check_replication_ratio == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_replica_check_replication_ratio =
+		    GFARM_REPLICA_CHECK_REPLICATION_RATIO_DEFAULT;
 	if (gfarm_ctxp->gfsd_connection_cache == GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_ctxp->gfsd_connection_cache =
 		    GFARM_GFSD_CONNECTION_CACHE_DEFAULT;
+	if (gfarm_ctxp->gfsd_connection_pool_size == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_ctxp->gfsd_connection_pool_size =
+		    GFARM_GFSD_CONNECTION_POOL_SIZE_DEFAULT;
 	if (gfarm_ctxp->gfmd_connection_cache == GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_ctxp->gfmd_connection_cache =
 		    GFARM_GFMD_CONNECTION_CACHE_DEFAULT;
@@ -3280,8 +3526,21 @@ gfarm_config_set_default_misc(void)
 		    GFARM_METADB_HEARTBEAT_INTERVAL_DEFAULT;
 	if (gfarm_metadb_dbq_size == GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_metadb_dbq_size = GFARM_METADB_DBQ_SIZE_DEFAULT;
+	if (gfarm_metadb_inode_hugepage == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_metadb_inode_hugepage =
+		    GFARM_METADB_INODE_HUGEPAGE_DEFAULT;
+	if (gfarm_metadb_check_parallel == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_metadb_check_parallel =
+		    GFARM_METADB_CHECK_PARALLEL_DEFAULT;
+	if (gfarm_metadb_check_after_clean_shutdown ==
+	    GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_metadb_check_after_clean_shutdown =
+		    GFARM_METADB_CHECK_AFTER_CLEAN_SHUTDOWN_DEFAULT;
 	if (gfarm_atime_type == GFARM_ATIME_DEFAULT)
 		(void)gfarm_atime_type_set(GFARM_ATIME_RELATIVE);
+	if (gfarm_replica_placement == GFARM_REPLICA_PLACEMENT_DEFAULT)
+		(void)gfarm_replica_placement_set(
+		    GFARM_REPLICA_PLACEMENT_TWO_CHOICES);
 	if (gfarm_ctxp->client_file_bufsize == GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_ctxp->client_file_bufsize =
 		    GFARM_CLIENT_FILE_BUFSIZE_DEFAULT;
@@ -3291,6 +3550,9 @@ gfarm_config_set_default_misc(void)
 	if (gfarm_ctxp->client_parallel_max == GFARM_CONFIG_MISC_DEFAULT)
 		gfarm_ctxp->client_parallel_max =
 		    GFARM_CLIENT_PARALLEL_MAX_DEFAULT;
+	if (gfarm_ctxp->client_read_cache_size == GFARM_CONFIG_MISC_DEFAULT)
+		gfarm_ctxp->client_read_cache_size =
+		    GFARM_CLIENT_READ_CACHE_SIZE_DEFAULT;
 	if (staticp->profile == GFARM_CONFIG_MISC_DEFAULT)
 		staticp->profile = GFARM_PROFILE_DEFAULT;
 	if (metadb_replication_enabled == GFARM_CONFIG_MISC_DEFAULT)
@@ -31,6 +31,17 @@ const char *gfarm_atime_type_get_by_name(void);
 gfarm_error_t gfarm_atime_type_set(enum gfarm_atime_type);
 gfarm_error_t gfarm_atime_type_set_by_name(const char *);
 
+enum gfarm_replica_placement {
+	GFARM_REPLICA_PLACEMENT_DEFAULT,
+	GFARM_REPLICA_PLACEMENT_RANDOM,
+	GFARM_REPLICA_PLACEMENT_WEIGHTED,
+	GFARM_REPLICA_PLACEMENT_TWO_CHOICES,
+};
+enum gfarm_replica_placement gfarm_replica_placement_get(void);
+const char *gfarm_replica_placement_get_by_name(void);
+gfarm_error_t gfarm_replica_placement_set(enum gfarm_replica_placement);
+gfarm_error_t gfarm_replica_placement_set_by_name(const char *);
+
 enum gfarm_backend_db_type {
 	GFARM_BACKEND_DB_TYPE_UNKNOWN,
 	GFARM_BACKEND_DB_TYPE_LDAP,
@@ -48,17 +59,27 @@ extern int gfarm_metadb_thread_pool_size;
 extern int gfarm_metadb_job_queue_length;
 extern int gfarm_metadb_heartbeat_interval;
 extern int gfarm_metadb_dbq_size;
+extern int gfarm_metadb_inode_hugepage;
+extern int gfarm_metadb_check_parallel;
+extern int gfarm_metadb_check_after_clean_shutdown;
 #ifdef not_def_REPLY_QUEUE
 extern int gfm_proto_reply_to_gfsd_window;
 #endif
 extern int gfs_proto_fhremove_request_window;
+extern int gfs_proto_fhremove_batch_size;
 extern int gfs_proto_replication_request_window;
 extern int gfarm_outstanding_file_replication_limit;
+extern int gfarm_replication_source_window;
+extern gfarm_off_t gfarm_replication_bandwidth_limit;
+extern int gfarm_replica_check_replication_ratio;
 extern int gfarm_relatime;
 extern int gfarm_replica_check;
 extern int gfarm_replica_check_host_down_thresh;
 extern int gfarm_replica_check_sleep_time;
 extern int gfarm_replica_check_minimum_interval;
+extern int gfarm_spool_check_parallel;
+extern int gfarm_spool_check_incremental;
+extern int gfarm_host_status_report_interval;
 #define GFARM_METADB_STACK_SIZE_DEFAULT 0 /* use OS default */
 #define GFARM_METADB_THREAD_POOL_SIZE_DEFAULT	16  /* quadcore, quadsocket */
 #if 0
@@ -68,6 +89,9 @@ extern int gfarm_replica_check_minimum_interval;
 #endif
 #define GFARM_METADB_HEARTBEAT_INTERVAL_DEFAULT 180 /* 3 min */
 #define GFARM_METADB_DBQ_SIZE_DEFAULT	65536
+#define GFARM_METADB_INODE_HUGEPAGE_DEFAULT	0 /* disable */
+#define GFARM_METADB_CHECK_PARALLEL_DEFAULT	8
+#define GFARM_METADB_CHECK_AFTER_CLEAN_SHUTDOWN_DEFAULT 1 /* enable */
 #define GFARM_SYMLINK_LEVEL_MAX			20
 
 /* LDAP dependent */
@@ -104,6 +128,8 @@ gfarm_error_t gfarm_get_global_username_by_host_for_connection_cache(
 	const char *, int, char **);
 
 int gfarm_schedule_write_local_priority(void);
+int gfarm_schedule_topology_aware(void);
+int gfarm_schedule_host_status(void);
 char *gfarm_schedule_write_target_domain(void);
 gfarm_off_t gfarm_get_minimum_free_disk_space(void);
 const char *gfarm_config_get_argv0(void);
@@ -44,6 +44,9 @@ struct gfp_cached_connection {
 
 	struct gfarm_hash_entry *hash_entry;
 
+	/* next connection to the same (host, port, user) in the pool */
+	struct gfp_cached_connection *pool_next;
+
 	struct gfp_conn_hash_id id;
 
 	void *connection_data;
@@ -55,7 +58,7 @@ struct gfp_cached_connection {
 void
 gfp_conn_cache_init(struct gfp_conn_cache *c,
 	gfarm_error_t (*dispose)(void *), const char *type_name,
-	int table_size, int *num_cachep)
+	int table_size, int *num_cachep, int *pool_sizep)
 {
 	assert(c != NULL);
 
@@ -65,6 +68,7 @@ gfp_conn_cache_init(struct gfp_conn_cache *c,
 	c->type_name = type_name;
 	c->table_size = table_size;
 	c->num_cachep = num_cachep;
+	c->pool_sizep = pool_sizep;
 	gfarm_mutex_init(&c->mutex, "gfp_conn_cache_init", "conn_cache");
 }
 
@@ -83,6 +87,61 @@ gfp_conn_cache_term(struct gfp_conn_cache *c)
 
 static const char diag_what[] =	"connection cache";
 
+static int
+gfp_conn_cache_pool_size(struct gfp_conn_cache *cache)
+{
+	if (cache->pool_sizep == NULL || *cache->pool_sizep < 1)
+		return (1);
+	return (*cache->pool_sizep);
+}
+
+#define POOL_HEAD(entry) \
+	(*(struct gfp_cached_connection **)gfarm_hash_entry_data(entry))
+
+/*
+ * unlink the connection from the pool of its hash entry,
+ * and purge the hash entry if the pool becomes empty.
+ * cache->mutex must be locked.
+ */
+static void
+gfp_conn_pool_unlink(struct gfp_conn_cache *cache,
+	struct gfp_cached_connection *connection)
+{
+	struct gfarm_hash_entry *entry = connection->hash_entry;
+	struct gfp_cached_connection **pp, *head;
+	struct gfp_conn_hash_id *kidp;
+
+	for (pp = &POOL_HEAD(entry); *pp != NULL; pp = &(*pp)->pool_next) {
+		if (*pp == connection) {
+			*pp = connection->pool_next;
+			break;
+		}
+	}
+	connection->pool_next = NULL;
+	connection->hash_entry = NULL; /* this is an uncached connection now */
+
+	head = POOL_HEAD(entry);
+	if (head == NULL) {
+		gfp_conn_hash_purge(cache->hashtab, entry);
+		return;
+	}
+	/* the key refers to the strings of a connection in the pool */
+	kidp = (struct gfp_conn_hash_id *)gfarm_hash_entry_key(entry);
+	kidp->hostname = head->id.hostname;
+	kidp->username = head->id.username;
+}
+
+static int
+gfp_conn_pool_count(struct gfarm_hash_entry *entry)
+{
+	struct gfp_cached_connection *c;
+	int n = 0;
+
+	for (c = POOL_HEAD(entry); c != NULL; c = c->pool_next)
+		n++;
+	return (n);
+}
+
 int
 gfp_is_cached_connection(struct gfp_cached_connection *connection)
 {
@@ -182,6 +241,7 @@ gfp_uncached_connection_new(const char *hostname, int port,
 	}
 
 	connection->hash_entry = NULL; /* this is an uncached connection */
+	connection->pool_next = NULL;
 	idp = &connection->id;
 	idp->hostname = strdup(hostname);
 	idp->username = strdup(username);
@@ -234,10 +294,8 @@ gfp_cached_connection_purge_from_cache(struct gfp_conn_cache *cache,
 	gfarm_mutex_lock(&cache->mutex, diag, diag_what);
 	gfarm_lru_cache_purge_entry(&connection->lru_entry);
 
-	gfp_conn_hash_purge(cache->hashtab, connection->hash_entry);
+	gfp_conn_pool_unlink(cache, connection);
 	gfarm_mutex_unlock(&cache->mutex, diag, diag_what);
-
-	connection->hash_entry = NULL; /* this is an uncached connection now */
 }
 
 /* convert from uncached connection to cached */
@@ -271,7 +329,8 @@ gfp_uncached_connection_into_cache(struct gfp_conn_cache *cache,
 			gfarm_error_string(e));
 		return (e);
 	}
-	if (!created) {
+	if (!created &&
+	    gfp_conn_pool_count(entry) >= gfp_conn_cache_pool_size(cache)) {
 		gfarm_mutex_unlock(&cache->mutex, diag, diag_what);
 
 		gflog_debug(GFARM_MSG_1001089,
@@ -284,8 +343,8 @@ gfp_uncached_connection_into_cache(struct gfp_conn_cache *cache,
 
 	func(&cache->lru_list, &connection->lru_entry);
 
-	*(struct gfp_cached_connection **)gfarm_hash_entry_data(entry)
-	    = connection;
+	connection->pool_next = created ? NULL : POOL_HEAD(entry);
+	POOL_HEAD(entry) = connection;
 	connection->hash_entry = entry;
 
 	gfarm_mutex_unlock(&cache->mutex, diag, diag_what);
@@ -330,7 +389,7 @@ gfp_cached_connection_gc_entry(struct gfarm_lru_entry *entry, void *closure)
 	static const char diag[] = "gfp_cached_connection_gc_entry";
 
 	gfarm_mutex_lock(&cache->mutex, diag, diag_what);
-	gfp_conn_hash_purge(cache->hashtab, connection->hash_entry);
+	gfp_conn_pool_unlink(cache, connection);
 	gfarm_mutex_unlock(&cache->mutex, diag, diag_what);
 
 	/*
@@ -373,6 +432,69 @@ gfp_connection_cache_change(struct gfp_conn_cache *cache, int cnt)
 	return (cnt);
 }
 
+/*
+ * allocate a new connection, and add it to the pool of the hash entry.
+ * cache->mutex must be locked.
+ */
+static gfarm_error_t
+gfp_cached_connection_pool_add(struct gfp_conn_cache *cache,
+	struct gfarm_hash_entry *entry, int created,
+	const char *canonical_hostname, int port, const char *user,
+	struct gfp_cached_connection **connectionp)
+{
+	gfarm_error_t e;
+	struct gfp_cached_connection *connection;
+	struct gfp_conn_hash_id *idp, *kidp;
+
+	GFARM_MALLOC(connection);
+	if (connection == NULL) {
+		gflog_debug(GFARM_MSG_1001091,
+			"allocation of 'connection' failed: %s",
+			gfarm_error_string(GFARM_ERR_NO_MEMORY));
+		return (GFARM_ERR_NO_MEMORY);
+	}
+
+	idp = &connection->id;
+	idp->hostname = strdup(canonical_hostname);
+	idp->port = port;
+	idp->username = strdup(user);
+	if (idp->hostname == NULL || idp->username == NULL) {
+		e = GFARM_ERR_NO_MEMORY;
+		gflog_debug(GFARM_MSG_1002566,
+		    "gfp_cached_connection_acquire (%s)(%d)"
+		    " failed: %s",
+		    canonical_hostname, port,
+		    gfarm_error_string(e));
+		free(idp->hostname);
+		free(idp->username);
+		free(connection);
+		return (e);
+	}
+	if (created) {
+		kidp = (struct gfp_conn_hash_id *)gfarm_hash_entry_key(entry);
+		kidp->hostname = idp->hostname;
+		kidp->username = idp->username;
+		connection->pool_next = NULL;
+	} else
+		connection->pool_next = POOL_HEAD(entry);
+
+	gfarm_lru_cache_add_entry(&cache->lru_list,
+	    &connection->lru_entry);
+
+	POOL_HEAD(entry) = connection;
+	connection->hash_entry = entry;
+	connection->connection_data = NULL;
+	connection->dispose_connection_data = NULL;
+	GFSP_CONN_INIT(connection)
+	*connectionp = connection;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/*
+ * an idle connection in the pool is preferred.
+ * if there is none, a new connection is added to the pool
+ * unless the pool is full, otherwise the least shared one is used.
+ */
 gfarm_error_t
 gfp_cached_connection_acquire(struct gfp_conn_cache *cache,
 	const char *canonical_hostname, int port, const char *user,
@@ -380,14 +502,14 @@ gfp_cached_connection_acquire(struct gfp_conn_cache *cache,
 {
 	gfarm_error_t e;
 	struct gfarm_hash_entry *entry;
-	struct gfp_cached_connection *connection;
-	struct gfp_conn_hash_id *idp, *kidp;
+	struct gfp_cached_connection *connection, *c;
+	int created, n;
 	static const char diag[] = "gfp_cached_connection_acquire";
 
 	gfarm_mutex_lock(&cache->mutex, diag, diag_what);
 	e = gfp_conn_hash_enter_noalloc(&cache->hashtab, cache->table_size,
 	    sizeof(connection), canonical_hostname, port, user,
-	    &entry, createdp);
+	    &entry, &created);
 	if (e != GFARM_ERR_NO_ERROR) {
 		gfarm_mutex_unlock(&cache->mutex, diag, diag_what);
 		gflog_debug(GFARM_MSG_1001090,
@@ -396,53 +518,31 @@ gfp_cached_connection_acquire(struct gfp_conn_cache *cache,
 			gfarm_error_string(e));
 		return (e);
 	}
-	if (!*createdp) {
-		connection = *(struct gfp_cached_connection **)
-		    gfarm_hash_entry_data(entry);
+	connection = NULL;
+	n = 0;
+	if (!created) {
+		for (c = POOL_HEAD(entry); c != NULL; c = c->pool_next) {
+			if (connection == NULL || c->lru_entry.acquired <
+			    connection->lru_entry.acquired)
+				connection = c;
+			n++;
+		}
+	}
+	if (connection != NULL && (connection->lru_entry.acquired == 0 ||
+	    n >= gfp_conn_cache_pool_size(cache))) {
 		gfarm_lru_cache_addref_entry(&cache->lru_list,
 		    &connection->lru_entry);
+		*createdp = 0;
 	} else {
-		GFARM_MALLOC(connection);
-		if (connection == NULL) {
-			gfp_conn_hash_purge(cache->hashtab, entry);
-			gfarm_mutex_unlock(&cache->mutex, diag, diag_what);
-			gflog_debug(GFARM_MSG_1001091,
-				"allocation of 'connection' failed: %s",
-				gfarm_error_string(GFARM_ERR_NO_MEMORY));
-			return (GFARM_ERR_NO_MEMORY);
-		}
-
-		idp = &connection->id;
-		idp->hostname = strdup(canonical_hostname);
-		idp->port = port;
-		idp->username = strdup(user);
-		if (idp->hostname == NULL || idp->username == NULL) {
-			e = GFARM_ERR_NO_MEMORY;
-			gflog_debug(GFARM_MSG_1002566,
-			    "gfp_cached_connection_acquire (%s)(%d)"
-			    " failed: %s",
-			    canonical_hostname, port,
-			    gfarm_error_string(e));
-			free(idp->hostname);
-			free(idp->username);
-			free(connection);
-			gfp_conn_hash_purge(cache->hashtab, entry);
+		e = gfp_cached_connection_pool_add(cache, entry, created,
+		    canonical_hostname, port, user, &connection);
+		if (e != GFARM_ERR_NO_ERROR) {
+			if (created)
+				gfp_conn_hash_purge(cache->hashtab, entry);
 			gfarm_mutex_unlock(&cache->mutex, diag, diag_what);
 			return (e);
 		}
-		kidp = (struct gfp_conn_hash_id *)gfarm_hash_entry_key(entry);
-		kidp->hostname = idp->hostname;
-		kidp->username = idp->username;
-
-		gfarm_lru_cache_add_entry(&cache->lru_list,
-		    &connection->lru_entry);
-
-		*(struct gfp_cached_connection **)gfarm_hash_entry_data(entry)
-		    = connection;
-		connection->hash_entry = entry;
-		connection->connection_data = NULL;
-		connection->dispose_connection_data = NULL;
-		GFSP_CONN_INIT(connection)
+		*createdp = 1;
 	}
 	gfarm_mutex_unlock(&cache->mutex, diag, diag_what);
 	*connectionp = connection;
@@ -508,12 +608,11 @@ gfp_cached_connection_terminate(struct gfp_conn_cache *cache)
 	for (gfarm_hash_iterator_begin(cache->hashtab, &it);
 	     !gfarm_hash_iterator_is_end(&it);) {
 		entry = gfarm_hash_iterator_access(&it);
-		connection = *(struct gfp_cached_connection **)
-		    gfarm_hash_entry_data(entry);
+		connection = POOL_HEAD(entry);
 
 		gfarm_lru_cache_purge_entry(&connection->lru_entry);
 
-		gfp_conn_hash_iterator_purge(&it);
+		gfp_conn_pool_unlink(cache, connection);
 
 		gfarm_mutex_unlock(&cache->mutex, diag, diag_what);
 		(*cache->dispose_connection)(connection->connection_data);
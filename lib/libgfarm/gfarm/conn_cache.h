@@ -18,23 +18,24 @@ struct gfp_conn_cache {
 	const char *type_name;
 	int table_size;
 	int *num_cachep;
+	int *pool_sizep; /* connections per (host, port, user), NULL: 1 */
 
 	pthread_mutex_t mutex;
 };
 
 /* The `dispose' function below must call gfp_uncached_connection_dispose() */
 #define GFP_CONN_CACHE_INITIALIZER(var, dispose, \
-	   type_name, table_size, num_cachep) \
+	   type_name, table_size, num_cachep, pool_sizep) \
 	{ \
 		GFARM_LRU_CACHE_INITIALIZER(var.lru_list), \
 		NULL, \
 		dispose, \
-		type_name, table_size, num_cachep, \
+		type_name, table_size, num_cachep, pool_sizep, \
 		GFARM_MUTEX_INITIALIZER(var.mutex) \
 	}
 
 void gfp_conn_cache_init(struct gfp_conn_cache *,
-	gfarm_error_t (*)(void *), const char *, int, int *);
+	gfarm_error_t (*)(void *), const char *, int, int *, int *);
 void gfp_conn_cache_term(struct gfp_conn_cache *);
 
 int gfp_is_cached_connection(struct gfp_cached_connection *);
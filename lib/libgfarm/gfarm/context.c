@@ -86,6 +86,10 @@ static const struct gfarm_context_module_entry module_entries[] = {
 		gfarm_iostat_static_init,
 		gfarm_iostat_static_term
 	},
+	{
+		gfarm_gfs_pio_cache_static_init,
+		gfarm_gfs_pio_cache_static_term
+	},
 #endif /* __KERNEL__ */
 	{
 		gfarm_filesystem_static_init,
@@ -127,12 +131,18 @@ gfarm_context_init(void)
 	ctxp->schedule_rtt_thresh_ratio = GFARM_CONFIG_MISC_DEFAULT;
 	ctxp->schedule_rtt_thresh_diff = GFARM_CONFIG_MISC_DEFAULT;
 	ctxp->schedule_write_target_domain = NULL;
+	ctxp->schedule_shared_cache_directory = NULL;
 	ctxp->schedule_write_local_priority = GFARM_CONFIG_MISC_DEFAULT;
+	ctxp->schedule_topology_aware = GFARM_CONFIG_MISC_DEFAULT;
+	ctxp->schedule_host_status = GFARM_CONFIG_MISC_DEFAULT;
 	ctxp->gfsd_connection_cache = GFARM_CONFIG_MISC_DEFAULT;
+	ctxp->gfsd_connection_pool_size = GFARM_CONFIG_MISC_DEFAULT;
 	ctxp->gfmd_connection_cache = GFARM_CONFIG_MISC_DEFAULT;
 	ctxp->client_file_bufsize = GFARM_CONFIG_MISC_DEFAULT;
 	ctxp->client_parallel_copy = GFARM_CONFIG_MISC_DEFAULT;
 	ctxp->client_parallel_max = GFARM_CONFIG_MISC_DEFAULT;
+	ctxp->client_read_cache_directory = NULL;
+	ctxp->client_read_cache_size = GFARM_CONFIG_MISC_DEFAULT;
 	ctxp->network_receive_timeout = GFARM_CONFIG_MISC_DEFAULT;
 	ctxp->file_trace = GFARM_CONFIG_MISC_DEFAULT;
 	ctxp->on_demand_replication = 0;
@@ -171,6 +181,8 @@ gfarm_context_term(void)
 	free(gfarm_ctxp->metadb_admin_user);
 	free(gfarm_ctxp->metadb_admin_user_gsi_dn);
 	free(gfarm_ctxp->schedule_write_target_domain);
+	free(gfarm_ctxp->schedule_shared_cache_directory);
+	free(gfarm_ctxp->client_read_cache_directory);
 	free(gfarm_ctxp);
 
 	gfarm_ctxp = NULL;
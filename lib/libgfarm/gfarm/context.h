@@ -23,11 +23,17 @@ struct gfarm_context {
 	int schedule_rtt_thresh_diff;
 	char *schedule_write_target_domain;
 	int schedule_write_local_priority;
+	int schedule_topology_aware;
+	int schedule_host_status;
+	char *schedule_shared_cache_directory;
 	int gfmd_connection_cache;
 	int gfsd_connection_cache;
+	int gfsd_connection_pool_size;
 	int client_file_bufsize;
 	int client_parallel_copy;
 	int client_parallel_max;
+	char *client_read_cache_directory;
+	long long client_read_cache_size;
 	int on_demand_replication;
 	int call_rpc_instead_syscall;
 	int network_receive_timeout;
@@ -55,6 +61,7 @@ struct gfarm_context {
 	struct gfarm_schedule_static *schedule_static;
 	struct gfarm_gfs_pio_static *gfs_pio_static;
 	struct gfarm_gfs_pio_section_static *gfs_pio_section_static;
+	struct gfarm_gfs_pio_cache_static *gfs_pio_cache_static;
 	struct gfarm_gfs_stat_static *gfs_stat_static;
 	struct gfarm_gfs_unlink_static *gfs_unlink_static;
 	struct gfarm_gfs_xattr_static *gfs_xattr_static;
@@ -108,6 +115,9 @@ void          gfarm_gfs_pio_static_term(struct gfarm_context *);
 gfarm_error_t gfarm_gfs_pio_section_static_init(struct gfarm_context *);
 void          gfarm_gfs_pio_section_static_term(struct gfarm_context *);
 
+gfarm_error_t gfarm_gfs_pio_cache_static_init(struct gfarm_context *);
+void          gfarm_gfs_pio_cache_static_term(struct gfarm_context *);
+
 gfarm_error_t gfarm_gfs_stat_static_init(struct gfarm_context *);
 void          gfarm_gfs_stat_static_term(struct gfarm_context *);
 
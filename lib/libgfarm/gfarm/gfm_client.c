@@ -93,7 +93,8 @@ gfm_client_static_init(struct gfarm_context *ctxp)
 		gfm_client_connection_dispose,
 		"gfm_connection",
 		SERVER_HASHTAB_SIZE,
-		&ctxp->gfmd_connection_cache);
+		&ctxp->gfmd_connection_cache,
+		NULL);
 
 	ctxp->gfm_client_static = s;
 	return (GFARM_ERR_NO_ERROR);
@@ -1019,6 +1020,25 @@ gfm_client_xdr_recv(struct gfm_connection *gfm_server,
 	return (e);
 }
 
+/* see gfp_xdr_recv_stat() for the arguments */
+static gfarm_error_t
+gfm_client_xdr_recv_stat(struct gfm_connection *gfm_server,
+	size_t *sizep, size_t name_size, size_t *name_lenp, char *name,
+	struct gfs_stat *st)
+{
+	gfarm_error_t e;
+
+	e = gfp_xdr_recv_stat(gfm_server->conn, 0, 1, sizep,
+	    name_size, name_lenp, name, st);
+
+	check_connection_or_purge(gfm_server, e);
+
+	if (e != GFARM_ERR_NO_ERROR)
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "gfp_xdr_recv_stat: %s", gfarm_error_string(e));
+	return (e);
+}
+
 static gfarm_error_t
 gfm_client_vrpc_raw_request_begin(struct gfm_connection *gfm_server,
 	struct gfp_xdr_xid_record **xidrp, int *size_posp,
@@ -2702,13 +2722,17 @@ gfarm_error_t
 gfm_client_fstat_result(struct gfm_connection *gfm_server,
 	struct gfp_xdr_context *ctx, struct gfs_stat *st)
 {
-	return (gfm_client_rpc_result(gfm_server, ctx, "llilsslllilili",
-	    &st->st_ino, &st->st_gen, &st->st_mode, &st->st_nlink,
-	    &st->st_user, &st->st_group, &st->st_size,
-	    &st->st_ncopy,
-	    &st->st_atimespec.tv_sec, &st->st_atimespec.tv_nsec,
-	    &st->st_mtimespec.tv_sec, &st->st_mtimespec.tv_nsec,
-	    &st->st_ctimespec.tv_sec, &st->st_ctimespec.tv_nsec));
+	gfarm_error_t e;
+	size_t size;
+
+	e = gfm_client_rpc_result_begin(gfm_server, ctx, &size, "");
+	if (e != GFARM_ERR_NO_ERROR)
+		return (e);
+	/* "llilsslllilili" */
+	if ((e = gfm_client_xdr_recv_stat(gfm_server, &size, 0, NULL, NULL,
+	    st)) != GFARM_ERR_NO_ERROR)
+		return (e);
+	return (gfm_client_rpc_result_end(gfm_server, ctx, size));
 }
 
 gfarm_error_t
@@ -2942,6 +2966,20 @@ gfm_client_get_schedule_result(struct gfm_connection *gfm_server,
 		}
 		/* loadavg_1min * GFM_PROTO_LOADAVG_FSCALE */
 		infos[i].loadavg = loadavg;
+
+		/* only GFM_PROTO_SCHEDULE_FILE_WITH_STATUS sets this flag */
+		if ((infos[i].flags & GFM_PROTO_SCHED_FLAG_STATUS_AVAIL) == 0)
+			continue;
+		e = gfm_client_xdr_recv(gfm_server, &size, "iiill",
+		    &infos[i].nclients, &infos[i].queue_depth,
+		    &infos[i].status_age,
+		    &infos[i].read_rate, &infos[i].write_rate);
+		if (e != GFARM_ERR_NO_ERROR) {
+			gflog_debug(GFARM_MSG_UNFIXED,
+				"receiving host status response failed: %s",
+				gfarm_error_string(e));
+			return (e); /* XXX memory leak */
+		}
 	}
 	if ((e = gfm_client_rpc_result_end(gfm_server, ctx, size)) !=
 	    GFARM_ERR_NO_ERROR) {
@@ -2960,8 +2998,14 @@ gfarm_error_t
 gfm_client_schedule_file_request(struct gfm_connection *gfm_server,
 	struct gfp_xdr_context *ctx, const char *domain)
 {
+	/*
+	 * GFM_PROTO_SCHEDULE_FILE_WITH_STATUS is not supported by old gfmd,
+	 * which breaks the connection, thus, it has to be enabled explicitly.
+	 */
 	return (gfm_client_rpc_request(gfm_server, ctx,
-	    GFM_PROTO_SCHEDULE_FILE, "s", domain));
+	    gfarm_schedule_host_status() ?
+	    GFM_PROTO_SCHEDULE_FILE_WITH_STATUS : GFM_PROTO_SCHEDULE_FILE,
+	    "s", domain));
 }
 
 gfarm_error_t
@@ -3030,6 +3074,131 @@ gfm_client_statfs(struct gfm_connection *gfm_server,
 		    GFM_PROTO_STATFS, "/lll", used, avail, files));
 }
 
+static gfarm_error_t
+gfm_client_rpc_stat_get_n(struct gfm_connection *gfm_server,
+	size_t *sizep, int n, struct gfm_rpc_stat *stats)
+{
+	gfarm_error_t e;
+	struct gfm_rpc_stat_histogram *h;
+	gfarm_int32_t nbuckets, bucket;
+	gfarm_uint64_t count;
+	int i, j, k;
+
+	memset(stats, 0, sizeof(*stats) * n);
+	for (i = 0; i < n; i++) {
+		e = gfm_client_xdr_recv(gfm_server, sizep, "il",
+		    &stats[i].request, &stats[i].count);
+		for (j = 0; e == GFARM_ERR_NO_ERROR &&
+		    j < GFM_PROTO_RPC_STAT_NPHASES; j++) {
+			h = &stats[i].phases[j];
+			e = gfm_client_xdr_recv(gfm_server, sizep, "lli",
+			    &h->total, &h->max, &nbuckets);
+			for (k = 0; e == GFARM_ERR_NO_ERROR && k < nbuckets;
+			    k++) {
+				e = gfm_client_xdr_recv(gfm_server, sizep,
+				    "il", &bucket, &count);
+				if (e == GFARM_ERR_NO_ERROR && bucket >= 0 &&
+				    bucket < GFM_PROTO_RPC_STAT_NBUCKETS)
+					h->buckets[bucket] = count;
+			}
+		}
+		if (e != GFARM_ERR_NO_ERROR) {
+			gflog_debug(GFARM_MSG_UNFIXED,
+			    "gfm_client_xdr_recv() failed: %s",
+			    gfarm_error_string(e));
+			return (e);
+		}
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/* called by gftool/gfstatus */
+gfarm_error_t
+gfm_client_rpc_stat_get(struct gfm_connection *gfm_server,
+	int *np, struct gfm_rpc_stat **statsp)
+{
+	gfarm_error_t e, e2;
+	struct gfp_xdr_xid_record *xidr;
+	size_t size;
+	gfarm_int32_t n;
+	struct gfm_rpc_stat *stats = NULL;
+
+	if ((e = gfm_client_rpc_request_and_result_begin(gfm_server,
+	    &xidr, &size, GFM_PROTO_RPC_STAT_GET,
+	    "/i", &n)) != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "gfm_client_rpc() failed: %s",
+		    gfarm_error_string(e));
+		return (e);
+	}
+	if (n > 0) {
+		GFARM_MALLOC_ARRAY(stats, n);
+		if (stats == NULL)
+			e = GFARM_ERR_NO_MEMORY;
+		else
+			e = gfm_client_rpc_stat_get_n(gfm_server, &size,
+			    n, stats);
+	}
+	e2 = gfm_client_rpc_raw_result_end(gfm_server, xidr, size);
+	if (e == GFARM_ERR_NO_ERROR)
+		e = e2;
+	if (e != GFARM_ERR_NO_ERROR) {
+		free(stats);
+		return (e);
+	}
+	*np = n;
+	*statsp = stats;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/* called by gftool/gfstatus */
+gfarm_error_t
+gfm_client_memory_stat_get(struct gfm_connection *gfm_server,
+	int *np, char ***namesp, gfarm_uint64_t **valuesp)
+{
+	gfarm_error_t e, e2;
+	struct gfp_xdr_xid_record *xidr;
+	size_t size;
+	gfarm_int32_t n;
+	char **names = NULL;
+	gfarm_uint64_t *values = NULL;
+	int i = 0;
+
+	if ((e = gfm_client_rpc_request_and_result_begin(gfm_server,
+	    &xidr, &size, GFM_PROTO_MEMORY_STAT_GET,
+	    "/i", &n)) != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "gfm_client_rpc() failed: %s",
+		    gfarm_error_string(e));
+		return (e);
+	}
+	if (n > 0) {
+		GFARM_MALLOC_ARRAY(names, n);
+		GFARM_MALLOC_ARRAY(values, n);
+		if (names == NULL || values == NULL)
+			e = GFARM_ERR_NO_MEMORY;
+		for (; e == GFARM_ERR_NO_ERROR && i < n; i++) {
+			e = gfm_client_xdr_recv(gfm_server, &size, "sl",
+			    &names[i], &values[i]);
+			if (e != GFARM_ERR_NO_ERROR)
+				break;
+		}
+	}
+	e2 = gfm_client_rpc_raw_result_end(gfm_server, xidr, size);
+	if (e == GFARM_ERR_NO_ERROR)
+		e = e2;
+	if (e != GFARM_ERR_NO_ERROR) {
+		if (names != NULL)
+			gfarm_strings_free_deeply(i, names);
+		free(values);
+		return (e);
+	}
+	*np = n;
+	*namesp = names;
+	*valuesp = values;
+	return (GFARM_ERR_NO_ERROR);
+}
+
 gfarm_error_t
 gfm_client_remove_request(struct gfm_connection *gfm_server,
 	struct gfp_xdr_context *ctx, const char *name)
@@ -3154,6 +3323,22 @@ gfm_client_getdirpath_result(struct gfm_connection *gfm_server,
 	return (gfm_client_rpc_result(gfm_server, ctx, "s", pathp));
 }
 
+gfarm_error_t
+gfm_client_dir_usage_get_request(struct gfm_connection *gfm_server,
+	struct gfp_xdr_context *ctx)
+{
+	return (gfm_client_rpc_request(gfm_server, ctx,
+	    GFM_PROTO_DIR_USAGE_GET, ""));
+}
+
+gfarm_error_t
+gfm_client_dir_usage_get_result(struct gfm_connection *gfm_server,
+	struct gfp_xdr_context *ctx, struct gfs_dir_usage *usage)
+{
+	return (gfm_client_rpc_result(gfm_server, ctx, "llll",
+	    &usage->space, &usage->num, &usage->phy_space, &usage->phy_num));
+}
+
 gfarm_error_t
 gfm_client_getdirents_request(struct gfm_connection *gfm_server,
 	struct gfp_xdr_context *ctx, gfarm_int32_t n_entries)
@@ -3239,14 +3424,9 @@ gfm_client_getdirentsplus_result(struct gfm_connection *gfm_server,
 	for (i = 0; i < n; i++) {
 		struct gfs_stat *st = &stv[i];
 
-		e = gfm_client_xdr_recv(gfm_server, &size, "bllilsslllilili",
-		    sizeof(dirents[i].d_name) - 1, &sz, dirents[i].d_name,
-		    &st->st_ino, &st->st_gen, &st->st_mode, &st->st_nlink,
-		    &st->st_user, &st->st_group, &st->st_size,
-		    &st->st_ncopy,
-		    &st->st_atimespec.tv_sec, &st->st_atimespec.tv_nsec,
-		    &st->st_mtimespec.tv_sec, &st->st_mtimespec.tv_nsec,
-		    &st->st_ctimespec.tv_sec, &st->st_ctimespec.tv_nsec);
+		/* "bllilsslllilili" */
+		e = gfm_client_xdr_recv_stat(gfm_server, &size,
+		    sizeof(dirents[i].d_name) - 1, &sz, dirents[i].d_name, st);
 		/* XXX st_user or st_group may be NULL */
 		if (e != GFARM_ERR_NO_ERROR) {
 			/* XXX memory leak */
@@ -25,6 +25,12 @@ struct gfarm_host_sched_info {
 	gfarm_uint32_t rtt_usec;
 
 	gfarm_uint32_t flags;			/* GFM_PROTO_SCHED_FLAG_* */
+
+	/* if GFM_PROTO_SCHED_FLAG_STATUS_AVAIL */
+	gfarm_int32_t nclients;
+	gfarm_int32_t queue_depth;
+	gfarm_int32_t status_age;	/* msec. since the last status report */
+	gfarm_uint64_t read_rate, write_rate;	/* bytes per second */
 };
 void gfarm_host_sched_info_free(int, struct gfarm_host_sched_info *);
 
@@ -316,6 +322,10 @@ gfarm_error_t gfm_client_getdirpath_request(struct gfm_connection *,
 	struct gfp_xdr_context *);
 gfarm_error_t gfm_client_getdirpath_result(struct gfm_connection *,
 	struct gfp_xdr_context *, char **);
+gfarm_error_t gfm_client_dir_usage_get_request(struct gfm_connection *,
+	struct gfp_xdr_context *);
+gfarm_error_t gfm_client_dir_usage_get_result(struct gfm_connection *,
+	struct gfp_xdr_context *, struct gfs_dir_usage *);
 gfarm_error_t gfm_client_getdirents_request(struct gfm_connection *,
 	struct gfp_xdr_context *, gfarm_int32_t);
 gfarm_error_t gfm_client_getdirents_result(struct gfm_connection *,
@@ -337,6 +347,11 @@ gfarm_error_t gfm_client_seek_result(struct gfm_connection *,
 	struct gfp_xdr_context *, gfarm_off_t *);
 gfarm_error_t gfm_client_statfs(struct gfm_connection *,
 	gfarm_off_t *, gfarm_off_t *, gfarm_off_t *);
+struct gfm_rpc_stat;
+gfarm_error_t gfm_client_rpc_stat_get(struct gfm_connection *,
+	int *, struct gfm_rpc_stat **);
+gfarm_error_t gfm_client_memory_stat_get(struct gfm_connection *,
+	int *, char ***, gfarm_uint64_t **);
 
 gfarm_error_t gfm_client_setxattr_request(struct gfm_connection *,
 	struct gfp_xdr_context *,
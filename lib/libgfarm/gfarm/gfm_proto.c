@@ -0,0 +1,338 @@
+#include <stddef.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfm_proto.h"
+
+/*
+ * Not really public interface,
+ * but common routine called from both client and server.
+ */
+
+/* GFM_PROTO_RPC_STAT_GET histogram */
+
+#define SUBBUCKETS	(1 << GFM_PROTO_RPC_STAT_SUBBUCKET_BITS)
+
+int
+gfm_proto_rpc_stat_bucket(gfarm_uint64_t usec)
+{
+	int msb = 0, b;
+
+	if (usec < SUBBUCKETS)
+		return ((int)usec);
+	for (b = 32; b > 0; b /= 2) {
+		if (usec >= ((gfarm_uint64_t)1 << (msb + b)))
+			msb += b;
+	}
+	b = (msb - GFM_PROTO_RPC_STAT_SUBBUCKET_BITS + 1) * SUBBUCKETS +
+	    (int)((usec >> (msb - GFM_PROTO_RPC_STAT_SUBBUCKET_BITS)) &
+	    (SUBBUCKETS - 1));
+	return (b < GFM_PROTO_RPC_STAT_NBUCKETS ?
+	    b : GFM_PROTO_RPC_STAT_NBUCKETS - 1);
+}
+
+gfarm_uint64_t
+gfm_proto_rpc_stat_bucket_lower_bound(int bucket)
+{
+	int shift = bucket / SUBBUCKETS - 1;
+
+	if (bucket < SUBBUCKETS)
+		return (bucket);
+	return ((gfarm_uint64_t)(SUBBUCKETS + bucket % SUBBUCKETS) << shift);
+}
+
+/* GFM_PROTO_HOST_STATUS_REPORT, GFS_PROTO_STATUS2 */
+
+static unsigned char *
+host_status_put32(unsigned char *p, gfarm_uint32_t v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+	return (p + 4);
+}
+
+static unsigned char *
+host_status_put64(unsigned char *p, gfarm_uint64_t v)
+{
+	p = host_status_put32(p, (gfarm_uint32_t)(v >> 32));
+	return (host_status_put32(p, (gfarm_uint32_t)v));
+}
+
+static const unsigned char *
+host_status_get32(const unsigned char *p, gfarm_uint32_t *vp)
+{
+	*vp = ((gfarm_uint32_t)p[0] << 24) | ((gfarm_uint32_t)p[1] << 16) |
+	    ((gfarm_uint32_t)p[2] << 8) | p[3];
+	return (p + 4);
+}
+
+static const unsigned char *
+host_status_get64(const unsigned char *p, gfarm_uint64_t *vp)
+{
+	gfarm_uint32_t hi, lo;
+
+	p = host_status_get32(p, &hi);
+	p = host_status_get32(p, &lo);
+	*vp = ((gfarm_uint64_t)hi << 32) | lo;
+	return (p);
+}
+
+#define LOADAVG_TO_FIXED(l) \
+	((gfarm_uint32_t)((l) * GFM_PROTO_LOADAVG_FSCALE))
+#define LOADAVG_FROM_FIXED(v) \
+	((double)(v) / GFM_PROTO_LOADAVG_FSCALE)
+
+/*
+ * the buffer must have GFM_PROTO_HOST_STATUS_SIZE_MAX bytes at least.
+ * returns the encoded size.
+ */
+size_t
+gfm_proto_host_status_encode(gfarm_int32_t mask,
+	const struct gfm_host_status *st, unsigned char *buf)
+{
+	unsigned char *p = buf;
+
+	mask &= GFM_PROTO_HOST_STATUS_ALL;
+	p = host_status_put32(p, mask);
+	if (mask & GFM_PROTO_HOST_STATUS_LOADAVG) {
+		p = host_status_put32(p, LOADAVG_TO_FIXED(st->loadavg_1min));
+		p = host_status_put32(p, LOADAVG_TO_FIXED(st->loadavg_5min));
+		p = host_status_put32(p, LOADAVG_TO_FIXED(st->loadavg_15min));
+	}
+	if (mask & GFM_PROTO_HOST_STATUS_DISK) {
+		p = host_status_put64(p, st->disk_used);
+		p = host_status_put64(p, st->disk_avail);
+	}
+	if (mask & GFM_PROTO_HOST_STATUS_NCLIENTS)
+		p = host_status_put32(p, st->nclients);
+	if (mask & GFM_PROTO_HOST_STATUS_QUEUE)
+		p = host_status_put32(p, st->queue_depth);
+	if (mask & GFM_PROTO_HOST_STATUS_IO_RATE) {
+		p = host_status_put64(p, st->read_rate);
+		p = host_status_put64(p, st->write_rate);
+	}
+	return (p - buf);
+}
+
+/* only the fields specified by *maskp are stored to *st */
+gfarm_error_t
+gfm_proto_host_status_decode(const unsigned char *buf, size_t size,
+	gfarm_int32_t *maskp, struct gfm_host_status *st)
+{
+	const unsigned char *p = buf;
+	gfarm_uint32_t mask, v1, v5, v15;
+	gfarm_uint64_t used, avail;
+	size_t needed = 4;
+
+	if (size < needed)
+		return (GFARM_ERR_PROTOCOL);
+	p = host_status_get32(p, &mask);
+	if (mask & ~GFM_PROTO_HOST_STATUS_ALL)
+		return (GFARM_ERR_PROTOCOL);
+	if (mask & GFM_PROTO_HOST_STATUS_LOADAVG)
+		needed += 3 * 4;
+	if (mask & GFM_PROTO_HOST_STATUS_DISK)
+		needed += 2 * 8;
+	if (mask & GFM_PROTO_HOST_STATUS_NCLIENTS)
+		needed += 4;
+	if (mask & GFM_PROTO_HOST_STATUS_QUEUE)
+		needed += 4;
+	if (mask & GFM_PROTO_HOST_STATUS_IO_RATE)
+		needed += 2 * 8;
+	if (size != needed)
+		return (GFARM_ERR_PROTOCOL);
+
+	if (mask & GFM_PROTO_HOST_STATUS_LOADAVG) {
+		p = host_status_get32(p, &v1);
+		p = host_status_get32(p, &v5);
+		p = host_status_get32(p, &v15);
+		st->loadavg_1min = LOADAVG_FROM_FIXED(v1);
+		st->loadavg_5min = LOADAVG_FROM_FIXED(v5);
+		st->loadavg_15min = LOADAVG_FROM_FIXED(v15);
+	}
+	if (mask & GFM_PROTO_HOST_STATUS_DISK) {
+		p = host_status_get64(p, &used);
+		p = host_status_get64(p, &avail);
+		st->disk_used = used;
+		st->disk_avail = avail;
+	}
+	if (mask & GFM_PROTO_HOST_STATUS_NCLIENTS) {
+		p = host_status_get32(p, &v1);
+		st->nclients = v1;
+	}
+	if (mask & GFM_PROTO_HOST_STATUS_QUEUE) {
+		p = host_status_get32(p, &v1);
+		st->queue_depth = v1;
+	}
+	if (mask & GFM_PROTO_HOST_STATUS_IO_RATE) {
+		p = host_status_get64(p, &st->read_rate);
+		p = host_status_get64(p, &st->write_rate);
+	}
+	*maskp = mask;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static const struct {
+	gfarm_int32_t command;
+	const char *name;
+} gfm_proto_command_names[] = {
+	{ GFM_PROTO_HOST_INFO_GET_ALL, "HOST_INFO_GET_ALL" },
+	{ GFM_PROTO_HOST_INFO_GET_BY_ARCHITECTURE, "HOST_INFO_GET_BY_ARCHITECTURE" },
+	{ GFM_PROTO_HOST_INFO_GET_BY_NAMES, "HOST_INFO_GET_BY_NAMES" },
+	{ GFM_PROTO_HOST_INFO_GET_BY_NAMEALIASES, "HOST_INFO_GET_BY_NAMEALIASES" },
+	{ GFM_PROTO_HOST_INFO_SET, "HOST_INFO_SET" },
+	{ GFM_PROTO_HOST_INFO_MODIFY, "HOST_INFO_MODIFY" },
+	{ GFM_PROTO_HOST_INFO_REMOVE, "HOST_INFO_REMOVE" },
+	{ GFM_PROTO_FSNGROUP_GET_ALL, "FSNGROUP_GET_ALL" },
+	{ GFM_PROTO_FSNGROUP_GET_BY_HOSTNAME, "FSNGROUP_GET_BY_HOSTNAME" },
+	{ GFM_PROTO_FSNGROUP_MODIFY, "FSNGROUP_MODIFY" },
+	{ GFM_PROTO_HOST_STATUS_REPORT, "HOST_STATUS_REPORT" },
+	{ GFM_PROTO_USER_INFO_GET_ALL, "USER_INFO_GET_ALL" },
+	{ GFM_PROTO_USER_INFO_GET_BY_NAMES, "USER_INFO_GET_BY_NAMES" },
+	{ GFM_PROTO_USER_INFO_SET, "USER_INFO_SET" },
+	{ GFM_PROTO_USER_INFO_MODIFY, "USER_INFO_MODIFY" },
+	{ GFM_PROTO_USER_INFO_REMOVE, "USER_INFO_REMOVE" },
+	{ GFM_PROTO_USER_INFO_GET_BY_GSI_DN, "USER_INFO_GET_BY_GSI_DN" },
+	{ GFM_PROTO_GROUP_INFO_GET_ALL, "GROUP_INFO_GET_ALL" },
+	{ GFM_PROTO_GROUP_INFO_GET_BY_NAMES, "GROUP_INFO_GET_BY_NAMES" },
+	{ GFM_PROTO_GROUP_INFO_SET, "GROUP_INFO_SET" },
+	{ GFM_PROTO_GROUP_INFO_MODIFY, "GROUP_INFO_MODIFY" },
+	{ GFM_PROTO_GROUP_INFO_REMOVE, "GROUP_INFO_REMOVE" },
+	{ GFM_PROTO_GROUP_INFO_ADD_USERS, "GROUP_INFO_ADD_USERS" },
+	{ GFM_PROTO_GROUP_INFO_REMOVE_USERS, "GROUP_INFO_REMOVE_USERS" },
+	{ GFM_PROTO_GROUP_NAMES_GET_BY_USERS, "GROUP_NAMES_GET_BY_USERS" },
+	{ GFM_PROTO_QUOTA_USER_GET, "QUOTA_USER_GET" },
+	{ GFM_PROTO_QUOTA_USER_SET, "QUOTA_USER_SET" },
+	{ GFM_PROTO_QUOTA_GROUP_GET, "QUOTA_GROUP_GET" },
+	{ GFM_PROTO_QUOTA_GROUP_SET, "QUOTA_GROUP_SET" },
+	{ GFM_PROTO_QUOTA_CHECK, "QUOTA_CHECK" },
+	{ GFM_PROTO_COMPOUND_BEGIN, "COMPOUND_BEGIN" },
+	{ GFM_PROTO_COMPOUND_END, "COMPOUND_END" },
+	{ GFM_PROTO_COMPOUND_ON_ERROR, "COMPOUND_ON_ERROR" },
+	{ GFM_PROTO_PUT_FD, "PUT_FD" },
+	{ GFM_PROTO_GET_FD, "GET_FD" },
+	{ GFM_PROTO_SAVE_FD, "SAVE_FD" },
+	{ GFM_PROTO_RESTORE_FD, "RESTORE_FD" },
+	{ GFM_PROTO_BEQUEATH_FD, "BEQUEATH_FD" },
+	{ GFM_PROTO_INHERIT_FD, "INHERIT_FD" },
+	{ GFM_PROTO_OPEN_ROOT, "OPEN_ROOT" },
+	{ GFM_PROTO_OPEN_PARENT, "OPEN_PARENT" },
+	{ GFM_PROTO_OPEN, "OPEN" },
+	{ GFM_PROTO_CREATE, "CREATE" },
+	{ GFM_PROTO_CLOSE, "CLOSE" },
+	{ GFM_PROTO_VERIFY_TYPE, "VERIFY_TYPE" },
+	{ GFM_PROTO_VERIFY_TYPE_NOT, "VERIFY_TYPE_NOT" },
+	{ GFM_PROTO_REVOKE_GFSD_ACCESS, "REVOKE_GFSD_ACCESS" },
+	{ GFM_PROTO_OPEN_DIR, "OPEN_DIR" },
+	{ GFM_PROTO_FHOPEN, "FHOPEN" },
+	{ GFM_PROTO_FSTAT, "FSTAT" },
+	{ GFM_PROTO_FUTIMES, "FUTIMES" },
+	{ GFM_PROTO_FCHMOD, "FCHMOD" },
+	{ GFM_PROTO_FCHOWN, "FCHOWN" },
+	{ GFM_PROTO_CKSUM_GET, "CKSUM_GET" },
+	{ GFM_PROTO_CKSUM_SET, "CKSUM_SET" },
+	{ GFM_PROTO_SCHEDULE_FILE, "SCHEDULE_FILE" },
+	{ GFM_PROTO_SCHEDULE_FILE_WITH_PROGRAM, "SCHEDULE_FILE_WITH_PROGRAM" },
+	{ GFM_PROTO_SCHEDULE_FILE_WITH_STATUS, "SCHEDULE_FILE_WITH_STATUS" },
+	{ GFM_PROTO_FGETATTRPLUS, "FGETATTRPLUS" },
+	{ GFM_PROTO_REMOVE, "REMOVE" },
+	{ GFM_PROTO_RENAME, "RENAME" },
+	{ GFM_PROTO_FLINK, "FLINK" },
+	{ GFM_PROTO_MKDIR, "MKDIR" },
+	{ GFM_PROTO_SYMLINK, "SYMLINK" },
+	{ GFM_PROTO_READLINK, "READLINK" },
+	{ GFM_PROTO_GETDIRPATH, "GETDIRPATH" },
+	{ GFM_PROTO_GETDIRENTS, "GETDIRENTS" },
+	{ GFM_PROTO_SEEK, "SEEK" },
+	{ GFM_PROTO_GETDIRENTSPLUS, "GETDIRENTSPLUS" },
+	{ GFM_PROTO_GETDIRENTSPLUSXATTR, "GETDIRENTSPLUSXATTR" },
+	{ GFM_PROTO_DIR_USAGE_GET, "DIR_USAGE_GET" },
+	{ GFM_PROTO_REOPEN, "REOPEN" },
+	{ GFM_PROTO_CLOSE_READ, "CLOSE_READ" },
+	{ GFM_PROTO_CLOSE_WRITE, "CLOSE_WRITE" },
+	{ GFM_PROTO_LOCK, "LOCK" },
+	{ GFM_PROTO_TRYLOCK, "TRYLOCK" },
+	{ GFM_PROTO_UNLOCK, "UNLOCK" },
+	{ GFM_PROTO_LOCK_INFO, "LOCK_INFO" },
+	{ GFM_PROTO_SWITCH_ASYNC_BACK_CHANNEL, "SWITCH_ASYNC_BACK_CHANNEL" },
+	{ GFM_PROTO_CLOSE_WRITE_V2_4, "CLOSE_WRITE_V2_4" },
+	{ GFM_PROTO_GENERATION_UPDATED, "GENERATION_UPDATED" },
+	{ GFM_PROTO_FHCLOSE_READ, "FHCLOSE_READ" },
+	{ GFM_PROTO_FHCLOSE_WRITE, "FHCLOSE_WRITE" },
+	{ GFM_PROTO_GENERATION_UPDATED_BY_COOKIE, "GENERATION_UPDATED_BY_COOKIE" },
+	{ GFM_PROTO_GLOB, "GLOB" },
+	{ GFM_PROTO_SCHEDULE, "SCHEDULE" },
+	{ GFM_PROTO_PIO_OPEN, "PIO_OPEN" },
+	{ GFM_PROTO_PIO_SET_PATHS, "PIO_SET_PATHS" },
+	{ GFM_PROTO_PIO_CLOSE, "PIO_CLOSE" },
+	{ GFM_PROTO_PIO_VISIT, "PIO_VISIT" },
+	{ GFM_PROTO_HOSTNAME_SET, "HOSTNAME_SET" },
+	{ GFM_PROTO_SCHEDULE_HOST_DOMAIN, "SCHEDULE_HOST_DOMAIN" },
+	{ GFM_PROTO_STATFS, "STATFS" },
+	{ GFM_PROTO_RPC_STAT_GET, "RPC_STAT_GET" },
+	{ GFM_PROTO_MEMORY_STAT_GET, "MEMORY_STAT_GET" },
+	{ GFM_PROTO_REPLICA_LIST_BY_NAME, "REPLICA_LIST_BY_NAME" },
+	{ GFM_PROTO_REPLICA_LIST_BY_HOST, "REPLICA_LIST_BY_HOST" },
+	{ GFM_PROTO_REPLICA_REMOVE_BY_HOST, "REPLICA_REMOVE_BY_HOST" },
+	{ GFM_PROTO_REPLICA_REMOVE_BY_FILE, "REPLICA_REMOVE_BY_FILE" },
+	{ GFM_PROTO_REPLICA_INFO_GET, "REPLICA_INFO_GET" },
+	{ GFM_PROTO_REPLICATE_FILE_FROM_TO, "REPLICATE_FILE_FROM_TO" },
+	{ GFM_PROTO_REPLICATE_FILE_TO, "REPLICATE_FILE_TO" },
+	{ GFM_PROTO_REPLICA_ADDING, "REPLICA_ADDING" },
+	{ GFM_PROTO_REPLICA_ADDED, "REPLICA_ADDED" },
+	{ GFM_PROTO_REPLICA_LOST, "REPLICA_LOST" },
+	{ GFM_PROTO_REPLICA_ADD, "REPLICA_ADD" },
+	{ GFM_PROTO_REPLICA_ADDED2, "REPLICA_ADDED2" },
+	{ GFM_PROTO_REPLICATION_RESULT, "REPLICATION_RESULT" },
+	{ GFM_PROTO_REPLICA_GET_MY_ENTRIES, "REPLICA_GET_MY_ENTRIES" },
+	{ GFM_PROTO_REPLICA_CREATE_FILE_IN_LOST_FOUND, "REPLICA_CREATE_FILE_IN_LOST_FOUND" },
+	{ GFM_PROTO_REPLICA_GET_MY_ENTRIES2, "REPLICA_GET_MY_ENTRIES2" },
+	{ GFM_PROTO_PROCESS_ALLOC, "PROCESS_ALLOC" },
+	{ GFM_PROTO_PROCESS_ALLOC_CHILD, "PROCESS_ALLOC_CHILD" },
+	{ GFM_PROTO_PROCESS_FREE, "PROCESS_FREE" },
+	{ GFM_PROTO_PROCESS_SET, "PROCESS_SET" },
+	{ GFJ_PROTO_LOCK_REGISTER, "GFJ_PROTO_LOCK_REGISTER" },
+	{ GFJ_PROTO_UNLOCK_REGISTER, "GFJ_PROTO_UNLOCK_REGISTER" },
+	{ GFJ_PROTO_REGISTER, "GFJ_PROTO_REGISTER" },
+	{ GFJ_PROTO_UNREGISTER, "GFJ_PROTO_UNREGISTER" },
+	{ GFJ_PROTO_REGISTER_NODE, "GFJ_PROTO_REGISTER_NODE" },
+	{ GFJ_PROTO_LIST, "GFJ_PROTO_LIST" },
+	{ GFJ_PROTO_INFO, "GFJ_PROTO_INFO" },
+	{ GFJ_PROTO_HOSTINFO, "GFJ_PROTO_HOSTINFO" },
+	{ GFM_PROTO_XATTR_SET, "XATTR_SET" },
+	{ GFM_PROTO_XMLATTR_SET, "XMLATTR_SET" },
+	{ GFM_PROTO_XATTR_GET, "XATTR_GET" },
+	{ GFM_PROTO_XMLATTR_GET, "XMLATTR_GET" },
+	{ GFM_PROTO_XATTR_REMOVE, "XATTR_REMOVE" },
+	{ GFM_PROTO_XMLATTR_REMOVE, "XMLATTR_REMOVE" },
+	{ GFM_PROTO_XATTR_LIST, "XATTR_LIST" },
+	{ GFM_PROTO_XMLATTR_LIST, "XMLATTR_LIST" },
+	{ GFM_PROTO_XMLATTR_FIND, "XMLATTR_FIND" },
+	{ GFM_PROTO_SWITCH_GFMD_CHANNEL, "SWITCH_GFMD_CHANNEL" },
+	{ GFM_PROTO_JOURNAL_READY_TO_RECV, "JOURNAL_READY_TO_RECV" },
+	{ GFM_PROTO_JOURNAL_SEND, "JOURNAL_SEND" },
+	{ GFM_PROTO_REMOTE_PEER_ALLOC, "REMOTE_PEER_ALLOC" },
+	{ GFM_PROTO_REMOTE_PEER_FREE, "REMOTE_PEER_FREE" },
+	{ GFM_PROTO_REMOTE_RPC, "REMOTE_RPC" },
+	{ GFM_PROTO_REMOTE_GFS_RPC, "REMOTE_GFS_RPC" },
+	{ GFM_PROTO_REMOTE_PEER_DISCONNECT, "REMOTE_PEER_DISCONNECT" },
+	{ GFM_PROTO_METADB_SERVER_GET, "METADB_SERVER_GET" },
+	{ GFM_PROTO_METADB_SERVER_GET_ALL, "METADB_SERVER_GET_ALL" },
+	{ GFM_PROTO_METADB_SERVER_SET, "METADB_SERVER_SET" },
+	{ GFM_PROTO_METADB_SERVER_MODIFY, "METADB_SERVER_MODIFY" },
+	{ GFM_PROTO_METADB_SERVER_REMOVE, "METADB_SERVER_REMOVE" },
+};
+
+const char *
+gfm_proto_command_name(gfarm_int32_t command)
+{
+	int i;
+
+	for (i = 0; i < GFARM_ARRAY_LENGTH(gfm_proto_command_names); i++) {
+		if (gfm_proto_command_names[i].command == command)
+			return (gfm_proto_command_names[i].name);
+	}
+	return (NULL);
+}
@@ -17,7 +17,7 @@ enum gfm_proto_command {
 	GFM_PROTO_FSNGROUP_GET_ALL,
 	GFM_PROTO_FSNGROUP_GET_BY_HOSTNAME,
 	GFM_PROTO_FSNGROUP_MODIFY,
-	GFM_PROTO_HOST_INFO_RESERVE10,
+	GFM_PROTO_HOST_STATUS_REPORT,		/* from gfsd via back channel */
 	GFM_PROTO_HOST_INFO_RESERVE11,
 	GFM_PROTO_HOST_INFO_RESERVE12,
 	GFM_PROTO_HOST_INFO_RESERVE13,
@@ -120,7 +120,7 @@ enum gfm_proto_command {
 	GFM_PROTO_SCHEDULE_FILE,
 	GFM_PROTO_SCHEDULE_FILE_WITH_PROGRAM,
 	GFM_PROTO_FGETATTRPLUS,
-	GFM_PROTO_FD_OP_RESERVE9,
+	GFM_PROTO_SCHEDULE_FILE_WITH_STATUS,
 	GFM_PROTO_FD_OP_RESERVE10,
 	GFM_PROTO_FD_OP_RESERVE11,
 	GFM_PROTO_FD_OP_RESERVE12,
@@ -139,7 +139,7 @@ enum gfm_proto_command {
 	GFM_PROTO_SEEK,
 	GFM_PROTO_GETDIRENTSPLUS,
 	GFM_PROTO_GETDIRENTSPLUSXATTR,
-	GFM_PROTO_DIR_OP_RESERVE11,
+	GFM_PROTO_DIR_USAGE_GET,
 	GFM_PROTO_DIR_OP_RESERVE12,
 	GFM_PROTO_DIR_OP_RESERVE13,
 	GFM_PROTO_DIR_OP_RESERVE14,
@@ -203,8 +203,8 @@ enum gfm_proto_command {
 	GFM_PROTO_HOSTNAME_SET,
 	GFM_PROTO_SCHEDULE_HOST_DOMAIN,
 	GFM_PROTO_STATFS,
-	GFM_PROTO_MISC_RESERVE3,
-	GFM_PROTO_MISC_RESERVE4,
+	GFM_PROTO_RPC_STAT_GET,
+	GFM_PROTO_MEMORY_STAT_GET,
 	GFM_PROTO_MISC_RESERVE5,
 	GFM_PROTO_MISC_RESERVE6,
 	GFM_PROTO_MISC_RESERVE7,
@@ -408,8 +408,35 @@ enum gfm_proto_command {
 #define GFM_PROTO_SCHED_FLAG_HOST_AVAIL		1 /* always TRUE for now */
 #define GFM_PROTO_SCHED_FLAG_LOADAVG_AVAIL	2 /* always TRUE for now */
 #define GFM_PROTO_SCHED_FLAG_RTT_AVAIL		4 /* always FALSE for now */
+#define GFM_PROTO_SCHED_FLAG_STATUS_AVAIL	8 /* WITH_STATUS only */
 #define GFM_PROTO_LOADAVG_FSCALE 		2048
 
+/*
+ * GFM_PROTO_HOST_STATUS_REPORT, GFS_PROTO_STATUS2:
+ * status of a filesystem node, only the fields specified by the mask
+ * are encoded by gfm_proto_host_status_encode().
+ */
+#define GFM_PROTO_HOST_STATUS_LOADAVG	1 /* loadavg_{1,5,15}min */
+#define GFM_PROTO_HOST_STATUS_DISK	2 /* disk_used, disk_avail */
+#define GFM_PROTO_HOST_STATUS_NCLIENTS	4
+#define GFM_PROTO_HOST_STATUS_QUEUE	8
+#define GFM_PROTO_HOST_STATUS_IO_RATE	16 /* read_rate, write_rate */
+#define GFM_PROTO_HOST_STATUS_ALL	31
+#define GFM_PROTO_HOST_STATUS_SIZE_MAX	56
+
+struct gfm_host_status {
+	double loadavg_1min, loadavg_5min, loadavg_15min;
+	gfarm_int64_t disk_used, disk_avail;	/* KiB */
+	gfarm_int32_t nclients;			/* client connections */
+	gfarm_int32_t queue_depth;		/* replications in progress */
+	gfarm_uint64_t read_rate, write_rate;	/* bytes per second */
+};
+
+size_t gfm_proto_host_status_encode(gfarm_int32_t,
+	const struct gfm_host_status *, unsigned char *);
+gfarm_error_t gfm_proto_host_status_decode(const unsigned char *, size_t,
+	gfarm_int32_t *, struct gfm_host_status *);
+
 /* output of GFM_PROTO_CLOSE_WRITE_V2_4 */
 #define	GFM_PROTO_CLOSE_WRITE_GENERATION_UPDATE_NEEDED	1
 
@@ -439,6 +466,49 @@ enum gfm_proto_command {
 /* Special sequence number, never used in the protocol. */
 #define GFARM_METADB_SERVER_SEQNUM_INVALID		0
 
+/*
+ * output of GFM_PROTO_RPC_STAT_GET: latency histograms of each request.
+ * a bucket has 4 sub-buckets per a power of two microseconds,
+ * i.e. the relative error of a bucket is less than 25%.
+ */
+#define GFM_PROTO_RPC_STAT_QUEUE	0 /* wait in the thread pool queue */
+#define GFM_PROTO_RPC_STAT_LOCK		1 /* wait for giant_lock */
+#define GFM_PROTO_RPC_STAT_DBQ		2 /* wait to enqueue DB updates */
+#define GFM_PROTO_RPC_STAT_TOTAL	3 /* whole processing of the request */
+#define GFM_PROTO_RPC_STAT_NPHASES	4
+#define GFM_PROTO_RPC_STAT_SUBBUCKET_BITS	2
+#define GFM_PROTO_RPC_STAT_NBUCKETS	108 /* up to 2^28 microseconds */
+
+struct gfm_rpc_stat {
+	gfarm_int32_t request;
+	gfarm_uint64_t count;
+	struct gfm_rpc_stat_histogram {
+		gfarm_uint64_t total, max; /* microseconds */
+		gfarm_uint64_t buckets[GFM_PROTO_RPC_STAT_NBUCKETS];
+	} phases[GFM_PROTO_RPC_STAT_NPHASES];
+};
+
+/*
+ * output of GFM_PROTO_MEMORY_STAT_GET: pairs of a name and a value.
+ * a client should ignore unknown names.
+ */
+#define GFM_PROTO_MEMORY_STAT_INODES		"inodes"
+#define GFM_PROTO_MEMORY_STAT_INODE_SLOTS	"inode_slots"
+#define GFM_PROTO_MEMORY_STAT_INODE_TABLE_BYTES	"inode_table_bytes"
+#define GFM_PROTO_MEMORY_STAT_INODE_BYTES	"inode_bytes"
+#define GFM_PROTO_MEMORY_STAT_FILE_COPIES	"file_copies"
+#define GFM_PROTO_MEMORY_STAT_FILE_COPY_BYTES	"file_copy_bytes"
+#define GFM_PROTO_MEMORY_STAT_MAX		6 /* except the followings */
+/* for each connection class, e.g. "metadata_buffer_bytes" */
+#define GFM_PROTO_MEMORY_STAT_CONNECTIONS_FMT	"%s_connections"
+#define GFM_PROTO_MEMORY_STAT_BUFFER_BYTES_FMT	"%s_buffer_bytes"
+#define GFM_PROTO_MEMORY_STAT_BUFFER_MAX_BYTES_FMT "%s_buffer_max_bytes"
+#define GFM_PROTO_MEMORY_STAT_NAME_MAX		64
+
+int gfm_proto_rpc_stat_bucket(gfarm_uint64_t);
+gfarm_uint64_t gfm_proto_rpc_stat_bucket_lower_bound(int);
+const char *gfm_proto_command_name(gfarm_int32_t);
+
 /* GFM_PROTO_REMOTE_PEER_ALLOC */
 #define GFARM_PROTO_FAMILY_IPV4				1
 #define GFARM_PROTO_FAMILY_IPV6				2
@@ -446,7 +516,7 @@ enum gfm_proto_command {
 
 #define GFMD_USERNAME	"_gfarmmd"
 
-#if 0 /* There isn't gfm_proto.c for now. */
+#if 0 /* gfm_proto.c doesn't define this for now. */
 extern char GFM_SERVICE_TAG[];
 #else
 #define GFM_SERVICE_TAG "gfarm-metadata"
@@ -1,3 +1,4 @@
+#include <pthread.h>
 #include <assert.h>
 #include <stdio.h>
 #include <errno.h>
@@ -14,8 +15,10 @@
 #include <gfarm/gflog.h>
 #include <gfarm/error.h>
 #include <gfarm/gfarm_misc.h>
+#include <gfarm/gfs.h>
 
 #include "gfutil.h" /* gflog_fatal() */
+#include "thrsubr.h"
 
 #include "liberror.h"
 #include "iobuffer.h"
@@ -37,6 +40,29 @@
 
 #define GFP_XDR_BUFSIZE	16384
 
+/*
+ * buffer sizes and policies of each connection class.
+ * note that large 'b' data bypasses the buffers anyway.
+ */
+static const struct gfp_xdr_profile {
+	const char *name;
+	int bufsize;
+	int shrink_when_idle; /* release the buffers by gfp_xdr_shrink() */
+} gfp_xdr_profiles[GFP_XDR_NPROFILES] = {
+	/* gfmd has thousands of mostly idle client connections */
+	{ "metadata",		GFP_XDR_BUFSIZE,	1 },
+	/* fewer system calls for a stream of file data and replicas */
+	{ "bulk",		65536,			0 },
+	/* always busy with asynchronous requests */
+	{ "back_channel",	GFP_XDR_BUFSIZE,	0 },
+};
+
+/*
+ * memory used by the buffers of each connection class.
+ * updated atomically, because every allocation of a buffer updates this.
+ */
+static struct gfp_xdr_profile_stat gfp_xdr_profile_stats[GFP_XDR_NPROFILES];
+
 struct gfp_xdr {
 	struct gfarm_iobuffer *recvbuffer;
 	struct gfarm_iobuffer *sendbuffer;
@@ -45,6 +71,9 @@ struct gfp_xdr {
 	void *cookie;
 	int fd;
 
+	int profile;
+	gfarm_int64_t alloc_size; /* of recvbuffer and sendbuffer */
+
 	/* XXX currently used by client only, but should be used by servers */
 	struct gfp_xdr_async_server *async;
 };
@@ -67,9 +96,121 @@ gfp_xdr_set(struct gfp_xdr *conn,
 		gfarm_iobuffer_set_read_notimeout(conn->recvbuffer,
 		    ops->blocking_read_notimeout, cookie, fd);
 	}
-	if (conn->sendbuffer)
+	if (conn->sendbuffer) {
 		gfarm_iobuffer_set_write(conn->sendbuffer, ops->blocking_write,
 		    cookie, fd);
+		gfarm_iobuffer_set_writev(conn->sendbuffer,
+		    ops->blocking_writev);
+	}
+}
+
+static void
+gfp_xdr_profile_stat_add(struct gfp_xdr_profile_stat *st,
+	gfarm_int64_t delta)
+{
+	gfarm_int64_t size, max;
+
+	size = __sync_add_and_fetch(&st->alloc_size, delta);
+	do {
+		max = st->max_alloc_size;
+	} while (max < size &&
+	    !__sync_bool_compare_and_swap(&st->max_alloc_size, max, size));
+}
+
+/* called when an iobuffer of the connection is allocated or released */
+static void
+gfp_xdr_alloc_hook(void *cookie, int delta)
+{
+	struct gfp_xdr *conn = cookie;
+
+	/* only a thread which uses the connection calls this */
+	conn->alloc_size += delta;
+	gfp_xdr_profile_stat_add(&gfp_xdr_profile_stats[conn->profile], delta);
+}
+
+/* move the connection from a class to another */
+static void
+gfp_xdr_profile_stat_move(struct gfp_xdr *conn, int from, int to)
+{
+	struct gfp_xdr_profile_stat *st;
+
+	if (from >= 0) {
+		st = &gfp_xdr_profile_stats[from];
+		(void)__sync_fetch_and_sub(&st->connections, 1);
+		(void)__sync_fetch_and_sub(&st->alloc_size, conn->alloc_size);
+	}
+	if (to >= 0) {
+		st = &gfp_xdr_profile_stats[to];
+		(void)__sync_fetch_and_add(&st->connections, 1);
+		gfp_xdr_profile_stat_add(st, conn->alloc_size);
+	}
+	conn->profile = to;
+}
+
+void
+gfp_xdr_set_profile(struct gfp_xdr *conn, int profile)
+{
+	const struct gfp_xdr_profile *pr;
+
+	assert(profile >= 0 && profile < GFP_XDR_NPROFILES);
+	if (profile == conn->profile)
+		return;
+	gfp_xdr_profile_stat_move(conn, conn->profile, profile);
+
+	/* the size is changed when the buffer is allocated next time */
+	pr = &gfp_xdr_profiles[profile];
+	if (conn->recvbuffer != NULL) {
+		gfarm_iobuffer_set_default_size(conn->recvbuffer,
+		    pr->bufsize);
+		gfarm_iobuffer_shrink(conn->recvbuffer);
+	}
+	if (conn->sendbuffer != NULL) {
+		gfarm_iobuffer_set_default_size(conn->sendbuffer,
+		    pr->bufsize);
+		gfarm_iobuffer_shrink(conn->sendbuffer);
+	}
+}
+
+int
+gfp_xdr_get_profile(struct gfp_xdr *conn)
+{
+	return (conn->profile);
+}
+
+/*
+ * release the buffers of an idle connection, if its class allows.
+ * the caller must make sure that no other thread uses the connection.
+ */
+void
+gfp_xdr_shrink(struct gfp_xdr *conn)
+{
+	if (!gfp_xdr_profiles[conn->profile].shrink_when_idle)
+		return;
+	if (conn->recvbuffer != NULL)
+		gfarm_iobuffer_shrink(conn->recvbuffer);
+	if (conn->sendbuffer != NULL)
+		gfarm_iobuffer_shrink(conn->sendbuffer);
+}
+
+const char *
+gfp_xdr_profile_name(int profile)
+{
+	if (profile < 0 || profile >= GFP_XDR_NPROFILES)
+		return (NULL);
+	return (gfp_xdr_profiles[profile].name);
+}
+
+/* each member is read atomically, but not all of them at once */
+void
+gfp_xdr_profile_stat_get(int profile, struct gfp_xdr_profile_stat *st)
+{
+	struct gfp_xdr_profile_stat *s;
+
+	assert(profile >= 0 && profile < GFP_XDR_NPROFILES);
+	s = &gfp_xdr_profile_stats[profile];
+	st->connections = __sync_fetch_and_add(&s->connections, 0);
+	st->alloc_size = __sync_fetch_and_add(&s->alloc_size, 0);
+	st->max_alloc_size = __sync_fetch_and_add(&s->max_alloc_size, 0);
 }
 
 gfarm_error_t
@@ -114,6 +255,16 @@ gfp_xdr_new(struct gfp_iobuffer_ops *ops, void *cookie, int fd,
 	} else
 		conn->sendbuffer = NULL;
 
+	conn->alloc_size = 0;
+	conn->profile = -1;
+	gfp_xdr_profile_stat_move(conn, -1, GFP_XDR_PROFILE_METADATA);
+	if (conn->recvbuffer != NULL)
+		gfarm_iobuffer_set_alloc_hook(conn->recvbuffer,
+		    gfp_xdr_alloc_hook, conn);
+	if (conn->sendbuffer != NULL)
+		gfarm_iobuffer_set_alloc_hook(conn->sendbuffer,
+		    gfp_xdr_alloc_hook, conn);
+
 	gfp_xdr_set(conn, ops, cookie, fd);
 	conn->async = NULL;
 
@@ -129,6 +280,7 @@ gfp_xdr_free(struct gfp_xdr *conn)
 	e_save = gfp_xdr_flush(conn);
 	gfarm_iobuffer_free(conn->sendbuffer);
 	gfarm_iobuffer_free(conn->recvbuffer);
+	gfp_xdr_profile_stat_move(conn, conn->profile, -1);
 
 	e = (*conn->iob_ops->close)(conn->cookie, conn->fd);
 	if (e_save == GFARM_ERR_NO_ERROR)
@@ -1641,6 +1793,251 @@ gfp_xdr_recv_get_error(struct gfp_xdr *conn)
 	return (gfarm_iobuffer_get_error(conn->recvbuffer));
 }
 
+unsigned char *
+gfp_xdr_send_reserve(struct gfp_xdr *conn, size_t size)
+{
+	if (size > INT_MAX)
+		return (NULL);
+	return ((unsigned char *)gfarm_iobuffer_put_reserve(
+	    conn->sendbuffer, size));
+}
+
+void
+gfp_xdr_send_commit(struct gfp_xdr *conn, size_t size)
+{
+	gfarm_iobuffer_put_commit(conn->sendbuffer, size);
+}
+
+const unsigned char *
+gfp_xdr_recv_peek(struct gfp_xdr *conn, size_t *availp)
+{
+	const char *p;
+	int avail;
+
+	p = gfarm_iobuffer_get_peek(conn->recvbuffer, &avail);
+	*availp = avail;
+	return ((const unsigned char *)p);
+}
+
+void
+gfp_xdr_recv_commit(struct gfp_xdr *conn, size_t size)
+{
+	gfarm_iobuffer_get_commit(conn->recvbuffer, size);
+}
+
+/*
+ * "llilsslllilili"
+ * GFP_XDR_STAT_SIZE: the size except the contents of the strings
+ * GFP_XDR_STAT_USER_OFFSET: the offset of the length of st_user
+ * GFP_XDR_STAT_TAIL_SIZE: the size after the contents of st_group
+ */
+#define GFP_XDR_STAT_SIZE		88
+#define GFP_XDR_STAT_USER_OFFSET	28
+#define GFP_XDR_STAT_TAIL_SIZE		52
+
+#if !INT64T_IS_FLOAT
+
+/* returns false, if the send buffer doesn't have enough space */
+static int
+gfp_xdr_send_stat_in_place(struct gfp_xdr *conn, const char *name,
+	const struct gfs_stat *st)
+{
+	size_t name_len = 0, user_len, group_len, size;
+	unsigned char *p;
+
+	user_len = strlen(st->st_user);
+	group_len = strlen(st->st_group);
+	size = GFP_XDR_STAT_SIZE + user_len + group_len;
+	if (name != NULL) {
+		name_len = strlen(name);
+		size += sizeof(gfarm_int32_t) + name_len;
+	}
+	if ((p = gfp_xdr_send_reserve(conn, size)) == NULL)
+		return (0);
+
+	if (name != NULL)
+		GFP_XDR_PUT_BYTES(p, name, name_len);
+	GFP_XDR_PUT_INT64(p, st->st_ino);
+	GFP_XDR_PUT_INT64(p, st->st_gen);
+	GFP_XDR_PUT_INT32(p, st->st_mode);
+	GFP_XDR_PUT_INT64(p, st->st_nlink);
+	GFP_XDR_PUT_BYTES(p, st->st_user, user_len);
+	GFP_XDR_PUT_BYTES(p, st->st_group, group_len);
+	GFP_XDR_PUT_INT64(p, st->st_size);
+	GFP_XDR_PUT_INT64(p, st->st_ncopy);
+	GFP_XDR_PUT_INT64(p, st->st_atimespec.tv_sec);
+	GFP_XDR_PUT_INT32(p, st->st_atimespec.tv_nsec);
+	GFP_XDR_PUT_INT64(p, st->st_mtimespec.tv_sec);
+	GFP_XDR_PUT_INT32(p, st->st_mtimespec.tv_nsec);
+	GFP_XDR_PUT_INT64(p, st->st_ctimespec.tv_sec);
+	GFP_XDR_PUT_INT32(p, st->st_ctimespec.tv_nsec);
+	gfp_xdr_send_commit(conn, size);
+	return (1);
+}
+
+/*
+ * returns false, if the whole message isn't received yet,
+ * or if memory is exhausted.
+ */
+static int
+gfp_xdr_recv_stat_in_place(struct gfp_xdr *conn, size_t *sizep,
+	size_t name_size, size_t *name_lenp, char *name, struct gfs_stat *st)
+{
+	const unsigned char *head, *p;
+	size_t avail, off = 0;
+	gfarm_uint32_t name_len = 0, user_len, group_len;
+	char *user, *group;
+
+	head = gfp_xdr_recv_peek(conn, &avail);
+	if (sizep != NULL && avail > *sizep)
+		avail = *sizep;
+
+	/* check the lengths of the strings at first */
+	if (name != NULL) {
+		if (avail < sizeof(gfarm_int32_t))
+			return (0);
+		p = head;
+		GFP_XDR_GET_INT32(p, name_len);
+		off = sizeof(gfarm_int32_t);
+		if (name_len > avail - off)
+			return (0);
+		off += name_len;
+	}
+	if (avail - off < GFP_XDR_STAT_USER_OFFSET + sizeof(gfarm_int32_t))
+		return (0);
+	p = head + off + GFP_XDR_STAT_USER_OFFSET;
+	GFP_XDR_GET_INT32(p, user_len);
+	off += GFP_XDR_STAT_USER_OFFSET + sizeof(gfarm_int32_t);
+	if (user_len > avail - off ||
+	    avail - off - user_len < sizeof(gfarm_int32_t))
+		return (0);
+	off += user_len;
+	p = head + off;
+	GFP_XDR_GET_INT32(p, group_len);
+	off += sizeof(gfarm_int32_t);
+	if (group_len > avail - off ||
+	    avail - off - group_len < GFP_XDR_STAT_TAIL_SIZE)
+		return (0);
+	off += group_len + GFP_XDR_STAT_TAIL_SIZE;
+
+	GFARM_MALLOC_ARRAY(user, user_len + 1);
+	GFARM_MALLOC_ARRAY(group, group_len + 1);
+	if (user == NULL || group == NULL) {
+		/* let gfp_xdr_recv_sized() report it */
+		free(user);
+		free(group);
+		return (0);
+	}
+
+	p = head;
+	if (name != NULL) {
+		p += sizeof(gfarm_int32_t);
+		memcpy(name, p, name_len < name_size ? name_len : name_size);
+		*name_lenp = name_len;
+		p += name_len;
+	}
+	GFP_XDR_GET_INT64(p, st->st_ino);
+	GFP_XDR_GET_INT64(p, st->st_gen);
+	GFP_XDR_GET_INT32(p, st->st_mode);
+	GFP_XDR_GET_INT64(p, st->st_nlink);
+	p += sizeof(gfarm_int32_t);
+	memcpy(user, p, user_len);
+	user[user_len] = '\0';
+	p += user_len;
+	p += sizeof(gfarm_int32_t);
+	memcpy(group, p, group_len);
+	group[group_len] = '\0';
+	p += group_len;
+	st->st_user = user;
+	st->st_group = group;
+	GFP_XDR_GET_INT64(p, st->st_size);
+	GFP_XDR_GET_INT64(p, st->st_ncopy);
+	GFP_XDR_GET_INT64(p, st->st_atimespec.tv_sec);
+	GFP_XDR_GET_INT32(p, st->st_atimespec.tv_nsec);
+	GFP_XDR_GET_INT64(p, st->st_mtimespec.tv_sec);
+	GFP_XDR_GET_INT32(p, st->st_mtimespec.tv_nsec);
+	GFP_XDR_GET_INT64(p, st->st_ctimespec.tv_sec);
+	GFP_XDR_GET_INT32(p, st->st_ctimespec.tv_nsec);
+	assert(p == head + off);
+
+	gfp_xdr_recv_commit(conn, off);
+	if (sizep != NULL)
+		*sizep -= off;
+	return (1);
+}
+
+#endif /* !INT64T_IS_FLOAT */
+
+/*
+ * same as gfp_xdr_send() with "llilsslllilili",
+ * or "sllilsslllilili" if name isn't NULL.
+ */
+gfarm_error_t
+gfp_xdr_send_stat(struct gfp_xdr *conn, const char *name,
+	const struct gfs_stat *st)
+{
+#if !INT64T_IS_FLOAT
+	if (gfp_xdr_send_stat_in_place(conn, name, st))
+		return (gfarm_iobuffer_get_error(conn->sendbuffer));
+#endif
+	if (name == NULL)
+		return (gfp_xdr_send(conn, "llilsslllilili",
+		    st->st_ino, st->st_gen, st->st_mode, st->st_nlink,
+		    st->st_user, st->st_group, st->st_size,
+		    st->st_ncopy,
+		    st->st_atimespec.tv_sec, st->st_atimespec.tv_nsec,
+		    st->st_mtimespec.tv_sec, st->st_mtimespec.tv_nsec,
+		    st->st_ctimespec.tv_sec, st->st_ctimespec.tv_nsec));
+	return (gfp_xdr_send(conn, "sllilsslllilili", name,
+	    st->st_ino, st->st_gen, st->st_mode, st->st_nlink,
+	    st->st_user, st->st_group, st->st_size,
+	    st->st_ncopy,
+	    st->st_atimespec.tv_sec, st->st_atimespec.tv_nsec,
+	    st->st_mtimespec.tv_sec, st->st_mtimespec.tv_nsec,
+	    st->st_ctimespec.tv_sec, st->st_ctimespec.tv_nsec));
+}
+
+/*
+ * same as gfp_xdr_recv_sized() with "llilsslllilili",
+ * or "bllilsslllilili" with name_size, name_lenp and name if name isn't NULL,
+ * except that EOF is reported as GFARM_ERR_UNEXPECTED_EOF.
+ */
+gfarm_error_t
+gfp_xdr_recv_stat(struct gfp_xdr *conn, int just, int do_timeout,
+	size_t *sizep, size_t name_size, size_t *name_lenp, char *name,
+	struct gfs_stat *st)
+{
+	gfarm_error_t e;
+	int eof;
+
+#if !INT64T_IS_FLOAT
+	if (gfp_xdr_recv_stat_in_place(conn, sizep,
+	    name_size, name_lenp, name, st))
+		return (GFARM_ERR_NO_ERROR);
+#endif
+	if (name == NULL)
+		e = gfp_xdr_recv_sized(conn, just, do_timeout, sizep, &eof,
+		    "llilsslllilili",
+		    &st->st_ino, &st->st_gen, &st->st_mode, &st->st_nlink,
+		    &st->st_user, &st->st_group, &st->st_size,
+		    &st->st_ncopy,
+		    &st->st_atimespec.tv_sec, &st->st_atimespec.tv_nsec,
+		    &st->st_mtimespec.tv_sec, &st->st_mtimespec.tv_nsec,
+		    &st->st_ctimespec.tv_sec, &st->st_ctimespec.tv_nsec);
+	else
+		e = gfp_xdr_recv_sized(conn, just, do_timeout, sizep, &eof,
+		    "bllilsslllilili", name_size, name_lenp, name,
+		    &st->st_ino, &st->st_gen, &st->st_mode, &st->st_nlink,
+		    &st->st_user, &st->st_group, &st->st_size,
+		    &st->st_ncopy,
+		    &st->st_atimespec.tv_sec, &st->st_atimespec.tv_nsec,
+		    &st->st_mtimespec.tv_sec, &st->st_mtimespec.tv_nsec,
+		    &st->st_ctimespec.tv_sec, &st->st_ctimespec.tv_nsec);
+	if (e == GFARM_ERR_NO_ERROR && eof)
+		e = GFARM_ERR_UNEXPECTED_EOF;
+	return (e);
+}
+
 void
 gfp_xdr_begin_sendbuffer_pindown(struct gfp_xdr *conn)
 {
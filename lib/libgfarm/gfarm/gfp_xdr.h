@@ -1,4 +1,5 @@
 struct gfarm_iobuffer;
+struct iovec;
 
 struct gfp_iobuffer_ops {
 	gfarm_error_t (*close)(void *, int);
@@ -11,12 +12,27 @@ struct gfp_iobuffer_ops {
 	    void *, int);
 	int (*blocking_write)(struct gfarm_iobuffer *, void *, int,
 	    void *, int);
+	/* optional, may be NULL. used to send a large 'b' without copy */
+	int (*blocking_writev)(struct gfarm_iobuffer *, void *, int,
+	    struct iovec *, int);
 };
 
 #define GFP_XDR_NEW_RECV		1
 #define GFP_XDR_NEW_SEND		2
 #define GFP_XDR_NEW_AUTO_RECV_EXPANSION	4
 
+/* connection classes, which decide buffer sizes. see gfp_xdr_set_profile() */
+#define GFP_XDR_PROFILE_METADATA	0 /* default */
+#define GFP_XDR_PROFILE_BULK		1 /* file data */
+#define GFP_XDR_PROFILE_BACK_CHANNEL	2 /* between servers */
+#define GFP_XDR_NPROFILES		3
+
+struct gfp_xdr_profile_stat {
+	gfarm_int64_t connections;
+	gfarm_int64_t alloc_size; /* bytes allocated for the buffers */
+	gfarm_int64_t max_alloc_size; /* peak of alloc_size */
+};
+
 struct gfp_xdr;
 struct gfp_xdr_async_server;
 
@@ -47,6 +63,11 @@ gfarm_error_t gfp_xdr_sendbuffer_check_size(struct gfp_xdr *, int);
 void gfp_xdr_recvbuffer_clear_read_eof(struct gfp_xdr *);
 void gfp_xdr_set(struct gfp_xdr *,
 	struct gfp_iobuffer_ops *, void *, int);
+void gfp_xdr_set_profile(struct gfp_xdr *, int);
+int gfp_xdr_get_profile(struct gfp_xdr *);
+void gfp_xdr_shrink(struct gfp_xdr *);
+const char *gfp_xdr_profile_name(int);
+void gfp_xdr_profile_stat_get(int, struct gfp_xdr_profile_stat *);
 
 gfarm_error_t gfp_xdr_export_credential(struct gfp_xdr *);
 gfarm_error_t gfp_xdr_delete_credential(struct gfp_xdr *, int);
@@ -109,6 +130,70 @@ gfarm_error_t gfp_xdr_vrpc(struct gfp_xdr *, int, int,
 gfarm_error_t gfp_xdr_recv_partial(struct gfp_xdr *, int, void *, int, int *);
 gfarm_error_t gfp_xdr_recv_get_error(struct gfp_xdr *);
 
+/*
+ * in-place encoding and decoding, for messages which are sent so often
+ * that interpreting the format string of gfp_xdr_send() matters.
+ *
+ * gfp_xdr_send_reserve() returns the space of the specified size in the
+ * send buffer, or NULL if there isn't such space without writing, then
+ * the caller falls back to gfp_xdr_send().
+ * GFP_XDR_PUT_*() store a field there in the same encoding as the
+ * corresponding format character, and advance the pointer.
+ * gfp_xdr_send_commit() enqueues the stored fields.
+ *
+ * gfp_xdr_recv_peek() returns the data already received, and
+ * gfp_xdr_recv_commit() consumes them.  GFP_XDR_GET_*() are the
+ * counterparts of GFP_XDR_PUT_*().
+ *
+ * GFP_XDR_{PUT,GET}_INT64() assume that gfarm_int64_t is an integer type.
+ * see gfp_xdr_send_stat() and gfp_xdr_recv_stat() for examples.
+ */
+#define GFP_XDR_PUT_INT32(p, v) do { \
+		gfarm_uint32_t gfp_xdr_v = (v); \
+		(p)[0] = gfp_xdr_v >> 24; \
+		(p)[1] = gfp_xdr_v >> 16; \
+		(p)[2] = gfp_xdr_v >> 8; \
+		(p)[3] = gfp_xdr_v; \
+		(p) += 4; \
+	} while (0)
+#define GFP_XDR_PUT_INT64(p, v) do { \
+		gfarm_uint64_t gfp_xdr_o = (v); \
+		GFP_XDR_PUT_INT32(p, gfp_xdr_o >> 32); \
+		GFP_XDR_PUT_INT32(p, gfp_xdr_o); \
+	} while (0)
+/* 's', 'S' and 'b' */
+#define GFP_XDR_PUT_BYTES(p, s, n) do { \
+		GFP_XDR_PUT_INT32(p, n); \
+		memcpy(p, s, n); \
+		(p) += (n); \
+	} while (0)
+
+#define GFP_XDR_GET_INT32(p, v) do { \
+		(v) = (gfarm_int32_t)(((gfarm_uint32_t)(p)[0] << 24) | \
+		    ((gfarm_uint32_t)(p)[1] << 16) | \
+		    ((gfarm_uint32_t)(p)[2] << 8) | (gfarm_uint32_t)(p)[3]); \
+		(p) += 4; \
+	} while (0)
+#define GFP_XDR_GET_INT64(p, v) do { \
+		gfarm_uint32_t gfp_xdr_hi, gfp_xdr_lo; \
+		GFP_XDR_GET_INT32(p, gfp_xdr_hi); \
+		GFP_XDR_GET_INT32(p, gfp_xdr_lo); \
+		(v) = (gfarm_int64_t) \
+		    (((gfarm_uint64_t)gfp_xdr_hi << 32) | gfp_xdr_lo); \
+	} while (0)
+
+unsigned char *gfp_xdr_send_reserve(struct gfp_xdr *, size_t);
+void gfp_xdr_send_commit(struct gfp_xdr *, size_t);
+const unsigned char *gfp_xdr_recv_peek(struct gfp_xdr *, size_t *);
+void gfp_xdr_recv_commit(struct gfp_xdr *, size_t);
+
+/* struct gfs_stat, i.e. "llilsslllilili", preceded by the name if any */
+struct gfs_stat;
+gfarm_error_t gfp_xdr_send_stat(struct gfp_xdr *, const char *,
+	const struct gfs_stat *);
+gfarm_error_t gfp_xdr_recv_stat(struct gfp_xdr *, int, int, size_t *,
+	size_t, size_t *, char *, struct gfs_stat *);
+
 
 /* asynchronous RPC related functions */
 struct gfp_xdr_async_peer;
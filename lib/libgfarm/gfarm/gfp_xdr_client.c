@@ -145,6 +145,9 @@ gfp_xdr_vrpc_raw_request(struct gfp_xdr *conn,
 
 /*
  * get RPC result
+ *
+ * if the result is received partially, *sizep is the number of
+ * remaining bytes of the message, to let the caller purge them.
  */
 gfarm_error_t
 gfp_xdr_vrpc_raw_result_begin(
@@ -160,6 +163,7 @@ gfp_xdr_vrpc_raw_result_begin(
 	size_t size;
 
 	assert(xidr->xid != -1);
+	*sizep = 0;
 
 	e = gfp_xdr_recv_async_header(conn, just, do_timeout,
 	    &type, &xid, &size);
@@ -193,6 +197,7 @@ gfp_xdr_vrpc_raw_result_begin(
 		gflog_debug(GFARM_MSG_1001010,
 		    "receiving response (%d) failed: %s",
 		    just, gfarm_error_string(e));
+		*sizep = size;
 		return (e);
 	}
 
@@ -200,6 +205,7 @@ gfp_xdr_vrpc_raw_result_begin(
 		gflog_debug(GFARM_MSG_1001011,
 		    "Unexpected EOF when receiving response: %s",
 		    gfarm_error_string(GFARM_ERR_UNEXPECTED_EOF));
+		*sizep = size;
 		return (GFARM_ERR_UNEXPECTED_EOF);
 	}
 	if (*errcodep != GFARM_ERR_NO_ERROR) { /* no result argument */
@@ -213,17 +219,20 @@ gfp_xdr_vrpc_raw_result_begin(
 		gflog_debug(GFARM_MSG_1001012,
 		    "gfp_xdr_vrecv_sized_x() failed: %s",
 		    gfarm_error_string(e));
+		*sizep = size;
 		return (e);
 	}
 	if (eof) { /* rpc return value missing */
 		gflog_debug(GFARM_MSG_1001013,
 		    "Unexpected EOF when doing xdr vrecv: %s",
 		    gfarm_error_string(GFARM_ERR_UNEXPECTED_EOF));
+		*sizep = size;
 		return (GFARM_ERR_UNEXPECTED_EOF);
 	}
 	if (**formatp != '\0') {
 		gflog_debug(GFARM_MSG_UNFIXED,
 		    "invalid format character: %c(%x)", **formatp, **formatp);
+		*sizep = size;
 		return (GFARM_ERRMSG_GFP_XDR_VRPC_INVALID_FORMAT_CHARACTER);
 	}
 	*sizep = size;
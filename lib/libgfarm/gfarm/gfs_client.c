@@ -85,6 +85,9 @@ struct gfs_connection {
 	void *context; /* work area for RPC (esp. GFS_PROTO_COMMAND) */
 
 	int failover_count; /* compare to gfm_connection.failover_count */
+
+	/* outstanding asynchronous requests, in the order of sending */
+	struct gfs_client_aio *aio_head, **aio_tailp;
 };
 
 #define staticp	(gfarm_ctxp->gfs_client_static)
@@ -102,6 +105,8 @@ struct gfs_client_static {
 #define SERVER_HASHTAB_SIZE	3079	/* prime number */
 
 static gfarm_error_t gfs_client_connection_dispose(void *);
+static void gfs_client_aio_abort(struct gfs_connection *, gfarm_error_t);
+static gfarm_error_t gfs_client_aio_drain(struct gfs_connection *);
 
 gfarm_error_t
 gfs_client_static_init(struct gfarm_context *ctxp)
@@ -116,7 +121,8 @@ gfs_client_static_init(struct gfarm_context *ctxp)
 		gfs_client_connection_dispose,
 		"gfs_connection",
 		SERVER_HASHTAB_SIZE,
-		&ctxp->gfsd_connection_cache);
+		&ctxp->gfsd_connection_cache,
+		&ctxp->gfsd_connection_pool_size);
 	s->hook_for_connection_error = NULL;
 	s->self_ip_asked = 0;
 	s->self_ip_count = 0;
@@ -431,6 +437,7 @@ gfs_client_connection_alloc(const char *canonical_hostname,
 			gfarm_error_string(e));
 		return (e);
 	}
+	gfp_xdr_set_profile(gfs_server->conn, GFP_XDR_PROFILE_BULK);
 	gfs_server->hostname = strdup(canonical_hostname);
 	if (gfs_server->hostname == NULL) {
 		e = gfp_xdr_free(gfs_server->conn);
@@ -446,6 +453,8 @@ gfs_client_connection_alloc(const char *canonical_hostname,
 	gfs_server->context = NULL;
 	gfs_server->opened = 0;
 	gfs_server->failover_count = failover_count;
+	gfs_server->aio_head = NULL;
+	gfs_server->aio_tailp = &gfs_server->aio_head;
 
 	gfs_server->cache_entry = cache_entry;
 	gfp_cached_connection_set_data(cache_entry, gfs_server);
@@ -567,6 +576,7 @@ gfsk_client_connection_alloc_and_auth(struct gfarm_eventqueue *q,
 			gfarm_error_string(e));
 			return (e);
 		}
+		gfp_xdr_set_profile(gfs_server->conn, GFP_XDR_PROFILE_BULK);
 	} else
 		gfs_server->conn = NULL;
 	gfs_server->port = ntohs(((struct sockaddr_in *)peer_addr)->sin_port);
@@ -575,6 +585,8 @@ gfsk_client_connection_alloc_and_auth(struct gfarm_eventqueue *q,
 	gfs_server->context = NULL;
 	gfs_server->opened = 0;
 	gfs_server->failover_count = failover_count;
+	gfs_server->aio_head = NULL;
+	gfs_server->aio_tailp = &gfs_server->aio_head;
 
 	gfs_server->cache_entry = cache_entry;
 	gfp_cached_connection_set_data(cache_entry, gfs_server);
@@ -599,8 +611,10 @@ static gfarm_error_t
 gfs_client_connection_dispose(void *connection_data)
 {
 	struct gfs_connection *gfs_server = connection_data;
-	gfarm_error_t e = gfp_xdr_free(gfs_server->conn);
+	gfarm_error_t e;
 
+	gfs_client_aio_abort(gfs_server, GFARM_ERR_CONNECTION_ABORTED);
+	e = gfp_xdr_free(gfs_server->conn);
 	gfp_uncached_connection_dispose(gfs_server->cache_entry);
 	free(gfs_server->hostname);
 	/* XXX - gfs_server->context should be NULL here */
@@ -1049,7 +1063,9 @@ gfs_client_connect_kern_end(int events, int fd, void *kevp, void *closure)
 				"gfp_xdr_new_socket() failed: %s",
 				gfarm_error_string(e));
 				state->error = e;
-			}
+			} else
+				gfp_xdr_set_profile(state->gfs_server->conn,
+				    GFP_XDR_PROFILE_BULK);
 		}
 		if (state->continuation != NULL)
 			(*state->continuation)(state->closure);
@@ -1308,6 +1324,9 @@ gfs_client_rpc_request(struct gfs_connection *gfs_server,
 	va_list ap;
 	gfarm_error_t e;
 
+	if ((e = gfs_client_aio_drain(gfs_server)) != GFARM_ERR_NO_ERROR)
+		return (e);
+
 	va_start(ap, format);
 	e = gfp_xdr_vrpc_raw_request(gfs_server->conn, xidrp,
 	    command, &format, &ap);
@@ -1324,11 +1343,11 @@ gfs_client_rpc_request(struct gfs_connection *gfs_server,
 	return (e);
 }
 
-gfarm_error_t
-gfs_client_rpc_result(struct gfs_connection *gfs_server, int just,
-	struct gfp_xdr_xid_record *xidr, const char *format, ...)
+static gfarm_error_t
+gfs_client_vrpc_result(struct gfs_connection *gfs_server, int just,
+	int do_timeout, struct gfp_xdr_xid_record *xidr,
+	const char *format, va_list *app)
 {
-	va_list ap;
 	gfarm_error_t e;
 	int errcode;
 
@@ -1346,10 +1365,8 @@ gfs_client_rpc_result(struct gfs_connection *gfs_server, int just,
 		return (e);
 	}
 
-	va_start(ap, format);
-	e = gfp_xdr_vrpc_raw_result(gfs_server->conn, just, 1, xidr,
-	    &errcode, &format, &ap);
-	va_end(ap);
+	e = gfp_xdr_vrpc_raw_result(gfs_server->conn, just, do_timeout, xidr,
+	    &errcode, &format, app);
 
 	if (IS_CONNECTION_ERROR(e)) {
 		gfs_client_execute_hook_for_connection_error(gfs_server);
@@ -1374,6 +1391,32 @@ gfs_client_rpc_result(struct gfs_connection *gfs_server, int just,
 	return (GFARM_ERR_NO_ERROR);
 }
 
+gfarm_error_t
+gfs_client_rpc_result(struct gfs_connection *gfs_server, int just,
+	struct gfp_xdr_xid_record *xidr, const char *format, ...)
+{
+	va_list ap;
+	gfarm_error_t e;
+
+	va_start(ap, format);
+	e = gfs_client_vrpc_result(gfs_server, just, 1, xidr, format, &ap);
+	va_end(ap);
+	return (e);
+}
+
+static gfarm_error_t
+gfs_client_rpc_result_notimeout(struct gfs_connection *gfs_server, int just,
+	struct gfp_xdr_xid_record *xidr, const char *format, ...)
+{
+	va_list ap;
+	gfarm_error_t e;
+
+	va_start(ap, format);
+	e = gfs_client_vrpc_result(gfs_server, just, 0, xidr, format, &ap);
+	va_end(ap);
+	return (e);
+}
+
 static gfarm_error_t
 gfs_client_vrpc(struct gfs_connection *gfs_server, int just, int do_timeout,
 	int command, const char *format, va_list *app)
@@ -1381,6 +1424,9 @@ gfs_client_vrpc(struct gfs_connection *gfs_server, int just, int do_timeout,
 	gfarm_error_t e;
 	int errcode;
 
+	if ((e = gfs_client_aio_drain(gfs_server)) != GFARM_ERR_NO_ERROR)
+		return (e);
+
 	gfs_client_connection_used(gfs_server);
 
 	e = gfp_xdr_vrpc(gfs_server->conn, just, do_timeout,
@@ -1625,6 +1671,410 @@ gfs_client_pwrite(struct gfs_connection *gfs_server,
 	return (GFARM_ERR_NO_ERROR);
 }
 
+/*
+ * asynchronous GFS_PROTO_PREAD and GFS_PROTO_PWRITE
+ *
+ * requests are queued on the connection in the order of sending,
+ * and gfsd replies in that order.  any other RPC on the connection
+ * receives the outstanding results first to keep the stream in sync.
+ *
+ * like the other RPCs of struct gfs_connection, this is not serialized.
+ * a connection must not be used by multiple threads at the same time.
+ */
+
+struct gfs_client_aio {
+	struct gfs_connection *gfs_server; /* NULL, if completed */
+	int command;
+	void *buffer;
+	size_t size;
+	struct gfp_xdr_xid_record *xidr;
+
+	/* results */
+	gfarm_error_t error;
+	size_t length;
+
+	struct gfs_client_aio *next;
+};
+
+#define GFS_CLIENT_AIO_WINDOW	64 /* max outstanding requests of preadv */
+
+static void
+gfs_client_aio_complete(struct gfs_client_aio *aio,
+	gfarm_error_t e, size_t length)
+{
+	aio->gfs_server = NULL;
+	aio->next = NULL;
+	aio->error = e;
+	aio->length = length;
+}
+
+/* fail all outstanding requests, since the stream is out of sync */
+static void
+gfs_client_aio_abort(struct gfs_connection *gfs_server, gfarm_error_t e)
+{
+	struct gfs_client_aio *aio;
+
+	while ((aio = gfs_server->aio_head) != NULL) {
+		gfs_server->aio_head = aio->next;
+		gfs_client_aio_complete(aio, e, 0);
+	}
+	gfs_server->aio_tailp = &gfs_server->aio_head;
+}
+
+/*
+ * receive the result of an asynchronous request.
+ * unlike gfs_client_rpc_result(), the rest of the message is purged
+ * even if the result is short or broken, to keep the following
+ * results of the connection in sync.
+ */
+static gfarm_error_t
+gfs_client_aio_result(struct gfs_connection *gfs_server,
+	struct gfp_xdr_xid_record *xidr, int *out_of_syncp,
+	const char *format, ...)
+{
+	va_list ap;
+	gfarm_error_t e, e2;
+	gfarm_int32_t errcode;
+	size_t size;
+
+	gfs_client_connection_used(gfs_server);
+
+	*out_of_syncp = 0;
+	e = gfp_xdr_flush(gfs_server->conn);
+	if (e == GFARM_ERR_NO_ERROR) {
+		va_start(ap, format);
+		e = gfp_xdr_vrpc_raw_result_begin(gfs_server->conn, 0, 1,
+		    xidr, &size, &errcode, &format, &ap);
+		va_end(ap);
+		if (!IS_CONNECTION_ERROR(e) && size > 0) {
+			e2 = gfp_xdr_purge(gfs_server->conn, 0, size);
+			if (e2 != GFARM_ERR_NO_ERROR) {
+				e = e2;
+				*out_of_syncp = 1;
+			} else if (e != GFARM_ERR_NO_ERROR)
+				gflog_debug(GFARM_MSG_UNFIXED,
+				    "asynchronous result: %d bytes purged: %s",
+				    (int)size, gfarm_error_string(e));
+		}
+	}
+	if (IS_CONNECTION_ERROR(e))
+		*out_of_syncp = 1;
+	if (*out_of_syncp) {
+		gfs_client_execute_hook_for_connection_error(gfs_server);
+		gfs_client_purge_from_cache(gfs_server);
+	}
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "asynchronous result failed: %s", gfarm_error_string(e));
+		return (e);
+	}
+	if (errcode != 0) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "asynchronous result: errcode=%d", errcode);
+		return (errcode);
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/* receive the result of the oldest outstanding request */
+static gfarm_error_t
+gfs_client_aio_recv(struct gfs_connection *gfs_server)
+{
+	gfarm_error_t e;
+	struct gfs_client_aio *aio = gfs_server->aio_head;
+	size_t length = 0;
+	gfarm_int32_t n;
+	int out_of_sync;
+
+	gfs_server->aio_head = aio->next;
+	if (gfs_server->aio_head == NULL)
+		gfs_server->aio_tailp = &gfs_server->aio_head;
+
+	if (aio->command == GFS_PROTO_PREAD) {
+		e = gfs_client_aio_result(gfs_server, aio->xidr,
+		    &out_of_sync, "b", aio->size, &length, aio->buffer);
+		if (e == GFARM_ERR_NO_ERROR && length > aio->size) {
+			gflog_debug(GFARM_MSG_UNFIXED,
+			    "Protocol error in client pread (%llu)>(%llu)",
+			    (unsigned long long)length,
+			    (unsigned long long)aio->size);
+			e = GFARM_ERRMSG_GFS_PROTO_PREAD_PROTOCOL;
+		}
+	} else {
+		e = gfs_client_aio_result(gfs_server, aio->xidr,
+		    &out_of_sync, "i", &n);
+		if (e == GFARM_ERR_NO_ERROR) {
+			length = n;
+			if (length > aio->size) {
+				gflog_debug(GFARM_MSG_UNFIXED,
+				    "Protocol error in client pwrite "
+				    "(%llu)>(%llu)",
+				    (unsigned long long)length,
+				    (unsigned long long)aio->size);
+				e = GFARM_ERRMSG_GFS_PROTO_PWRITE_PROTOCOL;
+			}
+		}
+	}
+	gfs_client_aio_complete(aio, e, length);
+	if (out_of_sync) {
+		gfs_client_aio_abort(gfs_server, e);
+		return (e);
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static gfarm_error_t
+gfs_client_aio_drain(struct gfs_connection *gfs_server)
+{
+	gfarm_error_t e;
+
+	while (gfs_server->aio_head != NULL) {
+		if ((e = gfs_client_aio_recv(gfs_server))
+		    != GFARM_ERR_NO_ERROR)
+			return (e);
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static gfarm_error_t
+gfs_client_aio_request(struct gfs_connection *gfs_server,
+	struct gfs_client_aio *aio, int do_flush, int command,
+	const char *format, ...)
+{
+	va_list ap;
+	gfarm_error_t e;
+
+	gfs_client_connection_used(gfs_server);
+
+	va_start(ap, format);
+	e = gfp_xdr_vrpc_raw_request(gfs_server->conn, &aio->xidr,
+	    command, &format, &ap);
+	va_end(ap);
+	if (e == GFARM_ERR_NO_ERROR && do_flush)
+		e = gfp_xdr_flush(gfs_server->conn);
+	if (e != GFARM_ERR_NO_ERROR) {
+		if (IS_CONNECTION_ERROR(e)) {
+			gfs_client_execute_hook_for_connection_error(
+			    gfs_server);
+			gfs_client_purge_from_cache(gfs_server);
+		}
+		gfs_client_aio_abort(gfs_server, e);
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "asynchronous request (%d) failed: %s",
+		    command, gfarm_error_string(e));
+		return (e);
+	}
+	aio->gfs_server = gfs_server;
+	aio->command = command;
+	aio->next = NULL;
+	*gfs_server->aio_tailp = aio;
+	gfs_server->aio_tailp = &aio->next;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static gfarm_error_t
+gfs_client_aio_pread_request(struct gfs_connection *gfs_server,
+	struct gfs_client_aio *aio, int do_flush, gfarm_int32_t fd,
+	void *buffer, size_t size, gfarm_off_t off)
+{
+	aio->buffer = buffer;
+	aio->size = size;
+	return (gfs_client_aio_request(gfs_server, aio, do_flush,
+	    GFS_PROTO_PREAD, "iil", fd, (int)size, off));
+}
+
+static gfarm_error_t
+gfs_client_aio_pwrite_request(struct gfs_connection *gfs_server,
+	struct gfs_client_aio *aio, int do_flush, gfarm_int32_t fd,
+	const void *buffer, size_t size, gfarm_off_t off)
+{
+	aio->buffer = (void *)buffer; /* UNCONST */
+	aio->size = size;
+	return (gfs_client_aio_request(gfs_server, aio, do_flush,
+	    GFS_PROTO_PWRITE, "ibl", fd, size, buffer, off));
+}
+
+gfarm_error_t
+gfs_client_aio_pread(struct gfs_connection *gfs_server,
+	gfarm_int32_t fd, void *buffer, size_t size,
+	gfarm_off_t off, struct gfs_client_aio **aiop)
+{
+	gfarm_error_t e;
+	struct gfs_client_aio *aio;
+
+	if (size > GFS_PROTO_MAX_IOSIZE)
+		size = GFS_PROTO_MAX_IOSIZE;
+	GFARM_MALLOC(aio);
+	if (aio == NULL) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "allocation of 'gfs_client_aio' failed: %s",
+		    gfarm_error_string(GFARM_ERR_NO_MEMORY));
+		return (GFARM_ERR_NO_MEMORY);
+	}
+	if ((e = gfs_client_aio_pread_request(gfs_server, aio, 1,
+	    fd, buffer, size, off)) != GFARM_ERR_NO_ERROR) {
+		free(aio);
+		return (e);
+	}
+	*aiop = aio;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+gfarm_error_t
+gfs_client_aio_pwrite(struct gfs_connection *gfs_server,
+	gfarm_int32_t fd, const void *buffer, size_t size,
+	gfarm_off_t off, struct gfs_client_aio **aiop)
+{
+	gfarm_error_t e;
+	struct gfs_client_aio *aio;
+
+	if (size > GFS_PROTO_MAX_IOSIZE)
+		size = GFS_PROTO_MAX_IOSIZE;
+	GFARM_MALLOC(aio);
+	if (aio == NULL) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "allocation of 'gfs_client_aio' failed: %s",
+		    gfarm_error_string(GFARM_ERR_NO_MEMORY));
+		return (GFARM_ERR_NO_MEMORY);
+	}
+	if ((e = gfs_client_aio_pwrite_request(gfs_server, aio, 1,
+	    fd, buffer, size, off)) != GFARM_ERR_NO_ERROR) {
+		free(aio);
+		return (e);
+	}
+	*aiop = aio;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/*
+ * receive results which have started arriving,
+ * and return TRUE if the request has completed.
+ * this doesn't wait for a reply which hasn't arrived yet, but
+ * a reply which has partially arrived is received entirely, and
+ * that may block until the rest of the reply, up to
+ * GFS_PROTO_MAX_IOSIZE bytes of data, arrives.
+ */
+int
+gfs_client_aio_poll(struct gfs_client_aio *aio)
+{
+	struct gfs_connection *gfs_server;
+	struct pollfd fds[1];
+
+	while ((gfs_server = aio->gfs_server) != NULL) {
+		if (!gfp_xdr_recv_is_ready(gfs_server->conn)) {
+			fds[0].fd = gfp_xdr_fd(gfs_server->conn);
+			fds[0].events = POLLIN;
+			if (poll(fds, 1, 0) <= 0)
+				return (0);
+		}
+		(void)gfs_client_aio_recv(gfs_server);
+	}
+	return (1);
+}
+
+/* wait for the completion of the request, and free it */
+gfarm_error_t
+gfs_client_aio_wait(struct gfs_client_aio *aio, size_t *np)
+{
+	gfarm_error_t e;
+	struct gfs_connection *gfs_server;
+
+	while ((gfs_server = aio->gfs_server) != NULL)
+		(void)gfs_client_aio_recv(gfs_server);
+	e = aio->error;
+	*np = aio->length;
+	free(aio);
+	return (e);
+}
+
+/* receive the result of a request of gfs_client_pio_vector() */
+static void
+gfs_client_pio_vector_result(struct gfs_connection *gfs_server,
+	struct gfs_client_aio *aio, gfarm_error_t *ep, size_t *np, int *donep)
+{
+	while (aio->gfs_server != NULL)
+		(void)gfs_client_aio_recv(gfs_server);
+	if (*donep)
+		return;
+	if (aio->error != GFARM_ERR_NO_ERROR) {
+		*ep = aio->error;
+		*donep = 1;
+		return;
+	}
+	*np += aio->length;
+	if (aio->length < aio->size) /* short transfer */
+		*donep = 1;
+}
+
+/*
+ * send the requests of all segments before receiving any result,
+ * so that gfsd processes them without waiting for each round trip.
+ * a segment larger than GFS_PROTO_MAX_IOSIZE is split.
+ * *np is the number of bytes transferred until the first short transfer.
+ */
+static gfarm_error_t
+gfs_client_pio_vector(struct gfs_connection *gfs_server, gfarm_int32_t fd,
+	int is_write, const struct gfs_pio_iovec *iov, int iovcnt, size_t *np)
+{
+	gfarm_error_t e = GFARM_ERR_NO_ERROR, e_req = GFARM_ERR_NO_ERROR;
+	struct gfs_client_aio aios[GFS_CLIENT_AIO_WINDOW], *aio;
+	int i, head = 0, tail = 0, done = 0;
+	size_t chunk, off;
+	size_t n = 0;
+	char *p;
+
+	if ((e = gfs_client_aio_drain(gfs_server)) != GFARM_ERR_NO_ERROR)
+		return (e);
+
+	for (i = 0; i < iovcnt && e_req == GFARM_ERR_NO_ERROR; i++) {
+		p = iov[i].iov_base;
+		for (off = 0; off < iov[i].iov_len; off += chunk) {
+			chunk = iov[i].iov_len - off;
+			if (chunk > GFS_PROTO_MAX_IOSIZE)
+				chunk = GFS_PROTO_MAX_IOSIZE;
+			if (tail - head >= GFS_CLIENT_AIO_WINDOW)
+				gfs_client_pio_vector_result(gfs_server,
+				    &aios[head++ % GFS_CLIENT_AIO_WINDOW],
+				    &e, &n, &done);
+			aio = &aios[tail % GFS_CLIENT_AIO_WINDOW];
+			if (is_write)
+				e_req = gfs_client_aio_pwrite_request(
+				    gfs_server, aio, 0, fd, p + off, chunk,
+				    iov[i].iov_offset + off);
+			else
+				e_req = gfs_client_aio_pread_request(
+				    gfs_server, aio, 0, fd, p + off, chunk,
+				    iov[i].iov_offset + off);
+			if (e_req != GFARM_ERR_NO_ERROR)
+				break;
+			tail++;
+		}
+	}
+	while (head < tail)
+		gfs_client_pio_vector_result(gfs_server,
+		    &aios[head++ % GFS_CLIENT_AIO_WINDOW], &e, &n, &done);
+	if (!done && e_req != GFARM_ERR_NO_ERROR)
+		e = e_req;
+	if (e != GFARM_ERR_NO_ERROR && n > 0)
+		e = GFARM_ERR_NO_ERROR; /* partial transfer */
+	*np = n;
+	return (e);
+}
+
+gfarm_error_t
+gfs_client_preadv(struct gfs_connection *gfs_server, gfarm_int32_t fd,
+	const struct gfs_pio_iovec *iov, int iovcnt, size_t *np)
+{
+	return (gfs_client_pio_vector(gfs_server, fd, 0, iov, iovcnt, np));
+}
+
+gfarm_error_t
+gfs_client_pwritev(struct gfs_connection *gfs_server, gfarm_int32_t fd,
+	const struct gfs_pio_iovec *iov, int iovcnt, size_t *np)
+{
+	return (gfs_client_pio_vector(gfs_server, fd, 1, iov, iovcnt, np));
+}
+
 gfarm_error_t
 gfs_client_write(struct gfs_connection *gfs_server,
 	gfarm_int32_t fd, const void *buffer, size_t size,
@@ -1727,6 +2177,46 @@ gfs_client_replica_add_from(struct gfs_connection *gfs_server,
 	    GFS_PROTO_REPLICA_ADD_FROM, "sii/", host, port, fd));
 }
 
+/*
+ * the request and the result of GFS_PROTO_REPLICA_ADD_FROM_RELAY are
+ * separated, so that all hops of a chained replication run concurrently.
+ */
+gfarm_error_t
+gfs_client_replica_add_from_relay_request(struct gfs_connection *gfs_server,
+	char *host, gfarm_int32_t port, char *relay_host,
+	gfarm_int32_t relay_port, gfarm_int32_t fd,
+	struct gfp_xdr_xid_record **xidrp)
+{
+	gfarm_error_t e;
+
+	gfs_client_connection_lock(gfs_server);
+	e = gfs_client_rpc_request(gfs_server, xidrp,
+	    GFS_PROTO_REPLICA_ADD_FROM_RELAY, "sisii",
+	    host, port, relay_host, relay_port, fd);
+	if (e == GFARM_ERR_NO_ERROR) {
+		e = gfp_xdr_flush(gfs_server->conn);
+		if (IS_CONNECTION_ERROR(e)) {
+			gfs_client_execute_hook_for_connection_error(
+			    gfs_server);
+			gfs_client_purge_from_cache(gfs_server);
+		}
+	}
+	gfs_client_connection_unlock(gfs_server);
+	return (e);
+}
+
+gfarm_error_t
+gfs_client_replica_add_from_relay_result(struct gfs_connection *gfs_server,
+	struct gfp_xdr_xid_record *xidr)
+{
+	gfarm_error_t e;
+
+	gfs_client_connection_lock(gfs_server);
+	e = gfs_client_rpc_result_notimeout(gfs_server, 0, xidr, "");
+	gfs_client_connection_unlock(gfs_server);
+	return (e);
+}
+
 gfarm_error_t
 gfs_client_statfs(struct gfs_connection *gfs_server, char *path,
 	gfarm_int32_t *bsizep,
@@ -1993,8 +2483,9 @@ gfs_client_ctx_rpc_result(struct gfs_connection *gfs_server,
  * but defined here for better maintainability.
  */
 
-gfarm_error_t
-gfs_client_replica_recv(struct gfs_connection *gfs_server,
+static gfarm_error_t
+gfs_client_replica_recv_common(struct gfs_connection *gfs_server,
+	gfarm_int32_t command, const char *diag,
 	gfarm_ino_t ino, gfarm_uint64_t gen, gfarm_int32_t local_fd,
 	gfarm_error_t *e_localp, gfarm_error_t *e_remotep)
 {
@@ -2011,11 +2502,10 @@ gfs_client_replica_recv(struct gfs_connection *gfs_server,
 	gfarm_off_t offset = 0;
 	size_t got;
 	struct pollfd fds[1];
-	static const char diag[] = "gfs_client_replica_recv";
 
 	assert(REPLICA_RECV_IOSIZE <= GFS_PROTO_MAX_IOSIZE);
 
-	e_remote = gfs_client_rpc(gfs_server, 0, GFS_PROTO_FHOPEN,
+	e_remote = gfs_client_rpc(gfs_server, 0, command,
 	    "ll/i", ino, gen, &remote_fd);
 	if (e_remote != GFARM_ERR_NO_ERROR) {
 		if (IS_CONNECTION_ERROR(e_remote)) {
@@ -2024,8 +2514,9 @@ gfs_client_replica_recv(struct gfs_connection *gfs_server,
 			gfs_client_purge_from_cache(gfs_server);
 		}
 		gflog_debug(GFARM_MSG_1001218,
-		    "%s: GFS_PROTO_FHOPEN failed: %s",
-		    diag, gfarm_error_string(e_remote));
+		    "%s: GFS_PROTO_FHOPEN%s failed: %s", diag,
+		    command == GFS_PROTO_FHOPEN_RELAY ? "_RELAY" : "",
+		    gfarm_error_string(e_remote));
 		*e_localp = GFARM_ERR_NO_ERROR;
 		*e_remotep = e_remote;
 		return (e_remote);
@@ -2257,6 +2748,30 @@ gfs_client_replica_recv(struct gfs_connection *gfs_server,
 	return (e);
 #endif /* implementation until gfarm-2.X and before */
 }
+
+gfarm_error_t
+gfs_client_replica_recv(struct gfs_connection *gfs_server,
+	gfarm_ino_t ino, gfarm_uint64_t gen, gfarm_int32_t local_fd,
+	gfarm_error_t *e_localp, gfarm_error_t *e_remotep)
+{
+	return (gfs_client_replica_recv_common(gfs_server,
+	    GFS_PROTO_FHOPEN, "gfs_client_replica_recv",
+	    ino, gen, local_fd, e_localp, e_remotep));
+}
+
+/*
+ * same as gfs_client_replica_recv(),
+ * but the replica on gfs_server may be still being received.
+ */
+gfarm_error_t
+gfs_client_replica_recv_relay(struct gfs_connection *gfs_server,
+	gfarm_ino_t ino, gfarm_uint64_t gen, gfarm_int32_t local_fd,
+	gfarm_error_t *e_localp, gfarm_error_t *e_remotep)
+{
+	return (gfs_client_replica_recv_common(gfs_server,
+	    GFS_PROTO_FHOPEN_RELAY, "gfs_client_replica_recv_relay",
+	    ino, gen, local_fd, e_localp, e_remotep));
+}
 #endif /* __KERNEL__ */
 
 /*
@@ -72,6 +72,19 @@ gfarm_error_t gfs_client_pwrite(struct gfs_connection *,
 gfarm_error_t gfs_client_write(struct gfs_connection *,
 			gfarm_int32_t, const void *, size_t,
 			size_t *, gfarm_off_t *, gfarm_off_t *);
+struct gfs_pio_iovec;
+gfarm_error_t gfs_client_preadv(struct gfs_connection *, gfarm_int32_t,
+	const struct gfs_pio_iovec *, int, size_t *);
+gfarm_error_t gfs_client_pwritev(struct gfs_connection *, gfarm_int32_t,
+	const struct gfs_pio_iovec *, int, size_t *);
+struct gfs_client_aio;
+gfarm_error_t gfs_client_aio_pread(struct gfs_connection *,
+	gfarm_int32_t, void *, size_t, gfarm_off_t, struct gfs_client_aio **);
+gfarm_error_t gfs_client_aio_pwrite(struct gfs_connection *,
+	gfarm_int32_t, const void *, size_t, gfarm_off_t,
+	struct gfs_client_aio **);
+int gfs_client_aio_poll(struct gfs_client_aio *);
+gfarm_error_t gfs_client_aio_wait(struct gfs_client_aio *, size_t *);
 gfarm_error_t gfs_client_ftruncate(struct gfs_connection *,
 	gfarm_int32_t, gfarm_off_t);
 gfarm_error_t gfs_client_fsync(struct gfs_connection *,
@@ -93,9 +106,18 @@ gfarm_error_t gfs_client_lock_info(struct gfs_connection *, gfarm_int32_t,
 	gfarm_off_t *, gfarm_off_t *, gfarm_int32_t *, char**, gfarm_pid_t **);
 gfarm_error_t gfs_client_replica_add_from(struct gfs_connection *,
 	char *, gfarm_int32_t, gfarm_int32_t);
+struct gfp_xdr_xid_record;
+gfarm_error_t gfs_client_replica_add_from_relay_request(
+	struct gfs_connection *, char *, gfarm_int32_t, char *, gfarm_int32_t,
+	gfarm_int32_t, struct gfp_xdr_xid_record **);
+gfarm_error_t gfs_client_replica_add_from_relay_result(
+	struct gfs_connection *, struct gfp_xdr_xid_record *);
 gfarm_error_t gfs_client_replica_recv(struct gfs_connection *,
 	gfarm_ino_t, gfarm_uint64_t, gfarm_int32_t,
 	gfarm_error_t *, gfarm_error_t *);
+gfarm_error_t gfs_client_replica_recv_relay(struct gfs_connection *,
+	gfarm_ino_t, gfarm_uint64_t, gfarm_int32_t,
+	gfarm_error_t *, gfarm_error_t *);
 gfarm_error_t gfs_client_statfs(struct gfs_connection *, char *,
 	gfarm_int32_t *,
 	gfarm_off_t *, gfarm_off_t *, gfarm_off_t *,
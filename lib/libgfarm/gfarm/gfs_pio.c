@@ -29,6 +29,7 @@
 #include "gfm_proto.h"
 #include "gfm_client.h"
 #include "gfs_proto.h"	/* GFS_PROTO_FSYNC_* */
+#include "gfs_client.h"
 #include "gfs_io.h"
 #include "gfs_pio.h"
 #include "gfp_xdr.h"
@@ -1067,6 +1068,177 @@ gfs_pio_pwrite(GFS_File gf, void *buffer, int size, gfarm_off_t offset, int *np)
 	return (e);
 }
 
+gfarm_error_t
+gfs_pio_preadv(GFS_File gf, const struct gfs_pio_iovec *iov, int iovcnt,
+	int *np)
+{
+	gfarm_error_t e;
+	size_t length;
+	gfarm_timerval_t t1, t2;
+
+	GFARM_KERNEL_UNUSE2(t1, t2);
+	GFARM_TIMEVAL_FIX_INITIALIZE_WARNING(t1);
+	gfs_profile(gfarm_gettimerval(&t1));
+
+	e = gfs_pio_check_view_default(gf);
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+			"Check view default for pio failed: %s",
+			gfarm_error_string(e));
+		return (e);
+	}
+
+	CHECK_READABLE(gf);
+
+	e = (*gf->ops->view_preadv)(gf, iov, iovcnt, &length);
+	if (e == GFARM_ERR_NO_ERROR)
+		*np = length;
+	else
+		gflog_debug(GFARM_MSG_UNFIXED,
+			"view_preadv() failed: %s",
+			gfarm_error_string(e));
+
+	gfs_profile(gfarm_gettimerval(&t2));
+	gfs_profile(staticp->read_time += gfarm_timerval_sub(&t2, &t1));
+
+	return (e);
+}
+
+gfarm_error_t
+gfs_pio_pwritev(GFS_File gf, const struct gfs_pio_iovec *iov, int iovcnt,
+	int *np)
+{
+	gfarm_error_t e;
+	size_t length;
+	gfarm_timerval_t t1, t2;
+
+	GFARM_KERNEL_UNUSE2(t1, t2);
+	GFARM_TIMEVAL_FIX_INITIALIZE_WARNING(t1);
+	gfs_profile(gfarm_gettimerval(&t1));
+
+	e = gfs_pio_check_view_default(gf);
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+			"gfs_pio_check_view_default() failed: %s",
+			gfarm_error_string(e));
+		return (e);
+	}
+
+	CHECK_WRITABLE(gf);
+
+	e = (*gf->ops->view_pwritev)(gf, iov, iovcnt, &length);
+	if (e == GFARM_ERR_NO_ERROR)
+		*np = length;
+	else
+		gflog_debug(GFARM_MSG_UNFIXED,
+			"view_pwritev() failed: %s",
+			gfarm_error_string(e));
+
+	gfs_profile(gfarm_gettimerval(&t2));
+	gfs_profile(staticp->write_time += gfarm_timerval_sub(&t2, &t1));
+
+	return (e);
+}
+
+/*
+ * gfs_pio_aio_read() and gfs_pio_aio_write() send the request and
+ * return without waiting for the result.  the aiocb and its buffer
+ * must not be touched until gfs_pio_aio_error() stops returning
+ * GFARM_ERR_OPERATION_NOW_IN_PROGRESS, and gfs_pio_aio_return()
+ * must be called once for each request.
+ */
+gfarm_error_t
+gfs_pio_aio_read(GFS_File gf, struct gfs_pio_aiocb *cb)
+{
+	gfarm_error_t e;
+
+	e = gfs_pio_check_view_default(gf);
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+			"Check view default for pio failed: %s",
+			gfarm_error_string(e));
+		return (e);
+	}
+
+	CHECK_READABLE(gf);
+
+	cb->aio_handle = NULL;
+	cb->aio_error = GFARM_ERR_OPERATION_NOW_IN_PROGRESS;
+	cb->aio_return = 0;
+	e = (*gf->ops->view_aio_read)(gf, cb);
+	if (e != GFARM_ERR_NO_ERROR) {
+		cb->aio_error = e;
+		gflog_debug(GFARM_MSG_UNFIXED,
+			"view_aio_read() failed: %s",
+			gfarm_error_string(e));
+	}
+	return (e);
+}
+
+gfarm_error_t
+gfs_pio_aio_write(GFS_File gf, struct gfs_pio_aiocb *cb)
+{
+	gfarm_error_t e;
+
+	e = gfs_pio_check_view_default(gf);
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+			"gfs_pio_check_view_default() failed: %s",
+			gfarm_error_string(e));
+		return (e);
+	}
+
+	CHECK_WRITABLE(gf);
+
+	cb->aio_handle = NULL;
+	cb->aio_error = GFARM_ERR_OPERATION_NOW_IN_PROGRESS;
+	cb->aio_return = 0;
+	e = (*gf->ops->view_aio_write)(gf, cb);
+	if (e != GFARM_ERR_NO_ERROR) {
+		cb->aio_error = e;
+		gflog_debug(GFARM_MSG_UNFIXED,
+			"view_aio_write() failed: %s",
+			gfarm_error_string(e));
+	}
+	return (e);
+}
+
+static void
+gfs_pio_aio_finish(struct gfs_pio_aiocb *cb)
+{
+	size_t length;
+
+	cb->aio_error = gfs_client_aio_wait(cb->aio_handle, &length);
+	cb->aio_return = length;
+	cb->aio_handle = NULL;
+}
+
+/*
+ * this doesn't wait for a reply which hasn't arrived yet,
+ * but once a reply has started arriving, this blocks until the whole
+ * reply, e.g. the data of GFS_PROTO_PREAD, is received.
+ */
+gfarm_error_t
+gfs_pio_aio_error(struct gfs_pio_aiocb *cb)
+{
+	if (cb->aio_handle != NULL) {
+		if (!gfs_client_aio_poll(cb->aio_handle))
+			return (GFARM_ERR_OPERATION_NOW_IN_PROGRESS);
+		gfs_pio_aio_finish(cb);
+	}
+	return (cb->aio_error);
+}
+
+/* this waits for the completion of the request */
+gfarm_error_t
+gfs_pio_aio_return(struct gfs_pio_aiocb *cb, int *np)
+{
+	if (cb->aio_handle != NULL)
+		gfs_pio_aio_finish(cb);
+	*np = cb->aio_return;
+	return (cb->aio_error);
+}
+
 gfarm_error_t
 gfs_pio_append(GFS_File gf, void *buffer, int size, int *np, 
 		gfarm_off_t *offp, gfarm_off_t *fsizep)
@@ -26,6 +26,12 @@ struct gfs_pio_ops {
 	gfarm_error_t (*view_reopen)(GFS_File);
 	gfarm_error_t (*view_write)(GFS_File,
 		const char *, size_t, size_t *, gfarm_off_t *, gfarm_off_t *);
+	gfarm_error_t (*view_preadv)(GFS_File,
+		const struct gfs_pio_iovec *, int, size_t *);
+	gfarm_error_t (*view_pwritev)(GFS_File,
+		const struct gfs_pio_iovec *, int, size_t *);
+	gfarm_error_t (*view_aio_read)(GFS_File, struct gfs_pio_aiocb *);
+	gfarm_error_t (*view_aio_write)(GFS_File, struct gfs_pio_aiocb *);
 };
 
 struct gfm_connection;
@@ -107,6 +113,16 @@ struct gfs_storage_ops {
 	gfarm_error_t (*storage_reopen)(GFS_File);
 	gfarm_error_t (*storage_write)(GFS_File,
 		const char *, size_t, size_t *, gfarm_off_t *, gfarm_off_t *);
+	gfarm_error_t (*storage_preadv)(GFS_File,
+		const struct gfs_pio_iovec *, int, size_t *);
+	gfarm_error_t (*storage_pwritev)(GFS_File,
+		const struct gfs_pio_iovec *, int, size_t *);
+	/*
+	 * if aio_handle is set to NULL, the request has already completed,
+	 * otherwise it's a struct gfs_client_aio *.
+	 */
+	gfarm_error_t (*storage_aio_read)(GFS_File, struct gfs_pio_aiocb *);
+	gfarm_error_t (*storage_aio_write)(GFS_File, struct gfs_pio_aiocb *);
 };
 
 #define GFS_DEFAULT_DIGEST_NAME	"md5"
@@ -123,6 +139,10 @@ struct gfs_file_section_context {
 	int fd; /* local file descriptor. i.e. never used in remote case */
 	pid_t pid;
 
+	/* client read cache, only used in remote case */
+	int cache_enabled;
+	gfarm_uint64_t cache_gen;
+
 #ifdef EVP_MD_CTX_FLAG_ONESHOT /* for kernel mode */
 	/* for checksum, maintained only if GFS_FILE_MODE_CALC_DIGEST */
 	EVP_MD_CTX md_ctx;
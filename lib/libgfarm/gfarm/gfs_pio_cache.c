@@ -0,0 +1,491 @@
+/*
+ * client side read cache for remote files
+ *
+ * Data read from a remote gfsd is kept in local files under
+ * client_read_cache_directory, one file per GFS_PROTO_MAX_IOSIZE block:
+ *
+ *	<directory>/<uid>/<ino % 256>/<ino>-<gen>-<block>
+ *
+ * Since a new generation number is assigned to an inode whenever
+ * its content is modified, a cached block is never used for
+ * a different generation.  i.e. the cache provides close-to-open
+ * consistency.  Stale generations are simply expired by the LRU eviction.
+ *
+ * The cache directory and the statistics file <directory>/<uid>/iostat
+ * may be shared by several client processes of the user on the node.
+ * Because <directory> may be shared by users like /var/tmp, everything
+ * is accessed relative to the descriptor of the <uid> subdirectory,
+ * which is verified to be only accessible by the user, without following
+ * symbolic links.
+ *
+ * $Id$
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <gfarm/gfarm.h>
+#include <gfarm/gfarm_iostat.h>
+
+#include "context.h"
+#include "gfs_proto.h"	/* GFS_PROTO_MAX_IOSIZE */
+#include "gfs_client.h"
+#include "gfs_pio_cache.h"
+#include "iostat.h"
+
+#define CACHE_BLOCK_SIZE	GFS_PROTO_MAX_IOSIZE
+#define CACHE_NSUBDIRS		256
+#define CACHE_STAT_FILE		"iostat"
+
+#define CACHE_STATE_UNKNOWN	0
+#define CACHE_STATE_ENABLED	1
+#define CACHE_STATE_DISABLED	2
+
+#ifndef O_NOFOLLOW
+#define O_NOFOLLOW	0
+#endif
+#ifndef O_DIRECTORY
+#define O_DIRECTORY	0
+#endif
+
+struct gfarm_gfs_pio_cache_static {
+	int state;
+	int dir_fd; /* <directory>/<uid> */
+	struct gfarm_iostat_head *stat_hp;
+	struct gfarm_iostat_items *stat_ip;
+	size_t stat_size;
+};
+
+#define staticp	(gfarm_ctxp->gfs_pio_cache_static)
+
+static struct gfarm_iostat_spec cache_iostat_spec[] = {
+	{ "hit_count",	GFARM_IOSTAT_TYPE_TOTAL },
+	{ "hit_bytes",	GFARM_IOSTAT_TYPE_TOTAL },
+	{ "miss_count",	GFARM_IOSTAT_TYPE_TOTAL },
+	{ "miss_bytes",	GFARM_IOSTAT_TYPE_TOTAL },
+	{ "size",	GFARM_IOSTAT_TYPE_CURRENT },
+};
+
+gfarm_error_t
+gfarm_gfs_pio_cache_static_init(struct gfarm_context *ctxp)
+{
+	struct gfarm_gfs_pio_cache_static *s;
+
+	GFARM_MALLOC(s);
+	if (s == NULL)
+		return (GFARM_ERR_NO_MEMORY);
+
+	s->state = CACHE_STATE_UNKNOWN;
+	s->dir_fd = -1;
+	s->stat_hp = NULL;
+	s->stat_ip = NULL;
+	s->stat_size = 0;
+
+	ctxp->gfs_pio_cache_static = s;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+void
+gfarm_gfs_pio_cache_static_term(struct gfarm_context *ctxp)
+{
+	struct gfarm_gfs_pio_cache_static *s = ctxp->gfs_pio_cache_static;
+
+	if (s == NULL)
+		return;
+	if (s->stat_hp != NULL)
+		munmap(s->stat_hp, s->stat_size);
+	if (s->dir_fd != -1)
+		close(s->dir_fd);
+	free(s);
+	ctxp->gfs_pio_cache_static = NULL;
+}
+
+/* don't trust a file which others can modify */
+static int
+gfs_pio_cache_is_private(int fd, mode_t type)
+{
+	struct stat st;
+
+	return (fstat(fd, &st) == 0 && (st.st_mode & S_IFMT) == type &&
+	    st.st_uid == geteuid() && (st.st_mode & 077) == 0);
+}
+
+/* open <directory>/<uid>, which only the user can access */
+static gfarm_error_t
+gfs_pio_cache_open_dir(const char *dir, int *fdp, char **pathp)
+{
+	int fd;
+	char *path;
+	gfarm_error_t e;
+
+	/* the directory may be shared by users, like /var/tmp */
+	if (mkdir(dir, 0777) == 0)
+		(void)chmod(dir, 0777 | S_ISVTX);
+	else if (errno != EEXIST)
+		return (gfarm_errno_to_error(errno));
+
+	GFARM_MALLOC_ARRAY(path, strlen(dir) + 1 + GFARM_INT64STRLEN + 1 +
+	    sizeof(CACHE_STAT_FILE));
+	if (path == NULL)
+		return (GFARM_ERR_NO_MEMORY);
+	sprintf(path, "%s/%ld", dir, (long)geteuid());
+	if (mkdir(path, 0700) == -1 && errno != EEXIST) {
+		e = gfarm_errno_to_error(errno);
+		free(path);
+		return (e);
+	}
+	if ((fd = open(path, O_RDONLY|O_DIRECTORY|O_NOFOLLOW)) == -1) {
+		e = gfarm_errno_to_error(errno);
+		free(path);
+		return (e);
+	}
+	if (!gfs_pio_cache_is_private(fd, S_IFDIR)) {
+		close(fd);
+		free(path);
+		return (GFARM_ERR_PERMISSION_DENIED);
+	}
+	(void)fcntl(fd, F_SETFD, FD_CLOEXEC);
+	*fdp = fd;
+	*pathp = path;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+int
+gfs_pio_cache_is_enabled(void)
+{
+	struct gfarm_gfs_pio_cache_static *s = staticp;
+	const char *dir = gfarm_ctxp->client_read_cache_directory;
+	char *path = NULL;
+	gfarm_error_t e;
+
+	if (s->state != CACHE_STATE_UNKNOWN)
+		return (s->state == CACHE_STATE_ENABLED);
+
+	s->state = CACHE_STATE_DISABLED;
+	if (dir == NULL || gfarm_ctxp->client_read_cache_size <= 0)
+		return (0);
+	if ((e = gfs_pio_cache_open_dir(dir, &s->dir_fd, &path)) !=
+	    GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "client_read_cache_directory %s: %s",
+		    dir, gfarm_error_string(e));
+		return (0);
+	}
+	strcat(path, "/" CACHE_STAT_FILE);
+	e = gfarm_iostat_mmap_shared(path, cache_iostat_spec,
+	    GFARM_IOSTAT_CACHE_NITEM, &s->stat_hp, &s->stat_size);
+	free(path);
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "client read cache disabled: %s", gfarm_error_string(e));
+		close(s->dir_fd);
+		s->dir_fd = -1;
+		return (0);
+	}
+	s->stat_ip = (struct gfarm_iostat_items *)
+	    ((char *)s->stat_hp + s->stat_hp->s_item_off);
+	s->state = CACHE_STATE_ENABLED;
+	return (1);
+}
+
+/* the statistics file is updated by several processes at the same time */
+static void
+gfs_pio_cache_stat_add(unsigned int cat, gfarm_int64_t val)
+{
+	struct gfarm_gfs_pio_cache_static *s = staticp;
+
+	(void)__sync_fetch_and_add(&s->stat_ip->s_vals[cat], val);
+	s->stat_hp->s_update_sec = time(NULL);
+}
+
+/*
+ * eviction
+ */
+
+struct cache_entry {
+	char *path; /* relative to dir_fd */
+	time_t mtime;
+	gfarm_off_t size;
+};
+
+static int
+cache_entry_compare_by_mtime(const void *a, const void *b)
+{
+	const struct cache_entry *p = a, *q = b;
+
+	return (p->mtime < q->mtime ? -1 : p->mtime > q->mtime ? 1 : 0);
+}
+
+static gfarm_error_t
+gfs_pio_cache_scan_subdir(const char *subdir,
+	struct cache_entry **entriesp, int *nentriesp, int *nallocp,
+	gfarm_off_t *totalp)
+{
+	DIR *dirp;
+	struct dirent *dp;
+	struct stat st;
+	struct cache_entry *entries = *entriesp, *tmp;
+	int n = *nentriesp, nalloc = *nallocp, fd;
+	char *path;
+
+	fd = openat(staticp->dir_fd, subdir, O_RDONLY|O_DIRECTORY|O_NOFOLLOW);
+	if (fd == -1)
+		return (GFARM_ERR_NO_ERROR); /* not created yet */
+	if ((dirp = fdopendir(fd)) == NULL) {
+		close(fd);
+		return (GFARM_ERR_NO_ERROR);
+	}
+	while ((dp = readdir(dirp)) != NULL) {
+		if (dp->d_name[0] == '.')
+			continue;
+		if (fstatat(fd, dp->d_name, &st, AT_SYMLINK_NOFOLLOW) == -1 ||
+		    !S_ISREG(st.st_mode))
+			continue;
+		GFARM_MALLOC_ARRAY(path,
+		    strlen(subdir) + 1 + strlen(dp->d_name) + 1);
+		if (path == NULL)
+			break;
+		sprintf(path, "%s/%s", subdir, dp->d_name);
+		if (n >= nalloc) {
+			nalloc = nalloc == 0 ? 1024 : nalloc * 2;
+			GFARM_REALLOC_ARRAY(tmp, entries, nalloc);
+			if (tmp == NULL) {
+				free(path);
+				break;
+			}
+			entries = tmp;
+		}
+		entries[n].path = path;
+		entries[n].mtime = st.st_mtime;
+		entries[n].size = st.st_size;
+		*totalp += st.st_size;
+		n++;
+	}
+	closedir(dirp); /* this closes fd as well */
+	*entriesp = entries;
+	*nentriesp = n;
+	*nallocp = nalloc;
+	return (dp == NULL ? GFARM_ERR_NO_ERROR : GFARM_ERR_NO_MEMORY);
+}
+
+/*
+ * remove least recently used blocks until the total size becomes
+ * 90% of client_read_cache_size.
+ * only one process on the node performs this at a time.
+ */
+static void
+gfs_pio_cache_evict(void)
+{
+	gfarm_off_t limit = gfarm_ctxp->client_read_cache_size;
+	gfarm_off_t total = 0;
+	struct cache_entry *entries = NULL;
+	int i, fd, nentries = 0, nalloc = 0;
+	char subdir[3];
+	struct flock lock;
+	gfarm_error_t e = GFARM_ERR_NO_ERROR;
+
+	fd = openat(staticp->dir_fd, CACHE_STAT_FILE, O_RDWR|O_NOFOLLOW);
+	if (fd == -1)
+		return;
+	memset(&lock, 0, sizeof(lock));
+	lock.l_type = F_WRLCK;
+	lock.l_whence = SEEK_SET;
+	if (fcntl(fd, F_SETLK, &lock) == -1) {
+		close(fd); /* someone else is evicting */
+		return;
+	}
+
+	for (i = 0; e == GFARM_ERR_NO_ERROR && i < CACHE_NSUBDIRS; i++) {
+		sprintf(subdir, "%02x", i);
+		e = gfs_pio_cache_scan_subdir(subdir,
+		    &entries, &nentries, &nalloc, &total);
+	}
+
+	if (e == GFARM_ERR_NO_ERROR) {
+		qsort(entries, nentries, sizeof(*entries),
+		    cache_entry_compare_by_mtime);
+		for (i = 0; i < nentries && total > limit - limit / 10; i++) {
+			if (unlinkat(staticp->dir_fd, entries[i].path, 0) == 0)
+				total -= entries[i].size;
+		}
+		/* correct the drift caused by racy updates */
+		staticp->stat_ip->s_vals[GFARM_IOSTAT_CACHE_SIZE] = total;
+	} else
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "client read cache eviction: %s", gfarm_error_string(e));
+	for (i = 0; i < nentries; i++)
+		free(entries[i].path);
+	free(entries);
+	close(fd); /* this releases the lock */
+}
+
+/*
+ * cache blocks
+ */
+
+/* relative to dir_fd */
+static char *
+gfs_pio_cache_block_path(gfarm_ino_t ino, gfarm_uint64_t gen,
+	gfarm_off_t block)
+{
+	char *path;
+
+	GFARM_MALLOC_ARRAY(path, 2 + 1 + GFARM_INT64STRLEN * 3 + 2 + 1);
+	if (path != NULL)
+		sprintf(path, "%02x/%llu-%llu-%llu",
+		    (unsigned int)(ino % CACHE_NSUBDIRS),
+		    (unsigned long long)ino, (unsigned long long)gen,
+		    (unsigned long long)block);
+	return (path);
+}
+
+static int
+gfs_pio_cache_lookup(const char *path,
+	char *buffer, size_t size, gfarm_off_t off, size_t *lengthp)
+{
+	int fd;
+	ssize_t rv;
+
+	if ((fd = openat(staticp->dir_fd, path, O_RDONLY|O_NOFOLLOW)) == -1)
+		return (0);
+	if (!gfs_pio_cache_is_private(fd, S_IFREG)) {
+		close(fd);
+		return (0);
+	}
+	rv = pread(fd, buffer, size, off);
+	if (rv != -1)
+		(void)futimens(fd, NULL); /* for LRU */
+	close(fd);
+	if (rv == -1)
+		return (0);
+	*lengthp = rv;
+	return (1);
+}
+
+static void
+gfs_pio_cache_store(const char *path, const char *data, size_t size)
+{
+	char *tmp, *slash;
+	int fd;
+	ssize_t rv;
+	size_t done;
+
+	GFARM_MALLOC_ARRAY(tmp, strlen(path) + 5 + GFARM_INT32STRLEN + 1);
+	if (tmp == NULL)
+		return;
+	sprintf(tmp, "%s.tmp.%ld", path, (long)getpid());
+	if ((fd = openat(staticp->dir_fd, tmp,
+	    O_CREAT|O_EXCL|O_WRONLY|O_NOFOLLOW, 0600)) == -1 &&
+	    errno == ENOENT) {
+		/* create the subdirectory, and retry */
+		slash = strrchr(tmp, '/');
+		*slash = '\0';
+		(void)mkdirat(staticp->dir_fd, tmp, 0700);
+		*slash = '/';
+		fd = openat(staticp->dir_fd, tmp,
+		    O_CREAT|O_EXCL|O_WRONLY|O_NOFOLLOW, 0600);
+	}
+	if (fd == -1) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "client read cache %s: %s", tmp, strerror(errno));
+		free(tmp);
+		return;
+	}
+	for (done = 0; done < size; done += rv) {
+		if ((rv = write(fd, data + done, size - done)) == -1)
+			break;
+	}
+	if (close(fd) == -1 || done < size ||
+	    renameat(staticp->dir_fd, tmp, staticp->dir_fd, path) == -1) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "client read cache %s: %s", path, strerror(errno));
+		unlinkat(staticp->dir_fd, tmp, 0);
+	} else
+		gfs_pio_cache_stat_add(GFARM_IOSTAT_CACHE_SIZE, size);
+	free(tmp);
+}
+
+/*
+ * read a block containing the offset through the cache.
+ * this may return less than the requested size, the upper gfs_pio layer
+ * takes care of the partial read.
+ */
+gfarm_error_t
+gfs_pio_cache_pread(struct gfs_connection *gfs_server, gfarm_int32_t fd,
+	gfarm_ino_t ino, gfarm_uint64_t gen,
+	char *buffer, size_t size, gfarm_off_t offset, size_t *lengthp)
+{
+	gfarm_error_t e;
+	gfarm_off_t block = offset / CACHE_BLOCK_SIZE;
+	gfarm_off_t block_offset = block * CACHE_BLOCK_SIZE;
+	size_t off_in_block = offset - block_offset, len, n;
+	char *path, *data;
+
+	if (size > CACHE_BLOCK_SIZE - off_in_block)
+		size = CACHE_BLOCK_SIZE - off_in_block;
+
+	if ((path = gfs_pio_cache_block_path(ino, gen, block)) == NULL)
+		return (gfs_client_pread(gfs_server, fd, buffer, size, offset,
+		    lengthp));
+	if (gfs_pio_cache_lookup(path, buffer, size, off_in_block, lengthp)) {
+		free(path);
+		gfs_pio_cache_stat_add(GFARM_IOSTAT_CACHE_HIT_COUNT, 1);
+		gfs_pio_cache_stat_add(GFARM_IOSTAT_CACHE_HIT_BYTES, *lengthp);
+		return (GFARM_ERR_NO_ERROR);
+	}
+
+	/* fetch the whole block, directly into the buffer if possible */
+	if (off_in_block == 0 && size == CACHE_BLOCK_SIZE)
+		data = buffer;
+	else {
+		GFARM_MALLOC_ARRAY(data, CACHE_BLOCK_SIZE);
+		if (data == NULL) {
+			free(path);
+			return (gfs_client_pread(gfs_server, fd,
+			    buffer, size, offset, lengthp));
+		}
+	}
+	for (len = 0; len < CACHE_BLOCK_SIZE; len += n) {
+		e = gfs_client_pread(gfs_server, fd, data + len,
+		    CACHE_BLOCK_SIZE - len, block_offset + len, &n);
+		if (e != GFARM_ERR_NO_ERROR) {
+			gflog_debug(GFARM_MSG_UNFIXED,
+			    "gfs_client_pread: %s", gfarm_error_string(e));
+			if (data != buffer)
+				free(data);
+			free(path);
+			return (e);
+		}
+		if (n == 0) /* EOF */
+			break;
+	}
+	gfs_pio_cache_stat_add(GFARM_IOSTAT_CACHE_MISS_COUNT, 1);
+	gfs_pio_cache_stat_add(GFARM_IOSTAT_CACHE_MISS_BYTES, len);
+
+	gfs_pio_cache_store(path, data, len);
+	free(path);
+
+	if (data != buffer) {
+		n = off_in_block < len ? len - off_in_block : 0;
+		if (n > size)
+			n = size;
+		memcpy(buffer, data + off_in_block, n);
+		free(data);
+		*lengthp = n;
+	} else
+		*lengthp = len;
+
+	if (staticp->stat_ip->s_vals[GFARM_IOSTAT_CACHE_SIZE] >
+	    gfarm_ctxp->client_read_cache_size)
+		gfs_pio_cache_evict();
+	return (GFARM_ERR_NO_ERROR);
+}
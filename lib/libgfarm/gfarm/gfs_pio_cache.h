@@ -0,0 +1,10 @@
+/*
+ * $Id$
+ */
+
+struct gfs_connection;
+
+/* gfs_pio_cache.c */
+int gfs_pio_cache_is_enabled(void);
+gfarm_error_t gfs_pio_cache_pread(struct gfs_connection *, gfarm_int32_t,
+	gfarm_ino_t, gfarm_uint64_t, char *, size_t, gfarm_off_t, size_t *);
@@ -230,6 +230,72 @@ gfs_pio_local_storage_pread(GFS_File gf,
 	return (GFARM_ERR_NO_ERROR);
 }
 
+static gfarm_error_t
+gfs_pio_local_storage_vector(GFS_File gf, int is_write,
+	const struct gfs_pio_iovec *iov, int iovcnt, size_t *lengthp)
+{
+	gfarm_error_t e = GFARM_ERR_NO_ERROR;
+	size_t n = 0, length;
+	int i;
+
+	for (i = 0; i < iovcnt; i++) {
+		if (is_write)
+			e = gfs_pio_local_storage_pwrite(gf, iov[i].iov_base,
+			    iov[i].iov_len, iov[i].iov_offset, &length);
+		else
+			e = gfs_pio_local_storage_pread(gf, iov[i].iov_base,
+			    iov[i].iov_len, iov[i].iov_offset, &length);
+		if (e != GFARM_ERR_NO_ERROR)
+			break;
+		n += length;
+		if (length < iov[i].iov_len) /* short transfer */
+			break;
+	}
+	if (e != GFARM_ERR_NO_ERROR && n == 0)
+		return (e);
+	*lengthp = n;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static gfarm_error_t
+gfs_pio_local_storage_preadv(GFS_File gf,
+	const struct gfs_pio_iovec *iov, int iovcnt, size_t *lengthp)
+{
+	return (gfs_pio_local_storage_vector(gf, 0, iov, iovcnt, lengthp));
+}
+
+static gfarm_error_t
+gfs_pio_local_storage_pwritev(GFS_File gf,
+	const struct gfs_pio_iovec *iov, int iovcnt, size_t *lengthp)
+{
+	return (gfs_pio_local_storage_vector(gf, 1, iov, iovcnt, lengthp));
+}
+
+/* the local storage completes the request immediately */
+static gfarm_error_t
+gfs_pio_local_storage_aio_read(GFS_File gf, struct gfs_pio_aiocb *cb)
+{
+	size_t length = 0;
+
+	cb->aio_handle = NULL;
+	cb->aio_error = gfs_pio_local_storage_pread(gf, cb->aio_buf,
+	    cb->aio_nbytes, cb->aio_offset, &length);
+	cb->aio_return = length;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static gfarm_error_t
+gfs_pio_local_storage_aio_write(GFS_File gf, struct gfs_pio_aiocb *cb)
+{
+	size_t length = 0;
+
+	cb->aio_handle = NULL;
+	cb->aio_error = gfs_pio_local_storage_pwrite(gf, cb->aio_buf,
+	    cb->aio_nbytes, cb->aio_offset, &length);
+	cb->aio_return = length;
+	return (GFARM_ERR_NO_ERROR);
+}
+
 static gfarm_error_t
 gfs_pio_local_storage_ftruncate(GFS_File gf, gfarm_off_t length)
 {
@@ -344,6 +410,10 @@ struct gfs_storage_ops gfs_pio_local_storage_ops = {
 	gfs_pio_local_storage_fstat,
 	gfs_pio_local_storage_reopen,
 	gfs_pio_local_storage_write,
+	gfs_pio_local_storage_preadv,
+	gfs_pio_local_storage_pwritev,
+	gfs_pio_local_storage_aio_read,
+	gfs_pio_local_storage_aio_write,
 };
 
 gfarm_error_t
@@ -20,6 +20,7 @@
 #include "gfs_client.h"
 #include "gfs_io.h"
 #include "gfs_pio.h"
+#include "gfs_pio_cache.h"
 #include "schedule.h"
 
 static gfarm_error_t
@@ -106,10 +107,66 @@ gfs_pio_remote_storage_pread(GFS_File gf,
 	 * performed by gfsd isn't inefficient for read case.
 	 * Note that upper gfs_pio layer should care the partial read.
 	 */
+#ifndef __KERNEL__
+	if (vc->cache_enabled)
+		return (gfs_pio_cache_pread(gfs_server, gf->fd,
+		    gf->ino, vc->cache_gen, buffer, size, offset, lengthp));
+#endif /* __KERNEL__ */
 	return (gfs_client_pread(gfs_server, gf->fd, buffer, size, offset,
 	    lengthp));
 }
 
+static gfarm_error_t
+gfs_pio_remote_storage_preadv(GFS_File gf,
+	const struct gfs_pio_iovec *iov, int iovcnt, size_t *lengthp)
+{
+	struct gfs_file_section_context *vc = gf->view_context;
+	struct gfs_connection *gfs_server = vc->storage_context;
+
+	return (gfs_client_preadv(gfs_server, gf->fd, iov, iovcnt, lengthp));
+}
+
+static gfarm_error_t
+gfs_pio_remote_storage_pwritev(GFS_File gf,
+	const struct gfs_pio_iovec *iov, int iovcnt, size_t *lengthp)
+{
+	struct gfs_file_section_context *vc = gf->view_context;
+	struct gfs_connection *gfs_server = vc->storage_context;
+
+	return (gfs_client_pwritev(gfs_server, gf->fd, iov, iovcnt, lengthp));
+}
+
+static gfarm_error_t
+gfs_pio_remote_storage_aio_read(GFS_File gf, struct gfs_pio_aiocb *cb)
+{
+	struct gfs_file_section_context *vc = gf->view_context;
+	struct gfs_connection *gfs_server = vc->storage_context;
+	struct gfs_client_aio *aio;
+	gfarm_error_t e;
+
+	e = gfs_client_aio_pread(gfs_server, gf->fd,
+	    cb->aio_buf, cb->aio_nbytes, cb->aio_offset, &aio);
+	if (e == GFARM_ERR_NO_ERROR)
+		cb->aio_handle = aio;
+	return (e);
+}
+
+static gfarm_error_t
+gfs_pio_remote_storage_aio_write(GFS_File gf, struct gfs_pio_aiocb *cb)
+{
+	struct gfs_file_section_context *vc = gf->view_context;
+	struct gfs_connection *gfs_server = vc->storage_context;
+	struct gfs_client_aio *aio;
+	gfarm_error_t e;
+
+	/* a partial write is reported by gfs_pio_aio_return() */
+	e = gfs_client_aio_pwrite(gfs_server, gf->fd,
+	    cb->aio_buf, cb->aio_nbytes, cb->aio_offset, &aio);
+	if (e == GFARM_ERR_NO_ERROR)
+		cb->aio_handle = aio;
+	return (e);
+}
+
 static gfarm_error_t
 gfs_pio_remote_storage_ftruncate(GFS_File gf, gfarm_off_t length)
 {
@@ -172,6 +229,10 @@ struct gfs_storage_ops gfs_pio_remote_storage_ops = {
 	gfs_pio_remote_storage_fstat,
 	gfs_pio_remote_storage_reopen,
 	gfs_pio_remote_storage_write,
+	gfs_pio_remote_storage_preadv,
+	gfs_pio_remote_storage_pwritev,
+	gfs_pio_remote_storage_aio_read,
+	gfs_pio_remote_storage_aio_write,
 };
 
 gfarm_error_t
@@ -192,5 +253,22 @@ gfs_pio_open_remote_section(GFS_File gf, struct gfs_connection *gfs_server)
 	vc->storage_context = gfs_server;
 	vc->fd = -1; /* not used */
 	vc->pid = getpid();
+	vc->cache_enabled = 0;
+#ifndef __KERNEL__
+	/* the generation number identifies the content of a read-only file */
+	if ((gf->open_flags & GFARM_FILE_ACCMODE) == GFARM_FILE_RDONLY &&
+	    gfs_pio_cache_is_enabled()) {
+		struct gfs_stat st;
+
+		if ((e = gfs_fstat(gf, &st)) == GFARM_ERR_NO_ERROR) {
+			vc->cache_gen = st.st_gen;
+			vc->cache_enabled = 1;
+			gfs_stat_free(&st);
+		} else
+			gflog_debug(GFARM_MSG_UNFIXED,
+			    "gfs_fstat: %s, read cache is not used",
+			    gfarm_error_string(e));
+	}
+#endif /* __KERNEL__ */
 	return (GFARM_ERR_NO_ERROR);
 }
@@ -337,6 +337,52 @@ gfs_pio_view_section_fd(GFS_File gf)
 	return ((*vc->ops->storage_fd)(gf));
 }
 
+static gfarm_error_t
+gfs_pio_view_section_preadv(GFS_File gf,
+	const struct gfs_pio_iovec *iov, int iovcnt, size_t *lengthp)
+{
+	struct gfs_file_section_context *vc = gf->view_context;
+	gfarm_error_t e = (*vc->ops->storage_preadv)(gf, iov, iovcnt, lengthp);
+
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+			"storage_preadv failed: %s",
+			gfarm_error_string(e));
+	}
+	return (e);
+}
+
+static gfarm_error_t
+gfs_pio_view_section_pwritev(GFS_File gf,
+	const struct gfs_pio_iovec *iov, int iovcnt, size_t *lengthp)
+{
+	struct gfs_file_section_context *vc = gf->view_context;
+	gfarm_error_t e = (*vc->ops->storage_pwritev)(gf, iov, iovcnt, lengthp);
+
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+			"storage_pwritev failed: %s",
+			gfarm_error_string(e));
+	}
+	return (e);
+}
+
+static gfarm_error_t
+gfs_pio_view_section_aio_read(GFS_File gf, struct gfs_pio_aiocb *cb)
+{
+	struct gfs_file_section_context *vc = gf->view_context;
+
+	return ((*vc->ops->storage_aio_read)(gf, cb));
+}
+
+static gfarm_error_t
+gfs_pio_view_section_aio_write(GFS_File gf, struct gfs_pio_aiocb *cb)
+{
+	struct gfs_file_section_context *vc = gf->view_context;
+
+	return ((*vc->ops->storage_aio_write)(gf, cb));
+}
+
 struct gfs_pio_ops gfs_pio_view_section_ops = {
 	gfs_pio_view_section_close,
 	gfs_pio_view_section_fd,
@@ -347,6 +393,10 @@ struct gfs_pio_ops gfs_pio_view_section_ops = {
 	gfs_pio_view_section_fstat,
 	gfs_pio_view_section_reopen,
 	gfs_pio_view_section_write,
+	gfs_pio_view_section_preadv,
+	gfs_pio_view_section_pwritev,
+	gfs_pio_view_section_aio_read,
+	gfs_pio_view_section_aio_write,
 };
 
 
@@ -8,10 +8,14 @@
 /*
  * 1: protocol until gfarm 2.3
  * 2: protocol since gfarm 2.4
+ * 3: GFS_PROTO_FHREMOVE_MULTI is supported
+ * 4: GFS_PROTO_STATUS2 and GFM_PROTO_HOST_STATUS_REPORT are supported
  */
 #define GFS_PROTOCOL_VERSION_V2_3	1
 #define GFS_PROTOCOL_VERSION_V2_4	2
-#define GFS_PROTOCOL_VERSION		GFS_PROTOCOL_VERSION_V2_4
+#define GFS_PROTOCOL_VERSION_V2_7	3
+#define GFS_PROTOCOL_VERSION_V2_8	4
+#define GFS_PROTOCOL_VERSION		GFS_PROTOCOL_VERSION_V2_8
 
 enum gfs_proto_command {
 	/* from client */
@@ -55,10 +59,62 @@ enum gfs_proto_command {
 	/* from client */
 	GFS_PROTO_PROCESS_RESET,
 	GFS_PROTO_WRITE,
+
+	/* from gfmd */
+	GFS_PROTO_FHREMOVE_MULTI,
+	GFS_PROTO_STATUS2,
+
+	/* from client */
+	GFS_PROTO_REPLICA_ADD_FROM_RELAY,
+
+	/* from gfsd */
+	GFS_PROTO_FHOPEN_RELAY,
 };
 
 #define GFS_PROTO_MAX_IOSIZE	(1024 * 1024)
 
+/*
+ * GFS_PROTO_FHREMOVE_MULTI
+ *
+ * request: "ib" number of replicas, and array of (inode, generation)
+ *	each of them is encoded as two big endian 64bit integers.
+ * reply: "b" array of gfarm_error_t of each replica
+ *	each of them is encoded as a big endian 32bit integer.
+ */
+#define GFS_PROTO_FHREMOVE_MULTI_MAX	4096
+#define GFS_PROTO_FHREMOVE_MULTI_ENTRY_SIZE \
+	(sizeof(gfarm_uint64_t) * 2)
+#define GFS_PROTO_FHREMOVE_MULTI_RESULT_SIZE	sizeof(gfarm_int32_t)
+
+/*
+ * GFS_PROTO_STATUS2
+ *
+ * request: none
+ * reply: "b" whole status encoded by gfm_proto_host_status_encode().
+ * once gfsd receives this request, it pushes the changes of its status
+ * to gfmd by GFM_PROTO_HOST_STATUS_REPORT, which has the same encoding.
+ */
+
+/*
+ * GFS_PROTO_REPLICA_ADD_FROM_RELAY
+ *
+ * request: "sisii" source host, source port, relay host, relay port, and fd
+ * reply: none
+ * same as GFS_PROTO_REPLICA_ADD_FROM, but the data is received from
+ * the relay host, which is creating the replica from the source host
+ * at the same time.  the source host is reported to gfmd as the origin.
+ * if the relay host is "", the data is received from the source host,
+ * and the replica can be relayed to other hosts while it is being created.
+ *
+ * GFS_PROTO_FHOPEN_RELAY
+ *
+ * request: "ll" inode and generation
+ * reply: "i" fd
+ * same as GFS_PROTO_FHOPEN, but waits for the replica to be created
+ * by GFS_PROTO_REPLICA_ADD_FROM_RELAY, and GFS_PROTO_PREAD to the fd
+ * waits for the data which has not been received yet.
+ */
+
 /*
  * sub protocols of GFS_PROTO_COMMAND
  */
@@ -264,6 +264,114 @@ gfs_replicate_to(char *file, char *dsthost, int dstport)
 	return (gfs_replicate_to_internal(file, dsthost, dstport, 0));
 }
 
+/*
+ * replicate a file to ndsts distinct hosts by a chained replication,
+ * source -> dsthosts[0] -> dsthosts[1] -> ..., where each host relays
+ * the replica which is being received to the next host, thus the source
+ * sends the data only once and all hops run concurrently.
+ * if a hop fails, e.g. the gfsd is too old to relay, the host receives
+ * the replica directly from the source instead.
+ * the result of each hop is stored in errs[], and the first error is
+ * returned.
+ */
+gfarm_error_t
+gfs_replicate_chain_to(char *file, int ndsts, char **dsthosts, int *dstports,
+	gfarm_error_t *errs)
+{
+	gfarm_error_t e, e2;
+	GFS_File *gfs;
+	struct gfm_connection *gfm_server;
+	struct gfs_connection **gfs_servers;
+	struct gfp_xdr_xid_record **xidrs;
+	char *srchost, *relayhost;
+	int i, srcport, relayport, nopened, scheduled = 0;
+
+	if (ndsts == 1) {
+		errs[0] = gfs_replicate_to(file, dsthosts[0], dstports[0]);
+		return (errs[0]);
+	}
+	GFARM_MALLOC_ARRAY(gfs, ndsts);
+	GFARM_MALLOC_ARRAY(gfs_servers, ndsts);
+	GFARM_MALLOC_ARRAY(xidrs, ndsts);
+	if (gfs == NULL || gfs_servers == NULL || xidrs == NULL) {
+		free(gfs);
+		free(gfs_servers);
+		free(xidrs);
+		return (GFARM_ERR_NO_MEMORY);
+	}
+
+	/* a replication source is limited to one per descriptor in gfmd */
+	for (nopened = 0; nopened < ndsts; nopened++) {
+		e = gfs_pio_open(file, GFARM_FILE_RDONLY, &gfs[nopened]);
+		if (e != GFARM_ERR_NO_ERROR) {
+			gflog_debug(GFARM_MSG_UNFIXED,
+			    "gfs_pio_open(%s) failed: %s",
+			    file, gfarm_error_string(e));
+			goto close;
+		}
+	}
+	e = gfarm_schedule_file(gfs[0], &srchost, &srcport);
+	if (e != GFARM_ERR_NO_ERROR)
+		goto close;
+
+	scheduled = 1;
+	relayhost = "";
+	relayport = 0;
+	for (i = 0; i < ndsts; i++) {
+		gfm_server = gfs_pio_metadb(gfs[i]);
+		errs[i] = gfs_client_connection_and_process_acquire(
+		    &gfm_server, dsthosts[i], dstports[i], &gfs_servers[i],
+		    NULL);
+		if (errs[i] != GFARM_ERR_NO_ERROR)
+			continue;
+		errs[i] = gfs_client_replica_add_from_relay_request(
+		    gfs_servers[i], srchost, srcport, relayhost, relayport,
+		    gfs_pio_fileno(gfs[i]), &xidrs[i]);
+		if (errs[i] != GFARM_ERR_NO_ERROR) {
+			gfs_client_connection_free(gfs_servers[i]);
+			continue;
+		}
+		relayhost = dsthosts[i];
+		relayport = dstports[i];
+	}
+	for (i = 0; i < ndsts; i++) {
+		if (errs[i] != GFARM_ERR_NO_ERROR)
+			continue;
+		errs[i] = gfs_client_replica_add_from_relay_result(
+		    gfs_servers[i], xidrs[i]);
+		gfs_client_connection_free(gfs_servers[i]);
+	}
+
+	/* fall back to the replication from the source */
+	for (i = 0; i < ndsts; i++) {
+		if (errs[i] == GFARM_ERR_NO_ERROR)
+			continue;
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "chained replication of %s to %s:%d: %s, "
+		    "replicating from %s:%d", file, dsthosts[i], dstports[i],
+		    gfarm_error_string(errs[i]), srchost, srcport);
+		errs[i] = gfs_replicate_from_to_internal(gfs[i],
+		    srchost, srcport, dsthosts[i], dstports[i]);
+		if (e == GFARM_ERR_NO_ERROR)
+			e = errs[i];
+	}
+	free(srchost);
+ close:
+	for (i = 0; i < nopened; i++) {
+		e2 = gfs_pio_close(gfs[i]);
+		if (e == GFARM_ERR_NO_ERROR)
+			e = e2;
+	}
+	if (!scheduled) {
+		for (i = 0; i < ndsts; i++)
+			errs[i] = e;
+	}
+	free(gfs);
+	free(gfs_servers);
+	free(xidrs);
+	return (e);
+}
+
 gfarm_error_t
 gfs_migrate_to(char *file, char *dsthost, int dstport)
 {
@@ -176,6 +176,53 @@ gfs_fstat(GFS_File gf, struct gfs_stat *s)
 	return (e);
 }
 
+static gfarm_error_t
+gfm_dir_usage_request(struct gfm_connection *gfm_server,
+	struct gfp_xdr_context *ctx, void *closure)
+{
+	gfarm_error_t e = gfm_client_dir_usage_get_request(gfm_server, ctx);
+
+	if (e != GFARM_ERR_NO_ERROR)
+		gflog_warning(GFARM_MSG_UNFIXED,
+		    "dir_usage_get request: %s", gfarm_error_string(e));
+	return (e);
+}
+
+static gfarm_error_t
+gfm_dir_usage_result(struct gfm_connection *gfm_server,
+	struct gfp_xdr_context *ctx, void *closure)
+{
+	return (gfm_client_dir_usage_get_result(gfm_server, ctx, closure));
+}
+
+/*
+ * the total usage of the files and directories under the directory,
+ * which is maintained by gfmd, thus, this doesn't traverse the directory.
+ */
+gfarm_error_t
+gfs_dir_usage(const char *path, struct gfs_dir_usage *usage)
+{
+	gfarm_error_t e;
+
+	/*
+	 * requires the read permission, as well as reading the directory.
+	 * besides, only the owner of the directory and the administrator
+	 * are permitted, because the usage includes unreadable subtrees.
+	 */
+	e = gfm_inode_op_readonly(path, GFARM_FILE_RDONLY,
+	    gfm_dir_usage_request,
+	    gfm_dir_usage_result,
+	    gfm_inode_success_op_connection_free,
+	    NULL,
+	    usage);
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "gfm_inode_op(%s) failed: %s",
+		    path, gfarm_error_string(e));
+	}
+	return (e);
+}
+
 void
 gfs_stat_display_timers(void)
 {
@@ -51,9 +51,17 @@ struct known_network {
 	struct gfarm_hostspec *network;
 };
 
+struct network_location {
+	struct network_location *next;
+	struct gfarm_hostspec *network;
+	char *location;
+};
+
 struct gfarm_host_static {
 	struct known_network *known_network_list;
 	struct known_network **known_network_list_last;
+	struct network_location *network_location_list;
+	struct network_location **network_location_list_last;
 
 	/* gfarm_host_get_self_name() */
 	int initialized;
@@ -76,6 +84,8 @@ gfarm_host_static_init(struct gfarm_context *ctxp)
 
 	s->known_network_list = NULL;
 	s->known_network_list_last = &s->known_network_list;
+	s->network_location_list = NULL;
+	s->network_location_list_last = &s->network_location_list;
 
 	s->initialized = 0;
 	memset(s->hostname, 0, sizeof(s->hostname));
@@ -92,6 +102,7 @@ gfarm_host_static_term(struct gfarm_context *ctxp)
 {
 	struct gfarm_host_static *s = ctxp->host_static;
 	struct known_network *n, *next;
+	struct network_location *l, *lnext;
 
 	if (s == NULL)
 		return;
@@ -101,6 +112,12 @@ gfarm_host_static_term(struct gfarm_context *ctxp)
 		gfarm_hostspec_free(n->network);
 		free(n);
 	}
+	for (l = s->network_location_list; l != NULL; l = lnext) {
+		lnext = l->next;
+		gfarm_hostspec_free(l->network);
+		free(l->location);
+		free(l);
+	}
 	free(s->canonical_self_name);
 	free(s);
 }
@@ -963,6 +980,44 @@ gfarm_known_network_list_add_local_host(void)
 	return (e);
 }
 
+gfarm_error_t
+gfarm_network_location_add(struct gfarm_hostspec *network,
+	const char *location)
+{
+	struct network_location *l;
+
+	GFARM_MALLOC(l);
+	if (l == NULL)
+		return (GFARM_ERR_NO_MEMORY);
+	l->location = strdup(location);
+	if (l->location == NULL) {
+		free(l);
+		return (GFARM_ERR_NO_MEMORY);
+	}
+	l->network = network;
+	l->next = NULL;
+	*staticp->network_location_list_last = l;
+	staticp->network_location_list_last = &l->next;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/*
+ * returns the location of the address in the network topology,
+ * such as "/dc1/spine1/rack3", or NULL if it's not configured.
+ * shouldn't free the return value of this function.
+ */
+const char *
+gfarm_addr_network_location_get(struct sockaddr *addr)
+{
+	struct network_location *l;
+
+	for (l = staticp->network_location_list; l != NULL; l = l->next) {
+		if (gfarm_hostspec_match(l->network, NULL, addr))
+			return (l->location);
+	}
+	return (NULL);
+}
+
 gfarm_error_t
 gfarm_addr_network_get(struct sockaddr *addr,
 	struct gfarm_hostspec **networkp)
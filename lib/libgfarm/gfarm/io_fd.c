@@ -11,6 +11,7 @@
 #include <sys/time.h>
 #endif
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <unistd.h>
 #include <stdarg.h>
@@ -183,6 +184,53 @@ gfarm_iobuffer_blocking_write_socket_op(struct gfarm_iobuffer *b,
 	}
 }
 
+/*
+ * writev(2) is not used, since it may raise SIGPIPE.
+ * the kernel module doesn't provide sendmsg(2) either.
+ */
+#if defined(MSG_NOSIGNAL) && !defined(__KERNEL__)
+#define HAVE_BLOCKING_WRITEV_SOCKET_OP
+
+static int
+gfarm_iobuffer_blocking_writev_socket_op(struct gfarm_iobuffer *b,
+	void *cookie, int fd, struct iovec *iov, int iovcnt)
+{
+	ssize_t rv;
+	struct msghdr msg;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = iovcnt;
+	for (;;) {
+		rv = sendmsg(fd, &msg, MSG_NOSIGNAL);
+		if (rv == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN) {
+#ifdef HAVE_POLL
+				struct pollfd fds[1];
+
+				fds[0].fd = fd;
+				fds[0].events = POLLOUT;
+				fds[0].revents = 0;
+				poll(fds, 1, -1);
+#else
+				fd_set writable;
+
+				FD_ZERO(&writable);
+				FD_SET(fd, &writable);
+				select(fd + 1, NULL, &writable, NULL, NULL);
+#endif
+				continue;
+			}
+			gfarm_iobuffer_set_error(b,
+			    gfarm_errno_to_error(errno));
+		}
+		return (rv);
+	}
+}
+#endif /* MSG_NOSIGNAL && !__KERNEL__ */
+
 /*
  * an option for gfarm_iobuffer_set_write_close()
  */
@@ -235,7 +283,12 @@ struct gfp_iobuffer_ops gfp_xdr_socket_iobuffer_ops = {
 	gfp_iobuffer_env_for_credential_fd_op,
 	gfarm_iobuffer_blocking_read_timeout_fd_op,
 	gfarm_iobuffer_blocking_read_notimeout_fd_op,
-	gfarm_iobuffer_blocking_write_socket_op
+	gfarm_iobuffer_blocking_write_socket_op,
+#ifdef HAVE_BLOCKING_WRITEV_SOCKET_OP
+	gfarm_iobuffer_blocking_writev_socket_op,
+#else
+	NULL,
+#endif
 };
 
 gfarm_error_t
@@ -1,6 +1,8 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/types.h>
+#include <sys/uio.h>
 #include <gfarm/error.h>
 #include <gfarm/gflog.h>
 #include <gfarm/gfarm_misc.h>
@@ -9,10 +11,21 @@
 
 /* XXX - This implementation is somewhat slow, but probably acceptable */
 
+/*
+ * data which is at least this size is written from, or read into
+ * the memory of the caller directly, instead of being copied via 'buffer'.
+ */
+#define IOBUFFER_DIRECT_MIN	8192
+
 struct gfarm_iobuffer {
-	char *buffer;
+	char *buffer; /* allocated on demand, thus may be NULL */
 	int bufsize;
 	int head, tail;
+	int default_bufsize; /* bufsize when 'buffer' is (re)allocated */
+
+	/* notified of the change of the allocated size */
+	void (*alloc_hook)(void *, int);
+	void *alloc_hook_cookie;
 
 	int (*read_timeout_func)(struct gfarm_iobuffer *, void *, int,
 				 void *, int);
@@ -22,6 +35,8 @@ struct gfarm_iobuffer {
 	int read_fd; /* for file descriptor i/o */
 
 	int (*write_func)(struct gfarm_iobuffer *, void *, int, void *, int);
+	int (*writev_func)(struct gfarm_iobuffer *, void *, int,
+			   struct iovec *, int); /* may be NULL */
 	void *write_cookie;
 	int write_fd; /* for file descriptor i/o */
 
@@ -51,17 +66,13 @@ gfarm_iobuffer_alloc(int bufsize)
 			gfarm_error_string(GFARM_ERR_NO_MEMORY));
 		return (NULL);
 	}
-	GFARM_MALLOC_ARRAY(b->buffer, bufsize);
-	if (b->buffer == NULL) {
-		free(b);
-		gflog_debug(GFARM_MSG_1000995,
-			"allocation of buffer with size(%d) failed: %s",
-			bufsize,
-			gfarm_error_string(GFARM_ERR_NO_MEMORY));
-		return (NULL);
-	}
+	b->buffer = NULL;
 	b->bufsize = bufsize;
 	b->head = b->tail = 0;
+	b->default_bufsize = bufsize;
+
+	b->alloc_hook = NULL;
+	b->alloc_hook_cookie = NULL;
 
 	b->read_timeout_func = NULL;
 	b->read_notimeout_func = NULL;
@@ -69,6 +80,7 @@ gfarm_iobuffer_alloc(int bufsize)
 	b->read_fd = -1;
 
 	b->write_func = NULL;
+	b->writev_func = NULL;
 	b->write_cookie = NULL;
 	b->write_fd = -1;
 
@@ -88,10 +100,73 @@ gfarm_iobuffer_free(struct gfarm_iobuffer *b)
 {
 	if (b == NULL)
 		return;
+	if (b->buffer != NULL && b->alloc_hook != NULL)
+		(*b->alloc_hook)(b->alloc_hook_cookie, -b->bufsize);
 	free(b->buffer);
 	free(b);
 }
 
+/* returns true on success */
+static int
+gfarm_iobuffer_alloc_buffer(struct gfarm_iobuffer *b)
+{
+	if (b->buffer != NULL)
+		return (1);
+	GFARM_MALLOC_ARRAY(b->buffer, b->bufsize);
+	if (b->buffer == NULL) {
+		gfarm_iobuffer_set_error(b, GFARM_ERR_NO_MEMORY);
+		gflog_debug(GFARM_MSG_1000995,
+			"allocation of buffer with size(%d) failed: %s",
+			b->bufsize,
+			gfarm_error_string(GFARM_ERR_NO_MEMORY));
+		return (0);
+	}
+	if (b->alloc_hook != NULL)
+		(*b->alloc_hook)(b->alloc_hook_cookie, b->bufsize);
+	return (1);
+}
+
+/*
+ * release 'buffer' if it's empty, to save memory of idle connections.
+ * it will be allocated again with the default size on demand.
+ */
+void
+gfarm_iobuffer_shrink(struct gfarm_iobuffer *b)
+{
+	if (b->buffer == NULL || !IOBUFFER_IS_EMPTY(b) || b->pindown)
+		return;
+	if (b->alloc_hook != NULL)
+		(*b->alloc_hook)(b->alloc_hook_cookie, -b->bufsize);
+	free(b->buffer);
+	b->buffer = NULL;
+	b->bufsize = b->default_bufsize;
+	b->head = b->tail = 0;
+}
+
+/* takes effect at next allocation, i.e. after gfarm_iobuffer_shrink() */
+void
+gfarm_iobuffer_set_default_size(struct gfarm_iobuffer *b, int bufsize)
+{
+	b->default_bufsize = bufsize;
+	if (b->buffer == NULL)
+		b->bufsize = bufsize;
+}
+
+void
+gfarm_iobuffer_set_alloc_hook(struct gfarm_iobuffer *b,
+	void (*func)(void *, int), void *cookie)
+{
+	b->alloc_hook = func;
+	b->alloc_hook_cookie = cookie;
+}
+
+/* returns 0, if 'buffer' is not allocated */
+int
+gfarm_iobuffer_get_alloc_size(struct gfarm_iobuffer *b)
+{
+	return (b->buffer != NULL ? b->bufsize : 0);
+}
+
 static void
 gfarm_iobuffer_squeeze(struct gfarm_iobuffer *b)
 {
@@ -122,6 +197,9 @@ gfarm_iobuffer_resize(struct gfarm_iobuffer *b, int new_bufsize)
 	gflog_debug(GFARM_MSG_1003448,
 	    "bufsize of struct iobuffer extended: %d -> %d",
 	    b->bufsize, new_bufsize);
+	if (b->alloc_hook != NULL)
+		(*b->alloc_hook)(b->alloc_hook_cookie,
+		    new_bufsize - b->bufsize);
 	b->bufsize = new_bufsize;
 	b->buffer = new_buffer;
 	return (1);
@@ -194,6 +272,14 @@ gfarm_iobuffer_set_write(struct gfarm_iobuffer *b,
 	b->write_fd = fd;
 }
 
+/* the cookie and fd are the ones of gfarm_iobuffer_set_write() */
+void
+gfarm_iobuffer_set_writev(struct gfarm_iobuffer *b,
+	int (*wvf)(struct gfarm_iobuffer *, void *, int, struct iovec *, int))
+{
+	b->writev_func = wvf;
+}
+
 void *
 gfarm_iobuffer_get_write_cookie(struct gfarm_iobuffer *b)
 {
@@ -332,6 +418,8 @@ gfarm_iobuffer_read(struct gfarm_iobuffer *b, int *residualp, int do_timeout)
 
 	if (!b->read_auto_expansion && IOBUFFER_IS_FULL(b))
 		return (1); /* can get from the buffer */
+	if (!gfarm_iobuffer_alloc_buffer(b))
+		return (0);
 
 	space = IOBUFFER_SPACE_SIZE(b);
 	if (residualp == NULL) /* unlimited */
@@ -363,6 +451,24 @@ gfarm_iobuffer_read(struct gfarm_iobuffer *b, int *residualp, int do_timeout)
 	}
 }
 
+/*
+ * read into `data' directly, bypassing 'buffer' which must be empty.
+ * returns the length read, 0 at EOF, or -1 in case of an error.
+ */
+static int
+gfarm_iobuffer_read_direct(struct gfarm_iobuffer *b, void *data, int len,
+	int do_timeout)
+{
+	int rv;
+	int (*func)(struct gfarm_iobuffer *, void *, int, void *, int);
+
+	func = do_timeout ? b->read_timeout_func : b->read_notimeout_func;
+	rv = (*func)(b, b->read_cookie, b->read_fd, data, len);
+	if (rv == 0)
+		b->read_eof = 1;
+	return (rv);
+}
+
 /* enqueue: returns 0 in case of an error, otherwise returns buffered length */
 static int
 gfarm_iobuffer_put(struct gfarm_iobuffer *b, const void *data, int len)
@@ -375,6 +481,8 @@ gfarm_iobuffer_put(struct gfarm_iobuffer *b, const void *data, int len)
 
 	if (!b->pindown && IOBUFFER_IS_FULL(b))
 		return (0);
+	if (!gfarm_iobuffer_alloc_buffer(b))
+		return (0);
 
 	space = IOBUFFER_SPACE_SIZE(b);
 	if (b->pindown) {
@@ -526,12 +634,58 @@ gfarm_iobuffer_flush_write(struct gfarm_iobuffer *b)
 		gfarm_iobuffer_write(b, NULL);
 }
 
+/*
+ * write the buffered data and then `data', without copying `data' to
+ * the buffer.  they are written at once, if writev_func is available.
+ */
+static int
+gfarm_iobuffer_put_write_direct(struct gfarm_iobuffer *b,
+	const void *data, int len)
+{
+	const char *p = data;
+	int rv, avail, residual = len;
+	struct iovec iov[2];
+
+	if (b->writev_func == NULL)
+		gfarm_iobuffer_flush_write(b);
+	while (!IOBUFFER_IS_EMPTY(b) && b->error == 0) {
+		avail = IOBUFFER_AVAIL_LENGTH(b);
+		iov[0].iov_base = b->buffer + b->head;
+		iov[0].iov_len = avail;
+		iov[1].iov_base = (void *)p;
+		iov[1].iov_len = residual;
+		rv = (*b->writev_func)(b, b->write_cookie, b->write_fd,
+		    iov, 2);
+		if (rv <= 0)
+			return (0);
+		if (rv < avail) {
+			b->head += rv;
+			continue;
+		}
+		b->head = b->tail = 0;
+		p += rv - avail;
+		residual -= rv - avail;
+	}
+	while (residual > 0 && b->error == 0) {
+		rv = (*b->write_func)(b, b->write_cookie, b->write_fd,
+		    (void *)p, residual);
+		if (rv <= 0)
+			break;
+		p += rv;
+		residual -= rv;
+	}
+	return (len - residual);
+}
+
 int
 gfarm_iobuffer_put_write(struct gfarm_iobuffer *b, const void *data, int len)
 {
 	const char *p;
 	int rv, residual;
 
+	if (!b->pindown && len >= IOBUFFER_DIRECT_MIN)
+		return (gfarm_iobuffer_put_write_direct(b, data, len));
+
 	for (p = data, residual = len; residual > 0; residual -= rv, p += rv) {
 		if (!b->pindown && IOBUFFER_IS_FULL(b))
 			gfarm_iobuffer_write(b, NULL);
@@ -544,6 +698,63 @@ gfarm_iobuffer_put_write(struct gfarm_iobuffer *b, const void *data, int len)
 	return (len - residual);
 }
 
+/*
+ * enqueue in place:
+ * returns contiguous `len' bytes at the tail of the buffer, or NULL if
+ * the buffer doesn't have such space without writing.
+ * the caller stores data there, and calls gfarm_iobuffer_put_commit().
+ */
+char *
+gfarm_iobuffer_put_reserve(struct gfarm_iobuffer *b, int len)
+{
+	if (b->error != 0 || !gfarm_iobuffer_alloc_buffer(b))
+		return (NULL);
+	if (len > b->bufsize - b->tail) {
+		if (b->pindown) {
+			if (!gfarm_iobuffer_resize(b, b->tail + len))
+				return (NULL);
+		} else if (len <= IOBUFFER_SPACE_SIZE(b)) {
+			gfarm_iobuffer_squeeze(b);
+		} else {
+			return (NULL);
+		}
+	}
+	return (b->buffer + b->tail);
+}
+
+void
+gfarm_iobuffer_put_commit(struct gfarm_iobuffer *b, int len)
+{
+	assert(len <= b->bufsize - b->tail);
+
+	b->tail += len;
+	if (!b->pindown && IOBUFFER_IS_FULL(b))
+		gfarm_iobuffer_write(b, NULL);
+}
+
+/*
+ * dequeue in place:
+ * returns the head of the buffered data, and its length by *availp.
+ * this doesn't read, thus *availp may be 0.
+ * the caller calls gfarm_iobuffer_get_commit() with the length it consumed.
+ */
+const char *
+gfarm_iobuffer_get_peek(struct gfarm_iobuffer *b, int *availp)
+{
+	*availp = IOBUFFER_AVAIL_LENGTH(b);
+	return (b->buffer + b->head);
+}
+
+void
+gfarm_iobuffer_get_commit(struct gfarm_iobuffer *b, int len)
+{
+	assert(len <= IOBUFFER_AVAIL_LENGTH(b));
+
+	b->head += len;
+	if (IOBUFFER_IS_EMPTY(b))
+		gfarm_iobuffer_squeeze(b);
+}
+
 int
 gfarm_iobuffer_purge_read_x(struct gfarm_iobuffer *b, int len, int just,
 			    int do_timeout)
@@ -563,14 +774,23 @@ gfarm_iobuffer_purge_read_x(struct gfarm_iobuffer *b, int len, int just,
 	return (len - residual);
 }
 
-int
-gfarm_iobuffer_get_read_x(struct gfarm_iobuffer *b, void *data,
-			  int len, int just, int do_timeout)
+/* `direct' allows reading without the buffer, i.e. not to look ahead */
+static int
+gfarm_iobuffer_get_read_internal(struct gfarm_iobuffer *b, void *data,
+	int len, int just, int do_timeout, int direct)
 {
 	char *p;
 	int rv, residual, tmp, *justp = just ? &tmp : NULL;
 
 	for (p = data, residual = len; residual > 0; residual -= rv, p += rv) {
+		if (direct &&
+		    IOBUFFER_IS_EMPTY(b) && residual >= IOBUFFER_DIRECT_MIN) {
+			rv = gfarm_iobuffer_read_direct(b, p, residual,
+			    do_timeout);
+			if (rv <= 0) /* EOF or error */
+				break;
+			continue;
+		}
 		if (IOBUFFER_IS_EMPTY(b)) {
 			tmp = residual;
 			if (!gfarm_iobuffer_read(b, justp, do_timeout))
@@ -583,6 +803,14 @@ gfarm_iobuffer_get_read_x(struct gfarm_iobuffer *b, void *data,
 	return (len - residual);
 }
 
+int
+gfarm_iobuffer_get_read_x(struct gfarm_iobuffer *b, void *data,
+			  int len, int just, int do_timeout)
+{
+	return (gfarm_iobuffer_get_read_internal(b, data, len, just,
+	    do_timeout, !b->pindown));
+}
+
 /*
  * gfarm_iobuffer_get_read*() wait until desired length of data is
  * received.
@@ -633,7 +861,8 @@ gfarm_iobuffer_get_read_x_ahead(struct gfarm_iobuffer *b, void *data, int len,
 	if (b->head + offset > b->tail)
 		return (0);
 	b->head += offset;
-	rlen = gfarm_iobuffer_get_read_x(b, data, len, just, do_timeout);
+	rlen = gfarm_iobuffer_get_read_internal(b, data, len, just,
+	    do_timeout, 0);
 	if (rlen == 0)
 		*errp = b->error;
 	b->head = head0;
@@ -52,8 +52,14 @@
 
 struct gfarm_iobuffer;
 
+/* the memory of the buffer is allocated on demand */
 struct gfarm_iobuffer *gfarm_iobuffer_alloc(int);
 void gfarm_iobuffer_free(struct gfarm_iobuffer *);
+void gfarm_iobuffer_shrink(struct gfarm_iobuffer *);
+void gfarm_iobuffer_set_default_size(struct gfarm_iobuffer *, int);
+void gfarm_iobuffer_set_alloc_hook(struct gfarm_iobuffer *,
+	void (*)(void *, int), void *);
+int gfarm_iobuffer_get_alloc_size(struct gfarm_iobuffer *);
 
 int gfarm_iobuffer_get_size(struct gfarm_iobuffer *);
 void gfarm_iobuffer_set_error(struct gfarm_iobuffer *, int);
@@ -96,16 +102,31 @@ void gfarm_iobuffer_set_write_close(struct gfarm_iobuffer *,
 void gfarm_iobuffer_set_write(struct gfarm_iobuffer *,
 	int (*)(struct gfarm_iobuffer *, void *, int, void *, int),
 	void *, int);
+struct iovec;
+void gfarm_iobuffer_set_writev(struct gfarm_iobuffer *,
+	int (*)(struct gfarm_iobuffer *, void *, int, struct iovec *, int));
 void *gfarm_iobuffer_get_write_cookie(struct gfarm_iobuffer *);
 int gfarm_iobuffer_get_write_fd(struct gfarm_iobuffer *);
 int gfarm_iobuffer_purge(struct gfarm_iobuffer *, int *);
 void gfarm_iobuffer_flush_write(struct gfarm_iobuffer *);
 
-/* enqueue by memory copy, dequeue by write */
+/*
+ * enqueue by memory copy, dequeue by write.
+ * large data is written directly without memory copy, unless pindown.
+ */
 int gfarm_iobuffer_put_write(struct gfarm_iobuffer *, const void *, int);
+/* enqueue in place, dequeue by write */
+char *gfarm_iobuffer_put_reserve(struct gfarm_iobuffer *, int);
+void gfarm_iobuffer_put_commit(struct gfarm_iobuffer *, int);
+/* dequeue in place, without read */
+const char *gfarm_iobuffer_get_peek(struct gfarm_iobuffer *, int *);
+void gfarm_iobuffer_get_commit(struct gfarm_iobuffer *, int);
 /* enqueue by read, dequeue by purge */
 int gfarm_iobuffer_purge_read_x(struct gfarm_iobuffer *, int, int, int);
-/* enqueue by read, dequeue by memory copy */
+/*
+ * enqueue by read, dequeue by memory copy.
+ * large data is read directly into the caller's memory.
+ */
 int gfarm_iobuffer_get_read_x(struct gfarm_iobuffer *, void *, int, int, int);
 int gfarm_iobuffer_get_read_partial_x(struct gfarm_iobuffer *, void *, int,
 	int, int);
@@ -1,3 +1,4 @@
+#include <pthread.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <time.h>
@@ -7,6 +8,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/mman.h>
 
 #include <gfarm/gfarm.h>
@@ -20,10 +22,31 @@ struct gfarm_iostat_static {
 	struct gfarm_iostat_items	*stat_local_ip;
 	gfarm_off_t		stat_size;
 };
+#ifndef O_NOFOLLOW
+#define O_NOFOLLOW	0
+#endif
+
 #define staticp (gfarm_ctxp->iostat_static)
 #define is_statfile_valid(hp, sip)	\
 	(staticp && (hp = staticp->stat_hp) && (sip = staticp->stat_sip))
 
+/*
+ * a row used by the calling thread instead of stat_local_ip,
+ * for a process which does I/O in several threads at once.
+ */
+static pthread_key_t gfarm_iostat_thread_ip_key;
+static pthread_once_t gfarm_iostat_thread_ip_once = PTHREAD_ONCE_INIT;
+
+static void
+gfarm_iostat_thread_ip_key_create(void)
+{
+	int err = pthread_key_create(&gfarm_iostat_thread_ip_key, NULL);
+
+	if (err != 0)
+		gflog_fatal(GFARM_MSG_UNFIXED,
+		    "iostat thread key: %s", strerror(err));
+}
+
 
 gfarm_error_t
 gfarm_iostat_static_init(struct gfarm_context *ctxp)
@@ -51,15 +74,11 @@ gfarm_iostat_static_term(struct gfarm_context *ctxp)
 }
 
 
-gfarm_error_t
-gfarm_iostat_mmap(char *path, struct gfarm_iostat_spec *specp,
+static size_t
+gfarm_iostat_head_init(struct gfarm_iostat_head *hp, char *path,
 		unsigned int nitem, unsigned int row)
 {
-	int fd;
-	gfarm_error_t e;
-	size_t	size, off;
-	void	*addr;
-	struct gfarm_iostat_head head, *hp = &head;
+	size_t off;
 
 	off = sizeof(struct gfarm_iostat_head)
 		+ sizeof(struct gfarm_iostat_spec) * nitem;
@@ -74,10 +93,24 @@ gfarm_iostat_mmap(char *path, struct gfarm_iostat_spec *specp,
 	hp->s_start_sec = hp->s_update_sec = time(0);
 	hp->s_item_off = off;
 	hp->s_item_size = sizeof(gfarm_int64_t) * (nitem + 1);
-
-	size = off + hp->s_item_size * row;
 	strncpy(hp->s_name, basename(path), GFARM_IOSTAT_NAME_MAX);
 
+	return (off + hp->s_item_size * row);
+}
+
+gfarm_error_t
+gfarm_iostat_mmap(char *path, struct gfarm_iostat_spec *specp,
+		unsigned int nitem, unsigned int row)
+{
+	int fd;
+	gfarm_error_t e;
+	size_t	size, off;
+	void	*addr;
+	struct gfarm_iostat_head head, *hp = &head;
+
+	size = gfarm_iostat_head_init(hp, path, nitem, row);
+	off = hp->s_item_off;
+
 	if ((fd = open(path, O_CREAT|O_TRUNC|O_RDWR, 0644)) < 0) {
 		e = gfarm_errno_to_error(errno);
 		gflog_error(GFARM_MSG_1003591,
@@ -126,6 +159,103 @@ gfarm_iostat_mmap(char *path, struct gfarm_iostat_spec *specp,
 
 	return (GFARM_ERR_NO_ERROR);
 }
+/*
+ * map a single row statistics file which is shared by several processes
+ * of the user.
+ * unlike gfarm_iostat_mmap(), an existing file is kept as is, and
+ * the mapping is not registered to the per-process iostat_static.
+ * a symbolic link, or a file which others can modify, is not used.
+ */
+gfarm_error_t
+gfarm_iostat_mmap_shared(char *path, struct gfarm_iostat_spec *specp,
+	unsigned int nitem, struct gfarm_iostat_head **hpp, size_t *sizep)
+{
+	int fd, save_errno;
+	gfarm_error_t e;
+	size_t	size;
+	void	*addr;
+	struct stat st;
+	struct flock lock;
+	struct gfarm_iostat_head head, *hp = &head;
+	struct gfarm_iostat_items *ip;
+
+	size = gfarm_iostat_head_init(hp, path, nitem, 1);
+
+	if ((fd = open(path, O_CREAT|O_RDWR|O_NOFOLLOW, 0600)) < 0) {
+		e = gfarm_errno_to_error(errno);
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "gfarm_iostat_mmap_shared(%s) open failed: %s",
+		    path, gfarm_error_string(e));
+		return (e);
+	}
+	/* serialize initialization of a new file */
+	memset(&lock, 0, sizeof(lock));
+	lock.l_type = F_WRLCK;
+	lock.l_whence = SEEK_SET;
+	if (fcntl(fd, F_SETLKW, &lock) == -1 || fstat(fd, &st) == -1) {
+		save_errno = errno;
+		close(fd);
+		e = gfarm_errno_to_error(save_errno);
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "gfarm_iostat_mmap_shared(%s) lock failed: %s",
+		    path, gfarm_error_string(e));
+		return (e);
+	}
+	if (!S_ISREG(st.st_mode) || st.st_uid != geteuid() ||
+	    (st.st_mode & 077) != 0) {
+		close(fd);
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "gfarm_iostat_mmap_shared(%s): not a private file", path);
+		return (GFARM_ERR_PERMISSION_DENIED);
+	}
+	if (st.st_size == 0) {
+		if (ftruncate(fd, size) == -1 ||
+		    write(fd, hp, sizeof(*hp)) == -1 ||
+		    write(fd, specp, sizeof(*specp) * nitem) == -1) {
+			save_errno = errno;
+			close(fd);
+			e = gfarm_errno_to_error(save_errno);
+			gflog_debug(GFARM_MSG_UNFIXED,
+			    "gfarm_iostat_mmap_shared(%s) init failed: %s",
+			    path, gfarm_error_string(e));
+			return (e);
+		}
+	} else if (st.st_size != size) {
+		close(fd);
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "gfarm_iostat_mmap_shared(%s) size %lld, %zu expected",
+		    path, (long long)st.st_size, size);
+		return (GFARM_ERR_INVALID_ARGUMENT);
+	}
+	if ((addr = mmap(NULL, size, PROT_WRITE|PROT_READ, MAP_SHARED, fd, 0))
+		== MAP_FAILED) {
+		save_errno = errno;
+		close(fd);
+		e = gfarm_errno_to_error(save_errno);
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "gfarm_iostat_mmap_shared(%s) mmap %zu failed: %s",
+		    path, size, gfarm_error_string(e));
+		return (e);
+	}
+	close(fd); /* this releases the lock as well */
+
+	hp = addr;
+	if (hp->s_magic != GFARM_IOSTAT_MAGIC || hp->s_nitem != nitem) {
+		munmap(addr, size);
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "gfarm_iostat_mmap_shared(%s): not a valid iostat file",
+		    path);
+		return (GFARM_ERR_INVALID_ARGUMENT);
+	}
+	ip = (struct gfarm_iostat_items *)((char *)addr + hp->s_item_off);
+	if (!ip->s_valid) {
+		ip->s_valid = 1;
+		hp->s_rowcur = hp->s_rowmax = 1;
+	}
+	*hpp = hp;
+	*sizep = size;
+	return (GFARM_ERR_NO_ERROR);
+}
 void
 gfarm_iostat_sync(void)
 {
@@ -303,6 +433,13 @@ gfarm_iostat_set_local_ip(struct gfarm_iostat_items *ip)
 	staticp->stat_local_ip = ip;
 }
 void
+gfarm_iostat_set_thread_local_ip(struct gfarm_iostat_items *ip)
+{
+	pthread_once(&gfarm_iostat_thread_ip_once,
+	    gfarm_iostat_thread_ip_key_create);
+	pthread_setspecific(gfarm_iostat_thread_ip_key, ip);
+}
+void
 gfarm_iostat_stat_add(struct gfarm_iostat_items *ip, unsigned int cat, int val)
 {
 	struct gfarm_iostat_head *hp; struct gfarm_iostat_items *sip;
@@ -334,7 +471,10 @@ gfarm_iostat_local_add(unsigned int cat, int val)
 
 	if (!is_statfile_valid(hp, sip))
 		return;
-	if (!(ip = staticp->stat_local_ip)) {
+	pthread_once(&gfarm_iostat_thread_ip_once,
+	    gfarm_iostat_thread_ip_key_create);
+	if (!(ip = pthread_getspecific(gfarm_iostat_thread_ip_key)) &&
+	    !(ip = staticp->stat_local_ip)) {
 		gflog_debug(GFARM_MSG_1003606, "not initialized");
 		return;
 	}
@@ -13,6 +13,7 @@
  */
 
 #include <assert.h>
+#include <limits.h>
 #include <stdio.h> /* sprintf */
 #include <stdlib.h>
 #include <string.h>
@@ -22,9 +23,15 @@
 #include <sys/time.h>
 #include <netinet/in.h>
 #include <time.h>
+#ifndef __KERNEL__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif /* __KERNEL__ */
+#include <pthread.h>	/* pthread_mutex_t */
 #ifdef __KERNEL__
 #include <net/tcp.h>
-#include <pthread.h>	/* pthread_mutex_t */
 #endif /* __KERNEL__ */
 
 #include <gfarm/gfarm.h>
@@ -33,6 +40,7 @@
 #include "gfevent.h"
 #include "hash.h"
 #include "timer.h"
+#include "thrsubr.h"
 
 #include "context.h"
 #include "liberror.h"
@@ -132,6 +140,13 @@
  *	and
  *	- finish().
  *
+ * if "schedule_topology_aware" is enabled, the locations of hosts specified
+ * by "network_location" are taken into account in select_hosts():
+ * - if it's read-mode, idle hosts are selected in order of the distance
+ *   from this client in the network topology, e.g. the same rack first.
+ * - if it's write-mode, the selected hosts are reordered to spread them
+ *   over different locations, e.g. one host from each rack in turn.
+ *
  * some notes:
  * - load average isn't only condition to see whether the host can be used
  *   or not.
@@ -163,6 +178,12 @@
 
 #define staticp	(gfarm_ctxp->schedule_static)
 
+#ifndef __KERNEL__
+#define SHARED_CACHE_STATE_UNKNOWN	0
+#define SHARED_CACHE_STATE_ENABLED	1
+#define SHARED_CACHE_STATE_DISABLED	2
+#endif /* __KERNEL__ */
+
 enum gfarm_schedule_search_mode {
 	GFARM_SCHEDULE_SEARCH_BY_LOADAVG,
 	GFARM_SCHEDULE_SEARCH_BY_LOADAVG_AND_AUTH,
@@ -202,6 +223,7 @@ struct gfarm_schedule_static {
 	struct search_idle_network *search_idle_local_net;
 	struct search_idle_network **search_idle_local_host;
 	int search_idle_local_host_count;
+	const char *search_idle_local_location; /* NULL if unknown */
 
 	/* The followings are working area during scheduling */
 	struct timeval search_idle_now;
@@ -209,9 +231,20 @@ struct gfarm_schedule_static {
 	/* whether need to see authentication or not? */
 	enum gfarm_schedule_search_mode default_search_method;
 
+#ifndef __KERNEL__
+	/* cache shared among processes on this node, if enabled */
+	int shared_cache_state;
+	int shared_cache_fd;
+	struct schedule_shared_cache *shared_cache;
+#endif /* __KERNEL__ */
+
 	SCHED_MUTEX_DCL
 };
 
+#ifndef __KERNEL__
+static void schedule_shared_cache_close(struct gfarm_schedule_static *);
+#endif /* __KERNEL__ */
+
 static void search_idle_network_list_free(void);
 
 gfarm_error_t
@@ -233,8 +266,14 @@ gfarm_schedule_static_init(struct gfarm_context *ctxp)
 	s->search_idle_local_net = NULL;
 	s->search_idle_local_host = NULL;
 	s->search_idle_local_host_count = 0;
+	s->search_idle_local_location = NULL;
 	memset(&s->search_idle_now, 0, sizeof(s->search_idle_now));
 	s->default_search_method = GFARM_SCHEDULE_SEARCH_BY_LOADAVG_AND_AUTH;
+#ifndef __KERNEL__
+	s->shared_cache_state = SHARED_CACHE_STATE_UNKNOWN;
+	s->shared_cache_fd = -1;
+	s->shared_cache = NULL;
+#endif /* __KERNEL__ */
 
 	SCHED_MUTEX_INIT(s)
 
@@ -251,6 +290,9 @@ gfarm_schedule_static_term(struct gfarm_context *ctxp)
 		return;
 
 	SCHED_MUTEX_DESTROY(s)
+#ifndef __KERNEL__
+	schedule_shared_cache_close(s);
+#endif /* __KERNEL__ */
 	if (s->search_idle_hosts_state != NULL)
 		gfp_conn_hash_table_dispose(s->search_idle_hosts_state);
 	search_idle_network_list_free();
@@ -341,6 +383,8 @@ struct search_idle_host_state {
 	struct sockaddr addr;		/* if HOST_STATE_FLAG_ADDR_AVAIL */
 
 	struct search_idle_network *net;
+	const char *location;		/* if HOST_STATE_FLAG_ADDR_AVAIL,
+					   NULL if unknown */
 
 	struct timeval rtt_cache_time;	/* if HOST_STATE_FLAG_RTT_TRIED */
 	int rtt_usec;			/* if HOST_STATE_FLAG_RTT_AVAIL */
@@ -390,6 +434,7 @@ struct search_idle_host_state {
 
 	/* work area */
 	char *return_value; /* hostname */
+	int topology_distance; /* from this client */
 };
 
 struct search_idle_network {
@@ -424,6 +469,309 @@ is_expired(struct timeval *cached_timep, int expiration)
 	return (gfarm_timeval_cmp(&staticp->search_idle_now, &expired) >= 0);
 }
 
+#ifndef __KERNEL__
+/*
+ * The node-wide cache shared among processes of a same user.
+ *
+ * If schedule_shared_cache_directory is specified, the status of hosts
+ * measured by search_idle_try_host() are stored to a file in the directory,
+ * which is mapped by all processes, and the other processes use the status
+ * instead of measuring again, until it expires.
+ * The file is a hash table of SHARED_CACHE_NENTRIES entries with
+ * linear probing, and it's protected by fcntl(2) lock among processes,
+ * and by shared_cache_mutex among threads of a process.
+ *
+ * Because the directory may be shared by users like /tmp, the file is
+ * created in a per-user subdirectory, which only the user can access.
+ */
+
+#ifndef O_NOFOLLOW
+#define O_NOFOLLOW	0
+#endif
+
+#define SHARED_CACHE_DIR_PREFIX		"gfarm-"
+#define SHARED_CACHE_FILE		"schedule"
+#define SHARED_CACHE_MAGIC		0x67667363 /* "gfsc" */
+#define SHARED_CACHE_VERSION		2 /* depends on gfarm_hash_default() */
+#define SHARED_CACHE_NENTRIES		4096
+#define SHARED_CACHE_PROBE		16
+#define SHARED_CACHE_HOSTNAME_MAX	256
+#define SHARED_CACHE_USERNAME_MAX	64
+
+/* host state which can be shared */
+#define SHARED_CACHE_HOST_FLAGS	(HOST_STATE_FLAG_RTT_TRIED| \
+	HOST_STATE_FLAG_RTT_AVAIL|HOST_STATE_FLAG_AUTH_SUCCEED| \
+	HOST_STATE_FLAG_STATFS_AVAIL)
+
+struct schedule_shared_cache_entry {
+	char hostname[SHARED_CACHE_HOSTNAME_MAX]; /* "" if unused */
+	char username[SHARED_CACHE_USERNAME_MAX];
+	gfarm_int32_t port;
+	gfarm_int32_t flags;	/* SHARED_CACHE_HOST_FLAGS */
+	gfarm_int32_t rtt_usec;
+	gfarm_int32_t rtt_cache_usec;
+	gfarm_int64_t rtt_cache_sec;
+	gfarm_int64_t statfs_cache_sec;
+	gfarm_int32_t statfs_cache_usec;
+	gfarm_int32_t padding;
+	gfarm_int64_t loadavg;	/* loadavg * GFM_PROTO_LOADAVG_FSCALE */
+	gfarm_int64_t diskused, diskavail;
+};
+
+struct schedule_shared_cache {
+	gfarm_uint32_t magic, version, nentries, entry_size;
+	struct schedule_shared_cache_entry entries[SHARED_CACHE_NENTRIES];
+};
+
+static void
+schedule_shared_cache_close(struct gfarm_schedule_static *s)
+{
+	if (s->shared_cache != NULL)
+		munmap(s->shared_cache, sizeof(*s->shared_cache));
+	if (s->shared_cache_fd != -1)
+		close(s->shared_cache_fd);
+	s->shared_cache = NULL;
+	s->shared_cache_fd = -1;
+}
+
+/* fcntl(2) lock doesn't serialize threads of a process */
+static pthread_mutex_t shared_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static const char shared_cache_mutex_diag[] = "shared_cache_mutex";
+
+static int
+schedule_shared_cache_fcntl_lock(int type)
+{
+	struct flock lock;
+
+	memset(&lock, 0, sizeof(lock));
+	lock.l_type = type;
+	lock.l_whence = SEEK_SET;
+	while (fcntl(staticp->shared_cache_fd, F_SETLKW, &lock) == -1) {
+		if (errno != EINTR) {
+			gflog_debug(GFARM_MSG_UNFIXED,
+			    "schedule shared cache: lock: %s",
+			    strerror(errno));
+			return (0);
+		}
+	}
+	return (1);
+}
+
+static int
+schedule_shared_cache_lock(int type)
+{
+	static const char diag[] = "schedule_shared_cache_lock";
+
+	gfarm_mutex_lock(&shared_cache_mutex, diag, shared_cache_mutex_diag);
+	if (!schedule_shared_cache_fcntl_lock(type)) {
+		gfarm_mutex_unlock(&shared_cache_mutex, diag,
+		    shared_cache_mutex_diag);
+		return (0);
+	}
+	return (1);
+}
+
+static void
+schedule_shared_cache_unlock(void)
+{
+	static const char diag[] = "schedule_shared_cache_unlock";
+
+	(void)schedule_shared_cache_fcntl_lock(F_UNLCK);
+	gfarm_mutex_unlock(&shared_cache_mutex, diag, shared_cache_mutex_diag);
+}
+
+/* don't trust the file which others can modify */
+static gfarm_error_t
+schedule_shared_cache_check_owner(struct stat *stp, mode_t type)
+{
+	if ((stp->st_mode & S_IFMT) != type ||
+	    stp->st_uid != geteuid() || (stp->st_mode & 077) != 0)
+		return (GFARM_ERR_PERMISSION_DENIED);
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static gfarm_error_t
+schedule_shared_cache_open(const char *dir)
+{
+	int fd;
+	char *path;
+	struct stat st;
+	void *addr;
+	struct schedule_shared_cache *c;
+	gfarm_error_t e = GFARM_ERR_NO_ERROR;
+
+	/* the directory may be shared by users, like /tmp */
+	if (mkdir(dir, 0777) == 0)
+		(void)chmod(dir, 0777 | S_ISVTX);
+	else if (errno != EEXIST)
+		return (gfarm_errno_to_error(errno));
+
+	GFARM_MALLOC_ARRAY(path, strlen(dir) + 1 +
+	    sizeof(SHARED_CACHE_DIR_PREFIX) + GFARM_INT64STRLEN + 1 +
+	    sizeof(SHARED_CACHE_FILE));
+	if (path == NULL)
+		return (GFARM_ERR_NO_MEMORY);
+
+	/*
+	 * others cannot replace the subdirectory owned by the user,
+	 * if the shared directory is sticky.
+	 */
+	sprintf(path, "%s/%s%ld", dir, SHARED_CACHE_DIR_PREFIX,
+	    (long)geteuid());
+	if (mkdir(path, 0700) == -1 && errno != EEXIST)
+		e = gfarm_errno_to_error(errno);
+	else if (lstat(path, &st) == -1)
+		e = gfarm_errno_to_error(errno);
+	else
+		e = schedule_shared_cache_check_owner(&st, S_IFDIR);
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_UNFIXED, "%s: %s",
+		    path, gfarm_error_string(e));
+		free(path);
+		return (e);
+	}
+
+	strcat(path, "/" SHARED_CACHE_FILE);
+	fd = open(path, O_CREAT|O_RDWR|O_NOFOLLOW, 0600);
+	if (fd == -1) {
+		e = gfarm_errno_to_error(errno);
+	} else if (fstat(fd, &st) == -1) {
+		e = gfarm_errno_to_error(errno);
+		close(fd);
+	} else if ((e = schedule_shared_cache_check_owner(&st, S_IFREG)) !=
+	    GFARM_ERR_NO_ERROR) {
+		close(fd);
+	}
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_UNFIXED, "%s: %s",
+		    path, gfarm_error_string(e));
+		free(path);
+		return (e);
+	}
+	free(path);
+	staticp->shared_cache_fd = fd;
+
+	/* serialize initialization of a new file */
+	if (!schedule_shared_cache_lock(F_WRLCK)) {
+		schedule_shared_cache_close(staticp);
+		return (GFARM_ERR_INPUT_OUTPUT);
+	}
+	/* the size may be changed by another process before the lock */
+	if (fstat(fd, &st) == -1) {
+		e = gfarm_errno_to_error(errno);
+	} else if (st.st_size == 0) {
+		if (ftruncate(fd, sizeof(*c)) == -1)
+			e = gfarm_errno_to_error(errno);
+	} else if (st.st_size != sizeof(*c)) {
+		e = GFARM_ERR_INVALID_ARGUMENT;
+	}
+	if (e == GFARM_ERR_NO_ERROR) {
+		addr = mmap(NULL, sizeof(*c), PROT_READ|PROT_WRITE,
+		    MAP_SHARED, fd, 0);
+		if (addr == MAP_FAILED)
+			e = gfarm_errno_to_error(errno);
+	}
+	if (e == GFARM_ERR_NO_ERROR) {
+		c = addr;
+		if (st.st_size == 0) {
+			/* ftruncate(2) fills the entries with zero */
+			c->magic = SHARED_CACHE_MAGIC;
+			c->version = SHARED_CACHE_VERSION;
+			c->nentries = SHARED_CACHE_NENTRIES;
+			c->entry_size = sizeof(c->entries[0]);
+		} else if (c->magic != SHARED_CACHE_MAGIC ||
+		    c->version != SHARED_CACHE_VERSION ||
+		    c->nentries != SHARED_CACHE_NENTRIES ||
+		    c->entry_size != sizeof(c->entries[0])) {
+			munmap(addr, sizeof(*c));
+			e = GFARM_ERR_INVALID_ARGUMENT;
+		}
+	}
+	schedule_shared_cache_unlock();
+	if (e != GFARM_ERR_NO_ERROR) {
+		schedule_shared_cache_close(staticp);
+		return (e);
+	}
+	staticp->shared_cache = c;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static int
+schedule_shared_cache_is_enabled(void)
+{
+	const char *dir = gfarm_ctxp->schedule_shared_cache_directory;
+	gfarm_error_t e;
+
+	if (staticp->shared_cache_state != SHARED_CACHE_STATE_UNKNOWN)
+		return (staticp->shared_cache_state ==
+		    SHARED_CACHE_STATE_ENABLED);
+
+	staticp->shared_cache_state = SHARED_CACHE_STATE_DISABLED;
+	if (dir == NULL)
+		return (0);
+	if ((e = schedule_shared_cache_open(dir)) != GFARM_ERR_NO_ERROR) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "schedule_shared_cache_directory %s: disabled: %s",
+		    dir, gfarm_error_string(e));
+		return (0);
+	}
+	staticp->shared_cache_state = SHARED_CACHE_STATE_ENABLED;
+	return (1);
+}
+
+static int
+schedule_shared_cache_entry_is_older(struct schedule_shared_cache_entry *a,
+	struct schedule_shared_cache_entry *b)
+{
+	return (a->rtt_cache_sec < b->rtt_cache_sec ||
+	    (a->rtt_cache_sec == b->rtt_cache_sec &&
+	     a->rtt_cache_usec < b->rtt_cache_usec));
+}
+
+/*
+ * PREREQUISITE: schedule_shared_cache_lock()
+ * if `create' is true, the oldest entry is reused when there is no room.
+ */
+static struct schedule_shared_cache_entry *
+schedule_shared_cache_lookup(const char *hostname, int port,
+	const char *username, int create)
+{
+	struct schedule_shared_cache *c = staticp->shared_cache;
+	struct schedule_shared_cache_entry *ent, *victim = NULL;
+	int i;
+	unsigned int hash;
+
+	if (strlen(hostname) >= SHARED_CACHE_HOSTNAME_MAX ||
+	    strlen(username) >= SHARED_CACHE_USERNAME_MAX)
+		return (NULL);
+	/* unsigned, to avoid overflow of signed integer */
+	hash = (unsigned int)gfarm_hash_default(hostname, strlen(hostname)) +
+	    (unsigned int)port;
+	for (i = 0; i < SHARED_CACHE_PROBE; i++) {
+		ent = &c->entries[(hash + i) % SHARED_CACHE_NENTRIES];
+		if (ent->hostname[0] == '\0') {
+			/* entries are never removed, so this is the end */
+			victim = ent;
+			break;
+		}
+		if (ent->port == port &&
+		    strcmp(ent->hostname, hostname) == 0 &&
+		    strcmp(ent->username, username) == 0)
+			return (ent);
+		if (victim == NULL ||
+		    schedule_shared_cache_entry_is_older(ent, victim))
+			victim = ent;
+	}
+	if (!create)
+		return (NULL);
+	memset(victim, 0, sizeof(*victim));
+	strcpy(victim->hostname, hostname);
+	strcpy(victim->username, username);
+	victim->port = port;
+	return (victim);
+}
+#endif /* __KERNEL__ */
+
 static void
 search_idle_network_set_local(struct search_idle_network *net)
 {
@@ -498,6 +846,10 @@ serch_idle_network_list_local_host_init(void)
 			search_idle_network_set_local(net);
 		} else if (save_e == GFARM_ERR_NO_ERROR)
 			save_e = e;
+		if (staticp->search_idle_local_location == NULL)
+			staticp->search_idle_local_location =
+			    gfarm_addr_network_location_get(
+			    (struct sockaddr *)&addr_in);
 	}
 	free(self_ip);
 	staticp->search_idle_local_host_count = j;
@@ -541,6 +893,9 @@ search_idle_network_list_init(struct gfm_connection *gfm_server)
 		    self_name, gfarm_error_string(e));
 		return (e);
 	}
+	if (staticp->search_idle_local_location == NULL)
+		staticp->search_idle_local_location =
+		    gfarm_addr_network_location_get(&peer_addr);
 	e = search_idle_network_list_add0(&peer_addr,
 		NET_FLAG_NETMASK_KNOWN | NET_FLAG_RTT_AVAIL, &net);
 	if (e == GFARM_ERR_NO_ERROR) {
@@ -655,6 +1010,7 @@ search_idle_host_state_add_host_sched_info(struct gfm_connection *gfm_server,
 			}
 #endif
 			h->net = NULL;
+			h->location = NULL;
 			h->scheduled_age =
 			    HOST_STATE_SCHEDULED_AGE_NOT_FOUND + 1;
 			h->scheduled = 0;
@@ -685,6 +1041,7 @@ search_idle_host_state_add_host_sched_info(struct gfm_connection *gfm_server,
 			return (e);
 		}
 		h->flags |= HOST_STATE_FLAG_ADDR_AVAIL;
+		h->location = gfarm_addr_network_location_get(&h->addr);
 		e = search_idle_network_list_add(&h->addr, &h->net);
 		if (e != GFARM_ERR_NO_ERROR) {
 			gflog_debug(GFARM_MSG_1001432,
@@ -737,6 +1094,20 @@ gfarm_schedule_host_cache_purge(struct gfs_connection *gfs_server)
 
 	h = gfarm_hash_entry_data(entry);
 	h->flags &= ~HOST_STATE_FLAG_AUTH_SUCCEED;
+#ifndef __KERNEL__
+	if (schedule_shared_cache_is_enabled() &&
+	    schedule_shared_cache_lock(F_WRLCK)) {
+		struct schedule_shared_cache_entry *ent =
+		    schedule_shared_cache_lookup(
+		    gfs_client_hostname(gfs_server),
+		    gfs_client_port(gfs_server),
+		    gfs_client_username(gfs_server), 0);
+
+		if (ent != NULL)
+			ent->flags &= ~HOST_STATE_FLAG_AUTH_SUCCEED;
+		schedule_shared_cache_unlock();
+	}
+#endif /* __KERNEL__ */
 	return (GFARM_ERR_NO_ERROR);
 }
 
@@ -870,6 +1241,67 @@ entropy(void)
 	    / (RAND_MAX + 1LL));
 }
 
+#define TOPOLOGY_DISTANCE_UNKNOWN	INT_MAX
+
+/* skip to the next component of a location like "/dc1/spine1/rack3" */
+static const char *
+location_component(const char *p, size_t *lenp)
+{
+	while (*p == '/')
+		p++;
+	*lenp = strcspn(p, "/");
+	return (p);
+}
+
+static int
+location_depth(const char *p)
+{
+	int depth = 0;
+	size_t len;
+
+	for (;;) {
+		p = location_component(p, &len);
+		if (len == 0)
+			return (depth);
+		depth++;
+		p += len;
+	}
+}
+
+/*
+ * the number of links between two locations in the tree of the network,
+ * e.g. 0 in the same rack, 2 between racks under the same switch.
+ */
+static int
+topology_distance(const char *a, const char *b)
+{
+	size_t la, lb;
+
+	if (a == NULL || b == NULL)
+		return (TOPOLOGY_DISTANCE_UNKNOWN);
+	/* skip common ancestors */
+	for (;;) {
+		a = location_component(a, &la);
+		b = location_component(b, &lb);
+		if (la == 0 || la != lb || memcmp(a, b, la) != 0)
+			break;
+		a += la;
+		b += lb;
+	}
+	return (location_depth(a) + location_depth(b));
+}
+
+#define IDLE_LOAD_AVERAGE	(gfarm_ctxp->schedule_idle_load * \
+				 GFM_PROTO_LOADAVG_FSCALE / GFARM_F2LL_SCALE)
+				/* 0.5 * GFM_PROTO_LOADAVG_FSCALE */
+#define SEMI_IDLE_LOAD_AVERAGE	(gfarm_ctxp->schedule_busy_load * \
+				 GFM_PROTO_LOADAVG_FSCALE / GFARM_F2LL_SCALE)
+				/* 0.1 * GFM_PROTO_LOADAVG_FSCALE */
+#define VIRTUAL_LOAD_FOR_SCHEDULED_HOST \
+				(gfarm_ctxp->schedule_virtual_load * \
+				 GFM_PROTO_LOADAVG_FSCALE / GFARM_F2LL_SCALE)
+				/* 0.3 * GFM_PROTO_LOADAVG_FSCALE */
+
 static gfarm_error_t
 search_idle_candidate_list_add(struct gfm_connection *gfm_server,
 	struct gfarm_host_sched_info *info)
@@ -919,6 +1351,7 @@ search_idle_candidate_list_add(struct gfm_connection *gfm_server,
 #endif
 
 	if (info->flags & GFM_PROTO_SCHED_FLAG_LOADAVG_AVAIL) {
+		struct timeval status_time;
 #ifdef __KERNEL__
 		int update_loadavg = 1;
 #else
@@ -926,14 +1359,38 @@ search_idle_candidate_list_add(struct gfm_connection *gfm_server,
 			(h->flags & HOST_STATE_FLAG_RTT_AVAIL) == 0 ||
 			h->loadavg_cache_time.tv_sec < info->cache_time;
 #endif
+
+		if (info->flags & GFM_PROTO_SCHED_FLAG_STATUS_AVAIL) {
+			/*
+			 * gfsd reports the changes of its status to gfmd
+			 * immediately, thus the status is as fresh as
+			 * an RTT measurement, and it also tells
+			 * the replications in progress.
+			 */
+			struct timeval age;
+
+			age.tv_sec = info->status_age / 1000;
+			age.tv_usec = info->status_age % 1000 * 1000;
+			gettimeofday(&status_time, NULL);
+			gfarm_timeval_sub(&status_time, &age);
+#ifndef __KERNEL__
+			update_loadavg = update_loadavg ||
+			    gfarm_timeval_cmp(&h->loadavg_cache_time,
+			    &status_time) < 0;
+#endif
+		} else {
+			status_time.tv_sec = info->cache_time;
+			status_time.tv_usec = 0;
+		}
 		if (update_loadavg) {
-			h->loadavg_cache_time.tv_sec = info->cache_time;
-			h->loadavg_cache_time.tv_usec = 0;
+			h->loadavg_cache_time = status_time;
 			/* add entropy to randomize the scheduling result */
 			h->loadavg = info->loadavg + entropy();
+			if (info->flags & GFM_PROTO_SCHED_FLAG_STATUS_AVAIL)
+				h->loadavg += info->queue_depth *
+				    VIRTUAL_LOAD_FOR_SCHEDULED_HOST;
 		}
-		h->statfs_cache_time.tv_sec = info->cache_time;
-		h->statfs_cache_time.tv_usec = 0;
+		h->statfs_cache_time = status_time;
 		/* convert KiByte to Byte */
 		h->diskused = info->disk_used * 1024;
 		h->diskavail = info->disk_avail * 1024;
@@ -961,6 +1418,9 @@ search_idle_candidate_list_add(struct gfm_connection *gfm_server,
 	 * input hostnames instead of newly allocated strings.
 	 */
 	h->return_value = hostname;
+	h->topology_distance = gfarm_schedule_topology_aware() ?
+	    topology_distance(staticp->search_idle_local_location,
+		h->location) : 0;
 	return (GFARM_ERR_NO_ERROR);
 }
 
@@ -972,16 +1432,11 @@ gfarm_schedule_search_mode_use_loadavg(void)
 	staticp->default_search_method = GFARM_SCHEDULE_SEARCH_BY_LOADAVG;
 }
 
-#define IDLE_LOAD_AVERAGE	(gfarm_ctxp->schedule_idle_load * \
-				 GFM_PROTO_LOADAVG_FSCALE / GFARM_F2LL_SCALE)
-				/* 0.5 * GFM_PROTO_LOADAVG_FSCALE */
-#define SEMI_IDLE_LOAD_AVERAGE	(gfarm_ctxp->schedule_busy_load * \
-				 GFM_PROTO_LOADAVG_FSCALE / GFARM_F2LL_SCALE)
-				/* 0.1 * GFM_PROTO_LOADAVG_FSCALE */
-#define VIRTUAL_LOAD_FOR_SCHEDULED_HOST \
-				(gfarm_ctxp->schedule_virtual_load * \
-				 GFM_PROTO_LOADAVG_FSCALE / GFARM_F2LL_SCALE)
-				/* 0.3 * GFM_PROTO_LOADAVG_FSCALE */
+void
+gfarm_schedule_search_mode_use_topology(void)
+{
+	gfarm_ctxp->schedule_topology_aware = 1;
+}
 
 struct search_idle_state {
 	struct gfarm_eventqueue *q;
@@ -1403,6 +1858,104 @@ loadavg_compare(const void *a, const void *b)
 		return (0);
 }
 
+/* idle hosts in order of the distance, then busy hosts */
+static int
+topology_compare(const void *a, const void *b)
+{
+	struct search_idle_host_state *const *aa = a;
+	struct search_idle_host_state *const *bb = b;
+	const struct search_idle_host_state *p = *aa;
+	const struct search_idle_host_state *q = *bb;
+	const long long l1 = (p->loadavg
+	    + p->scheduled * VIRTUAL_LOAD_FOR_SCHEDULED_HOST) / p->ncpu;
+	const long long l2 = (q->loadavg
+	    + q->scheduled * VIRTUAL_LOAD_FOR_SCHEDULED_HOST) / q->ncpu;
+	const int idle1 = l1 <= IDLE_LOAD_AVERAGE;
+	const int idle2 = l2 <= IDLE_LOAD_AVERAGE;
+
+	if (idle1 != idle2)
+		return (idle1 ? -1 : 1);
+	if (idle1 && p->topology_distance != q->topology_distance)
+		return (p->topology_distance < q->topology_distance ? -1 : 1);
+	if (l1 < l2)
+		return (-1);
+	else if (l1 > l2)
+		return (1);
+	else
+		return (0);
+}
+
+struct location_round {
+	struct search_idle_host_state *h;
+	int round, index;
+};
+
+static int
+location_round_compare(const void *a, const void *b)
+{
+	const struct location_round *p = a;
+	const struct location_round *q = b;
+
+	if (p->round != q->round)
+		return (p->round < q->round ? -1 : 1);
+	return (p->index < q->index ? -1 : p->index > q->index ? 1 : 0);
+}
+
+static int
+location_is_same(const char *a, const char *b)
+{
+	if (a == NULL || b == NULL)
+		return (a == b);
+	return (strcmp(a, b) == 0);
+}
+
+/*
+ * reorder hosts to spread them over locations,
+ * i.e. the i-th host of each location is placed at the i-th round,
+ * preserving the order in the same location.
+ */
+static void
+search_idle_spread_over_locations(int n,
+	struct search_idle_host_state **results)
+{
+	struct location_round *rounds;
+	const char **locations;
+	int *counts, nlocations = 0, i, j;
+
+	GFARM_MALLOC_ARRAY(rounds, n);
+	GFARM_MALLOC_ARRAY(locations, n);
+	GFARM_MALLOC_ARRAY(counts, n);
+	if (rounds == NULL || locations == NULL || counts == NULL) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "search_idle_spread_over_locations: no memory");
+		free(rounds);
+		free(locations);
+		free(counts);
+		return; /* keep the order */
+	}
+	for (i = 0; i < n; i++) {
+		/* the number of locations is usually small */
+		for (j = 0; j < nlocations; j++) {
+			if (location_is_same(locations[j],
+			    results[i]->location))
+				break;
+		}
+		if (j == nlocations) {
+			locations[nlocations] = results[i]->location;
+			counts[nlocations++] = 0;
+		}
+		rounds[i].h = results[i];
+		rounds[i].round = counts[j]++;
+		rounds[i].index = i;
+	}
+	qsort(rounds, n, sizeof(*rounds), location_round_compare);
+	for (i = 0; i < n; i++)
+		results[i] = rounds[i].h;
+	free(rounds);
+	free(locations);
+	free(counts);
+}
+
 static int
 search_idle_cache_should_be_used(struct search_idle_host_state *h)
 {
@@ -1678,6 +2231,100 @@ search_idle_by_rtt_order(struct search_idle_state *s)
 	return (GFARM_ERR_NO_ERROR);
 }
 
+#ifndef __KERNEL__
+/* use the status measured by other processes, if it's newer */
+static void
+search_idle_shared_cache_import(struct search_idle_state *s)
+{
+	struct search_idle_host_state *h;
+	struct schedule_shared_cache_entry *ent;
+	struct timeval rtt_cache_time;
+	const char *username = gfm_client_username(s->gfm_server);
+
+	if (!schedule_shared_cache_is_enabled() ||
+	    !schedule_shared_cache_lock(F_RDLCK))
+		return;
+	for (h = staticp->search_idle_candidate_list; h != NULL; h = h->next) {
+		if ((h->flags & HOST_STATE_FLAG_ADDR_AVAIL) == 0)
+			continue;
+		ent = schedule_shared_cache_lookup(h->return_value, h->port,
+		    username, 0);
+		if (ent == NULL ||
+		    (ent->flags & HOST_STATE_FLAG_RTT_TRIED) == 0)
+			continue;
+		rtt_cache_time.tv_sec = ent->rtt_cache_sec;
+		rtt_cache_time.tv_usec = ent->rtt_cache_usec;
+		if (is_expired(&rtt_cache_time, LOADAVG_EXPIRATION))
+			continue;
+		if ((h->flags & HOST_STATE_FLAG_RTT_TRIED) != 0 &&
+		    gfarm_timeval_cmp(&h->rtt_cache_time, &rtt_cache_time)
+		    >= 0)
+			continue; /* this process knows newer status */
+
+		h->flags = (h->flags & ~SHARED_CACHE_HOST_FLAGS) | ent->flags;
+		h->rtt_cache_time = rtt_cache_time;
+		if ((ent->flags & HOST_STATE_FLAG_RTT_AVAIL) != 0) {
+			h->loadavg = ent->loadavg;
+			h->loadavg_cache_time = rtt_cache_time;
+			h->scheduled_age++;
+			h->scheduled = 0; /* because now we know real loadavg */
+			h->rtt_usec = ent->rtt_usec;
+			if ((h->net->flags & NET_FLAG_RTT_AVAIL) == 0 ||
+			    h->net->rtt_usec > h->rtt_usec) {
+				h->net->flags |= NET_FLAG_RTT_AVAIL;
+				h->net->rtt_usec = h->rtt_usec;
+			}
+		} else {
+			/* the host was down */
+			h->loadavg_cache_time = rtt_cache_time;
+		}
+		if ((ent->flags & HOST_STATE_FLAG_STATFS_AVAIL) != 0) {
+			h->statfs_cache_time.tv_sec = ent->statfs_cache_sec;
+			h->statfs_cache_time.tv_usec = ent->statfs_cache_usec;
+			h->diskused = ent->diskused;
+			h->diskavail = ent->diskavail;
+		}
+	}
+	schedule_shared_cache_unlock();
+}
+
+/* share the status which is measured by this process */
+static void
+search_idle_shared_cache_export(struct search_idle_state *s)
+{
+	struct search_idle_host_state *h;
+	struct schedule_shared_cache_entry *ent;
+	const char *username = gfm_client_username(s->gfm_server);
+
+	if (!schedule_shared_cache_is_enabled())
+		return;
+	for (h = staticp->search_idle_candidate_list; h != NULL; h = h->next) {
+		if ((h->flags & HOST_STATE_FLAG_JUST_CACHED) != 0)
+			break;
+	}
+	if (h == NULL || !schedule_shared_cache_lock(F_WRLCK))
+		return; /* nothing was measured */
+	for (; h != NULL; h = h->next) {
+		if ((h->flags & HOST_STATE_FLAG_JUST_CACHED) == 0)
+			continue;
+		ent = schedule_shared_cache_lookup(h->return_value, h->port,
+		    username, 1);
+		if (ent == NULL)
+			continue;
+		ent->flags = h->flags & SHARED_CACHE_HOST_FLAGS;
+		ent->rtt_cache_sec = h->rtt_cache_time.tv_sec;
+		ent->rtt_cache_usec = h->rtt_cache_time.tv_usec;
+		ent->rtt_usec = h->rtt_usec;
+		ent->loadavg = h->loadavg;
+		ent->statfs_cache_sec = h->statfs_cache_time.tv_sec;
+		ent->statfs_cache_usec = h->statfs_cache_time.tv_usec;
+		ent->diskused = h->diskused;
+		ent->diskavail = h->diskavail;
+	}
+	schedule_shared_cache_unlock();
+}
+#endif /* __KERNEL__ */
+
 /* `*nohostsp' is INPUT/OUTPUT parameter, and `*ohosts' is OUTPUT parameter */
 static gfarm_error_t
 search_idle(struct gfm_connection *gfm_server,
@@ -1703,6 +2350,9 @@ search_idle(struct gfm_connection *gfm_server,
 		    gfarm_error_string(e));
 		return (e);
 	}
+#ifndef __KERNEL__
+	search_idle_shared_cache_import(&s);
+#endif
 	gfs_profile(gfarm_gettimerval(&t2));
 
 	/*
@@ -1735,6 +2385,9 @@ search_idle(struct gfm_connection *gfm_server,
 			   gfarm_timerval_sub(&t3, &t2),
 			   gfarm_timerval_sub(&t4, &t3)));
 
+#ifndef __KERNEL__
+	search_idle_shared_cache_export(&s);
+#endif
 	gfarm_eventqueue_free(s.q);
 	if (e != GFARM_ERR_NO_ERROR) {
 		gflog_debug(GFARM_MSG_1001449,
@@ -1785,6 +2438,13 @@ search_idle(struct gfm_connection *gfm_server,
 				    davail_compare);
 			}
 		}
+		if (gfarm_schedule_topology_aware())
+			search_idle_spread_over_locations(n, results);
+	} else if (gfarm_schedule_topology_aware()) {
+		/* sort in order of distance and load average */
+		qsort(results, s.available_hosts_number, sizeof(*results),
+		    topology_compare);
+		n = s.available_hosts_number;
 	} else {
 		/* sort in order of load average */
 		qsort(results, s.available_hosts_number, sizeof(*results),
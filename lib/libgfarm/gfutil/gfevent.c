@@ -51,7 +51,7 @@ struct gfarm_event {
 	int filter;
 	void *closure;
 	struct timeval timeout;
-	int timeout_specified;
+	int timeout_index; /* in gfarm_eventqueue::timeouts, or -1 */
 
 	enum { GFARM_FD_EVENT, GFARM_TIMER_EVENT
 #ifdef __KERNEL__
@@ -93,6 +93,7 @@ gfarm_fd_event_alloc(int filter, int fd,
 	if (ev == NULL)
 		return (NULL);
 	ev->next = ev->prev = NULL; /* to be sure */
+	ev->timeout_index = -1;
 	ev->type = GFARM_FD_EVENT;
 	ev->filter = filter;
 	ev->closure = closure;
@@ -123,6 +124,7 @@ gfarm_timer_event_alloc(
 		return (NULL);
 	}
 	ev->next = ev->prev = NULL; /* to be sure */
+	ev->timeout_index = -1;
 	ev->type = GFARM_TIMER_EVENT;
 	ev->filter = GFARM_EVENT_TIMEOUT;
 	ev->closure = closure;
@@ -150,6 +152,7 @@ gfarm_kern_event_alloc(void *kevp,
 	if (ev == NULL)
 		return (NULL);
 	ev->next = ev->prev = NULL; /* to be sure */
+	ev->timeout_index = -1;
 	ev->type = GFARM_KERN_EVENT;
 	ev->filter = GFARM_EVENT_TIMEOUT;
 	ev->closure = closure;
@@ -179,10 +182,23 @@ struct gfarm_eventqueue {
 	/* doubly linked circular list with a header */
 	struct gfarm_event header;
 
+	/* binary min-heap of the events which have a timeout */
+	struct gfarm_event **timeouts;
+	int size_timeouts, n_timeouts;
+
 #ifdef HAVE_EPOLL
 	int size_epoll_events, n_epoll_events;
 	struct epoll_event *epoll_events;
 	int epoll_fd;
+
+	/*
+	 * the event which is watching each descriptor, indexed by the fd.
+	 * a descriptor is registered with EPOLLONESHOT, and stays registered
+	 * after its event is fired or deleted, so that it can be rearmed
+	 * by one EPOLL_CTL_MOD, instead of EPOLL_CTL_DEL and EPOLL_CTL_ADD.
+	 */
+	struct gfarm_event **epoll_fd_events;
+	int size_epoll_fd_events;
 #else
 	int fd_set_size, fd_set_bytes;
 	fd_set *read_fd_set, *write_fd_set, *exception_fd_set;
@@ -208,9 +224,14 @@ gfarm_eventqueue_alloc(int ndesc_hint, struct gfarm_eventqueue **qp)
 	/* make the queue empty */
 	q->header.next = q->header.prev = &q->header;
 
+	q->timeouts = NULL;
+	q->size_timeouts = q->n_timeouts = 0;
+
 #ifdef HAVE_EPOLL
 	q->size_epoll_events = q->n_epoll_events = 0;
 	q->epoll_events = NULL;
+	q->epoll_fd_events = NULL;
+	q->size_epoll_fd_events = 0;
 	q->epoll_fd = epoll_create(ndesc_hint);
 	if (q->epoll_fd == -1) {
 		free(q);
@@ -244,8 +265,10 @@ gfarm_eventqueue_alloc(int ndesc_hint, struct gfarm_eventqueue **qp)
 void
 gfarm_eventqueue_free(struct gfarm_eventqueue *q)
 {
+	free(q->timeouts);
 #ifdef HAVE_EPOLL
 	free(q->epoll_events);
+	free(q->epoll_fd_events);
 	close(q->epoll_fd);
 #else
 	free(q->read_fd_set);
@@ -381,21 +404,228 @@ gfarm_eventqueue_alloc_fd_set(struct gfarm_eventqueue *q, int fd,
 }
 #endif /* !HAVE_EPOLL */
 
+/*
+ * timeout heap
+ *
+ * The events which have a timeout are kept in a binary min-heap ordered by
+ * the timeout, so that the nearest one can be found without scanning
+ * the whole queue.
+ */
+
+#define TIMEOUT_HEAP_MIN_SIZE	16
+
+/* this must be called before gfarm_eventqueue_timeout_insert() */
+static int
+gfarm_eventqueue_timeout_reserve(struct gfarm_eventqueue *q)
+{
+	struct gfarm_event **p;
+	int sz;
+
+	if (q->n_timeouts < q->size_timeouts)
+		return (0);
+	sz = q->size_timeouts > 0 ? q->size_timeouts * 2 :
+	    TIMEOUT_HEAP_MIN_SIZE;
+	GFARM_REALLOC_ARRAY(p, q->timeouts, sz);
+	if (p == NULL) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "allocation of timeout heap (%d) failed", sz);
+		return (ENOMEM);
+	}
+	q->timeouts = p;
+	q->size_timeouts = sz;
+	return (0);
+}
+
+static void
+gfarm_eventqueue_timeout_set(struct gfarm_eventqueue *q, int i,
+	struct gfarm_event *ev)
+{
+	q->timeouts[i] = ev;
+	ev->timeout_index = i;
+}
+
+static void
+gfarm_eventqueue_timeout_sift_up(struct gfarm_eventqueue *q, int i)
+{
+	struct gfarm_event *ev = q->timeouts[i];
+	int parent;
+
+	while (i > 0) {
+		parent = (i - 1) / 2;
+		if (gfarm_timeval_cmp(&q->timeouts[parent]->timeout,
+		    &ev->timeout) <= 0)
+			break;
+		gfarm_eventqueue_timeout_set(q, i, q->timeouts[parent]);
+		i = parent;
+	}
+	gfarm_eventqueue_timeout_set(q, i, ev);
+}
+
+static void
+gfarm_eventqueue_timeout_sift_down(struct gfarm_eventqueue *q, int i)
+{
+	struct gfarm_event *ev = q->timeouts[i];
+	int child;
+
+	for (;;) {
+		child = i * 2 + 1;
+		if (child >= q->n_timeouts)
+			break;
+		if (child + 1 < q->n_timeouts &&
+		    gfarm_timeval_cmp(&q->timeouts[child + 1]->timeout,
+		    &q->timeouts[child]->timeout) < 0)
+			child++;
+		if (gfarm_timeval_cmp(&ev->timeout,
+		    &q->timeouts[child]->timeout) <= 0)
+			break;
+		gfarm_eventqueue_timeout_set(q, i, q->timeouts[child]);
+		i = child;
+	}
+	gfarm_eventqueue_timeout_set(q, i, ev);
+}
+
+static void
+gfarm_eventqueue_timeout_insert(struct gfarm_eventqueue *q,
+	struct gfarm_event *ev)
+{
+	int i = q->n_timeouts++;
+
+	gfarm_eventqueue_timeout_set(q, i, ev);
+	gfarm_eventqueue_timeout_sift_up(q, i);
+}
+
+static void
+gfarm_eventqueue_timeout_remove(struct gfarm_eventqueue *q,
+	struct gfarm_event *ev)
+{
+	int i = ev->timeout_index;
+	struct gfarm_event *last = q->timeouts[--q->n_timeouts];
+
+	ev->timeout_index = -1;
+	if (last == ev)
+		return;
+	gfarm_eventqueue_timeout_set(q, i, last);
+	if (i > 0 && gfarm_timeval_cmp(&q->timeouts[(i - 1) / 2]->timeout,
+	    &last->timeout) > 0)
+		gfarm_eventqueue_timeout_sift_up(q, i);
+	else
+		gfarm_eventqueue_timeout_sift_down(q, i);
+}
+
+#ifdef HAVE_EPOLL
+static int
+gfarm_eventqueue_epoll_fd_events_alloc(struct gfarm_eventqueue *q, int fd)
+{
+	struct gfarm_event **p;
+	int sz;
+
+	if (fd < q->size_epoll_fd_events)
+		return (0);
+	sz = q->size_epoll_fd_events > 0 ? q->size_epoll_fd_events : 64;
+	for (; fd >= sz; sz += sz)
+		;
+	GFARM_REALLOC_ARRAY(p, q->epoll_fd_events, sz);
+	if (p == NULL) {
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "allocation of epoll fd table (%d) failed", sz);
+		return (ENOMEM);
+	}
+	memset(p + q->size_epoll_fd_events, 0,
+	    sizeof(*p) * (sz - q->size_epoll_fd_events));
+	q->epoll_fd_events = p;
+	q->size_epoll_fd_events = sz;
+	return (0);
+}
+
+/*
+ * the descriptor is rearmed by EPOLL_CTL_MOD, if it was registered by
+ * a previous event.  EPOLL_CTL_ADD is used only at the first time,
+ * or after the descriptor is closed and reopened.
+ */
+static int
+gfarm_eventqueue_epoll_arm(struct gfarm_eventqueue *q,
+	struct gfarm_event *ev)
+{
+	struct epoll_event epoll_ev;
+	int fd = ev->u.fd.fd, save_errno;
+
+	if (fd < q->size_epoll_fd_events && q->epoll_fd_events[fd] != NULL) {
+		/* only one event can watch a descriptor, as EPOLL_CTL_ADD */
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "epoll: fd %d is already watched", fd);
+		return (EEXIST);
+	}
+	if ((save_errno = gfarm_eventqueue_epoll_fd_events_alloc(q, fd)) != 0)
+		return (save_errno);
+
+	memset(&epoll_ev, 0, sizeof(epoll_ev));
+	/* We use the level triggered mode, but only once per arming */
+	epoll_ev.events = EPOLLONESHOT;
+	if ((ev->filter & GFARM_EVENT_READ) != 0)
+		epoll_ev.events |= EPOLLIN;
+	if ((ev->filter & GFARM_EVENT_WRITE) != 0)
+		epoll_ev.events |= EPOLLOUT;
+	if ((ev->filter & GFARM_EVENT_EXCEPTION) != 0)
+		epoll_ev.events |= EPOLLPRI;
+	epoll_ev.data.fd = fd;
+	if (epoll_ctl(q->epoll_fd, EPOLL_CTL_MOD, fd, &epoll_ev) == -1 &&
+	    (errno != ENOENT ||
+	     epoll_ctl(q->epoll_fd, EPOLL_CTL_ADD, fd, &epoll_ev) == -1)) {
+		save_errno = errno;
+		gflog_debug(GFARM_MSG_1002519,
+		    "epoll_ctl(%d, EPOLL_CTL_MOD/ADD, %d, ): %s",
+		    q->epoll_fd, fd, strerror(save_errno));
+		return (save_errno);
+	}
+	q->epoll_fd_events[fd] = ev;
+	q->n_epoll_events++;
+	return (0);
+}
+
+/*
+ * if the event has been fired, EPOLLONESHOT has already disarmed
+ * the descriptor, otherwise it's disarmed by EPOLL_CTL_MOD here.
+ * the descriptor is removed from epoll_fd when it's closed.
+ */
+static void
+gfarm_eventqueue_epoll_disarm(struct gfarm_eventqueue *q,
+	struct gfarm_event *ev, int fired)
+{
+	struct epoll_event epoll_ev;
+	int fd = ev->u.fd.fd;
+
+	q->epoll_fd_events[fd] = NULL;
+	q->n_epoll_events--;
+	if (fired)
+		return;
+
+	memset(&epoll_ev, 0, sizeof(epoll_ev));
+	epoll_ev.events = EPOLLONESHOT; /* no event is reported */
+	epoll_ev.data.fd = fd;
+	if (epoll_ctl(q->epoll_fd, EPOLL_CTL_MOD, fd, &epoll_ev) == -1) {
+		gflog_warning(GFARM_MSG_1002520,
+		    "epoll_ctl(%d, EPOLL_CTL_MOD, %d, ): %s",
+		     q->epoll_fd, fd, strerror(errno));
+	}
+}
+#endif /* HAVE_EPOLL */
+
 int
 gfarm_eventqueue_add_event(struct gfarm_eventqueue *q,
 	struct gfarm_event *ev, const struct timeval *timeout)
 {
 #ifdef HAVE_EPOLL
-	struct epoll_event epoll_ev;
+	int rv;
 #endif
 
 	if (ev->next != NULL || ev->prev != NULL) /* shouldn't happen */
 		return (EINVAL);
 
 	if (timeout == NULL) {
-		ev->timeout_specified = 0;
+		ev->timeout_index = -1;
 	} else if ((ev->filter & GFARM_EVENT_TIMEOUT) != 0) {
-		ev->timeout_specified = 1;
+		if (gfarm_eventqueue_timeout_reserve(q) != 0)
+			return (ENOMEM);
 		gettimeofday(&ev->timeout, NULL);
 		gfarm_timeval_add(&ev->timeout, timeout);
 	} else {
@@ -410,25 +640,8 @@ gfarm_eventqueue_add_event(struct gfarm_eventqueue *q,
 	switch (ev->type) {
 	case GFARM_FD_EVENT:
 #ifdef HAVE_EPOLL
-		memset(&epoll_ev, 0, sizeof(epoll_ev));
-		epoll_ev.events = 0; /* We use the level triggered mode */
-		if ((ev->filter & GFARM_EVENT_READ) != 0)
-			epoll_ev.events |= EPOLLIN;
-		if ((ev->filter & GFARM_EVENT_WRITE) != 0)
-			epoll_ev.events |= EPOLLOUT;
-		if ((ev->filter & GFARM_EVENT_EXCEPTION) != 0)
-			epoll_ev.events |= EPOLLPRI;
-		epoll_ev.data.ptr = ev;
-		if (epoll_ctl(q->epoll_fd, EPOLL_CTL_ADD,
-		    ev->u.fd.fd, &epoll_ev) == -1) {
-			int save_errno = errno;
-			gflog_debug(GFARM_MSG_1002519,
-			    "epoll(%d, EPOLL_CTL_ADD, %d, %p): %s",
-			    q->epoll_fd, ev->u.fd.fd, &epoll_ev,
-			    strerror(errno));
-			return (save_errno);
-		}
-		q->n_epoll_events++;
+		if ((rv = gfarm_eventqueue_epoll_arm(q, ev)) != 0)
+			return (rv);
 #else
 		if ((ev->filter & GFARM_EVENT_READ) != 0) {
 			if (!gfarm_eventqueue_alloc_fd_set(q, ev->u.fd.fd,
@@ -474,6 +687,10 @@ gfarm_eventqueue_add_event(struct gfarm_eventqueue *q,
 #endif /* __KERNEL__ */
 	}
 
+	/* the room is reserved above */
+	if (timeout != NULL)
+		gfarm_eventqueue_timeout_insert(q, ev);
+
 	/* enqueue - insert at the tail of the circular list */
 	ev->next = &q->header;
 	ev->prev = q->header.prev;
@@ -482,15 +699,11 @@ gfarm_eventqueue_add_event(struct gfarm_eventqueue *q,
 	return (0);
 }
 
-int
-gfarm_eventqueue_delete_event(struct gfarm_eventqueue *q,
-	struct gfarm_event *ev)
+/* `fired' means that the descriptor is already disarmed by EPOLLONESHOT */
+static int
+gfarm_eventqueue_remove_event(struct gfarm_eventqueue *q,
+	struct gfarm_event *ev, int fired)
 {
-#ifdef HAVE_EPOLL
-	/* dummy is for linux before 2.6.9 */
-	struct epoll_event dummy;
-#endif
-
 	if (ev->next == NULL || ev->prev == NULL) { /* shouldn't happen */
 		gflog_debug(GFARM_MSG_1000780,
 			"Event queue link broken");
@@ -501,14 +714,7 @@ gfarm_eventqueue_delete_event(struct gfarm_eventqueue *q,
 
 	case GFARM_FD_EVENT:
 #ifdef HAVE_EPOLL
-		memset(&dummy, 0, sizeof(dummy));
-		if (epoll_ctl(q->epoll_fd, EPOLL_CTL_DEL, ev->u.fd.fd, &dummy)
-		    == -1) {
-			gflog_warning(GFARM_MSG_1002520,
-			    "epoll_ctl(%d, EPOLL_CTL_DEL, %d, ): %s",
-			     q->epoll_fd, ev->u.fd.fd, strerror(errno));
-		}
-		q->n_epoll_events--;
+		gfarm_eventqueue_epoll_disarm(q, ev, fired);
 #endif
 		break;
 	case GFARM_TIMER_EVENT:
@@ -520,6 +726,8 @@ gfarm_eventqueue_delete_event(struct gfarm_eventqueue *q,
 		break;
 #endif /* __KERNEL__ */
 	}
+	if (ev->timeout_index != -1)
+		gfarm_eventqueue_timeout_remove(q, ev);
 
 	/* dequeue */
 	ev->next->prev = ev->prev;
@@ -528,6 +736,13 @@ gfarm_eventqueue_delete_event(struct gfarm_eventqueue *q,
 	return (0);
 }
 
+int
+gfarm_eventqueue_delete_event(struct gfarm_eventqueue *q,
+	struct gfarm_event *ev)
+{
+	return (gfarm_eventqueue_remove_event(q, ev, 0));
+}
+
 /*
  * run one turn of select(2) loop.
  * this function may return before the timeout.
@@ -545,10 +760,13 @@ gfarm_eventqueue_turn(struct gfarm_eventqueue *q,
 	const struct timeval *timeo)
 {
 	int nfound;
-	struct gfarm_event *ev, *n;
+	struct gfarm_event *ev;
 	struct timeval start_time, end_time, timeout_value, *timeout = NULL;
 	int events;
-#ifndef HAVE_EPOLL
+#ifdef HAVE_EPOLL
+	int i, fd;
+#else
+	struct gfarm_event *n;
 	int max_fd = -1;
 	fd_set *read_fd_set, *write_fd_set, *exception_fd_set;
 #endif
@@ -560,8 +778,15 @@ gfarm_eventqueue_turn(struct gfarm_eventqueue *q,
 	/*
 	 * prepare arguments for select(2)
 	 */
+	gettimeofday(&start_time, NULL);
 	if (timeo != NULL) {
-		timeout_value = *timeo;
+		timeout_value = start_time;
+		gfarm_timeval_add(&timeout_value, timeo);
+		timeout = &timeout_value;
+	}
+	if (q->n_timeouts > 0 && (timeout == NULL ||
+	    gfarm_timeval_cmp(&q->timeouts[0]->timeout, timeout) < 0)) {
+		timeout_value = q->timeouts[0]->timeout;
 		timeout = &timeout_value;
 	}
 #ifndef HAVE_EPOLL
@@ -576,19 +801,9 @@ gfarm_eventqueue_turn(struct gfarm_eventqueue *q,
 	if (q->exception_fd_set != NULL)
 		memset(q->exception_fd_set, 0, q->fd_set_bytes);
 	read_fd_set = write_fd_set = exception_fd_set = NULL;
-#endif
 	for (ev = q->header.next; ev != &q->header; ev = ev->next) {
-		if (ev->timeout_specified) {
-			if (timeout == NULL) {
-				timeout = &timeout_value;
-				timeout_value = ev->timeout;
-			} else if (gfarm_timeval_cmp(&ev->timeout,timeout) <0){
-				timeout_value = ev->timeout;
-			}
-		}
 		switch (ev->type) {
 		case GFARM_FD_EVENT:
-#ifndef HAVE_EPOLL
 			if ((ev->filter & GFARM_EVENT_READ) != 0) {
 				read_fd_set = q->read_fd_set;
 				FD_SET(ev->u.fd.fd, read_fd_set);
@@ -603,7 +818,6 @@ gfarm_eventqueue_turn(struct gfarm_eventqueue *q,
 			}
 			if (ev->u.fd.fd > max_fd)
 				max_fd = ev->u.fd.fd;
-#endif
 			break;
 		case GFARM_TIMER_EVENT:
 			break;
@@ -621,6 +835,7 @@ gfarm_eventqueue_turn(struct gfarm_eventqueue *q,
 			max_fd = q->evfd;
 	}
 #endif /* __KERNEL__ */
+#endif /* !HAVE_EPOLL */
 
 	/*
 	 * do wait
@@ -629,7 +844,6 @@ gfarm_eventqueue_turn(struct gfarm_eventqueue *q,
 	if (max_fd < 0 && timeout == NULL)
 		return (EDEADLK); /* infinite sleep without any watching fd */
 #endif
-	gettimeofday(&start_time, NULL);
 	if (timeout != NULL) {
 		gfarm_timeval_sub(&timeout_value, &start_time);
 		if (timeout_value.tv_sec < 0)
@@ -677,52 +891,44 @@ gfarm_eventqueue_turn(struct gfarm_eventqueue *q,
 	 * call event callback routines
 	 */
 #ifdef HAVE_EPOLL
-	if (nfound > 0) {
-		int i;
-
-		for (i = 0; i < nfound; i++) {
-			ev = q->epoll_events[i].data.ptr;
-			events = 0;
-			if ((q->epoll_events[i].events & EPOLLIN) != 0)
-				events |= GFARM_EVENT_READ;
-			if ((q->epoll_events[i].events & EPOLLOUT) != 0)
-				events |= GFARM_EVENT_WRITE;
-			if ((q->epoll_events[i].events & EPOLLPRI) != 0)
-				events |= GFARM_EVENT_EXCEPTION;
-			if ((q->epoll_events[i].events & (EPOLLHUP|EPOLLERR))
-			    != 0)
-				events |= ev->filter & (GFARM_EVENT_READ|
-				    GFARM_EVENT_WRITE|GFARM_EVENT_EXCEPTION);
-			gfarm_eventqueue_delete_event(q, ev);
-			(*ev->u.fd.callback)(events, ev->u.fd.fd, ev->closure,
-			    &end_time);
-		}
-	} else {
-		for (ev = q->header.next; ev != &q->header; ev = n) {
-			n = ev->next;
-
-			switch (ev->type) {
-			case GFARM_FD_EVENT:
-				if (ev->timeout_specified &&
-				    gfarm_timeval_cmp(&end_time, &ev->timeout)
-				    >= 0) {
-					gfarm_eventqueue_delete_event(q, ev);
-					(*ev->u.fd.callback)(
-					    GFARM_EVENT_TIMEOUT, ev->u.fd.fd,
-					    ev->closure, &end_time);
-				}
-				break;
-			case GFARM_TIMER_EVENT:
-				if (gfarm_timeval_cmp(&end_time, &ev->timeout)
-				    >= 0){
-					gfarm_eventqueue_delete_event(q, ev);
-					(*ev->u.timeout.callback)(
-					    ev->closure, &end_time);
-				}
-				break;
-			default :
-				break;
-			}
+	for (i = 0; i < nfound; i++) {
+		/*
+		 * the event is looked up by the descriptor, because
+		 * a preceding callback may delete and free it.
+		 */
+		fd = q->epoll_events[i].data.fd;
+		ev = fd < q->size_epoll_fd_events ?
+		    q->epoll_fd_events[fd] : NULL;
+		if (ev == NULL)
+			continue;
+		events = 0;
+		if ((q->epoll_events[i].events & EPOLLIN) != 0)
+			events |= GFARM_EVENT_READ;
+		if ((q->epoll_events[i].events & EPOLLOUT) != 0)
+			events |= GFARM_EVENT_WRITE;
+		if ((q->epoll_events[i].events & EPOLLPRI) != 0)
+			events |= GFARM_EVENT_EXCEPTION;
+		if ((q->epoll_events[i].events & (EPOLLHUP|EPOLLERR)) != 0)
+			events |= GFARM_EVENT_READ|GFARM_EVENT_WRITE|
+			    GFARM_EVENT_EXCEPTION;
+		events &= ev->filter;
+		if (events == 0) /* the descriptor is rearmed by another event */
+			continue;
+		gfarm_eventqueue_remove_event(q, ev, 1);
+		(*ev->u.fd.callback)(events, fd, ev->closure, &end_time);
+	}
+	while (q->n_timeouts > 0 &&
+	    gfarm_timeval_cmp(&end_time, &q->timeouts[0]->timeout) >= 0) {
+		ev = q->timeouts[0];
+		gfarm_eventqueue_remove_event(q, ev, 0);
+		switch (ev->type) {
+		case GFARM_FD_EVENT:
+			(*ev->u.fd.callback)(GFARM_EVENT_TIMEOUT,
+			    ev->u.fd.fd, ev->closure, &end_time);
+			break;
+		case GFARM_TIMER_EVENT:
+			(*ev->u.timeout.callback)(ev->closure, &end_time);
+			break;
 		}
 	}
 #else /* !HAVE_EPOLL */
@@ -751,7 +957,7 @@ gfarm_eventqueue_turn(struct gfarm_eventqueue *q,
 				/* here is a good breakpoint on a debugger */
 				(*ev->u.fd.callback)(events, ev->u.fd.fd,
 				    ev->closure, &end_time);
-			} else if (ev->timeout_specified &&
+			} else if (ev->timeout_index != -1 &&
 			    gfarm_timeval_cmp(&end_time, &ev->timeout) >= 0) {
 				gfarm_eventqueue_delete_event(q, ev);
 				(*ev->u.fd.callback)(
@@ -774,7 +980,7 @@ gfarm_eventqueue_turn(struct gfarm_eventqueue *q,
 				}
 
 			}
-			if (ev->timeout_specified &&
+			if (ev->timeout_index != -1 &&
 			    gfarm_timeval_cmp(&end_time, &ev->timeout) >= 0) {
 				void *kevp = ev->u.kern.kevp;
 				ev->u.kern.kevp = NULL;
@@ -14,39 +14,101 @@
 #define ALIGNMENT 16
 #define HASH_ALIGN(p) (((unsigned long)(p) + ALIGNMENT - 1) & ~(ALIGNMENT - 1))
 
-/* string hash function by Peter Weinberger */
+/*
+ * string hash function, based on xxHash32 by Yann Collet.
+ * the input is read by each byte, thus the result doesn't depend on
+ * the alignment nor the byte order, and case folding can be applied.
+ */
+
+#define XXH_PRIME32_1	0x9E3779B1U
+#define XXH_PRIME32_2	0x85EBCA77U
+#define XXH_PRIME32_3	0xC2B2AE3DU
+#define XXH_PRIME32_4	0x27D4EB2FU
+#define XXH_PRIME32_5	0x165667B1U
+
+#define XXH_ROTL32(x, r)	(((x) << (r)) | ((x) >> (32 - (r))))
+
+static inline unsigned int
+xxh_byte(const unsigned char *p, int casefold)
+{
+	return (casefold ? tolower(*p) : *p);
+}
+
+static inline unsigned int
+xxh_read32(const unsigned char *p, int casefold)
+{
+	return (xxh_byte(p, casefold) |
+	    (xxh_byte(p + 1, casefold) << 8) |
+	    (xxh_byte(p + 2, casefold) << 16) |
+	    (xxh_byte(p + 3, casefold) << 24));
+}
+
+static inline unsigned int
+xxh_round(unsigned int acc, unsigned int input)
+{
+	acc += input * XXH_PRIME32_2;
+	acc = XXH_ROTL32(acc, 13);
+	return (acc * XXH_PRIME32_1);
+}
+
+static inline unsigned int
+xxh32(const void *key, int keylen, int casefold)
+{
+	const unsigned char *p = key, *end = p + keylen;
+	unsigned int h, v1, v2, v3, v4;
+
+	if (keylen >= 16) {
+		const unsigned char *limit = end - 16;
+
+		v1 = XXH_PRIME32_1 + XXH_PRIME32_2;
+		v2 = XXH_PRIME32_2;
+		v3 = 0;
+		v4 = 0 - XXH_PRIME32_1;
+		do {
+			v1 = xxh_round(v1, xxh_read32(p, casefold));
+			v2 = xxh_round(v2, xxh_read32(p + 4, casefold));
+			v3 = xxh_round(v3, xxh_read32(p + 8, casefold));
+			v4 = xxh_round(v4, xxh_read32(p + 12, casefold));
+			p += 16;
+		} while (p <= limit);
+		h = XXH_ROTL32(v1, 1) + XXH_ROTL32(v2, 7) +
+		    XXH_ROTL32(v3, 12) + XXH_ROTL32(v4, 18);
+	} else {
+		h = XXH_PRIME32_5;
+	}
+	h += (unsigned int)keylen;
+
+	for (; p + 4 <= end; p += 4) {
+		h += xxh_read32(p, casefold) * XXH_PRIME32_3;
+		h = XXH_ROTL32(h, 17) * XXH_PRIME32_4;
+	}
+	for (; p < end; p++) {
+		h += xxh_byte(p, casefold) * XXH_PRIME32_5;
+		h = XXH_ROTL32(h, 11) * XXH_PRIME32_1;
+	}
+
+	h ^= h >> 15;
+	h *= XXH_PRIME32_2;
+	h ^= h >> 13;
+	h *= XXH_PRIME32_3;
+	h ^= h >> 16;
+	return (h);
+}
+
+/*
+ * NOTE: the value is stored in the scheduling cache shared among processes,
+ * thus SHARED_CACHE_VERSION in schedule.c must be changed with this.
+ */
 int
 gfarm_hash_default(const void *key, int keylen)
 {
-	int i;
-	unsigned int hash = 0, g;
-
-	for (i = 0; i < keylen; i++) {
-		hash = (hash << 4) + ((unsigned char *)key)[i];
-		/* this assumes size of `int' is 32 bit */
-		if ((g = hash & 0xf0000000) != 0) {
-			hash ^= g >> 24;
-			hash ^= g;
-		}
-	}
-	return (hash);
+	return (xxh32(key, keylen, 0));
 }
 
 int
 gfarm_hash_casefold(const void *key, int keylen)
 {
-	int i;
-	unsigned int hash = 0, g;
-
-	for (i = 0; i < keylen; i++) {
-		hash = (hash << 4) + tolower(((unsigned char *)key)[i]);
-		/* this assumes size of `int' is 32 bit */
-		if ((g = hash & 0xf0000000) != 0) {
-			hash ^= g >> 24;
-			hash ^= g;
-		}
-	}
-	return (hash);
+	return (xxh32(key, keylen, 1));
 }
 
 int
@@ -72,8 +134,31 @@ gfarm_hash_key_equal_casefold(const void *key1, int key1len,
 	return (1);
 }
 
+/*
+ * hash table
+ *
+ * This is an open addressing table with linear probing.
+ * Each slot has a control byte, which is either HASH_CTRL_EMPTY,
+ * HASH_CTRL_DELETED, or a flag bit and 7 bits of the hash value
+ * of the entry in the slot, so that most of mismatched slots are skipped
+ * without touching the entry.
+ * The control bytes are stored apart from the entry pointers to be
+ * cache friendly.  The entries themselves are allocated one by one,
+ * thus their address is stable, as the chained table in the past.
+ *
+ * The table is doubled when 7/8 of the slots are used or deleted.
+ * The entries in the old slots are moved to the new slots incrementally
+ * by HASH_MIGRATE_STEP slots at each gfarm_hash_enter(), to avoid
+ * a latency spike of rehashing a large table at once.
+ * Until then, both of the old and the new slots are searched.
+ *
+ * A deleted slot is left as HASH_CTRL_DELETED, and reused by an insertion.
+ * Thus purging entries during iteration never moves the others,
+ * but entering an entry during iteration is not allowed.
+ */
+
 struct gfarm_hash_entry {
-	struct gfarm_hash_entry *next;
+	unsigned int hash;	/* mixed */
 	int key_length;
 	int data_length;
 	double key_stub;
@@ -85,117 +170,329 @@ struct gfarm_hash_entry {
 #define HASH_DATA(entry) \
 	(HASH_KEY(entry) + HASH_ALIGN((entry)->key_length))
 
+/* HASH_CTRL_EMPTY is 0, to leave the initialization to calloc(3) */
+#define HASH_CTRL_EMPTY		0x00
+#define HASH_CTRL_DELETED	0x01
+#define HASH_CTRL_TAG(hash)	((unsigned char)(0x80 | ((hash) >> 25)))
+#define HASH_CTRL_IS_FULL(c)	(((c) & 0x80) != 0)
+
+#define HASH_MIN_SLOTS		8
+#define HASH_MIGRATE_STEP	16	/* slots */
+
+struct gfarm_hash_slots {
+	unsigned int nslots;		/* power of 2 */
+	unsigned int nused, ndeleted;
+	struct gfarm_hash_entry **entries;
+	unsigned char *ctrl;
+};
+
 struct gfarm_hash_table {
-	int table_size;
+	struct gfarm_hash_slots cur;
+
+	/* the slots before growing, old.entries == NULL if not growing */
+	struct gfarm_hash_slots old;
+	unsigned int migrate_index;
 
 	int (*hash)(const void *, int);
 	int (*equal)(const void *, int, const void *, int);
-
-	struct gfarm_hash_entry *buckets[1];
 };
 
+/*
+ * the hash functions given by the callers are not always uniform,
+ * e.g. a sum of a string hash and a port number, thus the result is mixed
+ * before it's used as an index of the power-of-2 slots.
+ * (the finalizer of MurmurHash3 by Austin Appleby)
+ */
+static unsigned int
+hash_mix(unsigned int h)
+{
+	h ^= h >> 16;
+	h *= 0x85ebca6bU;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35U;
+	h ^= h >> 16;
+	return (h);
+}
+
+static int
+hash_slots_alloc(struct gfarm_hash_slots *slots, unsigned int nslots)
+{
+	size_t entries_size;
+	int overflow = 0;
+	char *p;
+
+	entries_size = gfarm_size_mul(&overflow,
+	    sizeof(*slots->entries), nslots);
+	/* a large calloc(3) doesn't touch the pages, unlike memset(3) */
+	p = calloc(1, gfarm_size_add(&overflow, entries_size, nslots));
+	if (overflow || p == NULL) {
+		if (p != NULL)
+			free(p);
+		gflog_debug(GFARM_MSG_1000784,
+		    "allocation of hash slots (%u) failed", nslots);
+		return (0);
+	}
+	slots->nslots = nslots;
+	slots->nused = slots->ndeleted = 0;
+	slots->entries = (struct gfarm_hash_entry **)p;
+	slots->ctrl = (unsigned char *)p + entries_size;
+	return (1);
+}
+
+static void
+hash_slots_free(struct gfarm_hash_slots *slots)
+{
+	free(slots->entries); /* ctrl is allocated together */
+	slots->entries = NULL;
+	slots->ctrl = NULL;
+	slots->nslots = slots->nused = slots->ndeleted = 0;
+}
+
+/*
+ * returns the index of the slot which has the key,
+ * or -1 if not found.  in the latter case, if insertp != NULL,
+ * *insertp is set to the slot where the key should be inserted.
+ */
+static long
+hash_slots_search(struct gfarm_hash_table *hashtab,
+	struct gfarm_hash_slots *slots, unsigned int hash,
+	const void *key, int keylen, long *insertp)
+{
+	int (*equal)(const void *, int, const void *, int) = hashtab->equal;
+	unsigned int mask = slots->nslots - 1, i = hash & mask;
+	unsigned char c, tag = HASH_CTRL_TAG(hash);
+	struct gfarm_hash_entry *p;
+	long insert = -1;
+
+	/* there is always an empty slot, see hash_grow() */
+	for (;; i = (i + 1) & mask) {
+		c = slots->ctrl[i];
+		if (c == tag) {
+			p = slots->entries[i];
+			if (p->hash == hash &&
+			    (*equal)(HASH_KEY(p), p->key_length, key, keylen))
+				return (i);
+		} else if (c == HASH_CTRL_EMPTY) {
+			break;
+		} else if (c == HASH_CTRL_DELETED && insert == -1) {
+			insert = i;
+		}
+	}
+	if (insertp != NULL)
+		*insertp = insert != -1 ? insert : i;
+	return (-1);
+}
+
+static void
+hash_slots_set(struct gfarm_hash_slots *slots, long i,
+	struct gfarm_hash_entry *p)
+{
+	if (slots->ctrl[i] == HASH_CTRL_DELETED)
+		slots->ndeleted--;
+	slots->ctrl[i] = HASH_CTRL_TAG(p->hash);
+	slots->entries[i] = p;
+	slots->nused++;
+}
+
+static void
+hash_slots_delete(struct gfarm_hash_slots *slots, long i)
+{
+	free(slots->entries[i]);
+	slots->entries[i] = NULL;
+	slots->nused--;
+	/* an empty slot can be reclaimed, if the next slot is empty */
+	if (slots->ctrl[(i + 1) & (slots->nslots - 1)] == HASH_CTRL_EMPTY) {
+		slots->ctrl[i] = HASH_CTRL_EMPTY;
+	} else {
+		slots->ctrl[i] = HASH_CTRL_DELETED;
+		slots->ndeleted++;
+	}
+}
+
+/* move the entries from the old slots to the current ones */
+static void
+hash_migrate(struct gfarm_hash_table *hashtab, unsigned int nmigrate)
+{
+	struct gfarm_hash_slots *old = &hashtab->old, *cur = &hashtab->cur;
+	unsigned int mask = cur->nslots - 1, i, j;
+
+	for (; nmigrate > 0 && hashtab->migrate_index < old->nslots;
+	    nmigrate--) {
+		i = hashtab->migrate_index++;
+		if (!HASH_CTRL_IS_FULL(old->ctrl[i]))
+			continue;
+		/* the key is unique, thus the search is not necessary */
+		for (j = old->entries[i]->hash & mask;
+		    HASH_CTRL_IS_FULL(cur->ctrl[j]); j = (j + 1) & mask)
+			;
+		hash_slots_set(cur, j, old->entries[i]);
+	}
+	if (hashtab->migrate_index >= old->nslots)
+		hash_slots_free(old);
+}
+
+/*
+ * called before an insertion into the current slots.
+ * returns 1, if the current slots are changed.
+ * NOTE: even if the allocation fails, the table is still usable.
+ */
+static int
+hash_grow(struct gfarm_hash_table *hashtab)
+{
+	struct gfarm_hash_slots *cur = &hashtab->cur, new;
+	unsigned int nslots = cur->nslots;
+	int changed = 0;
+
+	if (hashtab->old.entries != NULL) {
+		hash_migrate(hashtab, HASH_MIGRATE_STEP);
+		changed = 1;
+	}
+	if ((cur->nused + cur->ndeleted + 1) * 8 <= nslots * 7)
+		return (changed);
+	/* shouldn't happen, because the current slots are large enough */
+	if (hashtab->old.entries != NULL)
+		hash_migrate(hashtab, hashtab->old.nslots);
+
+	/* if many slots are deleted, they are simply cleaned up */
+	if (cur->nused * 2 >= nslots)
+		nslots *= 2;
+	if (!hash_slots_alloc(&new, nslots)) {
+		/* the insertion can be done, unless all slots are full */
+		return (changed);
+	}
+	hashtab->old = *cur;
+	hashtab->cur = new;
+	hashtab->migrate_index = 0;
+	hash_migrate(hashtab, HASH_MIGRATE_STEP);
+	return (1);
+}
+
 struct gfarm_hash_table *
 gfarm_hash_table_alloc(int size,
 		       int (*hash)(const void *, int),
 		       int (*equal)(const void *, int, const void *, int))
 {
 	struct gfarm_hash_table *hashtab;
-	size_t alloc_size;
-	int overflow = 0;
-	
-	alloc_size = gfarm_size_add(&overflow,
-			sizeof(struct gfarm_hash_table),
-			gfarm_size_mul(&overflow, 
-				sizeof(struct gfarm_hash_entry *), size - 1));
-	if (overflow) {
+	unsigned int nslots;
+
+	/* `size' is a hint of the number of entries */
+	for (nslots = HASH_MIN_SLOTS; (int)nslots < size && nslots < (1U << 30);
+	    nslots *= 2)
+		;
+
+	hashtab = malloc(sizeof(*hashtab));
+	if (hashtab == NULL) {
 		gflog_debug(GFARM_MSG_1000783,
-			"Overflow when allocating hash table, size=(%d)",
+			"allocation of 'gfarm_hash_table' failed, size=(%d)",
 			size);
 		return (NULL);
 	}
-	hashtab = malloc(alloc_size); /* size is already checked */
-	if (hashtab == NULL) {
-		gflog_debug(GFARM_MSG_1000784,
-			"allocation of 'gfarm_hash_table' (%zd) failed",
-			alloc_size);
+	if (!hash_slots_alloc(&hashtab->cur, nslots)) {
+		free(hashtab);
 		return (NULL);
 	}
-	hashtab->table_size = size;
+	hashtab->old.entries = NULL;
+	hashtab->old.ctrl = NULL;
+	hashtab->old.nslots = hashtab->old.nused = hashtab->old.ndeleted = 0;
+	hashtab->migrate_index = 0;
 	hashtab->hash = hash;
 	hashtab->equal = equal;
-	memset(hashtab->buckets, 0, sizeof(struct gfarm_hash_entry *) * size);
 	return (hashtab);
 }
 
-void
-gfarm_hash_table_free(struct gfarm_hash_table *hashtab)
+static void
+hash_slots_free_entries(struct gfarm_hash_slots *slots, unsigned int start)
 {
-	int i;
-	struct gfarm_hash_entry *p, *np;
+	unsigned int i;
 
-	for (i = 0; i < hashtab->table_size; i++) {
-		for (p = hashtab->buckets[i]; p != NULL; p = np) {
-			np = p->next;
-			free(p);
-		}
+	if (slots->entries == NULL)
+		return;
+	for (i = start; i < slots->nslots; i++) {
+		if (HASH_CTRL_IS_FULL(slots->ctrl[i]))
+			free(slots->entries[i]);
 	}
+	hash_slots_free(slots);
+}
+
+void
+gfarm_hash_table_free(struct gfarm_hash_table *hashtab)
+{
+	hash_slots_free_entries(&hashtab->old, hashtab->migrate_index);
+	hash_slots_free_entries(&hashtab->cur, 0);
 	free(hashtab);
 }
 
-static struct gfarm_hash_entry **
-gfarm_hash_lookup_internal_search(struct gfarm_hash_table *hashtab,
-	struct gfarm_hash_entry **pp,
-	const void *key, int keylen)
+/*
+ * an iterator index less than cur.nslots points the current slots,
+ * otherwise it points the old slots.
+ */
+static long
+hash_lookup_index(struct gfarm_hash_table *hashtab,
+	const void *key, int keylen, unsigned int hash, long *insertp)
 {
-	struct gfarm_hash_entry *p;
-	int (*equal)(const void *, int, const void *, int) = hashtab->equal;
+	long i;
+
+	i = hash_slots_search(hashtab, &hashtab->cur, hash, key, keylen,
+	    insertp);
+	if (i != -1 || hashtab->old.entries == NULL)
+		return (i);
+	i = hash_slots_search(hashtab, &hashtab->old, hash, key, keylen,
+	    NULL);
+	return (i == -1 ? -1 : hashtab->cur.nslots + i);
+}
 
-	for (p = *pp; p != NULL; pp = &p->next, p = *pp) {
-		if ((*equal)(HASH_KEY(p), p->key_length, key, keylen))
-			break;
-	}
-	return (pp);
+static struct gfarm_hash_entry *
+hash_index_entry(struct gfarm_hash_table *hashtab, long i)
+{
+	return (i < hashtab->cur.nslots ? hashtab->cur.entries[i] :
+	    hashtab->old.entries[i - hashtab->cur.nslots]);
 }
 
-#define HASH_BUCKET(hashtab, key, keylen) \
-	((*hashtab->hash)(key, keylen) % hashtab->table_size)
+static void
+hash_index_delete(struct gfarm_hash_table *hashtab, long i)
+{
+	if (i < hashtab->cur.nslots)
+		hash_slots_delete(&hashtab->cur, i);
+	else
+		hash_slots_delete(&hashtab->old, i - hashtab->cur.nslots);
+}
 
-#define GFARM_HASH_LOOKUP_INTERNAL(hashtab, key, keylen) \
-	gfarm_hash_lookup_internal_search(hashtab, \
-	    &hashtab->buckets[HASH_BUCKET(hashtab, key, keylen)], \
-	    key, keylen)
+#define HASH_VALUE(hashtab, key, keylen) \
+	hash_mix((unsigned int)(*(hashtab)->hash)(key, keylen))
 
 struct gfarm_hash_entry *
 gfarm_hash_lookup(struct gfarm_hash_table *hashtab,
 		  const void *key, int keylen)
 {
-	struct gfarm_hash_entry **pp =
-		GFARM_HASH_LOOKUP_INTERNAL(hashtab, key, keylen);
+	long i = hash_lookup_index(hashtab, key, keylen,
+	    HASH_VALUE(hashtab, key, keylen), NULL);
 
-	return (*pp);
+	return (i == -1 ? NULL : hash_index_entry(hashtab, i));
 }
 
 struct gfarm_hash_entry *
 gfarm_hash_enter(struct gfarm_hash_table *hashtab, const void *key, int keylen,
 		  int datalen, int *createdp)
 {
-	struct gfarm_hash_entry *p, **pp =
-		GFARM_HASH_LOOKUP_INTERNAL(hashtab, key, keylen);
+	struct gfarm_hash_entry *p;
+	unsigned int hash = HASH_VALUE(hashtab, key, keylen);
 	size_t hash_entry_size;
 	int overflow = 0;
+	long i, insert;
 
 	if (createdp != NULL)
 		*createdp = 0;
 
-	if (*pp != NULL)
-		return (*pp);
+	i = hash_lookup_index(hashtab, key, keylen, hash, &insert);
+	if (i != -1)
+		return (hash_index_entry(hashtab, i));
 
 	/*
 	 * create if not found
 	 */
 	hash_entry_size =
 		gfarm_size_add(&overflow,
-		    gfarm_size_add(&overflow, 	 
+		    gfarm_size_add(&overflow,
 			HASH_ALIGN(offsetof(struct gfarm_hash_entry, key_stub)),
 			HASH_ALIGN(keylen)),
 		    datalen);
@@ -204,6 +501,16 @@ gfarm_hash_enter(struct gfarm_hash_table *hashtab, const void *key, int keylen,
 			"Overflow when entering hash entry");
 		return (NULL);
 	}
+	if (hash_grow(hashtab)) /* the slot to insert may be changed */
+		(void)hash_slots_search(hashtab, &hashtab->cur, hash,
+		    key, keylen, &insert);
+	if (hashtab->cur.nused + hashtab->cur.ndeleted + 1 >=
+	    hashtab->cur.nslots) {
+		/* hash_grow() failed, and no room is left */
+		gflog_debug(GFARM_MSG_UNFIXED,
+			"hash table is full (%u)", hashtab->cur.nslots);
+		return (NULL);
+	}
 	p = malloc(hash_entry_size); /* size is already checked */
 	if (p == NULL) {
 		gflog_debug(GFARM_MSG_1000786,
@@ -211,13 +518,13 @@ gfarm_hash_enter(struct gfarm_hash_table *hashtab, const void *key, int keylen,
 			hash_entry_size);
 		return (NULL);
 	}
-	*pp = p;
-
-	p->next = NULL;
+	p->hash = hash;
 	p->key_length = keylen;
 	p->data_length = datalen;
 	memcpy(HASH_KEY(p), key, keylen);
 
+	hash_slots_set(&hashtab->cur, insert, p);
+
 	if (createdp != NULL)
 		*createdp = 1;
 	return (p);
@@ -226,14 +533,12 @@ gfarm_hash_enter(struct gfarm_hash_table *hashtab, const void *key, int keylen,
 int
 gfarm_hash_purge(struct gfarm_hash_table *hashtab, const void *key, int keylen)
 {
-	struct gfarm_hash_entry *p, **pp =
-		GFARM_HASH_LOOKUP_INTERNAL(hashtab, key, keylen);
+	long i = hash_lookup_index(hashtab, key, keylen,
+	    HASH_VALUE(hashtab, key, keylen), NULL);
 
-	p = *pp;
-	if (p == NULL)
+	if (i == -1)
 		return (0); /* key is not found */
-	*pp = p->next;
-	free(p);
+	hash_index_delete(hashtab, i);
 	return (1); /* purged */
 }
 
@@ -263,20 +568,35 @@ gfarm_hash_entry_data_length(struct gfarm_hash_entry *entry)
 
 /*
  * hash iterator
+ *
+ * the current slots are visited first, and then the old slots
+ * which are not migrated yet.
  */
-int
+static int
 gfarm_hash_iterator_valid_entry(struct gfarm_hash_iterator *iterator)
 {
 	struct gfarm_hash_table *hashtab = iterator->table;
+	struct gfarm_hash_slots *cur = &hashtab->cur, *old = &hashtab->old;
+	long i = iterator->index;
 
-	if (iterator->bucket_index >= hashtab->table_size)
-		return (0);
-	while (*iterator->pp == NULL) {
-		if (++iterator->bucket_index >= hashtab->table_size)
-			return (0);
-		iterator->pp = &hashtab->buckets[iterator->bucket_index];
+	for (; i < cur->nslots; i++) {
+		if (HASH_CTRL_IS_FULL(cur->ctrl[i])) {
+			iterator->index = i;
+			return (1);
+		}
 	}
-	return (1);
+	if (old->entries != NULL) {
+		if (i < cur->nslots + hashtab->migrate_index)
+			i = cur->nslots + hashtab->migrate_index;
+		for (; i < cur->nslots + old->nslots; i++) {
+			if (HASH_CTRL_IS_FULL(old->ctrl[i - cur->nslots])) {
+				iterator->index = i;
+				return (1);
+			}
+		}
+	}
+	iterator->index = i;
+	return (0);
 }
 
 void
@@ -284,17 +604,13 @@ gfarm_hash_iterator_begin(struct gfarm_hash_table *hashtab,
 	struct gfarm_hash_iterator *iterator)
 {
 	iterator->table = hashtab;
-	iterator->bucket_index = 0;
-	iterator->pp = &hashtab->buckets[0 /* == iterator->bucket_index */];
+	iterator->index = 0;
 }
 
 void
 gfarm_hash_iterator_next(struct gfarm_hash_iterator *iterator)
 {
-	if (*iterator->pp == NULL)
-		iterator->bucket_index++;
-	else
-		iterator->pp = &(*iterator->pp)->next;
+	iterator->index++;
 }
 
 int
@@ -307,7 +623,7 @@ struct gfarm_hash_entry *
 gfarm_hash_iterator_access(struct gfarm_hash_iterator *iterator)
 {
 	if (gfarm_hash_iterator_valid_entry(iterator))
-		return (*iterator->pp);
+		return (hash_index_entry(iterator->table, iterator->index));
 	else
 		return (NULL);
 }
@@ -317,23 +633,25 @@ gfarm_hash_iterator_lookup(struct gfarm_hash_table *hashtab,
 	const void *key, int keylen,
 	struct gfarm_hash_iterator *iterator)
 {
+	long i = hash_lookup_index(hashtab, key, keylen,
+	    HASH_VALUE(hashtab, key, keylen), NULL);
+
 	iterator->table = hashtab;
-	iterator->bucket_index = HASH_BUCKET(hashtab, key, keylen);
-	iterator->pp = gfarm_hash_lookup_internal_search(hashtab,
-	    &hashtab->buckets[HASH_BUCKET(hashtab, key, keylen)],
-	    key, keylen);
-	return (*iterator->pp != NULL);
+	if (i == -1) {
+		/* points the end */
+		iterator->index = hashtab->cur.nslots + hashtab->old.nslots;
+		return (0);
+	}
+	iterator->index = i;
+	return (1);
 }
 
+/* the iterator points the next entry after this */
 int
 gfarm_hash_iterator_purge(struct gfarm_hash_iterator *iterator)
 {
-	struct gfarm_hash_entry *p;
-
 	if (!gfarm_hash_iterator_valid_entry(iterator))
 		return (0); /* not purged */
-	p = *iterator->pp;
-	*iterator->pp = p->next;
-	free(p);
+	hash_index_delete(iterator->table, iterator->index);
 	return (1); /* purged */
 }
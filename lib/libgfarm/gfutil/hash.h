@@ -39,10 +39,14 @@ int gfarm_hash_entry_data_length(struct gfarm_hash_entry *);
 
 struct gfarm_hash_iterator {
 	struct gfarm_hash_table *table;
-	int bucket_index;
-	struct gfarm_hash_entry **pp;
+	long index;
 };
 
+/*
+ * gfarm_hash_iterator_purge() makes the iterator point the next entry.
+ * entering an entry into the table during iteration is not allowed.
+ */
+
 void gfarm_hash_iterator_begin(struct gfarm_hash_table *,
 	struct gfarm_hash_iterator *);
 void gfarm_hash_iterator_next(struct gfarm_hash_iterator *);
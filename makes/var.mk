@@ -61,6 +61,11 @@ GFARMLIB_SRCDIR = $(top_srcdir)/lib/libgfarm/gfarm
 GFMD_SRCDIR = $(top_srcdir)/server/gfmd
 GFMD_BUILDDIR = $(top_builddir)/server/gfmd
 
+# gfsd
+
+GFSD_SRCDIR = $(top_srcdir)/server/gfsd
+GFSD_BUILDDIR = $(top_builddir)/server/gfsd
+
 # doc & man
 
 XSLTPROC = xsltproc
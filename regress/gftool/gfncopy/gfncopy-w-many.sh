@@ -0,0 +1,73 @@
+#!/bin/sh
+
+# automatic replication of many files from two hosts to each other,
+# which makes a back channel gfsd replicate several files at once.
+
+. ./regress.conf
+
+dir=$gftmp
+nfiles=32
+
+cleanup() {
+    gfrm -rf ${dir}
+    rm -f $localtmp
+}
+
+trap 'cleanup; exit $exit_trap' $trap_sigs
+
+set -- `gfsched -w | head -2`
+[ $# -eq 2 ] || exit $exit_unsupported
+host0=$1
+host1=$2
+
+awk 'BEGIN { for (i = 0; i < 20000; i++) printf "%09d\n", i }' > $localtmp
+if gfmkdir ${dir} && gfncopy -s 2 ${dir}; then
+    :
+else
+    cleanup
+    exit $exit_fail
+fi
+
+files=
+i=0
+while [ $i -lt $nfiles ]; do
+    if [ `expr $i % 2` -eq 0 ]; then src=$host0; else src=$host1; fi
+    if gfreg -h $src $localtmp ${dir}/f$i; then
+	:
+    else
+	echo >&2 "gfreg -h $src ${dir}/f$i failed"
+	cleanup
+	exit $exit_fail
+    fi
+    files="$files ${dir}/f$i"
+    i=`expr $i + 1`
+done
+
+if gfncopy -w -t 120 $files; then
+    :
+else
+    echo >&2 "gfncopy -w failed"
+    cleanup
+    exit $exit_fail
+fi
+
+exit_code=$exit_pass
+i=0
+while [ $i -lt $nfiles ]; do
+    if [ `expr $i % 2` -eq 0 ]; then dst=$host1; else dst=$host0; fi
+    f=${dir}/f$i
+    n=`gfncopy -c $f`
+    if [ "$n" != 2 ]; then
+	echo >&2 "$f: $n replicas"
+	exit_code=$exit_fail
+    elif gfexport -h $dst $f | cmp -s - $localtmp; then
+	:
+    else
+	echo >&2 "$f: replica on $dst is broken"
+	exit_code=$exit_fail
+    fi
+    i=`expr $i + 1`
+done
+
+cleanup
+exit $exit_code
@@ -0,0 +1,49 @@
+#!/bin/sh
+
+# chained replication by gfrep -c, the second destination receives
+# the replica relayed by the first destination, which is still receiving
+# it from the source, by GFS_PROTO_REPLICA_ADD_FROM_RELAY and
+# GFS_PROTO_FHOPEN_RELAY.
+
+. ./regress.conf
+
+hostfile=$localtmp.hosts
+
+cleanup() {
+    gfrm -f $gftmp
+    rm -f $localtmp $localtmp.out $hostfile
+}
+
+trap 'cleanup; exit $exit_trap' $trap_sigs
+
+set -- `gfsched -w | head -3`
+[ $# -eq 3 ] || exit $exit_unsupported
+src=$1
+shift
+echo $1 >$hostfile
+echo $2 >>$hostfile
+
+# large enough to be relayed while it's being received
+awk 'BEGIN { for (i = 0; i < 1000000; i++) printf "%09d\n", i }' >$localtmp
+if gfreg -h $src $localtmp $gftmp &&
+   gfrep -q -c -N 2 -H $hostfile $gftmp; then
+    :
+else
+    echo >&2 "gfreg or gfrep -c failed"
+    cleanup
+    exit $exit_fail
+fi
+
+exit_code=$exit_pass
+for host in $src "$@"; do
+    if gfexport -h $host $gftmp >$localtmp.out &&
+       cmp -s $localtmp $localtmp.out; then
+	:
+    else
+	echo >&2 "replica on $host differs"
+	exit_code=$exit_fail
+    fi
+done
+
+cleanup
+exit $exit_code
@@ -0,0 +1,265 @@
+/*
+ * check that large 'b' and 'B' fields are transferred correctly by
+ * gfp_xdr_send() and gfp_xdr_recv(), both with and without the writev
+ * operation of the socket, and measure the throughput of 'b' fields.
+ *
+ * the sender is the parent process, and the receiver is a child process,
+ * connected by a socketpair.
+ *
+ * $Id$
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include <gfarm/gfarm.h>
+
+#include "context.h"
+#include "gfp_xdr.h"
+#include "io_fd.h"
+
+#define BENCH_SIZE_MAX		(1024 * 1024)	/* GFS_PROTO_MAX_IOSIZE */
+
+/* around the threshold of the direct i/o of iobuffer, and larger */
+static size_t bench_check_sizes[] = {
+	0, 1, 100, 8191, 8192, 8193, 16383, 16384, 16385, 65536, 100000,
+	BENCH_SIZE_MAX - 1, BENCH_SIZE_MAX,
+};
+#define BENCH_NCHECK_SIZES \
+	(sizeof(bench_check_sizes) / sizeof(bench_check_sizes[0]))
+
+/* the socket operation without writev, i.e. a buffer flush and a write */
+extern struct gfp_iobuffer_ops gfp_xdr_socket_iobuffer_ops;
+static struct gfp_iobuffer_ops bench_nowritev_iobuffer_ops;
+
+static char *program_name = "gfp_xdr_bulk_bench";
+
+static long bench_nmessages = 1000;
+static size_t bench_size = BENCH_SIZE_MAX;
+
+static double
+bench_now(void)
+{
+	struct timeval t;
+
+	gettimeofday(&t, NULL);
+	return (t.tv_sec + t.tv_usec * .000001);
+}
+
+static void
+bench_fatal(const char *diag, gfarm_error_t e)
+{
+	fprintf(stderr, "%s: %s: %s\n", program_name, diag,
+	    gfarm_error_string(e));
+	exit(EXIT_FAILURE);
+}
+
+static void
+bench_fill(char *buf, size_t size, gfarm_int32_t seq)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++)
+		buf[i] = (seq + i * 7) & 0xff;
+}
+
+static int
+bench_verify(const char *buf, size_t size, gfarm_int32_t seq)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		if (buf[i] != (char)((seq + i * 7) & 0xff))
+			return (0);
+	}
+	return (1);
+}
+
+/* returns the number of errors */
+static int
+bench_receiver(int fd)
+{
+	struct gfp_xdr *conn;
+	gfarm_error_t e;
+	gfarm_int32_t seq, trailer;
+	size_t size, sz, i;
+	char *buf, *p;
+	int eof, errors = 0;
+	long n;
+
+	if ((buf = malloc(BENCH_SIZE_MAX)) == NULL)
+		bench_fatal("receive buffer", GFARM_ERR_NO_MEMORY);
+	if ((e = gfp_xdr_new_socket(fd, &conn)) != GFARM_ERR_NO_ERROR)
+		bench_fatal("gfp_xdr_new_socket", e);
+
+	for (i = 0; i < 2 * BENCH_NCHECK_SIZES; i++) {
+		sz = bench_check_sizes[i % BENCH_NCHECK_SIZES];
+		if (i % 2 == 0) {
+			e = gfp_xdr_recv(conn, 0, &eof, "ibi", &seq,
+			    (size_t)BENCH_SIZE_MAX, &size, buf, &trailer);
+			p = buf;
+		} else {
+			e = gfp_xdr_recv(conn, 0, &eof, "iBi",
+			    &seq, &size, &p, &trailer);
+		}
+		if (e != GFARM_ERR_NO_ERROR || eof)
+			bench_fatal("receive", e != GFARM_ERR_NO_ERROR ? e :
+			    GFARM_ERR_UNEXPECTED_EOF);
+		if (seq != i || size != sz || trailer != ~seq ||
+		    !bench_verify(p, size, seq)) {
+			fprintf(stderr, "%s: message %d of %lu bytes "
+			    "is broken\n", program_name, (int)i,
+			    (unsigned long)sz);
+			errors++;
+		}
+		if (i % 2 != 0)
+			free(p);
+	}
+
+	for (n = 0; n < bench_nmessages; n++) {
+		e = gfp_xdr_recv(conn, 0, &eof, "ib",
+		    &seq, (size_t)BENCH_SIZE_MAX, &size, buf);
+		if (e != GFARM_ERR_NO_ERROR || eof)
+			bench_fatal("receive", e != GFARM_ERR_NO_ERROR ? e :
+			    GFARM_ERR_UNEXPECTED_EOF);
+	}
+	if ((e = gfp_xdr_send(conn, "i", (gfarm_int32_t)errors))
+	    != GFARM_ERR_NO_ERROR ||
+	    (e = gfp_xdr_flush(conn)) != GFARM_ERR_NO_ERROR)
+		bench_fatal("send", e);
+
+	gfp_xdr_free(conn);
+	free(buf);
+	return (errors);
+}
+
+static void
+bench_sender(int fd)
+{
+	struct gfp_xdr *conn;
+	gfarm_error_t e;
+	gfarm_int32_t seq, errors;
+	size_t sz, i;
+	char *buf;
+	int eof;
+	long n;
+	double t;
+
+	if ((buf = malloc(BENCH_SIZE_MAX)) == NULL)
+		bench_fatal("send buffer", GFARM_ERR_NO_MEMORY);
+	if ((e = gfp_xdr_new_socket(fd, &conn)) != GFARM_ERR_NO_ERROR)
+		bench_fatal("gfp_xdr_new_socket", e);
+
+	/* the first half is sent with writev, and the rest is without it */
+	for (i = 0; i < 2 * BENCH_NCHECK_SIZES; i++) {
+		if (i == BENCH_NCHECK_SIZES) {
+			if ((e = gfp_xdr_flush(conn)) != GFARM_ERR_NO_ERROR)
+				bench_fatal("flush", e);
+			gfp_xdr_set(conn, &bench_nowritev_iobuffer_ops,
+			    NULL, fd);
+		}
+		seq = i;
+		sz = bench_check_sizes[i % BENCH_NCHECK_SIZES];
+		bench_fill(buf, sz, seq);
+		if ((e = gfp_xdr_send(conn, "ibi", seq, sz, buf, ~seq))
+		    != GFARM_ERR_NO_ERROR)
+			bench_fatal("send", e);
+	}
+	if ((e = gfp_xdr_flush(conn)) != GFARM_ERR_NO_ERROR)
+		bench_fatal("flush", e);
+	gfp_xdr_set(conn, &gfp_xdr_socket_iobuffer_ops, NULL, fd);
+
+	t = bench_now();
+	for (n = 0; n < bench_nmessages; n++) {
+		if ((e = gfp_xdr_send(conn, "ib", (gfarm_int32_t)n,
+		    bench_size, buf)) != GFARM_ERR_NO_ERROR)
+			bench_fatal("send", e);
+	}
+	if ((e = gfp_xdr_flush(conn)) != GFARM_ERR_NO_ERROR)
+		bench_fatal("flush", e);
+	if ((e = gfp_xdr_recv(conn, 0, &eof, "i", &errors))
+	    != GFARM_ERR_NO_ERROR || eof)
+		bench_fatal("receive", e != GFARM_ERR_NO_ERROR ? e :
+		    GFARM_ERR_UNEXPECTED_EOF);
+	t = bench_now() - t;
+
+	printf("messages: %ld, size: %lu\n", bench_nmessages,
+	    (unsigned long)bench_size);
+	printf("%-36s %8.1f usec/message %8.1f MB/s\n", "'b' transfer",
+	    t * 1e6 / bench_nmessages,
+	    (double)bench_size * bench_nmessages / t / 1e6);
+
+	gfp_xdr_free(conn);
+	free(buf);
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "Usage: %s [-n <messages>] [-s <size>]\n",
+	    program_name);
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char **argv)
+{
+	int c, status, sv[2];
+	pid_t pid;
+	gfarm_error_t e;
+
+	if (argc > 0)
+		program_name = argv[0];
+	while ((c = getopt(argc, argv, "n:s:")) != -1) {
+		switch (c) {
+		case 'n':
+			bench_nmessages = atol(optarg);
+			break;
+		case 's':
+			bench_size = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (bench_nmessages < 1 || bench_size > BENCH_SIZE_MAX)
+		usage();
+
+	/* for the timeout of gfarm_iobuffer_blocking_read_timeout_fd_op() */
+	if ((e = gfarm_context_init()) != GFARM_ERR_NO_ERROR)
+		bench_fatal("gfarm_context_init", e);
+
+	bench_nowritev_iobuffer_ops = gfp_xdr_socket_iobuffer_ops;
+	bench_nowritev_iobuffer_ops.blocking_writev = NULL;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == -1) {
+		perror("socketpair");
+		return (EXIT_FAILURE);
+	}
+	if ((pid = fork()) == -1) {
+		perror("fork");
+		return (EXIT_FAILURE);
+	}
+	if (pid == 0) {
+		close(sv[0]);
+		_exit(bench_receiver(sv[1]) == 0 ? EXIT_SUCCESS :
+		    EXIT_FAILURE);
+	}
+	close(sv[1]);
+	bench_sender(sv[0]);
+	if (waitpid(pid, &status, 0) == -1) {
+		perror("waitpid");
+		return (EXIT_FAILURE);
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+		fprintf(stderr, "%s: the receiver failed\n", program_name);
+		return (EXIT_FAILURE);
+	}
+	return (EXIT_SUCCESS);
+}
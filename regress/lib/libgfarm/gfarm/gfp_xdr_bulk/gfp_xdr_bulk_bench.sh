@@ -0,0 +1,11 @@
+#!/bin/sh
+
+. ./regress.conf
+
+if $testbin/gfp_xdr_bulk_bench -n 1000; then
+	exit_code=$exit_pass
+else
+	exit_code=$exit_fail
+fi
+
+exit $exit_code
@@ -0,0 +1,131 @@
+/*
+ * check that the buffers of gfp_xdr are allocated on demand,
+ * released by gfp_xdr_shrink(), and accounted to the connection class.
+ *
+ * $Id$
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <gfarm/gfarm.h>
+
+#include "context.h"
+#include "gfp_xdr.h"
+#include "io_fd.h"
+
+static char *program_name = "gfp_xdr_profile_test";
+
+static int test_errors = 0;
+
+static void
+test_fatal(const char *diag, gfarm_error_t e)
+{
+	fprintf(stderr, "%s: %s: %s\n", program_name, diag,
+	    gfarm_error_string(e));
+	exit(EXIT_FAILURE);
+}
+
+static void
+test_expect(const char *diag, int profile,
+	gfarm_int64_t connections, gfarm_int64_t alloc_size)
+{
+	struct gfp_xdr_profile_stat st;
+
+	gfp_xdr_profile_stat_get(profile, &st);
+	if (st.connections == connections && st.alloc_size == alloc_size &&
+	    st.max_alloc_size >= alloc_size)
+		return;
+	fprintf(stderr, "%s: %s: %s: expected %lld connections and "
+	    "%lld bytes, but %lld connections and %lld bytes\n",
+	    program_name, diag, gfp_xdr_profile_name(profile),
+	    (long long)connections, (long long)alloc_size,
+	    (long long)st.connections, (long long)st.alloc_size);
+	test_errors++;
+}
+
+/* send a request from `client' to `server', and receive it */
+static void
+test_roundtrip(struct gfp_xdr *client, struct gfp_xdr *server)
+{
+	gfarm_error_t e;
+	gfarm_int32_t i;
+	int eof;
+
+	if ((e = gfp_xdr_send(client, "i", (gfarm_int32_t)1))
+	    != GFARM_ERR_NO_ERROR ||
+	    (e = gfp_xdr_flush(client)) != GFARM_ERR_NO_ERROR)
+		test_fatal("send", e);
+	if ((e = gfp_xdr_recv(server, 0, &eof, "i", &i))
+	    != GFARM_ERR_NO_ERROR || eof || i != 1)
+		test_fatal("recv", e != GFARM_ERR_NO_ERROR ? e :
+		    GFARM_ERR_PROTOCOL);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct gfp_xdr *client, *server;
+	gfarm_error_t e;
+	int sv[2];
+	const int meta = GFP_XDR_PROFILE_METADATA;
+	const int bulk = GFP_XDR_PROFILE_BULK;
+
+	if (argc > 0)
+		program_name = argv[0];
+
+	/* for the timeout of gfarm_iobuffer_blocking_read_timeout_fd_op() */
+	if ((e = gfarm_context_init()) != GFARM_ERR_NO_ERROR)
+		test_fatal("gfarm_context_init", e);
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == -1) {
+		perror("socketpair");
+		return (EXIT_FAILURE);
+	}
+	if ((e = gfp_xdr_new_socket(sv[0], &client)) != GFARM_ERR_NO_ERROR ||
+	    (e = gfp_xdr_new_socket(sv[1], &server)) != GFARM_ERR_NO_ERROR)
+		test_fatal("gfp_xdr_new_socket", e);
+
+	/* no buffer is allocated until it's used */
+	test_expect("new", meta, 2, 0);
+	test_expect("new", bulk, 0, 0);
+
+	/* the send buffer of the client and the recv buffer of the server */
+	test_roundtrip(client, server);
+	test_expect("roundtrip", meta, 2, 2 * 16384);
+
+	gfp_xdr_shrink(client);
+	gfp_xdr_shrink(server);
+	test_expect("shrink", meta, 2, 0);
+
+	/* the bulk class has larger buffers, and doesn't shrink */
+	gfp_xdr_set_profile(server, bulk);
+	if (gfp_xdr_get_profile(server) != bulk) {
+		fprintf(stderr, "%s: gfp_xdr_set_profile failed\n",
+		    program_name);
+		test_errors++;
+	}
+	test_expect("set_profile", meta, 1, 0);
+	test_expect("set_profile", bulk, 1, 0);
+	test_roundtrip(client, server);
+	test_roundtrip(server, client);
+	test_expect("bulk roundtrip", meta, 1, 2 * 16384);
+	test_expect("bulk roundtrip", bulk, 1, 2 * 65536);
+	gfp_xdr_shrink(server);
+	test_expect("bulk shrink", bulk, 1, 2 * 65536);
+
+	/* moving a connection moves its buffers as well */
+	gfp_xdr_set_profile(client, bulk);
+	test_expect("move", meta, 0, 0);
+	test_expect("move", bulk, 2, 2 * 65536);
+
+	gfp_xdr_free(client);
+	gfp_xdr_free(server);
+	test_expect("free", meta, 0, 0);
+	test_expect("free", bulk, 0, 0);
+
+	return (test_errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -0,0 +1,453 @@
+/*
+ * check gfp_xdr_send_stat() and gfp_xdr_recv_stat(), and compare their
+ * speed with gfp_xdr_send() and gfp_xdr_recv_sized() with the format
+ * strings of the replies of GFM_PROTO_FSTAT and GFM_PROTO_GETDIRENTSPLUS.
+ *
+ * the connection is a memory pipe instead of a socket, to measure the
+ * encoding and decoding only.
+ *
+ * $Id$
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfp_xdr.h"
+
+#define BENCH_STAT_FORMAT	"llilsslllilili"
+#define BENCH_DIRENT_FORMAT	"sllilsslllilili"
+#define BENCH_DIRENT_RECV_FORMAT "bllilsslllilili"
+
+#define BENCH_NAME_MAX		256
+#define BENCH_BATCH		100	/* a reply of GETDIRENTSPLUS */
+#define BENCH_PIPE_SIZE		(1024 * 1024)
+
+static char *program_name = "gfp_xdr_stat_bench";
+
+static long bench_nmessages = 1000000;
+
+static int bench_errors = 0;
+
+/* a memory pipe, written by the send buffer, and read by the recv buffer */
+struct bench_pipe {
+	char buf[BENCH_PIPE_SIZE];
+	size_t rpos, wpos;
+	int discard;
+	int chunk; /* the maximum length of a read, 0 means unlimited */
+};
+
+static struct bench_pipe bench_pipe;
+
+static double
+bench_now(void)
+{
+	struct timeval t;
+
+	gettimeofday(&t, NULL);
+	return (t.tv_sec + t.tv_usec * .000001);
+}
+
+static void
+bench_error(const char *diag, long i)
+{
+	fprintf(stderr, "%s: %s (message %ld)\n", program_name, diag, i);
+	if (++bench_errors >= 10)
+		exit(EXIT_FAILURE);
+}
+
+static void
+bench_fatal(const char *diag, gfarm_error_t e)
+{
+	fprintf(stderr, "%s: %s: %s\n", program_name, diag,
+	    gfarm_error_string(e));
+	exit(EXIT_FAILURE);
+}
+
+static void
+bench_report(const char *op, long n, double elapsed)
+{
+	printf("%-36s %8.1f nsec/message\n", op, elapsed * 1e9 / n);
+}
+
+static int
+bench_write(struct gfarm_iobuffer *b, void *cookie, int fd,
+	void *data, int length)
+{
+	struct bench_pipe *pipe = cookie;
+
+	if (pipe->discard)
+		return (length);
+	if (length > BENCH_PIPE_SIZE - pipe->wpos) {
+		fprintf(stderr, "%s: memory pipe overflow\n", program_name);
+		exit(EXIT_FAILURE);
+	}
+	memcpy(pipe->buf + pipe->wpos, data, length);
+	pipe->wpos += length;
+	return (length);
+}
+
+static int
+bench_read(struct gfarm_iobuffer *b, void *cookie, int fd,
+	void *data, int length)
+{
+	struct bench_pipe *pipe = cookie;
+
+	if (length > pipe->wpos - pipe->rpos)
+		length = pipe->wpos - pipe->rpos;
+	if (pipe->chunk > 0 && length > pipe->chunk)
+		length = pipe->chunk;
+	memcpy(data, pipe->buf + pipe->rpos, length);
+	pipe->rpos += length;
+	return (length); /* 0 means EOF */
+}
+
+static gfarm_error_t
+bench_close(void *cookie, int fd)
+{
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static struct gfp_iobuffer_ops bench_iobuffer_ops = {
+	bench_close,
+	NULL,
+	NULL,
+	NULL,
+	bench_read,
+	bench_read,
+	bench_write
+};
+
+static void
+bench_pipe_reset(int discard, int chunk)
+{
+	bench_pipe.rpos = bench_pipe.wpos = 0;
+	bench_pipe.discard = discard;
+	bench_pipe.chunk = chunk;
+}
+
+static void
+bench_stat(long i, char *name, char *user, char *group, struct gfs_stat *st)
+{
+	snprintf(name, BENCH_NAME_MAX, "file%07ld.dat", i);
+	snprintf(user, BENCH_NAME_MAX, "user%ld", i % 1000);
+	snprintf(group, BENCH_NAME_MAX, "group%ld", i % 100);
+	st->st_ino = 0x100000001ULL * i;
+	st->st_gen = i % 7;
+	st->st_mode = 0100644 ^ i;
+	st->st_nlink = 1 + i % 3;
+	st->st_user = user;
+	st->st_group = group;
+	st->st_size = i % 2 ? -i : i * 4096;
+	st->st_ncopy = i % 5;
+	st->st_atimespec.tv_sec = 1700000000 + i;
+	st->st_atimespec.tv_nsec = i % 1000000000;
+	st->st_mtimespec.tv_sec = -i;
+	st->st_mtimespec.tv_nsec = -(int)(i % 1000);
+	st->st_ctimespec.tv_sec = i << 20;
+	st->st_ctimespec.tv_nsec = 999999999;
+}
+
+static gfarm_error_t
+bench_send_format(struct gfp_xdr *conn, const char *name,
+	const struct gfs_stat *st)
+{
+	if (name == NULL)
+		return (gfp_xdr_send(conn, BENCH_STAT_FORMAT,
+		    st->st_ino, st->st_gen, st->st_mode, st->st_nlink,
+		    st->st_user, st->st_group, st->st_size,
+		    st->st_ncopy,
+		    st->st_atimespec.tv_sec, st->st_atimespec.tv_nsec,
+		    st->st_mtimespec.tv_sec, st->st_mtimespec.tv_nsec,
+		    st->st_ctimespec.tv_sec, st->st_ctimespec.tv_nsec));
+	return (gfp_xdr_send(conn, BENCH_DIRENT_FORMAT, name,
+	    st->st_ino, st->st_gen, st->st_mode, st->st_nlink,
+	    st->st_user, st->st_group, st->st_size,
+	    st->st_ncopy,
+	    st->st_atimespec.tv_sec, st->st_atimespec.tv_nsec,
+	    st->st_mtimespec.tv_sec, st->st_mtimespec.tv_nsec,
+	    st->st_ctimespec.tv_sec, st->st_ctimespec.tv_nsec));
+}
+
+static gfarm_error_t
+bench_recv_format(struct gfp_xdr *conn, size_t *sizep,
+	size_t name_size, size_t *name_lenp, char *name, struct gfs_stat *st)
+{
+	gfarm_error_t e;
+	int eof;
+
+	if (name == NULL)
+		e = gfp_xdr_recv_sized(conn, 0, 1, sizep, &eof,
+		    BENCH_STAT_FORMAT,
+		    &st->st_ino, &st->st_gen, &st->st_mode, &st->st_nlink,
+		    &st->st_user, &st->st_group, &st->st_size,
+		    &st->st_ncopy,
+		    &st->st_atimespec.tv_sec, &st->st_atimespec.tv_nsec,
+		    &st->st_mtimespec.tv_sec, &st->st_mtimespec.tv_nsec,
+		    &st->st_ctimespec.tv_sec, &st->st_ctimespec.tv_nsec);
+	else
+		e = gfp_xdr_recv_sized(conn, 0, 1, sizep, &eof,
+		    BENCH_DIRENT_RECV_FORMAT, name_size, name_lenp, name,
+		    &st->st_ino, &st->st_gen, &st->st_mode, &st->st_nlink,
+		    &st->st_user, &st->st_group, &st->st_size,
+		    &st->st_ncopy,
+		    &st->st_atimespec.tv_sec, &st->st_atimespec.tv_nsec,
+		    &st->st_mtimespec.tv_sec, &st->st_mtimespec.tv_nsec,
+		    &st->st_ctimespec.tv_sec, &st->st_ctimespec.tv_nsec);
+	if (e == GFARM_ERR_NO_ERROR && eof)
+		e = GFARM_ERR_UNEXPECTED_EOF;
+	return (e);
+}
+
+static gfarm_error_t
+bench_recv_stat(struct gfp_xdr *conn, size_t *sizep,
+	size_t name_size, size_t *name_lenp, char *name, struct gfs_stat *st)
+{
+	return (gfp_xdr_recv_stat(conn, 0, 1, sizep,
+	    name_size, name_lenp, name, st));
+}
+
+static int
+bench_stat_equal(const struct gfs_stat *a, const struct gfs_stat *b)
+{
+	return (a->st_ino == b->st_ino && a->st_gen == b->st_gen &&
+	    a->st_mode == b->st_mode && a->st_nlink == b->st_nlink &&
+	    strcmp(a->st_user, b->st_user) == 0 &&
+	    strcmp(a->st_group, b->st_group) == 0 &&
+	    a->st_size == b->st_size && a->st_ncopy == b->st_ncopy &&
+	    a->st_atimespec.tv_sec == b->st_atimespec.tv_sec &&
+	    a->st_atimespec.tv_nsec == b->st_atimespec.tv_nsec &&
+	    a->st_mtimespec.tv_sec == b->st_mtimespec.tv_sec &&
+	    a->st_mtimespec.tv_nsec == b->st_mtimespec.tv_nsec &&
+	    a->st_ctimespec.tv_sec == b->st_ctimespec.tv_sec &&
+	    a->st_ctimespec.tv_nsec == b->st_ctimespec.tv_nsec);
+}
+
+/*
+ * encode n messages into the memory pipe.
+ * the messages fill the send buffer several times when n is large,
+ * thus both the in-place path and its fallback are used.
+ */
+static void
+bench_encode(struct gfp_xdr *conn, long n, int with_name, int specialized)
+{
+	char name[BENCH_NAME_MAX], user[BENCH_NAME_MAX], group[BENCH_NAME_MAX];
+	struct gfs_stat st;
+	gfarm_error_t e;
+	long i;
+
+	for (i = 0; i < n; i++) {
+		bench_stat(i, name, user, group, &st);
+		if (specialized)
+			e = gfp_xdr_send_stat(conn, with_name ? name : NULL,
+			    &st);
+		else
+			e = bench_send_format(conn, with_name ? name : NULL,
+			    &st);
+		if (e != GFARM_ERR_NO_ERROR)
+			bench_fatal("send", e);
+	}
+	if ((e = gfp_xdr_flush(conn)) != GFARM_ERR_NO_ERROR)
+		bench_fatal("gfp_xdr_flush", e);
+}
+
+/* decode n messages from the memory pipe, and check them */
+static void
+bench_decode_check(struct gfp_xdr *conn, long n, int with_name,
+	size_t name_size,
+	gfarm_error_t (*recv)(struct gfp_xdr *, size_t *,
+	    size_t, size_t *, char *, struct gfs_stat *))
+{
+	char name[BENCH_NAME_MAX], user[BENCH_NAME_MAX], group[BENCH_NAME_MAX];
+	char rname[BENCH_NAME_MAX];
+	struct gfs_stat st, rst;
+	size_t size = bench_pipe.wpos - bench_pipe.rpos, name_len;
+	gfarm_error_t e;
+	long i;
+
+	for (i = 0; i < n; i++) {
+		bench_stat(i, name, user, group, &st);
+		memset(rname, 0, sizeof(rname));
+		if ((e = (*recv)(conn, &size, name_size, &name_len,
+		    with_name ? rname : NULL, &rst)) != GFARM_ERR_NO_ERROR)
+			bench_fatal("recv", e);
+		if (!bench_stat_equal(&st, &rst))
+			bench_error("wrong stat", i);
+		if (with_name && (name_len != strlen(name) ||
+		    strncmp(name, rname, name_size) != 0 ||
+		    rname[name_size] != '\0'))
+			bench_error("wrong name", i);
+		gfs_stat_free(&rst);
+	}
+	if (size != 0)
+		bench_error("message size mismatch", (long)size);
+}
+
+static void
+bench_check(struct gfp_xdr *conn)
+{
+	static char format_stream[BENCH_PIPE_SIZE];
+	size_t format_size;
+	long n = 3000; /* about 400KB */
+	int chunks[] = { 0, 7, 1000 }; /* see bench_read() */
+	int i, with_name;
+
+	for (with_name = 0; with_name <= 1; with_name++) {
+		/* gfp_xdr_send_stat() is wire compatible with the format */
+		bench_pipe_reset(0, 0);
+		bench_encode(conn, n, with_name, 0);
+		format_size = bench_pipe.wpos;
+		memcpy(format_stream, bench_pipe.buf, format_size);
+		bench_pipe_reset(0, 0);
+		bench_encode(conn, n, with_name, 1);
+		if (bench_pipe.wpos != format_size ||
+		    memcmp(bench_pipe.buf, format_stream, format_size) != 0)
+			bench_error("encoding differs from the format", 0);
+
+		/*
+		 * decode it in place, and with the fallback when a message
+		 * is received only partially.
+		 */
+		for (i = 0; i < GFARM_ARRAY_LENGTH(chunks); i++) {
+			bench_pipe.rpos = 0;
+			bench_pipe.chunk = chunks[i];
+			bench_decode_check(conn, n, with_name,
+			    BENCH_NAME_MAX - 1, bench_recv_stat);
+			bench_pipe.rpos = 0;
+			bench_decode_check(conn, n, with_name,
+			    BENCH_NAME_MAX - 1, bench_recv_format);
+		}
+		if (!with_name)
+			continue;
+		/* a name longer than the buffer is truncated */
+		bench_pipe.chunk = 0;
+		bench_pipe.rpos = 0;
+		bench_decode_check(conn, n, with_name, 5, bench_recv_stat);
+		bench_pipe.rpos = 0;
+		bench_decode_check(conn, n, with_name, 5, bench_recv_format);
+	}
+}
+
+static void
+bench_encode_time(struct gfp_xdr *conn, const char *op, int with_name,
+	int specialized)
+{
+	static char names[BENCH_BATCH][BENCH_NAME_MAX];
+	static char users[BENCH_BATCH][BENCH_NAME_MAX];
+	static char groups[BENCH_BATCH][BENCH_NAME_MAX];
+	static struct gfs_stat sts[BENCH_BATCH];
+	const char *name = NULL;
+	gfarm_error_t e;
+	double t0;
+	long i;
+
+	for (i = 0; i < BENCH_BATCH; i++)
+		bench_stat(i, names[i], users[i], groups[i], &sts[i]);
+
+	bench_pipe_reset(1, 0);
+	t0 = bench_now();
+	for (i = 0; i < bench_nmessages; i++) {
+		if (with_name)
+			name = names[i % BENCH_BATCH];
+		if (specialized)
+			e = gfp_xdr_send_stat(conn, name,
+			    &sts[i % BENCH_BATCH]);
+		else
+			e = bench_send_format(conn, name,
+			    &sts[i % BENCH_BATCH]);
+		if (e != GFARM_ERR_NO_ERROR)
+			bench_fatal("send", e);
+	}
+	if ((e = gfp_xdr_flush(conn)) != GFARM_ERR_NO_ERROR)
+		bench_fatal("gfp_xdr_flush", e);
+	bench_report(op, bench_nmessages, bench_now() - t0);
+}
+
+static void
+bench_decode_time(struct gfp_xdr *conn, const char *op, int with_name,
+	gfarm_error_t (*recv)(struct gfp_xdr *, size_t *,
+	    size_t, size_t *, char *, struct gfs_stat *))
+{
+	char name[BENCH_NAME_MAX];
+	struct gfs_stat st;
+	size_t size, name_len;
+	gfarm_error_t e;
+	double elapsed = 0, t0;
+	long i, j;
+
+	/* a batch of the messages, as a reply of GETDIRENTSPLUS */
+	bench_pipe_reset(0, 0);
+	bench_encode(conn, BENCH_BATCH, with_name, 0);
+
+	for (i = 0; i < bench_nmessages; i += BENCH_BATCH) {
+		bench_pipe.rpos = 0;
+		size = bench_pipe.wpos;
+		t0 = bench_now();
+		for (j = 0; j < BENCH_BATCH; j++) {
+			if ((e = (*recv)(conn, &size, sizeof(name) - 1,
+			    &name_len, with_name ? name : NULL, &st)) !=
+			    GFARM_ERR_NO_ERROR)
+				bench_fatal("recv", e);
+			gfs_stat_free(&st);
+		}
+		elapsed += bench_now() - t0;
+	}
+	bench_report(op, i, elapsed);
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "Usage: %s [-n messages]\n", program_name);
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct gfp_xdr *conn;
+	gfarm_error_t e;
+	int c;
+
+	if (argc > 0)
+		program_name = argv[0];
+	while ((c = getopt(argc, argv, "n:")) != -1) {
+		switch (c) {
+		case 'n':
+			bench_nmessages = atol(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (bench_nmessages < 1)
+		usage();
+
+	if ((e = gfp_xdr_new(&bench_iobuffer_ops, &bench_pipe, -1,
+	    GFP_XDR_NEW_RECV|GFP_XDR_NEW_SEND, &conn)) != GFARM_ERR_NO_ERROR)
+		bench_fatal("gfp_xdr_new", e);
+
+	bench_check(conn);
+
+	printf("messages: %ld\n", bench_nmessages);
+	bench_encode_time(conn, "FSTAT encode (format)", 0, 0);
+	bench_encode_time(conn, "FSTAT encode (specialized)", 0, 1);
+	bench_decode_time(conn, "FSTAT decode (format)", 0,
+	    bench_recv_format);
+	bench_decode_time(conn, "FSTAT decode (specialized)", 0,
+	    bench_recv_stat);
+	bench_encode_time(conn, "GETDIRENTSPLUS encode (format)", 1, 0);
+	bench_encode_time(conn, "GETDIRENTSPLUS encode (specialized)", 1, 1);
+	bench_decode_time(conn, "GETDIRENTSPLUS decode (format)", 1,
+	    bench_recv_format);
+	bench_decode_time(conn, "GETDIRENTSPLUS decode (specialized)", 1,
+	    bench_recv_stat);
+
+	gfp_xdr_free(conn);
+	return (bench_errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
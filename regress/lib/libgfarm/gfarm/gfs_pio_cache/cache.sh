@@ -0,0 +1,76 @@
+#!/bin/sh
+
+. ./regress.conf
+
+cache_stat=$testbin/gfs_pio_cache_stat
+cachedir=$localtmp.cache
+userdir=$cachedir/`id -u`
+localsrc=$localtmp.src
+localsrc2=$localtmp.src2
+rc=$localtmp.rc
+nreaders=4
+
+clean() {
+	gfrm -f $gftmp
+	rm -rf $localtmp $localtmp.[0-9] $localsrc $localsrc2 $rc $cachedir
+}
+
+trap 'clean; exit $exit_trap' $trap_sigs
+
+stat_is() {
+	[ "`$cache_stat $userdir $1`" = "$2" ]
+}
+
+# the user configuration, with the read cache enabled
+if [ -n "$GFARM_CONFIG_FILE" ]; then
+	cat "$GFARM_CONFIG_FILE"
+elif [ -f "$HOME/.gfarm2rc" ]; then
+	cat "$HOME/.gfarm2rc"
+fi >$rc
+echo "client_read_cache_directory $cachedir" >>$rc
+
+# 3000000 bytes are 3 blocks, the last one is partial
+if ! dd if=/dev/urandom of=$localsrc bs=1000 count=3000 2>/dev/null ||
+   ! dd if=/dev/urandom of=$localsrc2 bs=1000 count=3000 2>/dev/null ||
+   ! gfreg $localsrc $gftmp ||
+   ! GFARM_CONFIG_FILE=$rc gfexport $gftmp >$localtmp ||
+   ! cmp -s $localsrc $localtmp; then
+	clean
+	exit $exit_fail
+fi
+
+# the cache is only used for a remote gfsd
+if [ ! -f $userdir/iostat ] || stat_is miss_count 0; then
+	clean
+	exit $exit_unsupported
+fi
+
+hit_bytes=`$cache_stat $userdir hit_bytes`
+expected_hit_bytes=`expr $hit_bytes + $nreaders \* 3000000`
+
+# the first read fetches every block once, then parallel readers hit
+i=0
+while [ $i -lt $nreaders ]; do
+	GFARM_CONFIG_FILE=$rc gfexport $gftmp >$localtmp.$i &
+	i=`expr $i + 1`
+done
+wait
+
+if stat_is miss_count 3 && stat_is miss_bytes 3000000 &&
+   stat_is size 3000000 &&
+   stat_is hit_bytes $expected_hit_bytes &&
+   cmp -s $localsrc $localtmp.0 && cmp -s $localsrc $localtmp.1 &&
+   cmp -s $localsrc $localtmp.2 && cmp -s $localsrc $localtmp.3 &&
+
+   # a modified file never hits the old blocks
+   gfreg -f $localsrc2 $gftmp &&
+   GFARM_CONFIG_FILE=$rc gfexport $gftmp >$localtmp &&
+   cmp -s $localsrc2 $localtmp &&
+   stat_is miss_count 6 && stat_is miss_bytes 6000000 &&
+   stat_is size 6000000
+then
+	exit_code=$exit_pass
+fi
+
+clean
+exit $exit_code
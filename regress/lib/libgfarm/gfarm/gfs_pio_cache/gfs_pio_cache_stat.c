@@ -0,0 +1,95 @@
+/*
+ * print the statistics of the client read cache,
+ * i.e. <client_read_cache_directory>/<uid>/iostat
+ *
+ * $Id$
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <gfarm/gfarm.h>
+#include <gfarm/gfarm_iostat.h>
+
+static char *program_name = "gfs_pio_cache_stat";
+
+static void
+usage(void)
+{
+	fprintf(stderr, "Usage: %s <per-user cache directory> [<name>...]\n",
+	    program_name);
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct gfarm_iostat_head *hp;
+	struct gfarm_iostat_spec *specp;
+	struct gfarm_iostat_items *ip;
+	struct stat st;
+	char *path;
+	void *addr;
+	int fd, i, j, found;
+
+	if (argc > 0)
+		program_name = argv[0];
+	if (argc < 2)
+		usage();
+
+	GFARM_MALLOC_ARRAY(path, strlen(argv[1]) + sizeof("/iostat"));
+	if (path == NULL) {
+		fprintf(stderr, "%s: no memory\n", program_name);
+		return (EXIT_FAILURE);
+	}
+	sprintf(path, "%s/iostat", argv[1]);
+	if ((fd = open(path, O_RDONLY)) == -1 || fstat(fd, &st) == -1) {
+		perror(path);
+		return (EXIT_FAILURE);
+	}
+	if (st.st_size < sizeof(*hp) ||
+	    (addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0))
+	    == MAP_FAILED) {
+		fprintf(stderr, "%s: %s: cannot map\n", program_name, path);
+		return (EXIT_FAILURE);
+	}
+	close(fd);
+	hp = addr;
+	if (hp->s_magic != GFARM_IOSTAT_MAGIC ||
+	    hp->s_item_off + hp->s_item_size > st.st_size) {
+		fprintf(stderr, "%s: %s: not an iostat file\n",
+		    program_name, path);
+		return (EXIT_FAILURE);
+	}
+	specp = (struct gfarm_iostat_spec *)(hp + 1);
+	ip = (struct gfarm_iostat_items *)((char *)addr + hp->s_item_off);
+
+	if (argc == 2) {
+		for (j = 0; j < hp->s_nitem; j++)
+			printf("%s %lld\n", specp[j].s_name,
+			    (long long)ip->s_vals[j]);
+		return (EXIT_SUCCESS);
+	}
+	for (i = 2; i < argc; i++) {
+		found = 0;
+		for (j = 0; j < hp->s_nitem; j++) {
+			if (strcmp(specp[j].s_name, argv[i]) == 0) {
+				printf("%lld\n", (long long)ip->s_vals[j]);
+				found = 1;
+				break;
+			}
+		}
+		if (!found) {
+			fprintf(stderr, "%s: %s: unknown item\n",
+			    program_name, argv[i]);
+			return (EXIT_FAILURE);
+		}
+	}
+	return (EXIT_SUCCESS);
+}
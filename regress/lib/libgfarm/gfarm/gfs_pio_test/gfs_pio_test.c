@@ -22,11 +22,19 @@ char *program_name = "gfs_pio";
 #define OP_DATASYNC	'D'
 #define OP_READALL	'I'
 #define OP_WRITEALL	'O'
+#define OP_PREADV	'V'
+#define OP_PWRITEV	'U'
+#define OP_AIO_READ	'A'
+
+#define NSEGMENTS	16 /* for OP_PREADV, OP_PWRITEV and OP_AIO_READ */
 
 struct op {
 	unsigned char op;
 
-	/* for O_READ, OP_WRITE, OP_SEEK_*, OP_TRUNCATE, OP_PAUSE */
+	/*
+	 * for O_READ, OP_WRITE, OP_SEEK_*, OP_TRUNCATE, OP_PAUSE,
+	 * and segment size of OP_PREADV, OP_PWRITEV, OP_AIO_READ
+	 */
 	gfarm_off_t off;
 };
 
@@ -35,6 +43,153 @@ struct op {
 struct op ops[MAX_OPS];
 int nops = 0;
 
+/* read the whole file with gfs_pio_preadv(), and write it to stdout */
+int
+preadv_all(GFS_File gf, int segsize)
+{
+	gfarm_error_t e;
+	struct gfs_pio_iovec iov[NSEGMENTS];
+	char *buf;
+	gfarm_off_t off = 0;
+	int i, rv;
+
+	if ((buf = malloc(segsize * NSEGMENTS)) == NULL) {
+		fprintf(stderr, "no memory\n");
+		return (1);
+	}
+	do {
+		for (i = 0; i < NSEGMENTS; i++) {
+			iov[i].iov_base = buf + segsize * i;
+			iov[i].iov_len = segsize;
+			iov[i].iov_offset = off + segsize * i;
+		}
+		e = gfs_pio_preadv(gf, iov, NSEGMENTS, &rv);
+		if (e != GFARM_ERR_NO_ERROR) {
+			fprintf(stderr, "gfs_pio_preadv: %s\n",
+			    gfarm_error_string(e));
+			free(buf);
+			return (1);
+		}
+		if (write(1, buf, rv) != rv) {
+			perror("write");
+			free(buf);
+			return (1);
+		}
+		off += rv;
+	} while (rv == segsize * NSEGMENTS);
+	free(buf);
+	return (0);
+}
+
+/* write stdin to the file with gfs_pio_pwritev() */
+int
+pwritev_all(GFS_File gf, int segsize)
+{
+	gfarm_error_t e;
+	struct gfs_pio_iovec iov[NSEGMENTS];
+	char *buf;
+	gfarm_off_t off = 0;
+	int i, n, rv, eof = 0;
+
+	if ((buf = malloc(segsize * NSEGMENTS)) == NULL) {
+		fprintf(stderr, "no memory\n");
+		return (1);
+	}
+	while (!eof) {
+		for (i = 0; i < NSEGMENTS && !eof; i++) {
+			for (n = 0; n < segsize; n += rv) {
+				rv = read(0, buf + segsize * i + n,
+				    segsize - n);
+				if (rv == -1) {
+					perror("read");
+					free(buf);
+					return (1);
+				}
+				if (rv == 0) {
+					eof = 1;
+					break;
+				}
+			}
+			iov[i].iov_base = buf + segsize * i;
+			iov[i].iov_len = n;
+			iov[i].iov_offset = off + segsize * i;
+		}
+		n = (i - 1) * segsize + iov[i - 1].iov_len;
+		e = gfs_pio_pwritev(gf, iov, i, &rv);
+		if (e != GFARM_ERR_NO_ERROR) {
+			fprintf(stderr, "gfs_pio_pwritev: %s\n",
+			    gfarm_error_string(e));
+			free(buf);
+			return (1);
+		}
+		if (rv != n) {
+			fprintf(stderr, "gfs_pio_pwritev: %d of %d bytes\n",
+			    rv, n);
+			free(buf);
+			return (1);
+		}
+		off += rv;
+	}
+	free(buf);
+	return (0);
+}
+
+/* read the whole file with gfs_pio_aio_read(), and write it to stdout */
+int
+aio_read_all(GFS_File gf, int segsize)
+{
+	gfarm_error_t e;
+	struct gfs_pio_aiocb cb[NSEGMENTS];
+	char *buf;
+	gfarm_off_t off = 0;
+	int i, n, rv, eof = 0;
+
+	if ((buf = malloc(segsize * NSEGMENTS)) == NULL) {
+		fprintf(stderr, "no memory\n");
+		return (1);
+	}
+	while (!eof) {
+		for (i = 0; i < NSEGMENTS; i++) {
+			cb[i].aio_buf = buf + segsize * i;
+			cb[i].aio_nbytes = segsize;
+			cb[i].aio_offset = off + segsize * i;
+			e = gfs_pio_aio_read(gf, &cb[i]);
+			if (e != GFARM_ERR_NO_ERROR) {
+				fprintf(stderr, "gfs_pio_aio_read: %s\n",
+				    gfarm_error_string(e));
+				free(buf);
+				return (1);
+			}
+		}
+		/* poll the last one, then collect all */
+		while (gfs_pio_aio_error(&cb[NSEGMENTS - 1]) ==
+		    GFARM_ERR_OPERATION_NOW_IN_PROGRESS)
+			;
+		for (i = 0, n = 0; i < NSEGMENTS; i++) {
+			e = gfs_pio_aio_return(&cb[i], &rv);
+			if (e != GFARM_ERR_NO_ERROR) {
+				fprintf(stderr, "gfs_pio_aio_return: %s\n",
+				    gfarm_error_string(e));
+				free(buf);
+				return (1);
+			}
+			if (eof)
+				continue;
+			n += rv;
+			if (rv < segsize)
+				eof = 1;
+		}
+		if (write(1, buf, n) != n) {
+			perror("write");
+			free(buf);
+			return (1);
+		}
+		off += n;
+	}
+	free(buf);
+	return (0);
+}
+
 void
 usage(void)
 {
@@ -72,7 +227,8 @@ main(int argc, char **argv)
 		return (1);
 	}
 
-	while ((c = getopt(argc, argv, "acC:DeE:FIm:MnOP:rR:S:tT:vwW:"))
+	while ((c = getopt(argc, argv,
+	    "aA:cC:DeE:FIm:MnOP:rR:S:tT:U:vV:wW:"))
 	    != -1) {
 		off = -1;
 		switch (c) {
@@ -83,6 +239,9 @@ main(int argc, char **argv)
 		case OP_SEEK_END:
 		case OP_TRUNCATE:
 		case OP_PAUSE:
+		case OP_PREADV:
+		case OP_PWRITEV:
+		case OP_AIO_READ:
 			off = strtol(optarg, NULL, 0);
 			/*FALLTHROUGH*/
 		case OP_FLUSH:
@@ -325,6 +484,20 @@ main(int argc, char **argv)
 				fprintf(stderr, "read(%lld)\n",
 				    (long long)roff);
 			break;
+		case OP_PREADV:
+		case OP_PWRITEV:
+		case OP_AIO_READ:
+			if (off <= 0 || off > sizeof buffer) {
+				fprintf(stderr, "%s: invalid segment size\n",
+				    program_name);
+				return (c);
+			}
+			rv = (c == OP_PREADV ? preadv_all(gf, (int)off) :
+			    c == OP_PWRITEV ? pwritev_all(gf, (int)off) :
+			    aio_read_all(gf, (int)off));
+			if (rv != 0)
+				return (c);
+			break;
 		default:
 			assert(0);
 		}
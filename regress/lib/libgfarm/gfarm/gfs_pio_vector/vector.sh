@@ -0,0 +1,27 @@
+#!/bin/sh
+
+. ./regress.conf
+
+gfs_pio_test=`dirname $testbin`/gfs_pio_test/gfs_pio_test
+localsrc=$localtmp.src
+
+trap 'gfrm -f $gftmp; rm -f $localtmp $localsrc; exit $exit_trap' $trap_sigs
+
+# 300000 bytes isn't a multiple of the segment size
+if dd if=/dev/urandom of=$localsrc bs=1000 count=300 2>/dev/null &&
+   gfreg $localsrc $gftmp &&
+   $gfs_pio_test -r -V 4096 $gftmp >$localtmp &&
+   cmp -s $localsrc $localtmp &&
+   $gfs_pio_test -r -A 4096 $gftmp >$localtmp &&
+   cmp -s $localsrc $localtmp &&
+   gfrm $gftmp &&
+   $gfs_pio_test -c -w -U 4096 $gftmp <$localsrc &&
+   gfexport $gftmp >$localtmp &&
+   cmp -s $localsrc $localtmp
+then
+    exit_code=$exit_pass
+fi
+
+gfrm -f $gftmp
+rm -f $localtmp $localsrc
+exit $exit_code
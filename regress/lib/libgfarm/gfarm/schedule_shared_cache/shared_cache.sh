@@ -0,0 +1,93 @@
+#!/bin/sh
+
+# the scheduling cache shared by processes of a user, and a file planted
+# in the shared directory by another user must not be followed.
+
+. ./regress.conf
+
+cachedir=$localtmp.cache
+userdir=$cachedir/gfarm-`id -u`
+victim=$localtmp.victim
+rc=$localtmp.rc
+
+clean() {
+	rm -rf $localtmp $localtmp.[0-9] $cachedir $victim $rc
+}
+
+trap 'clean; exit $exit_trap' $trap_sigs
+
+mode_is() {
+	[ "`ls -ld $1 | cut -c1-10`" = "$2" ]
+}
+
+# the user configuration, with the shared cache enabled
+if [ -n "$GFARM_CONFIG_FILE" ]; then
+	cat "$GFARM_CONFIG_FILE"
+elif [ -f "$HOME/.gfarm2rc" ]; then
+	cat "$HOME/.gfarm2rc"
+fi >$rc
+echo "schedule_shared_cache_directory $cachedir" >>$rc
+
+hosts=`gfsched -w`
+if [ -z "$hosts" ]; then
+	clean
+	exit $exit_unsupported
+fi
+
+exit_code=$exit_fail
+
+# two processes share the cache, and both see all hosts
+GFARM_CONFIG_FILE=$rc gfsched -w >$localtmp.0 &
+GFARM_CONFIG_FILE=$rc gfsched -w >$localtmp.1 &
+wait
+if [ -s $localtmp.0 ] && [ -s $localtmp.1 ] &&
+   mode_is $cachedir drwxrwxrwt && mode_is $userdir drwx------ &&
+   [ -f $userdir/schedule ] && mode_is $userdir/schedule -rw------- &&
+   size=`wc -c <$userdir/schedule` && [ $size -gt 0 ]
+then
+	exit_code=$exit_pass
+	for h in $hosts; do
+		if grep -a -q "$h" $userdir/schedule; then
+			:
+		else
+			echo >&2 "$h: not in the shared cache"
+			exit_code=$exit_fail
+		fi
+	done
+	# the second run uses the cache, which is neither grown nor reset
+	if GFARM_CONFIG_FILE=$rc gfsched -w >$localtmp.2 &&
+	   [ `wc -c <$userdir/schedule` -eq $size ] &&
+	   [ "`sort $localtmp.2`" = "`sort $localtmp.0`" ]; then
+		:
+	else
+		echo >&2 "the shared cache is broken by the second run"
+		exit_code=$exit_fail
+	fi
+fi
+
+# a planted symlink to the cache file is not followed
+rm -rf $userdir
+mkdir -m 700 $userdir
+ln -s $victim $userdir/schedule
+if GFARM_CONFIG_FILE=$rc gfsched -w >$localtmp.2 && [ -s $localtmp.2 ] &&
+   [ ! -f $victim ]; then
+	:
+else
+	echo >&2 "symlink to the cache file is followed"
+	exit_code=$exit_fail
+fi
+
+# a planted symlink to the user directory is not followed
+rm -rf $userdir
+mkdir $victim
+ln -s $victim $userdir
+if GFARM_CONFIG_FILE=$rc gfsched -w >$localtmp.2 && [ -s $localtmp.2 ] &&
+   [ ! -f $victim/schedule ]; then
+	:
+else
+	echo >&2 "symlink to the user directory is followed"
+	exit_code=$exit_fail
+fi
+
+clean
+exit $exit_code
@@ -0,0 +1,302 @@
+/*
+ * measure the cost of a callback of gfarm_eventqueue, with many idle
+ * connections and some active ones, like the watcher of gfmd.
+ *
+ * each connection is a socketpair(2).  an idle connection is watched for
+ * reading with a long timeout, and never becomes readable.
+ * an active connection always has one byte to read, and its callback
+ * reads it, writes it back and adds the event again.
+ *
+ * $Id$
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include "gfevent.h"
+
+#define BENCH_IDLE_TIMEOUT	3600	/* seconds, never expires */
+#define BENCH_ACTIVE_TIMEOUT	60	/* seconds, never expires */
+#define BENCH_FD_SLACK		64
+
+static char *program_name = "eventqueue_bench";
+
+static int bench_nidle = 50000;
+static int bench_nactive = 1000;
+static long bench_ncallbacks = 1000000;
+
+struct bench_conn {
+	int fds[2];
+	struct gfarm_event *ev;
+};
+
+static struct gfarm_eventqueue *bench_q;
+static struct bench_conn *bench_idle, *bench_active;
+
+static long bench_nfired = 0, bench_ntimedout = 0;
+
+/* for the timeout check */
+static int bench_timeout_order[2], bench_ntimeouts_fired = 0;
+
+static double
+bench_timeval_sub(const struct timeval *t1, const struct timeval *t0)
+{
+	return ((t1->tv_sec - t0->tv_sec) +
+	    (t1->tv_usec - t0->tv_usec) * .000001);
+}
+
+static void
+bench_error(const char *diag, int err)
+{
+	fprintf(stderr, "%s: %s: %s\n", program_name, diag, strerror(err));
+	exit(EXIT_FAILURE);
+}
+
+static void
+bench_add_event(struct gfarm_event *ev, int timeout_sec)
+{
+	struct timeval timeout;
+	int err;
+
+	timeout.tv_sec = timeout_sec;
+	timeout.tv_usec = 0;
+	if ((err = gfarm_eventqueue_add_event(bench_q, ev, &timeout)) != 0)
+		bench_error("gfarm_eventqueue_add_event", err);
+}
+
+static void
+bench_idle_callback(int events, int fd, void *closure,
+	const struct timeval *t)
+{
+	bench_ntimedout++;
+}
+
+static void
+bench_active_callback(int events, int fd, void *closure,
+	const struct timeval *t)
+{
+	struct bench_conn *conn = closure;
+	char c;
+
+	if (events != GFARM_EVENT_READ) {
+		bench_ntimedout++;
+		return;
+	}
+	if (read(fd, &c, 1) != 1 || write(conn->fds[1], &c, 1) != 1)
+		bench_error("read/write", errno);
+	if (++bench_nfired < bench_ncallbacks)
+		bench_add_event(conn->ev, BENCH_ACTIVE_TIMEOUT);
+}
+
+static void
+bench_conn_init(struct bench_conn *conn,
+	void (*callback)(int, int, void *, const struct timeval *))
+{
+	if (socketpair(PF_UNIX, SOCK_STREAM, 0, conn->fds) == -1)
+		bench_error("socketpair", errno);
+	conn->ev = gfarm_fd_event_alloc(
+	    GFARM_EVENT_READ|GFARM_EVENT_TIMEOUT, conn->fds[0],
+	    callback, conn);
+	if (conn->ev == NULL)
+		bench_error("gfarm_fd_event_alloc", ENOMEM);
+}
+
+/* two descriptors per connection */
+static void
+bench_fd_limit(void)
+{
+	struct rlimit rl;
+	rlim_t needed = (rlim_t)(bench_nidle + bench_nactive) * 2 +
+	    BENCH_FD_SLACK;
+
+	if (getrlimit(RLIMIT_NOFILE, &rl) == -1)
+		bench_error("getrlimit", errno);
+	if (rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur < needed) {
+		rl.rlim_cur = needed;
+		if (rl.rlim_max != RLIM_INFINITY && rl.rlim_max < needed)
+			rl.rlim_max = needed; /* may fail, if not privileged */
+		if (setrlimit(RLIMIT_NOFILE, &rl) == -1) {
+			getrlimit(RLIMIT_NOFILE, &rl);
+			rl.rlim_cur = rl.rlim_max;
+			setrlimit(RLIMIT_NOFILE, &rl);
+		}
+	}
+	if (rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur < needed) {
+		if (rl.rlim_cur < bench_nactive * 2 + BENCH_FD_SLACK) {
+			fprintf(stderr, "%s: too few descriptors (%lld)\n",
+			    program_name, (long long)rl.rlim_cur);
+			exit(EXIT_FAILURE);
+		}
+		bench_nidle = (rl.rlim_cur - BENCH_FD_SLACK) / 2 -
+		    bench_nactive;
+		fprintf(stderr, "%s: descriptors are limited to %lld, "
+		    "idle connections are reduced to %d\n", program_name,
+		    (long long)rl.rlim_cur, bench_nidle);
+	}
+}
+
+static void
+bench_timeout_fd_callback(int events, int fd, void *closure,
+	const struct timeval *t)
+{
+	if (events == GFARM_EVENT_TIMEOUT && bench_ntimeouts_fired < 2)
+		bench_timeout_order[bench_ntimeouts_fired++] = 1;
+}
+
+static void
+bench_timeout_timer_callback(void *closure, const struct timeval *t)
+{
+	if (bench_ntimeouts_fired < 2)
+		bench_timeout_order[bench_ntimeouts_fired++] = 0;
+}
+
+/*
+ * the idle events are deleted, and then a fd event and a timer event
+ * must expire in the order of their timeouts.
+ */
+static int
+bench_check_timeout(void)
+{
+	struct gfarm_event *timer;
+	struct timeval fd_timeout, timer_timeout;
+	int i, err;
+
+	for (i = 0; i < bench_nidle; i++) {
+		if ((err = gfarm_eventqueue_delete_event(bench_q,
+		    bench_idle[i].ev)) != 0)
+			bench_error("gfarm_eventqueue_delete_event", err);
+	}
+
+	timer = gfarm_timer_event_alloc(bench_timeout_timer_callback, NULL);
+	if (timer == NULL)
+		bench_error("gfarm_timer_event_alloc", ENOMEM);
+	gfarm_fd_event_set_callback(bench_idle[0].ev,
+	    bench_timeout_fd_callback, NULL);
+	fd_timeout.tv_sec = 0;
+	fd_timeout.tv_usec = 20000;
+	timer_timeout.tv_sec = 0;
+	timer_timeout.tv_usec = 10000;
+	if ((err = gfarm_eventqueue_add_event(bench_q, bench_idle[0].ev,
+	    &fd_timeout)) != 0 ||
+	    (err = gfarm_eventqueue_add_event(bench_q, timer,
+	    &timer_timeout)) != 0)
+		bench_error("gfarm_eventqueue_add_event", err);
+	if ((err = gfarm_eventqueue_loop(bench_q, NULL)) != 0)
+		bench_error("gfarm_eventqueue_loop", err);
+	gfarm_event_free(timer);
+
+	if (bench_ntimeouts_fired != 2 ||
+	    bench_timeout_order[0] != 0 || bench_timeout_order[1] != 1) {
+		fprintf(stderr, "%s: timeouts expired in a wrong order\n",
+		    program_name);
+		return (0);
+	}
+	return (1);
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "Usage: %s [-i idle] [-a active] [-n callbacks]\n",
+	    program_name);
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char **argv)
+{
+	int c, i, err, ok = 1;
+	struct timeval t0, t1;
+	double elapsed;
+	char one = 1;
+
+	if (argc > 0)
+		program_name = argv[0];
+	while ((c = getopt(argc, argv, "a:i:n:")) != -1) {
+		switch (c) {
+		case 'a':
+			bench_nactive = atoi(optarg);
+			break;
+		case 'i':
+			bench_nidle = atoi(optarg);
+			break;
+		case 'n':
+			bench_ncallbacks = atol(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (bench_nidle < 1 || bench_nactive < 1 || bench_ncallbacks < 1)
+		usage();
+	bench_fd_limit();
+
+	if ((err = gfarm_eventqueue_alloc(bench_nidle + bench_nactive,
+	    &bench_q)) != 0)
+		bench_error("gfarm_eventqueue_alloc", err);
+	if ((bench_idle = calloc(bench_nidle, sizeof(*bench_idle))) == NULL ||
+	    (bench_active = calloc(bench_nactive, sizeof(*bench_active)))
+	    == NULL)
+		bench_error("calloc", ENOMEM);
+	for (i = 0; i < bench_nidle; i++) {
+		bench_conn_init(&bench_idle[i], bench_idle_callback);
+		bench_add_event(bench_idle[i].ev, BENCH_IDLE_TIMEOUT);
+	}
+	for (i = 0; i < bench_nactive; i++) {
+		bench_conn_init(&bench_active[i], bench_active_callback);
+		if (write(bench_active[i].fds[1], &one, 1) != 1)
+			bench_error("write", errno);
+		bench_add_event(bench_active[i].ev, BENCH_ACTIVE_TIMEOUT);
+	}
+
+	gettimeofday(&t0, NULL);
+	while (bench_nfired < bench_ncallbacks) {
+		err = gfarm_eventqueue_turn(bench_q, NULL);
+		if (err != EAGAIN && err != EINTR)
+			bench_error("gfarm_eventqueue_turn", err);
+	}
+	gettimeofday(&t1, NULL);
+	elapsed = bench_timeval_sub(&t1, &t0);
+
+	/* drain the active events which are still in the queue */
+	for (i = 0; i < bench_nactive; i++)
+		(void)gfarm_eventqueue_delete_event(bench_q,
+		    bench_active[i].ev);
+
+	printf("idle connections: %d\n", bench_nidle);
+	printf("active connections: %d\n", bench_nactive);
+	printf("callbacks: %ld\n", bench_nfired);
+	printf("elapsed: %.3f sec\n", elapsed);
+	printf("callbacks/sec: %.0f\n", bench_nfired / elapsed);
+	printf("usec/callback: %.3f\n", elapsed * 1e6 / bench_nfired);
+
+	if (bench_ntimedout != 0) {
+		fprintf(stderr, "%s: %ld events timed out unexpectedly\n",
+		    program_name, bench_ntimedout);
+		ok = 0;
+	}
+	if (!bench_check_timeout())
+		ok = 0;
+
+	for (i = 0; i < bench_nidle; i++) {
+		gfarm_event_free(bench_idle[i].ev);
+		close(bench_idle[i].fds[0]);
+		close(bench_idle[i].fds[1]);
+	}
+	for (i = 0; i < bench_nactive; i++) {
+		gfarm_event_free(bench_active[i].ev);
+		close(bench_active[i].fds[0]);
+		close(bench_active[i].fds[1]);
+	}
+	free(bench_idle);
+	free(bench_active);
+	gfarm_eventqueue_free(bench_q);
+	return (ok ? EXIT_SUCCESS : EXIT_FAILURE);
+}
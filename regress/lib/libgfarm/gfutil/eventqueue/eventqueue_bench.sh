@@ -0,0 +1,13 @@
+#!/bin/sh
+
+. ./regress.conf
+
+# 50k idle connections and 1k active ones.
+# the idle connections are reduced, if file descriptors are limited.
+if $testbin/eventqueue_bench -i 50000 -a 1000 -n 1000000; then
+	exit_code=$exit_pass
+else
+	exit_code=$exit_fail
+fi
+
+exit $exit_code
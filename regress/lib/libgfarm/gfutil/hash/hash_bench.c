@@ -0,0 +1,293 @@
+/*
+ * check gfarm_hash_table, and measure the time of its operations.
+ *
+ * the keys are host names like "host0000123.example.org", and the data is
+ * the number of the key.  the table is allocated with a small size hint,
+ * as the callers in gfarm do, and grows to the number of keys.
+ *
+ * $Id$
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+
+#include "hash.h"
+
+#define BENCH_KEY_MAX	64
+
+static char *program_name = "hash_bench";
+
+static int bench_nkeys = 1000000;
+static int bench_size_hint = 3079;
+
+static int bench_errors = 0;
+
+static double
+bench_now(void)
+{
+	struct timeval t;
+
+	gettimeofday(&t, NULL);
+	return (t.tv_sec + t.tv_usec * .000001);
+}
+
+static int
+bench_key(char *key, int i, int upper)
+{
+	return (snprintf(key, BENCH_KEY_MAX,
+	    upper ? "HOST%07d.EXAMPLE.ORG" : "host%07d.example.org", i) + 1);
+}
+
+static void
+bench_error(const char *diag, int i)
+{
+	fprintf(stderr, "%s: %s (key %d)\n", program_name, diag, i);
+	if (++bench_errors >= 10)
+		exit(EXIT_FAILURE);
+}
+
+static void
+bench_report(const char *op, int n, double elapsed)
+{
+	printf("%-16s %8.1f nsec/op\n", op, elapsed * 1e9 / n);
+}
+
+static struct gfarm_hash_table *
+bench_table_alloc(void)
+{
+	struct gfarm_hash_table *hashtab = gfarm_hash_table_alloc(
+	    bench_size_hint, gfarm_hash_default, gfarm_hash_key_equal_default);
+
+	if (hashtab == NULL) {
+		fprintf(stderr, "%s: no memory\n", program_name);
+		exit(EXIT_FAILURE);
+	}
+	return (hashtab);
+}
+
+static void
+bench_enter(struct gfarm_hash_table *hashtab, int i, int expect_created,
+	double *max_latency)
+{
+	char key[BENCH_KEY_MAX];
+	struct gfarm_hash_entry *entry;
+	int created, keylen = bench_key(key, i, 0);
+	double t0 = 0;
+
+	if (max_latency != NULL)
+		t0 = bench_now();
+	entry = gfarm_hash_enter(hashtab, key, keylen, sizeof(int), &created);
+	if (max_latency != NULL && bench_now() - t0 > *max_latency)
+		*max_latency = bench_now() - t0;
+	if (entry == NULL) {
+		fprintf(stderr, "%s: no memory\n", program_name);
+		exit(EXIT_FAILURE);
+	}
+	if (created != expect_created)
+		bench_error("unexpected created flag", i);
+	if (created)
+		*(int *)gfarm_hash_entry_data(entry) = i;
+	else if (*(int *)gfarm_hash_entry_data(entry) != i)
+		bench_error("wrong data", i);
+}
+
+static void
+bench_lookup(struct gfarm_hash_table *hashtab, int i, int expect_found)
+{
+	char key[BENCH_KEY_MAX];
+	struct gfarm_hash_entry *entry;
+	int keylen = bench_key(key, i, 0);
+
+	entry = gfarm_hash_lookup(hashtab, key, keylen);
+	if ((entry != NULL) != expect_found)
+		bench_error(expect_found ? "not found" : "unexpectedly found",
+		    i);
+	else if (entry != NULL && *(int *)gfarm_hash_entry_data(entry) != i)
+		bench_error("wrong data", i);
+}
+
+/* every entry is visited exactly once */
+static int
+bench_iterate(struct gfarm_hash_table *hashtab, char *visited, int nkeys)
+{
+	struct gfarm_hash_iterator it;
+	struct gfarm_hash_entry *entry;
+	int i, n = 0;
+
+	memset(visited, 0, nkeys);
+	for (gfarm_hash_iterator_begin(hashtab, &it);
+	     !gfarm_hash_iterator_is_end(&it);
+	     gfarm_hash_iterator_next(&it)) {
+		entry = gfarm_hash_iterator_access(&it);
+		i = *(int *)gfarm_hash_entry_data(entry);
+		if (i < 0 || i >= nkeys || visited[i]++)
+			bench_error("visited twice", i);
+		n++;
+	}
+	return (n);
+}
+
+/*
+ * lookups, purges and iterations are checked during growth,
+ * i.e. while the entries are being moved to the new slots.
+ */
+static void
+bench_check(void)
+{
+	struct gfarm_hash_table *hashtab = bench_table_alloc(), *ci;
+	struct gfarm_hash_iterator it;
+	char key[BENCH_KEY_MAX], *visited;
+	int i, n, nkeys = 100000, keylen;
+
+	if ((visited = malloc(nkeys)) == NULL) {
+		fprintf(stderr, "%s: no memory\n", program_name);
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < nkeys; i++) {
+		bench_enter(hashtab, i, 1, NULL);
+		if (i % 3 == 0) {
+			keylen = bench_key(key, i / 3, 0);
+			if (!gfarm_hash_purge(hashtab, key, keylen))
+				bench_error("not purged", i / 3);
+		}
+		if (i % 9973 == 0) {
+			n = bench_iterate(hashtab, visited, nkeys);
+			if (n != i + 1 - (i / 3 + 1))
+				bench_error("wrong number of entries", n);
+		}
+	}
+	for (i = 0; i < nkeys; i++)
+		bench_lookup(hashtab, i, i > (nkeys - 1) / 3);
+
+	/* purge the odd keys during an iteration */
+	for (gfarm_hash_iterator_begin(hashtab, &it);
+	     !gfarm_hash_iterator_is_end(&it);) {
+		i = *(int *)gfarm_hash_entry_data(
+		    gfarm_hash_iterator_access(&it));
+		if (i % 2 == 1)
+			gfarm_hash_iterator_purge(&it);
+		else
+			gfarm_hash_iterator_next(&it);
+	}
+	for (i = 0; i < nkeys; i++)
+		bench_lookup(hashtab, i, i > (nkeys - 1) / 3 && i % 2 == 0);
+
+	/* purge by gfarm_hash_iterator_lookup() */
+	for (i = 0; i < nkeys; i += 2) {
+		keylen = bench_key(key, i, 0);
+		if (gfarm_hash_iterator_lookup(hashtab, key, keylen, &it) !=
+		    (i > (nkeys - 1) / 3))
+			bench_error("iterator_lookup", i);
+		else if (i > (nkeys - 1) / 3 && !gfarm_hash_iterator_purge(&it))
+			bench_error("iterator_purge", i);
+	}
+	if (bench_iterate(hashtab, visited, nkeys) != 0)
+		bench_error("table is not empty", 0);
+	gfarm_hash_table_free(hashtab);
+
+	ci = gfarm_hash_table_alloc(bench_size_hint,
+	    gfarm_hash_casefold, gfarm_hash_key_equal_casefold);
+	if (ci == NULL) {
+		fprintf(stderr, "%s: no memory\n", program_name);
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < 1000; i++) {
+		keylen = bench_key(key, i, 0);
+		if (gfarm_hash_enter(ci, key, keylen, 0, NULL) == NULL) {
+			fprintf(stderr, "%s: no memory\n", program_name);
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (i = 0; i < 1000; i++) {
+		keylen = bench_key(key, i, 1);
+		if (gfarm_hash_lookup(ci, key, keylen) == NULL)
+			bench_error("casefold lookup", i);
+	}
+	gfarm_hash_table_free(ci);
+	free(visited);
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "Usage: %s [-n keys] [-s size_hint]\n",
+	    program_name);
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct gfarm_hash_table *hashtab;
+	struct gfarm_hash_iterator it;
+	char key[BENCH_KEY_MAX], *visited;
+	int c, i, n, keylen;
+	double t0, max_latency = 0;
+
+	if (argc > 0)
+		program_name = argv[0];
+	while ((c = getopt(argc, argv, "n:s:")) != -1) {
+		switch (c) {
+		case 'n':
+			bench_nkeys = atoi(optarg);
+			break;
+		case 's':
+			bench_size_hint = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (bench_nkeys < 1 || bench_size_hint < 1)
+		usage();
+
+	bench_check();
+
+	if ((visited = malloc(bench_nkeys)) == NULL) {
+		fprintf(stderr, "%s: no memory\n", program_name);
+		exit(EXIT_FAILURE);
+	}
+	hashtab = bench_table_alloc();
+	printf("keys: %d, size hint: %d\n", bench_nkeys, bench_size_hint);
+
+	t0 = bench_now();
+	for (i = 0; i < bench_nkeys; i++)
+		bench_enter(hashtab, i, 1, &max_latency);
+	bench_report("enter", bench_nkeys, bench_now() - t0);
+	printf("%-16s %8.1f usec\n", "max enter", max_latency * 1e6);
+
+	t0 = bench_now();
+	for (i = 0; i < bench_nkeys; i++)
+		bench_lookup(hashtab, i, 1);
+	bench_report("lookup (hit)", bench_nkeys, bench_now() - t0);
+
+	t0 = bench_now();
+	for (i = 0; i < bench_nkeys; i++)
+		bench_lookup(hashtab, bench_nkeys + i, 0);
+	bench_report("lookup (miss)", bench_nkeys, bench_now() - t0);
+
+	t0 = bench_now();
+	n = bench_iterate(hashtab, visited, bench_nkeys);
+	bench_report("iterate", bench_nkeys, bench_now() - t0);
+	if (n != bench_nkeys)
+		bench_error("wrong number of entries", n);
+
+	t0 = bench_now();
+	for (i = 0; i < bench_nkeys; i++) {
+		keylen = bench_key(key, i, 0);
+		if (!gfarm_hash_purge(hashtab, key, keylen))
+			bench_error("not purged", i);
+	}
+	bench_report("purge", bench_nkeys, bench_now() - t0);
+	gfarm_hash_iterator_begin(hashtab, &it);
+	if (!gfarm_hash_iterator_is_end(&it))
+		bench_error("table is not empty", 0);
+
+	gfarm_hash_table_free(hashtab);
+	free(visited);
+	return (bench_errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
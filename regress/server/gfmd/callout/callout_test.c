@@ -0,0 +1,323 @@
+/*
+ * $Id$
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfutil.h"
+#include "timer.h"
+
+#include "config.h"
+
+#include "callout.h"
+
+/* dummy definitions to link successfully without rpc_stat.o */
+void rpc_stat_job_started(double wait) {}
+void rpc_stat_lock_waited(double wait) {}
+
+#define CALLOUT_NTHREADS	4
+
+static char *program_name = "callout_test";
+
+struct test_callout {
+	struct callout *callout;
+	int microseconds;
+	struct timeval scheduled, fired;
+	int nfired;
+};
+
+static pthread_mutex_t fired_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t fired_cond = PTHREAD_COND_INITIALIZER;
+static int nfired = 0;
+
+static void *
+test_callout_func(void *arg)
+{
+	struct test_callout *tc = arg;
+
+	pthread_mutex_lock(&fired_mutex);
+	gettimeofday(&tc->fired, NULL);
+	tc->nfired++;
+	nfired++;
+	pthread_cond_signal(&fired_cond);
+	pthread_mutex_unlock(&fired_mutex);
+	return (NULL);
+}
+
+static struct test_callout *
+test_callouts_new(int n)
+{
+	struct test_callout *tcs;
+	int i;
+
+	GFARM_MALLOC_ARRAY(tcs, n);
+	if (tcs == NULL) {
+		fprintf(stderr, "%s: no memory for %d callouts\n",
+		    program_name, n);
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < n; i++) {
+		if ((tcs[i].callout = callout_new()) == NULL) {
+			fprintf(stderr, "%s: callout_new: no memory\n",
+			    program_name);
+			exit(EXIT_FAILURE);
+		}
+		callout_setfunc(tcs[i].callout, NULL, test_callout_func,
+		    &tcs[i]);
+		tcs[i].nfired = 0;
+	}
+	return (tcs);
+}
+
+/*
+ * check that every callout fires once, not earlier than scheduled,
+ * and that stopped callouts never fire.
+ */
+static int
+t_order(int n, int slack_msec)
+{
+	struct test_callout *tcs = test_callouts_new(n);
+	struct timeval deadline;
+	int i, nstopped = 0, nerrors = 0;
+	long long late, max_late = 0;
+
+	srandom(getpid());
+	for (i = 0; i < n; i++) {
+		/* mostly in the level 0 wheel, some in the upper levels */
+		tcs[i].microseconds = i % 10 == 0 ?
+		    1000000 + random() % 2000000 : random() % 200000;
+		gettimeofday(&tcs[i].scheduled, NULL);
+		callout_schedule(tcs[i].callout, tcs[i].microseconds);
+	}
+	/* reschedule or stop some of the long ones before they fire */
+	for (i = 0; i < n; i += 10) {
+		if (i % 30 == 20) {
+			continue;
+		} else if (i % 30 == 0) {
+			tcs[i].microseconds = random() % 500000;
+			gettimeofday(&tcs[i].scheduled, NULL);
+			callout_schedule(tcs[i].callout, tcs[i].microseconds);
+		} else {
+			if (callout_stop(tcs[i].callout))
+				continue; /* already fired */
+			tcs[i].microseconds = -1;
+			nstopped++;
+		}
+	}
+
+	gettimeofday(&deadline, NULL);
+	deadline.tv_sec += 3 + (slack_msec + 999) / 1000;
+	pthread_mutex_lock(&fired_mutex);
+	while (nfired < n - nstopped) {
+		struct timespec ts;
+
+		ts.tv_sec = deadline.tv_sec;
+		ts.tv_nsec = deadline.tv_usec * 1000;
+		if (pthread_cond_timedwait(&fired_cond, &fired_mutex, &ts)
+		    != 0)
+			break;
+	}
+	pthread_mutex_unlock(&fired_mutex);
+	/* make sure that stopped callouts don't fire */
+	sleep(1);
+
+	pthread_mutex_lock(&fired_mutex);
+	for (i = 0; i < n; i++) {
+		struct test_callout *tc = &tcs[i];
+
+		if (tc->microseconds < 0) {
+			if (tc->nfired != 0) {
+				fprintf(stderr, "callout %d: fired after stop\n",
+				    i);
+				nerrors++;
+			}
+			continue;
+		}
+		if (tc->nfired != 1) {
+			fprintf(stderr, "callout %d: fired %d times\n",
+			    i, tc->nfired);
+			nerrors++;
+			continue;
+		}
+		late = (tc->fired.tv_sec - tc->scheduled.tv_sec) * 1000000LL +
+		    (tc->fired.tv_usec - tc->scheduled.tv_usec) -
+		    tc->microseconds;
+		if (late < 0) {
+			fprintf(stderr, "callout %d: fired %lld usec earlier\n",
+			    i, -late);
+			nerrors++;
+		} else if (late > slack_msec * 1000LL) {
+			fprintf(stderr, "callout %d: fired %lld usec later\n",
+			    i, late);
+			nerrors++;
+		}
+		if (max_late < late)
+			max_late = late;
+	}
+	pthread_mutex_unlock(&fired_mutex);
+	printf("%d callouts, %d stopped, max delay %lld usec, %d errors\n",
+	    n, nstopped, max_late, nerrors);
+	return (nerrors == 0);
+}
+
+#define BUSY_SECONDS	2
+
+static void *
+test_busy_func(void *arg)
+{
+	test_callout_func(arg);
+	sleep(BUSY_SECONDS);
+	return (NULL);
+}
+
+/*
+ * check that callouts fire in time, even while other callout threads
+ * are busy running callouts which take long time.
+ * each callout is scheduled after the previous one starts to run.
+ */
+static int
+t_busy(int slack_msec)
+{
+	struct test_callout *tcs = test_callouts_new(CALLOUT_NTHREADS);
+	struct timeval deadline;
+	long long late, max_late = 0;
+	int i, nerrors = 0;
+
+	for (i = 0; i < CALLOUT_NTHREADS; i++) {
+		/* the callout threads themselves run these */
+		callout_setfunc(tcs[i].callout, NULL, test_busy_func, &tcs[i]);
+		tcs[i].microseconds = 10000;
+		gettimeofday(&tcs[i].scheduled, NULL);
+		callout_schedule(tcs[i].callout, tcs[i].microseconds);
+
+		gettimeofday(&deadline, NULL);
+		deadline.tv_sec += BUSY_SECONDS + 1;
+		pthread_mutex_lock(&fired_mutex);
+		while (tcs[i].nfired == 0) {
+			struct timespec ts;
+
+			ts.tv_sec = deadline.tv_sec;
+			ts.tv_nsec = deadline.tv_usec * 1000;
+			if (pthread_cond_timedwait(&fired_cond, &fired_mutex,
+			    &ts) != 0)
+				break;
+		}
+		pthread_mutex_unlock(&fired_mutex);
+		if (tcs[i].nfired == 0) {
+			fprintf(stderr, "busy callout %d: didn't fire\n", i);
+			nerrors++;
+			break;
+		}
+		late = (tcs[i].fired.tv_sec - tcs[i].scheduled.tv_sec) *
+		    1000000LL +
+		    (tcs[i].fired.tv_usec - tcs[i].scheduled.tv_usec) -
+		    tcs[i].microseconds;
+		if (late > slack_msec * 1000LL) {
+			fprintf(stderr,
+			    "busy callout %d: fired %lld usec later\n",
+			    i, late);
+			nerrors++;
+		}
+		if (max_late < late)
+			max_late = late;
+	}
+	/* let the callout threads finish */
+	sleep(BUSY_SECONDS);
+	printf("%d busy callouts, max delay %lld usec, %d errors\n",
+	    CALLOUT_NTHREADS, max_late, nerrors);
+	return (nerrors == 0);
+}
+
+static void
+print_throughput(const char *what, int n, gfarm_timerval_t *t1,
+	gfarm_timerval_t *t2)
+{
+	double sec = gfarm_timerval_sub(t2, t1);
+
+	printf("%-12s %d callouts: %.3f sec, %.0f ops/sec\n",
+	    what, n, sec, sec > 0 ? n / sec : 0.0);
+}
+
+/* throughput of schedule/stop with many pending callouts */
+static int
+t_bench(int n)
+{
+	struct test_callout *tcs = test_callouts_new(n);
+	gfarm_timerval_t t1, t2;
+	int i;
+
+	gfarm_timerval_calibrate();
+	srandom(getpid());
+	/* between 1 minute and 30 minutes, i.e. nothing fires */
+	for (i = 0; i < n; i++)
+		tcs[i].microseconds = 60000000 + random() % 1740000000;
+
+	gfarm_gettimerval(&t1);
+	for (i = 0; i < n; i++)
+		callout_schedule(tcs[i].callout, tcs[i].microseconds);
+	gfarm_gettimerval(&t2);
+	print_throughput("schedule", n, &t1, &t2);
+
+	/* e.g. heartbeat of each host */
+	gfarm_gettimerval(&t1);
+	for (i = 0; i < n; i++)
+		callout_schedule(tcs[i].callout, 60000000);
+	gfarm_gettimerval(&t2);
+	print_throughput("reschedule", n, &t1, &t2);
+
+	gfarm_gettimerval(&t1);
+	for (i = 0; i < n; i++)
+		callout_stop(tcs[i].callout);
+	gfarm_gettimerval(&t2);
+	print_throughput("stop", n, &t1, &t2);
+	return (1);
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "Usage: %s [-b] [-n <callouts>] [-s <slack-msec>]\n",
+	    program_name);
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char **argv)
+{
+	int c, opt_bench = 0, n = -1, slack_msec = 500, ok;
+
+	while ((c = getopt(argc, argv, "bn:s:?")) != -1) {
+		switch (c) {
+		case 'b':
+			opt_bench = 1;
+			break;
+		case 'n':
+			n = atoi(optarg);
+			break;
+		case 's':
+			slack_msec = atoi(optarg);
+			break;
+		case '?':
+		default:
+			usage();
+		}
+	}
+	if (n <= 0)
+		n = opt_bench ? 100000 : 10000;
+
+	/* gfarm_config_read() is not called */
+	gfarm_metadb_stack_size = GFARM_METADB_STACK_SIZE_DEFAULT;
+	callout_module_init(CALLOUT_NTHREADS);
+	if (opt_bench)
+		ok = t_bench(n);
+	else
+		ok = t_order(n, slack_msec) && t_busy(slack_msec);
+	return (ok ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -18,6 +18,7 @@
 /* #include "thrsubr.h" */ /* already included in db_journal.c */
 
 #include "crc32.h"
+#include "timespec.h"
 #include "user.h"
 #include "group.h"
 #include "mdhost.h"
@@ -2549,11 +2550,11 @@ t_apply_inode_add(void)
 	TEST_ASSERT_L("st_size",
 	    123, inode_get_size(i));
 	TEST_ASSERT_T("st_atimespec",
-	    atm, *inode_get_atime(i));
+	    atm, inode_get_atime(i));
 	TEST_ASSERT_T("st_mtimespec",
-	    mtm, *inode_get_mtime(i));
+	    mtm, inode_get_mtime(i));
 	TEST_ASSERT_T("st_ctimespec",
-	    ctm, *inode_get_ctime(i));
+	    ctm, inode_get_ctime(i));
 }
 
 static void
@@ -2602,11 +2603,11 @@ t_apply_inode_modify(void)
 	TEST_ASSERT_L("st_size",
 	    1123, inode_get_size(i));
 	TEST_ASSERT_T("st_atimespec",
-	    atm, *inode_get_atime(i));
+	    atm, inode_get_atime(i));
 	TEST_ASSERT_T("st_mtimespec",
-	    mtm, *inode_get_mtime(i));
+	    mtm, inode_get_mtime(i));
 	TEST_ASSERT_T("st_ctimespec",
-	    ctm, *inode_get_ctime(i));
+	    ctm, inode_get_ctime(i));
 }
 
 static void
@@ -2732,7 +2733,7 @@ t_apply_inode_atime_modify(void)
 {
 	struct inode *i;
 	struct db_inode_timespec_modify_arg m;
-	struct gfarm_timespec tm;
+	struct gfarm_timespec tm, cur;
 
 	m.inum = T_APPLY_INODE_FILE_INUM;
 	tm.tv_sec = 2111;
@@ -2741,12 +2742,13 @@ t_apply_inode_atime_modify(void)
 
 	TEST_ASSERT_B("inode_lookup",
 	    (i = inode_lookup(m.inum)) != NULL);
+	cur = inode_get_atime(i);
 	TEST_ASSERT_B("current st_atimespec",
-	    memcmp(&tm, inode_get_atime(i), sizeof(tm)) != 0);
+	    gfarm_timespec_cmp(&tm, &cur) != 0);
 	TEST_ASSERT_NOERR("inode_atime_modify",
 	    db_journal_apply_ops.inode_atime_modify(0, &m));
 	TEST_ASSERT_T("st_atimespec",
-	    tm, *inode_get_atime(i));
+	    tm, inode_get_atime(i));
 }
 
 static void
@@ -2754,7 +2756,7 @@ t_apply_inode_mtime_modify(void)
 {
 	struct inode *i;
 	struct db_inode_timespec_modify_arg m;
-	struct gfarm_timespec tm;
+	struct gfarm_timespec tm, cur;
 
 	m.inum = T_APPLY_INODE_FILE_INUM;
 	tm.tv_sec = 2333;
@@ -2763,12 +2765,13 @@ t_apply_inode_mtime_modify(void)
 
 	TEST_ASSERT_B("inode_lookup",
 	    (i = inode_lookup(m.inum)) != NULL);
+	cur = inode_get_mtime(i);
 	TEST_ASSERT_B("current st_mtimespec",
-	    memcmp(&tm, inode_get_mtime(i), sizeof(tm)) != 0);
+	    gfarm_timespec_cmp(&tm, &cur) != 0);
 	TEST_ASSERT_NOERR("inode_mtime_modify",
 	    db_journal_apply_ops.inode_mtime_modify(0, &m));
 	TEST_ASSERT_T("st_mtimespec",
-	    tm, *inode_get_mtime(i));
+	    tm, inode_get_mtime(i));
 }
 
 static void
@@ -2776,7 +2779,7 @@ t_apply_inode_ctime_modify(void)
 {
 	struct inode *i;
 	struct db_inode_timespec_modify_arg m;
-	struct gfarm_timespec tm;
+	struct gfarm_timespec tm, cur;
 
 	m.inum = T_APPLY_INODE_FILE_INUM;
 	tm.tv_sec = 2555;
@@ -2785,12 +2788,13 @@ t_apply_inode_ctime_modify(void)
 
 	TEST_ASSERT_B("inode_lookup",
 	    (i = inode_lookup(m.inum)) != NULL);
+	cur = inode_get_atime(i);
 	TEST_ASSERT_B("current st_atimespec",
-	    memcmp(&tm, inode_get_atime(i), sizeof(tm)) != 0);
+	    gfarm_timespec_cmp(&tm, &cur) != 0);
 	TEST_ASSERT_NOERR("inode_atime_modify",
 	    db_journal_apply_ops.inode_atime_modify(0, &m));
 	TEST_ASSERT_T("st_atimespec",
-	    tm, *inode_get_atime(i));
+	    tm, inode_get_atime(i));
 }
 
 static void
@@ -0,0 +1,519 @@
+/*
+ * check the batched removal of obsolete replicas by dead_file_copy.c,
+ * with a gfsd which supports GFS_PROTO_FHREMOVE_MULTI and an old gfsd.
+ *
+ * the back channel is replaced by the --wrap option of the linker.
+ * requests are recorded instead of being sent, and the results are
+ * made by this program.
+ *
+ * $Id$
+ */
+
+#include <pthread.h>	/* db_access.h currently needs this */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfutil.h"
+#include "queue.h"
+
+#include "gfp_xdr.h"
+#include "config.h"
+#include "gfs_proto.h"
+#include "metadb_server.h"
+
+#include "subr.h"
+#include "quota.h"
+#include "db_access.h"
+#include "db_ops.h"
+#include "mdhost.h"
+#include "abstract_host.h"
+#include "host.h"
+#include "user.h"
+#include "group.h"
+#include "inode.h"
+#include "netsendq.h"
+#include "netsendq_impl.h"
+#include "dead_file_copy.h"
+#include "internal_host_info.h"
+
+/* XXX FIXME - dummy definitions to link successfully without gfmd.o */
+struct thread_pool *sync_protocol_get_thrpool(void) { return NULL; }
+int protocol_service(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep)
+{ return 0; }
+void resuming_enqueue(void *entry) {}
+void gfmd_terminate(void) {}
+int gfmd_port;
+
+extern const struct db_ops empty_ops;
+
+static char *program_name = "dfc_batch_test";
+
+#define OLD_HOST	"old.example.org"	/* no GFS_PROTO_FHREMOVE_MULTI */
+#define NEW_HOST	"new.example.org"
+
+#define BATCH_SIZE	4
+#define NDFCS		10	/* dead file copies per host */
+#define DFC_INUM(i)	(100 + (i))
+#define DFC_IGEN	1
+
+/* the results made by the gfsd */
+#define NOENT_INUM	DFC_INUM(3)	/* already removed */
+#define EPERM_INUM	DFC_INUM(5)	/* fails, and retried */
+#define ABORT_INUM	DFC_INUM(7)	/* connection is lost, and retried */
+
+#define MAX_ENTRIES	64
+
+struct entry_list {
+	int n;
+	struct netsendq_entry *entries[MAX_ENTRIES];
+};
+
+static struct entry_list sendq, finishedq;
+
+struct request {
+	struct host *host;
+	gfarm_int32_t command;
+	gfarm_int32_t (*result_op)(void *, void *, size_t);
+	void (*disconnect_op)(void *, void *);
+	void *closure;
+
+	int n;
+	gfarm_ino_t inums[BATCH_SIZE];
+	gfarm_uint64_t igens[BATCH_SIZE];
+};
+
+static struct request requests[MAX_ENTRIES];
+static int nrequests;
+static struct request *replying;
+
+static int errors = 0;
+
+static void
+error(const char *format, ...)
+{
+	va_list ap;
+
+	fprintf(stderr, "%s: ", program_name);
+	va_start(ap, format);
+	vfprintf(stderr, format, ap);
+	va_end(ap);
+	fputc('\n', stderr);
+	errors++;
+}
+
+static void
+entry_list_add(struct entry_list *l, struct netsendq_entry *qentry)
+{
+	if (l->n >= MAX_ENTRIES) {
+		fprintf(stderr, "%s: too many entries\n", program_name);
+		exit(EXIT_FAILURE);
+	}
+	l->entries[l->n++] = qentry;
+}
+
+/*
+ * wrappers
+ */
+
+gfarm_error_t
+__wrap_netsendq_add_entry(struct netsendq *qhost,
+	struct netsendq_entry *qentry, int flags)
+{
+	if (qentry->sendq_type != &gfs_proto_fhremove_queue) {
+		fprintf(stderr, "%s: unexpected netsendq entry\n",
+		    program_name);
+		exit(EXIT_FAILURE);
+	}
+	entry_list_add(&sendq, qentry);
+	return (GFARM_ERR_NO_ERROR);
+}
+
+void
+__wrap_netsendq_entry_was_sent(struct netsendq *qhost,
+	struct netsendq_entry *qentry)
+{
+}
+
+void
+__wrap_netsendq_remove_entry(struct netsendq *qhost,
+	struct netsendq_entry *qentry, gfarm_error_t result)
+{
+	qentry->result = result;
+	entry_list_add(&finishedq, qentry);
+}
+
+int
+__wrap_host_supports_fhremove_multi(struct host *h)
+{
+	return (strcmp(host_name(h), NEW_HOST) == 0);
+}
+
+static gfarm_uint64_t
+decode_uint64(const unsigned char *p)
+{
+	gfarm_uint64_t v = 0;
+	int i;
+
+	for (i = 0; i < sizeof(v); i++)
+		v = (v << 8) | p[i];
+	return (v);
+}
+
+gfarm_error_t
+__wrap_gfs_client_send_request(struct host *host,
+	struct peer *peer0, const char *diag,
+	gfarm_int32_t (*result_op)(void *, void *, size_t),
+	void (*disconnect_op)(void *, void *),
+	void *closure,
+	gfarm_int32_t command, const char *format, ...)
+{
+	va_list ap;
+	struct request *r;
+	const unsigned char *buf;
+	size_t size;
+	int i;
+
+	if (nrequests >= MAX_ENTRIES) {
+		fprintf(stderr, "%s: too many requests\n", program_name);
+		exit(EXIT_FAILURE);
+	}
+	r = &requests[nrequests++];
+	r->host = host;
+	r->command = command;
+	r->result_op = result_op;
+	r->disconnect_op = disconnect_op;
+	r->closure = closure;
+
+	va_start(ap, format);
+	switch (command) {
+	case GFS_PROTO_FHREMOVE:
+		r->n = 1;
+		r->inums[0] = va_arg(ap, gfarm_int64_t);
+		r->igens[0] = va_arg(ap, gfarm_int64_t);
+		break;
+	case GFS_PROTO_FHREMOVE_MULTI:
+		r->n = va_arg(ap, gfarm_int32_t);
+		size = va_arg(ap, size_t);
+		buf = va_arg(ap, const unsigned char *);
+		if (r->n < 1 || r->n > BATCH_SIZE ||
+		    size != r->n * GFS_PROTO_FHREMOVE_MULTI_ENTRY_SIZE) {
+			fprintf(stderr, "%s: %d replicas in %d bytes\n",
+			    program_name, r->n, (int)size);
+			exit(EXIT_FAILURE);
+		}
+		for (i = 0; i < r->n; i++) {
+			r->inums[i] = decode_uint64(
+			    buf + i * GFS_PROTO_FHREMOVE_MULTI_ENTRY_SIZE);
+			r->igens[i] = decode_uint64(
+			    buf + i * GFS_PROTO_FHREMOVE_MULTI_ENTRY_SIZE +
+			    sizeof(gfarm_uint64_t));
+		}
+		break;
+	default:
+		fprintf(stderr, "%s: unexpected request %d\n",
+		    program_name, (int)command);
+		exit(EXIT_FAILURE);
+	}
+	va_end(ap);
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static gfarm_error_t
+removal_result(gfarm_ino_t inum)
+{
+	if (inum == NOENT_INUM)
+		return (GFARM_ERR_NO_SUCH_FILE_OR_DIRECTORY);
+	if (inum == EPERM_INUM)
+		return (GFARM_ERR_OPERATION_NOT_PERMITTED);
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static void
+encode_int32(unsigned char *p, gfarm_int32_t v)
+{
+	p[0] = (v >> 24) & 0xff;
+	p[1] = (v >> 16) & 0xff;
+	p[2] = (v >> 8) & 0xff;
+	p[3] = v & 0xff;
+}
+
+gfarm_error_t
+__wrap_gfs_client_recv_result(struct peer *peer, struct host *host,
+	size_t size, const char *diag, const char *format, ...)
+{
+	va_list ap;
+	struct request *r = replying;
+	size_t expected, *rsizep;
+	unsigned char *buf;
+	int i;
+
+	if (r->command == GFS_PROTO_FHREMOVE)
+		return (removal_result(r->inums[0]));
+
+	va_start(ap, format);
+	expected = va_arg(ap, size_t);
+	rsizep = va_arg(ap, size_t *);
+	buf = va_arg(ap, unsigned char *);
+	va_end(ap);
+	if (expected != r->n * GFS_PROTO_FHREMOVE_MULTI_RESULT_SIZE) {
+		error("%s: %d results are expected in %d bytes",
+		    diag, r->n, (int)expected);
+		return (GFARM_ERR_PROTOCOL);
+	}
+	for (i = 0; i < r->n; i++)
+		encode_int32(buf + i * GFS_PROTO_FHREMOVE_MULTI_RESULT_SIZE,
+		    removal_result(r->inums[i]));
+	*rsizep = expected;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/*
+ * the database
+ */
+
+static char *
+test_strdup(const char *s)
+{
+	char *p = strdup(s);
+
+	if (p == NULL) {
+		fprintf(stderr, "%s: no memory\n", program_name);
+		exit(EXIT_FAILURE);
+	}
+	return (p);
+}
+
+static void
+test_host(void (*callback)(void *, struct gfarm_internal_host_info *),
+	void *closure, const char *name)
+{
+	struct gfarm_internal_host_info hi;
+
+	memset(&hi, 0, sizeof(hi));
+	hi.hi.hostname = test_strdup(name);
+	hi.hi.port = 600;
+	hi.hi.nhostaliases = 0;
+	hi.hi.hostaliases = NULL;
+	hi.hi.architecture = test_strdup("x86_64-linux");
+	hi.hi.ncpu = 1;
+	hi.hi.flags = 0;
+	hi.fsngroupname = NULL;
+	(*callback)(closure, &hi);
+}
+
+static gfarm_error_t
+test_host_load(void *closure,
+	void (*callback)(void *, struct gfarm_internal_host_info *))
+{
+	test_host(callback, closure, OLD_HOST);
+	test_host(callback, closure, NEW_HOST);
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static gfarm_error_t
+test_deadfilecopy_load(void *closure,
+	void (*callback)(void *, gfarm_ino_t, gfarm_uint64_t, char *))
+{
+	int i;
+
+	for (i = 0; i < NDFCS; i++) {
+		(*callback)(closure, DFC_INUM(i), DFC_IGEN,
+		    test_strdup(OLD_HOST));
+		(*callback)(closure, DFC_INUM(i), DFC_IGEN,
+		    test_strdup(NEW_HOST));
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/*
+ * the test
+ */
+
+static void
+expect_int(const char *diag, int value, int expected)
+{
+	if (value != expected)
+		error("%s: %d, but %d is expected", diag, value, expected);
+}
+
+/*
+ * send the batches queued for the host, and check that
+ * each request is sent in the form which the host supports,
+ * and each expected replica is requested to be removed exactly once.
+ */
+static void
+round_send(const char *diag, struct host *host,
+	int expected_nrequests, int expected_nreplicas, const int *inums)
+{
+	struct entry_list queued = sendq;
+	int i, j, k, first = nrequests, nreplicas = 0, nr[MAX_ENTRIES];
+	int multi = __wrap_host_supports_fhremove_multi(host);
+	char buf[256];
+
+	/* the batches for the other hosts are kept in the queue */
+	sendq.n = 0;
+	for (i = 0; i < queued.n; i++) {
+		if (abstract_host_to_host(queued.entries[i]->abhost) == host)
+			(*gfs_proto_fhremove_queue.send)(queued.entries[i]);
+		else
+			entry_list_add(&sendq, queued.entries[i]);
+	}
+
+	memset(nr, 0, sizeof(nr));
+	for (i = first; i < nrequests; i++) {
+		snprintf(buf, sizeof(buf), "%s: %s: request %d",
+		    diag, host_name(host), i - first);
+		if (requests[i].host != host)
+			error("%s: sent to %s", buf,
+			    host_name(requests[i].host));
+		if (requests[i].n > 1 || !multi)
+			expect_int(buf, requests[i].command, multi ?
+			    GFS_PROTO_FHREMOVE_MULTI : GFS_PROTO_FHREMOVE);
+		for (j = 0; j < requests[i].n; j++) {
+			nreplicas++;
+			expect_int(buf, (int)requests[i].igens[j], DFC_IGEN);
+			for (k = 0; k < expected_nreplicas; k++) {
+				if (requests[i].inums[j] == inums[k])
+					nr[k]++;
+			}
+		}
+	}
+	snprintf(buf, sizeof(buf), "%s: %s: requests", diag, host_name(host));
+	expect_int(buf, nrequests - first, expected_nrequests);
+	snprintf(buf, sizeof(buf), "%s: %s: replicas", diag, host_name(host));
+	expect_int(buf, nreplicas, expected_nreplicas);
+	for (k = 0; k < expected_nreplicas; k++) {
+		snprintf(buf, sizeof(buf), "%s: %s: inode %d",
+		    diag, host_name(host), inums[k]);
+		expect_int(buf, nr[k], 1);
+	}
+}
+
+/* reply to the requests, and finalize the batches */
+static void
+round_reply(const char *diag, int expected_nbatches)
+{
+	struct entry_list finished;
+	int i;
+
+	for (i = 0; i < nrequests; i++) {
+		replying = &requests[i];
+		if (requests[i].command == GFS_PROTO_FHREMOVE &&
+		    requests[i].inums[0] == ABORT_INUM)
+			(*requests[i].disconnect_op)(NULL,
+			    requests[i].closure);
+		else
+			(*requests[i].result_op)(NULL,
+			    requests[i].closure, 0);
+	}
+	replying = NULL;
+	nrequests = 0;
+
+	finished = finishedq;
+	finishedq.n = 0;
+	expect_int(diag, finished.n, expected_nbatches);
+	for (i = 0; i < finished.n; i++)
+		(*gfs_proto_fhremove_queue.finalize)(finished.entries[i]);
+}
+
+int
+main(int argc, char **argv)
+{
+	gfarm_error_t e;
+	struct db_ops test_ops;
+	struct host *old_host, *new_host;
+	int all[NDFCS], i;
+	static const int retried_old[] = { EPERM_INUM, ABORT_INUM };
+	static const int retried_new[] = { EPERM_INUM };
+
+	/* XXX: settings in gfmd.conf doesn't work in this case */
+	char *config = getenv("GFARM_CONFIG_FILE");
+
+	debug_mode = 1;
+	e = gfarm_server_initialize(config, &argc, &argv);
+	if (e != GFARM_ERR_NO_ERROR) {
+		fprintf(stderr, "%s: gfarm_server_initialize: %s\n",
+		    program_name, gfarm_error_string(e));
+		exit(EXIT_FAILURE);
+	}
+	/* the retries are reported by gflog_error() */
+	gflog_set_priority_level(LOG_CRIT);
+	gfs_proto_fhremove_batch_size = BATCH_SIZE;
+
+	test_ops = empty_ops;
+	test_ops.host_load = test_host_load;
+	test_ops.deadfilecopy_load = test_deadfilecopy_load;
+
+	gfarm_set_metadb_replication_enabled(0);
+	db_use(&test_ops);
+	giant_init();
+	e = db_initialize();
+	if (e != GFARM_ERR_NO_ERROR) {
+		fprintf(stderr, "%s: db_initialize: %s\n",
+		    program_name, gfarm_error_string(e));
+		exit(EXIT_FAILURE);
+	}
+	e = create_detached_thread(db_thread, NULL);
+	if (e != GFARM_ERR_NO_ERROR) {
+		fprintf(stderr, "%s: create_detached_thread(db_thread): %s\n",
+		    program_name, gfarm_error_string(e));
+		exit(EXIT_FAILURE);
+	}
+
+	mdhost_init();
+	host_init();
+	user_init();
+	group_init();
+	inode_init();
+	dir_entry_init();
+	file_copy_init();
+	symlink_init();
+	xattr_init();
+
+	old_host = host_lookup(OLD_HOST);
+	new_host = host_lookup(NEW_HOST);
+	if (old_host == NULL || new_host == NULL) {
+		fprintf(stderr, "%s: hosts are not loaded\n", program_name);
+		exit(EXIT_FAILURE);
+	}
+
+	/* the dead file copies are scheduled to be removed at loading */
+	dead_file_copy_init(1);
+
+	/*
+	 * whether the gfsd supports GFS_PROTO_FHREMOVE_MULTI is unknown
+	 * at loading, thus both hosts get BATCH_SIZE replicas per batch,
+	 * and the batch is sent by a request per replica to the old gfsd.
+	 */
+	for (i = 0; i < NDFCS; i++)
+		all[i] = DFC_INUM(i);
+	expect_int("queued batches", sendq.n,
+	    2 * ((NDFCS + BATCH_SIZE - 1) / BATCH_SIZE));
+	round_send("1st", old_host, NDFCS, NDFCS, all);
+	round_send("1st", new_host, (NDFCS + BATCH_SIZE - 1) / BATCH_SIZE,
+	    NDFCS, all);
+	expect_int("1st: queued batches", sendq.n, 0);
+	round_reply("1st: finished batches",
+	    2 * ((NDFCS + BATCH_SIZE - 1) / BATCH_SIZE));
+
+	/* only the failed replicas are retried */
+	expect_int("2nd: queued batches", sendq.n, 2);
+	round_send("2nd", old_host, GFARM_ARRAY_LENGTH(retried_old),
+	    GFARM_ARRAY_LENGTH(retried_old), retried_old);
+	round_send("2nd", new_host, 1,
+	    GFARM_ARRAY_LENGTH(retried_new), retried_new);
+	round_reply("2nd: finished batches", 2);
+
+	/* the same replicas fail again, and nothing else is left */
+	expect_int("3rd: queued batches", sendq.n, 2);
+
+	if (errors > 0)
+		return (EXIT_FAILURE);
+	printf("ok\n");
+	return (EXIT_SUCCESS);
+}
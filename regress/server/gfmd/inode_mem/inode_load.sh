@@ -0,0 +1,14 @@
+#!/bin/sh
+
+. ./regress.conf
+
+# 1M inodes, and 2 replicas per file.
+# 128 bytes of struct inode, 8 bytes of the inode table, 2 * 24 bytes of
+# struct file_copy, and some slack of the slabs on LP64.
+if $testbin/inode_load_bench -n 1000000 -r 2 -t 192; then
+	exit_code=$exit_pass
+else
+	exit_code=$exit_fail
+fi
+
+exit $exit_code
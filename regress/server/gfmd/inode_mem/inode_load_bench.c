@@ -0,0 +1,564 @@
+/*
+ * load a synthetic namespace into the in-memory metadata of gfmd,
+ * and report the time and the memory used per inode.
+ *
+ * the namespace consists of the root directory, directories in the root,
+ * and regular files in the directories.  each file has replicas on hosts.
+ * it is generated by the *_load() operations of a db_ops which is based on
+ * empty_ops, and loaded by the same *_init() functions as gfmd.
+ * the usage of the directory trees computed by inode_usage_check() is
+ * verified as well, and so is the usage maintained incrementally while
+ * the namespace is modified after that.
+ *
+ * $Id$
+ */
+
+#include <pthread.h>	/* db_access.h currently needs this */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfutil.h"
+#include "nanosec.h"
+
+#include "gfp_xdr.h"
+#include "config.h"
+#include "metadb_server.h"
+
+#include "subr.h"
+#include "quota.h"
+#include "db_access.h"
+#include "db_ops.h"
+#include "mdhost.h"
+#include "host.h"
+#include "user.h"
+#include "group.h"
+#include "inode.h"
+#include "dead_file_copy.h"
+#include "internal_host_info.h"
+
+/* XXX FIXME - dummy definitions to link successfully without gfmd.o */
+struct thread_pool *sync_protocol_get_thrpool(void) { return NULL; }
+int protocol_service(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep)
+{ return 0; }
+void resuming_enqueue(void *entry) {}
+void gfmd_terminate(void) {}
+int gfmd_port;
+
+/* see WRAP_LDFLAGS in Makefile */
+struct user *__wrap_process_get_user(struct process *);
+
+extern const struct db_ops empty_ops;
+
+#define BENCH_ROOT_INUMBER	2	/* same as ROOT_INUMBER in inode.c */
+
+static char *program_name = "inode_load_bench";
+
+static gfarm_uint64_t bench_ninodes = 1000000;
+static int bench_fanout = 1000;		/* files per directory */
+static int bench_nreplicas = 2;		/* replicas per file */
+static int bench_nhosts = 16;
+
+/* computed from the above */
+static gfarm_uint64_t bench_ndirs, bench_nfiles;
+
+#define BENCH_DIR_INUM(i)	(BENCH_ROOT_INUMBER + 1 + (i))
+#define BENCH_FILE_INUM(i)	(BENCH_ROOT_INUMBER + 1 + bench_ndirs + (i))
+
+static char *
+bench_strdup(const char *s)
+{
+	char *p = strdup(s);
+
+	if (p == NULL) {
+		fprintf(stderr, "%s: no memory\n", program_name);
+		exit(EXIT_FAILURE);
+	}
+	return (p);
+}
+
+static char *
+bench_hostname(int i)
+{
+	char name[64];
+
+	snprintf(name, sizeof(name), "fsnode%04d.example.org", i);
+	return (bench_strdup(name));
+}
+
+static gfarm_error_t
+bench_host_load(void *closure,
+	void (*callback)(void *, struct gfarm_internal_host_info *))
+{
+	int i;
+	struct gfarm_internal_host_info hi;
+
+	for (i = 0; i < bench_nhosts; i++) {
+		memset(&hi, 0, sizeof(hi));
+		hi.hi.hostname = bench_hostname(i);
+		hi.hi.port = 600;
+		hi.hi.nhostaliases = 0;
+		hi.hi.hostaliases = NULL;
+		hi.hi.architecture = bench_strdup("x86_64-linux");
+		hi.hi.ncpu = 1;
+		hi.hi.flags = 0;
+		hi.fsngroupname = NULL;
+		(*callback)(closure, &hi);
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static void
+bench_stat(struct gfs_stat *st, gfarm_ino_t inum, gfarm_mode_t mode,
+	gfarm_uint64_t nlink)
+{
+	memset(st, 0, sizeof(*st));
+	st->st_ino = inum;
+	st->st_gen = 0;
+	st->st_mode = mode;
+	st->st_nlink = nlink;
+	st->st_user = bench_strdup(ADMIN_USER_NAME);
+	st->st_group = bench_strdup(ADMIN_GROUP_NAME);
+	st->st_size = GFARM_S_ISDIR(mode) ? 0 : 4096;
+	st->st_atimespec.tv_sec = st->st_mtimespec.tv_sec =
+	    st->st_ctimespec.tv_sec = 1000000000 + inum;
+	st->st_atimespec.tv_nsec = st->st_mtimespec.tv_nsec =
+	    st->st_ctimespec.tv_nsec = inum % GFARM_SECOND_BY_NANOSEC;
+}
+
+static gfarm_error_t
+bench_inode_load(void *closure, void (*callback)(void *, struct gfs_stat *))
+{
+	gfarm_uint64_t i;
+	struct gfs_stat st;
+
+	bench_stat(&st, BENCH_ROOT_INUMBER, GFARM_S_IFDIR | 0755,
+	    2 + bench_ndirs);
+	(*callback)(closure, &st);
+	for (i = 0; i < bench_ndirs; i++) {
+		bench_stat(&st, BENCH_DIR_INUM(i), GFARM_S_IFDIR | 0755, 2);
+		(*callback)(closure, &st);
+	}
+	for (i = 0; i < bench_nfiles; i++) {
+		bench_stat(&st, BENCH_FILE_INUM(i), GFARM_S_IFREG | 0644, 1);
+		(*callback)(closure, &st);
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+typedef void (*bench_direntry_callback_t)(void *,
+	gfarm_ino_t, char *, int, gfarm_ino_t);
+
+static void
+bench_direntry(bench_direntry_callback_t callback,
+	void *closure, gfarm_ino_t dir, const char *name, gfarm_ino_t entry)
+{
+	char *s = bench_strdup(name);
+
+	(*callback)(closure, dir, s, strlen(s), entry);
+}
+
+static gfarm_error_t
+bench_direntry_load(void *closure, bench_direntry_callback_t callback)
+{
+	gfarm_uint64_t i;
+	char name[32];
+
+	bench_direntry(callback, closure,
+	    BENCH_ROOT_INUMBER, ".", BENCH_ROOT_INUMBER);
+	bench_direntry(callback, closure,
+	    BENCH_ROOT_INUMBER, "..", BENCH_ROOT_INUMBER);
+	for (i = 0; i < bench_ndirs; i++) {
+		snprintf(name, sizeof(name), "d%llu", (unsigned long long)i);
+		bench_direntry(callback, closure,
+		    BENCH_ROOT_INUMBER, name, BENCH_DIR_INUM(i));
+		bench_direntry(callback, closure,
+		    BENCH_DIR_INUM(i), ".", BENCH_DIR_INUM(i));
+		bench_direntry(callback, closure,
+		    BENCH_DIR_INUM(i), "..", BENCH_ROOT_INUMBER);
+	}
+	for (i = 0; i < bench_nfiles; i++) {
+		snprintf(name, sizeof(name), "f%llu", (unsigned long long)i);
+		bench_direntry(callback, closure,
+		    BENCH_DIR_INUM(i % bench_ndirs), name,
+		    BENCH_FILE_INUM(i));
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static gfarm_error_t
+bench_filecopy_load(void *closure,
+	void (*callback)(void *, gfarm_ino_t, char *))
+{
+	gfarm_uint64_t i;
+	int j;
+
+	for (i = 0; i < bench_nfiles; i++) {
+		for (j = 0; j < bench_nreplicas; j++)
+			(*callback)(closure, BENCH_FILE_INUM(i),
+			    bench_hostname((i + j) % bench_nhosts));
+	}
+	return (GFARM_ERR_NO_ERROR);
+}
+
+/* the usage under the directory should be `nfiles' files */
+static void
+bench_check_usage(const char *diag, struct inode *dir,
+	gfarm_uint64_t ndirs, gfarm_uint64_t nfiles)
+{
+	gfarm_error_t e;
+	gfarm_int64_t space, num, phy_space, phy_num;
+
+	e = inode_get_usage(dir, &space, &num, &phy_space, &phy_num);
+	if (e != GFARM_ERR_NO_ERROR) {
+		fprintf(stderr, "%s: usage of %s: %s\n",
+		    program_name, diag, gfarm_error_string(e));
+		exit(EXIT_FAILURE);
+	}
+	if (num != ndirs + nfiles || space != nfiles * 4096 ||
+	    phy_num != nfiles * bench_nreplicas ||
+	    phy_space != nfiles * bench_nreplicas * 4096) {
+		fprintf(stderr, "%s: usage of %s: "
+		    "%lld bytes, %lld files, %lld physical bytes, "
+		    "%lld replicas: wrong\n", program_name, diag,
+		    (long long)space, (long long)num,
+		    (long long)phy_space, (long long)phy_num);
+		exit(EXIT_FAILURE);
+	}
+}
+
+struct user *
+__wrap_process_get_user(struct process *process)
+{
+	return (user_lookup(ADMIN_USER_NAME));
+}
+
+struct bench_usage {
+	gfarm_int64_t space, num, phy_space, phy_num;
+};
+
+static void
+bench_get_usage(const char *diag, struct inode *dir, struct bench_usage *u)
+{
+	gfarm_error_t e;
+
+	e = inode_get_usage(dir, &u->space, &u->num,
+	    &u->phy_space, &u->phy_num);
+	if (e != GFARM_ERR_NO_ERROR) {
+		fprintf(stderr, "%s: %s: usage of %lld: %s\n",
+		    program_name, diag, (long long)inode_get_number(dir),
+		    gfarm_error_string(e));
+		exit(EXIT_FAILURE);
+	}
+}
+
+/*
+ * the usage maintained incrementally by the step `diag' should be same
+ * with the usage computed from scratch by inode_usage_check().
+ */
+static void
+bench_verify_usage(const char *diag, struct inode **dirs, int ndirs)
+{
+	int i;
+	struct bench_usage *maintained, computed;
+
+	maintained = malloc(sizeof(*maintained) * ndirs);
+	if (maintained == NULL) {
+		fprintf(stderr, "%s: no memory\n", program_name);
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < ndirs; i++)
+		bench_get_usage(diag, dirs[i], &maintained[i]);
+	inode_usage_check();
+	for (i = 0; i < ndirs; i++) {
+		bench_get_usage(diag, dirs[i], &computed);
+		if (memcmp(&maintained[i], &computed, sizeof(computed))
+		    != 0) {
+			fprintf(stderr, "%s: %s: usage of %lld: "
+			    "%lld/%lld bytes, %lld/%lld files, "
+			    "%lld/%lld physical bytes, %lld/%lld replicas "
+			    "(maintained/computed)\n", program_name, diag,
+			    (long long)inode_get_number(dirs[i]),
+			    (long long)maintained[i].space,
+			    (long long)computed.space,
+			    (long long)maintained[i].num,
+			    (long long)computed.num,
+			    (long long)maintained[i].phy_space,
+			    (long long)computed.phy_space,
+			    (long long)maintained[i].phy_num,
+			    (long long)computed.phy_num);
+			exit(EXIT_FAILURE);
+		}
+	}
+	free(maintained);
+}
+
+static struct inode *
+bench_lookup(const char *diag, struct inode *dir, char *name)
+{
+	gfarm_error_t e;
+	struct inode *inode;
+
+	e = inode_lookup_by_name(dir, name, NULL, 0, &inode);
+	if (e != GFARM_ERR_NO_ERROR) {
+		fprintf(stderr, "%s: %s: lookup %s: %s\n",
+		    program_name, diag, name, gfarm_error_string(e));
+		exit(EXIT_FAILURE);
+	}
+	return (inode);
+}
+
+static void
+bench_check_error(const char *diag, gfarm_error_t e)
+{
+	if (e != GFARM_ERR_NO_ERROR) {
+		fprintf(stderr, "%s: %s: %s\n",
+		    program_name, diag, gfarm_error_string(e));
+		exit(EXIT_FAILURE);
+	}
+}
+
+static struct host *
+bench_host(int i)
+{
+	char *name = bench_hostname(i);
+	struct host *h = host_lookup(name);
+
+	free(name);
+	if (h == NULL) {
+		fprintf(stderr, "%s: host %d is not found\n",
+		    program_name, i);
+		exit(EXIT_FAILURE);
+	}
+	return (h);
+}
+
+/*
+ * modify the namespace step by step, and verify the usage after each step.
+ * d0/new is a new file, which is renamed to d1/sub/moved, and
+ * d1/sub is a new directory, which is renamed to d2/sub2 with its files.
+ */
+static void
+bench_modify_namespace(void)
+{
+	int dummy, created;
+	struct inode *root, *d0, *d1, *d2, *sub, *file, *file2;
+	struct inode *dirs[5];
+	int ndirs = 0;
+
+	root = inode_lookup(BENCH_ROOT_INUMBER);
+	d0 = inode_lookup(BENCH_DIR_INUM(0));
+	d1 = inode_lookup(BENCH_DIR_INUM(1 % bench_ndirs));
+	d2 = inode_lookup(BENCH_DIR_INUM(2 % bench_ndirs));
+	dirs[ndirs++] = root;
+	dirs[ndirs++] = d0;
+	dirs[ndirs++] = d1;
+	dirs[ndirs++] = d2;
+
+	bench_check_error("create file", inode_create_file(d0, "new",
+	    NULL, 0, 0644, 1, &file, &created));
+	bench_check_error("create directory",
+	    inode_create_dir(d1, "sub", NULL, 0755));
+	sub = bench_lookup("create directory", d1, "sub");
+	dirs[ndirs++] = sub;
+	bench_check_error("create file in directory", inode_create_file(sub,
+	    "f", NULL, 0, 0644, 1, &file2, &created));
+	bench_verify_usage("create", dirs, ndirs);
+
+	inode_set_size(file, 10000);
+	inode_set_size(file2, 5000);
+	bench_verify_usage("grow", dirs, ndirs);
+
+	bench_check_error("add replica",
+	    inode_add_replica(file, bench_host(0), 1));
+	if (bench_nhosts > 1)
+		bench_check_error("add replica",
+		    inode_add_replica(file, bench_host(1), 1));
+	bench_check_error("add replica",
+	    inode_add_replica(file2, bench_host(0), 1));
+	bench_verify_usage("add replicas", dirs, ndirs);
+
+	bench_check_error("rename file", inode_rename(d0, "new", sub, "moved",
+	    NULL, NULL, NULL, &dummy, &dummy));
+	bench_verify_usage("rename file", dirs, ndirs);
+
+	bench_check_error("rename directory", inode_rename(d1, "sub",
+	    d2, "sub2", NULL, NULL, NULL, &dummy, &dummy));
+	bench_verify_usage("rename directory", dirs, ndirs);
+
+	bench_check_error("remove replica", inode_remove_replica_metadata(
+	    file, bench_host(0), inode_get_gen(file)));
+	bench_verify_usage("remove replica", dirs, ndirs);
+
+	bench_check_error("unlink",
+	    inode_unlink(sub, "moved", NULL, NULL, &dummy));
+	bench_check_error("unlink",
+	    inode_unlink(sub, "f", NULL, NULL, &dummy));
+	bench_verify_usage("unlink", dirs, ndirs);
+}
+
+static double
+bench_time(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec * .000001);
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "Usage: %s [-f <files per directory>] "
+	    "[-h <hosts>] [-n <inodes>]\n"
+	    "\t[-p <check threads>] [-r <replicas per file>] "
+	    "[-t <target bytes per inode>]\n",
+	    program_name);
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char **argv)
+{
+	gfarm_error_t e;
+	int c;
+	double target = 0, t0, t1, t2, t3, bytes_per_inode;
+	struct db_ops bench_ops;
+	struct inode *root;
+	struct rusage ru;
+	gfarm_uint64_t nslots, table_bytes, inode_bytes, ncopies, copy_bytes;
+
+	/* XXX: settings in gfmd.conf doesn't work in this case */
+	char *config = getenv("GFARM_CONFIG_FILE");
+
+	debug_mode = 1;
+	e = gfarm_server_initialize(config, &argc, &argv);
+	if (e != GFARM_ERR_NO_ERROR) {
+		fprintf(stderr, "%s: gfarm_server_initialize: %s\n",
+		    program_name, gfarm_error_string(e));
+		exit(EXIT_FAILURE);
+	}
+	gflog_set_priority_level(LOG_WARNING);
+
+	while ((c = getopt(argc, argv, "f:h:n:p:r:t:")) != -1) {
+		switch (c) {
+		case 'f':
+			bench_fanout = atoi(optarg);
+			break;
+		case 'h':
+			bench_nhosts = atoi(optarg);
+			break;
+		case 'n':
+			bench_ninodes = strtoull(optarg, NULL, 0);
+			break;
+		case 'p':
+			gfarm_metadb_check_parallel = atoi(optarg);
+			break;
+		case 'r':
+			bench_nreplicas = atoi(optarg);
+			break;
+		case 't':
+			target = atof(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (bench_fanout <= 0 || bench_nhosts <= 0 || bench_nreplicas < 0 ||
+	    bench_nreplicas > bench_nhosts || bench_ninodes < 3)
+		usage();
+	bench_ndirs = (bench_ninodes - 1 + bench_fanout) / (bench_fanout + 1);
+	bench_nfiles = bench_ninodes - 1 - bench_ndirs;
+
+	bench_ops = empty_ops;
+	bench_ops.host_load = bench_host_load;
+	bench_ops.inode_load = bench_inode_load;
+	bench_ops.direntry_load = bench_direntry_load;
+	bench_ops.filecopy_load = bench_filecopy_load;
+
+	gfarm_set_metadb_replication_enabled(0);
+	db_use(&bench_ops);
+	giant_init();
+	e = db_initialize();
+	if (e != GFARM_ERR_NO_ERROR) {
+		fprintf(stderr, "%s: db_initialize: %s\n",
+		    program_name, gfarm_error_string(e));
+		exit(EXIT_FAILURE);
+	}
+	e = create_detached_thread(db_thread, NULL);
+	if (e != GFARM_ERR_NO_ERROR) {
+		fprintf(stderr, "%s: create_detached_thread(db_thread): %s\n",
+		    program_name, gfarm_error_string(e));
+		exit(EXIT_FAILURE);
+	}
+
+	mdhost_init();
+	host_init();
+	user_init();
+	group_init();
+
+	t0 = bench_time();
+	inode_init();
+	dir_entry_init();
+	file_copy_init();
+	symlink_init();
+	xattr_init();
+	t1 = bench_time();
+	inode_check_and_repair(1);
+	t2 = bench_time();
+	inode_usage_check();
+	inode_startup_done();
+	t3 = bench_time();
+
+	/* the namespace is consistent, nothing should be repaired */
+	root = inode_lookup(BENCH_ROOT_INUMBER);
+	if (root == NULL || inode_get_nlink(root) != 2 + bench_ndirs ||
+	    inode_total_num() != bench_ninodes) {
+		fprintf(stderr, "%s: the namespace is modified by the check\n",
+		    program_name);
+		exit(EXIT_FAILURE);
+	}
+	bench_check_usage("root", root, bench_ndirs, bench_nfiles);
+	bench_check_usage("d0", inode_lookup(BENCH_DIR_INUM(0)), 0,
+	    (bench_nfiles + bench_ndirs - 1) / bench_ndirs);
+
+	inode_memory_usage(&nslots, &table_bytes, &inode_bytes);
+	file_copy_memory_usage(&ncopies, &copy_bytes);
+	bytes_per_inode = (double)(table_bytes + inode_bytes + copy_bytes) /
+	    inode_total_num();
+	printf("%-20s %llu\n", "inodes",
+	    (unsigned long long)inode_total_num());
+	printf("%-20s %llu\n", "directories",
+	    (unsigned long long)bench_ndirs + 1);
+	printf("%-20s %llu\n", "file_copies", (unsigned long long)ncopies);
+	printf("%-20s %.3f\n", "load_seconds", t1 - t0);
+	printf("%-20s %.3f\n", "check_seconds", t2 - t1);
+	printf("%-20s %d\n", "check_threads", gfarm_metadb_check_parallel);
+	printf("%-20s %.3f\n", "usage_check_seconds", t3 - t2);
+	printf("%-20s %llu\n", "inode_table_bytes",
+	    (unsigned long long)table_bytes);
+	printf("%-20s %llu\n", "inode_bytes", (unsigned long long)inode_bytes);
+	printf("%-20s %llu\n", "file_copy_bytes",
+	    (unsigned long long)copy_bytes);
+	printf("%-20s %.1f\n", "bytes_per_inode", bytes_per_inode);
+	if (getrusage(RUSAGE_SELF, &ru) == 0) /* ru_maxrss is KiB on Linux */
+		printf("%-20s %.1f\n", "maxrss_per_inode",
+		    ru.ru_maxrss * 1024.0 / inode_total_num());
+
+	/* removed replicas are moved to dead file copies */
+	dead_file_copy_init(1);
+	bench_modify_namespace();
+
+	if (target > 0 && bytes_per_inode > target) {
+		fprintf(stderr, "%s: %.1f bytes per inode exceeds %.1f\n",
+		    program_name, bytes_per_inode, target);
+		exit(EXIT_FAILURE);
+	}
+	return (EXIT_SUCCESS);
+}
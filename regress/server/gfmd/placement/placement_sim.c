@@ -0,0 +1,437 @@
+/*
+ * replay a host status trace, place replicas by replica_placement policies,
+ * and report the placement skew.
+ *
+ * trace format (one host status per line):
+ *	tick hostname disk_avail(KiB) loadavg_1min ncpu fsngroup
+ * fsngroup "-" means that the host doesn't belong to any fsngroup.
+ *
+ * $Id$
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfutil.h"
+
+#include "config.h"
+
+#include "replica_placement.h"
+
+#define MAX_HOSTS	1024
+#define MAX_RECORDS	65536
+
+static char *program_name = "placement_sim";
+
+struct sim_host {
+	char *name, *fsngroup;
+	int ncpu;
+
+	/* reported status */
+	gfarm_uint64_t disk_avail; /* KiB, before the replicas placed */
+	double loadavg;
+
+	gfarm_uint64_t placed_size; /* KiB */
+	int inflight, *finish_ticks; /* finish ticks of inflight replications */
+	int nplaced, nplaced_busy, nplaced_low, peak_inflight;
+};
+
+struct sim_record {
+	int tick, host;
+	gfarm_uint64_t disk_avail;
+	double loadavg;
+};
+
+static struct sim_host hosts[MAX_HOSTS];
+static int nhosts = 0;
+static struct sim_record records[MAX_RECORDS];
+static int nrecords = 0;
+
+/* simulation parameters */
+static int files_per_tick = 5;
+static int replicas_per_file = 2;
+static gfarm_uint64_t replica_size = 1024 * 1024; /* KiB */
+static gfarm_uint64_t minfree = 128 * 1024; /* KiB */
+static int replication_ticks = 2;
+
+struct sim_result {
+	const char *policy;
+	int nplaced, nfailed, nsame_fsngroup, nfiles;
+	int nbusy, nlow, nfull, peak_inflight;
+	double max_per_mean;
+};
+
+static int
+host_lookup_or_add(const char *name, const char *fsngroup, int ncpu)
+{
+	int i;
+
+	for (i = 0; i < nhosts; i++) {
+		if (strcmp(hosts[i].name, name) == 0)
+			return (i);
+	}
+	if (nhosts >= MAX_HOSTS) {
+		fprintf(stderr, "%s: too many hosts\n", program_name);
+		exit(EXIT_FAILURE);
+	}
+	hosts[nhosts].name = strdup(name);
+	hosts[nhosts].fsngroup = strdup(strcmp(fsngroup, "-") == 0 ?
+	    "" : fsngroup);
+	hosts[nhosts].ncpu = ncpu > 0 ? ncpu : 1;
+	if (hosts[nhosts].name == NULL || hosts[nhosts].fsngroup == NULL) {
+		fprintf(stderr, "%s: no memory\n", program_name);
+		exit(EXIT_FAILURE);
+	}
+	return (nhosts++);
+}
+
+static void
+trace_read(const char *file)
+{
+	FILE *fp;
+	char line[1024], name[256], fsngroup[256];
+	int tick, ncpu, lineno = 0;
+	unsigned long long avail;
+	double loadavg;
+
+	if ((fp = fopen(file, "r")) == NULL) {
+		perror(file);
+		exit(EXIT_FAILURE);
+	}
+	while (fgets(line, sizeof line, fp) != NULL) {
+		lineno++;
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+		if (sscanf(line, "%d %255s %llu %lf %d %255s",
+		    &tick, name, &avail, &loadavg, &ncpu, fsngroup) != 6) {
+			fprintf(stderr, "%s: %s, line %d: syntax error\n",
+			    program_name, file, lineno);
+			exit(EXIT_FAILURE);
+		}
+		if (nrecords >= MAX_RECORDS) {
+			fprintf(stderr, "%s: too many records\n",
+			    program_name);
+			exit(EXIT_FAILURE);
+		}
+		if (nrecords > 0 && tick < records[nrecords - 1].tick) {
+			fprintf(stderr, "%s: %s, line %d: tick goes back\n",
+			    program_name, file, lineno);
+			exit(EXIT_FAILURE);
+		}
+		records[nrecords].tick = tick;
+		records[nrecords].host =
+		    host_lookup_or_add(name, fsngroup, ncpu);
+		records[nrecords].disk_avail = avail;
+		records[nrecords].loadavg = loadavg;
+		nrecords++;
+	}
+	fclose(fp);
+	if (nrecords == 0) {
+		fprintf(stderr, "%s: %s: empty trace\n", program_name, file);
+		exit(EXIT_FAILURE);
+	}
+}
+
+static gfarm_uint64_t
+host_disk_avail(struct sim_host *h)
+{
+	return (h->disk_avail > h->placed_size ?
+	    h->disk_avail - h->placed_size : 0);
+}
+
+static int
+cmp_uint64(const void *a, const void *b)
+{
+	const gfarm_uint64_t *x = a, *y = b;
+
+	return (*x < *y ? -1 : *x > *y ? 1 : 0);
+}
+
+static void
+host_finish_replications(struct sim_host *h, int tick)
+{
+	int i;
+
+	for (i = 0; i < h->inflight; ) {
+		if (h->finish_ticks[i] <= tick)
+			h->finish_ticks[i] = h->finish_ticks[--h->inflight];
+		else
+			i++;
+	}
+}
+
+static void
+simulate(enum gfarm_replica_placement policy, struct sim_result *res)
+{
+	int i, j, r, f, tick, last_tick, interval, ncands, max_inflight;
+	int *cands, *chosen, fsngroup_shared;
+	gfarm_uint64_t *avails, low;
+	struct replica_placement_load *loads;
+	struct sim_host *h;
+
+	max_inflight = files_per_tick * replicas_per_file *
+	    replication_ticks * 8 + 1;
+	for (i = 0; i < nhosts; i++) {
+		h = &hosts[i];
+		h->disk_avail = 0;
+		h->loadavg = 0;
+		h->placed_size = 0;
+		h->inflight = 0;
+		h->nplaced = h->nplaced_busy = h->nplaced_low = 0;
+		h->peak_inflight = 0;
+		GFARM_MALLOC_ARRAY(h->finish_ticks, max_inflight);
+		if (h->finish_ticks == NULL) {
+			fprintf(stderr, "%s: no memory\n", program_name);
+			exit(EXIT_FAILURE);
+		}
+	}
+	GFARM_MALLOC_ARRAY(cands, nhosts);
+	GFARM_MALLOC_ARRAY(chosen, replicas_per_file);
+	GFARM_MALLOC_ARRAY(avails, nhosts);
+	GFARM_MALLOC_ARRAY(loads, nhosts);
+	if (cands == NULL || chosen == NULL || avails == NULL ||
+	    loads == NULL) {
+		fprintf(stderr, "%s: no memory\n", program_name);
+		exit(EXIT_FAILURE);
+	}
+	memset(res, 0, sizeof(*res));
+	res->policy = gfarm_replica_placement_get_by_name();
+
+	/* replay one more interval of the status reports after the last */
+	interval = 1;
+	for (i = 1; i < nrecords; i++) {
+		if (records[i].tick > records[0].tick) {
+			interval = records[i].tick - records[0].tick;
+			break;
+		}
+	}
+	last_tick = records[nrecords - 1].tick + interval - 1;
+	for (tick = records[0].tick, r = 0; tick <= last_tick; tick++) {
+		for (; r < nrecords && records[r].tick <= tick; r++) {
+			h = &hosts[records[r].host];
+			h->disk_avail = records[r].disk_avail;
+			h->loadavg = records[r].loadavg;
+		}
+		for (i = 0; i < nhosts; i++)
+			host_finish_replications(&hosts[i], tick);
+		for (f = 0; f < files_per_tick; f++) {
+			/* same filter as host_is_disk_available() */
+			ncands = 0;
+			for (i = 0; i < nhosts; i++) {
+				h = &hosts[i];
+				if (host_disk_avail(h) < minfree + replica_size)
+					continue;
+				avails[ncands] = host_disk_avail(h);
+				cands[ncands] = i;
+				loads[ncands].disk_avail =
+				    host_disk_avail(h) - minfree;
+				loads[ncands].loadavg = h->loadavg / h->ncpu;
+				loads[ncands].inflight = h->inflight;
+				loads[ncands].fsngroup = h->fsngroup;
+				loads[ncands].fsngroup_replicas = 0;
+				ncands++;
+			}
+			res->nfiles++;
+			if (ncands <= replicas_per_file) {
+				res->nfailed += replicas_per_file;
+				continue;
+			}
+			qsort(avails, ncands, sizeof(*avails), cmp_uint64);
+			low = avails[ncands / 2] / 4;
+
+			if (replica_placement_select(policy, ncands, loads,
+			    replicas_per_file, chosen) != GFARM_ERR_NO_ERROR) {
+				fprintf(stderr, "%s: no memory\n",
+				    program_name);
+				exit(EXIT_FAILURE);
+			}
+			fsngroup_shared = 0;
+			for (i = 0; i < replicas_per_file; i++) {
+				h = &hosts[cands[chosen[i]]];
+				if (host_disk_avail(h) < low) {
+					h->nplaced_low++;
+					res->nlow++;
+				}
+				if (h->loadavg >= h->ncpu) {
+					h->nplaced_busy++;
+					res->nbusy++;
+				}
+				if (h->inflight < max_inflight)
+					h->finish_ticks[h->inflight++] = tick +
+					    (int)(replication_ticks *
+					    (1.0 + h->loadavg / h->ncpu) + 0.5);
+				if (h->peak_inflight < h->inflight)
+					h->peak_inflight = h->inflight;
+				h->placed_size += replica_size;
+				h->nplaced++;
+				res->nplaced++;
+				for (j = 0; j < i; j++) {
+					if (h->fsngroup[0] != '\0' &&
+					    strcmp(h->fsngroup, hosts[
+					    cands[chosen[j]]].fsngroup) == 0)
+						fsngroup_shared = 1;
+				}
+			}
+			res->nsame_fsngroup += fsngroup_shared;
+		}
+	}
+
+	for (i = 0; i < nhosts; i++) {
+		h = &hosts[i];
+		if (res->max_per_mean < h->nplaced)
+			res->max_per_mean = h->nplaced;
+		if (res->peak_inflight < h->peak_inflight)
+			res->peak_inflight = h->peak_inflight;
+		if (host_disk_avail(h) < minfree + replica_size)
+			res->nfull++;
+		free(h->finish_ticks);
+	}
+	if (res->nplaced > 0)
+		res->max_per_mean /= (double)res->nplaced / nhosts;
+	free(cands);
+	free(chosen);
+	free(avails);
+	free(loads);
+}
+
+static void
+print_hosts(void)
+{
+	int i;
+	struct sim_host *h;
+
+	printf("%-16s %-8s %8s %6s %6s %8s %10s\n", "host", "fsngroup",
+	    "placed", "busy", "low", "inflight", "avail(GiB)");
+	for (i = 0; i < nhosts; i++) {
+		h = &hosts[i];
+		printf("%-16s %-8s %8d %6d %6d %8d %10.1f\n", h->name,
+		    h->fsngroup[0] != '\0' ? h->fsngroup : "-", h->nplaced,
+		    h->nplaced_busy, h->nplaced_low, h->peak_inflight,
+		    host_disk_avail(h) / 1024.0 / 1024.0);
+	}
+}
+
+static void
+print_result_header(void)
+{
+	printf("%-12s %7s %6s %9s %6s %6s %6s %5s %8s\n", "policy",
+	    "placed", "failed", "max/mean", "busy%", "low%", "group%",
+	    "full", "inflight");
+}
+
+static void
+print_result(struct sim_result *res)
+{
+	double placed = res->nplaced > 0 ? res->nplaced : 1;
+	double files = res->nfiles > 0 ? res->nfiles : 1;
+
+	printf("%-12s %7d %6d %9.2f %6.1f %6.1f %6.1f %5d %8d\n",
+	    res->policy, res->nplaced, res->nfailed, res->max_per_mean,
+	    100.0 * res->nbusy / placed, 100.0 * res->nlow / placed,
+	    100.0 * res->nsame_fsngroup / files, res->nfull,
+	    res->peak_inflight);
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "Usage: %s [-cv] [-p policy] [-f files_per_tick] "
+	    "[-n replicas_per_file]\n\t[-s replica_size_KiB] "
+	    "[-m minimum_free_KiB] [-t replication_ticks] trace\n",
+	    program_name);
+	exit(EXIT_FAILURE);
+}
+
+/*
+ * with -c, all policies are simulated, and exits with failure,
+ * unless "weighted" and "two_choices" place less replicas than "random"
+ * to busy hosts, to hosts with low free space, and to a same fsngroup.
+ */
+int
+main(int argc, char **argv)
+{
+	int c, i, check = 0, verbose = 0, ok = 1;
+	const char *policy_name = NULL;
+	static const enum gfarm_replica_placement policies[] = {
+		GFARM_REPLICA_PLACEMENT_RANDOM,
+		GFARM_REPLICA_PLACEMENT_WEIGHTED,
+		GFARM_REPLICA_PLACEMENT_TWO_CHOICES,
+	};
+	struct sim_result results[GFARM_ARRAY_LENGTH(policies)];
+
+	while ((c = getopt(argc, argv, "cf:m:n:p:s:t:v")) != -1) {
+		switch (c) {
+		case 'c':
+			check = 1;
+			break;
+		case 'f':
+			files_per_tick = atoi(optarg);
+			break;
+		case 'm':
+			minfree = strtoull(optarg, NULL, 0);
+			break;
+		case 'n':
+			replicas_per_file = atoi(optarg);
+			break;
+		case 'p':
+			policy_name = optarg;
+			break;
+		case 's':
+			replica_size = strtoull(optarg, NULL, 0);
+			break;
+		case 't':
+			replication_ticks = atoi(optarg);
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc != 1 || files_per_tick <= 0 || replicas_per_file <= 0 ||
+	    replication_ticks <= 0)
+		usage();
+	trace_read(argv[0]);
+
+	print_result_header();
+	if (policy_name != NULL) {
+		if (gfarm_replica_placement_set_by_name(policy_name) !=
+		    GFARM_ERR_NO_ERROR) {
+			fprintf(stderr, "%s: unknown policy %s\n",
+			    program_name, policy_name);
+			exit(EXIT_FAILURE);
+		}
+		simulate(gfarm_replica_placement_get(), &results[0]);
+		print_result(&results[0]);
+		if (verbose)
+			print_hosts();
+		return (EXIT_SUCCESS);
+	}
+	for (i = 0; i < GFARM_ARRAY_LENGTH(policies); i++) {
+		gfarm_replica_placement_set(policies[i]);
+		simulate(policies[i], &results[i]);
+		print_result(&results[i]);
+		if (verbose)
+			print_hosts();
+	}
+	if (!check)
+		return (EXIT_SUCCESS);
+	for (i = 1; i < GFARM_ARRAY_LENGTH(policies); i++) {
+		if (results[i].nbusy >= results[0].nbusy ||
+		    results[i].nlow >= results[0].nlow ||
+		    results[i].nsame_fsngroup >= results[0].nsame_fsngroup) {
+			fprintf(stderr, "%s: %s is not better than %s\n",
+			    program_name, results[i].policy,
+			    results[0].policy);
+			ok = 0;
+		}
+	}
+	return (ok ? EXIT_SUCCESS : EXIT_FAILURE);
+}
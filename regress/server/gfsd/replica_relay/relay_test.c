@@ -0,0 +1,185 @@
+/*
+ * check that a reader of a relayed replica sees the failure of the writer,
+ * even after the slot of the writer is reused by another replication.
+ * if the reader sees an error, the relaying gfsd fails, and
+ * gfs_replicate_chain_to() falls back to the replication from the source.
+ *
+ * the writer and the reader are run in this process, and the hoststat
+ * slot is replaced by dummy definitions.
+ *
+ * $Id$
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <gfarm/gfarm.h>
+
+#include "config.h"
+
+#include "gfsd_subr.h"
+
+#define NSLOTS		2
+#define DATA_SIZE	1000
+#define GEN		1
+
+static int slot_index = 0;
+
+/* dummy definitions to link successfully without hoststat.o */
+int gfsd_hoststat_nslots(void) { return (NSLOTS); }
+int gfsd_hoststat_slot_index(void) { return (slot_index); }
+
+static char *program_name = "relay_test";
+
+static int errors = 0;
+static char data[DATA_SIZE];
+
+static void
+error(const char *format, ...)
+{
+	va_list ap;
+
+	va_start(ap, format);
+	fprintf(stderr, "%s: ", program_name);
+	vfprintf(stderr, format, ap);
+	fprintf(stderr, "\n");
+	va_end(ap);
+	errors++;
+}
+
+/* the writer receives the whole replica, but the result is `e' */
+static void
+write_replica(int fd, gfarm_ino_t ino, gfarm_error_t e)
+{
+	gfsd_replica_relay_begin(ino, GEN);
+	if (pwrite(fd, data, DATA_SIZE, 0) != DATA_SIZE) {
+		fprintf(stderr, "%s: pwrite: %s\n",
+		    program_name, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	gfsd_replica_relay_end(e);
+}
+
+static void
+attach(const char *diag, gfarm_ino_t ino)
+{
+	gfarm_error_t e = gfsd_replica_relay_attach(ino, GEN);
+
+	if (e != GFARM_ERR_NO_ERROR)
+		error("%s: attach: %s", diag, gfarm_error_string(e));
+}
+
+/* the reader reads the replica, and expects the whole data or EIO */
+static void
+expect_read(const char *diag, int fd, int expect_success)
+{
+	char buffer[DATA_SIZE * 2];
+	ssize_t rv;
+
+	rv = gfsd_replica_relay_read(fd, buffer, sizeof(buffer), 0);
+	if (expect_success) {
+		if (rv != DATA_SIZE)
+			error("%s: read %lld bytes (%s), %d expected", diag,
+			    (long long)rv, rv == -1 ? strerror(errno) : "",
+			    DATA_SIZE);
+		else if (memcmp(buffer, data, DATA_SIZE) != 0)
+			error("%s: data mismatch", diag);
+	} else if (rv != -1 || errno != EIO) {
+		error("%s: read returns %lld (%s), EIO expected", diag,
+		    (long long)rv, rv == -1 ? strerror(errno) : "no error");
+	}
+	gfsd_replica_relay_detach();
+}
+
+int
+main(int argc, char **argv)
+{
+	gfarm_error_t e;
+	char path[] = "/tmp/relay_test.XXXXXX";
+	int fd, i, status;
+	pid_t pid;
+	char *config = getenv("GFARM_CONFIG_FILE");
+
+	e = gfarm_server_initialize(config, &argc, &argv);
+	if (e != GFARM_ERR_NO_ERROR) {
+		fprintf(stderr, "%s: gfarm_server_initialize: %s\n",
+		    program_name, gfarm_error_string(e));
+		exit(EXIT_FAILURE);
+	}
+	if ((fd = mkstemp(path)) == -1) {
+		fprintf(stderr, "%s: mkstemp: %s\n",
+		    program_name, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	unlink(path);
+	for (i = 0; i < DATA_SIZE; i++)
+		data[i] = i;
+
+	gfsd_replica_relay_init();
+
+	/* the writer has finished, or failed */
+	write_replica(fd, 1, GFARM_ERR_NO_ERROR);
+	attach("done", 1);
+	expect_read("done", fd, 1);
+
+	write_replica(fd, 2, GFARM_ERR_INPUT_OUTPUT);
+	if (gfsd_replica_relay_attach(2, GEN) != GFARM_ERR_INPUT_OUTPUT)
+		error("failed: attach doesn't fail");
+	gfsd_replica_relay_detach();
+
+	/* the writer fails after the reader attaches */
+	gfsd_replica_relay_begin(3, GEN);
+	attach("failing", 3);
+	gfsd_replica_relay_end(GFARM_ERR_CONNECTION_ABORTED);
+	expect_read("failing", fd, 0);
+
+	/* the slot is reused after the writer fails */
+	gfsd_replica_relay_begin(4, GEN);
+	attach("reused after failure", 4);
+	gfsd_replica_relay_end(GFARM_ERR_CONNECTION_ABORTED);
+	write_replica(fd, 5, GFARM_ERR_NO_ERROR);
+	expect_read("reused after failure", fd, 0);
+
+	/* the slot is reused after the writer succeeds */
+	gfsd_replica_relay_begin(6, GEN);
+	attach("reused after success", 6);
+	if (pwrite(fd, data, DATA_SIZE, 0) != DATA_SIZE)
+		error("pwrite: %s", strerror(errno));
+	gfsd_replica_relay_end(GFARM_ERR_NO_ERROR);
+	write_replica(fd, 7, GFARM_ERR_INPUT_OUTPUT);
+	expect_read("reused after success", fd, 1);
+
+	/* the writer dies, and the slot is reused */
+	slot_index = 1;
+	if ((pid = fork()) == -1) {
+		fprintf(stderr, "%s: fork: %s\n",
+		    program_name, strerror(errno));
+		exit(EXIT_FAILURE);
+	} else if (pid == 0) {
+		gfsd_replica_relay_begin(8, GEN);
+		_exit(0);
+	}
+	if (waitpid(pid, &status, 0) == -1) {
+		fprintf(stderr, "%s: waitpid: %s\n",
+		    program_name, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	attach("died", 8);
+	expect_read("died", fd, 0);
+	attach("reused after death", 8);
+	write_replica(fd, 9, GFARM_ERR_NO_ERROR);
+	expect_read("reused after death", fd, 0);
+
+	close(fd);
+	if (errors > 0)
+		return (EXIT_FAILURE);
+	printf("ok\n");
+	return (EXIT_SUCCESS);
+}
@@ -215,6 +215,8 @@ gfs_client_status_result(void *p, void *arg, size_t size)
 	    size, diag, "fffll",
 	    &st.loadavg_1min, &st.loadavg_5min, &st.loadavg_15min,
 	    &st.disk_used, &st.disk_avail);
+	st.nclients = st.queue_depth = 0;
+	st.read_rate = st.write_rate = 0;
 	netsendq_remove_entry(abstract_host_get_sendq(qe->qentry.abhost),
 	    &qe->qentry, e);
 
@@ -228,6 +230,40 @@ gfs_client_status_result(void *p, void *arg, size_t size)
 	return (e);
 }
 
+static gfarm_int32_t
+gfs_client_status2_result(void *p, void *arg, size_t size)
+{
+	gfarm_error_t e;
+	struct peer *peer = p;
+	struct gfs_client_status_entry *qe = arg;
+	struct host *host = abstract_host_to_host(qe->qentry.abhost);
+	unsigned char buf[GFM_PROTO_HOST_STATUS_SIZE_MAX];
+	size_t len;
+	gfarm_int32_t mask;
+	struct gfm_host_status st;
+	static const char diag[] = "GFS_PROTO_STATUS2";
+
+	e = gfs_client_recv_result(peer, host,
+	    size, diag, "b", sizeof(buf), &len, buf);
+	if (e == GFARM_ERR_NO_ERROR) {
+		e = gfm_proto_host_status_decode(buf, len, &mask, &st);
+		if (e == GFARM_ERR_NO_ERROR &&
+		    mask != GFM_PROTO_HOST_STATUS_ALL)
+			e = GFARM_ERR_PROTOCOL;
+	}
+	netsendq_remove_entry(abstract_host_get_sendq(qe->qentry.abhost),
+	    &qe->qentry, e);
+
+	if (e == GFARM_ERR_NO_ERROR) {
+		host_status_report(host, mask, &st);
+	} else {
+		/* this gfsd is not working correctly, thus, disconnect it */
+		gfs_client_status_disconnect_or_message(host, peer,
+		    diag, "result", gfarm_error_string(e));
+	}
+	return (e);
+}
+
 /* both giant_lock and peer_table_lock are held before calling this function */
 static void
 gfs_client_status_free(void *p, void *arg)
@@ -252,9 +288,15 @@ gfs_client_status_request(void *arg)
 	struct peer *peer = host_get_peer(host); /* increment refcount */
 	static const char diag[] = "GFS_PROTO_STATUS";
 
-	e = gfs_client_send_request(host, peer, diag,
-	    gfs_client_status_result, gfs_client_status_free, qe,
-	    GFS_PROTO_STATUS, "");
+	/* since GFS_PROTO_STATUS2, gfsd pushes the changes of its status */
+	if (host_supports_status2(host))
+		e = gfs_client_send_request(host, peer, diag,
+		    gfs_client_status2_result, gfs_client_status_free, qe,
+		    GFS_PROTO_STATUS2, "");
+	else
+		e = gfs_client_send_request(host, peer, diag,
+		    gfs_client_status_result, gfs_client_status_free, qe,
+		    GFS_PROTO_STATUS, "");
 	netsendq_entry_was_sent(abstract_host_get_sendq(qe->qentry.abhost),
 	    &qe->qentry);
 
@@ -450,6 +492,34 @@ gfm_async_server_reply_to_gfsd_schedule(struct host *host,
 
 #endif /* not_def_REPLY_QUEUE */
 
+static gfarm_error_t
+gfm_async_server_host_status_report(struct host *host,
+	struct peer *peer, gfp_xdr_xid_t xid, size_t size)
+{
+	gfarm_error_t e;
+	unsigned char buf[GFM_PROTO_HOST_STATUS_SIZE_MAX];
+	size_t len;
+	gfarm_int32_t mask;
+	struct gfm_host_status st;
+	static const char diag[] = "GFM_PROTO_HOST_STATUS_REPORT";
+
+	e = gfm_async_server_get_request(peer, size, diag, "b",
+	    sizeof(buf), &len, buf);
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_error(GFARM_MSG_UNFIXED, "%s: %s: %s",
+		    diag, host_name(host), gfarm_error_string(e));
+		return (e);
+	}
+	e = gfm_proto_host_status_decode(buf, len, &mask, &st);
+	if (e != GFARM_ERR_NO_ERROR)
+		gflog_warning(GFARM_MSG_UNFIXED, "%s: %s: %s",
+		    diag, host_name(host), gfarm_error_string(e));
+	else
+		host_status_report(host, mask, &st);
+
+	return (gfm_async_server_put_reply(host, peer, xid, diag, e, ""));
+}
+
 /*
  * Back channel protocol switch for master gfmd.
  */
@@ -465,6 +535,9 @@ async_back_channel_protocol_switch_master(struct abstract_host *h,
 	case GFM_PROTO_REPLICATION_RESULT:
 		e = gfm_async_server_replication_result(host, peer, xid, size);
 		break;
+	case GFM_PROTO_HOST_STATUS_REPORT:
+		e = gfm_async_server_host_status_report(host, peer, xid, size);
+		break;
 	default:
 		*unknown_request = 1;
 		e = GFARM_ERR_PROTOCOL;
@@ -765,6 +838,8 @@ gfm_server_switch_back_channel_common(
 	if (is_direct_connection) {
 		local_peer = peer_to_local_peer(peer);
 		local_peer_set_async(local_peer, async); /* XXXRELAY */
+		gfp_xdr_set_profile(peer_get_conn(peer),
+		    GFP_XDR_PROFILE_BACK_CHANNEL);
 		local_peer_set_readable_watcher(local_peer,
 		    back_channel_recv_watcher);
 	}
@@ -1,5 +1,4 @@
 #include <pthread.h>
-#include <sys/time.h>
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
@@ -14,6 +13,34 @@
 #include "subr.h"
 #include "thrpool.h"
 
+/*
+ * Pending callouts are kept in a hierarchical timing wheel
+ * (G. Varghese and T. Lauck, "Hashed and Hierarchical Timing Wheels"),
+ * so that callout_schedule() and callout_stop() take O(1) time
+ * regardless of the number of pending callouts.
+ *
+ * The level 0 wheel has a slot for each tick, and a slot of the level N
+ * wheel covers a whole turn of the level N-1 wheel.  When the level 0
+ * wheel makes a turn, callouts in the current slot of the upper level
+ * are redistributed into the lower levels.
+ */
+#define CALLOUT_TICK_MICROSEC	1000
+#define CALLOUT_WHEEL_LEVELS	5
+#define CALLOUT_WHEEL0_BITS	8
+#define CALLOUT_WHEELN_BITS	6
+#define CALLOUT_WHEEL0_SIZE	(1 << CALLOUT_WHEEL0_BITS)
+#define CALLOUT_WHEELN_SIZE	(1 << CALLOUT_WHEELN_BITS)
+#define CALLOUT_WHEEL0_MASK	(CALLOUT_WHEEL0_SIZE - 1)
+#define CALLOUT_WHEELN_MASK	(CALLOUT_WHEELN_SIZE - 1)
+#define CALLOUT_WHEEL_SHIFT(level) \
+	(CALLOUT_WHEEL0_BITS + CALLOUT_WHEELN_BITS * ((level) - 1))
+/* ticks covered by the whole wheel, about 49 days */
+#define CALLOUT_WHEEL_RANGE \
+	((gfarm_uint64_t)1 << CALLOUT_WHEEL_SHIFT(CALLOUT_WHEEL_LEVELS))
+
+#define CALLOUT_LEVEL_EXPIRED	(-1)
+#define CALLOUT_TICK_NONE	(~(gfarm_uint64_t)0)
+
 struct callout {
 	struct callout *prev, *next;
 
@@ -22,35 +49,267 @@ struct callout {
 #define CALLOUT_INVOKING	4
 	int state;
 
-	struct timespec target_time;
+	int level; /* valid only if CALLOUT_PENDING */
+	gfarm_uint64_t target_tick;
 
 	struct thread_pool *thrpool;
 	void *(*func)(void *);
 	void *closure;
 };
 
+/* a callout_main() thread waiting for have_things_to_run */
+struct callout_sleeper {
+	gfarm_uint64_t wakeup_tick;	/* CALLOUT_TICK_NONE, if no timeout */
+	struct callout_sleeper *next;
+};
+
 struct callout_module {
 	pthread_mutex_t mutex;
 	pthread_cond_t have_things_to_run;
 
-	/* dummy head of doubly linked circular list */
-	struct callout pendings;
+	struct timespec epoch;		/* the time of the tick 0 */
+	gfarm_uint64_t current_tick;	/* ticks before this are processed */
+
+	/*
+	 * the earliest wakeup_tick of the sleepers, 0 if nobody sleeps.
+	 * a thread which is dispatching will check the wheel by itself.
+	 */
+	gfarm_uint64_t wakeup_tick;
+	struct callout_sleeper *sleepers;
+	int npendings[CALLOUT_WHEEL_LEVELS];
+
+	/* dummy heads of doubly linked circular lists */
+	struct callout expired;
+	struct callout wheel0[CALLOUT_WHEEL0_SIZE];
+	struct callout wheel[CALLOUT_WHEEL_LEVELS - 1][CALLOUT_WHEELN_SIZE];
 } callout_module;
 
 static const char module_name[] = "callout_module";
 
-int
-timespec_cmp(const struct timespec *t1, const struct timespec *t2)
+static void
+callout_list_init(struct callout *head)
+{
+	head->prev = head;
+	head->next = head;
+}
+
+static void
+callout_list_remove(struct callout *c)
+{
+	c->prev->next = c->next;
+	c->next->prev = c->prev;
+	/* clear the pointers to be sure */
+	c->next = c;
+	c->prev = c;
+}
+
+static void
+callout_list_append(struct callout *head, struct callout *c)
+{
+	c->prev = head->prev;
+	c->next = head;
+	head->prev->next = c;
+	head->prev = c;
+}
+
+static gfarm_uint64_t
+callout_tick(struct callout_module *cm, const struct timespec *t)
+{
+	gfarm_int64_t usec;
+
+	usec = (gfarm_int64_t)(t->tv_sec - cm->epoch.tv_sec) *
+	    GFARM_SECOND_BY_MICROSEC +
+	    (t->tv_nsec - cm->epoch.tv_nsec) / GFARM_MICROSEC_BY_NANOSEC;
+	return (usec <= 0 ? 0 : usec / CALLOUT_TICK_MICROSEC);
+}
+
+static void
+callout_tick_to_time(struct callout_module *cm, gfarm_uint64_t tick,
+	struct timespec *t)
+{
+	gfarm_uint64_t usec = tick * CALLOUT_TICK_MICROSEC;
+
+	t->tv_sec = cm->epoch.tv_sec + usec / GFARM_SECOND_BY_MICROSEC;
+	t->tv_nsec = cm->epoch.tv_nsec +
+	    (usec % GFARM_SECOND_BY_MICROSEC) * GFARM_MICROSEC_BY_NANOSEC;
+	if (t->tv_nsec >= GFARM_SECOND_BY_NANOSEC) {
+		t->tv_sec++;
+		t->tv_nsec -= GFARM_SECOND_BY_NANOSEC;
+	}
+}
+
+/* PREREQUISITE: cm->mutex */
+static void
+callout_wheel_add(struct callout_module *cm, struct callout *c)
+{
+	gfarm_uint64_t tick, delta;
+	int level, shift;
+
+	if (c->target_tick < cm->current_tick) /* already expired */
+		c->target_tick = cm->current_tick;
+	tick = c->target_tick;
+	delta = tick - cm->current_tick;
+	if (delta < CALLOUT_WHEEL0_SIZE) {
+		c->level = 0;
+		callout_list_append(&cm->wheel0[tick & CALLOUT_WHEEL0_MASK], c);
+	} else {
+		if (delta >= CALLOUT_WHEEL_RANGE) {
+			/* will be redistributed again */
+			tick = cm->current_tick + CALLOUT_WHEEL_RANGE - 1;
+		}
+		for (level = 1; level < CALLOUT_WHEEL_LEVELS - 1; level++) {
+			if (delta < ((gfarm_uint64_t)1 <<
+			    CALLOUT_WHEEL_SHIFT(level + 1)))
+				break;
+		}
+		shift = CALLOUT_WHEEL_SHIFT(level);
+		c->level = level;
+		callout_list_append(&cm->wheel[level - 1]
+		    [(tick >> shift) & CALLOUT_WHEELN_MASK], c);
+	}
+	cm->npendings[c->level]++;
+}
+
+/* PREREQUISITE: cm->mutex */
+static void
+callout_wheel_remove(struct callout_module *cm, struct callout *c)
+{
+	if (c->level != CALLOUT_LEVEL_EXPIRED)
+		cm->npendings[c->level]--;
+	callout_list_remove(c);
+}
+
+/*
+ * redistribute the callouts in the current slot of the level,
+ * and returns the index of the slot.
+ */
+static int
+callout_wheel_cascade(struct callout_module *cm, int level)
+{
+	int i = (cm->current_tick >> CALLOUT_WHEEL_SHIFT(level)) &
+	    CALLOUT_WHEELN_MASK;
+	struct callout *head = &cm->wheel[level - 1][i], *c;
+
+	while ((c = head->next) != head) {
+		callout_wheel_remove(cm, c);
+		callout_wheel_add(cm, c);
+	}
+	return (i);
+}
+
+static int
+callout_wheel_is_empty(struct callout_module *cm)
 {
-	if (t1->tv_sec > t2->tv_sec)
-		return (1);
-	if (t1->tv_sec < t2->tv_sec)
-		return (-1);
-	if (t1->tv_nsec > t2->tv_nsec)
-		return (1);
-	if (t1->tv_nsec < t2->tv_nsec)
-		return (-1);
-	return (0);
+	int level;
+
+	for (level = 0; level < CALLOUT_WHEEL_LEVELS; level++) {
+		if (cm->npendings[level] > 0)
+			return (0);
+	}
+	return (1);
+}
+
+/* move the callouts which expire by the tick to cm->expired */
+static void
+callout_wheel_advance(struct callout_module *cm, gfarm_uint64_t tick)
+{
+	struct callout *head, *c;
+	gfarm_uint64_t next;
+	int level;
+
+	while (cm->current_tick <= tick) {
+		if (callout_wheel_is_empty(cm)) {
+			cm->current_tick = tick + 1;
+			break;
+		}
+		if ((cm->current_tick & CALLOUT_WHEEL0_MASK) == 0) {
+			for (level = 1; level < CALLOUT_WHEEL_LEVELS; level++) {
+				if (callout_wheel_cascade(cm, level) != 0)
+					break;
+			}
+		}
+		head = &cm->wheel0[cm->current_tick & CALLOUT_WHEEL0_MASK];
+		while ((c = head->next) != head) {
+			callout_wheel_remove(cm, c);
+			c->level = CALLOUT_LEVEL_EXPIRED;
+			callout_list_append(&cm->expired, c);
+		}
+		cm->current_tick++;
+
+		if (cm->npendings[0] == 0) {
+			/* nothing to do until the next turn of the level 0 */
+			next = (cm->current_tick + CALLOUT_WHEEL0_MASK) &
+			    ~(gfarm_uint64_t)CALLOUT_WHEEL0_MASK;
+			cm->current_tick = next <= tick ? next : tick + 1;
+		}
+	}
+}
+
+/* returns the tick when callout_wheel_advance() has something to do */
+static gfarm_uint64_t
+callout_wheel_next_tick(struct callout_module *cm)
+{
+	gfarm_uint64_t tick, base, next = CALLOUT_TICK_NONE;
+	int level, shift, i;
+
+	if (cm->npendings[0] > 0) {
+		for (tick = cm->current_tick;
+		    tick < cm->current_tick + CALLOUT_WHEEL0_SIZE; tick++) {
+			if (cm->wheel0[tick & CALLOUT_WHEEL0_MASK].next !=
+			    &cm->wheel0[tick & CALLOUT_WHEEL0_MASK])
+				return (tick);
+		}
+	}
+	for (level = 1; level < CALLOUT_WHEEL_LEVELS; level++) {
+		if (cm->npendings[level] == 0)
+			continue;
+		shift = CALLOUT_WHEEL_SHIFT(level);
+		base = cm->current_tick >> shift;
+		/* i == 0 and i == CALLOUT_WHEELN_SIZE are the same slot */
+		for (i = 0; i <= CALLOUT_WHEELN_SIZE; i++) {
+			tick = (base + i) << shift;
+			if (tick < cm->current_tick)
+				continue;
+			if (cm->wheel[level - 1][(base + i) &
+			    CALLOUT_WHEELN_MASK].next !=
+			    &cm->wheel[level - 1][(base + i) &
+			    CALLOUT_WHEELN_MASK]) {
+				if (next > tick)
+					next = tick;
+				break;
+			}
+		}
+	}
+	return (next);
+}
+
+static void
+callout_sleeper_add(struct callout_module *cm, struct callout_sleeper *sl,
+	gfarm_uint64_t wakeup_tick)
+{
+	sl->wakeup_tick = wakeup_tick;
+	sl->next = cm->sleepers;
+	cm->sleepers = sl;
+	if (cm->wakeup_tick == 0 || cm->wakeup_tick > wakeup_tick)
+		cm->wakeup_tick = wakeup_tick;
+}
+
+static void
+callout_sleeper_remove(struct callout_module *cm, struct callout_sleeper *sl)
+{
+	struct callout_sleeper **slp;
+
+	cm->wakeup_tick = 0;
+	for (slp = &cm->sleepers; *slp != NULL; ) {
+		if (*slp == sl) {
+			*slp = sl->next;
+			continue;
+		}
+		if (cm->wakeup_tick == 0 ||
+		    cm->wakeup_tick > (*slp)->wakeup_tick)
+			cm->wakeup_tick = (*slp)->wakeup_tick;
+		slp = &(*slp)->next;
+	}
 }
 
 void *
@@ -62,46 +321,54 @@ callout_main(void *arg)
 	void *(*func)(void *);
 	void *closure;
 	int rv;
-	struct timespec now;
+	struct timespec now, target_time;
+	struct callout_sleeper self;
 
-#ifdef __GNUC__ /* shut up stupid warning by gcc */
-	thrpool = NULL;
-	closure = NULL;
-#endif
 	for (;;) {
 		gfarm_mutex_lock(&cm->mutex, module_name, "main lock");
-		c = cm->pendings.next;
-		if (c == &cm->pendings)
-			rv = pthread_cond_wait(&cm->have_things_to_run,
-			    &cm->mutex);
-		else
-			rv = pthread_cond_timedwait(&cm->have_things_to_run,
-			    &cm->mutex, &c->target_time);
-		if (rv != 0 && rv != ETIMEDOUT) {
-			gflog_fatal(GFARM_MSG_1001490, "s: %s cond wait: %s",
-			    module_name, strerror(rv));
-		}
-
-		func = NULL;
-
-		/* cm->pendings may be changed while cond_wait */
-		c = cm->pendings.next;
-		if (c != &cm->pendings) {
+		for (;;) {
 			gfarm_gettime(&now);
-			if (timespec_cmp(&c->target_time, &now) <= 0) {
-				/* remove the head of the list */
-				c->prev->next = c->next;
-				c->next->prev = c->prev;
-				/* clear the pointers to be sure */
-				c->next = c;
-				c->prev = c;
-				c->state &= ~CALLOUT_PENDING;
-				c->state |= (CALLOUT_FIRED | CALLOUT_INVOKING);
-				thrpool = c->thrpool;
-				func = c->func;
-				closure = c->closure;
+			callout_wheel_advance(cm, callout_tick(cm, &now));
+			if (cm->expired.next != &cm->expired)
+				break;
+
+			callout_sleeper_add(cm, &self,
+			    callout_wheel_next_tick(cm));
+			if (self.wakeup_tick == CALLOUT_TICK_NONE) {
+				rv = pthread_cond_wait(&cm->have_things_to_run,
+				    &cm->mutex);
+			} else {
+				callout_tick_to_time(cm, self.wakeup_tick,
+				    &target_time);
+				rv = pthread_cond_timedwait(
+				    &cm->have_things_to_run,
+				    &cm->mutex, &target_time);
+			}
+			if (rv != 0 && rv != ETIMEDOUT) {
+				gflog_fatal(GFARM_MSG_1001490,
+				    "s: %s cond wait: %s",
+				    module_name, strerror(rv));
 			}
+			/*
+			 * let callout_schedule_common() wake another thread
+			 * for an earlier callout, while this one is busy
+			 */
+			callout_sleeper_remove(cm, &self);
 		}
+
+		/* remove the head of the expired list */
+		c = cm->expired.next;
+		callout_list_remove(c);
+		c->state &= ~CALLOUT_PENDING;
+		c->state |= (CALLOUT_FIRED | CALLOUT_INVOKING);
+		thrpool = c->thrpool;
+		func = c->func;
+		closure = c->closure;
+
+		/* let another thread dispatch the rest in parallel */
+		if (cm->expired.next != &cm->expired)
+			gfarm_cond_signal(&cm->have_things_to_run,
+			    module_name, "dispatching signal");
 		gfarm_mutex_unlock(&cm->mutex, module_name, "main lock");
 
 		if (func != NULL) {
@@ -123,12 +390,23 @@ callout_module_init(int nthreads)
 {
 	gfarm_error_t e;
 	struct callout_module *cm = &callout_module;
-	int i;
+	int i, j;
 
 	gfarm_mutex_init(&cm->mutex, module_name, "init");
 	gfarm_cond_init(&cm->have_things_to_run, module_name, "init");
-	cm->pendings.prev = &cm->pendings;
-	cm->pendings.next = &cm->pendings;
+	gfarm_gettime(&cm->epoch);
+	cm->current_tick = 0;
+	cm->wakeup_tick = 0;
+	cm->sleepers = NULL;
+	callout_list_init(&cm->expired);
+	for (i = 0; i < CALLOUT_WHEEL0_SIZE; i++)
+		callout_list_init(&cm->wheel0[i]);
+	for (i = 0; i < CALLOUT_WHEEL_LEVELS - 1; i++) {
+		for (j = 0; j < CALLOUT_WHEELN_SIZE; j++)
+			callout_list_init(&cm->wheel[i][j]);
+	}
+	for (i = 0; i < CALLOUT_WHEEL_LEVELS; i++)
+		cm->npendings[i] = 0;
 
 	for (i = 0; i < nthreads; i++) {
 		e = create_detached_thread(callout_main, &callout_module);
@@ -172,42 +450,24 @@ static void
 callout_schedule_common(struct callout *n, int microseconds)
 {
 	struct callout_module *cm = &callout_module;
-	struct callout *c;
-	struct timeval now;
+	struct timespec now;
 
 	/* callout_module.mutex must be already locked here */
 
-	gettimeofday(&now, NULL);
-	gfarm_timeval_add_microsec(&now, microseconds);
-	n->target_time.tv_sec = now.tv_sec;
-	n->target_time.tv_nsec = now.tv_usec * GFARM_MICROSEC_BY_NANOSEC;
+	gfarm_gettime(&now);
 	n->state &= ~(CALLOUT_FIRED | CALLOUT_INVOKING);
 
-	if ((n->state & CALLOUT_PENDING) != 0) {
-		/* remove from the pending list */
-		n->prev->next = n->next;
-		n->next->prev = n->prev;
-	}
+	if ((n->state & CALLOUT_PENDING) != 0)
+		callout_wheel_remove(cm, n);
 
-	/*
-	 * Since currently all callouts are scheduled with same interval
-	 * (i.e. gfarm_metadb_heartbeat_interval), searching from the tail
-	 * is most efficient.
-	 * XXX If we use another interval for something, this implementation
-	 * should be changed to use buckets for efficiency.
-	 */
-	for (c = cm->pendings.prev; c != &cm->pendings;
-	     c = c->prev) {
-		if (timespec_cmp(&n->target_time, &c->target_time) >= 0)
-			break;
-	}
-	/* insert n as the successor of c */
-	n->prev = c;
-	n->next = c->next;
-	c->next->prev = n;
-	c->next = n;
+	/* round up, not to be called earlier than requested */
+	n->target_tick = callout_tick(cm, &now) + 1 +
+	    (microseconds <= 0 ? 0 :
+	     (microseconds + CALLOUT_TICK_MICROSEC - 1) /
+	     CALLOUT_TICK_MICROSEC);
+	callout_wheel_add(cm, n);
 	n->state |= CALLOUT_PENDING;
-	if (n->prev == &cm->pendings)
+	if (n->target_tick < cm->wakeup_tick)
 		gfarm_cond_signal(&cm->have_things_to_run, module_name,
 		    "scheduling singal");
 }
@@ -258,14 +518,8 @@ callout_stop(struct callout *c)
 	int expired;
 
 	gfarm_mutex_lock(&cm->mutex, module_name, "stop lock");
-	if ((c->state & CALLOUT_PENDING) != 0) {
-		/* remove the head of the list */
-		c->prev->next = c->next;
-		c->next->prev = c->prev;
-		/* clear the pointers to be sure */
-		c->next = c;
-		c->prev = c;
-	}
+	if ((c->state & CALLOUT_PENDING) != 0)
+		callout_wheel_remove(cm, c);
 	expired = (c->state & CALLOUT_FIRED) != 0;
 	c->state &= ~(CALLOUT_PENDING | CALLOUT_FIRED);
 	gfarm_mutex_unlock(&cm->mutex, module_name, "stop unlock");
@@ -17,6 +17,7 @@
 
 #include "gfutil.h"
 #include "thrsubr.h"
+#include "timer.h"
 
 #include "gfp_xdr.h"
 #include "config.h"
@@ -31,6 +32,7 @@
 #include "db_ops.h"
 #include "db_journal.h"
 #include "db_journal_apply.h"
+#include "rpc_stat.h"
 
 #define ALIGNMENT 8
 #define ALIGN(offset)	(((offset) + ALIGNMENT - 1) & ~(ALIGNMENT - 1))
@@ -143,6 +145,7 @@ dbq_enter0(struct dbq *q, dbq_entry_func_t func, void *data, int with_seqnum)
 	gfarm_error_t e;
 	static const char diag[] = "dbq_enter";
 	struct dbq_entry *ent;
+	gfarm_timerval_t t1, t2;
 
 	assert(!gfarm_get_metadb_replication_enabled() || with_seqnum == 0);
 
@@ -157,9 +160,14 @@ dbq_enter0(struct dbq *q, dbq_entry_func_t func, void *data, int with_seqnum)
 		gfarm_cond_signal(&q->nonempty, diag, "nonempty");
 	} else {
 		e = GFARM_ERR_NO_ERROR;
-		while (q->n >= gfarm_metadb_dbq_size) {
-			gfarm_cond_wait(&q->nonfull, &q->mutex,
-			    diag, "nonfull");
+		if (q->n >= gfarm_metadb_dbq_size) {
+			gfarm_gettimerval(&t1);
+			while (q->n >= gfarm_metadb_dbq_size) {
+				gfarm_cond_wait(&q->nonfull, &q->mutex,
+				    diag, "nonfull");
+			}
+			gfarm_gettimerval(&t2);
+			rpc_stat_dbq_waited(gfarm_timerval_sub(&t2, &t1));
 		}
 		ent = &q->entries[q->in];
 		ent->func = func;
@@ -393,6 +401,16 @@ db_initialize(void)
 		return ((*ops->initialize)());
 }
 
+/*
+ * whether gfmd was shut down cleanly last time is recorded
+ * in the SeqNum table, as the value of DB_SEQNUM_CLEAN_SHUTDOWN_NAME.
+ */
+#define DB_SEQNUM_CLEAN_SHUTDOWN_NAME	"gfmd_clean_shutdown"
+
+static int db_clean_shutdown_loaded = 0; /* db_clean_shutdown_get() done */
+static int db_clean_shutdown_recorded = 0; /* exists in the SeqNum table */
+static gfarm_error_t db_clean_shutdown_store(int);
+
 gfarm_error_t
 db_terminate(void)
 {
@@ -403,6 +421,9 @@ db_terminate(void)
 	dbq_wait_to_finish(&dbq);
 	gflog_info(GFARM_MSG_1000407, "terminating the database");
 	gfarm_mutex_lock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
+	/* all updates have been stored, see db_clean_shutdown_get() */
+	if (db_clean_shutdown_loaded)
+		(void)db_clean_shutdown_store(1);
 	e = ops->terminate();
 	gfarm_mutex_unlock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
 	return (e);
@@ -1854,6 +1875,69 @@ db_seqnum_load(void *closure,
 	return (e);
 }
 
+static void
+db_clean_shutdown_load_callback(void *closure, struct db_seqnum_arg *a)
+{
+	int *cleanp = closure;
+
+	if (a->name != NULL &&
+	    strcmp(a->name, DB_SEQNUM_CLEAN_SHUTDOWN_NAME) == 0) {
+		*cleanp = a->value != 0;
+		db_clean_shutdown_recorded = 1;
+	}
+	free(a->name);
+}
+
+/* db_access_mutex must be locked */
+static gfarm_error_t
+db_clean_shutdown_store(int clean)
+{
+	gfarm_error_t e;
+	struct db_seqnum_arg a;
+
+	if (ops->seqnum_add == NULL || ops->seqnum_modify == NULL)
+		return (GFARM_ERR_OPERATION_NOT_SUPPORTED);
+	a.name = DB_SEQNUM_CLEAN_SHUTDOWN_NAME;
+	a.value = clean;
+	if (db_clean_shutdown_recorded)
+		e = ops->seqnum_modify(&a);
+	else if ((e = ops->seqnum_add(&a)) == GFARM_ERR_NO_ERROR)
+		db_clean_shutdown_recorded = 1;
+	if (e != GFARM_ERR_NO_ERROR &&
+	    e != GFARM_ERR_OPERATION_NOT_SUPPORTED)
+		gflog_warning(GFARM_MSG_UNFIXED,
+		    "cannot record the %s shutdown state: %s",
+		    clean ? "clean" : "unclean", gfarm_error_string(e));
+	return (e);
+}
+
+/*
+ * this returns whether gfmd was shut down cleanly last time,
+ * and records that gfmd is running, until db_terminate() is called.
+ * this must be called after boot_apply_db_journal().
+ */
+int
+db_clean_shutdown_get(void)
+{
+	gfarm_error_t e;
+	int clean = 0;
+	static const char diag[] = "db_clean_shutdown_get";
+
+	gfarm_mutex_lock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
+	if (ops->seqnum_load == NULL)
+		e = GFARM_ERR_OPERATION_NOT_SUPPORTED;
+	else
+		e = (*ops->seqnum_load)(&clean,
+		    db_clean_shutdown_load_callback);
+	if (e == GFARM_ERR_NO_ERROR) {
+		db_clean_shutdown_loaded = 1;
+		e = db_clean_shutdown_store(0);
+	}
+	gfarm_mutex_unlock(&db_access_mutex, diag, DB_ACCESS_MUTEX_DIAG);
+	/* unknown, if it cannot be recorded that gfmd is running */
+	return (e == GFARM_ERR_NO_ERROR && clean);
+}
+
 void *
 db_mdhost_dup(const struct gfarm_metadb_server *ms, size_t size)
 {
@@ -119,6 +119,7 @@ gfarm_error_t db_seqnum_modify(char *, gfarm_uint64_t);
 gfarm_error_t db_seqnum_remove(char *);
 gfarm_error_t db_seqnum_load(void *,
 	void (*)(void *, struct db_seqnum_arg *));
+int db_clean_shutdown_get(void);
 pthread_mutex_t *get_db_access_mutex(void);
 
 struct gfarm_metadb_server;
@@ -37,6 +37,9 @@ struct dead_file_copy {
 
 	int is_kept; /* on dfc_keptq?: protected by giant lock */
 
+	/* the batch which this is removed by, if not kept */
+	struct dead_file_copy_batch *batch;
+
 	GFARM_HCIRCLEQ_ENTRY(dead_file_copy) same_inode_copies;
 };
 
@@ -53,6 +56,72 @@ struct dfc_keptq {
 /* IMPORTANT NOTE: functions should not sleep while holding dfc_keptq.mutex */
 static struct dfc_keptq dfc_keptq;
 
+/*
+ * obsolete replicas on a same host are removed by a batch.
+ * a batch is queued to netsendq when its first entry is added,
+ * and further entries are added to the batch until it's sent,
+ * thus a batch grows while the request window to the host is full.
+ */
+struct dead_file_copy_batch {
+	struct netsendq_entry qentry; /* must be first member */
+
+	/* protected by dfc_batch_mutex until the batch is sent */
+	int n;
+	struct dead_file_copy **dfcs;
+
+	/* replies not received yet, if GFS_PROTO_FHREMOVE is used */
+	int pending; /* protected by dfc_batch_mutex */
+
+	char *buffer; /* encoded request and reply of GFS_PROTO_FHREMOVE_MULTI */
+};
+
+/* IMPORTANT NOTE: functions should not sleep while holding this mutex */
+static pthread_mutex_t dfc_batch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static const char dfc_batch_diag[] = "dfc_batch";
+
+static int dfc_batch_size;
+
+/* statistics of the removal, protected by giant_lock */
+#define DFC_STAT_INTERVAL	600 /* seconds */
+static struct dfc_stat {
+	gfarm_uint64_t backlog; /* replicas scheduled to be removed */
+	gfarm_uint64_t removed;
+	gfarm_uint64_t removed_at_report;
+	time_t report_time;
+} dfc_stat;
+
+static struct dead_file_copy_batch *
+dead_file_copy_batch_alloc(struct abstract_host *abhost)
+{
+	struct dead_file_copy_batch *b;
+
+	GFARM_MALLOC(b);
+	if (b == NULL)
+		return (NULL);
+	GFARM_MALLOC_ARRAY(b->dfcs, dfc_batch_size);
+	b->buffer = malloc(dfc_batch_size * GFS_PROTO_FHREMOVE_MULTI_ENTRY_SIZE);
+	if (b->dfcs == NULL || b->buffer == NULL) {
+		free(b->dfcs);
+		free(b->buffer);
+		free(b);
+		return (NULL);
+	}
+	netsendq_entry_init(&b->qentry, &gfs_proto_fhremove_queue);
+	b->qentry.abhost = abhost;
+	b->n = 0;
+	b->pending = 0;
+	return (b);
+}
+
+static void
+dead_file_copy_batch_free(struct dead_file_copy_batch *b)
+{
+	netsendq_entry_destroy(&b->qentry);
+	free(b->dfcs);
+	free(b->buffer);
+	free(b);
+}
+
 /*
  * PREREQUISITE: giant_lock
  */
@@ -61,6 +130,8 @@ dead_file_copy_schedule_removal(struct dead_file_copy *dfc)
 {
 	struct netsendq *qhost =
 	    abstract_host_get_sendq(dfc->qentry.abhost);
+	struct dead_file_copy_batch **bp, *b = NULL;
+	int queued = 1;
 	static const char diag[] = "dead_file_copy_schedule_removal";
 
 	if (dfc->is_kept) {
@@ -69,49 +140,146 @@ dead_file_copy_schedule_removal(struct dead_file_copy *dfc)
 		GFARM_HCIRCLEQ_REMOVE(&dfc->qentry, workq_entries);
 		gfarm_mutex_unlock(&dfc_keptq.mutex, diag, "unlock");
 	}
+
+	/*
+	 * whether the gfsd supports GFS_PROTO_FHREMOVE_MULTI is unknown
+	 * until it connects, thus it's decided when the batch is sent.
+	 * see gfs_client_fhremove_request()
+	 */
+	gfarm_mutex_lock(&dfc_batch_mutex, diag, dfc_batch_diag);
+	bp = host_dead_file_copy_batch(
+	    abstract_host_to_host(dfc->qentry.abhost));
+	if (*bp == NULL || (*bp)->n >= dfc_batch_size) {
+		queued = 0;
+		*bp = dead_file_copy_batch_alloc(dfc->qentry.abhost);
+	}
+	if ((b = *bp) != NULL) {
+		b->dfcs[b->n++] = dfc;
+		dfc->batch = b;
+	}
+	gfarm_mutex_unlock(&dfc_batch_mutex, diag, dfc_batch_diag);
+
+	if (b == NULL) {
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "%s(%lld, %lld, %s): no memory, deferred", diag,
+		    (long long)dfc->inum, (long long)dfc->igen,
+		    abstract_host_get_name(dfc->qentry.abhost));
+		/* will be retried by dead_file_copy_host_becomes_up() */
+		dead_file_copy_mark_kept(dfc);
+		return;
+	}
+	dfc_stat.backlog++;
+
 	/* should success always, because of NETSENDQ_FLAG_QUEUEABLE_IF_DOWN */
-	(void)netsendq_add_entry(qhost, &dfc->qentry, 0);
+	if (!queued)
+		(void)netsendq_add_entry(qhost, &b->qentry, 0);
 }
 
 static void dead_file_copy_free(struct dead_file_copy *);
 
+/* PREREQUISITE: giant_lock */
+static void
+dead_file_copy_stat_report(void)
+{
+	time_t now = time(NULL);
+	gfarm_uint64_t removed;
+
+	if (dfc_stat.report_time == 0) {
+		dfc_stat.report_time = now;
+		return;
+	}
+	if (now < dfc_stat.report_time + DFC_STAT_INTERVAL)
+		return;
+	removed = dfc_stat.removed - dfc_stat.removed_at_report;
+	gflog_info(GFARM_MSG_UNFIXED,
+	    "dead file copy removal: backlog %llu, removed %llu "
+	    "in %ld seconds (%.1f/s)",
+	    (unsigned long long)dfc_stat.backlog,
+	    (unsigned long long)removed, (long)(now - dfc_stat.report_time),
+	    (double)removed / (now - dfc_stat.report_time));
+	dfc_stat.removed_at_report = dfc_stat.removed;
+	dfc_stat.report_time = now;
+}
+
 /*
- * PREREQUISITE: nothing
- * LOCKS: giant_lock
- *  -> (dbq.mutex, dfc_keptq.mutex, host_busyq.mutex, host::back_channel_mutex)
- * SLEEPS: yes (giant_lock, dbq.mutex)
- *	but dfc_keptq.mutex, host_busyq.mutex and host::back_channel_mutex
- *	won't be blocked while sleeping.
+ * PREREQUISITE: giant_lock
+ * LOCKS: dbq.mutex, dfc_keptq.mutex, dfc_batch_mutex
+ * SLEEPS: yes (dbq.mutex)
  */
 static void
-handle_removal_result(struct netsendq_entry *qentryp)
+handle_removal_result_of_entry(struct dead_file_copy *dfc, gfarm_error_t e,
+	int report_error)
 {
-	struct dead_file_copy *dfc = (struct dead_file_copy *)qentryp;
-	const char diag[] = "handle_removal_result";
+	static const char diag[] = "handle_removal_result_of_entry";
 
-	if (dfc->qentry.result == GFARM_ERR_NO_ERROR ||
-	    dfc->qentry.result == GFARM_ERR_NO_SUCH_FILE_OR_DIRECTORY ||
+	dfc_stat.backlog--;
+	if (e == GFARM_ERR_NO_ERROR ||
+	    e == GFARM_ERR_NO_SUCH_FILE_OR_DIRECTORY ||
 	    !abstract_host_is_valid(dfc->qentry.abhost, diag)) {
-		giant_lock(); /* necessary for dead_file_copy_free() */
+		dfc_stat.removed++;
 		dead_file_copy_free(dfc); /* sleeps to wait for dbq.mutex */
-		giant_unlock();
 	} else {
-		if (abstract_host_is_up(dfc->qentry.abhost) ||
-		    !IS_CONNECTION_ERROR(dfc->qentry.result)) {
+		if (report_error &&
+		    (abstract_host_is_up(dfc->qentry.abhost) ||
+		     !IS_CONNECTION_ERROR(e))) {
 			/* unexpected error */
 			gflog_error(GFARM_MSG_1002223,
 			    "retrying removal of (%lld, %lld, %s): %s",
 			    (long long)dfc->inum, (long long)dfc->igen,
 			    abstract_host_get_name(dfc->qentry.abhost),
-			    gfarm_error_string(dfc->qentry.result));
+			    gfarm_error_string(e));
 		}
 		/* try again later to avoid busy loop */
-		giant_lock();
 		dead_file_copy_schedule_removal(dfc);
-		giant_unlock();
 	}
 }
 
+/*
+ * PREREQUISITE: nothing
+ * LOCKS: giant_lock
+ *  -> (dbq.mutex, dfc_keptq.mutex, dfc_batch_mutex, host_busyq.mutex,
+ *	host::back_channel_mutex)
+ * SLEEPS: yes (giant_lock, dbq.mutex)
+ *	but dfc_keptq.mutex, dfc_batch_mutex, host_busyq.mutex and
+ *	host::back_channel_mutex won't be blocked while sleeping.
+ */
+static void
+handle_removal_result(struct netsendq_entry *qentryp)
+{
+	struct dead_file_copy_batch *b =
+	    (struct dead_file_copy_batch *)qentryp;
+	struct dead_file_copy_batch **bp;
+	gfarm_error_t e = b->qentry.result;
+	int i;
+	static const char diag[] = "handle_removal_result";
+
+	giant_lock(); /* necessary for dead_file_copy_free() */
+
+	/* the batch may be finalized without being sent, if host is removed */
+	gfarm_mutex_lock(&dfc_batch_mutex, diag, dfc_batch_diag);
+	bp = host_dead_file_copy_batch(abstract_host_to_host(b->qentry.abhost));
+	if (*bp == b)
+		*bp = NULL;
+	gfarm_mutex_unlock(&dfc_batch_mutex, diag, dfc_batch_diag);
+
+	if (e != GFARM_ERR_NO_ERROR &&
+	    abstract_host_is_valid(b->qentry.abhost, diag) &&
+	    (abstract_host_is_up(b->qentry.abhost) || !IS_CONNECTION_ERROR(e)))
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "retrying removal of %d replicas on %s: %s", b->n,
+		    abstract_host_get_name(b->qentry.abhost),
+		    gfarm_error_string(e));
+
+	for (i = 0; i < b->n; i++)
+		handle_removal_result_of_entry(b->dfcs[i],
+		    e != GFARM_ERR_NO_ERROR ? e : b->dfcs[i]->qentry.result,
+		    e == GFARM_ERR_NO_ERROR);
+	dead_file_copy_stat_report();
+	giant_unlock();
+
+	dead_file_copy_batch_free(b);
+}
+
 /*
  * FUNCTION:
  * check the policy whether it's ok to remove this obsolete replica or not.
@@ -420,10 +588,83 @@ dead_file_copy_get_host(struct dead_file_copy *dfc)
 }
 
 static void
-removal_finishedq_enqueue(struct dead_file_copy *dfc, gfarm_error_t e)
+removal_finishedq_enqueue(struct dead_file_copy_batch *b, gfarm_error_t e)
+{
+	netsendq_remove_entry(abstract_host_get_sendq(b->qentry.abhost),
+	    &b->qentry, e);
+}
+
+static void
+encode_uint64(unsigned char *p, gfarm_uint64_t v)
+{
+	int i;
+
+	for (i = sizeof(v) - 1; i >= 0; --i) {
+		p[i] = v & 0xff;
+		v >>= 8;
+	}
+}
+
+static gfarm_int32_t
+decode_int32(const unsigned char *p)
+{
+	return ((gfarm_int32_t)(((gfarm_uint32_t)p[0] << 24) |
+	    ((gfarm_uint32_t)p[1] << 16) | ((gfarm_uint32_t)p[2] << 8) | p[3]));
+}
+
+static gfarm_int32_t
+gfs_client_fhremove_multi_result(void *p, void *arg, size_t size)
+{
+	struct peer *peer = p;
+	struct dead_file_copy_batch *b = arg;
+	struct host *host = abstract_host_to_host(b->qentry.abhost);
+	size_t rsize = 0, expected = b->n * GFS_PROTO_FHREMOVE_MULTI_RESULT_SIZE;
+	gfarm_error_t e;
+	int i;
+	static const char diag[] = "GFS_PROTO_FHREMOVE_MULTI";
+
+	e = gfs_client_recv_result(peer, host, size, diag, "b",
+	    expected, &rsize, b->buffer);
+	if (e == GFARM_ERR_NO_ERROR && rsize != expected) {
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "%s: %s: %d results are expected, but %d",
+		    diag, host_name(host), b->n,
+		    (int)(rsize / GFS_PROTO_FHREMOVE_MULTI_RESULT_SIZE));
+		e = GFARM_ERR_PROTOCOL;
+	}
+	for (i = 0; e == GFARM_ERR_NO_ERROR && i < b->n; i++)
+		b->dfcs[i]->qentry.result = decode_int32((unsigned char *)
+		    b->buffer + i * GFS_PROTO_FHREMOVE_MULTI_RESULT_SIZE);
+	removal_finishedq_enqueue(b, e);
+	return (e);
+}
+
+/* both giant_lock and peer_table_lock are held before calling this function */
+static void
+gfs_client_fhremove_multi_free(void *p, void *arg)
 {
-	netsendq_remove_entry(abstract_host_get_sendq(dfc->qentry.abhost),
-	    &dfc->qentry, e);
+#if 0
+	struct peer *peer = p;
+#endif
+	struct dead_file_copy_batch *b = arg;
+
+	removal_finishedq_enqueue(b, GFARM_ERR_CONNECTION_ABORTED);
+}
+
+static void
+dead_file_copy_batch_done(struct dead_file_copy_batch *b, int n)
+{
+	int done;
+	static const char diag[] = "dead_file_copy_batch_done";
+
+	gfarm_mutex_lock(&dfc_batch_mutex, diag, dfc_batch_diag);
+	b->pending -= n;
+	done = b->pending == 0;
+	gfarm_mutex_unlock(&dfc_batch_mutex, diag, dfc_batch_diag);
+
+	/* results are stored in each dfc */
+	if (done)
+		removal_finishedq_enqueue(b, GFARM_ERR_NO_ERROR);
 }
 
 static gfarm_int32_t
@@ -436,7 +677,8 @@ gfs_client_fhremove_result(void *p, void *arg, size_t size)
 	static const char diag[] = "GFS_PROTO_FHREMOVE";
 
 	e = gfs_client_recv_result(peer, host, size, diag, "");
-	removal_finishedq_enqueue(dfc, e);
+	dfc->qentry.result = e;
+	dead_file_copy_batch_done(dfc->batch, 1);
 	return (e);
 }
 
@@ -449,36 +691,90 @@ gfs_client_fhremove_free(void *p, void *arg)
 #endif
 	struct dead_file_copy *dfc = arg;
 
-	removal_finishedq_enqueue(dfc, GFARM_ERR_CONNECTION_ABORTED);
+	dfc->qentry.result = GFARM_ERR_CONNECTION_ABORTED;
+	dead_file_copy_batch_done(dfc->batch, 1);
+}
+
+/* send a request per replica to gfsd which doesn't support the batch */
+static void
+gfs_client_fhremove_each(struct dead_file_copy_batch *b)
+{
+	struct host *host = abstract_host_to_host(b->qentry.abhost);
+	struct dead_file_copy *dfc;
+	gfarm_error_t e = GFARM_ERR_NO_ERROR;
+	int i, n = b->n;
+	static const char diag[] = "GFS_PROTO_FHREMOVE";
+
+	/* +1 prevents the batch from being finalized while sending */
+	b->pending = n + 1;
+	for (i = 0; i < n; i++) {
+		dfc = b->dfcs[i];
+		e = gfs_client_send_request(host, NULL, diag,
+		    gfs_client_fhremove_result, gfs_client_fhremove_free, dfc,
+		    GFS_PROTO_FHREMOVE, "ll", dfc->inum, dfc->igen);
+		if (e != GFARM_ERR_NO_ERROR)
+			break;
+	}
+	if (e == GFARM_ERR_DEVICE_BUSY) {
+		gflog_info(GFARM_MSG_1002284,
+		    "%s(%lld, %lld, %s): "
+		    "busy, shouldn't happen", diag,
+		    (long long)b->dfcs[i]->inum, (long long)b->dfcs[i]->igen,
+		    host_name(host));
+	}
+	/* the dfcs which weren't sent */
+	for (n = i; i < b->n; i++)
+		b->dfcs[i]->qentry.result = e;
+	netsendq_entry_was_sent(abstract_host_get_sendq(b->qentry.abhost),
+	    &b->qentry);
+	dead_file_copy_batch_done(b, b->n - n + 1);
 }
 
 static void *
 gfs_client_fhremove_request(void *closure)
 {
-	struct dead_file_copy *dfc = closure;
-	gfarm_ino_t ino = dead_file_copy_get_ino(dfc);
-	gfarm_int64_t gen = dead_file_copy_get_gen(dfc);
-	struct host *host = dead_file_copy_get_host(dfc);
+	struct dead_file_copy_batch *b = closure;
+	struct host *host = abstract_host_to_host(b->qentry.abhost);
+	struct dead_file_copy_batch **bp;
 	gfarm_error_t e;
-	static const char diag[] = "GFS_PROTO_FHREMOVE";
+	int i;
+	static const char diag[] = "GFS_PROTO_FHREMOVE_MULTI";
+
+	/* no more entries are added to this batch after this */
+	gfarm_mutex_lock(&dfc_batch_mutex, diag, dfc_batch_diag);
+	bp = host_dead_file_copy_batch(host);
+	if (*bp == b)
+		*bp = NULL;
+	gfarm_mutex_unlock(&dfc_batch_mutex, diag, dfc_batch_diag);
+
+	if (b->n == 1 || !host_supports_fhremove_multi(host)) {
+		gfs_client_fhremove_each(b);
+		return (NULL);
+	}
 
+	for (i = 0; i < b->n; i++) {
+		encode_uint64((unsigned char *)b->buffer +
+		    i * GFS_PROTO_FHREMOVE_MULTI_ENTRY_SIZE,
+		    b->dfcs[i]->inum);
+		encode_uint64((unsigned char *)b->buffer +
+		    i * GFS_PROTO_FHREMOVE_MULTI_ENTRY_SIZE +
+		    sizeof(gfarm_uint64_t), b->dfcs[i]->igen);
+	}
 	e = gfs_client_send_request(host, NULL, diag,
-	    gfs_client_fhremove_result, gfs_client_fhremove_free, dfc,
-	    GFS_PROTO_FHREMOVE, "ll", ino, gen);
-	netsendq_entry_was_sent(abstract_host_get_sendq(dfc->qentry.abhost),
-	    &dfc->qentry);
+	    gfs_client_fhremove_multi_result, gfs_client_fhremove_multi_free,
+	    b, GFS_PROTO_FHREMOVE_MULTI, "ib", (gfarm_int32_t)b->n,
+	    b->n * GFS_PROTO_FHREMOVE_MULTI_ENTRY_SIZE, b->buffer);
+	netsendq_entry_was_sent(abstract_host_get_sendq(b->qentry.abhost),
+	    &b->qentry);
 
 	if (e != GFARM_ERR_NO_ERROR) {
-		/* accessing dfc is only allowed if e != GFARM_ERR_NO_ERROR */
+		/* accessing b is only allowed if e != GFARM_ERR_NO_ERROR */
 		if (e == GFARM_ERR_DEVICE_BUSY) {
-			gflog_info(GFARM_MSG_1002284,
-			    "%s(%lld, %lld, %s): "
-			    "busy, shouldn't happen", diag,
-			    (long long)dead_file_copy_get_ino(dfc),
-			    (long long)dead_file_copy_get_gen(dfc),
-			    host_name(dead_file_copy_get_host(dfc)));
+			gflog_info(GFARM_MSG_UNFIXED,
+			    "%s(%d replicas, %s): busy, shouldn't happen",
+			    diag, b->n, host_name(host));
 		}
-		removal_finishedq_enqueue(dfc, e);
+		removal_finishedq_enqueue(b, e);
 	}
 
 	/* this return value won't be used, because this thread is detached */
@@ -517,6 +813,7 @@ dead_file_copy_alloc(gfarm_ino_t inum, gfarm_uint64_t igen, struct host *host)
 	dfc->inum = inum;
 	dfc->igen = igen;
 	dfc->is_kept = 0;
+	dfc->batch = NULL;
 
 	return (dfc);
 }
@@ -710,6 +1007,11 @@ dead_file_copy_init(int is_master)
 
 	gfs_proto_fhremove_queue.window_size =
 	    gfs_proto_fhremove_request_window;
+	dfc_batch_size = gfs_proto_fhremove_batch_size;
+	if (dfc_batch_size < 1)
+		dfc_batch_size = 1;
+	else if (dfc_batch_size > GFS_PROTO_FHREMOVE_MULTI_MAX)
+		dfc_batch_size = GFS_PROTO_FHREMOVE_MULTI_MAX;
 
 	gfarm_mutex_init(&dfc_keptq.mutex, diag, "dfc_keptq");
 	GFARM_HCIRCLEQ_INIT(dfc_keptq.q, workq_entries);
@@ -30,7 +30,12 @@ struct rbdir_entry {
 	struct inode *inode;
 };
 
-RB_HEAD(rbdir, rbdir_entry);
+/* RB_HEAD(rbdir, rbdir_entry), and the usage of the directory tree */
+struct rbdir {
+	struct rbdir_entry *rbh_root;
+
+	struct dir_usage usage;
+};
 
 static int
 rbdir_compare(DirEntry a, DirEntry b)
@@ -131,6 +136,7 @@ dir_alloc(void)
 		return (NULL);
 	}
 	RB_INIT(dir);
+	dir_usage_clear(dir);
 	return (dir);
 }
 
@@ -162,6 +168,22 @@ dir_get_entry_count(Dir dir)
 	return (root->nentries);
 }
 
+/* see inode_usage_check() in inode.c about the usage */
+struct dir_usage *
+dir_get_usage(Dir dir)
+{
+	return (&dir->usage);
+}
+
+void
+dir_usage_clear(Dir dir)
+{
+	dir->usage.space = 0;
+	dir->usage.num = 0;
+	dir->usage.phy_space = 0;
+	dir->usage.phy_num = 0;
+}
+
 DirEntry
 dir_enter(Dir dir, const char *name, int namelen, int *createdp)
 {
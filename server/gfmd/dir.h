@@ -19,10 +19,17 @@ typedef DirEntry DirCursor;
 
 struct inode;
 
+/* the total usage of the files and directories under the directory */
+struct dir_usage {
+	gfarm_int64_t space, num, phy_space, phy_num;
+};
+
 Dir dir_alloc(void);
 void dir_free(Dir);
 int dir_is_empty(Dir);
 gfarm_off_t dir_get_entry_count(Dir);
+struct dir_usage *dir_get_usage(Dir);
+void dir_usage_clear(Dir);
 
 DirEntry dir_enter(Dir, const char *, int, int *);
 DirEntry dir_lookup(Dir, const char *, int);
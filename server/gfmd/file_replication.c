@@ -3,6 +3,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <sys/time.h>
 
 #include <gfarm/gfarm.h>
 
@@ -54,6 +55,7 @@ struct file_replication {
 	struct dead_file_copy *cleanup;
 
 	int queued;
+	gfarm_off_t size; /* accounted by host_replication_add() */
 
 	gfarm_error_t src_errcode; /* qentry.result is dst_errcode */
 	gfarm_int64_t handle; /* pid of destination side worker */
@@ -67,6 +69,20 @@ struct inode_replication_state {
 
 static int outstanding_file_replications = 0;
 
+/*
+ * token bucket of replication_bandwidth_limit, which holds
+ * the budget for one second at most.
+ * user requests are always admitted, but consume the budget.
+ * automatic replication at close is admitted while the bucket is not empty,
+ * and replica_check is admitted while the bucket has more than
+ * (100 - replica_check_replication_ratio) percent of its capacity.
+ * i.e. lower priority replication gives way first.
+ *
+ * protected by giant_lock
+ */
+static double replication_budget = 0;
+static struct timeval replication_budget_time;
+
 struct host *
 file_replication_get_dst(struct file_replication *fr)
 {
@@ -103,8 +119,81 @@ file_replication_set_handle(struct file_replication *fr, gfarm_int64_t handle)
 	fr->handle = handle;
 }
 
+/* PREREQUISITE: giant_lock */
+static void
+replication_budget_refill(void)
+{
+	struct timeval now;
+	double capacity = gfarm_replication_bandwidth_limit;
+
+	gettimeofday(&now, NULL);
+	replication_budget += capacity *
+	    ((now.tv_sec - replication_budget_time.tv_sec) +
+	     (now.tv_usec - replication_budget_time.tv_usec) / 1000000.0);
+	if (replication_budget > capacity)
+		replication_budget = capacity;
+	replication_budget_time = now;
+}
+
+/*
+ * PREREQUISITE: giant_lock
+ * LOCKS: netsendq_workq::mutex
+ * SLEEPS: no
+ */
+static int
+file_replication_is_admitted(int priority, struct host *src, struct host *dst)
+{
+	int ratio = gfarm_replica_check_replication_ratio;
+	int src_window = gfarm_replication_source_window;
+	int dst_window = gfs_proto_replication_request_window;
+	double capacity = gfarm_replication_bandwidth_limit;
+
+	if (priority >= FILE_REPLICATION_PRIORITY_USER)
+		return (1);
+	if (priority <= FILE_REPLICATION_PRIORITY_REPLICA_CHECK) {
+		src_window = (src_window * ratio + 99) / 100;
+		dst_window = (dst_window * ratio + 99) / 100;
+		if (file_replication_inflight_number(dst) >= dst_window)
+			return (0);
+	}
+	if (src_window > 0 &&
+	    host_replication_source_number(src) >= src_window)
+		return (0);
+	if (capacity <= 0) /* unlimited */
+		return (1);
+	replication_budget_refill();
+	if (priority <= FILE_REPLICATION_PRIORITY_REPLICA_CHECK)
+		return (replication_budget > capacity * (100 - ratio) / 100);
+	return (replication_budget > 0);
+}
+
+/*
+ * choose the least loaded host from srcs[] as the source of a replication.
+ * *next_src_indexp rotates the choice among equally loaded hosts.
+ *
+ * PREREQUISITE: giant_lock
+ */
+struct host *
+file_replication_select_source(int n_srcs, struct host **srcs,
+	int *next_src_indexp)
+{
+	int i, j, best = 0;
+	gfarm_off_t load, best_load = 0;
+
+	for (i = 0; i < n_srcs; i++) {
+		j = (*next_src_indexp + i) % n_srcs;
+		load = host_replication_bytes(srcs[j]);
+		if (i == 0 || load < best_load) {
+			best = j;
+			best_load = load;
+		}
+	}
+	*next_src_indexp = (best + 1) % n_srcs;
+	return (srcs[best]);
+}
+
 gfarm_error_t
-file_replication_new(struct inode *inode, gfarm_uint64_t gen,
+file_replication_new(struct inode *inode, gfarm_uint64_t gen, int priority,
 	struct host *src, struct host *dst,
 	struct dead_file_copy *deferred_cleanup,
 	struct inode_replication_state **rstatep,
@@ -116,6 +205,8 @@ file_replication_new(struct inode *inode, gfarm_uint64_t gen,
 	if (outstanding_file_replications >=
 	    gfarm_outstanding_file_replication_limit)
 		return (GFARM_ERR_RESOURCE_TEMPORARILY_UNAVAILABLE);
+	if (!file_replication_is_admitted(priority, src, dst))
+		return (GFARM_ERR_RESOURCE_TEMPORARILY_UNAVAILABLE);
 
 	GFARM_MALLOC(fr);
 	if (fr == NULL)
@@ -140,11 +231,15 @@ file_replication_new(struct inode *inode, gfarm_uint64_t gen,
 	fr->src = src;
 	fr->cleanup = deferred_cleanup;
 	fr->queued = 0;
+	fr->size = inode_get_size(inode);
 	fr->handle = -1;
 	fr->filesize = -1;
 	fr->statewait = NULL;
 
 	++outstanding_file_replications;
+	host_replication_add(src, dst, 1, fr->size);
+	if (gfarm_replication_bandwidth_limit > 0)
+		replication_budget -= fr->size;
 
 	*frp = fr;
 	return (GFARM_ERR_NO_ERROR);
@@ -157,6 +252,8 @@ file_replication_free(struct file_replication *fr,
 	struct inode_replication_state *irs = *rstatep;
 
 	--outstanding_file_replications;
+	host_replication_add(fr->src, file_replication_get_dst(fr), -1,
+	    fr->size);
 
 	GFARM_HCIRCLEQ_REMOVE(fr, replications);
 	if (GFARM_HCIRCLEQ_EMPTY(irs->same_inode_list, replications)) {
@@ -177,6 +274,14 @@ file_replication_is_busy(struct host *dst)
 	    &gfs_proto_replication_request_queue));
 }
 
+int
+file_replication_inflight_number(struct host *dst)
+{
+	return (netsendq_inflight_number(
+	    abstract_host_get_sendq(host_to_abstract_host(dst)),
+	    &gfs_proto_replication_request_queue));
+}
+
 /*
  * PREREQUISITE: giant_lock
  * LOCKS: XXX
@@ -490,4 +595,5 @@ file_replication_init(void)
 {
 	gfs_proto_replication_request_queue.window_size =
 	    gfs_proto_replication_request_window;
+	gettimeofday(&replication_budget_time, NULL);
 }
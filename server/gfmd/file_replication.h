@@ -13,7 +13,13 @@ struct dead_file_copy *file_replication_get_dead_file_copy(
 
 gfarm_int64_t file_replication_get_handle(struct file_replication *);
 
+/* priority of gfmd-initiated replication, the higher is preferred */
+#define FILE_REPLICATION_PRIORITY_REPLICA_CHECK	0 /* repair */
+#define FILE_REPLICATION_PRIORITY_NCOPY		1 /* at close */
+#define FILE_REPLICATION_PRIORITY_USER		2 /* e.g. gfrep, replica update */
+
 int file_replication_is_busy(struct host *);
+int file_replication_inflight_number(struct host *);
 void file_replication_start(struct inode_replication_state *, gfarm_uint64_t);
 void file_replication_close_check(struct inode_replication_state **);
 
@@ -21,7 +27,8 @@ gfarm_error_t gfm_async_server_replication_result(struct host *,
 	struct peer *, gfp_xdr_xid_t, size_t);
 
 struct inode_replication_state;
-gfarm_error_t file_replication_new(struct inode *, gfarm_uint64_t,
+struct host *file_replication_select_source(int, struct host **, int *);
+gfarm_error_t file_replication_new(struct inode *, gfarm_uint64_t, int,
 	struct host *, struct host *, struct dead_file_copy *,
 	struct inode_replication_state **, struct file_replication **);
 void file_replication_free(struct file_replication *,
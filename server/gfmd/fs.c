@@ -1131,9 +1131,9 @@ inode_get_stat(struct inode *inode, struct gfs_stat *st)
 		st->st_ncopy = inode_get_ncopy(inode);
 	else
 		st->st_ncopy = 1;
-	st->st_atimespec = *inode_get_atime(inode);
-	st->st_mtimespec = *inode_get_mtime(inode);
-	st->st_ctimespec = *inode_get_ctime(inode);
+	st->st_atimespec = inode_get_atime(inode);
+	st->st_mtimespec = inode_get_mtime(inode);
+	st->st_ctimespec = inode_get_ctime(inode);
 	if (st->st_user == NULL || st->st_group == NULL) {
 		if (st->st_user != NULL)
 			free(st->st_user);
@@ -1826,6 +1826,7 @@ typedef struct {
 	 * Filled in initialization:
 	 */
 	int from_client;
+	int with_status;	/* GFM_PROTO_SCHEDULE_FILE_WITH_STATUS */
 
 	/*
 	 * Filled in request phase:
@@ -1844,9 +1845,10 @@ typedef struct {
 static void
 GFM_PROTO_SCHEDULE_FILE_context_initialize(
 	GFM_PROTO_SCHEDULE_FILE_context *cp,
-	int from_client)
+	int from_client, int with_status)
 {
 	cp->from_client = from_client;
+	cp->with_status = with_status;
 
 	cp->req_error = GFARM_ERR_UNKNOWN;
 	cp->domain = NULL;
@@ -2044,8 +2046,10 @@ GFM_PROTO_SCHEDULE_FILE_send_reply(
 
 		giant_lock();
 		for (i = 0; i < cp->nhosts; i++) {
-			ret = host_schedule_reply_arg_dynarg(cp->hosts[i],
-			    peer, sizep, diag);
+			ret = (cp->with_status ?
+			    host_schedule_reply_with_status_arg_dynarg :
+			    host_schedule_reply_arg_dynarg)(
+			    cp->hosts[i], peer, sizep, diag);
 			if (ret != GFARM_ERR_NO_ERROR) {
 				gflog_error(GFARM_MSG_UNFIXED,
 					"%s: %s failed: %s",
@@ -2068,19 +2072,20 @@ GFM_PROTO_SCHEDULE_FILE_send_reply(
 	return ret;
 }
 
-gfarm_error_t
-gfm_server_schedule_file(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
-	int from_client, int skip)
+static gfarm_error_t
+gfm_server_schedule_file_common(struct peer *peer, gfp_xdr_xid_t xid,
+	size_t *sizep, int from_client, int skip,
+	int command, int with_status, const char *diag)
 {
 	gfarm_error_t e;
 	GFM_PROTO_SCHEDULE_FILE_context c;
-	static const char diag[] = "GFM_PROTO_SCHEDULE_FILE";
 
-	GFM_PROTO_SCHEDULE_FILE_context_initialize(&c, from_client);
+	GFM_PROTO_SCHEDULE_FILE_context_initialize(&c, from_client,
+	    with_status);
 	e = gfm_server_relay_request_reply(peer, xid, skip,
 	    GFM_PROTO_SCHEDULE_FILE_receive_request,
 	    GFM_PROTO_SCHEDULE_FILE_send_reply,
-	    GFM_PROTO_SCHEDULE_FILE, &c, diag);
+	    command, &c, diag);
 	if (e != GFARM_ERR_NO_ERROR) { 
 		gflog_debug(GFARM_MSG_UNFIXED, "%s: %s",
 			diag, gfarm_error_string(e));
@@ -2091,6 +2096,30 @@ gfm_server_schedule_file(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
 	return (e);
 }
 
+gfarm_error_t
+gfm_server_schedule_file(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
+	int from_client, int skip)
+{
+	static const char diag[] = "GFM_PROTO_SCHEDULE_FILE";
+
+	return (gfm_server_schedule_file_common(peer, xid, sizep,
+	    from_client, skip, GFM_PROTO_SCHEDULE_FILE, 0, diag));
+}
+
+/*
+ * same as GFM_PROTO_SCHEDULE_FILE, but the reply of each host is followed
+ * by the status reported by GFM_PROTO_HOST_STATUS_REPORT, if available.
+ */
+gfarm_error_t
+gfm_server_schedule_file_with_status(struct peer *peer, gfp_xdr_xid_t xid,
+	size_t *sizep, int from_client, int skip)
+{
+	static const char diag[] = "GFM_PROTO_SCHEDULE_FILE_WITH_STATUS";
+
+	return (gfm_server_schedule_file_common(peer, xid, sizep,
+	    from_client, skip, GFM_PROTO_SCHEDULE_FILE_WITH_STATUS, 1, diag));
+}
+
 gfarm_error_t
 gfm_server_schedule_file_with_program(
 	struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
@@ -3065,14 +3094,8 @@ gfm_server_getdirentsplus(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
 		for (i = 0; i < n; i++) {
 			struct gfs_stat *st = &p[i].st;
 
-			e_ret = gfp_xdr_send(client, "sllilsslllilili",
-			    p[i].name,
-			    st->st_ino, st->st_gen, st->st_mode, st->st_nlink,
-			    st->st_user, st->st_group, st->st_size,
-			    st->st_ncopy,
-			    st->st_atimespec.tv_sec, st->st_atimespec.tv_nsec,
-			    st->st_mtimespec.tv_sec, st->st_mtimespec.tv_nsec,
-			    st->st_ctimespec.tv_sec, st->st_ctimespec.tv_nsec);
+			/* "sllilsslllilili" */
+			e_ret = gfp_xdr_send_stat(client, p[i].name, st);
 			if (e_ret != GFARM_ERR_NO_ERROR) {
 				gflog_warning(GFARM_MSG_1000387,
 				    "%s@%s: getdirentsplus: %s",
@@ -3301,6 +3324,66 @@ gfm_server_getdirentsplusxattr(struct peer *peer, gfp_xdr_xid_t xid,
 	return (e_ret);
 }
 
+gfarm_error_t
+gfm_server_dir_usage_get(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
+	int from_client, int skip)
+{
+	gfarm_error_t e, e_rpc;
+	struct process *process;
+	struct user *user;
+	gfarm_int32_t cfd;
+	struct inode *dir;
+	gfarm_int64_t space = 0, num = 0, phy_space = 0, phy_num = 0;
+	struct relayed_request *relay;
+	static const char diag[] = "GFM_PROTO_DIR_USAGE_GET";
+
+	e = gfm_server_relay_get_request(peer, sizep, skip, &relay, diag,
+	    GFM_PROTO_DIR_USAGE_GET, "");
+	if (e != GFARM_ERR_NO_ERROR)
+		return (e);
+	if (skip)
+		return (GFARM_ERR_NO_ERROR);
+	if (relay == NULL) {
+		/* do not relay RPC to master gfmd */
+		giant_lock();
+
+		if ((process = peer_get_process(peer)) == NULL) {
+			gflog_debug(GFARM_MSG_UNFIXED,
+			    "peer_get_process() failed");
+			e = GFARM_ERR_OPERATION_NOT_PERMITTED;
+		} else if ((e = peer_fdpair_get_current(peer, &cfd)) !=
+			   GFARM_ERR_NO_ERROR) {
+			gflog_debug(GFARM_MSG_UNFIXED,
+			    "peer_fdpair_get_current() "
+			    "failed: %s", gfarm_error_string(e));
+		} else if ((e = process_get_file_inode(process, cfd, &dir)) !=
+			   GFARM_ERR_NO_ERROR) {
+			gflog_debug(GFARM_MSG_UNFIXED,
+			    "process_get_file_inode() "
+			    "failed: %s", gfarm_error_string(e));
+		} else if ((user = process_get_user(process)) !=
+			   inode_get_user(dir) && !user_is_admin(user)) {
+			/*
+			 * the usage includes subdirectories which the user
+			 * may be unable to read, thus only the owner and
+			 * the administrator are allowed to see it,
+			 * like GFM_PROTO_QUOTA_USER_GET.
+			 */
+			e = GFARM_ERR_OPERATION_NOT_PERMITTED;
+			gflog_debug(GFARM_MSG_UNFIXED,
+			    "%s: not the owner of the directory", diag);
+		} else {
+			e = inode_get_usage(dir,
+			    &space, &num, &phy_space, &phy_num);
+		}
+
+		giant_unlock();
+	}
+	e_rpc = gfm_server_relay_put_reply(peer, xid, sizep, relay, diag,
+	    &e, "llll", &space, &num, &phy_space, &phy_num);
+	return (e_rpc);
+}
+
 gfarm_error_t
 gfm_server_seek(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
 	int from_client, int skip)
@@ -5009,7 +5092,7 @@ replica_adding_resume(struct peer *peer, void *closure, int *suspendedp)
 	struct inode *inode;
 	gfarm_ino_t inum = 0;
 	gfarm_uint64_t gen = 0;
-	struct gfarm_timespec *mtime;
+	struct gfarm_timespec mtime;
 	gfarm_int64_t mtime_sec = 0;
 	gfarm_int32_t mtime_nsec = 0;
 	gfp_xdr_xid_t xid;
@@ -5044,8 +5127,8 @@ replica_adding_resume(struct peer *peer, void *closure, int *suspendedp)
 		inum = inode_get_number(inode);
 		gen = inode_get_gen(inode);
 		mtime = inode_get_mtime(inode);
-		mtime_sec = mtime->tv_sec;
-		mtime_nsec = mtime->tv_nsec;
+		mtime_sec = mtime.tv_sec;
+		mtime_nsec = mtime.tv_nsec;
 	}
 
 	/* we don't maintain file_replication in this case */
@@ -5066,7 +5149,7 @@ gfm_server_replica_adding(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
 	gfarm_error_t e;
 	gfarm_ino_t inum = 0;
 	gfarm_uint64_t gen = 0;
-	struct gfarm_timespec *mtime;
+	struct gfarm_timespec mtime;
 	gfarm_int64_t mtime_sec = 0;
 	gfarm_int32_t fd, mtime_nsec = 0;
 	struct host *src, *spool_host;
@@ -5135,8 +5218,8 @@ gfm_server_replica_adding(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
 			inum = inode_get_number(inode);
 			gen = inode_get_gen(inode);
 			mtime = inode_get_mtime(inode);
-			mtime_sec = mtime->tv_sec;
-			mtime_nsec = mtime->tv_nsec;
+			mtime_sec = mtime.tv_sec;
+			mtime_nsec = mtime.tv_nsec;
 		}
 
 		/* we don't maintain file_replication in this case */
@@ -5633,3 +5716,92 @@ gfm_server_replica_create_file_in_lost_found(struct peer *peer,
 	return (gfm_server_relay_put_reply(peer, xid, sizep, relay,
 	    diag, &e_rpc, "ll", &inum_new, &gen_new));
 }
+
+/*
+ * memory usage of the metadata and the connection buffers,
+ * reported by GFM_PROTO_MEMORY_STAT_GET
+ */
+gfarm_error_t
+gfm_server_memory_stat_get(struct peer *peer, gfp_xdr_xid_t xid,
+	size_t *sizep, int from_client, int skip)
+{
+	gfarm_error_t e, e2;
+	struct user *user = peer_get_user(peer);
+	struct peer *mhpeer;
+	int i, n = 0, size_pos;
+	gfarm_uint64_t nslots = 0, table_bytes = 0, inode_bytes = 0;
+	gfarm_uint64_t ncopies = 0, copy_bytes = 0;
+	struct gfp_xdr_profile_stat xst;
+	const char *pname;
+	struct {
+		const char *name;
+		gfarm_uint64_t value;
+	} stats[GFM_PROTO_MEMORY_STAT_MAX + 3 * GFP_XDR_NPROFILES];
+	char names[3 * GFP_XDR_NPROFILES][GFM_PROTO_MEMORY_STAT_NAME_MAX];
+	static const char diag[] = "GFM_PROTO_MEMORY_STAT_GET";
+
+	e = gfm_server_get_request(peer, sizep, diag, "");
+	if (e != GFARM_ERR_NO_ERROR)
+		return (e);
+	if (skip)
+		return (GFARM_ERR_NO_ERROR);
+
+	giant_lock();
+	if (!from_client || user == NULL || !user_is_admin(user)) {
+		gflog_debug(GFARM_MSG_UNFIXED, "%s: operation is not permitted",
+		    diag);
+		e = GFARM_ERR_OPERATION_NOT_PERMITTED;
+	} else {
+		inode_memory_usage(&nslots, &table_bytes, &inode_bytes);
+		stats[n].name = GFM_PROTO_MEMORY_STAT_INODES;
+		stats[n++].value = inode_total_num();
+		stats[n].name = GFM_PROTO_MEMORY_STAT_INODE_SLOTS;
+		stats[n++].value = nslots;
+		stats[n].name = GFM_PROTO_MEMORY_STAT_INODE_TABLE_BYTES;
+		stats[n++].value = table_bytes;
+		stats[n].name = GFM_PROTO_MEMORY_STAT_INODE_BYTES;
+		stats[n++].value = inode_bytes;
+		file_copy_memory_usage(&ncopies, &copy_bytes);
+		stats[n].name = GFM_PROTO_MEMORY_STAT_FILE_COPIES;
+		stats[n++].value = ncopies;
+		stats[n].name = GFM_PROTO_MEMORY_STAT_FILE_COPY_BYTES;
+		stats[n++].value = copy_bytes;
+	}
+	giant_unlock();
+
+	/* buffers of connections, these don't need giant_lock */
+	for (i = 0; e == GFARM_ERR_NO_ERROR && i < GFP_XDR_NPROFILES; i++) {
+		gfp_xdr_profile_stat_get(i, &xst);
+		pname = gfp_xdr_profile_name(i);
+		snprintf(names[3 * i], sizeof(names[0]),
+		    GFM_PROTO_MEMORY_STAT_CONNECTIONS_FMT, pname);
+		stats[n].name = names[3 * i];
+		stats[n++].value = xst.connections;
+		snprintf(names[3 * i + 1], sizeof(names[0]),
+		    GFM_PROTO_MEMORY_STAT_BUFFER_BYTES_FMT, pname);
+		stats[n].name = names[3 * i + 1];
+		stats[n++].value = xst.alloc_size;
+		snprintf(names[3 * i + 2], sizeof(names[0]),
+		    GFM_PROTO_MEMORY_STAT_BUFFER_MAX_BYTES_FMT, pname);
+		stats[n].name = names[3 * i + 2];
+		stats[n++].value = xst.max_alloc_size;
+	}
+
+	e2 = gfm_server_put_reply_begin(peer, &mhpeer, xid, &size_pos, diag,
+	    e, "i", n);
+	/* if network error doesn't happen, e2 == e here */
+	if (e2 == GFARM_ERR_NO_ERROR) {
+		for (i = 0; i < n; i++) {
+			if ((e2 = gfp_xdr_send(peer_get_conn(peer), "sl",
+			    stats[i].name, stats[i].value))
+			    != GFARM_ERR_NO_ERROR) {
+				gflog_debug(GFARM_MSG_UNFIXED,
+				    "%s: gfp_xdr_send: %s",
+				    diag, gfarm_error_string(e2));
+				break;
+			}
+		}
+		gfm_server_put_reply_end(peer, mhpeer, diag, size_pos);
+	}
+	return (e2);
+}
@@ -68,6 +68,8 @@ gfarm_error_t gfm_server_schedule_file(
 	struct peer *, gfp_xdr_xid_t, size_t *, int, int);
 gfarm_error_t gfm_server_schedule_file_with_program(
 	struct peer *, gfp_xdr_xid_t, size_t *, int, int);
+gfarm_error_t gfm_server_schedule_file_with_status(
+	struct peer *, gfp_xdr_xid_t, size_t *, int, int);
 gfarm_error_t gfm_server_remove(
 	struct peer *, gfp_xdr_xid_t, size_t *, int, int);
 gfarm_error_t gfm_server_rmdir(
@@ -92,6 +94,8 @@ gfarm_error_t gfm_server_getdirentsplus(
 	struct peer *, gfp_xdr_xid_t, size_t *, int, int);
 gfarm_error_t gfm_server_getdirentsplusxattr(
 	struct peer *, gfp_xdr_xid_t, size_t *, int, int);
+gfarm_error_t gfm_server_dir_usage_get(
+	struct peer *, gfp_xdr_xid_t, size_t *, int, int);
 
 /* gfs from gfsd */
 gfarm_error_t gfm_server_reopen(
@@ -150,3 +154,5 @@ gfarm_error_t gfm_server_replica_get_my_entries2(
 	struct peer *, gfp_xdr_xid_t, size_t *, int, int);
 gfarm_error_t gfm_server_replica_create_file_in_lost_found(
 	struct peer *, gfp_xdr_xid_t, size_t *, int, int);
+gfarm_error_t gfm_server_memory_stat_get(
+	struct peer *, gfp_xdr_xid_t, size_t *, int, int);
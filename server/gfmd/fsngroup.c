@@ -108,7 +108,7 @@ fsngroup_get_hosts(const char *fsngroup, int *nhostsp, struct host ***hostsp)
  */
 gfarm_error_t
 fsngroup_schedule_replication(
-	struct inode *inode, const char *repattr,
+	struct inode *inode, int priority, const char *repattr,
 	int n_srcs, struct host **srcs,
 	int *n_existingp, struct host **existing, gfarm_time_t grace,
 	int *n_being_removedp, struct host **being_removed,
@@ -160,7 +160,7 @@ fsngroup_schedule_replication(
 		num = gfarm_repattr_amount(reps[i]);
 		*total_p = *total_p + num;
 		e = inode_schedule_replication_within_scope(
-		    inode, num, n_srcs, srcs, &next_src_index,
+		    inode, priority, num, n_srcs, srcs, &next_src_index,
 		    &n_scope, scope, n_existingp, existing, grace,
 		    n_being_removedp, being_removed, diag, n_successp);
 		if (e != GFARM_ERR_NO_ERROR &&
@@ -73,6 +73,7 @@
 #include "gfmd.h"
 #include "iostat.h"
 #include "replica_check.h"
+#include "rpc_stat.h"
 
 #include "protocol_state.h"
 
@@ -82,12 +83,13 @@
 
 #ifndef CALLOUT_NTHREADS
 /*
- * this is number of thread pools which are used by callouts,
- * so thrpool_add_job() in callout_main() won't be blocked for long time.
+ * this is number of threads which dispatch callouts.
  *
- * currently, only back_channel_send_thread_pool is called from callouts.
+ * gfs_client_status_callout() is called directly by these threads,
+ * so use several threads not to delay other callouts by a slow one
+ * when there are many filesystem nodes.
  */
-#define CALLOUT_NTHREADS	1
+#define CALLOUT_NTHREADS	4
 #endif
 
 char *program_name = "gfmd";
@@ -233,6 +235,8 @@ protocol_type(gfarm_int32_t request)
 		return (PROTO_USE_FD_CURRENT);
 	case GFM_PROTO_SCHEDULE_FILE_WITH_PROGRAM:
 		return (PROTO_USE_FD_CURRENT|PROTO_USE_FD_SAVED);
+	case GFM_PROTO_SCHEDULE_FILE_WITH_STATUS:
+		return (PROTO_USE_FD_CURRENT);
 	case GFM_PROTO_FGETATTRPLUS:
 		return (PROTO_HANDLED_BY_SLAVE|PROTO_USE_FD_CURRENT);
 	case GFM_PROTO_REMOVE:
@@ -257,6 +261,8 @@ protocol_type(gfarm_int32_t request)
 		return (PROTO_HANDLED_BY_SLAVE|PROTO_USE_FD_CURRENT);
 	case GFM_PROTO_GETDIRENTSPLUSXATTR:
 		return (PROTO_HANDLED_BY_SLAVE|PROTO_USE_FD_CURRENT);
+	case GFM_PROTO_DIR_USAGE_GET: /* the usage is only kept in master */
+		return (PROTO_USE_FD_CURRENT);
 	case GFM_PROTO_REOPEN:
 		return (PROTO_USE_FD_CURRENT);
 	case GFM_PROTO_CLOSE_READ:
@@ -309,6 +315,10 @@ protocol_type(gfarm_int32_t request)
 		return (0);
 	case GFM_PROTO_STATFS:
 		return (0);
+	case GFM_PROTO_RPC_STAT_GET:
+		return (PROTO_HANDLED_BY_SLAVE);
+	case GFM_PROTO_MEMORY_STAT_GET:
+		return (PROTO_HANDLED_BY_SLAVE);
 	case GFM_PROTO_REPLICA_LIST_BY_NAME:
 		return (PROTO_HANDLED_BY_SLAVE|PROTO_USE_FD_CURRENT);
 	case GFM_PROTO_REPLICA_LIST_BY_HOST:
@@ -457,6 +467,7 @@ protocol_switch(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
 	}
 
 	peer_stat_add(peer, GFARM_IOSTAT_TRAN_NUM, 1);
+	rpc_stat_request_begin(request);
 
 	switch (request) {
 	case GFM_PROTO_HOST_INFO_GET_ALL:
@@ -648,6 +659,10 @@ protocol_switch(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
 		e = gfm_server_schedule_file_with_program(peer, xid, sizep,
 		    from_client, skip);
 		break;
+	case GFM_PROTO_SCHEDULE_FILE_WITH_STATUS:
+		e = gfm_server_schedule_file_with_status(peer, xid, sizep,
+		    from_client, skip);
+		break;
 	case GFM_PROTO_FGETATTRPLUS:
 		e = gfm_server_fgetattrplus(peer, xid, sizep,
 		    from_client, skip);
@@ -687,6 +702,10 @@ protocol_switch(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
 		e = gfm_server_getdirentsplusxattr(peer,
 		    xid, sizep, from_client, skip);
 		break;
+	case GFM_PROTO_DIR_USAGE_GET:
+		e = gfm_server_dir_usage_get(peer, xid, sizep,
+		    from_client, skip);
+		break;
 	case GFM_PROTO_REOPEN:
 		e = gfm_server_reopen(peer, xid, sizep, from_client, skip,
 		    suspendedp);
@@ -737,12 +756,14 @@ protocol_switch(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
 	case GFM_PROTO_SWITCH_BACK_CHANNEL:
 		e = gfm_server_switch_back_channel(peer, xid, sizep,
 		    from_client, skip);
+		rpc_stat_request_end(request);
 		/* should not call gfp_xdr_flush() due to race */
 		return (e);
 #endif
 	case GFM_PROTO_SWITCH_ASYNC_BACK_CHANNEL:
 		e = gfm_server_switch_async_back_channel(peer, xid, sizep,
 		    from_client, skip);
+		rpc_stat_request_end(request);
 		/* should not call gfp_xdr_flush() due to race */
 		return (e);
 	case GFM_PROTO_SWITCH_GFMD_CHANNEL:
@@ -751,6 +772,7 @@ protocol_switch(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
 			    from_client, skip);
 		else
 			e = GFARM_ERR_OPERATION_NOT_SUPPORTED;
+		rpc_stat_request_end(request);
 		/* should not call gfp_xdr_flush() due to race */
 		return (e);
 	case GFM_PROTO_GLOB:
@@ -783,6 +805,14 @@ protocol_switch(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
 	case GFM_PROTO_STATFS:
 		e = gfm_server_statfs(peer, xid, sizep, from_client, skip);
 		break;
+	case GFM_PROTO_RPC_STAT_GET:
+		e = gfm_server_rpc_stat_get(peer, xid, sizep,
+		    from_client, skip);
+		break;
+	case GFM_PROTO_MEMORY_STAT_GET:
+		e = gfm_server_memory_stat_get(peer, xid, sizep,
+		    from_client, skip);
+		break;
 	case GFM_PROTO_REPLICA_LIST_BY_NAME:
 		e = gfm_server_replica_list_by_name(peer, xid, sizep,
 		    from_client, skip);
@@ -977,6 +1007,7 @@ protocol_switch(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
 		if (e == GFARM_ERR_NO_ERROR)
 			e = e2;
 	}
+	rpc_stat_request_end(request);
 
 	/* continue unless protocol error happens */
 	return (e);
@@ -1184,6 +1215,8 @@ protocol_main(void *arg)
 	 * and there was no chance that the jobq became available.
 	 */
 
+	/* the buffers are released, if it stays idle. */
+	local_peer_set_idle(local_peer);
 	local_peer_watch_readable(local_peer);
 
 	/* this return value won't be used, because this thread is detached */
@@ -1277,6 +1310,7 @@ resuming_thread(void *arg)
 		}
 
 		local_peer = peer_to_local_peer(peer);
+		local_peer_set_idle(local_peer);
 		local_peer_watch_readable(local_peer);
 	}
 
@@ -1640,6 +1674,7 @@ transform_to_master(void)
 	dead_file_copy_init_load();
 
 	quota_check();
+	inode_usage_check();
 
 	giant_unlock();
 
@@ -1927,6 +1962,7 @@ db_journal_store_failure(void)
 void
 gfmd_modules_init_default(int table_size)
 {
+	rpc_stat_init();
 	peer_watcher_set_default_nfd(table_size);
 	sync_protocol_watcher = peer_watcher_alloc(
 	    gfarm_metadb_thread_pool_size, gfarm_metadb_job_queue_length,
@@ -1974,6 +2010,7 @@ gfmd_modules_init_default(int table_size)
 	dead_file_copy_init(mdhost_self_is_master());
 
 	local_peer_init(table_size);
+	local_peer_shrink_idle_start(sync_protocol_get_thrpool());
 	peer_init();
 	job_table_init(table_size);
 }
@@ -1994,7 +2031,7 @@ main(int argc, char **argv)
 	int syslog_facility = GFARM_DEFAULT_FACILITY;
 	int ch, sock, table_size;
 	sigset_t sigs;
-	int is_master, file_trace = 0;
+	int is_master, file_trace = 0, clean_shutdown;
 
 	if (argc >= 1)
 		program_name = basename(argv[0]);
@@ -2214,15 +2251,19 @@ main(int argc, char **argv)
 
 	if (gfarm_get_metadb_replication_enabled())
 		start_db_journal_threads();
+	clean_shutdown = db_clean_shutdown_get();
 	if (mdhost_self_is_master()) {
 		gflog_info(GFARM_MSG_UNFIXED, "start filesystem check");
 		/* these functions write db, thus, must be after db_thread  */
 		inode_remove_orphan(); /* should be before
 					  inode_check_and_repair() */
-		inode_check_and_repair();
-		quota_check();
+		/* this does quota_check() as well */
+		inode_check_and_repair(!clean_shutdown ||
+		    gfarm_metadb_check_after_clean_shutdown);
+		inode_usage_check();
 	}
 	inode_free_orphan();
+	inode_startup_done();
 	gflog_info(GFARM_MSG_UNFIXED, "end bootstrap");
 	if (gfarm_get_metadb_replication_enabled()) {
 		is_master = mdhost_self_is_master();
@@ -2331,6 +2331,8 @@ switch_gfmd_channel(struct peer *peer, int from_client,
 		struct local_peer *local_peer = peer_to_local_peer(peer);
 
 		local_peer_set_async(local_peer, async);
+		gfp_xdr_set_profile(peer_get_conn(peer),
+		    GFP_XDR_PROFILE_BACK_CHANNEL);
 		local_peer_set_readable_watcher(local_peer, gfmdc_recv_watcher);
 		peer_set_gfmdc_record(peer, gfmdc_peer);
 
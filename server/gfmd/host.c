@@ -4,11 +4,13 @@
 
 #include <assert.h>
 #include <stdarg.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <errno.h>
 #include <time.h>
+#include <sys/time.h>
 
 /* for host_addr_lookup() */
 #include <sys/socket.h>
@@ -50,6 +52,7 @@
 #include "back_channel.h"
 #include "relay.h"
 #include "replica_check.h"
+#include "replica_placement.h"
 
 #define HOST_HASHTAB_SIZE	3079	/* prime number */
 
@@ -75,6 +78,13 @@ struct host {
 	 */
 	char *fsngroupname;
 
+	/* gfmd-initiated replications in flight, see file_replication.c */
+	int replication_src_number;
+	gfarm_off_t replication_src_bytes, replication_dst_bytes;
+
+	/* replica removals not sent yet, see dead_file_copy.c */
+	struct dead_file_copy_batch *dfc_batch;
+
 	pthread_mutex_t back_channel_mutex;
 
 #ifdef COMPAT_GFARM_2_3
@@ -89,6 +99,8 @@ struct host {
 	struct host_status status;
 	struct callout *status_callout;
 	gfarm_time_t last_report;
+	struct timeval status_time;	/* time of the last status report */
+	int status_extended;		/* status.nclients and so on are valid */
 	gfarm_time_t disconnect_time;
 	int status_callout_retry;
 };
@@ -457,6 +469,46 @@ host_sendq(struct host *h)
 	return (h->ah.sendq);
 }
 
+/*
+ * n replications of size bytes from src to dst are started (n > 0),
+ * or finished (n < 0).
+ *
+ * PREREQUISITE: giant_lock
+ */
+void
+host_replication_add(struct host *src, struct host *dst, int n,
+	gfarm_off_t size)
+{
+	src->replication_src_number += n;
+	src->replication_src_bytes += n * size;
+	dst->replication_dst_bytes += n * size;
+}
+
+/* PREREQUISITE: giant_lock */
+int
+host_replication_source_number(struct host *h)
+{
+	return (h->replication_src_number);
+}
+
+/*
+ * bytes being replicated from and to the host
+ *
+ * PREREQUISITE: giant_lock
+ */
+gfarm_off_t
+host_replication_bytes(struct host *h)
+{
+	return (h->replication_src_bytes + h->replication_dst_bytes);
+}
+
+/* PREREQUISITE: dfc_batch_mutex in dead_file_copy.c */
+struct dead_file_copy_batch **
+host_dead_file_copy_batch(struct host *h)
+{
+	return (&h->dfc_batch);
+}
+
 int
 host_supports_async_protocols(struct host *h)
 {
@@ -464,6 +516,20 @@ host_supports_async_protocols(struct host *h)
 		>= GFS_PROTOCOL_VERSION_V2_4);
 }
 
+int
+host_supports_fhremove_multi(struct host *h)
+{
+	return (abstract_host_get_protocol_version(&h->ah)
+		>= GFS_PROTOCOL_VERSION_V2_7);
+}
+
+int
+host_supports_status2(struct host *h)
+{
+	return (abstract_host_get_protocol_version(&h->ah)
+		>= GFS_PROTOCOL_VERSION_V2_8);
+}
+
 static void
 back_channel_mutex_lock(struct host *h, const char *diag)
 {
@@ -667,6 +733,8 @@ host_status_update(struct host *host, struct host_status *status)
 	}
 
 	host->last_report = time(NULL);
+	gettimeofday(&host->status_time, NULL);
+	host->status_extended = 0;
 	host->report_flags =
 		GFM_PROTO_SCHED_FLAG_HOST_AVAIL |
 		GFM_PROTO_SCHED_FLAG_LOADAVG_AVAIL;
@@ -678,6 +746,68 @@ host_status_update(struct host *host, struct host_status *status)
 	    status->disk_used, status->disk_avail);
 }
 
+/*
+ * update the fields of the host status specified by the mask.
+ * GFS_PROTO_STATUS2 reports all fields, and then
+ * GFM_PROTO_HOST_STATUS_REPORT reports only the changed fields.
+ */
+void
+host_status_report(struct host *host, gfarm_int32_t mask,
+	const struct gfm_host_status *status)
+{
+	gfarm_uint64_t saved_used = 0, saved_avail = 0;
+	gfarm_uint64_t new_used, new_avail;
+	const char diag[] = "status_report";
+
+	back_channel_mutex_lock(host, diag);
+
+	if ((host->report_flags & GFM_PROTO_SCHED_FLAG_LOADAVG_AVAIL) == 0 ||
+	    !host->status_extended) {
+		if (mask != GFM_PROTO_HOST_STATUS_ALL) {
+			/* a partial report before the whole status */
+			back_channel_mutex_unlock(host, diag);
+			gflog_info(GFARM_MSG_UNFIXED,
+			    "%s: partial status report (0x%x) ignored",
+			    host_name(host), (int)mask);
+			return;
+		}
+	} else {
+		saved_used = host->status.disk_used;
+		saved_avail = host->status.disk_avail;
+	}
+
+	host->status_callout_retry = 0;
+	host->last_report = time(NULL);
+	gettimeofday(&host->status_time, NULL);
+	host->status_extended = 1;
+	host->report_flags =
+		GFM_PROTO_SCHED_FLAG_HOST_AVAIL |
+		GFM_PROTO_SCHED_FLAG_LOADAVG_AVAIL;
+	if (mask & GFM_PROTO_HOST_STATUS_LOADAVG) {
+		host->status.loadavg_1min = status->loadavg_1min;
+		host->status.loadavg_5min = status->loadavg_5min;
+		host->status.loadavg_15min = status->loadavg_15min;
+	}
+	if (mask & GFM_PROTO_HOST_STATUS_DISK) {
+		host->status.disk_used = status->disk_used;
+		host->status.disk_avail = status->disk_avail;
+	}
+	if (mask & GFM_PROTO_HOST_STATUS_NCLIENTS)
+		host->status.nclients = status->nclients;
+	if (mask & GFM_PROTO_HOST_STATUS_QUEUE)
+		host->status.queue_depth = status->queue_depth;
+	if (mask & GFM_PROTO_HOST_STATUS_IO_RATE) {
+		host->status.read_rate = status->read_rate;
+		host->status.write_rate = status->write_rate;
+	}
+	new_used = host->status.disk_used;
+	new_avail = host->status.disk_avail;
+
+	back_channel_mutex_unlock(host, diag);
+
+	host_total_disk_update(saved_used, saved_avail, new_used, new_avail);
+}
+
 /*
  * PREREQUISITE: giant_lock
  * LOCKS: host::back_channel_mutex, dfc_allq.mutex, removal_pendingq.mutex
@@ -825,6 +955,9 @@ host_new(struct gfarm_host_info *hi, struct callout *callout)
 	}
 	h->hi = *hi;
 	h->fsngroupname = NULL;
+	h->replication_src_number = 0;
+	h->replication_src_bytes = h->replication_dst_bytes = 0;
+	h->dfc_batch = NULL;
 	gfarm_mutex_init(&h->back_channel_mutex, diag, BACK_CHANNEL_DIAG);
 #ifdef COMPAT_GFARM_2_3
 	h->back_channel_result = NULL;
@@ -838,6 +971,12 @@ host_new(struct gfarm_host_info *hi, struct callout *callout)
 	h->status.loadavg_15min = 0.0;
 	h->status.disk_used =
 	h->status.disk_avail = 0;
+	h->status.nclients =
+	h->status.queue_depth = 0;
+	h->status.read_rate =
+	h->status.write_rate = 0;
+	h->status_time.tv_sec = h->status_time.tv_usec = 0;
+	h->status_extended = 0;
 	h->status_callout = callout;
 	h->status_callout_retry = 0;
 	h->last_report = 0;
@@ -1093,20 +1232,64 @@ host_number()
 }
 
 /*
- * just select randomly		XXX FIXME: needs to improve
+ * select hosts by the replica_placement policy
+ *
+ * PREREQUISITE: giant_lock
+ * LOCKS: back_channel_mutex, netsendq_workq::mutex
+ * SLEEPS: no
  */
-static void
+static gfarm_error_t
 select_hosts(int nhosts, struct host **hosts,
+	int n_existing, struct host **existing,
 	int nresults, struct host **results)
 {
-	int i, j;
+	gfarm_error_t e;
+	int i, j, ncpu, *indexes;
+	gfarm_off_t avail, minfree = gfarm_get_minimum_free_disk_space() / 1024;
+	const char *fsngroup;
+	struct replica_placement_load *loads;
+	struct host *h;
+	static const char diag[] = "select_hosts";
 
 	assert(nhosts > nresults);
-	for (i = 0; i < nresults; i++) {
-		j = gfarm_random() % nhosts;
-		results[i] = hosts[j];
-		hosts[j] = hosts[--nhosts];
+	GFARM_MALLOC_ARRAY(loads, nhosts);
+	GFARM_MALLOC_ARRAY(indexes, nresults);
+	if (loads == NULL || indexes == NULL) {
+		free(loads);
+		free(indexes);
+		return (GFARM_ERR_NO_MEMORY);
 	}
+	for (i = 0; i < nhosts; i++) {
+		h = hosts[i];
+		ncpu = h->hi.ncpu > 0 ? h->hi.ncpu : 1;
+
+		back_channel_mutex_lock(h, diag);
+		avail = h->status.disk_avail;
+		loads[i].loadavg = h->status.loadavg_1min / ncpu;
+		back_channel_mutex_unlock(h, diag);
+
+		loads[i].disk_avail = avail > minfree ? avail - minfree : 0;
+		loads[i].inflight = file_replication_inflight_number(h);
+		fsngroup = host_fsngroup(h);
+		loads[i].fsngroup = fsngroup;
+		loads[i].fsngroup_replicas = 0;
+		if (fsngroup[0] == '\0')
+			continue;
+		for (j = 0; j < n_existing; j++) {
+			if (strcmp(host_fsngroup(existing[j]), fsngroup) == 0)
+				loads[i].fsngroup_replicas++;
+		}
+	}
+
+	e = replica_placement_select(gfarm_replica_placement_get(),
+	    nhosts, loads, nresults, indexes);
+	if (e == GFARM_ERR_NO_ERROR) {
+		for (i = 0; i < nresults; i++)
+			results[i] = hosts[indexes[i]];
+	}
+	free(loads);
+	free(indexes);
+	return (e);
 }
 
 /*
@@ -1215,7 +1398,12 @@ host_schedule_n_except(
 			targets[i] = hosts[i];
 		*n_targetsp = nhosts;
 	} else { /* too enough targets */
-		select_hosts(nhosts, hosts, n_shortage, targets);
+		e = select_hosts(nhosts, hosts, *n_existingp, existing,
+		    n_shortage, targets);
+		if (e != GFARM_ERR_NO_ERROR) {
+			free(targets);
+			return (e);
+		}
 		*n_targetsp = n_shortage;
 	}
 	*targetsp = targets;
@@ -1994,6 +2182,62 @@ host_schedule_reply_arg_dynarg(struct host *h, struct peer *peer,
 			report_flags));
 }
 
+/*
+ * reply of GFM_PROTO_SCHEDULE_FILE_WITH_STATUS.
+ * "iiill" follows the reply of GFM_PROTO_SCHEDULE_FILE,
+ * if GFM_PROTO_SCHED_FLAG_STATUS_AVAIL is set.
+ */
+gfarm_error_t
+host_schedule_reply_with_status_arg_dynarg(struct host *h, struct peer *peer,
+	size_t *sizep, const char *diag)
+{
+	gfarm_error_t e;
+	struct host_status status;
+	struct timeval status_time, now;
+	gfarm_time_t last_report;
+	gfarm_int32_t report_flags, age;
+
+	back_channel_mutex_lock(h, diag);
+	status = h->status;
+	status_time = h->status_time;
+	last_report = h->last_report;
+	report_flags = h->report_flags;
+	if (h->status_extended &&
+	    (report_flags & GFM_PROTO_SCHED_FLAG_LOADAVG_AVAIL) != 0)
+		report_flags |= GFM_PROTO_SCHED_FLAG_STATUS_AVAIL;
+	back_channel_mutex_unlock(h, diag);
+
+	e = gfm_server_relay_put_reply_arg_dynarg(
+			peer, sizep, diag, "siiillllii",
+			h->hi.hostname,
+			h->hi.port,
+			h->hi.ncpu,
+			(gfarm_int32_t)(status.loadavg_1min *
+				GFM_PROTO_LOADAVG_FSCALE),
+			last_report,
+			status.disk_used,
+			status.disk_avail,
+			(gfarm_int64_t)0 /* rtt_cache_time */,
+			(gfarm_int32_t)0 /* rtt_usec */,
+			report_flags);
+	if (e != GFARM_ERR_NO_ERROR ||
+	    (report_flags & GFM_PROTO_SCHED_FLAG_STATUS_AVAIL) == 0)
+		return (e);
+
+	/* milliseconds since the last report of the status */
+	gettimeofday(&now, NULL);
+	gfarm_timeval_sub(&now, &status_time);
+	age = now.tv_sec < 0 ? 0 : now.tv_sec >= INT_MAX / 1000 ?
+	    INT_MAX : now.tv_sec * 1000 + now.tv_usec / 1000;
+	return (gfm_server_relay_put_reply_arg_dynarg(
+			peer, sizep, diag, "iiill",
+			status.nclients,
+			status.queue_depth,
+			age,
+			(gfarm_int64_t)status.read_rate,
+			(gfarm_int64_t)status.write_rate));
+}
+
 gfarm_error_t
 host_schedule_reply_all(
 	struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
@@ -10,11 +10,17 @@ struct sockaddr;
 struct peer;
 struct callout;
 struct dead_file_copy;
+struct dead_file_copy_batch;
 struct netsendq;
+struct gfm_host_status;
 
 struct host_status {
 	double loadavg_1min, loadavg_5min, loadavg_15min;
 	gfarm_off_t disk_used, disk_avail;
+
+	/* only reported by GFS_PROTO_STATUS2 and GFM_PROTO_HOST_STATUS_REPORT */
+	gfarm_int32_t nclients, queue_depth;
+	gfarm_uint64_t read_rate, write_rate;
 };
 
 struct abstract_host *host_to_abstract_host(struct host *);
@@ -39,7 +45,13 @@ int host_ncpu(struct host *);
 int host_flags(struct host *);
 char *host_fsngroup(struct host *);
 struct netsendq *host_sendq(struct host *);
+void host_replication_add(struct host *, struct host *, int, gfarm_off_t);
+int host_replication_source_number(struct host *);
+gfarm_off_t host_replication_bytes(struct host *);
+struct dead_file_copy_batch **host_dead_file_copy_batch(struct host *);
 int host_supports_async_protocols(struct host *);
+int host_supports_fhremove_multi(struct host *);
+int host_supports_status2(struct host *);
 int host_is_disk_available(struct host *, gfarm_off_t);
 
 #ifdef COMPAT_GFARM_2_3
@@ -77,6 +89,8 @@ gfarm_error_t host_schedule_n_except(
 	int (*)(struct host *, void *), void *,
 	int, int *, struct host ***, int *);
 void host_status_update(struct host *, struct host_status *);
+void host_status_report(struct host *, gfarm_int32_t,
+	const struct gfm_host_status *);
 
 struct gfarm_host_info;
 gfarm_error_t host_enter(struct gfarm_host_info *, struct host **);
@@ -108,6 +122,8 @@ gfarm_error_t host_schedule_reply_all(struct peer *, gfp_xdr_xid_t, size_t *,
 	int (*)(struct host *, void *), void *, const char *);
 gfarm_error_t host_schedule_reply_arg_dynarg(struct host *, struct peer *,
 	size_t *, const char *);
+gfarm_error_t host_schedule_reply_with_status_arg_dynarg(struct host *,
+	struct peer *, size_t *, const char *);
 
 gfarm_error_t gfm_server_hostname_set(
 	struct peer *, gfp_xdr_xid_t, size_t *, int, int);
@@ -9,6 +9,7 @@
 #include <stdio.h> /* sprintf */
 #include <ctype.h>
 #include <sys/time.h>
+#include <sys/mman.h> /* madvise(2) */
 #include <pthread.h>
 #include <errno.h>
 
@@ -56,8 +57,31 @@
 #define MAX_DIR_DEPTH			1024	/* == GFARM_PATH_MAX */
 
 #define ROOT_INUMBER			2
-#define INODE_TABLE_SIZE_INITIAL	1000
-#define INODE_TABLE_SIZE_MULTIPLY	2
+
+/*
+ * The inode table is a directory of chunks of INODE_TABLE_CHUNK_SIZE slots,
+ * and a chunk is allocated when an inode number in it is used first.
+ * The slots never move, so growing the table only reallocates the directory,
+ * which is 8KiB per 64M inodes.
+ */
+#define INODE_TABLE_CHUNK_SHIFT		16
+#define INODE_TABLE_CHUNK_SIZE		((gfarm_ino_t)1 << INODE_TABLE_CHUNK_SHIFT)
+#define INODE_TABLE_CHUNK_MASK		(INODE_TABLE_CHUNK_SIZE - 1)
+#define INODE_TABLE_NCHUNKS_INITIAL	16
+#define INODE_TABLE_NCHUNKS_MULTIPLY	2
+
+/*
+ * struct inode is allocated from slab arenas, and never freed,
+ * because a free inode is kept in the inode_free_list for reuse.
+ */
+#define INODE_SLAB_SIZE			(2 * 1024 * 1024) /* a huge page */
+
+/*
+ * struct file_copy is allocated from pools of FILE_COPY_POOL_SIZE bytes,
+ * and recycled through file_copy_free_list, since the overhead of malloc(3)
+ * is large for such a small structure, and there is one for each replica.
+ */
+#define FILE_COPY_POOL_SIZE		(64 * 1024)
 
 #define INODE_MODE_FREE			0	/* struct inode:i_mode */
 
@@ -99,21 +123,32 @@ struct xattrs {
 	struct xattr_entry *head, *tail;
 };
 
+/*
+ * allocated when the first xattr or the first dead file copy of the inode
+ * is added, and freed when neither remains.
+ */
+struct inode_extra {
+	struct xattrs xattrs, xmlattrs;
+	struct dead_file_copy_list *dead_copies; /* even free inode may have */
+};
+
+/*
+ * struct inode is kept as small as possible, because gfmd holds all inodes
+ * in memory.  the timestamps are not struct gfarm_timespec, to avoid its
+ * padding, and the fields only used at gfmd startup are in struct
+ * inode_startup.  this is 128 bytes on LP64.
+ */
 struct inode {
 	gfarm_ino_t i_number;
 	gfarm_uint64_t i_gen;
 	gfarm_uint64_t i_nlink;
-	gfarm_uint64_t i_nlink_ini; /* only used at gfmd startup */
 	gfarm_off_t i_size;
 	struct user *i_user;
 	struct group *i_group;
-	struct gfarm_timespec i_atimespec;
+	gfarm_time_t i_atime_sec, i_mtime_sec, i_ctime_sec;
+	gfarm_int32_t i_atime_nsec, i_mtime_nsec, i_ctime_nsec;
 	gfarm_mode_t i_mode;
-	struct gfarm_timespec i_mtimespec;
-	struct gfarm_timespec i_ctimespec;
-	struct xattrs i_xattrs, i_xmlattrs;
-
-	struct dead_file_copy_list *dead_copies; /* even free inode may have */
+	struct inode_extra *i_extra; /* NULL, if no xattr and no dead copy */
 
 	union {
 		struct inode_free_link {
@@ -127,15 +162,18 @@ struct inode {
 				} f;
 				struct inode_dir {
 					Dir entries;
-
-					/* only used at gfmd startup */
-					struct inode *parent_dir;
 				} d;
 				struct inode_symlink {
 					char *source_path;
 				} l;
 			} s;
 			struct inode_activity *activity;
+
+			/*
+			 * the directory whose usage includes this inode.
+			 * see inode_usage_check().
+			 */
+			struct inode *parent;
 		} c;
 	} u;
 };
@@ -170,10 +208,16 @@ struct inode_activity {
 	} u;
 };
 
-struct inode **inode_table = NULL;
-gfarm_ino_t inode_table_size = 0;
+static struct inode ***inode_table = NULL; /* directory of chunks */
+static gfarm_ino_t inode_table_nchunks = 0; /* size of the directory */
+static gfarm_ino_t inode_table_nchunks_used = 0; /* allocated chunks */
+gfarm_ino_t inode_table_size = 0; /* upper bound of allocated slots */
 gfarm_ino_t inode_free_index = ROOT_INUMBER;
 
+static char *inode_slab_next = NULL;
+static size_t inode_slab_avail = 0;
+static gfarm_uint64_t inode_slab_total = 0; /* bytes */
+
 struct inode inode_free_list; /* dummy header of doubly linked circular list */
 int inode_free_list_initialized = 0;
 
@@ -243,6 +287,48 @@ file_copy_is_being_removed(struct file_copy *file_copy)
 	return (FILE_COPY_IS_BEING_REMOVED(file_copy));
 }
 
+static struct file_copy *file_copy_free_list = NULL;
+static gfarm_uint64_t file_copy_num = 0; /* in use */
+static gfarm_uint64_t file_copy_pool_total = 0; /* bytes */
+
+static struct file_copy *
+file_copy_alloc(void)
+{
+	struct file_copy *copy, *pool;
+	size_t i, n = FILE_COPY_POOL_SIZE / sizeof(*copy);
+
+	if (file_copy_free_list == NULL) {
+		GFARM_MALLOC_ARRAY(pool, n);
+		if (pool == NULL)
+			return (NULL);
+		for (i = 0; i < n; i++) {
+			pool[i].host_next = file_copy_free_list;
+			file_copy_free_list = &pool[i];
+		}
+		file_copy_pool_total += n * sizeof(*pool);
+	}
+	copy = file_copy_free_list;
+	file_copy_free_list = copy->host_next;
+	file_copy_num++;
+	return (copy);
+}
+
+static void
+file_copy_free(struct file_copy *copy)
+{
+	copy->host_next = file_copy_free_list;
+	file_copy_free_list = copy;
+	file_copy_num--;
+}
+
+/* REQUISITE: giant_lock */
+void
+file_copy_memory_usage(gfarm_uint64_t *ncopiesp, gfarm_uint64_t *bytesp)
+{
+	*ncopiesp = file_copy_num;
+	*bytesp = file_copy_pool_total;
+}
+
 gfarm_uint64_t
 inode_total_num(void)
 {
@@ -487,29 +573,79 @@ xattrs_free_entries(struct xattrs *xattrs)
 	xattrs->tail = NULL;
 }
 
+/* returns NULL, if no memory */
+static struct inode_extra *
+inode_extra_get_or_alloc(struct inode *inode)
+{
+	if (inode->i_extra == NULL) {
+		GFARM_MALLOC(inode->i_extra);
+		if (inode->i_extra == NULL) {
+			gflog_debug(GFARM_MSG_UNFIXED,
+			    "allocation of 'inode_extra' failed");
+			return (NULL);
+		}
+		xattrs_init(&inode->i_extra->xattrs);
+		xattrs_init(&inode->i_extra->xmlattrs);
+		inode->i_extra->dead_copies = NULL;
+	}
+	return (inode->i_extra);
+}
+
 static void
-inode_xattrs_init(struct inode *inode)
+inode_extra_free_if_unused(struct inode *inode)
 {
-	xattrs_init(&inode->i_xattrs);
-	xattrs_init(&inode->i_xmlattrs);
+	struct inode_extra *extra = inode->i_extra;
+
+	if (extra == NULL || extra->xattrs.head != NULL ||
+	    extra->xmlattrs.head != NULL || extra->dead_copies != NULL)
+		return;
+	free(extra);
+	inode->i_extra = NULL;
+}
+
+static struct dead_file_copy_list *
+inode_dead_copies(struct inode *inode)
+{
+	return (inode->i_extra == NULL ? NULL : inode->i_extra->dead_copies);
 }
 
 void
 inode_xattrs_clear(struct inode *inode)
 {
-	xattrs_free_entries(&inode->i_xattrs);
-	xattrs_free_entries(&inode->i_xmlattrs);
+	if (inode->i_extra == NULL)
+		return;
+	xattrs_free_entries(&inode->i_extra->xattrs);
+	xattrs_free_entries(&inode->i_extra->xmlattrs);
+	inode_extra_free_if_unused(inode);
+}
+
+/* returns NULL, if the inode has no xattr */
+static struct xattrs *
+inode_xattrs_get(struct inode *inode, int xmlMode)
+{
+	if (inode->i_extra == NULL)
+		return (NULL);
+	return (xmlMode ?
+	    &inode->i_extra->xmlattrs : &inode->i_extra->xattrs);
+}
+
+/* returns NULL, if no memory */
+static struct xattrs *
+inode_xattrs_get_or_alloc(struct inode *inode, int xmlMode)
+{
+	if (inode_extra_get_or_alloc(inode) == NULL)
+		return (NULL);
+	return (inode_xattrs_get(inode, xmlMode));
 }
 
 static void
 remove_all_xattrs(struct inode *inode, int xmlMode)
 {
 	gfarm_error_t e;
-	struct xattrs *xattrs = xmlMode ?
-		&inode->i_xmlattrs : &inode->i_xattrs;
+	struct xattrs *xattrs = inode_xattrs_get(inode, xmlMode);
 	struct xattr_entry *entry = NULL;
 
-	if (xattrs->head == NULL)
+	if (xattrs == NULL || xattrs->head == NULL)
 		return;
 
 	e = db_xattr_removeall(xmlMode, inode->i_number);
@@ -602,57 +738,255 @@ inode_free_list_init(void)
 	inode_free_list_initialized = 1;
 }
 
-struct inode *
-inode_alloc_num(gfarm_ino_t inum)
+static struct inode *
+inode_table_get(gfarm_ino_t inum)
 {
-	gfarm_ino_t i;
-	struct inode *inode;
-	static const char diag[] = "inode_alloc_num";
+	struct inode **chunk;
 
-	if (inum < ROOT_INUMBER)
-		return (NULL); /* we don't use 0 and 1 as i_number */
-	if (inode_table_size <= inum) {
-		gfarm_ino_t new_table_size;
-		struct inode **p;
-
-		if (inum < INODE_TABLE_SIZE_INITIAL)
-			new_table_size = INODE_TABLE_SIZE_INITIAL;
-		else if (inum < inode_table_size * INODE_TABLE_SIZE_MULTIPLY)
-			new_table_size =
-			    inode_table_size * INODE_TABLE_SIZE_MULTIPLY;
-		else
-			new_table_size = inum * INODE_TABLE_SIZE_MULTIPLY;
-		GFARM_REALLOC_ARRAY(p, inode_table, new_table_size);
+	if (inum >= inode_table_size)
+		return (NULL);
+	chunk = inode_table[inum >> INODE_TABLE_CHUNK_SHIFT];
+	return (chunk == NULL ? NULL : chunk[inum & INODE_TABLE_CHUNK_MASK]);
+}
+
+static struct inode **
+inode_table_slot_alloc(gfarm_ino_t inum)
+{
+	gfarm_ino_t i, ci = inum >> INODE_TABLE_CHUNK_SHIFT, nchunks;
+	struct inode ***p, **chunk;
+
+	if (ci >= inode_table_nchunks) {
+		nchunks = inode_table_nchunks == 0 ?
+		    INODE_TABLE_NCHUNKS_INITIAL :
+		    inode_table_nchunks * INODE_TABLE_NCHUNKS_MULTIPLY;
+		if (nchunks <= ci)
+			nchunks = ci + 1;
+		GFARM_REALLOC_ARRAY(p, inode_table, nchunks);
 		if (p == NULL) {
 			gflog_debug(GFARM_MSG_1001720,
 				"re-allocation of inode array failed");
 			return (NULL); /* no memory */
 		}
 		inode_table = p;
-
-		for (i = inode_table_size; i < new_table_size; i++)
+		for (i = inode_table_nchunks; i < nchunks; i++)
 			inode_table[i] = NULL;
-		inode_table_size = new_table_size;
+		inode_table_nchunks = nchunks;
+	}
+	if ((chunk = inode_table[ci]) == NULL) {
+		GFARM_CALLOC_ARRAY(chunk, INODE_TABLE_CHUNK_SIZE);
+		if (chunk == NULL) {
+			gflog_debug(GFARM_MSG_UNFIXED,
+			    "allocation of inode table chunk failed");
+			return (NULL); /* no memory */
+		}
+		inode_table[ci] = chunk;
+		inode_table_nchunks_used++;
+		if (inode_table_size <= inum)
+			inode_table_size = (ci + 1) << INODE_TABLE_CHUNK_SHIFT;
 	}
-	if ((inode = inode_table[inum]) == NULL) {
-		GFARM_MALLOC(inode);
+	return (&chunk[inum & INODE_TABLE_CHUNK_MASK]);
+}
+
+static struct inode *
+inode_slab_alloc(void)
+{
+	struct inode *inode;
+	void *p;
+	static int hugepage_warned = 0;
+
+	if (inode_slab_avail < sizeof(*inode)) {
+		p = NULL;
+#ifdef MADV_HUGEPAGE
+		if (gfarm_metadb_inode_hugepage) {
+			/* transparent huge pages need the alignment */
+			if (posix_memalign(&p, INODE_SLAB_SIZE,
+			    INODE_SLAB_SIZE) != 0)
+				p = NULL;
+			else if (madvise(p, INODE_SLAB_SIZE, MADV_HUGEPAGE)
+			    == -1 && !hugepage_warned) {
+				gflog_notice_errno(GFARM_MSG_UNFIXED,
+				    "madvise(MADV_HUGEPAGE) for inodes");
+				hugepage_warned = 1;
+			}
+		}
+#else
+		if (gfarm_metadb_inode_hugepage && !hugepage_warned) {
+			gflog_notice(GFARM_MSG_UNFIXED,
+			    "metadb_server_inode_hugepage: not supported");
+			hugepage_warned = 1;
+		}
+#endif
+		if (p == NULL)
+			p = malloc(INODE_SLAB_SIZE);
+		if (p == NULL)
+			return (NULL); /* no memory */
+		/* the rest of the previous arena is abandoned */
+		inode_slab_next = p;
+		inode_slab_avail = INODE_SLAB_SIZE;
+		inode_slab_total += INODE_SLAB_SIZE;
+	}
+	inode = (struct inode *)inode_slab_next;
+	inode_slab_next += sizeof(*inode);
+	inode_slab_avail -= sizeof(*inode);
+	return (inode);
+}
+
+/* REQUISITE: giant_lock */
+void
+inode_memory_usage(gfarm_uint64_t *nslotsp, gfarm_uint64_t *table_bytesp,
+	gfarm_uint64_t *inode_bytesp)
+{
+	*nslotsp = inode_table_size;
+	*table_bytesp = inode_table_nchunks * sizeof(*inode_table) +
+	    inode_table_nchunks_used * INODE_TABLE_CHUNK_SIZE *
+	    sizeof(**inode_table);
+	*inode_bytesp = inode_slab_total;
+}
+
+/*
+ * the fields only used by inode_check_and_repair() at gfmd startup.
+ * this table is indexed by the inode number in the same way as inode_table,
+ * and freed by inode_startup_done().
+ */
+struct inode_startup {
+	gfarm_uint64_t nlink_ini;
+	struct inode *parent_dir;
+};
+
+static struct inode_startup **inode_startup_table = NULL;
+static gfarm_ino_t inode_startup_nchunks = 0;
+static int inode_startup_finished = 0;
+
+static struct inode_startup *
+inode_startup_get(struct inode *inode, int create)
+{
+	gfarm_ino_t i, inum = inode->i_number, nchunks;
+	gfarm_ino_t ci = inum >> INODE_TABLE_CHUNK_SHIFT;
+	struct inode_startup **p;
+
+	if (inode_startup_finished)
+		return (NULL);
+	if (ci >= inode_startup_nchunks) {
+		if (!create)
+			return (NULL);
+		nchunks = inode_table_nchunks > ci ? inode_table_nchunks :
+		    ci + 1;
+		GFARM_REALLOC_ARRAY(p, inode_startup_table, nchunks);
+		/* the check of the namespace cannot continue without this */
+		if (p == NULL)
+			gflog_fatal(GFARM_MSG_UNFIXED,
+			    "inode startup table: no memory");
+		inode_startup_table = p;
+		for (i = inode_startup_nchunks; i < nchunks; i++)
+			inode_startup_table[i] = NULL;
+		inode_startup_nchunks = nchunks;
+	}
+	if (inode_startup_table[ci] == NULL) {
+		if (!create)
+			return (NULL);
+		GFARM_CALLOC_ARRAY(inode_startup_table[ci],
+		    INODE_TABLE_CHUNK_SIZE);
+		if (inode_startup_table[ci] == NULL)
+			gflog_fatal(GFARM_MSG_UNFIXED,
+			    "inode startup table chunk: no memory");
+	}
+	return (&inode_startup_table[ci][inum & INODE_TABLE_CHUNK_MASK]);
+}
+
+/* the fields are not maintained any more after inode_startup_done() */
+void
+inode_startup_done(void)
+{
+	gfarm_ino_t i;
+
+	for (i = 0; i < inode_startup_nchunks; i++)
+		free(inode_startup_table[i]);
+	free(inode_startup_table);
+	inode_startup_table = NULL;
+	inode_startup_nchunks = 0;
+	inode_startup_finished = 1;
+}
+
+static gfarm_int64_t
+inode_get_nlink_ini(struct inode *inode)
+{
+	struct inode_startup *is = inode_startup_get(inode, 0);
+
+	return (is == NULL ? 0 : is->nlink_ini);
+}
+
+static void
+inode_set_nlink_ini(struct inode *inode, gfarm_uint64_t nlink)
+{
+	struct inode_startup *is = inode_startup_get(inode, nlink != 0);
+
+	if (is != NULL)
+		is->nlink_ini = nlink;
+}
+
+static void
+inode_increment_nlink_ini(struct inode *inode)
+{
+	struct inode_startup *is = inode_startup_get(inode, 1);
+
+	if (is != NULL)
+		++is->nlink_ini;
+}
+
+static void
+inode_decrement_nlink_ini(struct inode *inode)
+{
+	struct inode_startup *is = inode_startup_get(inode, 0);
+
+	if (is != NULL)
+		--is->nlink_ini;
+}
+
+static struct inode *
+inode_get_parent_dir_ini(struct inode *inode)
+{
+	struct inode_startup *is = inode_startup_get(inode, 0);
+
+	return (is == NULL ? NULL : is->parent_dir);
+}
+
+static void
+inode_set_parent_dir_ini(struct inode *inode, struct inode *parent)
+{
+	struct inode_startup *is = inode_startup_get(inode, parent != NULL);
+
+	if (is != NULL)
+		is->parent_dir = parent;
+}
+
+struct inode *
+inode_alloc_num(gfarm_ino_t inum)
+{
+	struct inode **slot, *inode;
+	static const char diag[] = "inode_alloc_num";
+
+	if (inum < ROOT_INUMBER)
+		return (NULL); /* we don't use 0 and 1 as i_number */
+	if ((slot = inode_table_slot_alloc(inum)) == NULL)
+		return (NULL); /* no memory */
+	if ((inode = *slot) == NULL) {
+		inode = inode_slab_alloc();
 		if (inode == NULL) {
 			gflog_debug(GFARM_MSG_1001721,
 				"allocation of 'inode' failed");
 			return (NULL); /* no memory */
 		}
-		inode_xattrs_init(inode);
+		inode->i_extra = NULL;
 
 		inode->i_number = inum;
 		inode->i_gen = 0;
-		inode->dead_copies = NULL;
-		inode_table[inum] = inode;
+		*slot = inode;
 
 		/* update inode_free_index */
 		if (inum == inode_free_index) { /* always true for now */
 			while (++inode_free_index < inode_table_size) {
 				/* the following is always true for now */
-				if (inode_table[inode_free_index] == NULL)
+				if (inode_table_get(inode_free_index) == NULL)
 					break;
 			}
 		}
@@ -665,8 +999,9 @@ inode_alloc_num(gfarm_ino_t inum)
 		inode->u.l.prev->u.l.next = inode->u.l.next;
 		inode->i_gen++;
 	}
-	inode->i_nlink_ini = 0;
+	inode_set_nlink_ini(inode, 0);
 	inode->u.c.activity = NULL;
+	inode->u.c.parent = NULL;
 	gfarm_mutex_lock(&total_num_inodes_mutex, diag, total_num_inodes_diag);
 	++total_num_inodes;
 	gfarm_mutex_unlock(&total_num_inodes_mutex,
@@ -692,14 +1027,15 @@ inode_clear(struct inode *inode)
 	static const char diag[] = "inode_clear";
 
 	inode->i_mode = INODE_MODE_FREE;
-	inode->i_nlink = inode->i_nlink_ini = 0;
+	inode->i_nlink = 0;
+	inode_set_nlink_ini(inode, 0);
 	/* add to the inode_free_list */
 	inode->u.l.prev = &inode_free_list;
 	inode->u.l.next = inode_free_list.u.l.next;
 	inode->u.l.next->u.l.prev = inode;
 	inode_free_list.u.l.next = inode;
 	inode_xattrs_clear(inode);
-	/* preserve inode->dead_copies */
+	/* preserve inode->i_extra->dead_copies */
 	gfarm_mutex_lock(&total_num_inodes_mutex, diag, total_num_inodes_diag);
 	--total_num_inodes;
 	gfarm_mutex_unlock(&total_num_inodes_mutex,
@@ -766,10 +1102,11 @@ static struct gflog_reduced_state rep_fixed_state =
  * and being_removed[] but they may be abled to be used later.
  *
  * srcs[] must be different from existing[].
+ * the least loaded host in srcs[] is chosen as the source of each replica.
  */
 gfarm_error_t
 inode_schedule_replication_within_scope(
-	struct inode *inode, int n_desired,
+	struct inode *inode, int priority, int n_desired,
 	int n_srcs, struct host **srcs, int *next_src_indexp,
 	int *n_scopep, struct host **scope,
 	int *n_existingp, struct host **existing, gfarm_time_t grace,
@@ -820,12 +1157,12 @@ inode_schedule_replication_within_scope(
 	/* but, retry is unnecessary when n_desired is too large */
 
 	for (i = 0; i < n_targets; i++) {
-		if (*next_src_indexp >= n_srcs)
-			*next_src_indexp = 0;
-		src = srcs[*next_src_indexp];
+		src = file_replication_select_source(n_srcs, srcs,
+		    next_src_indexp);
 		dst = targets[i];
 
-		e = inode_replication_new(inode, src, dst, NULL, &fr);
+		e = inode_replication_new(inode, priority, src, dst, NULL,
+		    &fr);
 		if (e == GFARM_ERR_RESOURCE_TEMPORARILY_UNAVAILABLE) {
 			busy = 1;
 			gflog_reduced_debug(
@@ -887,7 +1224,7 @@ inode_schedule_replication_within_scope(
  */
 gfarm_error_t
 inode_schedule_replication_from_all(
-	struct inode *inode, int n_desired,
+	struct inode *inode, int priority, int n_desired,
 	int n_srcs, struct host **srcs,
 	int *n_existingp, struct host **existing, gfarm_time_t grace,
 	int *n_being_removedp, struct host **being_removed,
@@ -908,7 +1245,7 @@ inode_schedule_replication_from_all(
 		return (e);
 	}
 	e = inode_schedule_replication_within_scope(
-	    inode, n_desired, n_srcs, srcs, &next_src_index,
+	    inode, priority, n_desired, n_srcs, srcs, &next_src_index,
 	    &nhosts, hosts, n_existingp, existing, grace,
 	    n_being_removedp, being_removed, diag, n_successp);
 	free(hosts);
@@ -931,7 +1268,9 @@ inode_schedule_replication(
 	const char *diag, int *n_successp)
 {
 	gfarm_error_t e;
-	int total_repattr;
+	int total_repattr, priority = is_replica_check ?
+	    FILE_REPLICATION_PRIORITY_REPLICA_CHECK :
+	    FILE_REPLICATION_PRIORITY_NCOPY;
 
 	if (repattr != NULL) {
 		if (debug_mode)
@@ -943,7 +1282,7 @@ inode_schedule_replication(
 			    (long long)inode_get_gen(inode),
 			    host_name(srcs[0]));
 		e = fsngroup_schedule_replication(
-		    inode, repattr, n_srcs, srcs,
+		    inode, priority, repattr, n_srcs, srcs,
 		    n_existingp, existing, grace,
 		    n_being_removedp, being_removed, diag,
 		    n_successp, &total_repattr);
@@ -1051,7 +1390,7 @@ inode_schedule_replication(
 			    n_desired, n_existing2 + n_being_removed2,
 			    n_being_removed2);
 			e = inode_schedule_replication_from_all(
-			    inode, n_desired,
+			    inode, priority, n_desired,
 			    n_srcs, srcs, &n_existing2, existing2, grace,
 			    &n_being_removed2, being_removed2,
 			    diag, n_successp);
@@ -1070,7 +1409,7 @@ inode_schedule_replication(
 		    n_desired, *n_existingp + *n_being_removedp,
 		    *n_being_removedp);
 		e = inode_schedule_replication_from_all(
-		    inode, n_desired,
+		    inode, priority, n_desired,
 		    n_srcs, srcs, n_existingp, existing, grace,
 		    n_being_removedp, being_removed, diag, n_successp);
 	}
@@ -1198,7 +1537,7 @@ update_replicas(struct inode *inode, struct host *spool_host,
 			} else { /* dead_file_copy must be already created */
 				assert(!FILE_COPY_IS_VALID(copy));
 			}
-			free(copy);
+			file_copy_free(copy);
 		}
 	}
 
@@ -1253,7 +1592,12 @@ update_replicas(struct inode *inode, struct host *spool_host,
 				deferred_cleanup = NULL;
 			/* abandon `e' */
 
-			e = inode_replication_new(inode, spool_host,
+			/*
+			 * the old replica is removed if this fails,
+			 * so this must not be refused by admission control.
+			 */
+			e = inode_replication_new(inode,
+			    FILE_REPLICATION_PRIORITY_USER, spool_host,
 			    copy->host, deferred_cleanup, &fr);
 			if (e != GFARM_ERR_NO_ERROR) {
 				gflog_notice(GFARM_MSG_1002245,
@@ -1279,7 +1623,7 @@ update_replicas(struct inode *inode, struct host *spool_host,
 		}
 
 		next = copy->host_next;
-		free(copy);
+		file_copy_free(copy);
 	}
 
 	/*
@@ -1294,11 +1638,123 @@ update_replicas(struct inode *inode, struct host *spool_host,
 		replica_check_signal_rep_request_failed();
 }
 
+/*
+ * usage of directory trees.
+ *
+ * the Dir of each directory holds the total usage of the inodes under it.
+ * an inode is accounted in its u.c.parent directory and all ancestors of
+ * that.  u.c.parent is the directory where the inode was linked first,
+ * and is cleared when the link from there is removed.  thus, a file
+ * whose hard link in u.c.parent is removed isn't accounted anywhere
+ * until the next inode_usage_check(), even if it has other hard links.
+ *
+ * the usage is only maintained by the master gfmd, because a slave gfmd
+ * updates the inodes by the journal without these functions.
+ */
+static int inode_usage_available = 0;
+
+static void
+dir_usage_add(struct dir_usage *u, const struct dir_usage *delta, int sign)
+{
+	u->space += sign * delta->space;
+	u->num += sign * delta->num;
+	u->phy_space += sign * delta->phy_space;
+	u->phy_num += sign * delta->phy_num;
+}
+
+/* the usage of the inode itself, same with quota_update_file_add() */
+static void
+inode_usage_own(struct inode *inode, struct dir_usage *u)
+{
+	gfarm_int64_t ncopy;
+
+	u->num = 1;
+	if (inode_is_file(inode)) {
+		ncopy = inode_get_ncopy_with_dead_host(inode);
+		u->space = inode->i_size;
+		u->phy_space = inode->i_size * ncopy;
+		u->phy_num = ncopy;
+	} else {
+		u->space = 0;
+		u->phy_space = 0;
+		u->phy_num = 0;
+	}
+}
+
+/* the usage of the inode and the inodes under it */
+static void
+inode_usage_total(struct inode *inode, struct dir_usage *u)
+{
+	inode_usage_own(inode, u);
+	if (inode_is_dir(inode))
+		dir_usage_add(u, dir_get_usage(inode->u.c.s.d.entries), 1);
+}
+
+static void
+inode_usage_propagate(struct inode *inode, const struct dir_usage *delta,
+	int sign)
+{
+	struct inode *dir;
+
+	for (dir = inode->u.c.parent; dir != NULL; dir = dir->u.c.parent)
+		dir_usage_add(dir_get_usage(dir->u.c.s.d.entries),
+		    delta, sign);
+}
+
+/* the inode is linked to the directory `parent' */
+static void
+inode_usage_attach(struct inode *inode, struct inode *parent)
+{
+	struct dir_usage u;
+
+	if (!inode_usage_available || inode->u.c.parent != NULL)
+		return;
+	inode->u.c.parent = parent;
+	inode_usage_total(inode, &u);
+	inode_usage_propagate(inode, &u, 1);
+}
+
+/* the link from the directory `parent' to the inode is removed */
+static void
+inode_usage_detach(struct inode *inode, struct inode *parent)
+{
+	struct dir_usage u;
+
+	if (!inode_usage_available || inode->u.c.parent != parent)
+		return;
+	inode_usage_total(inode, &u);
+	inode_usage_propagate(inode, &u, -1);
+	inode->u.c.parent = NULL;
+}
+
+static void
+inode_usage_update(struct inode *inode,
+	gfarm_int64_t space, gfarm_int64_t phy_space, gfarm_int64_t phy_num)
+{
+	struct dir_usage u;
+
+	if (!inode_usage_available || inode->u.c.parent == NULL)
+		return;
+	u.space = space;
+	u.num = 0;
+	u.phy_space = phy_space;
+	u.phy_num = phy_num;
+	inode_usage_propagate(inode, &u, 1);
+}
+
+/* same with quota_update_replica_num() */
+static void
+inode_usage_replica_num(struct inode *inode, gfarm_int64_t n)
+{
+	inode_usage_update(inode, 0, inode->i_size * n, n);
+}
+
 void
 inode_remove(struct inode *inode)
 {
 	int dfc_needs_free = 0;
 
+	inode_usage_detach(inode, inode->u.c.parent); /* usually detached */
 	inode_remove_all_xattrs(inode);
 
 	if (inode->u.c.activity != NULL)
@@ -1315,7 +1771,7 @@ inode_remove(struct inode *inode)
 				/* abandon error */
 			}
 			cn = copy->host_next;
-			free(copy);
+			file_copy_free(copy);
 		}
 		inode->u.c.s.f.copies = NULL; /* ncopy == 0 */
 		inode_cksum_remove(inode);
@@ -1333,8 +1789,8 @@ inode_remove(struct inode *inode)
 	quota_update_file_remove(inode);
 	inode_free(inode);
 
-	if (dfc_needs_free && inode->dead_copies != NULL)
-		dead_file_copy_inode_status_changed(inode->dead_copies);
+	if (dfc_needs_free && inode_dead_copies(inode) != NULL)
+		dead_file_copy_inode_status_changed(inode_dead_copies(inode));
 }
 
 static int
@@ -1357,7 +1813,7 @@ inode_init_dir_internal(struct inode *inode)
 			"inode entries is NULL");
 		return (GFARM_ERR_NO_MEMORY);
 	}
-	inode->u.c.s.d.parent_dir = NULL;
+	inode_set_parent_dir_ini(inode, NULL);
 
 	return (GFARM_ERR_NO_ERROR);
 }
@@ -1465,11 +1921,8 @@ inode_table_current_size()
 struct inode *
 inode_lookup(gfarm_ino_t inum)
 {
-	struct inode *inode;
+	struct inode *inode = inode_table_get(inum);
 
-	if (inum >= inode_table_size)
-		return (NULL);
-	inode = inode_table[inum];
 	if (inode == NULL)
 		return (NULL);
 	if (inode->i_mode == INODE_MODE_FREE)
@@ -1480,23 +1933,129 @@ inode_lookup(gfarm_ino_t inum)
 struct inode *
 inode_lookup_including_free(gfarm_ino_t inum)
 {
-	if (inum >= inode_table_size)
-		return (NULL);
-	return (inode_table[inum]);
+	return (inode_table_get(inum));
 }
 
 void
 inode_lookup_all(void *closure, void (*callback)(void *, struct inode *))
 {
 	gfarm_ino_t i;
+	struct inode *inode;
 
 	for (i = ROOT_INUMBER; i < inode_table_size; i++) {
-		if (inode_table[i] != NULL &&
-		    inode_table[i]->i_mode != INODE_MODE_FREE)
-			callback(closure, inode_table[i]);
+		if ((i & INODE_TABLE_CHUNK_MASK) == 0 &&
+		    inode_table[i >> INODE_TABLE_CHUNK_SHIFT] == NULL) {
+			i += INODE_TABLE_CHUNK_SIZE - 1; /* skip the chunk */
+			continue;
+		}
+		inode = inode_table_get(i);
+		if (inode != NULL && inode->i_mode != INODE_MODE_FREE)
+			callback(closure, inode);
 	}
 }
 
+/*
+ * inode_lookup_all_parallel():
+ * the chunks of the inode table are distributed to the threads,
+ * thus the callback must not modify anything but its own closure.
+ */
+struct inode_lookup_all_parallel {
+	pthread_mutex_t mutex;
+	gfarm_ino_t next_chunk;
+	void (*callback)(void *, struct inode *);
+};
+
+struct inode_lookup_all_parallel_worker {
+	struct inode_lookup_all_parallel *shared;
+	void *closure;
+};
+
+static const char inode_lookup_all_parallel_diag[] =
+	"inode_lookup_all_parallel";
+
+static void *
+inode_lookup_all_parallel_thread(void *arg)
+{
+	struct inode_lookup_all_parallel_worker *w = arg;
+	struct inode_lookup_all_parallel *s = w->shared;
+	gfarm_ino_t ci, i, end;
+	struct inode **chunk, *inode;
+	static const char diag[] = "inode_lookup_all_parallel_thread";
+
+	for (;;) {
+		gfarm_mutex_lock(&s->mutex, diag,
+		    inode_lookup_all_parallel_diag);
+		ci = s->next_chunk++;
+		gfarm_mutex_unlock(&s->mutex, diag,
+		    inode_lookup_all_parallel_diag);
+		if (ci >= inode_table_nchunks)
+			return (NULL);
+		if ((chunk = inode_table[ci]) == NULL)
+			continue;
+		i = ci << INODE_TABLE_CHUNK_SHIFT;
+		end = i + INODE_TABLE_CHUNK_SIZE;
+		if (i < ROOT_INUMBER)
+			i = ROOT_INUMBER;
+		if (end > inode_table_size)
+			end = inode_table_size;
+		for (; i < end; i++) {
+			inode = chunk[i & INODE_TABLE_CHUNK_MASK];
+			if (inode != NULL && inode->i_mode != INODE_MODE_FREE)
+				s->callback(w->closure, inode);
+		}
+	}
+}
+
+/* the callback is called with closures[thread number] */
+void
+inode_lookup_all_parallel(int nthreads, void **closures,
+	void (*callback)(void *, struct inode *))
+{
+	struct inode_lookup_all_parallel s;
+	struct inode_lookup_all_parallel_worker *w;
+	pthread_t *threads;
+	int i, err;
+	static const char diag[] = "inode_lookup_all_parallel";
+
+	gfarm_mutex_init(&s.mutex, diag, inode_lookup_all_parallel_diag);
+	s.next_chunk = 0;
+	s.callback = callback;
+	GFARM_MALLOC_ARRAY(w, nthreads);
+	GFARM_MALLOC_ARRAY(threads, nthreads);
+	if (w == NULL || threads == NULL) {
+		gflog_warning(GFARM_MSG_UNFIXED,
+		    "%s: no memory for %d threads, run sequentially",
+		    diag, nthreads);
+		free(w);
+		free(threads);
+		inode_lookup_all(closures[0], callback);
+		gfarm_mutex_destroy(&s.mutex, diag,
+		    inode_lookup_all_parallel_diag);
+		return;
+	}
+	for (i = 0; i < nthreads; i++) {
+		w[i].shared = &s;
+		w[i].closure = closures[i];
+	}
+	/* the caller is one of the workers */
+	for (i = 1; i < nthreads; i++) {
+		err = pthread_create(&threads[i], NULL,
+		    inode_lookup_all_parallel_thread, &w[i]);
+		if (err != 0) {
+			gflog_warning(GFARM_MSG_UNFIXED,
+			    "%s: pthread_create: %s", diag, strerror(err));
+			break;
+		}
+	}
+	nthreads = i;
+	(void)inode_lookup_all_parallel_thread(&w[0]);
+	for (i = 1; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+	free(w);
+	gfarm_mutex_destroy(&s.mutex, diag, inode_lookup_all_parallel_diag);
+}
+
 int
 inode_is_dir(struct inode *inode)
 {
@@ -1549,24 +2108,6 @@ inode_get_nlink(struct inode *inode)
 	return (inode->i_nlink);
 }
 
-static gfarm_int64_t
-inode_get_nlink_ini(struct inode *inode)
-{
-	return (inode->i_nlink_ini);
-}
-
-static void
-inode_increment_nlink_ini(struct inode *inode)
-{
-	++inode->i_nlink_ini;
-}
-
-static void
-inode_decrement_nlink_ini(struct inode *inode)
-{
-	--inode->i_nlink_ini;
-}
-
 struct user *
 inode_get_user(struct inode *inode)
 {
@@ -1835,6 +2376,8 @@ inode_set_size(struct inode *inode, gfarm_off_t size)
 
 	/* inode is file */
 	quota_update_file_resize(inode, size);
+	inode_usage_update(inode, size - inode->i_size,
+	    (size - inode->i_size) * inode_get_ncopy_with_dead_host(inode), 0);
 	inode_set_size_in_cache(inode, size);
 
 	e = db_inode_size_modify(inode->i_number, inode->i_size);
@@ -1919,44 +2462,59 @@ inode_set_owner(struct inode *inode, struct user *user, struct group *group)
 	return (GFARM_ERR_NO_ERROR);
 }
 
-struct gfarm_timespec *
+struct gfarm_timespec
 inode_get_atime(struct inode *inode)
 {
-	return (&inode->i_atimespec);
+	struct gfarm_timespec ts;
+
+	ts.tv_sec = inode->i_atime_sec;
+	ts.tv_nsec = inode->i_atime_nsec;
+	return (ts);
 }
 
-struct gfarm_timespec *
+struct gfarm_timespec
 inode_get_mtime(struct inode *inode)
 {
-	return (&inode->i_mtimespec);
+	struct gfarm_timespec ts;
+
+	ts.tv_sec = inode->i_mtime_sec;
+	ts.tv_nsec = inode->i_mtime_nsec;
+	return (ts);
 }
 
-struct gfarm_timespec *
+struct gfarm_timespec
 inode_get_ctime(struct inode *inode)
 {
-	return (&inode->i_ctimespec);
+	struct gfarm_timespec ts;
+
+	ts.tv_sec = inode->i_ctime_sec;
+	ts.tv_nsec = inode->i_ctime_nsec;
+	return (ts);
 }
 
 void
 inode_set_atime_in_cache(struct inode *inode, struct gfarm_timespec *atime)
 {
-	inode->i_atimespec = *atime;
+	inode->i_atime_sec = atime->tv_sec;
+	inode->i_atime_nsec = atime->tv_nsec;
 }
 
 static void
 inode_set_atime_main(struct inode *inode, struct gfarm_timespec *atime)
 {
 	gfarm_error_t e;
+	struct gfarm_timespec cur;
 
 	if (atime == NULL)
 		return;
 
-	if (gfarm_timespec_cmp(&inode->i_atimespec, atime) == 0)
+	cur = inode_get_atime(inode);
+	if (gfarm_timespec_cmp(&cur, atime) == 0)
 		return; /* not necessary to change */
 
 	inode_set_atime_in_cache(inode, atime);
 
-	e = db_inode_atime_modify(inode->i_number, &inode->i_atimespec);
+	e = db_inode_atime_modify(inode->i_number, atime);
 	if (e != GFARM_ERR_NO_ERROR)
 		gflog_error(GFARM_MSG_1000308,
 		    "db_inode_atime_modify(%lld): %s",
@@ -1987,18 +2545,21 @@ inode_set_atime_switch(struct inode *inode, struct gfarm_timespec *atime)
 static void
 inode_set_relatime_main(struct inode *inode, struct gfarm_timespec *atime)
 {
-	struct gfarm_timespec sub;
+	struct gfarm_timespec sub, cur_atime, cur_mtime, cur_ctime;
 	static struct gfarm_timespec a_day
 		= { .tv_sec = 24 * 60 * 60, .tv_nsec = 0 };
 
 	if (atime == NULL)
 		return;
 
+	cur_atime = inode_get_atime(inode);
+	cur_mtime = inode_get_mtime(inode);
+	cur_ctime = inode_get_ctime(inode);
 	sub = *atime;
-	gfarm_timespec_sub(&sub, &inode->i_atimespec);
+	gfarm_timespec_sub(&sub, &cur_atime);
 	if (gfarm_timespec_cmp(&sub, &a_day) <= 0 &&
-	    gfarm_timespec_cmp(&inode->i_atimespec, &inode->i_ctimespec) > 0 &&
-	    gfarm_timespec_cmp(&inode->i_atimespec, &inode->i_mtimespec) > 0)
+	    gfarm_timespec_cmp(&cur_atime, &cur_ctime) > 0 &&
+	    gfarm_timespec_cmp(&cur_atime, &cur_mtime) > 0)
 		return;
 
 	inode_set_atime(inode, atime);
@@ -2030,20 +2591,22 @@ inode_set_relatime_switch(struct inode *inode, struct gfarm_timespec *atime)
 void
 inode_set_mtime_in_cache(struct inode *inode, struct gfarm_timespec *mtime)
 {
-	inode->i_mtimespec = *mtime;
+	inode->i_mtime_sec = mtime->tv_sec;
+	inode->i_mtime_nsec = mtime->tv_nsec;
 }
 
 void
 inode_set_mtime(struct inode *inode, struct gfarm_timespec *mtime)
 {
 	gfarm_error_t e;
+	struct gfarm_timespec cur = inode_get_mtime(inode);
 
-	if (gfarm_timespec_cmp(&inode->i_mtimespec, mtime) == 0)
+	if (gfarm_timespec_cmp(&cur, mtime) == 0)
 		return; /* not necessary to change */
 
 	inode_set_mtime_in_cache(inode, mtime);
 
-	e = db_inode_mtime_modify(inode->i_number, inode_get_mtime(inode));
+	e = db_inode_mtime_modify(inode->i_number, mtime);
 	if (e != GFARM_ERR_NO_ERROR)
 		gflog_error(GFARM_MSG_1000309,
 		    "db_inode_mtime_modify(%lld): %s",
@@ -2054,20 +2617,22 @@ inode_set_mtime(struct inode *inode, struct gfarm_timespec *mtime)
 void
 inode_set_ctime_in_cache(struct inode *inode, struct gfarm_timespec *ctime)
 {
-	inode->i_ctimespec = *ctime;
+	inode->i_ctime_sec = ctime->tv_sec;
+	inode->i_ctime_nsec = ctime->tv_nsec;
 }
 
 void
 inode_set_ctime(struct inode *inode, struct gfarm_timespec *ctime)
 {
 	gfarm_error_t e;
+	struct gfarm_timespec cur = inode_get_ctime(inode);
 
-	if (gfarm_timespec_cmp(&inode->i_ctimespec, ctime) == 0)
+	if (gfarm_timespec_cmp(&cur, ctime) == 0)
 		return; /* not necessary to change */
 
 	inode_set_ctime_in_cache(inode, ctime);
 
-	e = db_inode_ctime_modify(inode->i_number, &inode->i_ctimespec);
+	e = db_inode_ctime_modify(inode->i_number, ctime);
 	if (e != GFARM_ERR_NO_ERROR)
 		gflog_error(GFARM_MSG_1000310,
 		    "db_inode_ctime_modify(%lld): %s",
@@ -2115,8 +2680,12 @@ inode_status_changed(struct inode *inode)
 void
 inode_created(struct inode *inode)
 {
-	touch(&inode->i_ctimespec);
-	inode->i_atimespec = inode->i_mtimespec = inode->i_ctimespec;
+	struct gfarm_timespec ts;
+
+	touch(&ts);
+	inode_set_atime_in_cache(inode, &ts);
+	inode_set_mtime_in_cache(inode, &ts);
+	inode_set_ctime_in_cache(inode, &ts);
 }
 
 Dir
@@ -2148,7 +2717,7 @@ struct dead_file_copy_list *
 inode_get_dead_copies(struct inode *inode)
 {
 	if (inode != NULL)
-		return (inode->dead_copies);
+		return (inode_dead_copies(inode));
 	return (NULL);
 }
 
@@ -2256,8 +2825,8 @@ inode_replication_start(struct inode *inode)
 	assert(ia != NULL);
 	if (ia->u.f.rstate != NULL)
 		file_replication_start(ia->u.f.rstate, inode->i_gen);
-	else if (inode->dead_copies != NULL)
-		dead_file_copy_inode_status_changed(inode->dead_copies);
+	else if (inode_dead_copies(inode) != NULL)
+		dead_file_copy_inode_status_changed(inode_dead_copies(inode));
 }
 
 gfarm_error_t
@@ -2453,9 +3022,9 @@ inode_db_init(struct inode *inode)
 	st.st_group = group_name(inode->i_group);
 	st.st_size = inode->i_size;
 	st.st_ncopy = 0;
-	st.st_atimespec = inode->i_atimespec;
-	st.st_mtimespec = inode->i_mtimespec;
-	st.st_ctimespec = inode->i_ctimespec;
+	st.st_atimespec = inode_get_atime(inode);
+	st.st_mtimespec = inode_get_mtime(inode);
+	st.st_ctimespec = inode_get_ctime(inode);
 	if (inode->i_gen == 0)
 		e = db_inode_add(&st);
 	else
@@ -2584,6 +3153,7 @@ inode_lookup_basename(struct inode *parent, const char *name, int len,
 		*inp = dir_entry_get_inode(entry);
 		(*inp)->i_nlink--;
 		dir_remove_entry(parent->u.c.s.d.entries, name, len);
+		inode_usage_detach(*inp, parent);
 		inode_modified(parent);
 
 		e = db_direntry_remove(parent->i_number, name, len);
@@ -2623,6 +3193,7 @@ inode_lookup_basename(struct inode *parent, const char *name, int len,
 		n = *inp;
 		n->i_nlink++;
 		dir_entry_set_inode(entry, n);
+		inode_usage_attach(n, parent);
 		inode_status_changed(n);
 		inode_modified(parent);
 
@@ -2700,6 +3271,7 @@ inode_lookup_basename(struct inode *parent, const char *name, int len,
 
 	inode_db_init(n);
 	quota_update_file_add(n);
+	inode_usage_attach(n, parent);
 
 	if (acl_def != NULL) {
 		assert(inode_is_dir(n));
@@ -2932,9 +3504,9 @@ inode_lookup_lost_found(void)
 		return (NULL);
 	}
 	if (created) {
-		root->i_nlink_ini++;
-		inode->i_nlink_ini = inode->i_nlink;
-		inode->u.c.s.d.parent_dir = root;
+		inode_increment_nlink_ini(root);
+		inode_set_nlink_ini(inode, inode->i_nlink);
+		inode_set_parent_dir_ini(inode, root);
 		gflog_info(GFARM_MSG_1002483, "create /%s directory",
 		    lost_found);
 	}
@@ -3088,7 +3660,7 @@ inode_dir_reparent(struct inode *dir_inode,
 	return (GFARM_ERR_NO_ERROR);
 }
 
-/* similar to inode_dir_reparent(), but use i_nlink_ini instead of i_nlink */
+/* similar to inode_dir_reparent(), but use nlink_ini instead of i_nlink */
 static void
 inode_dir_reparent_ini(struct inode *dir_inode,
 	struct inode *old_parent, struct inode *new_parent)
@@ -3188,10 +3760,10 @@ inode_link_to_lost_found(struct inode *inode)
 	    (unsigned long long)inode_get_gen(inode));
 	e = inode_create_link_internal(base, name, admin, inode);
 	if (e == GFARM_ERR_NO_ERROR) {
-		inode->i_nlink_ini++;
+		inode_increment_nlink_ini(inode);
 		if (inode_is_dir(inode)) {
 			inode_dir_check_and_repair_dotdot(inode, base);
-			inode->u.c.s.d.parent_dir = base;
+			inode_set_parent_dir_ini(inode, base);
 		}
 	}
 
@@ -3426,6 +3998,8 @@ inode_rename(
 				    "rename(%s, %s): failed to reparent: %s",
 				    sname, dname, gfarm_error_string(e));
 		}
+		/* the usage has been detached from sdir, if accounted there */
+		inode_usage_attach(src, ddir);
 
 		if (sdir != ddir && (inode_is_dir(src) || inode_is_file(src))
 		    && (!inode_has_desired_number(src, &num) &&
@@ -3611,10 +4185,12 @@ inode_close_read(struct file_opening *fo, struct gfarm_timespec *atime,
 	struct inode *inode = fo->inode;
 	struct inode_activity *ia = inode->u.c.activity;
 	int slave_mode = FLAG_IS_SLAVE_ONLY(fo->flag);
+	struct gfarm_timespec mtime;
 
 	if ((fo->flag & GFARM_FILE_TRUNC_PENDING) != 0) {
 		assert(!slave_mode);
-		inode_file_update(fo, 0, atime, &inode->i_mtimespec, 0,
+		mtime = inode_get_mtime(inode);
+		inode_file_update(fo, 0, atime, &mtime, 0,
 		    NULL, NULL, trace_logp);
 	} else if (atime != NULL && !slave_mode)
 		inode_set_relatime(inode, atime);
@@ -4301,12 +4877,13 @@ inode_remove_replica_in_cache(struct inode *inode, struct host *spool_host)
 	}
 	copy = *foundp;
 	*foundp = copy->host_next;
-	free(copy);
+	file_copy_free(copy);
 	return (GFARM_ERR_NO_ERROR);
 }
 
 gfarm_error_t
-inode_replication_new(struct inode *inode, struct host *src, struct host *dst,
+inode_replication_new(struct inode *inode, int priority,
+	struct host *src, struct host *dst,
 	struct dead_file_copy *deferred_cleanup,
 	struct file_replication **frp)
 {
@@ -4342,8 +4919,8 @@ inode_replication_new(struct inode *inode, struct host *src, struct host *dst,
 		ia_alloced = 1;
 	}
 
-	e = file_replication_new(inode, inode_get_gen(inode), src, dst,
-	    deferred_cleanup, &ia->u.f.rstate, &fr);
+	e = file_replication_new(inode, inode_get_gen(inode), priority,
+	    src, dst, deferred_cleanup, &ia->u.f.rstate, &fr);
 	if (e != GFARM_ERR_NO_ERROR) {
 		if (ia_alloced)
 			inode_activity_free_try(inode);
@@ -4459,8 +5036,9 @@ inode_replicated(struct file_replication *fr,
 		}
 	} else if (e == GFARM_ERR_NO_ERROR) {
 		/* try to sweep kept queue */
-		if (inode->dead_copies != NULL)
-			dead_file_copy_inode_status_changed(inode->dead_copies);
+		if (inode_dead_copies(inode) != NULL)
+			dead_file_copy_inode_status_changed(
+			    inode_dead_copies(inode));
 	}
 
 	inode_replication_free(fr);
@@ -4509,8 +5087,10 @@ inode_add_replica_internal(struct inode *inode, struct host *spool_host,
 			} else { /* file_copy is invalid */
 				assert(copy->flags == 0);
 				copy->flags |= FILE_COPY_VALID;
-				if (update_quota)
+				if (update_quota) {
 					quota_update_replica_add(inode);
+					inode_usage_replica_num(inode, 1);
+				}
 				return (GFARM_ERR_NO_ERROR);
 			}
 		}
@@ -4528,15 +5108,17 @@ inode_add_replica_internal(struct inode *inode, struct host *spool_host,
 		}
 	}
 
-	GFARM_MALLOC(copy);
+	copy = file_copy_alloc();
 	if (copy == NULL) {
 		gflog_debug(GFARM_MSG_1001768,
 			"allocation of 'copy' failed");
 		return (GFARM_ERR_NO_MEMORY);
 	}
 
-	if (update_quota && (flags & FILE_COPY_VALID) != 0)
+	if (update_quota && (flags & FILE_COPY_VALID) != 0) {
 		quota_update_replica_add(inode);
+		inode_usage_replica_num(inode, 1);
+	}
 
 	copy->host = spool_host;
 	copy->flags = flags;
@@ -4551,7 +5133,7 @@ inode_dead_file_copy_added(gfarm_ino_t inum, gfarm_int64_t igen,
 {
 	struct inode *inode = inode_lookup(inum);
 
-	/* maintain inode::dead_copies */
+	/* maintain inode::i_extra::dead_copies */
 	if (inode == NULL) {
 		inode = inode_alloc_num(inum);
 		if (inode == NULL) {
@@ -4561,7 +5143,14 @@ inode_dead_file_copy_added(gfarm_ino_t inum, gfarm_int64_t igen,
 		}
 		inode_clear(inode);
 	}
-	dead_file_copy_list_add(&inode->dead_copies, dfc);
+	if (inode_extra_get_or_alloc(inode) == NULL) {
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "inode %lld: no memory for dead_file_copy_list",
+		    (long long)inum);
+		return;
+	}
+	dead_file_copy_list_add(&inode->i_extra->dead_copies, dfc);
+	inode_extra_free_if_unused(inode);
 
 	if (!inode_is_file(inode))
 		return;
@@ -4611,6 +5200,7 @@ remove_replica_metadata(struct inode *inode, struct host *spool_host)
 	gfarm_error_t e;
 
 	quota_update_replica_remove(inode);
+	inode_usage_replica_num(inode, -1);
 
 	e = db_filecopy_remove(inode->i_number, host_name(spool_host));
 	if (e != GFARM_ERR_NO_ERROR)
@@ -4628,8 +5218,14 @@ remove_replica_entity(struct inode *inode, gfarm_int64_t gen,
 {
 	struct dead_file_copy *dfc;
 
-	dfc = dead_file_copy_new(inode->i_number, gen, spool_host,
-	    &inode->dead_copies);
+	if (inode_extra_get_or_alloc(inode) == NULL)
+		dfc = NULL;
+	else {
+		dfc = dead_file_copy_new(inode->i_number, gen, spool_host,
+		    &inode->i_extra->dead_copies);
+		if (dfc == NULL)
+			inode_extra_free_if_unused(inode);
+	}
 	if (dfc == NULL) {
 		gflog_error(GFARM_MSG_1002260,
 		    "removing old replica %lld:%lld host %s: no memory",
@@ -4654,16 +5250,18 @@ inode_remove_replica_completed(gfarm_ino_t inum, gfarm_int64_t igen,
 {
 	struct inode *inode = inode_lookup(inum), *inode2;
 
-	/* maintain inode::dead_copies */
+	/* maintain inode::i_extra::dead_copies */
 	if (inode != NULL) {
 		inode2 = inode;
 	} else {
-		assert(inum < inode_table_size);
-		inode2 = inode_table[inum];
+		inode2 = inode_table_get(inum);
 		assert(inode2 != NULL);
 	}
-	if (dead_file_copy_list_free_check(inode2->dead_copies))
-		inode2->dead_copies = NULL;
+	assert(inode_dead_copies(inode2) != NULL);
+	if (dead_file_copy_list_free_check(inode2->i_extra->dead_copies)) {
+		inode2->i_extra->dead_copies = NULL;
+		inode_extra_free_if_unused(inode2);
+	}
 
 	if (inode == NULL)
 		return;
@@ -4842,7 +5440,7 @@ inode_remove_replica_internal(struct inode *inode, struct host *spool_host,
 					copy->flags |= FILE_COPY_BEING_REMOVED;
 				} else {
 					*foundp = copy->host_next;
-					free(copy);
+					file_copy_free(copy);
 				}
 			}
 		} else {
@@ -4860,7 +5458,7 @@ inode_remove_replica_internal(struct inode *inode, struct host *spool_host,
 					e = GFARM_ERR_NO_ERROR;
 				}
 				*foundp = copy->host_next;
-				free(copy);
+				file_copy_free(copy);
 			} else {
 				gflog_debug(GFARM_MSG_1002487,
 				    "remove_replica_metadata(%lld, %lld, %s): "
@@ -4961,7 +5559,8 @@ inode_prepare_to_replicate(struct inode *inode, struct user *user,
 	if ((flags & GFS_REPLICATE_FILE_FORCE) == 0 &&
 	    inode_is_opened_for_writing(inode))
 		return (GFARM_ERR_FILE_BUSY); /* src is busy */
-	else if ((e = inode_replication_new(inode, src, dst, NULL, frp))
+	else if ((e = inode_replication_new(inode,
+	    FILE_REPLICATION_PRIORITY_USER, src, dst, NULL, frp))
 	    != GFARM_ERR_NO_ERROR)
 		return (e);
 
@@ -4977,7 +5576,7 @@ inode_is_updated(struct inode *inode, struct gfarm_timespec *mtime)
 
 	/*
 	 * ia->u.f.last_update is necessary,
-	 * becasuse i_mtimespec may be modified by GFM_PROTO_FUTIMES.
+	 * becasuse the mtime may be modified by GFM_PROTO_FUTIMES.
 	 */
 	return (ia != NULL &&
 	    gfarm_timespec_cmp(mtime, &ia->u.f.last_update) >= 0);
@@ -5092,7 +5691,7 @@ inode_replica_info_get(struct inode *inode, gfarm_int32_t iflags,
 	nlatest = inode_get_ncopy_common(inode, !show_incomplete, 0);
 
 	if (show_obsolete)
-		ndead = dead_file_copy_count_by_inode(inode->dead_copies,
+		ndead = dead_file_copy_count_by_inode(inode_dead_copies(inode),
 		    latest_gen, 0); /* include !host_is_up() */
 	else
 		ndead = 0;
@@ -5146,7 +5745,7 @@ inode_replica_info_get(struct inode *inode, gfarm_int32_t iflags,
 	}
 	if (e == GFARM_ERR_NO_ERROR && show_obsolete)
 		e = dead_file_copy_info_by_inode(
-		     inode->dead_copies, latest_gen,
+		     inode_dead_copies(inode), latest_gen,
 		     !show_down, &ndead, &hosts[i], &gens[i], &oflags[i]);
 
 	if (e != GFARM_ERR_NO_ERROR) {
@@ -5585,9 +6184,9 @@ inode_modify(struct inode *inode, struct gfs_stat *st)
 	inode->i_mode = st->st_mode;
 	inode_set_user_by_name_in_cache(inode, st->st_user);
 	inode_set_group_by_name_in_cache(inode, st->st_group);
-	inode->i_atimespec = st->st_atimespec;
-	inode->i_mtimespec = st->st_mtimespec;
-	inode->i_ctimespec = st->st_ctimespec;
+	inode_set_atime_in_cache(inode, &st->st_atimespec);
+	inode_set_mtime_in_cache(inode, &st->st_mtimespec);
+	inode_set_ctime_in_cache(inode, &st->st_ctimespec);
 }
 
 /* The memory owner of `*st' is changed to inode.c */
@@ -5866,7 +6465,7 @@ dir_entry_add(gfarm_ino_t dir_inum, char *entry_name, int entry_len,
 		    dir_inode != entry_inode /* avoid self reference */) {
 			/* XXX should avoid loop too */
 			/* remember parent */
-			entry_inode->u.c.s.d.parent_dir = dir_inode;
+			inode_set_parent_dir_ini(entry_inode, dir_inode);
 		}
 		e = GFARM_ERR_NO_ERROR;
 	}
@@ -6017,7 +6616,7 @@ inode_check_and_repair_dir(void *closure, struct inode *inode)
 
 	inode_dir_check_and_repair_dot(inode);
 
-	if ((parent = inode->u.c.s.d.parent_dir) != NULL) {
+	if ((parent = inode_get_parent_dir_ini(inode)) != NULL) {
 		inode_dir_check_and_repair_dotdot(inode, parent);
 	} else {
 		inode_link_to_lost_found_and_report(inode);
@@ -6055,7 +6654,7 @@ inode_check_and_repair_dir_entries(void *closure, struct inode *inode)
 		entry_name = dir_entry_get_name(entry, &entry_len);
 		if (inode_is_dir(entry_inode) &&
 		    !name_is_dot_or_dotdot(entry_name, entry_len) &&
-		    entry_inode->u.c.s.d.parent_dir != inode) {
+		    inode_get_parent_dir_ini(entry_inode) != inode) {
 			e = db_direntry_remove(inode_get_number(inode),
 			    entry_name, entry_len);
 			if (e != GFARM_ERR_NO_ERROR)
@@ -6071,7 +6670,7 @@ inode_check_and_repair_dir_entries(void *closure, struct inode *inode)
 			    "%llu and %llu (name %.*s): the latter is removed",
 			    (unsigned long long)inode_get_number(entry_inode),
 			    (unsigned long long)inode_get_number(
-			    entry_inode->u.c.s.d.parent_dir),
+			    inode_get_parent_dir_ini(entry_inode)),
 			    (unsigned long long)inode_get_number(inode),
 			    entry_len, entry_name);
 
@@ -6128,14 +6727,14 @@ inode_check_and_repair_nlink(void *closure, struct inode *inode)
 		    gfarm_error_string(e));
 }
 
-void
-inode_check_and_repair(void)
+static void
+inode_repair(void)
 {
 	gfarm_error_t e;
 	int transaction = 0;
 	int lost_found_modified = 0;
 	struct inode *lost_found;
-	static const char diag[] = "inode_check_and_repair";
+	static const char diag[] = "inode_repair";
 
 	if (db_begin(diag) == GFARM_ERR_NO_ERROR) /* to make things faster */
 		transaction = 1;
@@ -6144,7 +6743,7 @@ inode_check_and_repair(void)
 
 	/*
 	 * must be different pass from inode_check_and_repair_dir,
-	 * since this assumes that inode->u.c.s.d.parent_dir is set,
+	 * since this assumes that the parent_dir of inode_startup is set,
 	 * and inode_check_and_repair_dir() may set it.
 	 */
 	inode_lookup_all(NULL, inode_check_and_repair_dir_entries);
@@ -6175,6 +6774,284 @@ inode_check_and_repair(void)
 		db_end(diag);
 }
 
+/*
+ * returns 0, if inode_repair() would modify this inode or its entries.
+ * this only reads, thus can be called by multiple threads at once.
+ */
+static int
+inode_is_consistent(struct inode *inode)
+{
+	Dir dir;
+	DirEntry entry;
+	DirCursor cursor;
+	char *entry_name;
+	int entry_len;
+	struct inode *parent, *entry_inode;
+
+	if (inode_get_nlink(inode) != inode_get_nlink_ini(inode) ||
+	    inode_get_nlink_ini(inode) == 0)
+		return (0);
+	if (!inode_is_dir(inode))
+		return (1);
+
+	dir = inode->u.c.s.d.entries;
+	entry = dir_lookup(dir, dot, DOT_LEN);
+	if (entry == NULL || dir_entry_get_inode(entry) != inode)
+		return (0);
+	if ((parent = inode_get_parent_dir_ini(inode)) == NULL)
+		return (0);
+	entry = dir_lookup(dir, dotdot, DOTDOT_LEN);
+	if (entry == NULL || dir_entry_get_inode(entry) != parent)
+		return (0);
+
+	/* see inode_check_and_repair_dir_entries() */
+	if (!dir_cursor_set_pos(dir, 0, &cursor))
+		return (0);
+	do {
+		entry = dir_cursor_get_entry(dir, &cursor);
+		if (entry == NULL)
+			break;
+		entry_inode = dir_entry_get_inode(entry);
+		entry_name = dir_entry_get_name(entry, &entry_len);
+		if (inode_is_dir(entry_inode) &&
+		    !name_is_dot_or_dotdot(entry_name, entry_len) &&
+		    inode_get_parent_dir_ini(entry_inode) != inode)
+			return (0);
+	} while (dir_cursor_next(dir, &cursor));
+	return (1);
+}
+
+/* the state of a thread of inode_check_and_repair() */
+struct inode_check {
+	int check_namespace;
+	gfarm_uint64_t ninodes, ninconsistent;
+	struct quota_usage *quota_usage;
+};
+
+static void
+inode_check(void *closure, struct inode *inode)
+{
+	struct inode_check *c = closure;
+
+	c->ninodes++;
+	if (c->check_namespace && !inode_is_consistent(inode))
+		c->ninconsistent++;
+	quota_usage_add(c->quota_usage, inode);
+}
+
+/*
+ * the namespace check and quota_check() are done by a single sweep
+ * of the inode table by gfarm_metadb_check_parallel threads.
+ * the namespace is only modified by inode_repair(), if the sweep finds
+ * an inconsistent inode.
+ * if check_namespace is 0, only the quota usage is counted.
+ */
+void
+inode_check_and_repair(int check_namespace)
+{
+	int i, ok = 1, nthreads = gfarm_metadb_check_parallel;
+	struct inode_check *checks;
+	void **closures;
+	gfarm_uint64_t ninodes = 0, ninconsistent = 0;
+	struct timeval t1, t2;
+	static const char diag[] = "inode_check_and_repair";
+
+	if (nthreads < 1)
+		nthreads = 1;
+	GFARM_CALLOC_ARRAY(checks, nthreads);
+	GFARM_MALLOC_ARRAY(closures, nthreads);
+	if (checks == NULL || closures == NULL)
+		ok = 0;
+	for (i = 0; ok && i < nthreads; i++) {
+		checks[i].check_namespace = check_namespace;
+		checks[i].ninodes = checks[i].ninconsistent = 0;
+		if ((checks[i].quota_usage = quota_usage_alloc()) == NULL)
+			ok = 0;
+		closures[i] = &checks[i];
+	}
+	if (!ok) {
+		gflog_warning(GFARM_MSG_UNFIXED,
+		    "%s: no memory for threads, run sequentially", diag);
+		if (check_namespace)
+			inode_repair();
+		quota_check();
+	} else {
+		gettimeofday(&t1, NULL);
+		quota_check_begin();
+		inode_lookup_all_parallel(nthreads, closures, inode_check);
+		for (i = 0; i < nthreads; i++) {
+			ninodes += checks[i].ninodes;
+			ninconsistent += checks[i].ninconsistent;
+			if (ok)
+				ok = quota_usage_merge(checks[i].quota_usage);
+		}
+		if (ok)
+			quota_check_end();
+		gettimeofday(&t2, NULL);
+		gfarm_timeval_sub(&t2, &t1);
+		if (check_namespace)
+			gflog_info(GFARM_MSG_UNFIXED,
+			    "filesystem check: %llu inodes, %llu inconsistent, "
+			    "%d threads, %ld.%03d sec",
+			    (unsigned long long)ninodes,
+			    (unsigned long long)ninconsistent, nthreads,
+			    (long)t2.tv_sec, (int)(t2.tv_usec / 1000));
+		else
+			gflog_info(GFARM_MSG_UNFIXED,
+			    "quota check: %llu inodes, %d threads, "
+			    "%ld.%03d sec (namespace check is skipped)",
+			    (unsigned long long)ninodes, nthreads,
+			    (long)t2.tv_sec, (int)(t2.tv_usec / 1000));
+
+		if (ninconsistent > 0) {
+			inode_repair();
+			ok = 0; /* lost+found may be created */
+		}
+		if (!ok)
+			quota_check();
+	}
+	if (checks != NULL) {
+		for (i = 0; i < nthreads; i++)
+			quota_usage_free(checks[i].quota_usage);
+	}
+	free(checks);
+	free(closures);
+}
+
+static void
+inode_usage_clear(void *closure, struct inode *inode)
+{
+	inode->u.c.parent = NULL;
+	if (inode_is_dir(inode))
+		dir_usage_clear(inode->u.c.s.d.entries);
+}
+
+/* a directory being traversed by inode_usage_check() */
+struct inode_usage_frame {
+	struct inode *dir;
+	DirCursor cursor;
+};
+
+#define INODE_USAGE_STACK_INITIAL	64
+
+/*
+ * compute the usage of all directory trees from scratch by a depth-first
+ * traversal from the root directory, and start to maintain it.
+ * this is called by the master gfmd whenever quota_check() is done.
+ */
+void
+inode_usage_check(void)
+{
+	struct inode_usage_frame *stack, *top, *new_stack;
+	int depth, stack_size = INODE_USAGE_STACK_INITIAL;
+	struct inode *root = inode_lookup(ROOT_INUMBER), *inode;
+	Dir dir;
+	DirEntry entry;
+	char *name;
+	int namelen;
+	struct dir_usage u;
+	gfarm_uint64_t ndirs = 0;
+	struct timeval t1, t2;
+	static const char diag[] = "inode_usage_check";
+
+	inode_usage_available = 0;
+	if (root == NULL || !inode_is_dir(root)) {
+		gflog_error(GFARM_MSG_UNFIXED, "%s: no root directory", diag);
+		return;
+	}
+	GFARM_MALLOC_ARRAY(stack, stack_size);
+	if (stack == NULL) {
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "%s: no memory, directory usage is unavailable", diag);
+		return;
+	}
+	gettimeofday(&t1, NULL);
+	inode_lookup_all(NULL, inode_usage_clear);
+
+	depth = 0;
+	stack[depth].dir = root;
+	if (!dir_cursor_set_pos(root->u.c.s.d.entries, 0,
+	    &stack[depth].cursor))
+		stack[depth].cursor = NULL;
+	depth++;
+	while (depth > 0) {
+		top = &stack[depth - 1];
+		dir = top->dir->u.c.s.d.entries;
+		entry = dir_cursor_get_entry(dir, &top->cursor);
+		if (entry == NULL) { /* the usage of top->dir is fixed */
+			ndirs++;
+			if (--depth > 0) {
+				inode_usage_total(top->dir, &u);
+				dir_usage_add(dir_get_usage(
+				    stack[depth - 1].dir->u.c.s.d.entries),
+				    &u, 1);
+			}
+			continue;
+		}
+		(void)dir_cursor_next(dir, &top->cursor);
+
+		inode = dir_entry_get_inode(entry);
+		name = dir_entry_get_name(entry, &namelen);
+		if (name_is_dot_or_dotdot(name, namelen) ||
+		    inode == root || inode->u.c.parent != NULL)
+			continue; /* already accounted */
+		inode->u.c.parent = top->dir;
+		if (!inode_is_dir(inode)) {
+			inode_usage_own(inode, &u);
+			dir_usage_add(dir_get_usage(dir), &u, 1);
+			continue;
+		}
+
+		/* descend, and this is accounted when it's finished */
+		if (depth >= stack_size) {
+			GFARM_REALLOC_ARRAY(new_stack, stack, stack_size * 2);
+			if (new_stack == NULL) {
+				gflog_error(GFARM_MSG_UNFIXED,
+				    "%s: no memory for depth %d, "
+				    "directory usage is unavailable",
+				    diag, depth);
+				free(stack);
+				return;
+			}
+			stack = new_stack;
+			stack_size *= 2;
+		}
+		stack[depth].dir = inode;
+		if (!dir_cursor_set_pos(inode->u.c.s.d.entries, 0,
+		    &stack[depth].cursor))
+			stack[depth].cursor = NULL;
+		depth++;
+	}
+	free(stack);
+	inode_usage_available = 1;
+
+	gettimeofday(&t2, NULL);
+	gfarm_timeval_sub(&t2, &t1);
+	gflog_info(GFARM_MSG_UNFIXED,
+	    "directory usage check: %llu directories, %ld.%03d sec",
+	    (unsigned long long)ndirs,
+	    (long)t2.tv_sec, (int)(t2.tv_usec / 1000));
+}
+
+/* the total usage of the files and directories under the directory */
+gfarm_error_t
+inode_get_usage(struct inode *inode, gfarm_int64_t *spacep,
+	gfarm_int64_t *nump, gfarm_int64_t *phy_spacep, gfarm_int64_t *phy_nump)
+{
+	struct dir_usage *u;
+
+	if (!inode_is_dir(inode))
+		return (GFARM_ERR_NOT_A_DIRECTORY);
+	if (!inode_usage_available)
+		return (GFARM_ERR_OPERATION_NOT_SUPPORTED);
+	u = dir_get_usage(inode->u.c.s.d.entries);
+	*spacep = u->space;
+	*nump = u->num;
+	*phy_spacep = u->phy_space;
+	*phy_nump = u->phy_num;
+	return (GFARM_ERR_NO_ERROR);
+}
+
 void
 dir_entry_init(void)
 {
@@ -6186,14 +7063,14 @@ dir_entry_init(void)
 		gflog_error(GFARM_MSG_1000363,
 		    "loading direntry: %s", gfarm_error_string(e));
 
-	/* setup root->u.c.s.d.parent_dir */
+	/* setup the parent_dir of the root */
 	root = inode_lookup(ROOT_INUMBER);
 	if (root == NULL) {
 		gflog_error(GFARM_MSG_1002843,
 		    "dir_entry_init: no root directory");
 		return;
 	}
-	root->u.c.s.d.parent_dir = root;
+	inode_set_parent_dir_ini(root, root);
 }
 
 void
@@ -6321,8 +7198,9 @@ xattr_add_one(void *closure, struct xattr_info *info)
 		else
 			xattr_defer_db_removal(info);
 	} else {
-		xattrs = (xmlMode ? &inode->i_xmlattrs : &inode->i_xattrs);
-		if (xattr_add(xattrs, xmlMode, info->attrname,
+		xattrs = inode_xattrs_get_or_alloc(inode, xmlMode);
+		if (xattrs == NULL ||
+		    xattr_add(xattrs, xmlMode, info->attrname,
 		    info->attrvalue, info->attrsize) == NULL)
 			gflog_error(GFARM_MSG_1000367, "xattr_add_one: "
 				"cannot add attrname %s to %lld",
@@ -6370,6 +7248,8 @@ xattr_find(struct xattrs *xattrs, const char *attrname)
 {
 	struct xattr_entry *entry;
 
+	if (xattrs == NULL) /* the inode has no xattr */
+		return NULL;
 	entry = xattrs->head;
 	while (entry != NULL) {
 		if (strcmp(entry->name, attrname) == 0) {
@@ -6383,7 +7263,7 @@ xattr_find(struct xattrs *xattrs, const char *attrname)
 int
 inode_xattr_has_attr(struct inode *inode, int xmlMode, const char *attrname)
 {
-	struct xattrs *xattrs = xmlMode ? &inode->i_xmlattrs : &inode->i_xattrs;
+	struct xattrs *xattrs = inode_xattrs_get(inode, xmlMode);
 
 	return (xattr_find(xattrs, attrname) != NULL);
 }
@@ -6393,10 +7273,11 @@ inode_xattr_add(struct inode *inode, int xmlMode, const char *attrname,
 	void *value, size_t size)
 {
 	gfarm_error_t e;
-	struct xattrs *xattrs =
-		xmlMode ? &inode->i_xmlattrs : &inode->i_xattrs;
+	struct xattrs *xattrs = inode_xattrs_get_or_alloc(inode, xmlMode);
 
-	if (xattr_find(xattrs, attrname) != NULL) {
+	if (xattrs == NULL) {
+		e = GFARM_ERR_NO_MEMORY;
+	} else if (xattr_find(xattrs, attrname) != NULL) {
 		gflog_debug(GFARM_MSG_1001779,
 			"xattr of inode already exists: %s", attrname);
 		e = GFARM_ERR_ALREADY_EXISTS;
@@ -6414,8 +7295,7 @@ gfarm_error_t
 inode_xattr_modify(struct inode *inode, int xmlMode, const char *attrname,
 	void *value, size_t size)
 {
-	struct xattrs *xattrs =
-		xmlMode ? &inode->i_xmlattrs : &inode->i_xattrs;
+	struct xattrs *xattrs = inode_xattrs_get(inode, xmlMode);
 	struct xattr_entry *entry = xattr_find(xattrs, attrname);
 
 	if (entry == NULL)
@@ -6445,8 +7325,7 @@ gfarm_error_t
 inode_xattr_get_cache(struct inode *inode, int xmlMode,
 	const char *attrname, void **cached_valuep, size_t *cached_sizep)
 {
-	struct xattrs *xattrs =
-		xmlMode ? &inode->i_xmlattrs : &inode->i_xattrs;
+	struct xattrs *xattrs = inode_xattrs_get(inode, xmlMode);
 	struct xattr_entry *entry;
 	void *r;
 
@@ -6472,8 +7351,7 @@ int
 inode_xattr_cache_is_same(struct inode *inode, int xmlMode,
 	const char *attrname, const void *value, size_t size)
 {
-	struct xattrs *xattrs =
-		xmlMode ? &inode->i_xmlattrs : &inode->i_xattrs;
+	struct xattrs *xattrs = inode_xattrs_get(inode, xmlMode);
 	struct xattr_entry *entry = xattr_find(xattrs, attrname);
 
 	if (entry == NULL || entry->cached_attrvalue == NULL) {
@@ -6520,8 +7398,8 @@ inode_xattr_list_get_cached_by_patterns(gfarm_ino_t inum,
 	if (inode == NULL)
 		return (GFARM_ERR_NO_SUCH_FILE_OR_DIRECTORY);
 
-	xattrs = &inode->i_xattrs;
-	entry = xattrs->head;
+	xattrs = inode_xattrs_get(inode, 0);
+	entry = xattrs == NULL ? NULL : xattrs->head;
 	if (entry == NULL) {
 		*np = 0;
 		*listp = NULL;
@@ -6581,7 +7459,8 @@ int
 inode_xattr_has_xmlattrs(struct inode *inode)
 {
 #ifdef ENABLE_XMLATTR
-	return (inode->i_xmlattrs.head != NULL);
+	return (inode->i_extra != NULL &&
+	    inode->i_extra->xmlattrs.head != NULL);
 #else
 	return 0;
 #endif
@@ -6590,7 +7469,7 @@ inode_xattr_has_xmlattrs(struct inode *inode)
 gfarm_error_t
 inode_xattr_remove(struct inode *inode, int xmlMode, const char *attrname)
 {
-	struct xattrs *xattrs = xmlMode ? &inode->i_xmlattrs : &inode->i_xattrs;
+	struct xattrs *xattrs = inode_xattrs_get(inode, xmlMode);
 	struct xattr_entry *entry, *prev, *next;
 
 	entry = xattr_find(xattrs, attrname);
@@ -6617,7 +7496,7 @@ inode_xattr_remove(struct inode *inode, int xmlMode, const char *attrname)
 gfarm_error_t
 inode_xattr_list(struct inode *inode, int xmlMode, char **namesp, size_t *sizep)
 {
-	struct xattrs *xattrs = xmlMode ? &inode->i_xmlattrs : &inode->i_xattrs;
+	struct xattrs *xattrs = inode_xattrs_get(inode, xmlMode);
 	struct xattr_entry *entry = NULL;
 	char *names, *p;
 	int size = 0, len;
@@ -6625,6 +7504,8 @@ inode_xattr_list(struct inode *inode, int xmlMode, char **namesp, size_t *sizep)
 	*namesp = NULL;
 	*sizep = 0;
 
+	if (xattrs == NULL)
+		return GFARM_ERR_NO_ERROR;
 	entry = xattrs->head;
 	while (entry != NULL) {
 		size += (strlen(entry->name) + 1);
@@ -6698,7 +7579,8 @@ inode_xattr_convert_desired_number(
 int
 inode_has_desired_number(struct inode *inode, int *desired_numberp)
 {
-	struct xattr_entry *ent = xattr_find(&inode->i_xattrs, "gfarm.ncopy");
+	struct xattr_entry *ent =
+	    xattr_find(inode_xattrs_get(inode, 0), "gfarm.ncopy");
 
 	if (ent == NULL || ent->cached_attrvalue == NULL)
 		return (0);
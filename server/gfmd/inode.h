@@ -55,9 +55,9 @@ gfarm_off_t inode_get_size(struct inode *);
 void inode_set_size(struct inode *, gfarm_off_t);
 void inode_set_size_in_cache(struct inode *, gfarm_off_t);
 gfarm_error_t inode_set_owner(struct inode *, struct user *, struct group *);
-struct gfarm_timespec *inode_get_atime(struct inode *);
-struct gfarm_timespec *inode_get_mtime(struct inode *);
-struct gfarm_timespec *inode_get_ctime(struct inode *);
+struct gfarm_timespec inode_get_atime(struct inode *);
+struct gfarm_timespec inode_get_mtime(struct inode *);
+struct gfarm_timespec inode_get_ctime(struct inode *);
 extern void (*inode_set_relatime)(struct inode *, struct gfarm_timespec *);
 extern void (*inode_set_atime)(struct inode *, struct gfarm_timespec *);
 void inode_set_atime_in_cache(struct inode *, struct gfarm_timespec *);
@@ -95,9 +95,14 @@ gfarm_error_t inode_access(struct inode *, struct user *, int);
 
 gfarm_ino_t inode_root_number();
 gfarm_ino_t inode_table_current_size();
+void inode_memory_usage(gfarm_uint64_t *, gfarm_uint64_t *,
+	gfarm_uint64_t *);
+void file_copy_memory_usage(gfarm_uint64_t *, gfarm_uint64_t *);
 struct inode *inode_lookup(gfarm_ino_t);
 struct inode *inode_lookup_including_free(gfarm_ino_t);
 void inode_lookup_all(void *, void (*callback)(void *, struct inode *));
+void inode_lookup_all_parallel(int, void **,
+	void (*callback)(void *, struct inode *));
 
 gfarm_error_t inode_lookup_root(struct process *, int, struct inode **);
 gfarm_error_t inode_lookup_parent(struct inode *, struct process *, int,
@@ -138,13 +143,13 @@ int inode_is_updated(struct inode *, struct gfarm_timespec *);
 gfarm_error_t dir_entry_add(gfarm_ino_t, char *, int, gfarm_ino_t);
 
 gfarm_error_t inode_schedule_replication_within_scope(
-	struct inode *, int,
+	struct inode *, int, int,
 	int, struct host **, int *,
 	int *, struct host **,
 	int *, struct host **, gfarm_time_t,
 	int *, struct host **, const char *, int *);
 gfarm_error_t inode_schedule_replication_from_all(
-	struct inode *, int,
+	struct inode *, int, int,
 	int, struct host **,
 	int *, struct host **, gfarm_time_t,
 	int *, struct host **, const char *, int *);
@@ -193,7 +198,7 @@ extern gfarm_error_t (*inode_schedule_file)(struct file_opening *,
 
 struct file_replication;
 void inode_replication_start(struct inode *);
-gfarm_error_t inode_replication_new(struct inode *, struct host *,
+gfarm_error_t inode_replication_new(struct inode *, int, struct host *,
 	struct host *, struct dead_file_copy *,
 	struct file_replication **);
 gfarm_error_t inode_replicated(struct file_replication *,
@@ -248,7 +253,11 @@ int inode_search_replica_spec(struct inode *, char **, int *);
 
 void inode_remove_orphan(void);
 void inode_free_orphan(void);
-void inode_check_and_repair(void);
+void inode_check_and_repair(int);
+void inode_usage_check(void);
+gfarm_error_t inode_get_usage(struct inode *,
+	gfarm_int64_t *, gfarm_int64_t *, gfarm_int64_t *, gfarm_int64_t *);
+void inode_startup_done(void);
 
 gfarm_error_t inode_create_file_in_lost_found(
 	struct host *, gfarm_ino_t, gfarm_uint64_t, gfarm_off_t,
@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
+#include <time.h>
 #include <netdb.h> /* for NI_MAXHOST, NI_NUMERICHOST, etc */
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -36,10 +37,14 @@
 #include "remote_peer.h"
 #include "process.h"
 #include "iostat.h"
+#include "callout.h"
 
 #include "protocol_state.h"
 #include "peer_impl.h"
 
+/* release the buffers of a client connection idle for this seconds */
+#define LOCAL_PEER_SHRINK_IDLE_TIME	30
+
 #define BACK_CHANNEL_DIAG(peer) (peer_get_auth_id_type(peer) == \
 	GFARM_AUTH_ID_TYPE_SPOOL_HOST ? "back_channel" : "gfmd_channel")
 
@@ -54,6 +59,10 @@ struct local_peer {
 	struct peer_watcher *readable_watcher;
 	struct watcher_event *readable_event;
 
+	/* see local_peer_set_idle(), 0 if busy or already shrunk */
+	time_t idle_since;
+	pthread_mutex_t idle_mutex;
+
 	struct remote_peer *child_peers;
 	pthread_mutex_t child_peers_mutex;
 
@@ -67,6 +76,9 @@ static int local_peer_table_size, local_peer_initialized;
 static pthread_mutex_t local_peer_table_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static const char local_peer_table_diag[] = "local_peer_table";
+static const char IDLE_MUTEX_DIAG[] = "idle_mutex";
+
+static struct callout *local_peer_shrink_callout;
 
 /* to wait for completion of local_peer_shutdown_all() */
 static struct gfarm_thr_statewait local_peer_shutdown_all_completed;
@@ -489,6 +501,7 @@ local_peer_alloc0(int fd, struct gfp_xdr *conn,
 	local_peer->conn = conn;
 	local_peer->async = NULL; /* synchronous protocol by default */
 	local_peer->master_private_peer_id = 0;
+	local_peer->idle_since = 0;
 
 	if (local_peer->readable_event == NULL) {
 		e = watcher_fd_readable_event_alloc(fd,
@@ -563,8 +576,11 @@ local_peer_authorized(struct local_peer *local_peer,
 
 	if (gfp_xdr_recv_is_ready(local_peer->conn))
 		peer_watcher_schedule(readable_watcher, local_peer);
-	else
+	else {
+		/* the synchronous protocol, until switched to a channel */
+		local_peer_set_idle(local_peer);
 		local_peer_watch_readable(local_peer);
+	}
 }
 
 void
@@ -583,12 +599,79 @@ local_peer_set_readable_watcher(struct local_peer *local_peer,
 void
 local_peer_readable_invoked(struct local_peer *local_peer)
 {
+	static const char diag[] = "local_peer_readable_invoked";
+
+	/* local_peer_shrink_idle() must not touch the connection any more */
+	gfarm_mutex_lock(&local_peer->idle_mutex, diag, IDLE_MUTEX_DIAG);
+	local_peer->idle_since = 0;
+	gfarm_mutex_unlock(&local_peer->idle_mutex, diag, IDLE_MUTEX_DIAG);
+
 	watcher_event_ack(local_peer->readable_event);
 	peer_del_ref(local_peer_to_peer(local_peer));
 
 	peer_closer_wakeup(&local_peer->super);
 }
 
+/*
+ * the connection of the synchronous protocol becomes idle,
+ * and nothing uses it until local_peer_readable_invoked().
+ * this must be called before local_peer_watch_readable().
+ */
+void
+local_peer_set_idle(struct local_peer *local_peer)
+{
+	static const char diag[] = "local_peer_set_idle";
+
+	gfarm_mutex_lock(&local_peer->idle_mutex, diag, IDLE_MUTEX_DIAG);
+	local_peer->idle_since = time(NULL);
+	gfarm_mutex_unlock(&local_peer->idle_mutex, diag, IDLE_MUTEX_DIAG);
+}
+
+/* release the buffers of connections which have been idle for a while */
+static void *
+local_peer_shrink_idle(void *arg)
+{
+	int i;
+	struct local_peer *local_peer;
+	time_t now = time(NULL);
+	static const char diag[] = "local_peer_shrink_idle";
+
+	gfarm_mutex_lock(&local_peer_table_mutex, diag, local_peer_table_diag);
+	for (i = 0; i < local_peer_table_size; i++) {
+		local_peer = &local_peer_table[i];
+		if (local_peer->conn == NULL)
+			continue;
+		gfarm_mutex_lock(&local_peer->idle_mutex,
+		    diag, IDLE_MUTEX_DIAG);
+		if (local_peer->idle_since != 0 &&
+		    now - local_peer->idle_since >=
+		    LOCAL_PEER_SHRINK_IDLE_TIME) {
+			gfp_xdr_shrink(local_peer->conn);
+			local_peer->idle_since = 0;
+		}
+		gfarm_mutex_unlock(&local_peer->idle_mutex,
+		    diag, IDLE_MUTEX_DIAG);
+	}
+	gfarm_mutex_unlock(&local_peer_table_mutex,
+	    diag, local_peer_table_diag);
+
+	callout_schedule(local_peer_shrink_callout,
+	    LOCAL_PEER_SHRINK_IDLE_TIME * 1000000);
+	return (NULL);
+}
+
+void
+local_peer_shrink_idle_start(struct thread_pool *thrpool)
+{
+	local_peer_shrink_callout = callout_new();
+	if (local_peer_shrink_callout == NULL)
+		gflog_fatal(GFARM_MSG_UNFIXED,
+		    "local_peer_shrink_idle_start: no memory");
+	callout_reset(local_peer_shrink_callout,
+	    LOCAL_PEER_SHRINK_IDLE_TIME * 1000000,
+	    thrpool, local_peer_shrink_idle, NULL);
+}
+
 void
 local_peer_watch_readable(struct local_peer *local_peer)
 {
@@ -698,6 +781,10 @@ local_peer_init(int max_peers)
 		local_peer->readable_watcher = NULL;
 		local_peer->readable_event = NULL;
 
+		local_peer->idle_since = 0;
+		gfarm_mutex_init(&local_peer->idle_mutex,
+		    diag, "peer:idle_mutex");
+
 		/*
 		 * to support remote peer
 		 */
@@ -4,6 +4,7 @@ struct peer;
 struct gfp_xdr;
 struct abstract_host;
 struct peer_watcher;
+struct thread_pool;
 
 struct peer *local_peer_to_peer(struct local_peer *);
 enum peer_type local_peer_get_peer_type(struct local_peer *);
@@ -22,6 +23,8 @@ void local_peer_set_readable_watcher(struct local_peer *,
 	struct peer_watcher *);
 void local_peer_readable_invoked(struct local_peer *);
 void local_peer_watch_readable(struct local_peer *);
+void local_peer_set_idle(struct local_peer *);
+void local_peer_shrink_idle_start(struct thread_pool *);
 void peer_set_readable_watcher(struct peer *, struct peer_watcher *);
 
 void local_peer_shutdown_all_prepare_to_wait(void);
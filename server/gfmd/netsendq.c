@@ -203,6 +203,20 @@ netsendq_window_is_full(struct netsendq *qhost, struct netsendq_type *type)
 	return (is_full);
 }
 
+int
+netsendq_inflight_number(struct netsendq *qhost, struct netsendq_type *type)
+{
+	int n;
+	struct netsendq_workq *workq;
+	static const char diag[] = "netsendq_inflight_number";
+
+	workq = &qhost->workqs[type->type_index];
+	gfarm_mutex_lock(&workq->mutex, diag, "workq");
+	n = workq->inflight_number;
+	gfarm_mutex_unlock(&workq->mutex, diag, "workq");
+	return (n);
+}
+
 gfarm_error_t
 netsendq_add_entry(struct netsendq *qhost, struct netsendq_entry *entry,
 	int flags)
@@ -1343,7 +1343,7 @@ process_replica_added(struct process *process,
 	gfarm_off_t size)
 {
 	struct file_opening *fo;
-	struct gfarm_timespec *mtime;
+	struct gfarm_timespec mtime;
 	gfarm_error_t e = process_get_file_opening(process, fd, &fo), e2;
 	static const char diag[] = "process_replica_added";
 
@@ -1389,8 +1389,8 @@ process_replica_added(struct process *process,
 		    diag, (long long)inode_get_number(fo->inode),
 		    host_name(spool_host), gfarm_error_string(e));
 	} else if (inode_is_opened_for_writing(fo->inode) ||
-	    mtime_sec != (mtime = inode_get_mtime(fo->inode))->tv_sec ||
-	    mtime_nsec != mtime->tv_nsec ||
+	    mtime_sec != (mtime = inode_get_mtime(fo->inode)).tv_sec ||
+	    mtime_nsec != mtime.tv_nsec ||
 	    (size != -1 && size != inode_get_size(fo->inode)) ||
 	    fo->u.f.replica_source->gen != inode_get_gen(fo->inode)) {
 		gflog_warning(GFARM_MSG_1002244,
@@ -1399,8 +1399,8 @@ process_replica_added(struct process *process,
 		    "size: %lld/%lld, gen:%lld/%lld",
 		    (long long)inode_get_number(fo->inode),
 		    (long long)mtime_sec, (long long)mtime_nsec,
-		    (long long)inode_get_mtime(fo->inode)->tv_sec,
-		    (long long)inode_get_mtime(fo->inode)->tv_nsec,
+		    (long long)inode_get_mtime(fo->inode).tv_sec,
+		    (long long)inode_get_mtime(fo->inode).tv_nsec,
 		    (long long)size, (long long)inode_get_size(fo->inode),
 		    (long long)fo->u.f.replica_source->gen,
 		    (long long)inode_get_gen(fo->inode));
@@ -14,6 +14,8 @@
 
 #include "gfp_xdr.h"
 #include "auth.h"
+#include "hash.h"
+#include "config.h"
 
 #include "peer.h"
 #include "subr.h"
@@ -32,10 +34,34 @@
 
 static gfarm_error_t db_state = GFARM_ERR_NO_ERROR;
 
+/*
+ * the current time, which is only read when it is actually used,
+ * because most of quota updates and checks don't need it.
+ */
+struct quota_now {
+	int valid;
+	gfarm_time_t sec;
+};
+
+#define QUOTA_NOW_INITIALIZER	{ 0, 0 }
+
+static gfarm_time_t
+quota_now_get(struct quota_now *now)
+{
+	struct timeval tv;
+
+	if (!now->valid) {
+		gettimeofday(&tv, NULL);
+		now->sec = tv.tv_sec;
+		now->valid = 1;
+	}
+	return (now->sec);
+}
+
 /* private functions */
 static void
-update_softlimit(gfarm_time_t *exceedp, gfarm_time_t now, gfarm_time_t grace,
-		gfarm_int64_t val, gfarm_int64_t soft)
+update_softlimit(gfarm_time_t *exceedp, struct quota_now *now,
+		gfarm_time_t grace, gfarm_int64_t val, gfarm_int64_t soft)
 {
 	if (!quota_limit_is_valid(grace) /* disable all softlimit */ ||
 	    !quota_limit_is_valid(soft) /* disable this softlimit */ ||
@@ -46,13 +72,13 @@ update_softlimit(gfarm_time_t *exceedp, gfarm_time_t now, gfarm_time_t grace,
 	} else if (*exceedp >= 0)
 		return; /* already exceeded */
 	else if (val > soft)
-		*exceedp = now; /* exceed now */
+		*exceedp = quota_now_get(now); /* exceed now */
 }
 
 static void
 quota_check_softlimit_exceed(struct quota *q)
 {
-	struct timeval now;
+	struct quota_now now = QUOTA_NOW_INITIALIZER;
 
 	if (!quota_limit_is_valid(q->grace_period)) {
 		/* disable all softlimit */
@@ -64,14 +90,13 @@ quota_check_softlimit_exceed(struct quota *q)
 	}
 
 	/* update exceeded time of softlimit */
-	gettimeofday(&now, NULL);
-	update_softlimit(&q->space_exceed, now.tv_sec, q->grace_period,
+	update_softlimit(&q->space_exceed, &now, q->grace_period,
 			 q->space, q->space_soft);
-	update_softlimit(&q->num_exceed, now.tv_sec, q->grace_period,
+	update_softlimit(&q->num_exceed, &now, q->grace_period,
 			 q->num, q->num_soft);
-	update_softlimit(&q->phy_space_exceed, now.tv_sec, q->grace_period,
+	update_softlimit(&q->phy_space_exceed, &now, q->grace_period,
 			 q->phy_space, q->phy_space_soft);
-	update_softlimit(&q->phy_num_exceed, now.tv_sec, q->grace_period,
+	update_softlimit(&q->phy_num_exceed, &now, q->grace_period,
 			 q->phy_num, q->phy_num_soft);
 }
 
@@ -402,6 +427,191 @@ quota_update_file_add_for_quotacheck(void *closure, struct inode *inode)
 	quota_update_file_add(inode);
 }
 
+/*
+ * the usage counted by a thread of the parallel quota check.
+ * quota_usage_merge() adds it to struct quota after all threads finish.
+ */
+struct quota_usage_value {
+	gfarm_int64_t space, num, phy_space, phy_num;
+};
+
+struct quota_usage {
+	struct gfarm_hash_table *users, *groups;
+	int no_memory;
+
+	/* consecutive inodes are likely to have the same owner */
+	struct user *last_user;
+	struct group *last_group;
+	struct quota_usage_value *last_user_value, *last_group_value;
+};
+
+#define QUOTA_USAGE_HASHTAB_SIZE	257
+
+struct quota_usage *
+quota_usage_alloc(void)
+{
+	struct quota_usage *qu;
+
+	GFARM_MALLOC(qu);
+	if (qu == NULL)
+		return (NULL);
+	qu->users = gfarm_hash_table_alloc(QUOTA_USAGE_HASHTAB_SIZE,
+	    gfarm_hash_default, gfarm_hash_key_equal_default);
+	qu->groups = gfarm_hash_table_alloc(QUOTA_USAGE_HASHTAB_SIZE,
+	    gfarm_hash_default, gfarm_hash_key_equal_default);
+	if (qu->users == NULL || qu->groups == NULL) {
+		quota_usage_free(qu);
+		return (NULL);
+	}
+	qu->no_memory = 0;
+	qu->last_user = NULL;
+	qu->last_group = NULL;
+	qu->last_user_value = NULL;
+	qu->last_group_value = NULL;
+	return (qu);
+}
+
+void
+quota_usage_free(struct quota_usage *qu)
+{
+	if (qu == NULL)
+		return;
+	if (qu->users != NULL)
+		gfarm_hash_table_free(qu->users);
+	if (qu->groups != NULL)
+		gfarm_hash_table_free(qu->groups);
+	free(qu);
+}
+
+/* the key is the address of struct user or struct group */
+static struct quota_usage_value *
+quota_usage_lookup(struct quota_usage *qu, struct gfarm_hash_table *table,
+	void *owner)
+{
+	struct gfarm_hash_entry *entry;
+	struct quota_usage_value *v;
+	int created;
+
+	entry = gfarm_hash_enter(table, &owner, sizeof(owner), sizeof(*v),
+	    &created);
+	if (entry == NULL) {
+		qu->no_memory = 1;
+		return (NULL);
+	}
+	v = gfarm_hash_entry_data(entry);
+	if (created)
+		memset(v, 0, sizeof(*v));
+	return (v);
+}
+
+#define usage_file_add(v, size, ncopy)					\
+	{								\
+		v->space = int64_add(v->space, size);			\
+		v->num = int64_add(v->num, 1);				\
+		v->phy_space = int64_add(v->phy_space, size * ncopy);	\
+		v->phy_num = int64_add(v->phy_num, ncopy);		\
+	}
+
+/* same as quota_update_file_add(), but only modifies `qu' */
+void
+quota_usage_add(struct quota_usage *qu, struct inode *inode)
+{
+	gfarm_off_t size;
+	gfarm_int64_t ncopy;
+	struct user *u = inode_get_user(inode);
+	struct group *g = inode_get_group(inode);
+	struct quota_usage_value *v;
+
+	if (inode_is_file(inode)) {
+		size = inode_get_size(inode);
+		ncopy = inode_get_ncopy_with_dead_host(inode);
+	} else {
+		size = 0;
+		ncopy = 0;
+	}
+
+	if (u != NULL && is_checked(user_quota(u))) {
+		if (u != qu->last_user) {
+			qu->last_user = u;
+			qu->last_user_value =
+			    quota_usage_lookup(qu, qu->users, u);
+		}
+		if ((v = qu->last_user_value) != NULL)
+			usage_file_add(v, size, ncopy);
+	}
+	if (g != NULL && is_checked(group_quota(g))) {
+		if (g != qu->last_group) {
+			qu->last_group = g;
+			qu->last_group_value =
+			    quota_usage_lookup(qu, qu->groups, g);
+		}
+		if ((v = qu->last_group_value) != NULL)
+			usage_file_add(v, size, ncopy);
+	}
+}
+
+static void
+quota_usage_add_for_quotacheck(void *closure, struct inode *inode)
+{
+	quota_usage_add(closure, inode);
+}
+
+#define usage_merge(q, v)						\
+	{								\
+		q->space = int64_add(q->space, v->space);		\
+		q->num = int64_add(q->num, v->num);			\
+		q->phy_space = int64_add(q->phy_space, v->phy_space);	\
+		q->phy_num = int64_add(q->phy_num, v->phy_num);		\
+	}
+
+static void
+quota_usage_merge_table(struct gfarm_hash_table *table, int is_group)
+{
+	struct gfarm_hash_iterator it;
+	struct gfarm_hash_entry *entry;
+	struct quota_usage_value *v;
+	struct quota *q;
+	void *owner;
+
+	for (gfarm_hash_iterator_begin(table, &it);
+	    !gfarm_hash_iterator_is_end(&it); gfarm_hash_iterator_next(&it)) {
+		entry = gfarm_hash_iterator_access(&it);
+		memcpy(&owner, gfarm_hash_entry_key(entry), sizeof(owner));
+		v = gfarm_hash_entry_data(entry);
+		q = is_group ? group_quota(owner) : user_quota(owner);
+		usage_merge(q, v);
+	}
+}
+
+/*
+ * returns 0, if the usage is incomplete due to no memory,
+ * and the caller should count it again by quota_check().
+ */
+int
+quota_usage_merge(struct quota_usage *qu)
+{
+	if (qu->no_memory)
+		return (0);
+	quota_usage_merge_table(qu->users, 0);
+	quota_usage_merge_table(qu->groups, 1);
+	return (1);
+}
+
+/* quota_usage_add() must be called between these functions */
+void
+quota_check_begin(void)
+{
+	/* zero clear and set true in is_checked */
+	quota_clear_value_all_user_and_group();
+}
+
+void
+quota_check_end(void)
+{
+	/* update memory */
+	quota_set_value_all_user_and_group();
+}
+
 #define update_file_resize(q, old_size, new_size, ncopy)		\
 	{								\
 		gfarm_int64_t diff = new_size - old_size;		\
@@ -529,7 +739,7 @@ enum quota_exceeded_type {
 };
 
 static int
-is_exceeded(struct timeval *nowp, struct quota *q,
+is_exceeded(struct quota_now *nowp, struct quota *q,
 	    int is_file_creating, int is_replica_adding)
 {
 	if (!is_checked(q))  /* quota is disabled */
@@ -539,19 +749,20 @@ is_exceeded(struct timeval *nowp, struct quota *q,
 	if (quota_limit_is_valid(q->grace_period)) {
 		if (quota_limit_is_valid(q->space_soft) &&
 		    quota_limit_is_valid(q->space_exceed) &&
-		    (nowp->tv_sec - q->space_exceed) > q->grace_period)
+		    (quota_now_get(nowp) - q->space_exceed) > q->grace_period)
 			return (QUOTA_EXCEEDED_SPACE_SOFT);
 		if (quota_limit_is_valid(q->num_soft) &&
 		    quota_limit_is_valid(q->num_exceed) &&
-		    (nowp->tv_sec - q->num_exceed) > q->grace_period)
+		    (quota_now_get(nowp) - q->num_exceed) > q->grace_period)
 			return (QUOTA_EXCEEDED_NUM_SOFT);
 		if (quota_limit_is_valid(q->phy_space_soft) &&
 		    quota_limit_is_valid(q->phy_space_exceed) &&
-		    (nowp->tv_sec - q->phy_space_exceed) > q->grace_period)
+		    (quota_now_get(nowp) - q->phy_space_exceed) >
+		    q->grace_period)
 			return (QUOTA_EXCEEDED_PHY_SPACE_SOFT);
 		if (quota_limit_is_valid(q->phy_num_soft) &&
 		    quota_limit_is_valid(q->phy_num_exceed) &&
-		    (nowp->tv_sec - q->phy_num_exceed) > q->grace_period)
+		    (quota_now_get(nowp) - q->phy_num_exceed) > q->grace_period)
 			return (QUOTA_EXCEEDED_PHY_NUM_SOFT);
 	}
 
@@ -576,9 +787,8 @@ gfarm_error_t
 quota_check_limits(struct user *u, struct group *g,
 		   int is_file_creating, int is_replica_adding)
 {
-	struct timeval now;
+	struct quota_now now = QUOTA_NOW_INITIALIZER;
 
-	gettimeofday(&now, NULL);
 	if (u && is_exceeded(&now, user_quota(u),
 			    is_file_creating, is_replica_adding)) {
 		gflog_debug(GFARM_MSG_1002051,
@@ -619,16 +829,52 @@ quota_group_remove(struct group *g)
 	q->space = QUOTA_NOT_CHECK_YET;
 }
 
+static void
+quota_check_sequential(void)
+{
+	quota_check_begin();
+	inode_lookup_all(NULL, quota_update_file_add_for_quotacheck);
+	quota_check_end();
+}
+
 void
 quota_check(void)
 {
-	/* zero clear and set true in is_checked */
-	quota_clear_value_all_user_and_group();
-	/* load all inodes from memory and count usage values of files */
-	/* XXX FIXME too long giant lock */
-	inode_lookup_all(NULL, quota_update_file_add_for_quotacheck);
-	/* update memory */
-	quota_set_value_all_user_and_group();
+	int i, ok = 1, nthreads = gfarm_metadb_check_parallel;
+	struct quota_usage **usages;
+
+	if (nthreads <= 1) {
+		quota_check_sequential();
+		return;
+	}
+	GFARM_CALLOC_ARRAY(usages, nthreads);
+	if (usages == NULL) {
+		quota_check_sequential();
+		return;
+	}
+	for (i = 0; i < nthreads; i++) {
+		if ((usages[i] = quota_usage_alloc()) == NULL)
+			ok = 0;
+	}
+	if (ok) {
+		quota_check_begin();
+		/* load all inodes from memory and count usage values */
+		/* XXX FIXME too long giant lock */
+		inode_lookup_all_parallel(nthreads, (void **)usages,
+		    quota_usage_add_for_quotacheck);
+		for (i = 0; i < nthreads && ok; i++)
+			ok = quota_usage_merge(usages[i]);
+		if (ok)
+			quota_check_end();
+	}
+	for (i = 0; i < nthreads; i++)
+		quota_usage_free(usages[i]);
+	free(usages);
+	if (!ok) {
+		gflog_warning(GFARM_MSG_UNFIXED,
+		    "quota_check: no memory for threads, run sequentially");
+		quota_check_sequential();
+	}
 }
 
 /* server operations */
@@ -940,6 +1186,7 @@ gfm_server_quota_check(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
 		}
 		/* XXX FIXME too long giant lock */
 		quota_check();
+		inode_usage_check();
 		giant_unlock();
 	}
 
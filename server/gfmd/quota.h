@@ -43,6 +43,15 @@ void quota_update_file_remove(struct inode *);
 gfarm_error_t quota_lookup(const char *, int, struct quota **, const char *);
 void quota_check(void);
 
+/* for a parallel quota check, a struct quota_usage per thread */
+struct quota_usage;
+struct quota_usage *quota_usage_alloc(void);
+void quota_usage_free(struct quota_usage *);
+void quota_usage_add(struct quota_usage *, struct inode *);
+int quota_usage_merge(struct quota_usage *);
+void quota_check_begin(void);
+void quota_check_end(void);
+
 struct peer;
 gfarm_error_t gfm_server_quota_user_get(
 	struct peer *, gfp_xdr_xid_t, size_t *, int, int);
@@ -0,0 +1,123 @@
+/*
+ * replica placement policies
+ *
+ * "random" chooses the replication targets uniformly at random.
+ * "weighted" chooses them at random with the probability proportional to
+ * replica_placement_weight(), and "two_choices" chooses the better one of
+ * two hosts picked at random (the power of two choices).
+ * The latter is less sensitive to the staleness of the host status,
+ * because the status is reported only at each heartbeat.
+ *
+ * $Id$
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfutil.h"
+
+#include "config.h"
+
+#include "replica_placement.h"
+
+#define RANDOM_SCALE	1000000
+
+/*
+ * a host is preferred if it has more free space, lower load,
+ * less replication requests in flight, and less replicas in its fsngroup.
+ */
+double
+replica_placement_weight(const struct replica_placement_load *l)
+{
+	return ((double)l->disk_avail / ((1.0 + l->loadavg) *
+	    (1 + l->inflight) * (1 + l->fsngroup_replicas)));
+}
+
+static int
+select_weighted(int ncands, int *cands, struct replica_placement_load *loads)
+{
+	int i;
+	double total = 0, x;
+
+	for (i = 0; i < ncands; i++)
+		total += replica_placement_weight(&loads[cands[i]]);
+	if (total <= 0)
+		return (gfarm_random() % ncands);
+
+	x = total * (gfarm_random() % RANDOM_SCALE) / RANDOM_SCALE;
+	for (i = 0; i < ncands - 1; i++) {
+		x -= replica_placement_weight(&loads[cands[i]]);
+		if (x < 0)
+			break;
+	}
+	return (i);
+}
+
+static int
+select_two_choices(int ncands, int *cands,
+	struct replica_placement_load *loads)
+{
+	int i, j;
+
+	i = gfarm_random() % ncands;
+	if (ncands == 1)
+		return (i);
+	j = gfarm_random() % (ncands - 1);
+	if (j >= i)
+		j++;
+	return (replica_placement_weight(&loads[cands[j]]) >
+	    replica_placement_weight(&loads[cands[i]]) ? j : i);
+}
+
+/*
+ * choose nresults hosts out of nhosts hosts, and store the indexes of
+ * the chosen hosts to results[].
+ * loads[].fsngroup_replicas is incremented for the hosts which belong to
+ * the same fsngroup as a chosen host.
+ */
+gfarm_error_t
+replica_placement_select(enum gfarm_replica_placement policy,
+	int nhosts, struct replica_placement_load *loads,
+	int nresults, int *results)
+{
+	int i, j, r, chosen, *cands;
+	const char *fsngroup;
+
+	assert(nhosts > nresults);
+	GFARM_MALLOC_ARRAY(cands, nhosts);
+	if (cands == NULL)
+		return (GFARM_ERR_NO_MEMORY);
+	for (i = 0; i < nhosts; i++)
+		cands[i] = i;
+
+	for (r = 0; r < nresults; r++) {
+		switch (policy) {
+		case GFARM_REPLICA_PLACEMENT_WEIGHTED:
+			j = select_weighted(nhosts, cands, loads);
+			break;
+		case GFARM_REPLICA_PLACEMENT_TWO_CHOICES:
+			j = select_two_choices(nhosts, cands, loads);
+			break;
+		default:
+			j = gfarm_random() % nhosts;
+			break;
+		}
+		chosen = cands[j];
+		results[r] = chosen;
+		cands[j] = cands[--nhosts];
+
+		fsngroup = loads[chosen].fsngroup;
+		if (fsngroup == NULL || fsngroup[0] == '\0')
+			continue;
+		for (i = 0; i < nhosts; i++) {
+			if (loads[cands[i]].fsngroup != NULL &&
+			    strcmp(loads[cands[i]].fsngroup, fsngroup) == 0)
+				loads[cands[i]].fsngroup_replicas++;
+		}
+	}
+	free(cands);
+	return (GFARM_ERR_NO_ERROR);
+}
@@ -0,0 +1,16 @@
+/*
+ * $Id$
+ */
+
+/* status of a candidate host, used to rank the replication targets */
+struct replica_placement_load {
+	gfarm_uint64_t disk_avail;	/* KiB, beyond minimum_free_disk_space */
+	double loadavg;			/* 1 minute load average per CPU */
+	int inflight;			/* replication requests in flight */
+	const char *fsngroup;		/* NULL or "", if not in any fsngroup */
+	int fsngroup_replicas;		/* replicas in the same fsngroup */
+};
+
+double replica_placement_weight(const struct replica_placement_load *);
+gfarm_error_t replica_placement_select(enum gfarm_replica_placement,
+	int, struct replica_placement_load *, int, int *);
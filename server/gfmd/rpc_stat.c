@@ -0,0 +1,323 @@
+/*
+ * per request latency statistics of gfmd
+ *
+ * Each thread records the statistics into its own table without locking,
+ * and GFM_PROTO_RPC_STAT_GET sums up the tables of all threads.
+ * Counters read by GFM_PROTO_RPC_STAT_GET may be slightly behind,
+ * but that doesn't matter for statistics.
+ *
+ * $Id$
+ */
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfutil.h"
+#include "thrsubr.h"
+#include "timer.h"
+
+#include "gfp_xdr.h"
+#include "auth.h"
+#include "gfm_proto.h"
+
+#include "subr.h"
+#include "rpcsubr.h"
+#include "user.h"
+#include "peer.h"
+#include "rpc_stat.h"
+
+/* protocol numbers beyond this are counted together */
+#define RPC_STAT_OTHERS		(GFM_PROTO_METADB_SERVER_RESERVE15 + 1)
+#define RPC_STAT_NENTRIES	(RPC_STAT_OTHERS + 1)
+
+struct rpc_stat_histogram {
+	gfarm_uint64_t total, max; /* microseconds */
+	gfarm_uint32_t buckets[GFM_PROTO_RPC_STAT_NBUCKETS];
+};
+
+struct rpc_stat_entry {
+	gfarm_uint64_t count;
+	struct rpc_stat_histogram phases[GFM_PROTO_RPC_STAT_NPHASES];
+};
+
+struct rpc_stat_thread {
+	struct rpc_stat_thread *next;
+
+	/* the request in progress */
+	int nesting;
+	int queue_wait_is_valid;
+	double waits[GFM_PROTO_RPC_STAT_NPHASES];
+	gfarm_timerval_t start;
+
+	/* allocated on demand */
+	struct rpc_stat_entry *entries[RPC_STAT_NENTRIES];
+};
+
+static pthread_key_t rpc_stat_key;
+static pthread_mutex_t rpc_stat_threads_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct rpc_stat_thread *rpc_stat_threads = NULL;
+static const char rpc_stat_threads_diag[] = "rpc_stat_threads";
+
+void
+rpc_stat_init(void)
+{
+	int err;
+
+	gfarm_timerval_calibrate();
+	if ((err = pthread_key_create(&rpc_stat_key, NULL)) != 0)
+		gflog_fatal(GFARM_MSG_UNFIXED, "rpc_stat_init: %s",
+		    strerror(err));
+}
+
+static struct rpc_stat_thread *
+rpc_stat_thread_get(void)
+{
+	struct rpc_stat_thread *t = pthread_getspecific(rpc_stat_key);
+	static const char diag[] = "rpc_stat_thread_get";
+
+	if (t != NULL)
+		return (t);
+	GFARM_MALLOC(t);
+	if (t == NULL) {
+		gflog_debug(GFARM_MSG_UNFIXED, "%s: no memory", diag);
+		return (NULL);
+	}
+	memset(t, 0, sizeof(*t));
+	if (pthread_setspecific(rpc_stat_key, t) != 0) {
+		free(t);
+		return (NULL);
+	}
+	gfarm_mutex_lock(&rpc_stat_threads_mutex, diag,
+	    rpc_stat_threads_diag);
+	t->next = rpc_stat_threads;
+	rpc_stat_threads = t;
+	gfarm_mutex_unlock(&rpc_stat_threads_mutex, diag,
+	    rpc_stat_threads_diag);
+	return (t);
+}
+
+void
+rpc_stat_job_started(double queue_wait)
+{
+	struct rpc_stat_thread *t = rpc_stat_thread_get();
+
+	if (t == NULL)
+		return;
+	t->waits[GFM_PROTO_RPC_STAT_QUEUE] = queue_wait;
+	t->queue_wait_is_valid = 1;
+}
+
+void
+rpc_stat_lock_waited(double wait)
+{
+	struct rpc_stat_thread *t = pthread_getspecific(rpc_stat_key);
+
+	if (t != NULL && t->nesting > 0)
+		t->waits[GFM_PROTO_RPC_STAT_LOCK] += wait;
+}
+
+void
+rpc_stat_dbq_waited(double wait)
+{
+	struct rpc_stat_thread *t = pthread_getspecific(rpc_stat_key);
+
+	if (t != NULL && t->nesting > 0)
+		t->waits[GFM_PROTO_RPC_STAT_DBQ] += wait;
+}
+
+void
+rpc_stat_request_begin(gfarm_int32_t request)
+{
+	struct rpc_stat_thread *t = rpc_stat_thread_get();
+
+	if (t == NULL || t->nesting++ > 0)
+		return;
+	t->waits[GFM_PROTO_RPC_STAT_LOCK] = 0;
+	t->waits[GFM_PROTO_RPC_STAT_DBQ] = 0;
+	gfarm_gettimerval(&t->start);
+}
+
+static void
+rpc_stat_histogram_add(struct rpc_stat_histogram *h, double sec)
+{
+	gfarm_uint64_t usec = sec > 0 ? (gfarm_uint64_t)(sec * 1000000) : 0;
+
+	h->total += usec;
+	if (h->max < usec)
+		h->max = usec;
+	h->buckets[gfm_proto_rpc_stat_bucket(usec)]++;
+}
+
+void
+rpc_stat_request_end(gfarm_int32_t request)
+{
+	struct rpc_stat_thread *t = pthread_getspecific(rpc_stat_key);
+	struct rpc_stat_entry *ent;
+	gfarm_timerval_t end;
+	int i;
+	static const char diag[] = "rpc_stat_request_end";
+
+	if (t == NULL || t->nesting == 0 || --t->nesting > 0)
+		return;
+	gfarm_gettimerval(&end);
+	t->waits[GFM_PROTO_RPC_STAT_TOTAL] = gfarm_timerval_sub(&end, &t->start);
+
+	i = request >= 0 && request < RPC_STAT_OTHERS ?
+	    request : RPC_STAT_OTHERS;
+	if ((ent = t->entries[i]) == NULL) {
+		GFARM_MALLOC(ent);
+		if (ent == NULL) {
+			gflog_debug(GFARM_MSG_UNFIXED, "%s: no memory", diag);
+			return;
+		}
+		memset(ent, 0, sizeof(*ent));
+		/* make the entry visible to GFM_PROTO_RPC_STAT_GET */
+		gfarm_mutex_lock(&rpc_stat_threads_mutex, diag,
+		    rpc_stat_threads_diag);
+		t->entries[i] = ent;
+		gfarm_mutex_unlock(&rpc_stat_threads_mutex, diag,
+		    rpc_stat_threads_diag);
+	}
+	ent->count++;
+	if (t->queue_wait_is_valid) {
+		/* only the first request after the thread pool dispatch */
+		rpc_stat_histogram_add(&ent->phases[GFM_PROTO_RPC_STAT_QUEUE],
+		    t->waits[GFM_PROTO_RPC_STAT_QUEUE]);
+		t->queue_wait_is_valid = 0;
+	}
+	rpc_stat_histogram_add(&ent->phases[GFM_PROTO_RPC_STAT_LOCK],
+	    t->waits[GFM_PROTO_RPC_STAT_LOCK]);
+	rpc_stat_histogram_add(&ent->phases[GFM_PROTO_RPC_STAT_DBQ],
+	    t->waits[GFM_PROTO_RPC_STAT_DBQ]);
+	rpc_stat_histogram_add(&ent->phases[GFM_PROTO_RPC_STAT_TOTAL],
+	    t->waits[GFM_PROTO_RPC_STAT_TOTAL]);
+}
+
+/* PREREQUISITE: rpc_stat_threads_mutex */
+static void
+rpc_stat_sum(int i, struct gfm_rpc_stat *st)
+{
+	struct rpc_stat_thread *t;
+	struct rpc_stat_entry *ent;
+	struct rpc_stat_histogram *h;
+	struct gfm_rpc_stat_histogram *sh;
+	int j, k;
+
+	memset(st, 0, sizeof(*st));
+	st->request = i < RPC_STAT_OTHERS ? i : GFM_PROTO_PRIVATE_BASE;
+	for (t = rpc_stat_threads; t != NULL; t = t->next) {
+		if ((ent = t->entries[i]) == NULL)
+			continue;
+		st->count += ent->count;
+		for (j = 0; j < GFM_PROTO_RPC_STAT_NPHASES; j++) {
+			h = &ent->phases[j];
+			sh = &st->phases[j];
+			sh->total += h->total;
+			if (sh->max < h->max)
+				sh->max = h->max;
+			for (k = 0; k < GFM_PROTO_RPC_STAT_NBUCKETS; k++)
+				sh->buckets[k] += h->buckets[k];
+		}
+	}
+}
+
+static gfarm_error_t
+rpc_stat_reply(struct peer *peer, struct gfm_rpc_stat *st)
+{
+	gfarm_error_t e;
+	struct gfp_xdr *client = peer_get_conn(peer);
+	struct gfm_rpc_stat_histogram *sh;
+	gfarm_int32_t nbuckets;
+	int j, k;
+
+	e = gfp_xdr_send(client, "il", st->request, st->count);
+	for (j = 0; e == GFARM_ERR_NO_ERROR &&
+	    j < GFM_PROTO_RPC_STAT_NPHASES; j++) {
+		sh = &st->phases[j];
+		/* only non-empty buckets are sent */
+		nbuckets = 0;
+		for (k = 0; k < GFM_PROTO_RPC_STAT_NBUCKETS; k++) {
+			if (sh->buckets[k] != 0)
+				nbuckets++;
+		}
+		e = gfp_xdr_send(client, "lli", sh->total, sh->max, nbuckets);
+		for (k = 0; e == GFARM_ERR_NO_ERROR &&
+		    k < GFM_PROTO_RPC_STAT_NBUCKETS; k++) {
+			if (sh->buckets[k] != 0)
+				e = gfp_xdr_send(client, "il",
+				    (gfarm_int32_t)k, sh->buckets[k]);
+		}
+	}
+	return (e);
+}
+
+gfarm_error_t
+gfm_server_rpc_stat_get(struct peer *peer, gfp_xdr_xid_t xid, size_t *sizep,
+	int from_client, int skip)
+{
+	gfarm_error_t e, e2;
+	struct user *user = peer_get_user(peer);
+	struct peer *mhpeer;
+	struct rpc_stat_thread *t;
+	struct gfm_rpc_stat *stats = NULL;
+	int i, n = 0, size_pos;
+	static const char diag[] = "GFM_PROTO_RPC_STAT_GET";
+
+	e = gfm_server_get_request(peer, sizep, diag, "");
+	if (e != GFARM_ERR_NO_ERROR)
+		return (e);
+	if (skip)
+		return (GFARM_ERR_NO_ERROR);
+
+	giant_lock();
+	if (!from_client || user == NULL || !user_is_admin(user)) {
+		gflog_debug(GFARM_MSG_UNFIXED, "%s: operation is not permitted",
+		    diag);
+		e = GFARM_ERR_OPERATION_NOT_PERMITTED;
+	}
+	giant_unlock();
+
+	if (e == GFARM_ERR_NO_ERROR) {
+		GFARM_MALLOC_ARRAY(stats, RPC_STAT_NENTRIES);
+		if (stats == NULL)
+			e = GFARM_ERR_NO_MEMORY;
+	}
+	if (e == GFARM_ERR_NO_ERROR) {
+		/* do not hold the mutex during network I/O */
+		gfarm_mutex_lock(&rpc_stat_threads_mutex, diag,
+		    rpc_stat_threads_diag);
+		for (i = 0; i < RPC_STAT_NENTRIES; i++) {
+			for (t = rpc_stat_threads; t != NULL; t = t->next) {
+				if (t->entries[i] != NULL)
+					break;
+			}
+			if (t != NULL)
+				rpc_stat_sum(i, &stats[n++]);
+		}
+		gfarm_mutex_unlock(&rpc_stat_threads_mutex, diag,
+		    rpc_stat_threads_diag);
+	}
+
+	e2 = gfm_server_put_reply_begin(peer, &mhpeer, xid, &size_pos, diag,
+	    e, "i", n);
+	/* if network error doesn't happen, e2 == e here */
+	if (e2 == GFARM_ERR_NO_ERROR) {
+		for (i = 0; i < n; i++) {
+			if ((e2 = rpc_stat_reply(peer, &stats[i]))
+			    != GFARM_ERR_NO_ERROR) {
+				gflog_debug(GFARM_MSG_UNFIXED,
+				    "%s: rpc_stat_reply: %s",
+				    diag, gfarm_error_string(e2));
+				break;
+			}
+		}
+		gfm_server_put_reply_end(peer, mhpeer, diag, size_pos);
+	}
+	free(stats);
+	return (e2);
+}
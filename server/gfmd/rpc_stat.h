@@ -0,0 +1,14 @@
+void rpc_stat_init(void);
+
+/* wait times in seconds, recorded to the request in the current thread */
+void rpc_stat_job_started(double);
+void rpc_stat_lock_waited(double);
+void rpc_stat_dbq_waited(double);
+
+/* called by protocol_switch() */
+void rpc_stat_request_begin(gfarm_int32_t);
+void rpc_stat_request_end(gfarm_int32_t);
+
+struct peer;
+gfarm_error_t gfm_server_rpc_stat_get(struct peer *, gfp_xdr_xid_t, size_t *,
+	int, int);
@@ -5,6 +5,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/time.h>
 
 #define GFARM_INTERNAL_USE
 #include <gfarm/gflog.h>
@@ -14,9 +15,13 @@
 
 #include "gfutil.h"
 #include "thrsubr.h"
+#include "timer.h"
+
+#include "gfp_xdr.h"
 
 #include "config.h"
 #include "subr.h"
+#include "rpc_stat.h"
 
 int debug_mode = 0;
 
@@ -31,7 +36,16 @@ giant_init(void)
 void
 giant_lock(void)
 {
+	gfarm_timerval_t t1, t2;
+
+	if (gfarm_mutex_trylock(&giant_mutex, "giant_lock", "giant"))
+		return;
+
+	/* record the wait time, only if contended */
+	gfarm_gettimerval(&t1);
 	gfarm_mutex_lock(&giant_mutex, "giant_lock", "giant");
+	gfarm_gettimerval(&t2);
+	rpc_stat_lock_waited(gfarm_timerval_sub(&t2, &t1));
 }
 
 /* false: busy */
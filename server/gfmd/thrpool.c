@@ -1,21 +1,28 @@
 #include <pthread.h>
+#include <stdarg.h>
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
 #include <sys/types.h>
+#include <sys/time.h>
 
 #include <gfarm/gfarm.h>
 
 #include "gfutil.h"
 #include "thrsubr.h"
+#include "timer.h"
+
+#include "gfp_xdr.h"
 
 #include "subr.h"
 #include "thrpool.h"
+#include "rpc_stat.h"
 
 struct thread_job {
 	void *(*thread_main)(void *);
 	void *arg;
+	gfarm_timerval_t queued;
 };
 
 struct thread_jobq {
@@ -54,6 +61,7 @@ thrjobq_add_job(struct thread_jobq *q, void *(*thread_main)(void *), void *arg)
 	}
 	q->entries[q->in].thread_main = thread_main;
 	q->entries[q->in].arg = arg;
+	gfarm_gettimerval(&q->entries[q->in].queued);
 	q->in++;
 	if (q->in >= q->size)
 		q->in = 0;
@@ -128,6 +136,7 @@ thrpool_worker(void *arg)
 	static const char diag[] = "thrpool_worker";
 	struct thread_pool *p = arg;
 	struct thread_job job;
+	gfarm_timerval_t now;
 
 	for (;;) {
 		gfarm_mutex_lock(&p->mutex, diag, "to get job");
@@ -135,6 +144,8 @@ thrpool_worker(void *arg)
 		gfarm_mutex_unlock(&p->mutex, diag, "to get job");
 
 		thrjobq_get_job(&p->jobq, &job);
+		gfarm_gettimerval(&now);
+		rpc_stat_job_started(gfarm_timerval_sub(&now, &job.queued));
 
 		gfarm_mutex_lock(&p->mutex, diag, "after job was gotten");
 		p->idles--;
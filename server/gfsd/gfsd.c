@@ -28,6 +28,7 @@
 #include <time.h>
 #include <pwd.h>
 #include <libgen.h>
+#include <pthread.h>
 
 #if defined(SCM_RIGHTS) && \
 		(!defined(sun) || (!defined(__svr4__) && !defined(__SVR4)))
@@ -57,6 +58,7 @@
 #include "hash.h"
 #include "nanosec.h"
 #include "timer.h"
+#include "thrsubr.h"
 
 #include "context.h"
 #include "gfp_xdr.h"
@@ -245,6 +247,8 @@ cleanup_handler(int signo)
 {
 	terminate_flag = 1;
 	if (write_open_count == 0) {
+		if (getpid() == master_gfsd_pid)
+			gfsd_spool_check_state_save(); /* clean shutdown */
 		cleanup(1);
 		_exit(0);
 	}
@@ -1935,6 +1939,7 @@ gfs_server_close(struct gfp_xdr *client, gfp_xdr_xid_t xid, size_t size)
 			else
 				e = GFARM_ERR_NO_ERROR;
 			replication_local_fd = REPLICATION_LOCAL_FD_CLOSED;
+			gfsd_replica_relay_detach();
 		}
 	} else {
 		e = close_fd_somehow(fd, diag);
@@ -1969,10 +1974,18 @@ gfs_server_pread(struct gfp_xdr *client, gfp_xdr_xid_t xid, size_t size)
 		local_fd = file_table_get(fd);
 	}
 
+	rv = 0;
+	if (fd == REPLICATION_REMOTE_FD && gfsd_replica_relay_is_attached()) {
+		/* wait for the data which is being received */
+		if ((rv = gfsd_replica_relay_read(local_fd, buffer, iosize,
+		    offset)) == -1) {
+			save_errno = errno;
+			rv = 0;
+		}
+	} else
 #if 0 /* XXX FIXME: pread(2) on NetBSD-3.0_BETA is broken */
 	if ((rv = pread(local_fd, buffer, iosize, offset)) == -1)
 #else
-	rv = 0;
 	if (lseek(local_fd, offset, SEEK_SET) == -1)
 		save_errno = errno;
 	else if ((rv = read(local_fd, buffer, iosize)) == -1)
@@ -1984,6 +1997,7 @@ gfs_server_pread(struct gfp_xdr *client, gfp_xdr_xid_t xid, size_t size)
 	if (rv > 0) {
 		gfarm_iostat_local_add(GFARM_IOSTAT_IO_RCOUNT, 1);
 		gfarm_iostat_local_add(GFARM_IOSTAT_IO_RBYTES, rv);
+		gfsd_hoststat_add(GFSD_HOSTSTAT_READ, rv);
 	}
 	gfs_profile(
 		gfarm_gettimerval(&t2);
@@ -2039,6 +2053,7 @@ gfs_server_pwrite(struct gfp_xdr *client, gfp_xdr_xid_t xid, size_t size)
 	if (rv > 0) {
 		gfarm_iostat_local_add(GFARM_IOSTAT_IO_WCOUNT, 1);
 		gfarm_iostat_local_add(GFARM_IOSTAT_IO_WBYTES, rv);
+		gfsd_hoststat_add(GFSD_HOSTSTAT_WRITE, rv);
 	}
 	gfs_profile(
 		gfarm_gettimerval(&t2);
@@ -2092,6 +2107,7 @@ gfs_server_write(struct gfp_xdr *client, gfp_xdr_xid_t xid, size_t size)
 	if (rv > 0) {
 		gfarm_iostat_local_add(GFARM_IOSTAT_IO_WCOUNT, 1);
 		gfarm_iostat_local_add(GFARM_IOSTAT_IO_WBYTES, rv);
+		gfsd_hoststat_add(GFSD_HOSTSTAT_WRITE, rv);
 	}
 	gfs_profile(
 		gfarm_gettimerval(&t2);
@@ -2410,32 +2426,34 @@ replica_added(gfarm_int32_t net_fd,
 	return (e);
 }
 
-void
-gfs_server_replica_add_from(struct gfp_xdr *client,
-	gfp_xdr_xid_t xid, size_t size)
+/*
+ * relay_host == NULL: receive from the host, and don't relay
+ * relay_host == "": receive from the host, and relay to other hosts
+ * otherwise: receive from the relay_host, and relay to other hosts
+ */
+static gfarm_error_t
+replica_add_from_common(gfarm_int32_t net_fd, char *host, gfarm_int32_t port,
+	char *relay_host, gfarm_int32_t relay_port, const char *diag)
 {
-	gfarm_int32_t net_fd, local_fd, port, mtime_nsec = 0;
+	gfarm_int32_t local_fd, mtime_nsec = 0;
 	gfarm_int64_t mtime_sec = 0;
 	gfarm_ino_t ino = 0;
 	gfarm_uint64_t gen = 0;
 	gfarm_error_t e, e2, e_local, e_remote;
-	char *host, *path;
+	char *path;
 	struct gfs_connection *server;
 	int flags = 0; /* XXX - for now */
+	int relayed = relay_host != NULL && relay_host[0] != '\0';
 	struct stat sb;
-	static const char diag[] = "GFS_PROTO_REPLICA_ADD_FROM";
 
 	sb.st_size = -1;
-	gfs_server_get_request(client, size, diag,
-	    "sii", &host, &port, &net_fd);
-
 	e = replica_adding(net_fd, host, &ino, &gen, &mtime_sec, &mtime_nsec,
 	    diag);
 	if (e != GFARM_ERR_NO_ERROR) {
 		gflog_debug(GFARM_MSG_1002176,
 			"replica_adding() failed: %s",
 			gfarm_error_string(e));
-		goto free_host;
+		return (e);
 	}
 
 	gfsd_local_path(ino, gen, diag, &path);
@@ -2447,8 +2465,11 @@ gfs_server_replica_add_from(struct gfp_xdr *client,
 		mtime_sec = mtime_nsec = 0;
 		goto adding_cancel;
 	}
+	if (relay_host != NULL)
+		gfsd_replica_relay_begin(ino, gen);
 
-	e = gfs_client_connection_acquire_by_host(gfm_server, host, port,
+	e = gfs_client_connection_acquire_by_host(gfm_server,
+	    relayed ? relay_host : host, relayed ? relay_port : port,
 	    &server, listen_addrname);
 	if (e != GFARM_ERR_NO_ERROR) {
 		gflog_debug(GFARM_MSG_1002177,
@@ -2457,8 +2478,8 @@ gfs_server_replica_add_from(struct gfp_xdr *client,
 		mtime_sec = mtime_nsec = 0; /* invalidate */
 		goto close;
 	}
-	e = gfs_client_replica_recv(server, ino, gen, local_fd,
-	    &e_local, &e_remote);
+	e = (relayed ? gfs_client_replica_recv_relay : gfs_client_replica_recv)
+	    (server, ino, gen, local_fd, &e_local, &e_remote);
 	if (e != GFARM_ERR_NO_ERROR) {
 		gflog_debug(GFARM_MSG_1002178,
 			"gfs_client_replica_recv() failed: %s",
@@ -2473,16 +2494,50 @@ gfs_server_replica_add_from(struct gfp_xdr *client,
  free_server:
 	gfs_client_connection_free(server);
  close:
+	gfsd_replica_relay_end(e);
 	close(local_fd);
  adding_cancel:
 	e2 = replica_added(net_fd, flags, mtime_sec, mtime_nsec, sb.st_size,
 	    diag);
 	if (e == GFARM_ERR_NO_ERROR)
 		e = e2;
- free_host:
+	return (e);
+}
+
+void
+gfs_server_replica_add_from(struct gfp_xdr *client,
+	gfp_xdr_xid_t xid, size_t size)
+{
+	gfarm_int32_t net_fd, port;
+	gfarm_error_t e;
+	char *host;
+	static const char diag[] = "GFS_PROTO_REPLICA_ADD_FROM";
+
+	gfs_server_get_request(client, size, diag,
+	    "sii", &host, &port, &net_fd);
+
+	e = replica_add_from_common(net_fd, host, port, NULL, 0, diag);
+	free(host);
+	gfs_server_put_reply(client, xid, diag, e, "");
+}
+
+void
+gfs_server_replica_add_from_relay(struct gfp_xdr *client,
+	gfp_xdr_xid_t xid, size_t size)
+{
+	gfarm_int32_t net_fd, port, relay_port;
+	gfarm_error_t e;
+	char *host, *relay_host;
+	static const char diag[] = "GFS_PROTO_REPLICA_ADD_FROM_RELAY";
+
+	gfs_server_get_request(client, size, diag,
+	    "sisii", &host, &port, &relay_host, &relay_port, &net_fd);
+
+	e = replica_add_from_common(net_fd, host, port,
+	    relay_host, relay_port, diag);
 	free(host);
+	free(relay_host);
 	gfs_server_put_reply(client, xid, diag, e, "");
-	return;
 }
 
 #if 1
@@ -2517,6 +2572,39 @@ gfs_server_fhopen(struct gfp_xdr *client, gfp_xdr_xid_t xid, size_t size,
 	gfs_server_put_reply(client, xid, diag, e, "i", REPLICATION_REMOTE_FD);
 }
 
+void
+gfs_server_fhopen_relay(struct gfp_xdr *client, gfp_xdr_xid_t xid,
+	size_t size, enum gfarm_auth_id_type peer_type)
+{
+	gfarm_error_t e = GFARM_ERR_NO_ERROR;
+	gfarm_ino_t ino;
+	gfarm_uint64_t gen;
+	char *path;
+	static const char diag[] = "GFS_PROTO_FHOPEN_RELAY";
+
+	gfs_server_get_request(client, size, diag, "ll", &ino, &gen);
+	/* from gfsd only */
+	if (peer_type != GFARM_AUTH_ID_TYPE_SPOOL_HOST) {
+		e = GFARM_ERR_OPERATION_NOT_PERMITTED;
+		gflog_debug(GFARM_MSG_UNFIXED,
+		    "operation is not permitted(peer_type)");
+	} else if (replication_local_fd != REPLICATION_LOCAL_FD_CLOSED) {
+		e = GFARM_ERR_TOO_MANY_OPEN_FILES;
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "replication is doubly requested");
+	} else if ((e = gfsd_replica_relay_attach(ino, gen))
+	    == GFARM_ERR_NO_ERROR) {
+		gfsd_local_path(ino, gen, diag, &path);
+		replication_local_fd = open_data(path, O_RDONLY);
+		free(path);
+		if (replication_local_fd == -1) {
+			e = gfarm_errno_to_error(errno);
+			gfsd_replica_relay_detach();
+		}
+	}
+	gfs_server_put_reply(client, xid, diag, e, "i", REPLICATION_REMOTE_FD);
+}
+
 #else /* implementation until gfarm-2.X and before */
 
 void
@@ -2572,6 +2660,7 @@ gfs_server_replica_recv(struct gfp_xdr *client, gfp_xdr_xid_t xid, size_t size,
 		}
 		gfarm_iostat_local_add(GFARM_IOSTAT_IO_RCOUNT, 1);
 		gfarm_iostat_local_add(GFARM_IOSTAT_IO_RBYTES, rv);
+		gfsd_hoststat_add(GFSD_HOSTSTAT_READ, rv);
 		e = gfp_xdr_send(client, "b", rv, buffer);
 		if (e != GFARM_ERR_NO_ERROR) {
 			error = e;
@@ -2675,15 +2764,186 @@ gfs_async_server_fhremove(struct gfp_xdr *conn, gfp_xdr_xid_t xid, size_t size)
 	    diag, save_errno, ""));
 }
 
+/*
+ * GFS_PROTO_FHREMOVE_MULTI unlinks the spool files by several threads,
+ * because unlink(2) of many files is mostly waiting for the disk.
+ */
+#define FHREMOVE_MULTI_MAX_THREADS		8
+#define FHREMOVE_MULTI_ENTRIES_PER_THREAD	64
+
+struct fhremove_multi {
+	int n, nthreads;
+	const unsigned char *entries;
+	unsigned char *results;
+};
+
+struct fhremove_multi_worker {
+	struct fhremove_multi *m;
+	int index;
+};
+
+static gfarm_uint64_t
+fhremove_multi_decode_uint64(const unsigned char *p)
+{
+	gfarm_uint64_t v = 0;
+	int i;
+
+	for (i = 0; i < sizeof(v); i++)
+		v = (v << 8) | p[i];
+	return (v);
+}
+
+static void *
+fhremove_multi_worker(void *arg)
+{
+	struct fhremove_multi_worker *w = arg;
+	struct fhremove_multi *m = w->m;
+	const unsigned char *p;
+	unsigned char *r;
+	gfarm_ino_t ino;
+	gfarm_uint64_t gen;
+	gfarm_int32_t ecode;
+	char *path;
+	int i;
+
+	for (i = w->index; i < m->n; i += m->nthreads) {
+		p = m->entries + i * GFS_PROTO_FHREMOVE_MULTI_ENTRY_SIZE;
+		ino = fhremove_multi_decode_uint64(p);
+		gen = fhremove_multi_decode_uint64(p + sizeof(gfarm_uint64_t));
+		gfsd_local_path(ino, gen, "fhremove_multi", &path);
+		if (unlink(path) == -1) {
+			ecode = gfarm_errno_to_error(errno);
+			if (ecode == GFARM_ERR_UNKNOWN)
+				gflog_warning(GFARM_MSG_UNFIXED, "%s: %s",
+				    path, strerror(errno));
+		} else
+			ecode = GFARM_ERR_NO_ERROR;
+		free(path);
+
+		r = m->results + i * GFS_PROTO_FHREMOVE_MULTI_RESULT_SIZE;
+		r[0] = (ecode >> 24) & 0xff;
+		r[1] = (ecode >> 16) & 0xff;
+		r[2] = (ecode >> 8) & 0xff;
+		r[3] = ecode & 0xff;
+	}
+	return (NULL);
+}
+
 gfarm_error_t
-gfs_async_server_status(struct gfp_xdr *conn, gfp_xdr_xid_t xid, size_t size)
+gfs_async_server_fhremove_multi(struct gfp_xdr *conn, gfp_xdr_xid_t xid,
+	size_t size)
 {
 	gfarm_error_t e;
-	int save_errno = 0;
+	gfarm_int32_t n;
+	size_t sz;
+	unsigned char *entries, *results = NULL;
+	struct fhremove_multi m;
+	struct fhremove_multi_worker workers[FHREMOVE_MULTI_MAX_THREADS];
+	pthread_t threads[FHREMOVE_MULTI_MAX_THREADS];
+	int i, created[FHREMOVE_MULTI_MAX_THREADS];
+	static const char diag[] = "GFS_PROTO_FHREMOVE_MULTI";
+
+	GFARM_MALLOC_ARRAY(entries,
+	    GFS_PROTO_FHREMOVE_MULTI_MAX * GFS_PROTO_FHREMOVE_MULTI_ENTRY_SIZE);
+	if (entries == NULL) {
+		/* purge the request */
+		e = gfp_xdr_purge(conn, 0, size);
+		if (e != GFARM_ERR_NO_ERROR)
+			return (e);
+		return (gfs_async_server_put_reply(conn, xid, diag,
+		    GFARM_ERR_NO_MEMORY, ""));
+	}
+	e = gfs_async_server_get_request(conn, size, diag, "ib", &n,
+	    GFS_PROTO_FHREMOVE_MULTI_MAX * GFS_PROTO_FHREMOVE_MULTI_ENTRY_SIZE,
+	    &sz, entries);
+	if (e != GFARM_ERR_NO_ERROR) {
+		free(entries);
+		return (e);
+	}
+
+	if (n <= 0 || n > GFS_PROTO_FHREMOVE_MULTI_MAX ||
+	    sz != n * GFS_PROTO_FHREMOVE_MULTI_ENTRY_SIZE) {
+		gflog_error(GFARM_MSG_UNFIXED, "%s: invalid request: "
+		    "%d replicas in %d bytes", diag, (int)n, (int)sz);
+		e = GFARM_ERR_PROTOCOL;
+	} else if (GFARM_MALLOC_ARRAY(results,
+	    n * GFS_PROTO_FHREMOVE_MULTI_RESULT_SIZE) == NULL) {
+		e = GFARM_ERR_NO_MEMORY;
+	} else {
+		m.n = n;
+		m.nthreads = (n + FHREMOVE_MULTI_ENTRIES_PER_THREAD - 1) /
+		    FHREMOVE_MULTI_ENTRIES_PER_THREAD;
+		if (m.nthreads > FHREMOVE_MULTI_MAX_THREADS)
+			m.nthreads = FHREMOVE_MULTI_MAX_THREADS;
+		m.entries = entries;
+		m.results = results;
+		for (i = 0; i < m.nthreads; i++) {
+			workers[i].m = &m;
+			workers[i].index = i;
+			/* this thread takes the first part */
+			created[i] = i > 0 && pthread_create(&threads[i], NULL,
+			    fhremove_multi_worker, &workers[i]) == 0;
+		}
+		for (i = 0; i < m.nthreads; i++) {
+			if (created[i])
+				pthread_join(threads[i], NULL);
+			else
+				fhremove_multi_worker(&workers[i]);
+		}
+	}
+	free(entries);
+
+	e = gfs_async_server_put_reply(conn, xid, diag, e, "b",
+	    (size_t)n * GFS_PROTO_FHREMOVE_MULTI_RESULT_SIZE, results);
+	free(results);
+	return (e);
+}
+
+static int replication_queue_depth(void);
+
+/* returns errno */
+static int
+host_status_get(struct gfm_host_status *st)
+{
+	int save_errno;
 	double loadavg[3];
 	gfarm_int32_t bsize;
 	gfarm_off_t blocks, bfree, bavail, files, ffree, favail;
-	gfarm_off_t used = 0, avail = 0;
+
+	memset(st, 0, sizeof(*st));
+	if (getloadavg(loadavg, GFARM_ARRAY_LENGTH(loadavg)) == -1) {
+		gflog_warning(GFARM_MSG_1000520,
+		    "gfs_server_status: cannot get load average");
+		return (EPERM); /* XXX */
+	}
+	st->loadavg_1min = loadavg[0];
+	st->loadavg_5min = loadavg[1];
+	st->loadavg_15min = loadavg[2];
+
+	save_errno = gfsd_statfs(gfarm_spool_root, &bsize,
+		&blocks, &bfree, &bavail, &files, &ffree, &favail);
+	if (save_errno != 0)
+		return (save_errno);
+
+	/* pretend to be disk full, to make this gfsd read-only */
+	if (is_readonly_mode()) {
+		bavail -= bfree;
+		bfree = 0;
+	}
+	st->disk_used = (blocks - bfree) * bsize / 1024;
+	st->disk_avail = bavail * bsize / 1024;
+
+	gfsd_hoststat_get(&st->nclients, &st->read_rate, &st->write_rate);
+	st->queue_depth = replication_queue_depth();
+	return (0);
+}
+
+gfarm_error_t
+gfs_async_server_status(struct gfp_xdr *conn, gfp_xdr_xid_t xid, size_t size)
+{
+	gfarm_error_t e;
+	int save_errno;
+	struct gfm_host_status st;
 	static const char diag[] = "GFS_PROTO_STATUS";
 
 	/* just check that size == 0 */
@@ -2691,35 +2951,229 @@ gfs_async_server_status(struct gfp_xdr *conn, gfp_xdr_xid_t xid, size_t size)
 	if (e != GFARM_ERR_NO_ERROR)
 		return (e);
 
-	if (getloadavg(loadavg, GFARM_ARRAY_LENGTH(loadavg)) == -1) {
-		save_errno = EPERM; /* XXX */
-		gflog_warning(GFARM_MSG_1000520,
-		    "gfs_server_status: cannot get load average");
-	} else {
-		save_errno = gfsd_statfs(gfarm_spool_root, &bsize,
-			&blocks, &bfree, &bavail, &files, &ffree, &favail);
-
-		/* pretend to be disk full, to make this gfsd read-only */
-		if (save_errno == 0 && is_readonly_mode()) {
-			bavail -= bfree;
-			bfree = 0;
-		}
-		if (save_errno == 0) {
-			used = (blocks - bfree) * bsize / 1024;
-			avail = bavail * bsize / 1024;
-		}
-	}
+	save_errno = host_status_get(&st);
 	return (gfs_async_server_put_reply_with_errno(conn, xid,
 	    diag, save_errno,
-	    "fffll", loadavg[0], loadavg[1], loadavg[2], used, avail));
+	    "fffll", st.loadavg_1min, st.loadavg_5min, st.loadavg_15min,
+	    st.disk_used, st.disk_avail));
+}
+
+/*
+ * Once gfmd sends GFS_PROTO_STATUS2, which means that gfmd understands
+ * GFM_PROTO_HOST_STATUS_REPORT, the back channel gfsd pushes the status
+ * of this host whenever it changes, at most once per
+ * host_status_report_interval.  Only the changed fields are sent.
+ * These are only accessed by the main thread of the back channel gfsd.
+ */
+static int host_status_push_enabled = 0;
+static struct gfm_host_status host_status_reported;
+static struct timeval host_status_report_time;
+
+#define HOST_STATUS_LOADAVG_DELTA	0.1
+#define HOST_STATUS_IO_RATE_DELTA	(1024 * 1024) /* bytes per second */
+
+static gfarm_int32_t
+host_status_changes(const struct gfm_host_status *old,
+	const struct gfm_host_status *new)
+{
+	gfarm_int32_t mask = 0;
+	gfarm_off_t disk_delta;
+	double l;
+
+	l = new->loadavg_1min - old->loadavg_1min;
+	if (l < 0)
+		l = -l;
+	if (l >= HOST_STATUS_LOADAVG_DELTA + old->loadavg_1min / 20)
+		mask |= GFM_PROTO_HOST_STATUS_LOADAVG;
+
+	/* 1% of the capacity */
+	disk_delta = new->disk_avail - old->disk_avail;
+	if (disk_delta < 0)
+		disk_delta = -disk_delta;
+	if (disk_delta > 0 &&
+	    disk_delta >= (new->disk_used + new->disk_avail) / 100)
+		mask |= GFM_PROTO_HOST_STATUS_DISK;
+
+	if (new->nclients != old->nclients)
+		mask |= GFM_PROTO_HOST_STATUS_NCLIENTS;
+	if (new->queue_depth != old->queue_depth)
+		mask |= GFM_PROTO_HOST_STATUS_QUEUE;
+
+	if (new->read_rate > old->read_rate + old->read_rate / 10 +
+	    HOST_STATUS_IO_RATE_DELTA ||
+	    old->read_rate > new->read_rate + new->read_rate / 10 +
+	    HOST_STATUS_IO_RATE_DELTA ||
+	    new->write_rate > old->write_rate + old->write_rate / 10 +
+	    HOST_STATUS_IO_RATE_DELTA ||
+	    old->write_rate > new->write_rate + new->write_rate / 10 +
+	    HOST_STATUS_IO_RATE_DELTA)
+		mask |= GFM_PROTO_HOST_STATUS_IO_RATE;
+	return (mask);
+}
+
+gfarm_error_t
+gfs_async_server_status2(struct gfp_xdr *conn, gfp_xdr_xid_t xid, size_t size)
+{
+	gfarm_error_t e;
+	int save_errno;
+	struct gfm_host_status st;
+	unsigned char buf[GFM_PROTO_HOST_STATUS_SIZE_MAX];
+	size_t len;
+	static const char diag[] = "GFS_PROTO_STATUS2";
+
+	/* just check that size == 0 */
+	e = gfs_async_server_get_request(conn, size, diag, "");
+	if (e != GFARM_ERR_NO_ERROR)
+		return (e);
+
+	save_errno = host_status_get(&st);
+	len = gfm_proto_host_status_encode(GFM_PROTO_HOST_STATUS_ALL,
+	    &st, buf);
+	e = gfs_async_server_put_reply_with_errno(conn, xid,
+	    diag, save_errno, "b", len, buf);
+	if (save_errno == 0 && gfarm_host_status_report_interval > 0) {
+		host_status_push_enabled = 1;
+		host_status_reported = st;
+		gettimeofday(&host_status_report_time, NULL);
+	}
+	return (e);
+}
+
+static gfarm_int32_t
+gfm_async_client_host_status_report_result(void *peer, void *arg,
+	size_t size)
+{
+	struct gfp_xdr *bc_conn = peer;
+
+	return (gfm_async_client_recv_reply(bc_conn,
+	    "gfm_async_client_host_status_report_result", size, ""));
 }
 
+static void
+gfm_async_client_host_status_report_free(void *peer, void *arg)
+{
+}
+
+/* returns the milliseconds until the next report may be sent */
+static int
+host_status_report_if_changed(struct gfp_xdr *bc_conn,
+	gfp_xdr_async_peer_t async, gfarm_error_t *ep)
+{
+	struct gfm_host_status st;
+	struct timeval now;
+	unsigned char buf[GFM_PROTO_HOST_STATUS_SIZE_MAX];
+	gfarm_int32_t mask;
+	size_t len;
+	int elapsed;
+	static const char diag[] = "GFM_PROTO_HOST_STATUS_REPORT";
+
+	*ep = GFARM_ERR_NO_ERROR;
+	gettimeofday(&now, NULL);
+	elapsed = (now.tv_sec - host_status_report_time.tv_sec) * 1000 +
+	    (now.tv_usec - host_status_report_time.tv_usec) / 1000;
+	if (elapsed >= 0 && elapsed < gfarm_host_status_report_interval)
+		return (gfarm_host_status_report_interval - elapsed);
+	if (host_status_get(&st) != 0)
+		return (gfarm_host_status_report_interval);
+
+	mask = host_status_changes(&host_status_reported, &st);
+	if (mask == 0)
+		return (gfarm_host_status_report_interval);
+	len = gfm_proto_host_status_encode(mask, &st, buf);
+	*ep = gfm_async_client_send_request(bc_conn, async, diag,
+	    gfm_async_client_host_status_report_result,
+	    gfm_async_client_host_status_report_free,
+	    NULL,
+	    GFM_PROTO_HOST_STATUS_REPORT, "b", len, buf);
+	/* keep the old values of unchanged fields to accumulate the delta */
+	if (mask & GFM_PROTO_HOST_STATUS_LOADAVG) {
+		host_status_reported.loadavg_1min = st.loadavg_1min;
+		host_status_reported.loadavg_5min = st.loadavg_5min;
+		host_status_reported.loadavg_15min = st.loadavg_15min;
+	}
+	if (mask & GFM_PROTO_HOST_STATUS_DISK) {
+		host_status_reported.disk_used = st.disk_used;
+		host_status_reported.disk_avail = st.disk_avail;
+	}
+	if (mask & GFM_PROTO_HOST_STATUS_NCLIENTS)
+		host_status_reported.nclients = st.nclients;
+	if (mask & GFM_PROTO_HOST_STATUS_QUEUE)
+		host_status_reported.queue_depth = st.queue_depth;
+	if (mask & GFM_PROTO_HOST_STATUS_IO_RATE) {
+		host_status_reported.read_rate = st.read_rate;
+		host_status_reported.write_rate = st.write_rate;
+	}
+	host_status_report_time = now;
+	return (gfarm_host_status_report_interval);
+}
+
+/*
+ * Replication requests from gfmd are processed by a pool of threads
+ * in the back channel gfsd.
+ * Requests from a same source host are queued, and processed in order
+ * by one thread at a time, reusing the cached connection to the source.
+ *
+ * As when a child process was forked for each replication,
+ * GFS_PROTO_REPLICATION_REQUEST is replied when the replication starts,
+ * with the handle, or with the error if it cannot be started.
+ * GFM_PROTO_REPLICATION_RESULT is only sent for a started replication.
+ * Both are sent by the main thread which owns the back channel,
+ * via replication_reply_head, replication_done_head and
+ * replication_notify_fds.
+ */
 static struct gfarm_hash_table *replication_queue_set = NULL;
 
+static pthread_mutex_t replication_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t replication_wakeup = PTHREAD_COND_INITIALIZER;
+static const char replication_mutex_diag[] = "replication_mutex";
+
+/*
+ * gfs_client_connection_acquire_by_host() uses gfm_server,
+ * which is replaced by the main thread when the back channel is reset.
+ */
+static pthread_mutex_t replication_gfm_server_mutex =
+	PTHREAD_MUTEX_INITIALIZER;
+static const char replication_gfm_server_diag[] = "replication_gfm_server";
+
+/* the followings are protected by replication_mutex */
+static int replication_nthreads = 0, replication_idle_threads = 0;
+static int replication_nrequests = 0; /* not finished yet */
+static struct gfarm_hash_entry *replication_ready_head = NULL;
+static struct gfarm_hash_entry **replication_ready_tail =
+	&replication_ready_head;
+static struct replication_request *replication_reply_head = NULL;
+static struct replication_request **replication_reply_tail =
+	&replication_reply_head;
+static struct replication_request *replication_done_head = NULL;
+static struct replication_request **replication_done_tail =
+	&replication_done_head;
+static gfarm_int64_t replication_handle_seq = 0;
+
+static int replication_notify_fds[2] = { -1, -1 };
+
+static int
+replication_queue_depth(void)
+{
+	int n;
+	static const char diag[] = "replication_queue_depth";
+
+	gfarm_mutex_lock(&replication_mutex, diag, replication_mutex_diag);
+	n = replication_nrequests;
+	gfarm_mutex_unlock(&replication_mutex, diag, replication_mutex_diag);
+	return (n);
+}
+
 /* per source-host queue */
 struct replication_queue_data {
+	/* pending requests, protected by replication_mutex */
 	struct replication_request *head;
 	struct replication_request **tail;
+	int active; /* being processed or in replication_ready_head */
+	struct gfarm_hash_entry *ready_next;
+
+	/* only accessed by the thread which processes this queue */
+	gfarm_error_t src_net_err;
+	int src_net_err_count;
 };
 
 gfarm_error_t
@@ -2744,181 +3198,177 @@ replication_queue_lookup(const char *hostname, int port,
 	if (created) {
 		qd->head = NULL;
 		qd->tail = &qd->head;
+		qd->active = 0;
+		qd->ready_next = NULL;
+		qd->src_net_err = GFARM_ERR_NO_ERROR;
+		qd->src_net_err_count = 0;
 	}
 	*qp = q;
 	return (GFARM_ERR_NO_ERROR);
 }
 
 struct replication_request {
-	/* only used when actual replication is ongoing */
-	struct replication_request *ongoing_next, *ongoing_prev;
-
-	struct replication_request *q_next;
-	struct gfarm_hash_entry *q;
+	struct replication_request *next; /* in a queue, or done */
+	struct replication_request *reply_next;
 
 	gfp_xdr_xid_t xid;
 	gfarm_ino_t ino;
 	gfarm_int64_t gen;
 
-	/* the followings are only used when actual replication is ongoing */
-	struct gfs_connection *src_gfsd;
-	int file_fd, pipe_fd;
-	pid_t pid;
+	/* the reply */
+	int started;
+	gfarm_int64_t handle;	/* only valid if started */
+	gfarm_error_t reply_err;	/* only valid if !started */
 
+	/* results, only valid if started */
+	gfarm_error_t src_err, dst_err;
+	gfarm_off_t filesize;
 };
 
-/* dummy header of doubly linked circular list */
-struct replication_request ongoing_replications = 
-	{ &ongoing_replications, &ongoing_replications };
+/* PREREQUISITE: replication_mutex */
+static void
+replication_notify(void)
+{
+	/* wake up the main thread, unless it's already woken up */
+	if (replication_reply_head == NULL && replication_done_head == NULL &&
+	    write(replication_notify_fds[1], "", 1) == -1)
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "replication: notify: %s", strerror(errno));
+}
 
-struct replication_errcodes {
-	gfarm_int32_t src_errcode;
-	gfarm_int32_t dst_errcode;
-};
+/* PREREQUISITE: replication_mutex */
+static void
+replication_reply(struct replication_request *rep)
+{
+	replication_notify();
+	rep->reply_next = NULL;
+	*replication_reply_tail = rep;
+	replication_reply_tail = &rep->reply_next;
+}
 
-gfarm_error_t
-try_replication(struct gfp_xdr *conn, struct gfarm_hash_entry *q,
-	gfarm_error_t *src_errp, gfarm_error_t *dst_errp)
+/* PREREQUISITE: replication_mutex */
+static void
+replication_done(struct replication_request *rep)
 {
-	gfarm_error_t e, dst_err = GFARM_ERR_NO_ERROR;
-	gfarm_error_t conn_err = GFARM_ERR_NO_ERROR;
-	struct replication_queue_data *qd = gfarm_hash_entry_data(q);
-	struct replication_request *rep = qd->head;
+	replication_notify();
+	rep->next = NULL;
+	*replication_done_tail = rep;
+	replication_done_tail = &rep->next;
+}
+
+/*
+ * open the local file and connect to the source.
+ * the returned error is the one replied to GFS_PROTO_REPLICATION_REQUEST.
+ */
+static gfarm_error_t
+replica_recv_start(struct gfarm_hash_entry *q,
+	struct replication_request *rep,
+	int *local_fdp, struct gfs_connection **src_gfsdp)
+{
+	gfarm_error_t e;
 	char *path;
-	struct gfs_connection *src_gfsd;
-	int save_errno, fds[2];
-	pid_t pid = -1;
-	struct replication_errcodes errcodes;
-	int local_fd, rv;
+	int local_fd;
 	static const char diag[] = "GFS_PROTO_REPLICATION_REQUEST";
-	struct gfarm_iostat_items *statp;
-
-	statp = gfarm_iostat_find_space(0);
 
-	/*
-	 * XXX FIXME:
-	 * gfs_client_connection_acquire_by_host() needs timeout, otherwise
-	 * the remote gfsd (or its kernel) can block this backchannel gfsd.
-	 * See http://sourceforge.net/apps/trac/gfarm/ticket/130
-	 */
 	gfsd_local_path(rep->ino, rep->gen, diag, &path);
 	local_fd = open_data(path, O_WRONLY|O_CREAT|O_TRUNC);
 	free(path);
 	if (local_fd < 0) {
-		dst_err = gfarm_errno_to_error(errno);
+		e = gfarm_errno_to_error(errno);
 		gflog_notice(GFARM_MSG_1002182,
 		    "%s: cannot open local file for %lld:%lld: %s", diag,
 		    (long long)rep->ino, (long long)rep->gen, strerror(errno));
-	} else if ((conn_err = gfs_client_connection_acquire_by_host(gfm_server,
+		return (e);
+	}
+
+	/*
+	 * XXX FIXME:
+	 * gfs_client_connection_acquire_by_host() needs timeout, otherwise
+	 * the remote gfsd (or its kernel) can block this thread.
+	 * See http://sourceforge.net/apps/trac/gfarm/ticket/130
+	 */
+	gfarm_mutex_lock(&replication_gfm_server_mutex, diag,
+	    replication_gfm_server_diag);
+	e = gfs_client_connection_acquire_by_host(gfm_server,
 	    gfp_conn_hash_hostname(q), gfp_conn_hash_port(q),
-	    &src_gfsd, listen_addrname)) != GFARM_ERR_NO_ERROR) {
+	    src_gfsdp, listen_addrname);
+	gfarm_mutex_unlock(&replication_gfm_server_mutex, diag,
+	    replication_gfm_server_diag);
+	if (e != GFARM_ERR_NO_ERROR) {
 		gflog_notice(GFARM_MSG_1002184, "%s: connecting to %s:%d: %s",
 		    diag,
 		    gfp_conn_hash_hostname(q), gfp_conn_hash_port(q),
-		    gfarm_error_string(conn_err));
-		close(local_fd);
-	} else if (pipe(fds) == -1) {
-		dst_err = gfarm_errno_to_error(errno);
-		gflog_error(GFARM_MSG_1002185, "%s: cannot create pipe: %s",
-		    diag, strerror(errno));
-		gfs_client_connection_free(src_gfsd);
-		close(local_fd);
-#ifndef HAVE_POLL /* i.e. use select(2) */
-	} else if (fds[0] >= FD_SETSIZE) { /* for select(2) */
-		dst_err = GFARM_ERR_TOO_MANY_OPEN_FILES;
-		gflog_error(GFARM_MSG_1002186, "%s: cannot select %d: %s",
-		    diag, fds[0], gfarm_error_string(dst_err));
-		close(fds[0]);
-		close(fds[1]);
-		gfs_client_connection_free(src_gfsd);
+		    gfarm_error_string(e));
 		close(local_fd);
-#endif
-	} else if ((pid = fork()) == 0) { /* child */
-		if (statp) {
-			gfarm_iostat_set_id(statp, (gfarm_uint64_t) getpid());
-			gfarm_iostat_set_local_ip(statp);
-		}
-		close(fds[0]);
-		e = gfs_client_replica_recv(src_gfsd, rep->ino, rep->gen,
-		    local_fd, &dst_err, &conn_err);
-		if (e != GFARM_ERR_NO_ERROR) {
-			gflog_warning(GFARM_MSG_1003513,
-			    "%s: replica_recv %lld:%lld: %s",
-			    diag, (long long)rep->ino, (long long)rep->gen,
-			    gfarm_error_string(e));
-		}
-		rv = close(local_fd);
-		if (rv == 0) {
-			save_errno = 0;
-		} else {
-			save_errno = errno;
-			gflog_error(GFARM_MSG_1003514,
-			    "%s: replica_recv %lld:%lld: close: %s",
-			    diag, (long long)rep->ino, (long long)rep->gen,
-			    strerror(save_errno));
-		}
-		errcodes.src_errcode = conn_err;
-		errcodes.dst_errcode =
-		    dst_err != GFARM_ERR_NO_ERROR ? dst_err :
-		    gfarm_errno_to_error(save_errno);
-		if ((rv = write(fds[1], &errcodes, sizeof(errcodes))) == -1)
-			gflog_notice(GFARM_MSG_1002188, "%s: write pipe: %s",
-			    diag, strerror(errno));
-		else if (rv != sizeof(errcodes))
-			gflog_error(GFARM_MSG_1002189, "%s: partial write: "
-			    "%d < %d", diag, rv, (int)sizeof(e));
-		close(fds[1]);
-		exit(e == GFARM_ERR_NO_ERROR ? 0 : 1);
-	} else { /* parent */
-		if (pid == -1) {
-			dst_err = gfarm_errno_to_error(errno);
-			gflog_error(GFARM_MSG_1002190,
-			    "%s: cannot create child process: %s",
-			    diag, strerror(errno));
-			close(fds[0]);
-			gfs_client_connection_free(src_gfsd);
-			close(local_fd);
-		} else {
-			if (statp) {
-				gfarm_iostat_set_id(statp, (gfarm_uint64_t)pid);
-				statp = NULL;
-			}
-			rep->src_gfsd = src_gfsd;
-			rep->file_fd = local_fd;
-			rep->pipe_fd = fds[0];
-			rep->pid = pid;
-			rep->ongoing_next = &ongoing_replications;
-			rep->ongoing_prev = ongoing_replications.ongoing_prev;
-			ongoing_replications.ongoing_prev->ongoing_next = rep;
-			ongoing_replications.ongoing_prev = rep;
-		}
-		close(fds[1]);
+		return (e);
 	}
-	if (statp)
-		gfarm_iostat_clear_ip(statp);
+	*local_fdp = local_fd;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+static void
+replica_recv(struct replication_request *rep,
+	int local_fd, struct gfs_connection *src_gfsd)
+{
+	gfarm_error_t e, src_err = GFARM_ERR_NO_ERROR;
+	gfarm_error_t dst_err = GFARM_ERR_NO_ERROR;
+	struct stat st;
+	static const char diag[] = "GFS_PROTO_REPLICATION_REQUEST";
 
-	*src_errp = conn_err;
-	*dst_errp = dst_err;
+	rep->filesize = 0;
+	e = gfs_client_replica_recv(src_gfsd, rep->ino, rep->gen,
+	    local_fd, &dst_err, &src_err);
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_warning(GFARM_MSG_1003513,
+		    "%s: replica_recv %lld:%lld: %s",
+		    diag, (long long)rep->ino, (long long)rep->gen,
+		    gfarm_error_string(e));
+	}
+	if (gfs_client_is_connection_error(src_err))
+		gfs_client_purge_from_cache(src_gfsd);
+	/* the connection remains cached for the next request */
+	gfs_client_connection_free(src_gfsd);
 
-	/* XXX FIXME, src_err and dst_err should be passed separately */
-	return (gfs_async_server_put_reply(conn, rep->xid, diag,
-	    conn_err != GFARM_ERR_NO_ERROR ? conn_err : dst_err,
-	    "l", (gfarm_int64_t)pid));
+	if (fstat(local_fd, &st) == -1) {
+		gflog_error(GFARM_MSG_1002193,
+		    "%s: cannot stat local fd: %s", diag, strerror(errno));
+		if (dst_err == GFARM_ERR_NO_ERROR)
+			dst_err = GFARM_ERR_UNKNOWN;
+	} else {
+		rep->filesize = st.st_size;
+	}
+	if (close(local_fd) == -1) {
+		gflog_error(GFARM_MSG_1003514,
+		    "%s: replica_recv %lld:%lld: close: %s",
+		    diag, (long long)rep->ino, (long long)rep->gen,
+		    strerror(errno));
+		if (dst_err == GFARM_ERR_NO_ERROR)
+			dst_err = gfarm_errno_to_error(errno);
+	}
+	rep->src_err = src_err;
+	rep->dst_err = dst_err;
 }
 
-gfarm_error_t
-start_replication(struct gfp_xdr *conn, struct gfarm_hash_entry *q)
+static void
+replication_process_queue(struct gfarm_hash_entry *q)
 {
-	gfarm_error_t gfmd_err, dst_err, src_err;
-	gfarm_error_t src_net_err = GFARM_ERR_NO_ERROR;
-	int src_net_err_count = 0;
 	struct replication_queue_data *qd = gfarm_hash_entry_data(q);
 	struct replication_request *rep;
-	static const char diag[] = "GFS_PROTO_REPLICATION_REQUEST";
+	struct gfs_connection *src_gfsd;
+	struct gfarm_iostat_items *statp;
+	gfarm_error_t e;
+	int local_fd = -1; /* shut up warning by gcc */
+	static const char diag[] = "replication_process_queue";
 
-	do {
-		if (src_net_err_count > 1) {
-			rep = qd->head;
+	/* replication_mutex is locked here */
+	while ((rep = qd->head) != NULL) {
+		qd->head = rep->next;
+		if (qd->head == NULL)
+			qd->tail = &qd->head;
+		gfarm_mutex_unlock(&replication_mutex, diag,
+		    replication_mutex_diag);
+
+		if (qd->src_net_err_count > 1) {
 			/*
 			 * avoid retries, because this may take long time,
 			 * if the host is down or network is unreachable.
@@ -2928,45 +3378,120 @@ start_replication(struct gfp_xdr *conn, struct gfarm_hash_entry *q)
 			    "because %s:%d is down: %s",
 			    (long long)rep->ino, (long long)rep->gen,
 			    gfp_conn_hash_hostname(q), gfp_conn_hash_port(q),
-			    gfarm_error_string(src_net_err));
-
-			/*
-			 * XXX FIXME
-			 * src_err and dst_err should be passed separately
-			 */
-			gfmd_err = gfs_async_server_put_reply(conn, rep->xid,
-			    diag, src_net_err, "");
-			if (gfmd_err != GFARM_ERR_NO_ERROR)
-				return (gfmd_err);
-		} else {
-			gfmd_err = try_replication(conn, q,
-			    &src_err, &dst_err);
-			if (gfmd_err != GFARM_ERR_NO_ERROR)
-				return (gfmd_err);
-			if (src_err == GFARM_ERR_NO_ERROR &&
-			    dst_err == GFARM_ERR_NO_ERROR)
-				return (GFARM_ERR_NO_ERROR);
-			if (IS_CONNECTION_ERROR(src_err)) {
-				src_net_err = src_err;
-				++src_net_err_count;
+			    gfarm_error_string(qd->src_net_err));
+			e = qd->src_net_err;
+		} else if ((e = replica_recv_start(q, rep,
+		    &local_fd, &src_gfsd)) != GFARM_ERR_NO_ERROR) {
+			if (IS_CONNECTION_ERROR(e)) {
+				qd->src_net_err = e;
+				++qd->src_net_err_count;
 			}
 		}
+		if (e != GFARM_ERR_NO_ERROR) {
+			/* XXX FIXME, src_err and dst_err should be separated */
+			gfarm_mutex_lock(&replication_mutex, diag,
+			    replication_mutex_diag);
+			rep->started = 0;
+			rep->reply_err = e;
+			replication_reply(rep);
+			continue;
+		}
 
 		/*
-		 * failed to start a replication, try next entry.
-		 *
-		 * we don't have to touch rep->ongoing_{next,prev} here,
-		 * since they are updated only after a replication actually
-		 * started or finished.
+		 * gfarm_iostat_find_space() and gfarm_iostat_clear_ip()
+		 * are serialized by replication_mutex.
 		 */
-		rep = qd->head->q_next;
-		free(qd->head);
+		gfarm_mutex_lock(&replication_mutex, diag,
+		    replication_mutex_diag);
+		rep->started = 1;
+		rep->handle = ++replication_handle_seq;
+		statp = gfarm_iostat_find_space(0);
+		if (statp)
+			gfarm_iostat_set_id(statp, (gfarm_uint64_t)rep->handle);
+		replication_reply(rep);
+		gfarm_mutex_unlock(&replication_mutex, diag,
+		    replication_mutex_diag);
+
+		gfarm_iostat_set_thread_local_ip(statp);
+		replica_recv(rep, local_fd, src_gfsd);
+		gfarm_iostat_set_thread_local_ip(NULL);
+		if (IS_CONNECTION_ERROR(rep->src_err)) {
+			qd->src_net_err = rep->src_err;
+			++qd->src_net_err_count;
+		} else {
+			qd->src_net_err_count = 0;
+		}
+
+		gfarm_mutex_lock(&replication_mutex, diag,
+		    replication_mutex_diag);
+		if (statp)
+			gfarm_iostat_clear_ip(statp);
+		replication_done(rep);
+	}
+	/* retry the source host at the next request */
+	qd->src_net_err_count = 0;
+	qd->active = 0;
+}
+
+static void *
+replication_thread(void *arg)
+{
+	struct gfarm_hash_entry *q;
+	struct replication_queue_data *qd;
+	static const char diag[] = "replication_thread";
 
-		qd->head = rep;
-	} while (rep != NULL);
+	gfarm_mutex_lock(&replication_mutex, diag, replication_mutex_diag);
+	for (;;) {
+		while ((q = replication_ready_head) == NULL) {
+			++replication_idle_threads;
+			gfarm_cond_wait(&replication_wakeup, &replication_mutex,
+			    diag, "replication_wakeup");
+			--replication_idle_threads;
+		}
+		qd = gfarm_hash_entry_data(q);
+		replication_ready_head = qd->ready_next;
+		if (replication_ready_head == NULL)
+			replication_ready_tail = &replication_ready_head;
+		qd->ready_next = NULL;
 
-	qd->tail = &qd->head;
-	return (GFARM_ERR_NO_ERROR); /* no gfmd_err */
+		replication_process_queue(q);
+	}
+	/*NOTREACHED*/
+#ifdef __GNUC__ /* shut up stupid warning by gcc */
+	return (NULL);
+#endif
+}
+
+/*
+ * PREREQUISITE: replication_mutex
+ *
+ * the number of threads is limited by gfs_proto_replication_request_window,
+ * because gfmd doesn't send more requests than that at once.
+ */
+static void
+replication_thread_add(void)
+{
+	pthread_t thread_id;
+	pthread_attr_t attr;
+	int err;
+
+	if (replication_idle_threads > 0 ||
+	    (replication_nthreads > 0 &&
+	     replication_nthreads >= gfs_proto_replication_request_window))
+		return;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	err = pthread_create(&thread_id, &attr, replication_thread, NULL);
+	pthread_attr_destroy(&attr);
+	if (err == 0)
+		++replication_nthreads;
+	else if (replication_nthreads == 0)
+		fatal(GFARM_MSG_UNFIXED, "cannot create replication thread: %s",
+		    strerror(err));
+	else
+		gflog_warning(GFARM_MSG_UNFIXED,
+		    "cannot create replication thread: %s", strerror(err));
 }
 
 gfarm_error_t
@@ -2993,45 +3518,43 @@ gfs_async_server_replication_request(struct gfp_xdr *conn,
 		gflog_error(GFARM_MSG_1002516,
 		    "cannot allocate replication queue for %s:%d: %s",
 		    host, port, gfarm_error_string(e));
-	} else {
-		GFARM_MALLOC(rep);
-		if (rep == NULL) {
-			e = GFARM_ERR_NO_MEMORY;
-			gflog_error(GFARM_MSG_1002517,
-			    "cannot allocate replication record for "
-			    "%s:%d %lld:%lld: no memory",
-			    host, port, (long long)ino, (long long)gen);
-		} else {
-			free(host);
-
-			rep->xid = xid;
-			rep->ino = ino;
-			rep->gen = gen;
-
-			/* not set yet, will be set in try_replication() */
-			rep->src_gfsd = NULL;
-			rep->file_fd = -1;
-			rep->pipe_fd = -1;
-			rep->pid = 0;
-			rep->ongoing_next = rep->ongoing_prev = rep;
-
-			rep->q = q;
-			rep->q_next = NULL;
-
-			qd = gfarm_hash_entry_data(q);
-			*qd->tail = rep;
-			qd->tail = &rep->q_next;
-			if (qd->head == rep) { /* this host is idle */
-				return (start_replication(conn, q));
-			} else { /* the replication is postponed */
-				return (GFARM_ERR_NO_ERROR);
-			}
-		}
+		free(host);
+		return (gfs_async_server_put_reply(conn, xid, diag, e, ""));
+	}
+	GFARM_MALLOC(rep);
+	if (rep == NULL) {
+		e = GFARM_ERR_NO_MEMORY;
+		gflog_error(GFARM_MSG_1002517,
+		    "cannot allocate replication record for "
+		    "%s:%d %lld:%lld: no memory",
+		    host, port, (long long)ino, (long long)gen);
+		free(host);
+		return (gfs_async_server_put_reply(conn, xid, diag, e, ""));
 	}
 	free(host);
 
-	/* only used in an error case */
-	return (gfs_async_server_put_reply(conn, xid, diag, e, ""));
+	rep->next = NULL;
+	rep->xid = xid;
+	rep->ino = ino;
+	rep->gen = gen;
+	rep->started = 0;
+
+	/* replied by replication_result_notify(), when this is started */
+	gfarm_mutex_lock(&replication_mutex, diag, replication_mutex_diag);
+	qd = gfarm_hash_entry_data(q);
+	*qd->tail = rep;
+	qd->tail = &rep->next;
+	++replication_nrequests;
+	if (!qd->active) { /* this host is idle */
+		qd->active = 1;
+		*replication_ready_tail = q;
+		replication_ready_tail = &qd->ready_next;
+		replication_thread_add();
+		gfarm_cond_signal(&replication_wakeup, diag,
+		    "replication_wakeup");
+	}
+	gfarm_mutex_unlock(&replication_mutex, diag, replication_mutex_diag);
+	return (GFARM_ERR_NO_ERROR);
 }
 
 #if 0 /* not yet in gfarm v2 */
@@ -3079,6 +3602,7 @@ gfs_server_striping_read(struct gfp_xdr *client)
 			}
 			gfarm_iostat_local_add(GFARM_IOSTAT_IO_RCOUNT, 1);
 			gfarm_iostat_local_add(GFARM_IOSTAT_IO_RBYTES, rv);
+			gfsd_hoststat_add(GFSD_HOSTSTAT_READ, rv);
 			e = gfp_xdr_send(client, "b", rv, buffer);
 			if (e != GFARM_ERR_NO_ERROR) {
 				error = e;
@@ -3639,6 +4163,7 @@ clear_child(void)
 		if (pid == -1 || pid == 0)
 			break;
 		gfarm_iostat_clear_id(pid, 0);
+		gfsd_hoststat_slot_free_by_pid(pid);
 	}
 }
 
@@ -3702,6 +4227,7 @@ server(int client_fd, char *client_name, struct sockaddr *client_addr)
 		fatal(GFARM_MSG_1000554, "%s: gfp_xdr_new: %s",
 		    client_name, gfarm_error_string(e));
 	}
+	gfp_xdr_set_profile(client, GFP_XDR_PROFILE_BULK);
 
 	e = gfarm_authorize(client, 0, GFS_SERVICE_TAG,
 	    client_name, client_addr,
@@ -3807,6 +4333,12 @@ server(int client_fd, char *client_name, struct sockaddr *client_addr)
 		case GFS_PROTO_FHOPEN:
 			gfs_server_fhopen(client, xid, size, peer_type);
 			break;
+		case GFS_PROTO_REPLICA_ADD_FROM_RELAY:
+			gfs_server_replica_add_from_relay(client, xid, size);
+			break;
+		case GFS_PROTO_FHOPEN_RELAY:
+			gfs_server_fhopen_relay(client, xid, size, peer_type);
+			break;
 #else /* implementation until gfarm-2.X and before */
 		case GFS_PROTO_REPLICA_RECV:
 			gfs_server_replica_recv(client, xid, size, peer_type);
@@ -3840,6 +4372,7 @@ start_server(int accepting_sock,
 	int i, client = accept(accepting_sock,
 	   client_addr_storage, &client_addr_size);
 	struct gfarm_iostat_items *statp;
+	struct gfsd_hoststat_slot *slot;
 
 	if (client < 0) {
 		if (errno == EINTR || errno == ECONNABORTED ||
@@ -3851,6 +4384,7 @@ start_server(int accepting_sock,
 		fatal_errno(GFARM_MSG_1000559, "accept");
 	}
 	statp = gfarm_iostat_find_space(0);
+	slot = gfsd_hoststat_slot_alloc();
 #ifndef GFSD_DEBUG
 	switch ((pid = fork())) {
 	case 0:
@@ -3859,6 +4393,7 @@ start_server(int accepting_sock,
 			gfarm_iostat_set_id(statp, (gfarm_uint64_t) getpid());
 			gfarm_iostat_set_local_ip(statp);
 		}
+		gfsd_hoststat_slot_attach(slot);
 		for (i = 0; i < accepting->local_socks_count; i++)
 			close(accepting->local_socks[i].sock);
 		close(accepting->tcp_sock);
@@ -3880,6 +4415,7 @@ start_server(int accepting_sock,
 	} else {
 		gfarm_iostat_clear_ip(statp);
 	}
+	gfsd_hoststat_slot_set_pid(slot, pid);
 #endif
 }
 
@@ -3940,124 +4476,115 @@ gfm_async_client_replication_free(void *peer, void *arg)
 
 gfarm_error_t
 replication_result_notify(struct gfp_xdr *bc_conn,
-	gfp_xdr_async_peer_t async, struct gfarm_hash_entry *q)
+	gfp_xdr_async_peer_t async)
 {
-	gfarm_error_t e, e2 = GFARM_ERR_NO_ERROR;
-	struct replication_queue_data *qd = gfarm_hash_entry_data(q);
-	struct replication_request *rep = qd->head;
-	struct replication_errcodes errcodes;
-	int rv = read(rep->pipe_fd, &errcodes, sizeof(errcodes)), status;
-	struct stat st;
+	gfarm_error_t e = GFARM_ERR_NO_ERROR;
+	struct replication_request *reply, *rep, *next;
+	char buf[64];
 	static const char diag[] = "GFM_PROTO_REPLICATION_RESULT";
+	static const char reply_diag[] = "GFS_PROTO_REPLICATION_REQUEST";
 
-	if (rv != sizeof(errcodes)) {
-		if (rv == -1) {
-			gflog_error(GFARM_MSG_1002191,
-			    "%s: cannot read child result: %s",
-			    diag, strerror(errno));
+	if (read(replication_notify_fds[0], buf, sizeof(buf)) == -1)
+		gflog_error(GFARM_MSG_1002191,
+		    "%s: cannot read replication notification: %s",
+		    diag, strerror(errno));
+
+	/*
+	 * a started replication may be in both lists.
+	 * the reply is sent before the result, since gfmd needs the handle.
+	 */
+	gfarm_mutex_lock(&replication_mutex, diag, replication_mutex_diag);
+	reply = replication_reply_head;
+	replication_reply_head = NULL;
+	replication_reply_tail = &replication_reply_head;
+	for (next = reply; next != NULL; next = next->reply_next) {
+		if (!next->started)
+			--replication_nrequests;
+	}
+	rep = replication_done_head;
+	replication_done_head = NULL;
+	replication_done_tail = &replication_done_head;
+	for (next = rep; next != NULL; next = next->next)
+		--replication_nrequests;
+	gfarm_mutex_unlock(&replication_mutex, diag, replication_mutex_diag);
+
+	for (; reply != NULL; reply = next) {
+		next = reply->reply_next;
+		if (reply->started) {
+			if (e == GFARM_ERR_NO_ERROR)
+				e = gfs_async_server_put_reply(bc_conn,
+				    reply->xid, reply_diag, GFARM_ERR_NO_ERROR,
+				    "l", reply->handle);
 		} else {
-			gflog_error(GFARM_MSG_1002192,
-			    "%s: too short child result: %d bytes", diag, rv);
+			if (e == GFARM_ERR_NO_ERROR)
+				e = gfs_async_server_put_reply(bc_conn,
+				    reply->xid, reply_diag, reply->reply_err,
+				    "");
+			free(reply);
 		}
-		errcodes.src_errcode = 0;
-		errcodes.dst_errcode = GFARM_ERR_UNKNOWN;
-	} else if (fstat(rep->file_fd, &st) == -1) {
-		gflog_error(GFARM_MSG_1002193,
-		    "%s: cannot stat local fd: %s", diag, strerror(errno));
-		if (errcodes.dst_errcode == GFARM_ERR_NO_ERROR)
-			errcodes.dst_errcode = GFARM_ERR_UNKNOWN;
-	}
-	e = gfm_async_client_send_request(bc_conn, async, diag,
-	    gfm_async_client_replication_result,
-	    gfm_async_client_replication_free,
-	    /* rep */ NULL,
-	    GFM_PROTO_REPLICATION_RESULT, "llliil",
-	    rep->ino, rep->gen, (gfarm_int64_t)rep->pid,
-	    errcodes.src_errcode, errcodes.dst_errcode,
-	    (gfarm_int64_t)st.st_size);
-	close(rep->pipe_fd);
-	close(rep->file_fd);
-	if ((rv = waitpid(rep->pid, &status, 0)) == -1)
-		gflog_warning(GFARM_MSG_1002303,
-		    "replication(%lld, %lld): child %d: %s",
-		    (long long)rep->ino, (long long)rep->gen, (int)rep->pid,
-		    strerror(errno));
-	else
-		gfarm_iostat_clear_id(rep->pid, 0);
-
-	if (gfs_client_is_connection_error(errcodes.src_errcode))
-		gfs_client_purge_from_cache(rep->src_gfsd);
-	gfs_client_connection_free(rep->src_gfsd);
-
-	rep->ongoing_prev->ongoing_next = rep->ongoing_next;
-	rep->ongoing_next->ongoing_prev = rep->ongoing_prev;
+	}
+	for (; rep != NULL; rep = next) {
+		next = rep->next;
+		if (e == GFARM_ERR_NO_ERROR)
+			e = gfm_async_client_send_request(bc_conn, async, diag,
+			    gfm_async_client_replication_result,
+			    gfm_async_client_replication_free,
+			    /* rep */ NULL,
+			    GFM_PROTO_REPLICATION_RESULT, "llliil",
+			    rep->ino, rep->gen, rep->handle,
+			    rep->src_err, rep->dst_err,
+			    (gfarm_int64_t)rep->filesize);
+		free(rep);
+	}
+	return (e);
+}
 
-	rep = rep->q_next;
-	free(qd->head);
+/*
+ * returns the timeout of poll(2) or select(2) in milliseconds,
+ * or -1, if GFM_PROTO_HOST_STATUS_REPORT fails.
+ */
+static int
+watch_fds_timeout(struct gfp_xdr *conn, gfp_xdr_async_peer_t async,
+	time_t deadline)
+{
+	gfarm_error_t e;
+	int timeout, next;
+	time_t now = time(NULL);
 
-	qd->head = rep;
-	if (rep == NULL) {
-		qd->tail = &qd->head;
-	} else {
-		e2 = start_replication(bc_conn, q);
+	timeout = now < deadline ? (deadline - now) * 1000 : 0;
+	if (!host_status_push_enabled)
+		return (timeout);
+	next = host_status_report_if_changed(conn, async, &e);
+	if (e != GFARM_ERR_NO_ERROR) {
+		gflog_error(GFARM_MSG_UNFIXED,
+		    "back channel: host status report: %s",
+		    gfarm_error_string(e));
+		return (-1);
 	}
-
-	return (e != GFARM_ERR_NO_ERROR ? e : e2);
+	return (next < timeout ? next : timeout);
 }
 
 static int
 watch_fds(struct gfp_xdr *conn, gfp_xdr_async_peer_t async)
 {
 	gfarm_error_t e;
-	int nfound;
-	struct replication_request *rep;
-
+	int nfound, replication_done_ready, gfmd_ready, msec;
+	time_t deadline = time(NULL) + gfarm_metadb_heartbeat_interval * 2;
 #ifdef HAVE_POLL
-#define MIN_NFDS 32
-	int gfmd_fd, i, n, n_alloc;
-
-	static int nfds = 0;
-	static struct pollfd *fds = NULL;
-	static struct replication_request **fd_rep_map = NULL;
+	struct pollfd fds[2];
 
 	for (;;) {
-		gfmd_fd = gfp_xdr_fd(conn);
-		n = 1; /* fds[0] is for gfmd_fd */
-		for (rep = ongoing_replications.ongoing_next;
-		    rep != &ongoing_replications; rep = rep->ongoing_next)
-			++n;
-		if (nfds < n) {
-			if (nfds < MIN_NFDS)
-				n_alloc = MIN_NFDS;
-			else
-				n_alloc = nfds * 2;
-			while (n_alloc < n)
-				n_alloc *= 2;
-			GFARM_REALLOC_ARRAY(fds, fds, n_alloc);
-			GFARM_REALLOC_ARRAY(fd_rep_map, fd_rep_map, n_alloc);
-			if (fds == NULL || fd_rep_map == NULL) {
-				gflog_fatal(GFARM_MSG_1003670,
-				    "no memory for %d descriptors, "
-				    "current = %d, alloc = %d",
-				    n, nfds, n_alloc);
-			}
-			nfds = n_alloc;
-		}
-		fds[0].fd = gfmd_fd;
+		fds[0].fd = gfp_xdr_fd(conn);
 		fds[0].events = POLLIN;
-		fd_rep_map[0] = NULL;
-		n = 1;
-		for (rep = ongoing_replications.ongoing_next;
-		    rep != &ongoing_replications; rep = rep->ongoing_next) {
-			fds[n].fd = rep->pipe_fd;
-			fds[n].events = POLLIN;
-			fd_rep_map[n] = rep;
-			++n;
-		}
+		fds[1].fd = replication_notify_fds[0];
+		fds[1].events = POLLIN;
 
-		nfound =
-		    poll(fds, n, gfarm_metadb_heartbeat_interval * 2 * 1000);
+		if ((msec = watch_fds_timeout(conn, async, deadline)) < 0)
+			return (0);
+		nfound = poll(fds, 2, msec);
 		if (nfound == 0) {
+			if (time(NULL) < deadline)
+				continue;
 			gflog_error(GFARM_MSG_1003671,
 			    "back channel: gfmd is down");
 			return (0);
@@ -4067,45 +4594,30 @@ watch_fds(struct gfp_xdr *conn, gfp_xdr_async_peer_t async)
 				continue;
 			fatal_errno(GFARM_MSG_1003672, "back channel poll");
 		}
-		for (i = 1; i < n; i++) {
-			if (fds[i].revents == 0)
-				continue;
-			e = replication_result_notify(conn, async,
-			    fd_rep_map[i]->q);
-			if (e != GFARM_ERR_NO_ERROR) {
-				gflog_error(GFARM_MSG_1003673,
-				    "back channel: "
-				    "communication error: %s",
-				    gfarm_error_string(e));
-				return (0);
-			}
-			
-		}
-		if (fds[0].revents != 0) /* check gfmd_fd */
-			return (1);
-	}
+		gfmd_ready = fds[0].revents != 0;
+		replication_done_ready = fds[1].revents != 0;
 #else /* !HAVE_POLL */
 	fd_set fds;
 	int max_fd;
 	struct timeval timeout;
-	struct replication_request *next;
 
 	for (;;) {
 		FD_ZERO(&fds);
+		FD_SET(gfp_xdr_fd(conn), &fds);
+		FD_SET(replication_notify_fds[0], &fds);
 		max_fd = gfp_xdr_fd(conn);
-		FD_SET(max_fd, &fds);
-		for (rep = ongoing_replications.ongoing_next;
-		    rep != &ongoing_replications; rep = rep->ongoing_next) {
-			FD_SET(rep->pipe_fd, &fds);
-			if (max_fd < rep->pipe_fd)
-				max_fd = rep->pipe_fd;
-		}
+		if (max_fd < replication_notify_fds[0])
+			max_fd = replication_notify_fds[0];
 
-		timeout.tv_sec = gfarm_metadb_heartbeat_interval * 2;
-		timeout.tv_usec = 0;
+		if ((msec = watch_fds_timeout(conn, async, deadline)) < 0)
+			return (0);
+		timeout.tv_sec = msec / 1000;
+		timeout.tv_usec = msec % 1000 * 1000;
 
 		nfound = select(max_fd + 1, &fds, NULL, NULL, &timeout);
 		if (nfound == 0) {
+			if (time(NULL) < deadline)
+				continue;
 			gflog_error(GFARM_MSG_1002304,
 			    "back channel: gfmd is down");
 			return (0);
@@ -4115,43 +4627,25 @@ watch_fds(struct gfp_xdr *conn, gfp_xdr_async_peer_t async)
 				continue;
 			fatal_errno(GFARM_MSG_1002194, "back channel select");
 		}
-
-		for (rep = ongoing_replications.ongoing_next;
-		    rep != &ongoing_replications; rep = next) {
-			if (FD_ISSET(rep->pipe_fd, &fds)) {
-				/*
-				 * replication_result_notify() may add an entry
-				 * at the tail of the ongoing_replications.
-				 * accessing and ignoring the new entry at
-				 * further iteration of this loop are both ok.
-				 */
-				next = rep->ongoing_next;
-
-				/*
-				 * the following is necessary to make it
-				 * possible to access a new entry in this loop.
-				 * note that the new entry may use same pipe_fd
-				 * with this rep->pipe_fd.
-				 */
-				FD_CLR(rep->pipe_fd, &fds);
-
-				e = replication_result_notify(conn, async,
-				    rep->q);
-				if (e != GFARM_ERR_NO_ERROR) {
-					gflog_error(GFARM_MSG_1002385,
-					    "back channel: "
-					    "communication error: %s",
-					    gfarm_error_string(e));
-					return (0);
-				}
-			} else {
-				next = rep->ongoing_next;
+		gfmd_ready = FD_ISSET(gfp_xdr_fd(conn), &fds);
+		replication_done_ready =
+		    FD_ISSET(replication_notify_fds[0], &fds);
+#endif /* !HAVE_POLL */
+		if (replication_done_ready) {
+			e = replication_result_notify(conn, async);
+			if (e != GFARM_ERR_NO_ERROR) {
+				gflog_error(GFARM_MSG_1003673,
+				    "back channel: "
+				    "communication error: %s",
+				    gfarm_error_string(e));
+				return (0);
 			}
+			deadline =
+			    time(NULL) + gfarm_metadb_heartbeat_interval * 2;
 		}
-		if (FD_ISSET(gfp_xdr_fd(conn), &fds))
+		if (gfmd_ready)
 			return (1);
 	}
-#endif /* !HAVE_POLL */
 }
 
 static void
@@ -4161,29 +4655,45 @@ kill_pending_replications(void)
 	struct gfarm_hash_entry *q;
 	struct replication_queue_data *qd;
 	struct replication_request *rep, *next;
+	static const char diag[] = "kill_pending_replications";
 
 	if (replication_queue_set == NULL)
 		return;
+	gfarm_mutex_lock(&replication_mutex, diag, replication_mutex_diag);
 	for (gfarm_hash_iterator_begin(replication_queue_set, &it);
 	     !gfarm_hash_iterator_is_end(&it);
 	     gfarm_hash_iterator_next(&it)) {
 		q = gfarm_hash_iterator_access(&it);
 		qd = gfarm_hash_entry_data(q);
-		if (qd->head == NULL)
-			continue;
-		/* do not free active replication (i.e. qd->head) */
-		for (rep = qd->head->q_next; rep != NULL; rep = next) {
-			next = rep->q_next;
+		/* active replications are not in qd->head */
+		for (rep = qd->head; rep != NULL; rep = next) {
+			next = rep->next;
 			gflog_debug(GFARM_MSG_1002518,
 			    "forget pending replication request "
 			    "%s:%d %lld:%lld",
 			    gfp_conn_hash_hostname(q), gfp_conn_hash_port(q),
 			    (long long)rep->ino, (long long)rep->gen);
 			free(rep);
+			--replication_nrequests;
 		}
-		qd->head->q_next = NULL;
-		qd->tail = &qd->head->q_next;		
+		qd->head = NULL;
+		qd->tail = &qd->head;
 	}
+
+	/*
+	 * the replies are for the old back channel.
+	 * the results of started replications are still sent to gfmd.
+	 */
+	for (rep = replication_reply_head; rep != NULL; rep = next) {
+		next = rep->reply_next;
+		if (!rep->started) {
+			free(rep);
+			--replication_nrequests;
+		}
+	}
+	replication_reply_head = NULL;
+	replication_reply_tail = &replication_reply_head;
+	gfarm_mutex_unlock(&replication_mutex, diag, replication_mutex_diag);
 }
 
 static void
@@ -4199,6 +4709,7 @@ back_channel_server(void)
 	gfarm_int32_t gfmd_knows_me, rv, request;
 
 	static int hack_to_make_cookie_not_work = 0; /* XXX FIXME */
+	static const char diag[] = "back_channel_server";
 
 	if (iostat_dirbuf) {
 		strcpy(&iostat_dirbuf[iostat_dirlen], "bcs");
@@ -4210,7 +4721,12 @@ back_channel_server(void)
 				iostat_dirbuf, gfarm_error_string(e));
 	}
 
+	if (pipe(replication_notify_fds) == -1)
+		fatal_errno(GFARM_MSG_1002185, "replication: cannot create pipe");
+
 	for (;;) {
+		gfarm_mutex_lock(&replication_gfm_server_mutex, diag,
+		    replication_gfm_server_diag);
 		e = gfm_client_switch_async_back_channel(gfm_server,
 		    GFS_PROTOCOL_VERSION,
 		    (gfarm_int64_t)(getpid() + hack_to_make_cookie_not_work++),
@@ -4235,13 +4751,18 @@ back_channel_server(void)
 
 		back_channel = gfm_server;
 		bc_conn = gfm_client_connection_conn(gfm_server);
+		gfp_xdr_set_profile(bc_conn, GFP_XDR_PROFILE_BACK_CHANNEL);
  
 		/* create another gfmd connection for a foreground channel */
 		gfm_server = NULL;
 		if ((e = connect_gfm_server()) != GFARM_ERR_NO_ERROR)
 			fatal(GFARM_MSG_1003363, "die");
+		gfarm_mutex_unlock(&replication_gfm_server_mutex, diag,
+		    replication_gfm_server_diag);
 
 		gflog_debug(GFARM_MSG_1000563, "back channel mode");
+		/* until GFS_PROTO_STATUS2 is received from the new gfmd */
+		host_status_push_enabled = 0;
 		for (;;) {
 			if (!gfp_xdr_recv_is_ready(bc_conn)) {
 				if (!watch_fds(bc_conn, async))
@@ -4310,10 +4831,18 @@ back_channel_server(void)
 				e = gfs_async_server_fhremove(
 				    bc_conn, xid, size);
 				break;
+			case GFS_PROTO_FHREMOVE_MULTI:
+				e = gfs_async_server_fhremove_multi(
+				    bc_conn, xid, size);
+				break;
 			case GFS_PROTO_STATUS:
 				e = gfs_async_server_status(
 				    bc_conn, xid, size);
 				break;
+			case GFS_PROTO_STATUS2:
+				e = gfs_async_server_status2(
+				    bc_conn, xid, size);
+				break;
 			case GFS_PROTO_REPLICATION_REQUEST:
 				e = gfs_async_server_replication_request(
 				    bc_conn, gfm_client_username(back_channel),
@@ -4344,6 +4873,8 @@ back_channel_server(void)
 		kill_pending_replications();
 
 		/* free the foreground channel */
+		gfarm_mutex_lock(&replication_gfm_server_mutex, diag,
+		    replication_gfm_server_diag);
 		gfm_client_connection_free(gfm_server);
 
 		gfp_xdr_async_peer_free(async, bc_conn);
@@ -4351,6 +4882,8 @@ back_channel_server(void)
 		free_gfm_server();
 		if ((e = connect_gfm_server()) != GFARM_ERR_NO_ERROR)
 			fatal(GFARM_MSG_1003364, "die");
+		gfarm_mutex_unlock(&replication_gfm_server_mutex, diag,
+		    replication_gfm_server_diag);
 	}
 }
 
@@ -4689,6 +5222,9 @@ main(int argc, char **argv)
 		break;
 	}
 	assert(e == GFARM_ERR_NO_ERROR);
+	/* the check explicitly requested by -c should not be skipped */
+	if (spool_check_level > 0)
+		gfarm_spool_check_incremental = 0;
 
 	e = gfarm_server_initialize(config_file, &argc, &argv);
 	if (e != GFARM_ERR_NO_ERROR) {
@@ -4928,6 +5464,10 @@ main(int argc, char **argv)
 		gflog_fatal_errno(GFARM_MSG_1002404,
 		    "signal(SIGPIPE, SIG_IGN)");
 
+	/* shared by the back channel gfsd and the children */
+	gfsd_hoststat_init();
+	gfsd_replica_relay_init();
+
 	/* start back channel server */
 	start_back_channel_server();
 
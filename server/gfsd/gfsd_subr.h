@@ -15,6 +15,31 @@ int gfsd_statfs(char *, gfarm_int32_t *,
 	gfarm_off_t *, gfarm_off_t *, gfarm_off_t *);
 
 void gfsd_spool_check();
+void gfsd_spool_check_state_save(void);
+
+#define GFSD_HOSTSTAT_READ	0
+#define GFSD_HOSTSTAT_WRITE	1
+#define GFSD_HOSTSTAT_NTYPES	2
+
+struct gfsd_hoststat_slot;
+
+void gfsd_hoststat_init(void);
+struct gfsd_hoststat_slot *gfsd_hoststat_slot_alloc(void);
+void gfsd_hoststat_slot_set_pid(struct gfsd_hoststat_slot *, pid_t);
+void gfsd_hoststat_slot_free_by_pid(pid_t);
+void gfsd_hoststat_slot_attach(struct gfsd_hoststat_slot *);
+int gfsd_hoststat_slot_index(void);
+int gfsd_hoststat_nslots(void);
+void gfsd_hoststat_add(int, size_t);
+void gfsd_hoststat_get(gfarm_int32_t *, gfarm_uint64_t *, gfarm_uint64_t *);
+
+void gfsd_replica_relay_init(void);
+void gfsd_replica_relay_begin(gfarm_ino_t, gfarm_uint64_t);
+void gfsd_replica_relay_end(gfarm_error_t);
+gfarm_error_t gfsd_replica_relay_attach(gfarm_ino_t, gfarm_uint64_t);
+void gfsd_replica_relay_detach(void);
+int gfsd_replica_relay_is_attached(void);
+ssize_t gfsd_replica_relay_read(int, void *, size_t, off_t);
 
 #define fatal_metadb_proto(msg_no, diag, proto, e) \
 	fatal_metadb_proto_full(msg_no, __FILE__, __LINE__, __func__, \
@@ -0,0 +1,183 @@
+/*
+ * load statistics of this filesystem node, reported to gfmd
+ *
+ * All gfsd processes share a table in an anonymous shared memory.
+ * The master gfsd assigns a slot to each client connection at fork(2),
+ * and the child counts the bytes read and written in the slot.
+ * The counters of a slot are cumulative over the successive children
+ * which use the slot, and each of them is written by one process at a time,
+ * thus no lock is necessary.  The back channel gfsd sums up the table,
+ * so the result may be slightly inconsistent, but it's enough for
+ * statistics.
+ *
+ * $Id$
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/mman.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfutil.h"
+
+#include "config.h"
+
+#include "gfsd_subr.h"
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS	MAP_ANON
+#endif
+
+#define HOSTSTAT_SLOT_FREE	0
+#define HOSTSTAT_SLOT_RESERVED	((pid_t)-1)
+
+#define HOSTSTAT_RATE_PERIOD	1.0 /* seconds */
+
+struct gfsd_hoststat_slot {
+	pid_t pid;		/* written by the master gfsd */
+	gfarm_uint64_t bytes[GFSD_HOSTSTAT_NTYPES]; /* written by the child */
+};
+
+static struct gfsd_hoststat_slot *hoststat_slots = NULL;
+static int hoststat_nslots = 0;
+
+/* the slot of this process, if this is a gfsd child */
+static struct gfsd_hoststat_slot *hoststat_self = NULL;
+
+/* only accessed by the back channel gfsd */
+static struct timeval hoststat_rate_time;
+static gfarm_uint64_t hoststat_rate_bytes[GFSD_HOSTSTAT_NTYPES];
+static gfarm_uint64_t hoststat_rate[GFSD_HOSTSTAT_NTYPES];
+
+/* this must be called before fork(2) of the back channel gfsd */
+void
+gfsd_hoststat_init(void)
+{
+	void *addr;
+	size_t size;
+
+	hoststat_nslots = gfarm_iostat_max_client;
+	size = sizeof(*hoststat_slots) * hoststat_nslots;
+	addr = mmap(NULL, size, PROT_READ|PROT_WRITE,
+	    MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+	if (addr == MAP_FAILED) {
+		gflog_warning_errno(GFARM_MSG_UNFIXED,
+		    "hoststat: mmap %zu bytes", size);
+		hoststat_nslots = 0;
+		return;
+	}
+	memset(addr, 0, size);
+	hoststat_slots = addr;
+}
+
+/* called by the master gfsd before fork(2) of a child */
+struct gfsd_hoststat_slot *
+gfsd_hoststat_slot_alloc(void)
+{
+	int i;
+
+	for (i = 0; i < hoststat_nslots; i++) {
+		if (hoststat_slots[i].pid == HOSTSTAT_SLOT_FREE) {
+			hoststat_slots[i].pid = HOSTSTAT_SLOT_RESERVED;
+			return (&hoststat_slots[i]);
+		}
+	}
+	return (NULL); /* too many clients, this one is not accounted */
+}
+
+/* called by the master gfsd after fork(2), pid == -1 means failure */
+void
+gfsd_hoststat_slot_set_pid(struct gfsd_hoststat_slot *slot, pid_t pid)
+{
+	if (slot != NULL)
+		slot->pid = pid == -1 ? HOSTSTAT_SLOT_FREE : pid;
+}
+
+/* called by the master gfsd after waitpid(2) */
+void
+gfsd_hoststat_slot_free_by_pid(pid_t pid)
+{
+	int i;
+
+	for (i = 0; i < hoststat_nslots; i++) {
+		if (hoststat_slots[i].pid == pid) {
+			hoststat_slots[i].pid = HOSTSTAT_SLOT_FREE;
+			return;
+		}
+	}
+}
+
+/* called by a child after fork(2) */
+void
+gfsd_hoststat_slot_attach(struct gfsd_hoststat_slot *slot)
+{
+	hoststat_self = slot;
+}
+
+/* the index of the slot of this process, or -1 if it has no slot */
+int
+gfsd_hoststat_slot_index(void)
+{
+	return (hoststat_self == NULL ? -1 : hoststat_self - hoststat_slots);
+}
+
+int
+gfsd_hoststat_nslots(void)
+{
+	return (hoststat_nslots);
+}
+
+void
+gfsd_hoststat_add(int type, size_t bytes)
+{
+	if (hoststat_self != NULL)
+		hoststat_self->bytes[type] += bytes;
+}
+
+/*
+ * called by the back channel gfsd.
+ * the I/O rates are averaged over HOSTSTAT_RATE_PERIOD at least.
+ */
+void
+gfsd_hoststat_get(gfarm_int32_t *nclientsp,
+	gfarm_uint64_t *read_ratep, gfarm_uint64_t *write_ratep)
+{
+	int i, t, nclients = 0;
+	gfarm_uint64_t bytes[GFSD_HOSTSTAT_NTYPES];
+	struct timeval now;
+	double elapsed;
+
+	memset(bytes, 0, sizeof(bytes));
+	for (i = 0; i < hoststat_nslots; i++) {
+		if (hoststat_slots[i].pid != HOSTSTAT_SLOT_FREE)
+			nclients++;
+		for (t = 0; t < GFSD_HOSTSTAT_NTYPES; t++)
+			bytes[t] += hoststat_slots[i].bytes[t];
+	}
+
+	gettimeofday(&now, NULL);
+	if (hoststat_rate_time.tv_sec == 0) {
+		/* first call */
+		hoststat_rate_time = now;
+		memcpy(hoststat_rate_bytes, bytes, sizeof(bytes));
+	} else {
+		elapsed = (now.tv_sec - hoststat_rate_time.tv_sec) +
+		    (now.tv_usec - hoststat_rate_time.tv_usec) * .000001;
+		if (elapsed >= HOSTSTAT_RATE_PERIOD) {
+			for (t = 0; t < GFSD_HOSTSTAT_NTYPES; t++) {
+				hoststat_rate[t] =
+				    bytes[t] >= hoststat_rate_bytes[t] ?
+				    (bytes[t] - hoststat_rate_bytes[t]) /
+				    elapsed : 0;
+			}
+			hoststat_rate_time = now;
+			memcpy(hoststat_rate_bytes, bytes, sizeof(bytes));
+		}
+	}
+	*nclientsp = nclients;
+	*read_ratep = hoststat_rate[GFSD_HOSTSTAT_READ];
+	*write_ratep = hoststat_rate[GFSD_HOSTSTAT_WRITE];
+}
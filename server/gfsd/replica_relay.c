@@ -0,0 +1,265 @@
+/*
+ * relay of a file replica which is being created
+ *
+ * A chained replication source -> dst1 -> dst2 -> ... is done by
+ * GFS_PROTO_REPLICA_ADD_FROM_RELAY, dst2 reads the replica on dst1 by
+ * GFS_PROTO_FHOPEN_RELAY and GFS_PROTO_PREAD while dst1 is still receiving
+ * it from the source.
+ *
+ * All gfsd processes share a table in an anonymous shared memory.
+ * The table is indexed by the hoststat slot of a gfsd child, thus each entry
+ * is written only by the child which receives a replica (writer),
+ * and no lock is necessary.  The entry of a finished replication is kept
+ * until the slot is used by another replication, and `seq' tells whether
+ * the entry is reused or not.  The results of the last RELAY_NHISTORY
+ * replications in the slot are kept in `failed', so that a reader
+ * can tell whether a replication in a reused entry has failed or not.
+ * A child which reads the replica (reader) waits for the data which has not
+ * been written yet, until the writer finishes.
+ *
+ * $Id$
+ */
+
+#include <stddef.h>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+
+#include <gfarm/gfarm.h>
+
+#include "gfutil.h"
+#include "nanosec.h"
+
+#include "context.h"
+
+#include "gfsd_subr.h"
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS	MAP_ANON
+#endif
+
+#define RELAY_STATE_NONE	0
+#define RELAY_STATE_IN_PROGRESS	1
+#define RELAY_STATE_DONE	2
+#define RELAY_STATE_FAILED	3
+
+#define RELAY_POLL_INTERVAL	10000000 /* nanoseconds, i.e. 10ms */
+
+#define RELAY_NHISTORY		64 /* number of bits of `failed' */
+#define RELAY_FAILED_BIT(seq)	((gfarm_uint64_t)1 << ((seq) % RELAY_NHISTORY))
+
+struct gfsd_replica_relay {
+	pid_t pid;
+	gfarm_ino_t ino;
+	gfarm_uint64_t gen;
+	gfarm_uint64_t seq;
+	gfarm_uint64_t failed; /* RELAY_FAILED_BIT(seq) is set if failed */
+	int state;
+};
+
+static volatile struct gfsd_replica_relay *relay_table = NULL;
+static int relay_nentries = 0;
+
+/* writer */
+static volatile struct gfsd_replica_relay *relay_self = NULL;
+
+/* reader */
+static int relay_reader_index = -1;
+static gfarm_uint64_t relay_reader_seq;
+
+/* this must be called after gfsd_hoststat_init(), and before fork(2) */
+void
+gfsd_replica_relay_init(void)
+{
+	void *addr;
+	size_t size;
+
+	relay_nentries = gfsd_hoststat_nslots();
+	if (relay_nentries == 0)
+		return;
+	size = sizeof(*relay_table) * relay_nentries;
+	addr = mmap(NULL, size, PROT_READ|PROT_WRITE,
+	    MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+	if (addr == MAP_FAILED) {
+		gflog_warning_errno(GFARM_MSG_UNFIXED,
+		    "replica relay: mmap %zu bytes", size);
+		relay_nentries = 0;
+		return;
+	}
+	memset(addr, 0, size);
+	relay_table = addr;
+}
+
+/*
+ * called by the writer after the local file is created.
+ * if this process has no slot, the replica cannot be relayed,
+ * and the readers will give up.
+ */
+void
+gfsd_replica_relay_begin(gfarm_ino_t ino, gfarm_uint64_t gen)
+{
+	int i = gfsd_hoststat_slot_index();
+
+	if (i < 0 || i >= relay_nentries) {
+		gflog_info(GFARM_MSG_UNFIXED,
+		    "replica relay: no slot, %lld:%lld is not relayed",
+		    (long long)ino, (long long)gen);
+		return;
+	}
+	relay_self = &relay_table[i];
+	/* the previous writer in this slot has died */
+	if (relay_self->state == RELAY_STATE_IN_PROGRESS)
+		relay_self->failed |= RELAY_FAILED_BIT(relay_self->seq);
+	relay_self->state = RELAY_STATE_NONE;
+	/* this must be cleared before a reader sees the new seq */
+	relay_self->failed &= ~RELAY_FAILED_BIT(relay_self->seq + 1);
+	__sync_synchronize();
+	relay_self->seq++;
+	relay_self->pid = getpid();
+	relay_self->ino = ino;
+	relay_self->gen = gen;
+	relay_self->state = RELAY_STATE_IN_PROGRESS;
+}
+
+/* called by the writer after all data is written or an error happens */
+void
+gfsd_replica_relay_end(gfarm_error_t e)
+{
+	if (relay_self == NULL)
+		return;
+	if (e != GFARM_ERR_NO_ERROR)
+		relay_self->failed |= RELAY_FAILED_BIT(relay_self->seq);
+	__sync_synchronize();
+	relay_self->state = e == GFARM_ERR_NO_ERROR ?
+	    RELAY_STATE_DONE : RELAY_STATE_FAILED;
+	relay_self = NULL;
+}
+
+/*
+ * the network_receive_timeout of the peer is split in half
+ * between the wait for the writer and the rest.
+ */
+static long long
+relay_timeout(void)
+{
+	return ((long long)gfarm_ctxp->network_receive_timeout *
+	    GFARM_SECOND_BY_NANOSEC / 2);
+}
+
+static int
+relay_lookup(gfarm_ino_t ino, gfarm_uint64_t gen)
+{
+	int i;
+
+	for (i = 0; i < relay_nentries; i++) {
+		if (relay_table[i].state != RELAY_STATE_NONE &&
+		    relay_table[i].ino == ino && relay_table[i].gen == gen)
+			return (i);
+	}
+	return (-1);
+}
+
+/* called by the reader before it opens the local file */
+gfarm_error_t
+gfsd_replica_relay_attach(gfarm_ino_t ino, gfarm_uint64_t gen)
+{
+	int i, state;
+	long long waited = 0, timeout = relay_timeout();
+
+	for (;;) {
+		if ((i = relay_lookup(ino, gen)) != -1)
+			break;
+		if (waited >= timeout) {
+			gflog_info(GFARM_MSG_UNFIXED,
+			    "replica relay: %lld:%lld is not being received",
+			    (long long)ino, (long long)gen);
+			return (GFARM_ERR_OPERATION_TIMED_OUT);
+		}
+		gfarm_nanosleep(RELAY_POLL_INTERVAL);
+		waited += RELAY_POLL_INTERVAL;
+	}
+	relay_reader_seq = relay_table[i].seq;
+	state = relay_table[i].state;
+	if (state == RELAY_STATE_FAILED)
+		return (GFARM_ERR_INPUT_OUTPUT);
+	relay_reader_index = i;
+	return (GFARM_ERR_NO_ERROR);
+}
+
+void
+gfsd_replica_relay_detach(void)
+{
+	relay_reader_index = -1;
+}
+
+int
+gfsd_replica_relay_is_attached(void)
+{
+	return (relay_reader_index != -1);
+}
+
+static int
+relay_state(void)
+{
+	volatile struct gfsd_replica_relay *r =
+	    &relay_table[relay_reader_index];
+	int state = r->state;
+	gfarm_uint64_t failed;
+
+	/* the entry is reused, thus the replication has finished */
+	if (r->seq != relay_reader_seq) {
+		__sync_synchronize();
+		failed = r->failed;
+		__sync_synchronize();
+		/* the result is lost, if the slot is reused too many times */
+		if (r->seq - relay_reader_seq >= RELAY_NHISTORY ||
+		    (failed & RELAY_FAILED_BIT(relay_reader_seq)) != 0)
+			return (RELAY_STATE_FAILED);
+		return (RELAY_STATE_DONE);
+	}
+	if (state == RELAY_STATE_IN_PROGRESS &&
+	    kill(r->pid, 0) == -1 && errno == ESRCH)
+		return (RELAY_STATE_FAILED);
+	return (state);
+}
+
+/*
+ * read(2) which waits for the data not written by the writer yet.
+ * a short count is returned only at the end of the file.
+ */
+ssize_t
+gfsd_replica_relay_read(int fd, void *buffer, size_t size, off_t offset)
+{
+	int state;
+	ssize_t rv, done = 0;
+	long long waited = 0, timeout = relay_timeout();
+
+	for (;;) {
+		/* the state must be checked before read(2) */
+		state = relay_state();
+		if (state == RELAY_STATE_FAILED) {
+			errno = EIO;
+			return (-1);
+		}
+		if (lseek(fd, offset + done, SEEK_SET) == -1)
+			return (-1);
+		if ((rv = read(fd, (char *)buffer + done, size - done)) == -1)
+			return (-1);
+		if (rv > 0) {
+			done += rv;
+			waited = 0;
+		}
+		if (done == size || state != RELAY_STATE_IN_PROGRESS)
+			return (done);
+		if (waited >= timeout) {
+			errno = ETIMEDOUT;
+			return (-1);
+		}
+		gfarm_nanosleep(RELAY_POLL_INTERVAL);
+		waited += RELAY_POLL_INTERVAL;
+	}
+}
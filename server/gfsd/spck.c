@@ -1,15 +1,33 @@
 /*
+ * spool consistency check at start-up of gfsd
+ *
+ * The spool is divided into units of data/XXXXXXXX/XX directories,
+ * each of which covers 2^24 inode numbers, and the units are checked
+ * by gfarm_spool_check_parallel threads.  The metadata of each unit is
+ * fetched from gfmd by GFM_PROTO_REPLICA_GET_MY_ENTRIES before walking
+ * the unit, thus only the replicas in the units being checked are kept
+ * in memory.  Because there is only one connection to gfmd, requests to
+ * gfmd are serialized by gfm_server_mutex.
+ *
+ * If gfsd was shut down cleanly after the last check at the lost_found
+ * level, and spool_check_incremental is enabled, only the directories
+ * and files which have been changed since the start of the last check
+ * are checked.
+ *
  * $Id$
  */
 
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <dirent.h>
+#include <fcntl.h>
 #include <string.h>
 #include <errno.h>
 #include <stdio.h>
+#include <time.h>
 
 #include <gfarm/gflog.h>
 #include <gfarm/error.h>
@@ -18,6 +36,7 @@
 
 #include "gfutil.h"
 #include "hash.h"
+#include "thrsubr.h"
 
 #include "config.h"
 #include "gfm_client.h"
@@ -26,6 +45,31 @@
 
 static enum gfarm_spool_check_level spool_check_level;
 
+static pthread_mutex_t gfm_server_mutex = PTHREAD_MUTEX_INITIALIZER;
+static const char gfm_server_diag[] = "gfm_server";
+
+/* the state of the last check, saved at clean shutdown */
+#define SPOOL_CHECK_STATE_FILE		".spool_check"
+#define SPOOL_CHECK_STATE_FILE_TMP	".spool_check.tmp"
+#define SPOOL_CHECK_STATE_MAGIC		"gfsd_spool_check"
+#define SPOOL_CHECK_STATE_VERSION	1
+
+static int spool_check_incremental;
+static time_t spool_check_since; /* if spool_check_incremental */
+static int spool_check_failed;
+
+/* what gfsd_spool_check_state_save() writes, "" if nothing */
+static char spool_check_state[64];
+
+struct spool_check_unit {
+	char *dir;
+	gfarm_ino_t inum; /* the first inode number in this directory */
+	int full; /* check all files, instead of changed files only */
+
+	struct gfarm_hash_table *hash_ok; /* valid files */
+	gfarm_uint64_t nchecked, nskipped;
+};
+
 static gfarm_error_t
 move_file_to_lost_found_main(const char *file, struct stat *stp,
 	gfarm_ino_t inum_old, gfarm_uint64_t gen_old)
@@ -297,13 +341,19 @@ check_file(char *file, struct stat *stp, void *arg)
 	gfarm_uint64_t gen, *genp;
 	gfarm_off_t size;
 	gfarm_error_t e;
-	struct gfarm_hash_table *hash_ok = arg;
+	struct spool_check_unit *u = arg;
+	struct gfarm_hash_table *hash_ok = u->hash_ok;
 	struct gfarm_hash_entry *hash_ent;
+	static const char diag[] = "check_file";
 
-	/* READONLY_CONFIG_FILE should be skipped */
-	if (strcmp(file, READONLY_CONFIG_FILE) == 0)
+	/* READONLY_CONFIG_FILE and SPOOL_CHECK_STATE_FILE should be skipped */
+	if (strcmp(file, READONLY_CONFIG_FILE) == 0 ||
+	    strcmp(file, SPOOL_CHECK_STATE_FILE) == 0 ||
+	    strcmp(file, SPOOL_CHECK_STATE_FILE_TMP) == 0)
 		return (GFARM_ERR_NO_ERROR);
 
+	u->nchecked++;
+
 	if (get_inum_gen(file, &inum, &gen))
 		return (deal_with_invalid_file(file, stp, 0, 0, 0, 0));
 	if (hash_ok) {
@@ -316,6 +366,7 @@ check_file(char *file, struct stat *stp, void *arg)
 	}
 
 	size = stp->st_size;
+	gfarm_mutex_lock(&gfm_server_mutex, diag, gfm_server_diag);
 	e = gfm_client_replica_add(gfm_server, inum, gen, size);
 	switch (e) {
 	case GFARM_ERR_ALREADY_EXISTS:
@@ -341,13 +392,28 @@ check_file(char *file, struct stat *stp, void *arg)
 		    (unsigned long long)inum, (unsigned long long)gen,
 		    gfarm_error_string(e));
 	}
+	gfarm_mutex_unlock(&gfm_server_mutex, diag, gfm_server_diag);
 	return (e);
 }
 
+static int
+is_changed(struct stat *stp)
+{
+	return (stp->st_mtime >= spool_check_since ||
+	    stp->st_ctime >= spool_check_since);
+}
+
+/* check only the files changed since the last check */
 static gfarm_error_t
-check_spool(char *dir, struct gfarm_hash_table *hash_ok)
+check_file_if_changed(char *file, struct stat *stp, void *arg)
 {
-	return (dir_foreach(check_file, NULL, NULL, dir, hash_ok));
+	struct spool_check_unit *u = arg;
+
+	if (!is_changed(stp)) {
+		u->nskipped++;
+		return (GFARM_ERR_NO_ERROR);
+	}
+	return (check_file(file, stp, arg));
 }
 
 static void
@@ -362,6 +428,7 @@ check_existing(
 	gfarm_ino_t inum2;
 	gfarm_uint64_t gen2, *genp;
 	struct gfarm_hash_entry *hash_ent;
+	static const char diag[] = "check_existing";
 
 	/*
 	 * If gfsd_local_path() or get_inum_gen() are broken,
@@ -411,7 +478,9 @@ check_existing(
 	/* else: This file will be checked by gfm_client_replica_add(). */
 
 	if (lost) { /* delete the replica-reference from metadata */
+		gfarm_mutex_lock(&gfm_server_mutex, diag, gfm_server_diag);
 		e = gfm_client_replica_lost(gfm_server, inum, gen);
+		gfarm_mutex_unlock(&gfm_server_mutex, diag, gfm_server_diag);
 		if (e != GFARM_ERR_NO_ERROR)
 			gflog_error(GFARM_MSG_1003537,
 			    "replica_lost(%llu, %llu): %s",
@@ -423,19 +492,24 @@ check_existing(
 
 #define REQUEST_NUM 10000
 
+/* check the replicas of inode number [inum, inum_last] in metadata */
 static gfarm_error_t
-check_metadata(struct gfarm_hash_table *hash_ok)
+check_metadata(struct gfarm_hash_table *hash_ok,
+	gfarm_ino_t inum, gfarm_ino_t inum_last)
 {
 	gfarm_error_t e;
-	gfarm_ino_t inum, *inums;
+	gfarm_ino_t *inums;
 	gfarm_uint64_t *gens;
 	gfarm_off_t *sizes;
 	int i, n;
+	static const char diag[] = "check_metadata";
 
-	for (inum = 0;; inum++) {
+	for (;; inum++) {
 		n = REQUEST_NUM;
+		gfarm_mutex_lock(&gfm_server_mutex, diag, gfm_server_diag);
 		e = gfm_client_replica_get_my_entries(gfm_server,
 		    inum, n, &n, &inums, &gens, &sizes);
+		gfarm_mutex_unlock(&gfm_server_mutex, diag, gfm_server_diag);
 		if (e == GFARM_ERR_NO_SUCH_OBJECT)
 			return (GFARM_ERR_NO_ERROR); /* end */
 		else if (e != GFARM_ERR_NO_ERROR) {
@@ -443,22 +517,451 @@ check_metadata(struct gfarm_hash_table *hash_ok)
 			    "replica_get_my_entries(%llu, %d): %s",
 			    (unsigned long long)inum, REQUEST_NUM,
 			    gfarm_error_string(e));
+			spool_check_failed = 1;
 			return (e);
 		}
 		for (i = 0; i < n && i < REQUEST_NUM; i++) {
+			if (inums[i] > inum_last)
+				break;
 			check_existing(hash_ok, inums[i], gens[i], sizes[i]);
 			inum = inums[i];
 		}
 		free(inums);
 		free(gens);
 		free(sizes);
-		if (n < REQUEST_NUM)
+		if (n < REQUEST_NUM || i < n || inum == inum_last)
 			return (GFARM_ERR_NO_ERROR); /* end */
 	}
 }
 
+/*
+ * spool directory layout, see gfsd_local_path():
+ * level 0: data
+ * level 1: data/XXXXXXXX		inode number bits 32...63
+ * level 2: data/XXXXXXXX/XX		inode number bits 24...31 (unit)
+ * level 3: data/XXXXXXXX/XX/XX		inode number bits 16...23
+ * level 4: data/XXXXXXXX/XX/XX/XX	inode number bits  8...15
+ */
+#define SPOOL_DATA_DIR		"data"
+#define SPOOL_LEVEL_UNIT	2
+#define SPOOL_LEVEL_LEAF	4
+
+static int
+spool_level_shift(int level)
+{
+	return (level == 1 ? 32 : 8 * (SPOOL_LEVEL_LEAF + 1 - level));
+}
+
+static gfarm_ino_t
+spool_level_last(int level, gfarm_ino_t inum)
+{
+	return (level == 0 ? ~(gfarm_ino_t)0 :
+	    inum + ((gfarm_ino_t)1 << spool_level_shift(level)) - 1);
+}
+
+/* returns -1, if the name isn't a directory name of the level */
+static long long
+spool_level_index(int level, const char *name)
+{
+	size_t len = level == 1 ? 8 : 2;
+	unsigned long long v = 0;
+	int i, c;
+
+	if (strlen(name) != len)
+		return (-1);
+	for (i = 0; i < len; i++) {
+		c = name[i];
+		if (c >= '0' && c <= '9')
+			v = (v << 4) | (c - '0');
+		else if (c >= 'A' && c <= 'F')
+			v = (v << 4) | (c - 'A' + 10);
+		else
+			return (-1);
+	}
+	return (v);
+}
+
+static char *
+path_join(const char *dir, const char *name)
+{
+	char *path;
+
+	GFARM_MALLOC_ARRAY(path, strlen(dir) + 1 + strlen(name) + 1);
+	if (path == NULL) {
+		gflog_error(GFARM_MSG_UNFIXED, "%s/%s: no memory", dir, name);
+		spool_check_failed = 1;
+		return (NULL);
+	}
+	sprintf(path, "%s/%s", dir, name);
+	return (path);
+}
+
 #define HASH_OK_SIZE 999983
 
+static int
+spool_level_hash_size(int level)
+{
+	return (level <= SPOOL_LEVEL_UNIT ? HASH_OK_SIZE :
+	    level < SPOOL_LEVEL_LEAF ? 65521 : 1021);
+}
+
+/* level should be SPOOL_LEVEL_UNIT or deeper */
+static void
+check_dir(struct spool_check_unit *u, const char *dir, int level,
+	gfarm_ino_t inum, int full)
+{
+	DIR *dirp;
+	struct dirent *dp;
+	struct stat st;
+	char *path;
+	long long index;
+	struct gfarm_hash_table *hash_ok_save = u->hash_ok;
+	int metadata_checked = 0;
+
+	if (lstat(dir, &st) == -1) {
+		gflog_error(GFARM_MSG_UNFIXED, "%s: %s", dir, strerror(errno));
+		return;
+	}
+	if (!full && is_changed(&st))
+		full = 1; /* some files may be added or removed here */
+	if (full && u->hash_ok == NULL &&
+	    spool_check_level == GFARM_SPOOL_CHECK_LEVEL_LOST_FOUND) {
+		u->hash_ok = gfarm_hash_table_alloc(
+		    spool_level_hash_size(level),
+		    gfarm_hash_default, gfarm_hash_key_equal_default);
+		if (u->hash_ok == NULL)
+			fatal(GFARM_MSG_UNFIXED, "no memory for spool_check");
+		metadata_checked = 1;
+		(void)check_metadata(u->hash_ok, inum,
+		    spool_level_last(level, inum));
+	}
+
+	dirp = opendir(dir);
+	if (dirp == NULL) {
+		gflog_error(GFARM_MSG_UNFIXED, "opendir(%s): %s",
+		    dir, strerror(errno));
+		spool_check_failed = 1;
+	} else {
+		while ((dp = readdir(dirp)) != NULL) {
+			if (dp->d_name[0] == '.' && (dp->d_name[1] == '\0' ||
+			    (dp->d_name[1] == '.' && dp->d_name[2] == '\0')))
+				continue;
+			if ((path = path_join(dir, dp->d_name)) == NULL)
+				break;
+			if (level < SPOOL_LEVEL_LEAF &&
+			    (index = spool_level_index(level + 1, dp->d_name))
+			    != -1 &&
+			    lstat(path, &st) == 0 && S_ISDIR(st.st_mode))
+				check_dir(u, path, level + 1, inum |
+				    ((gfarm_ino_t)index <<
+				     spool_level_shift(level + 1)), full);
+			else
+				(void)dir_foreach(full ? check_file :
+				    check_file_if_changed, NULL, NULL, path, u);
+			free(path);
+		}
+		closedir(dirp);
+	}
+
+	if (metadata_checked) {
+		gfarm_hash_table_free(u->hash_ok);
+		u->hash_ok = hash_ok_save;
+	}
+}
+
+static pthread_mutex_t units_mutex = PTHREAD_MUTEX_INITIALIZER;
+static const char units_diag[] = "spool_check_units";
+static struct spool_check_unit *units;
+static int nunits, units_next;
+
+static void *
+check_units_thread(void *arg)
+{
+	struct spool_check_unit *u;
+	static const char diag[] = "check_units_thread";
+
+	for (;;) {
+		gfarm_mutex_lock(&units_mutex, diag, units_diag);
+		u = units_next < nunits ? &units[units_next++] : NULL;
+		gfarm_mutex_unlock(&units_mutex, diag, units_diag);
+		if (u == NULL)
+			return (NULL);
+		check_dir(u, u->dir, SPOOL_LEVEL_UNIT, u->inum, u->full);
+	}
+}
+
+static void
+check_units(void)
+{
+	int i, err, nthreads = gfarm_spool_check_parallel;
+	pthread_t *threads;
+
+	if (nthreads > nunits)
+		nthreads = nunits;
+	if (nthreads <= 1) {
+		(void)check_units_thread(NULL);
+		return;
+	}
+	GFARM_MALLOC_ARRAY(threads, nthreads);
+	if (threads == NULL)
+		fatal(GFARM_MSG_UNFIXED, "no memory for spool_check threads");
+	/* the main thread is one of the workers */
+	for (i = 1; i < nthreads; i++) {
+		err = pthread_create(&threads[i], NULL, check_units_thread,
+		    NULL);
+		if (err != 0) {
+			gflog_warning(GFARM_MSG_UNFIXED,
+			    "spool_check: pthread_create: %s", strerror(err));
+			break;
+		}
+	}
+	nthreads = i;
+	(void)check_units_thread(NULL);
+	for (i = 1; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+}
+
+static int
+unit_compare(const void *a, const void *b)
+{
+	const struct spool_check_unit *p = a, *q = b;
+
+	return (p->inum < q->inum ? -1 : p->inum > q->inum ? 1 : 0);
+}
+
+/*
+ * check the replicas of [inum, inum_last] in metadata,
+ * which aren't covered by any unit, i.e. the directory doesn't exist.
+ * PREREQUISITE: units are sorted.
+ */
+static void
+check_metadata_outside_units(gfarm_ino_t inum, gfarm_ino_t inum_last)
+{
+	gfarm_error_t e;
+	gfarm_ino_t *inums, next;
+	gfarm_uint64_t *gens;
+	gfarm_off_t *sizes;
+	struct spool_check_unit key, *u;
+	int i, n, done, skipped;
+
+	for (;;) {
+		n = REQUEST_NUM;
+		e = gfm_client_replica_get_my_entries(gfm_server,
+		    inum, n, &n, &inums, &gens, &sizes);
+		if (e == GFARM_ERR_NO_SUCH_OBJECT)
+			return; /* end */
+		else if (e != GFARM_ERR_NO_ERROR) {
+			gflog_error(GFARM_MSG_UNFIXED,
+			    "replica_get_my_entries(%llu, %d): %s",
+			    (unsigned long long)inum, REQUEST_NUM,
+			    gfarm_error_string(e));
+			spool_check_failed = 1;
+			return;
+		}
+		next = inum;
+		done = skipped = 0;
+		for (i = 0; i < n && i < REQUEST_NUM; i++) {
+			if (inums[i] > inum_last) {
+				done = 1;
+				break;
+			}
+			key.inum = inums[i] & (~(gfarm_ino_t)0 <<
+			    spool_level_shift(SPOOL_LEVEL_UNIT));
+			u = bsearch(&key, units, nunits, sizeof(*units),
+			    unit_compare);
+			if (u != NULL) { /* already checked, skip the unit */
+				next = spool_level_last(SPOOL_LEVEL_UNIT,
+				    u->inum);
+				skipped = 1;
+				break;
+			}
+			check_existing(NULL, inums[i], gens[i], sizes[i]);
+			next = inums[i];
+		}
+		free(inums);
+		free(gens);
+		free(sizes);
+		if (done || next >= inum_last || (!skipped && n < REQUEST_NUM))
+			return; /* end */
+		inum = next + 1;
+	}
+}
+
+/* enumerate units in data/XXXXXXXX, and check other files there */
+static void
+add_units(struct spool_check_unit *u, const char *dir, gfarm_ino_t inum,
+	int full)
+{
+	DIR *dirp;
+	struct dirent *dp;
+	struct stat st;
+	char *path;
+	long long index;
+
+	dirp = opendir(dir);
+	if (dirp == NULL) {
+		gflog_error(GFARM_MSG_UNFIXED, "opendir(%s): %s",
+		    dir, strerror(errno));
+		spool_check_failed = 1;
+		return;
+	}
+	while ((dp = readdir(dirp)) != NULL) {
+		if (dp->d_name[0] == '.' && (dp->d_name[1] == '\0' ||
+		    (dp->d_name[1] == '.' && dp->d_name[2] == '\0')))
+			continue;
+		if ((path = path_join(dir, dp->d_name)) == NULL)
+			break;
+		if ((index = spool_level_index(SPOOL_LEVEL_UNIT, dp->d_name))
+		    == -1 || lstat(path, &st) == -1 || !S_ISDIR(st.st_mode)) {
+			(void)dir_foreach(check_file, NULL, NULL, path, u);
+			free(path);
+			continue;
+		}
+		if (!GFARM_REALLOC_ARRAY(units, units, nunits + 1))
+			fatal(GFARM_MSG_UNFIXED, "no memory for spool_check");
+		memset(&units[nunits], 0, sizeof(units[nunits]));
+		units[nunits].dir = path;
+		units[nunits].inum = inum |
+		    (gfarm_ino_t)index << spool_level_shift(SPOOL_LEVEL_UNIT);
+		units[nunits].full = full;
+		nunits++;
+	}
+	closedir(dirp);
+}
+
+/*
+ * walk the spool directory, except the units which are checked later.
+ * the ranges of inode number which should be fully checked are
+ * returned, because they may have the replicas without the units.
+ */
+static void
+check_spool(struct spool_check_unit *u,
+	int *nrangesp, gfarm_ino_t **rangesp)
+{
+	DIR *dirp;
+	struct dirent *dp;
+	struct stat st;
+	char *path;
+	long long index;
+	int full, full_all, nranges = 0;
+	gfarm_ino_t *ranges = NULL, inum;
+
+	/* files other than data/ are not used */
+	dirp = opendir(".");
+	if (dirp == NULL)
+		fatal(GFARM_MSG_UNFIXED, "opendir(%s): %s",
+		    gfarm_spool_root, strerror(errno));
+	while ((dp = readdir(dirp)) != NULL) {
+		if ((dp->d_name[0] == '.' && (dp->d_name[1] == '\0' ||
+		    (dp->d_name[1] == '.' && dp->d_name[2] == '\0'))) ||
+		    strcmp(dp->d_name, SPOOL_DATA_DIR) == 0)
+			continue;
+		(void)dir_foreach(check_file, NULL, NULL, dp->d_name, u);
+	}
+	closedir(dirp);
+
+	if (lstat(SPOOL_DATA_DIR, &st) == -1) {
+		full_all = 1; /* all replicas are lost */
+	} else if (!S_ISDIR(st.st_mode)) {
+		(void)dir_foreach(check_file, NULL, NULL, SPOOL_DATA_DIR, u);
+		full_all = 1;
+	} else {
+		full_all = !spool_check_incremental || is_changed(&st);
+		dirp = opendir(SPOOL_DATA_DIR);
+		if (dirp == NULL)
+			fatal(GFARM_MSG_UNFIXED, "opendir(%s): %s",
+			    SPOOL_DATA_DIR, strerror(errno));
+		while ((dp = readdir(dirp)) != NULL) {
+			if (dp->d_name[0] == '.' && (dp->d_name[1] == '\0' ||
+			    (dp->d_name[1] == '.' && dp->d_name[2] == '\0')))
+				continue;
+			if ((path = path_join(SPOOL_DATA_DIR, dp->d_name))
+			    == NULL)
+				break;
+			index = spool_level_index(1, dp->d_name);
+			if (index == -1 || lstat(path, &st) == -1 ||
+			    !S_ISDIR(st.st_mode)) {
+				(void)dir_foreach(check_file, NULL, NULL,
+				    path, u);
+				free(path);
+				continue;
+			}
+			inum = (gfarm_ino_t)index << spool_level_shift(1);
+			full = full_all || is_changed(&st);
+			if (full && !full_all) {
+				if (!GFARM_REALLOC_ARRAY(ranges, ranges,
+				    nranges + 1))
+					fatal(GFARM_MSG_UNFIXED,
+					    "no memory for spool_check");
+				ranges[nranges++] = inum;
+			}
+			add_units(u, path, inum, full);
+			free(path);
+		}
+		closedir(dirp);
+	}
+	if (full_all) {
+		free(ranges);
+		nranges = -1; /* everything */
+		ranges = NULL;
+	}
+	*nrangesp = nranges;
+	*rangesp = ranges;
+}
+
+static void
+spool_check_state_load(void)
+{
+	FILE *fp;
+	char magic[sizeof(SPOOL_CHECK_STATE_MAGIC)];
+	int version;
+	long long since;
+
+	/* the state is valid only once after clean shutdown */
+	fp = fopen(SPOOL_CHECK_STATE_FILE, "r");
+	if (fp == NULL)
+		return;
+	if (unlink(SPOOL_CHECK_STATE_FILE) == -1) {
+		gflog_error(GFARM_MSG_UNFIXED, "unlink(%s): %s",
+		    SPOOL_CHECK_STATE_FILE, strerror(errno));
+	} else if (fscanf(fp, "%16s %d %lld", magic, &version, &since) == 3 &&
+	    strcmp(magic, SPOOL_CHECK_STATE_MAGIC) == 0 &&
+	    version == SPOOL_CHECK_STATE_VERSION) {
+		spool_check_since = since;
+		spool_check_incremental = 1;
+	} else {
+		gflog_warning(GFARM_MSG_UNFIXED, "%s: invalid format",
+		    SPOOL_CHECK_STATE_FILE);
+	}
+	fclose(fp);
+}
+
+/*
+ * this is called at clean shutdown, and may be called from a signal handler.
+ * thus only async-signal-safe functions can be used here.
+ */
+void
+gfsd_spool_check_state_save(void)
+{
+	int fd;
+	size_t len = strlen(spool_check_state);
+
+	if (len == 0)
+		return;
+	fd = open(SPOOL_CHECK_STATE_FILE_TMP, O_WRONLY|O_CREAT|O_TRUNC, 0600);
+	if (fd == -1)
+		return;
+	if (write(fd, spool_check_state, len) != len || fsync(fd) == -1) {
+		close(fd);
+		unlink(SPOOL_CHECK_STATE_FILE_TMP);
+		return;
+	}
+	close(fd);
+	if (rename(SPOOL_CHECK_STATE_FILE_TMP, SPOOL_CHECK_STATE_FILE) == -1)
+		unlink(SPOOL_CHECK_STATE_FILE_TMP);
+}
+
 /*
  *  gfarm_spool_check_level == GFARM_SPOOL_CHECK_LEVEL_... :
  *  DISPLAY    ... display invalid files (slow)
@@ -469,28 +972,68 @@ check_metadata(struct gfarm_hash_table *hash_ok)
 void
 gfsd_spool_check()
 {
-	struct gfarm_hash_table *hash_ok; /* valid files */
+	struct spool_check_unit top;
+	gfarm_ino_t *ranges;
+	gfarm_uint64_t nchecked, nskipped;
+	time_t started = time(NULL);
+	int i, nranges;
 
 	gflog_debug(GFARM_MSG_1003680, "spool_check_level=%s",
 	    gfarm_spool_check_level_get_by_name());
 
+	spool_check_state_load();
 	spool_check_level = gfarm_spool_check_level_get();
 	switch (spool_check_level) {
 	case GFARM_SPOOL_CHECK_LEVEL_LOST_FOUND:
-		hash_ok = gfarm_hash_table_alloc(HASH_OK_SIZE,
-		    gfarm_hash_default, gfarm_hash_key_equal_default);
-		if (hash_ok == NULL)
-			fatal(GFARM_MSG_1003560, "no memory for spool_check");
-		check_metadata(hash_ok);
+		if (!gfarm_spool_check_incremental)
+			spool_check_incremental = 0;
 		break;
 	case GFARM_SPOOL_CHECK_LEVEL_DISPLAY:
 	case GFARM_SPOOL_CHECK_LEVEL_DELETE:
-		hash_ok = NULL;
+		/* invalid files should be reported every time */
+		spool_check_incremental = 0;
 		break;
 	default:
 		return;
 	}
-	(void)check_spool(".", hash_ok);
-	if (hash_ok)
-		gfarm_hash_table_free(hash_ok);
+	if (spool_check_incremental)
+		gflog_info(GFARM_MSG_UNFIXED,
+		    "spool_check: files changed since %lld are checked",
+		    (long long)spool_check_since);
+
+	memset(&top, 0, sizeof(top));
+	check_spool(&top, &nranges, &ranges);
+	check_units();
+
+	if (spool_check_level == GFARM_SPOOL_CHECK_LEVEL_LOST_FOUND) {
+		/* replicas whose directory doesn't exist */
+		qsort(units, nunits, sizeof(*units), unit_compare);
+		if (nranges == -1)
+			check_metadata_outside_units(0, ~(gfarm_ino_t)0);
+		for (i = 0; i < nranges; i++)
+			check_metadata_outside_units(ranges[i],
+			    spool_level_last(1, ranges[i]));
+	}
+	free(ranges);
+
+	nchecked = top.nchecked;
+	nskipped = top.nskipped;
+	for (i = 0; i < nunits; i++) {
+		nchecked += units[i].nchecked;
+		nskipped += units[i].nskipped;
+		free(units[i].dir);
+	}
+	free(units);
+	units = NULL;
+	nunits = units_next = 0;
+	gflog_info(GFARM_MSG_UNFIXED,
+	    "spool_check: %llu files checked, %llu unchanged files skipped, "
+	    "%ld seconds", (unsigned long long)nchecked,
+	    (unsigned long long)nskipped, (long)(time(NULL) - started));
+
+	if (spool_check_level == GFARM_SPOOL_CHECK_LEVEL_LOST_FOUND &&
+	    !spool_check_failed)
+		snprintf(spool_check_state, sizeof(spool_check_state),
+		    "%s %d %lld\n", SPOOL_CHECK_STATE_MAGIC,
+		    SPOOL_CHECK_STATE_VERSION, (long long)started);
 }
@@ -1,5 +1,6 @@
 #include <stddef.h>
 #include <errno.h>
+#include <sys/types.h> /* pid_t in gfsd_subr.h */
 #include <gfarm/gfarm.h>
 #include "gfsd_subr.h"
 